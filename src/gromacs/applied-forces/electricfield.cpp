@@ -45,6 +45,8 @@
 
 #include <cmath>
 
+#include <algorithm>
+
 #include "gromacs/commandline/filenm.h"
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/fileio/xvgr.h"
@@ -160,7 +162,8 @@ class ElectricField : public IMDModule,
                       public IForceProvider
 {
     public:
-        ElectricField() : fpField_(nullptr) {}
+        ElectricField() : fpField_(nullptr), stepForce_(nullptr),
+                          stepCharge_(nullptr), stepHomenr_(0) {}
 
         // From IMDModule
         virtual IMdpOptionProvider *mdpOptionProvider() { return this; }
@@ -183,6 +186,14 @@ class ElectricField : public IMDModule,
                                      const t_mdatoms  *mdatoms,
                                      PaddedRVecVector *force,
                                      double            t);
+        //! \copydoc IForceProvider::prepareForcesForAtomRanges()
+        virtual void prepareForcesForAtomRanges(const t_commrec  *cr,
+                                                const t_mdatoms  *mdatoms,
+                                                PaddedRVecVector *force,
+                                                double            t);
+        //! \copydoc IForceProvider::calculateForcesForAtomRange()
+        virtual void calculateForcesForAtomRange(int atomStart,
+                                                 int atomEnd);
 
     private:
         //! Return whether or not to apply a field
@@ -232,6 +243,14 @@ class ElectricField : public IMDModule,
         ElectricFieldData efield_[DIM];
         //! File pointer for electric field
         FILE             *fpField_;
+        //! The force per unit charge for the current step
+        rvec              stepFieldForce_;
+        //! The force array for the current step, nullptr when no field is applied
+        rvec             *stepForce_;
+        //! The charges for the current step
+        const real       *stepCharge_;
+        //! The number of home atoms for the current step
+        int               stepHomenr_;
 };
 
 //! Converts static parameters from mdp format to E0.
@@ -389,24 +408,26 @@ void ElectricField::calculateForces(const t_commrec  *cr,
                                     PaddedRVecVector *force,
                                     double            t)
 {
+    prepareForcesForAtomRanges(cr, mdatoms, force, t);
+    calculateForcesForAtomRange(0, mdatoms->homenr);
+}
+
+void ElectricField::prepareForcesForAtomRanges(const t_commrec  *cr,
+                                               const t_mdatoms  *mdatoms,
+                                               PaddedRVecVector *force,
+                                               double            t)
+{
+    stepForce_ = nullptr;
     if (isActive())
     {
-        rvec *f = as_rvec_array(force->data());
-
         for (int m = 0; (m < DIM); m++)
         {
-            real Ext = FIELDFAC*field(m, t);
-
-            if (Ext != 0)
-            {
-                // TODO: Check parallellism
-                for (int i = 0; i < mdatoms->homenr; ++i)
-                {
-                    // NOTE: Not correct with perturbed charges
-                    f[i][m] += mdatoms->chargeA[i]*Ext;
-                }
-            }
+            stepFieldForce_[m] = FIELDFAC*field(m, t);
         }
+        stepForce_  = as_rvec_array(force->data());
+        stepCharge_ = mdatoms->chargeA;
+        stepHomenr_ = mdatoms->homenr;
+
         if (MASTER(cr) && fpField_ != nullptr)
         {
             printComponents(t);
@@ -414,6 +435,30 @@ void ElectricField::calculateForces(const t_commrec  *cr,
     }
 }
 
+void ElectricField::calculateForcesForAtomRange(int atomStart,
+                                                int atomEnd)
+{
+    if (stepForce_ == nullptr)
+    {
+        return;
+    }
+
+    atomEnd = std::min(atomEnd, stepHomenr_);
+    for (int m = 0; (m < DIM); m++)
+    {
+        real Ext = stepFieldForce_[m];
+
+        if (Ext != 0)
+        {
+            for (int i = atomStart; i < atomEnd; ++i)
+            {
+                // NOTE: Not correct with perturbed charges
+                stepForce_[i][m] += stepCharge_[i]*Ext;
+            }
+        }
+    }
+}
+
 }   // namespace
 
 std::unique_ptr<IMDModule> createElectricFieldModule()
@@ -43,6 +43,8 @@
 
 #include "gromacs/applied-forces/electricfield.h"
 
+#include <string>
+
 #include <gtest/gtest.h>
 
 #include "gromacs/gmxlib/network.h"
@@ -134,4 +136,53 @@ TEST_F(ElectricFieldTest, Pulsed)
     test(0, 1, 5, 0.5, 1, -68.215782);
 }
 
+TEST_F(ElectricFieldTest, AtomRangesMatchFullCalculation)
+{
+    gmx::MDModules               module;
+    gmx::KeyValueTreeBuilder     mdpValues;
+    mdpValues.rootObject().addValue<std::string>("E-x", "1 0.5 0");
+    mdpValues.rootObject().addValue<std::string>("E-z", "1 -2 0");
+
+    gmx::KeyValueTreeTransformer transform;
+    transform.rules()->addRule()
+        .keyMatchType("/", gmx::StringCompareType::CaseAndDashInsensitive);
+    module.initMdpTransform(transform.rules());
+    auto result = transform.transform(mdpValues.build(), nullptr);
+    module.assignOptionsToModules(result.object(), nullptr);
+
+    const int        natoms = 5;
+    t_mdatoms        md;
+    PaddedRVecVector fFull(natoms + 1, { 0, 0, 0 });
+    PaddedRVecVector fRanges(natoms + 1, { 0, 0, 0 });
+    md.homenr = natoms - 1;
+    snew(md.chargeA, natoms);
+    for (int i = 0; i < natoms; i++)
+    {
+        md.chargeA[i] = 0.5*(i - 2);
+    }
+
+    t_commrec  *cr       = init_commrec();
+    t_forcerec *forcerec = mk_forcerec();
+    module.forceProvider()->initForcerec(forcerec);
+    forcerec->efield->calculateForces(cr, &md, &fFull, 0);
+    forcerec->efield->prepareForcesForAtomRanges(cr, &md, &fRanges, 0);
+    forcerec->efield->calculateForcesForAtomRange(2, natoms);
+    forcerec->efield->calculateForcesForAtomRange(0, 2);
+    done_commrec(cr);
+
+    for (int i = 0; i < natoms; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_REAL_EQ_TOL(fFull[i][d], fRanges[i][d], gmx::test::defaultRealTolerance());
+        }
+    }
+    /* Only home atoms get a force */
+    EXPECT_REAL_EQ_TOL(0, fRanges[natoms - 1][XX], gmx::test::defaultRealTolerance());
+    EXPECT_REAL_EQ_TOL(0, fRanges[natoms - 1][ZZ], gmx::test::defaultRealTolerance());
+    EXPECT_REAL_EQ_TOL(0, fRanges[0][YY], gmx::test::defaultRealTolerance());
+    sfree(forcerec);
+    sfree(md.chargeA);
+}
+
 } // namespace
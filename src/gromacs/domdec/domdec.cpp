@@ -3092,6 +3092,68 @@ static void dd_cell_sizes_dlb_root_enforce_limits(gmx_domdec_t *dd,
 }
 
 
+/*! \brief Sets the cell sizes along a row by bisecting the cumulative load
+ *
+ * The load within each current cell is assumed to be uniformly distributed,
+ * which gives a piecewise linear cumulative load along the row.
+ * The new boundaries are placed at the points where this function reaches
+ * equal fractions of the total load. Since the rows of the higher DD
+ * dimensions balance the load within the slabs set along the lower
+ * dimensions, this results in an orthogonal recursive bisection of the
+ * system that is restricted to the staggered DD grid, so the zone and halo
+ * communication setup is unaffected.
+ * The new sizes are returned in \p cell_size, mixed with the old sizes
+ * with relaxation factor \p relax to dampen noise in the load measurement.
+ */
+static void set_cell_sizes_recursive_bisection(const domdec_load_t *load,
+                                               int ncd, const real *cell_f,
+                                               real relax, real *cell_size)
+{
+    real load_tot = 0;
+    for (int i = 0; i < ncd; i++)
+    {
+        load_tot += load->load[i*load->nload + 2];
+    }
+    if (load_tot <= 0)
+    {
+        for (int i = 0; i < ncd; i++)
+        {
+            cell_size[i] = cell_f[i + 1] - cell_f[i];
+        }
+        return;
+    }
+
+    /* Walk along the row and determine the bisection points */
+    int  i        = 0;
+    real load_cum = 0;
+    real f_prev   = cell_f[0];
+    for (int k = 1; k <= ncd; k++)
+    {
+        real f;
+        if (k < ncd)
+        {
+            real load_target = k*load_tot/ncd;
+            while (i < ncd - 1 &&
+                   load_cum + load->load[i*load->nload + 2] < load_target)
+            {
+                load_cum += load->load[i*load->nload + 2];
+                i++;
+            }
+            real load_i = load->load[i*load->nload + 2];
+            real frac   = (load_i > 0 ? (load_target - load_cum)/load_i : 0.5);
+            frac        = std::min(std::max(frac, static_cast<real>(0)), static_cast<real>(1));
+            f           = cell_f[i] + frac*(cell_f[i + 1] - cell_f[i]);
+        }
+        else
+        {
+            f = cell_f[ncd];
+        }
+        real size_old    = cell_f[k] - cell_f[k - 1];
+        cell_size[k - 1] = (1 - relax)*size_old + relax*(f - f_prev);
+        f_prev           = f;
+    }
+}
+
 static void set_dd_cell_sizes_dlb_root(gmx_domdec_t *dd,
                                        int d, int dim, domdec_root_t *root,
                                        const gmx_ddbox_t *ddbox,
@@ -3131,6 +3193,14 @@ static void set_dd_cell_sizes_dlb_root(gmx_domdec_t *dd,
             cell_size[i] = 1.0/ncd;
         }
     }
+    else if (dd_load_count(comm) > 0 && comm->bRecursiveBisection)
+    {
+        /* The boundaries are not limited by dlb_scale_lim here,
+         * only by the cell size and staggering limits applied below.
+         */
+        set_cell_sizes_recursive_bisection(&comm->load[d], ncd, root->cell_f,
+                                           relax, cell_size);
+    }
     else if (dd_load_count(comm) > 0)
     {
         load_aver  = comm->load[d].sum_m/ncd;
@@ -5566,6 +5636,112 @@ static void setup_neighbor_relations(gmx_domdec_t *dd)
     }
 }
 
+#if GMX_MPI
+int dd_node_blocked_ddindex(FILE *fplog, const ivec nc, MPI_Comm comm_pp, int node_id)
+{
+    MPI_Comm comm_node, comm_leaders;
+    int      rank_pp, nrank_pp, nrank_node, rank_node, node_index = 0, nnodes;
+    int      nrank_node_minmax[2], buf[2];
+
+    MPI_Comm_rank(comm_pp, &rank_pp);
+    MPI_Comm_size(comm_pp, &nrank_pp);
+    MPI_Comm_split(comm_pp, node_id, rank_pp, &comm_node);
+    MPI_Comm_size(comm_node, &nrank_node);
+    MPI_Comm_rank(comm_node, &rank_node);
+
+    /* Number the nodes in order of their lowest rank */
+    MPI_Comm_split(comm_pp, rank_node == 0 ? 0 : MPI_UNDEFINED, rank_pp,
+                   &comm_leaders);
+    if (rank_node == 0)
+    {
+        MPI_Comm_rank(comm_leaders, &node_index);
+        MPI_Comm_free(&comm_leaders);
+    }
+    MPI_Bcast(&node_index, 1, MPI_INT, 0, comm_node);
+    MPI_Comm_free(&comm_node);
+
+    /* We need the same number of ranks on all nodes */
+    buf[0] = -nrank_node;
+    buf[1] =  nrank_node;
+    MPI_Allreduce(buf, nrank_node_minmax, 2, MPI_INT, MPI_MAX, comm_pp);
+    if (-nrank_node_minmax[0] != nrank_node_minmax[1])
+    {
+        if (fplog)
+        {
+            fprintf(fplog, "NOTE: Not using a node-blocked DD rank order, since the number of ranks per node is not uniform\n");
+        }
+        return -1;
+    }
+    nnodes = nrank_pp/nrank_node;
+    if (nnodes == 1)
+    {
+        return rank_pp;
+    }
+
+    /* Find the block shape with the minimal inter-node halo area */
+    ivec block     = { 0, 0, 0 };
+    int  area_best = -1;
+    for (int bx = 1; bx <= nc[XX]; bx++)
+    {
+        for (int by = 1; by <= nc[YY]; by++)
+        {
+            if (nrank_node % (bx*by) != 0)
+            {
+                continue;
+            }
+            ivec b = { bx, by, nrank_node/(bx*by) };
+            if (nc[XX] % b[XX] != 0 ||
+                nc[YY] % b[YY] != 0 ||
+                nc[ZZ] % b[ZZ] != 0)
+            {
+                continue;
+            }
+            int area = 0;
+            for (int d = 0; d < DIM; d++)
+            {
+                if (b[d] < nc[d])
+                {
+                    area += b[(d + 1) % DIM]*b[(d + 2) % DIM];
+                }
+            }
+            if (area_best < 0 || area < area_best)
+            {
+                copy_ivec(b, block);
+                area_best = area;
+            }
+        }
+    }
+    if (area_best < 0)
+    {
+        if (fplog)
+        {
+            fprintf(fplog, "NOTE: Not using a node-blocked DD rank order, since the DD grid %d x %d x %d can not be divided into blocks of %d cells\n",
+                    nc[XX], nc[YY], nc[ZZ], nrank_node);
+        }
+        return -1;
+    }
+    if (fplog)
+    {
+        fprintf(fplog, "Using a node-blocked DD rank order with blocks of %d x %d x %d cells per node\n",
+                block[XX], block[YY], block[ZZ]);
+    }
+
+    ivec nblock, node_ci, local_ci, ci;
+    for (int d = 0; d < DIM; d++)
+    {
+        nblock[d] = nc[d]/block[d];
+    }
+    ddindex2xyz(nblock, node_index, node_ci);
+    ddindex2xyz(block, rank_node, local_ci);
+    for (int d = 0; d < DIM; d++)
+    {
+        ci[d] = node_ci[d]*block[d] + local_ci[d];
+    }
+
+    return dd_index(nc, ci);
+}
+#endif
+
 static void make_pp_communicator(FILE                 *fplog,
                                  gmx_domdec_t         *dd,
                                  t_commrec gmx_unused *cr,
@@ -5597,6 +5773,40 @@ static void make_pp_communicator(FILE                 *fplog,
         /* We overwrite the old communicator with the new cartesian one */
         cr->mpi_comm_mygroup = comm_cart;
     }
+    else if (comm->bNodeBlockedPP)
+    {
+        int ddindex;
+
+        ddindex = dd_node_blocked_ddindex(fplog, dd->nc, cr->mpi_comm_mygroup,
+                                          gmx_physicalnode_id_hash());
+        if (ddindex >= 0)
+        {
+            MPI_Comm comm_blocked;
+            int      rank_blocked;
+
+            /* Renumber the ranks such that the rank equals the DD index.
+             * The simulation master keeps rank 0, since it is the first
+             * rank of the first node. So the rank that opened the log
+             * file remains the master.
+             */
+            MPI_Comm_split(cr->mpi_comm_mygroup, 0, ddindex, &comm_blocked);
+            MPI_Comm_rank(comm_blocked, &rank_blocked);
+            GMX_RELEASE_ASSERT(!MASTER(cr) || rank_blocked == 0, "The simulation master should keep rank 0 with node-blocked DD rank order");
+
+            /* Without separate PME ranks the PP communicator is the
+             * simulation communicator. We replace it, so we free the old
+             * one, unless it is the world communicator.
+             */
+            if (cr->mpi_comm_mysim != MPI_COMM_WORLD)
+            {
+                MPI_Comm_free(&cr->mpi_comm_mysim);
+            }
+            cr->mpi_comm_mygroup = comm_blocked;
+            cr->mpi_comm_mysim   = comm_blocked;
+            cr->nodeid           = rank_blocked;
+            cr->sim_nodeid       = rank_blocked;
+        }
+    }
 
     dd->mpi_comm_all = cr->mpi_comm_mygroup;
     MPI_Comm_rank(dd->mpi_comm_all, &dd->rank);
@@ -5913,6 +6123,15 @@ static void make_dd_communicators(FILE *fplog, t_commrec *cr,
     comm->bCartesianPP     = (dd_rank_order == ddrankorderCARTESIAN);
     comm->bCartesianPP_PME = FALSE;
 
+    if (comm->bNodeBlockedPP && (comm->bCartesianPP || cr->npmenodes > 0))
+    {
+        if (fplog)
+        {
+            fprintf(fplog, "NOTE: A node-blocked DD rank order is only supported without separate PME ranks and without a Cartesian rank order\n");
+        }
+        comm->bNodeBlockedPP = FALSE;
+    }
+
     /* Reorder the nodes by default. This might change the MPI ranks.
      * Real reordering is only supported on very few architectures,
      * Blue Gene is one of them.
@@ -7114,6 +7333,14 @@ static void set_dd_envvar_options(FILE *fplog, gmx_domdec_t *dd, int rank_mysim)
         fprintf(fplog, "Will use two sequential MPI_Sendrecv calls instead of two simultaneous non-blocking MPI_Irecv and MPI_Isend pairs for constraint and vsite communication\n");
     }
 
+    comm->bNodeBlockedPP = (dd_getenv(fplog, "GMX_DD_NODE_BLOCKS", 0) != 0);
+
+    comm->bRecursiveBisection = (dd_getenv(fplog, "GMX_DLB_RECURSIVE_BISECTION", 0) != 0);
+    if (comm->bRecursiveBisection && fplog)
+    {
+        fprintf(fplog, "Will set the dynamic load balancing cell boundaries by recursive bisection of the load\n");
+    }
+
     if (comm->eFlop)
     {
         if (fplog)
@@ -8634,51 +8861,59 @@ static int comp_cgsort(const void *a, const void *b)
     return comp;
 }
 
+/* The reordering functions below are threaded, since with large numbers
+ * of home atoms the gather and copy back of the state vectors at each
+ * repartitioning can take a significant amount of time.
+ */
 static void order_int_cg(int n, const gmx_cgsort_t *sort,
-                         int *a, int *buf)
+                         int *a, int *buf, int nthread)
 {
-    int i;
-
     /* Order the data */
-    for (i = 0; i < n; i++)
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (int i = 0; i < n; i++)
     {
+        // Trivial statement, does not throw
         buf[i] = a[sort[i].ind];
     }
 
     /* Copy back to the original array */
-    for (i = 0; i < n; i++)
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (int i = 0; i < n; i++)
     {
+        // Trivial statement, does not throw
         a[i] = buf[i];
     }
 }
 
 static void order_vec_cg(int n, const gmx_cgsort_t *sort,
-                         rvec *v, rvec *buf)
+                         rvec *v, rvec *buf, int nthread)
 {
-    int i;
-
     /* Order the data */
-    for (i = 0; i < n; i++)
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (int i = 0; i < n; i++)
     {
+        // Trivial statement, does not throw
         copy_rvec(v[sort[i].ind], buf[i]);
     }
 
     /* Copy back to the original array */
-    for (i = 0; i < n; i++)
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (int i = 0; i < n; i++)
     {
+        // Trivial statement, does not throw
         copy_rvec(buf[i], v[i]);
     }
 }
 
 static void order_vec_atom(int ncg, const int *cgindex, const gmx_cgsort_t *sort,
-                           rvec *v, rvec *buf)
+                           rvec *v, rvec *buf, int nthread)
 {
     int a, atot, cg, cg0, cg1, i;
 
     if (cgindex == nullptr)
     {
         /* Avoid the useless loop of the atoms within a cg */
-        order_vec_cg(ncg, sort, v, buf);
+        order_vec_cg(ncg, sort, v, buf, nthread);
 
         return;
     }
@@ -8698,8 +8933,10 @@ static void order_vec_atom(int ncg, const int *cgindex, const gmx_cgsort_t *sort
     atot = a;
 
     /* Copy back to the original array */
+#pragma omp parallel for num_threads(nthread) schedule(static)
     for (a = 0; a < atot; a++)
     {
+        // Trivial statement, does not throw
         copy_rvec(buf[a], v[a]);
     }
 }
@@ -8860,8 +9097,10 @@ static void dd_sort_state(gmx_domdec_t *dd, rvec *cgcm, t_forcerec *fr, t_state
     int               *cgindex;
     int                ncg_new, i, *ibuf, cgsize;
     rvec              *vbuf;
+    int                nthread;
 
-    sort = dd->comm->sort;
+    sort    = dd->comm->sort;
+    nthread = gmx_omp_nthreads_get(emntDomdec);
 
     if (dd->ncg_home > sort->sort_nalloc)
     {
@@ -8908,21 +9147,21 @@ static void dd_sort_state(gmx_domdec_t *dd, rvec *cgcm, t_forcerec *fr, t_state
     /* Reorder the state */
     if (state->flags & (1 << estX))
     {
-        order_vec_atom(dd->ncg_home, cgindex, cgsort, as_rvec_array(state->x.data()), vbuf);
+        order_vec_atom(dd->ncg_home, cgindex, cgsort, as_rvec_array(state->x.data()), vbuf, nthread);
     }
     if (state->flags & (1 << estV))
     {
-        order_vec_atom(dd->ncg_home, cgindex, cgsort, as_rvec_array(state->v.data()), vbuf);
+        order_vec_atom(dd->ncg_home, cgindex, cgsort, as_rvec_array(state->v.data()), vbuf, nthread);
     }
     if (state->flags & (1 << estCGP))
     {
-        order_vec_atom(dd->ncg_home, cgindex, cgsort, as_rvec_array(state->cg_p.data()), vbuf);
+        order_vec_atom(dd->ncg_home, cgindex, cgsort, as_rvec_array(state->cg_p.data()), vbuf, nthread);
     }
 
     if (fr->cutoff_scheme == ecutsGROUP)
     {
         /* Reorder cgcm */
-        order_vec_cg(dd->ncg_home, cgsort, cgcm, vbuf);
+        order_vec_cg(dd->ncg_home, cgsort, cgcm, vbuf, nthread);
     }
 
     if (dd->ncg_home+1 > sort->ibuf_nalloc)
@@ -8932,9 +9171,9 @@ static void dd_sort_state(gmx_domdec_t *dd, rvec *cgcm, t_forcerec *fr, t_state
     }
     ibuf = sort->ibuf;
     /* Reorder the global cg index */
-    order_int_cg(dd->ncg_home, cgsort, dd->index_gl, ibuf);
+    order_int_cg(dd->ncg_home, cgsort, dd->index_gl, ibuf, nthread);
     /* Reorder the cginfo */
-    order_int_cg(dd->ncg_home, cgsort, fr->cginfo, ibuf);
+    order_int_cg(dd->ncg_home, cgsort, fr->cginfo, ibuf, nthread);
     /* Rebuild the local cg index */
     if (dd->comm->bCGs)
     {
@@ -45,6 +45,8 @@
 
 #include "config.h"
 
+#include <cstdio>
+
 #include "gromacs/domdec/domdec.h"
 #include "gromacs/domdec/domdec_struct.h"
 #include "gromacs/mdtypes/commrec.h"
@@ -222,6 +224,7 @@ struct gmx_domdec_comm_t
 
     /* The DD particle-particle nodes only */
     gmx_bool bCartesianPP;        /**< Use a Cartesian communicator for PP */
+    gmx_bool bNodeBlockedPP;      /**< Assign blocks of DD cells to the ranks of each physical node */
     int     *ddindex2ddnodeid;    /**< The Cartesian index to DD rank conversion, used with bCartesianPP */
 
     /* The DLB state, used for reloading old states, during e.g. EM */
@@ -347,6 +350,8 @@ struct gmx_domdec_comm_t
 
     /** Maximum DLB scaling per load balancing step in percent */
     int dlb_scale_lim;
+    /** Use recursive bisection of the load for DLB instead of relaxed scaling */
+    gmx_bool bRecursiveBisection;
 
     /* Cycle counters */
     float  cycl[ddCyclNr];             /**< Total cycles counted */
@@ -412,6 +417,23 @@ real dd_cutoff_multibody(const gmx_domdec_t *dd);
 /*! \brief Returns the DD cut-off distance for two-body interactions */
 real dd_cutoff_twobody(const gmx_domdec_t *dd);
 
+#if GMX_MPI
+/*! \brief Returns the DD index for this rank with node-blocked rank order
+ *
+ * The DD grid \p nc is divided into equal blocks of cells, one block
+ * per physical node, such that the ranks on a node handle a compact
+ * super-domain. The block shape is chosen to minimize the area
+ * of the block faces that need halo communication with other nodes,
+ * so most halo communication happens within a node.
+ * \p node_id is a non-negative identifier of the physical node of this
+ * rank, nodes are numbered in the order of their lowest rank in
+ * \p comm_pp, so rank 0 gets DD index 0.
+ * Should be called by all ranks in \p comm_pp.
+ * Returns -1 when the ranks can not be assigned in this way.
+ */
+int dd_node_blocked_ddindex(FILE *fplog, const ivec nc, MPI_Comm comm_pp, int node_id);
+#endif
+
 /*! \endcond */
 
 #endif
@@ -0,0 +1,196 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Tests for the node-blocked DD rank order
+ *
+ * The tests emulate several physical nodes by passing node identifiers
+ * that differ between the thread-MPI ranks.
+ *
+ * \ingroup module_domdec
+ */
+#include "gmxpre.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/domdec/domdec_internal.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/utility/gmxmpi.h"
+
+#include "testutils/mpitest.h"
+
+namespace
+{
+
+//! The number of ranks all tests run with
+const int c_numRanks = 8;
+
+//! Returns the DD cell coordinates of \p ddindex in x-major order
+void ddIndexToCell(const ivec nc, int ddindex, ivec ci)
+{
+    ci[XX] = ddindex/(nc[YY]*nc[ZZ]);
+    ci[YY] = (ddindex/nc[ZZ]) % nc[YY];
+    ci[ZZ] = ddindex % nc[ZZ];
+}
+
+//! Returns the DD index of cell \p ci in x-major order
+int cellToDDIndex(const ivec nc, const ivec ci)
+{
+    return (ci[XX]*nc[YY] + ci[YY])*nc[ZZ] + ci[ZZ];
+}
+
+/*! \brief Checks the node-blocked order for DD grid \p nc with \p numNodes nodes
+ *
+ * With \p interleaved the ranks are assigned round-robin to the nodes,
+ * otherwise consecutive ranks share a node.
+ */
+void checkNodeBlockedOrder(const ivec nc, int numNodes, bool interleaved)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    const int numRanksPerNode = c_numRanks/numNodes;
+    const int nodeId          = (interleaved ? rank % numNodes : rank/numRanksPerNode);
+
+    const int ddindex = dd_node_blocked_ddindex(nullptr, nc, MPI_COMM_WORLD, nodeId);
+    ASSERT_GE(ddindex, 0);
+    ASSERT_LT(ddindex, c_numRanks);
+    if (rank == 0)
+    {
+        /* The simulation master has to stay the DD master */
+        EXPECT_EQ(0, ddindex);
+    }
+
+    /* Each DD cell is assigned to exactly one rank */
+    std::vector<int> count(c_numRanks, 0), countSum(c_numRanks);
+    count[ddindex] = 1;
+    MPI_Allreduce(count.data(), countSum.data(), c_numRanks, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    for (int i = 0; i < c_numRanks; i++)
+    {
+        EXPECT_EQ(1, countSum[i]) << "for DD index " << i;
+    }
+
+    /* The cells of each node form a block of as many cells as the node has ranks */
+    ivec ci;
+    ddIndexToCell(nc, ddindex, ci);
+    std::vector<int> bounds(numNodes*2*DIM, -c_numRanks), boundsMax(numNodes*2*DIM);
+    for (int d = 0; d < DIM; d++)
+    {
+        bounds[(nodeId*2 + 0)*DIM + d] = -ci[d];
+        bounds[(nodeId*2 + 1)*DIM + d] =  ci[d];
+    }
+    MPI_Allreduce(bounds.data(), boundsMax.data(), bounds.size(), MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    int blockVolume = 1;
+    for (int d = 0; d < DIM; d++)
+    {
+        blockVolume *= boundsMax[(nodeId*2 + 1)*DIM + d] + boundsMax[(nodeId*2 + 0)*DIM + d] + 1;
+    }
+    EXPECT_EQ(numRanksPerNode, blockVolume);
+
+    /* Renumber as make_pp_communicator() does. Without separate PME ranks,
+     * PME runs on the PP ranks and assigns its x-major slabs in rank order,
+     * which ddindex2pmeindex() assumes to be the DD index order.
+     */
+    MPI_Comm commBlocked;
+    int      rankBlocked;
+    MPI_Comm_split(MPI_COMM_WORLD, 0, ddindex, &commBlocked);
+    MPI_Comm_rank(commBlocked, &rankBlocked);
+    EXPECT_EQ(ddindex, rankBlocked);
+
+    /* The DD halo communication partners agree: sending our cell to the
+     * rank of the next cell along each dimension, we receive the cell
+     * before ours.
+     */
+    for (int d = 0; d < DIM; d++)
+    {
+        ivec ciForward, ciBackward;
+        copy_ivec(ci, ciForward);
+        copy_ivec(ci, ciBackward);
+        ciForward[d]  = (ci[d] + 1) % nc[d];
+        ciBackward[d] = (ci[d] - 1 + nc[d]) % nc[d];
+
+        ivec ciReceived;
+        MPI_Sendrecv(ci, DIM, MPI_INT, cellToDDIndex(nc, ciForward), 0,
+                     ciReceived, DIM, MPI_INT, cellToDDIndex(nc, ciBackward), 0,
+                     commBlocked, MPI_STATUS_IGNORE);
+        for (int e = 0; e < DIM; e++)
+        {
+            EXPECT_EQ(ciBackward[e], ciReceived[e]) << "along dimension " << d;
+        }
+    }
+
+    MPI_Comm_free(&commBlocked);
+}
+
+TEST(NodeBlockedDDOrderTest, ConsecutiveRanksPerNode)
+{
+    GMX_MPI_TEST(c_numRanks);
+    const ivec nc = { 2, 2, 2 };
+    checkNodeBlockedOrder(nc, 2, false);
+}
+
+TEST(NodeBlockedDDOrderTest, InterleavedRanksPerNode)
+{
+    GMX_MPI_TEST(c_numRanks);
+    const ivec nc = { 2, 2, 2 };
+    checkNodeBlockedOrder(nc, 2, true);
+}
+
+TEST(NodeBlockedDDOrderTest, BlocksSplitTheMajorDimension)
+{
+    GMX_MPI_TEST(c_numRanks);
+    /* The best block is 2 x 2 x 1 cells, so each node gets half of x */
+    const ivec nc = { 4, 2, 1 };
+    checkNodeBlockedOrder(nc, 2, true);
+}
+
+TEST(NodeBlockedDDOrderTest, FourNodes)
+{
+    GMX_MPI_TEST(c_numRanks);
+    const ivec nc = { 4, 2, 1 };
+    checkNodeBlockedOrder(nc, 4, false);
+}
+
+TEST(NodeBlockedDDOrderTest, RejectsNonUniformNodes)
+{
+    GMX_MPI_TEST(c_numRanks);
+    int        rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    const ivec nc = { 2, 2, 2 };
+    /* Five ranks on the first node and three on the second */
+    EXPECT_EQ(-1, dd_node_blocked_ddindex(nullptr, nc, MPI_COMM_WORLD, rank < 5 ? 0 : 1));
+}
+
+} // namespace
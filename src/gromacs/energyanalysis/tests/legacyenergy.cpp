@@ -44,15 +44,22 @@
 
 #include "gmxpre.h"
 
+#include <cmath>
 #include <cstring>
 
+#include <sstream>
 #include <string>
+#include <vector>
 
+#include "gromacs/fileio/enxio.h"
 #include "gromacs/gmxana/gmx_ana.h"
+#include "gromacs/utility/stringutil.h"
 
 #include "testutils/cmdlinetest.h"
+#include "testutils/refdata.h"
 #include "testutils/stdiohelper.h"
 #include "testutils/testasserts.h"
+#include "testutils/testfilemanager.h"
 #include "testutils/textblockmatchers.h"
 #include "testutils/xvgtest.h"
 
@@ -86,22 +93,169 @@ TEST_F(DhdlTest, ExtractDhdl)
     runTest();
 }
 
+//! The statistics of one energy term as printed by gmx energy
+struct EnergyStatistics
+{
+    std::string name;          //!< Name of the term
+    double      average;       //!< Average
+    std::string errorEstimate; //!< Error estimate, can be "--"
+    double      rmsd;          //!< RMSD
+    double      drift;         //!< Total drift
+};
+
+/*! \brief Returns the statistics table printed by gmx energy to stdout
+ *
+ * The table follows a line of dashes and ends with an empty line.
+ */
+std::vector<EnergyStatistics> parseStatistics(const std::string &output)
+{
+    std::vector<EnergyStatistics> statistics;
+    std::istringstream            stream(output);
+    std::string                   line;
+    bool                          bInTable = false;
+
+    while (std::getline(stream, line))
+    {
+        if (!bInTable)
+        {
+            bInTable = startsWith(line, "-----");
+            continue;
+        }
+        if (stripString(line).empty())
+        {
+            break;
+        }
+        /* The name is printed left aligned in 24 characters */
+        EnergyStatistics   s;
+        std::istringstream values(line.substr(24));
+        s.name = stripString(line.substr(0, 24));
+        values >> s.average >> s.errorEstimate >> s.rmsd >> s.drift;
+        statistics.push_back(s);
+    }
+
+    return statistics;
+}
+
+/*! \brief Copies energy file \p input to \p output without the sums over steps
+ *
+ * gmx energy then computes the statistics from the frames.
+ */
+void copyEnergyFileWithoutSums(const std::string &input, const std::string &output)
+{
+    ener_file_t  in   = open_enx(input.c_str(), "r");
+    ener_file_t  out  = open_enx(output.c_str(), "w");
+    int          nre  = 0;
+    gmx_enxnm_t *enm  = nullptr;
+    t_enxframe   fr;
+
+    do_enxnms(in, &nre, &enm);
+    do_enxnms(out, &nre, &enm);
+    init_enxframe(&fr);
+    while (do_enx(in, &fr))
+    {
+        fr.nsum = 0;
+        do_enx(out, &fr);
+    }
+    free_enxframe(&fr);
+    free_enxnms(nre, enm);
+    close_enx(in);
+    close_enx(out);
+}
+
 class EnergyTest : public CommandLineTestBase
 {
     public:
-        void runTest(const char *stringForStdin)
+        EnergyTest()
         {
-            auto &cmdline = commandLine();
-            cmdline.append("energy");
+            commandLine().append("energy");
+        }
 
+        /*! \brief Runs gmx energy and checks its output
+         *
+         * With \p checkStatistics the printed statistics are also
+         * checked against reference data.
+         */
+        void runTest(const char *stringForStdin, bool checkStatistics = false)
+        {
+            auto &cmdline = commandLine();
             setInputFile("-f", "ener.edr");
             setOutputFile("-o", "energy.xvg", XvgMatch());
 
+            std::vector<EnergyStatistics> statistics =
+                runAndParseStatistics(&cmdline, stringForStdin);
+
+            checkOutputFiles();
+            if (checkStatistics)
+            {
+                checkStatisticsAgainstReference(statistics);
+            }
+        }
+
+        //! Checks \p statistics against reference data
+        void checkStatisticsAgainstReference(const std::vector<EnergyStatistics> &statistics)
+        {
+            TestReferenceChecker checker(rootChecker().checkSequenceCompound("Statistics", statistics.size()));
+            checker.setDefaultTolerance(relativeToleranceAsFloatingPoint(1, 1e-5));
+            for (const auto &s : statistics)
+            {
+                TestReferenceChecker compound(checker.checkCompound("Term", nullptr));
+                compound.checkString(s.name, "Name");
+                compound.checkDouble(s.average, "Average");
+                compound.checkString(s.errorEstimate, "ErrorEstimate");
+                compound.checkDouble(s.rmsd, "RMSD");
+                compound.checkDouble(s.drift, "TotalDrift");
+            }
+        }
+
+        /*! \brief Checks that -stream gives the same statistics for \p energyFile
+         *
+         * The streamed statistics are also checked against reference data,
+         * as the error estimate uses different blocks with -stream.
+         */
+        void compareStreamingWithStoredFrames(const std::string &energyFile)
+        {
+            const char *const terms = "Potential\nKinetic-En.\nTotal-Energy\nTemperature\nPressure\n";
+
+            CommandLine       stored;
+            stored.append("energy");
+            stored.addOption("-f", energyFile);
+            CommandLine       streamed(stored);
+            stored.addOption("-o", fileManager().getTemporaryFilePath("stored.xvg"));
+            streamed.addOption("-o", fileManager().getTemporaryFilePath("streamed.xvg"));
+            streamed.addOption("-stream");
+
+            std::vector<EnergyStatistics> storedStatistics   = runAndParseStatistics(&stored, terms);
+            std::vector<EnergyStatistics> streamedStatistics = runAndParseStatistics(&streamed, terms);
+
+            /* The statistics are printed with 6 significant digits */
+            ASSERT_EQ(5, storedStatistics.size());
+            ASSERT_EQ(storedStatistics.size(), streamedStatistics.size());
+            for (size_t i = 0; i < storedStatistics.size(); i++)
+            {
+                const EnergyStatistics &a         = storedStatistics[i];
+                const EnergyStatistics &b         = streamedStatistics[i];
+                auto                    tolerance = relativeToleranceAsFloatingPoint(std::abs(a.average), 1e-5);
+
+                EXPECT_EQ(a.name, b.name);
+                EXPECT_DOUBLE_EQ_TOL(a.average, b.average, tolerance) << a.name;
+                EXPECT_DOUBLE_EQ_TOL(a.rmsd, b.rmsd, tolerance) << a.name;
+                EXPECT_DOUBLE_EQ_TOL(a.drift, b.drift, tolerance) << a.name;
+            }
+            checkStatisticsAgainstReference(streamedStatistics);
+        }
+
+        //! Runs gmx energy with \p cmdline and returns the statistics it prints
+        std::vector<EnergyStatistics> runAndParseStatistics(CommandLine *cmdline,
+                                                            const char  *stringForStdin)
+        {
             StdioTestHelper stdioHelper(&fileManager());
             stdioHelper.redirectStringToStdin(stringForStdin);
-            ASSERT_EQ(0, gmx_energy(cmdline.argc(), cmdline.argv()));
+            stdioHelper.redirectStdoutToFile();
+            int         returnValue = gmx_energy(cmdline->argc(), cmdline->argv());
+            std::string output      = stdioHelper.readStdout();
+            EXPECT_EQ(0, returnValue);
 
-            checkOutputFiles();
+            return parseStatistics(output);
         }
 };
 
@@ -120,6 +274,24 @@ TEST_F(EnergyTest, ExtractEnergyMixed)
     runTest("Pressu\n7\nbox-z\nvol\n");
 }
 
+TEST_F(EnergyTest, ExtractEnergyStreaming)
+{
+    commandLine().addOption("-stream");
+    runTest("Potential\nKinetic-En.\nTotal-Energy\n", true);
+}
+
+TEST_F(EnergyTest, StreamingMatchesStoredFramesWithSums)
+{
+    compareStreamingWithStoredFrames(TestFileManager::getInputFilePath("ener.edr"));
+}
+
+TEST_F(EnergyTest, StreamingMatchesStoredFramesWithoutSums)
+{
+    std::string energyFile = fileManager().getTemporaryFilePath("nosums.edr");
+    copyEnergyFileWithoutSums(TestFileManager::getInputFilePath("ener.edr"), energyFile);
+    compareStreamingWithStoredFrames(energyFile);
+}
+
 class ViscosityTest : public CommandLineTestBase
 {
     public:
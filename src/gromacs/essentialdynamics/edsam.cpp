@@ -42,18 +42,23 @@
 #include <string.h>
 #include <time.h>
 
+#include <algorithm>
+
 #include "gromacs/commandline/filenm.h"
 #include "gromacs/domdec/domdec_struct.h"
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/fileio/xvgr.h"
 #include "gromacs/gmxlib/network.h"
 #include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/linearalgebra/gmx_blas.h"
 #include "gromacs/linearalgebra/nrjac.h"
 #include "gromacs/math/functions.h"
 #include "gromacs/math/utilities.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/math/vectypes.h"
 #include "gromacs/mdlib/broadcaststructs.h"
+#include "gromacs/mdlib/cvreduce.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
 #include "gromacs/mdlib/groupcoord.h"
 #include "gromacs/mdlib/mdrun.h"
 #include "gromacs/mdlib/sim_util.h"
@@ -67,6 +72,7 @@
 #include "gromacs/topology/mtop_lookup.h"
 #include "gromacs/topology/topology.h"
 #include "gromacs/utility/cstringutil.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/gmxassert.h"
 #include "gromacs/utility/smalloc.h"
@@ -88,7 +94,9 @@ typedef struct
     int     neig;    /* nr of eigenvectors             */
     int    *ieig;    /* index nrs of eigenvectors      */
     real   *stpsz;   /* stepsizes (per eigenvector)    */
-    rvec  **vec;     /* eigenvector components         */
+    rvec  **vec;     /* eigenvector components, vec[i] points into
+                      * one contiguous neig x nr block starting
+                      * at vec[0], used as a matrix for BLAS      */
     real   *xproj;   /* instantaneous x projections    */
     real   *fproj;   /* instantaneous f projections    */
     real    radius;  /* instantaneous radius           */
@@ -190,6 +198,7 @@ typedef struct gmx_edsam
     FILE          *edo;           /* output file pointer                  */
     t_edpar       *edpar;
     gmx_bool       bFirst;
+    gmx_cvreduce_t *cvr;          /* For fusing the global sums of positions */
 } t_gmx_edsam;
 
 
@@ -207,6 +216,8 @@ struct t_do_edsam
     ivec    *extra_shifts_xcoll;  /* xcoll shift changes since last NS step */
     ivec    *shifts_xc_ref;       /* Shifts for xc_ref */
     ivec    *extra_shifts_xc_ref; /* xc_ref shift changes since last NS step */
+    gmx_group_gather_t *xcoll_gather;  /* For collecting xcoll by all-gather */
+    gmx_group_gather_t *xc_ref_gather; /* For collecting xc_ref by all-gather */
     gmx_bool bUpdateShifts;       /* TRUE in NS steps to indicate that the
                                      ED shifts for this ED group need to
                                      be updated */
@@ -220,6 +231,7 @@ struct t_ed_buffer
     struct t_do_edfit *             do_edfit;
     struct t_do_edsam *             do_edsam;
     struct t_do_radcon *            do_radcon;
+    struct t_ed_gemv *              ed_gemv;
 };
 
 
@@ -275,7 +287,8 @@ static char get_EDgroupChar(int nr_edi, int nED)
 
 
 /* Does not subtract average positions, projection on single eigenvector is returned
- * used by: do_linfix, do_linacc, do_radfix, do_radacc, do_radcon
+ * used by: do_linfix, do_linacc, where each correction changes the positions
+ * that the next eigenvector is projected on.
  * Average position is subtracted in ed_apply_constraints prior to calling projectx
  */
 static real projectx(t_edpar *edi, rvec *xcoll, rvec *vec)
@@ -293,66 +306,178 @@ static real projectx(t_edpar *edi, rvec *xcoll, rvec *vec)
 }
 
 
-/* Specialized: projection is stored in vec->refproj
- * -> used for radacc, radfix, radcon  and center of flooding potential
- * subtracts average positions, projects vector x */
-static void rad_project(t_edpar *edi, rvec *x, t_eigvec *vec)
+/* Allocates the components of all eigenvectors of tvec as one contiguous
+ * block, such that the eigenvectors form a (column-major) nr*DIM x neig
+ * matrix starting at tvec->vec[0], which can be passed to BLAS */
+static void alloc_eigvec_components(t_eigvec *tvec, int nr)
 {
-    int  i;
-    real rad = 0.0;
+    if (tvec->neig == 0)
+    {
+        return;
+    }
 
-    /* Subtract average positions */
-    for (i = 0; i < edi->sav.nr; i++)
+    snew(tvec->vec[0], tvec->neig*nr);
+    for (int i = 1; i < tvec->neig; i++)
     {
-        rvec_dec(x[i], edi->sav.x[i]);
+        tvec->vec[i] = tvec->vec[0] + i*nr;
     }
+}
 
-    for (i = 0; i < vec->neig; i++)
+
+/* Calls the real-precision BLAS matrix-vector product y = alpha*op(a)*x + beta*y */
+static void ed_gemv(const char *trans, int m, int n, real alpha, rvec *a, int lda,
+                    real *x, real beta, real *y)
+{
+    int inc = 1;
+
+#if GMX_DOUBLE
+    F77_FUNC(dgemv, DGEMV) (trans, &m, &n, &alpha, a[0], &lda, x, &inc, &beta, y, &inc);
+#else
+    F77_FUNC(sgemv, SGEMV) (trans, &m, &n, &alpha, a[0], &lda, x, &inc, &beta, y, &inc);
+#endif
+}
+
+
+struct t_ed_gemv {
+    rvec *xmw;         /* Mass-weighted positions to project              */
+    rvec *fcoll;       /* Collective flooding forces for all ED atoms     */
+};
+
+/* Returns the buffer for the mass-weighted positions, which is allocated
+ * the first time this routine is called for each edi group */
+static rvec *get_xmw_buffer(t_edpar *edi)
+{
+    if (nullptr == edi->buf->ed_gemv)
     {
-        vec->refproj[i] = projectx(edi, x, vec->vec[i]);
-        rad            += gmx::square((vec->refproj[i]-vec->xproj[i]));
+        snew(edi->buf->ed_gemv, 1);
+    }
+    if (nullptr == edi->buf->ed_gemv->xmw)
+    {
+        snew(edi->buf->ed_gemv->xmw, edi->sav.nr);
     }
-    vec->radius = sqrt(rad);
 
-    /* Add average positions */
-    for (i = 0; i < edi->sav.nr; i++)
+    return edi->buf->ed_gemv->xmw;
+}
+
+
+/* Returns the mass-weighted positions sqrt(m_i)*(x_i - <x_i>), the average
+ * positions are only subtracted when bSubtractAverage is set. The positions
+ * x themselves are not changed. */
+static rvec *mass_weight_positions(t_edpar *edi, rvec *x, gmx_bool bSubtractAverage)
+{
+    rvec *xmw = get_xmw_buffer(edi);
+    int   nth = gmx_omp_nthreads_get(emntDefault);
+
+#pragma omp parallel for num_threads(nth) schedule(static)
+    for (int i = 0; i < edi->sav.nr; i++)
     {
-        rvec_inc(x[i], edi->sav.x[i]);
+        // Trivial OpenMP region that cannot throw
+        if (bSubtractAverage)
+        {
+            rvec_sub(x[i], edi->sav.x[i], xmw[i]);
+        }
+        else
+        {
+            copy_rvec(x[i], xmw[i]);
+        }
+        svmul(edi->sav.sqrtm[i], xmw[i], xmw[i]);
     }
+
+    return xmw;
 }
 
 
-/* Project vector x, subtract average positions prior to projection and add
- * them afterwards to retain the unchanged vector. Store in xproj. Mass-weighting
- * is applied. */
-static void project_to_eigvectors(rvec       *x,    /* The positions to project to an eigenvector */
-                                  t_eigvec   *vec,  /* The eigenvectors */
-                                  t_edpar    *edi)
+/* Projects the mass-weighted positions xmw onto all eigenvectors of vec at
+ * once. With the eigenvectors stored as one matrix this is a single
+ * transposed matrix-vector product, which is threaded over blocks of
+ * eigenvectors. */
+static void project_mass_weighted(t_edpar *edi, rvec *xmw, t_eigvec *vec, real *proj)
 {
-    int  i;
+    int ncomp = edi->sav.nr*DIM;
+    int nth   = std::min(gmx_omp_nthreads_get(emntDefault), vec->neig);
 
+    if (vec->neig == 0)
+    {
+        return;
+    }
 
-    if (!vec->neig)
+#pragma omp parallel for num_threads(nth) schedule(static)
+    for (int th = 0; th < nth; th++)
+    {
+        try
+        {
+            int e0 = (vec->neig*th)/nth;
+            int e1 = (vec->neig*(th + 1))/nth;
+
+            ed_gemv("T", ncomp, e1 - e0, 1, vec->vec[e0], ncomp, xmw[0], 0, proj + e0);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+}
+
+
+/* Adds the linear combination sum_i coeff[i]*vec[i] of all eigenvectors of vec
+ * to the collective positions x, as a matrix-vector product threaded over
+ * blocks of atoms */
+static void add_eigvec_combination(t_edpar *edi, t_eigvec *vec, real *coeff, rvec *x)
+{
+    int nr    = edi->sav.nr;
+    int ncomp = nr*DIM;
+    int nth   = gmx_omp_nthreads_get(emntDefault);
+
+    if (vec->neig == 0)
     {
         return;
     }
 
-    /* Subtract average positions */
-    for (i = 0; i < edi->sav.nr; i++)
+#pragma omp parallel for num_threads(nth) schedule(static)
+    for (int th = 0; th < nth; th++)
     {
-        rvec_dec(x[i], edi->sav.x[i]);
+        try
+        {
+            int a0 = (nr*th)/nth;
+            int a1 = (nr*(th + 1))/nth;
+
+            ed_gemv("N", (a1 - a0)*DIM, vec->neig, 1, vec->vec[0] + a0, ncomp, coeff, 1, x[a0]);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+}
+
+
+/* Specialized: projection is stored in vec->refproj
+ * -> used for radacc, radfix, radcon  and center of flooding potential
+ * subtracts average positions, projects vector x */
+static void rad_project(t_edpar *edi, rvec *x, t_eigvec *vec)
+{
+    int  i;
+    real rad = 0.0;
+
+    if (vec->neig > 0)
+    {
+        project_mass_weighted(edi, mass_weight_positions(edi, x, TRUE), vec, vec->refproj);
     }
 
     for (i = 0; i < vec->neig; i++)
     {
-        vec->xproj[i] = projectx(edi, x, vec->vec[i]);
+        rad += gmx::square((vec->refproj[i]-vec->xproj[i]));
     }
+    vec->radius = sqrt(rad);
+}
 
-    /* Add average positions */
-    for (i = 0; i < edi->sav.nr; i++)
+
+/* Project vector x, subtract average positions prior to projection, x itself
+ * is not changed. Store in xproj. Mass-weighting is applied. */
+static void project_to_eigvectors(rvec       *x,    /* The positions to project to an eigenvector */
+                                  t_eigvec   *vec,  /* The eigenvectors */
+                                  t_edpar    *edi)
+{
+    if (!vec->neig)
     {
-        rvec_inc(x[i], edi->sav.x[i]);
+        return;
     }
+
+    project_mass_weighted(edi, mass_weight_positions(edi, x, TRUE), vec, vec->xproj);
 }
 
 
@@ -360,14 +485,24 @@ static void project_to_eigvectors(rvec       *x,    /* The positions to project
 static void project(rvec      *x,     /* positions to project */
                     t_edpar   *edi)   /* edi data set */
 {
-    /* It is not more work to subtract the average position in every
-     * subroutine again, because these routines are rarely used simultaneously */
-    project_to_eigvectors(x, &edi->vecs.mon, edi);
-    project_to_eigvectors(x, &edi->vecs.linfix, edi);
-    project_to_eigvectors(x, &edi->vecs.linacc, edi);
-    project_to_eigvectors(x, &edi->vecs.radfix, edi);
-    project_to_eigvectors(x, &edi->vecs.radacc, edi);
-    project_to_eigvectors(x, &edi->vecs.radcon, edi);
+    rvec *xmw;
+
+
+    if (!bNeedDoEdsam(edi))
+    {
+        return;
+    }
+
+    /* The mass-weighted, average-subtracted positions are the same for all
+     * vector sets, so we only compute them once */
+    xmw = mass_weight_positions(edi, x, TRUE);
+
+    project_mass_weighted(edi, xmw, &edi->vecs.mon, edi->vecs.mon.xproj);
+    project_mass_weighted(edi, xmw, &edi->vecs.linfix, edi->vecs.linfix.xproj);
+    project_mass_weighted(edi, xmw, &edi->vecs.linacc, edi->vecs.linacc.xproj);
+    project_mass_weighted(edi, xmw, &edi->vecs.radfix, edi->vecs.radfix.xproj);
+    project_mass_weighted(edi, xmw, &edi->vecs.radacc, edi->vecs.radacc.xproj);
+    project_mass_weighted(edi, xmw, &edi->vecs.radcon, edi->vecs.radcon.xproj);
 }
 
 
@@ -907,32 +1042,70 @@ static void flood_blowup(t_edpar *edi, rvec *forces_cart)
        field forces_cart prior the computation, but we compute the forces separately
        to have them accessible for diagnostics
      */
-    int   j, eig;
-    rvec  dum;
-    real *forces_sub;
+    int       nr    = edi->sav.nr;
+    int       ncomp = nr*DIM;
+    int       nth   = gmx_omp_nthreads_get(emntDefault);
+    t_eigvec *vecs  = &edi->flood.vecs;
+    real     *forces_sub;
 
 
-    forces_sub = edi->flood.vecs.fproj;
+    forces_sub = vecs->fproj;
 
+    if (edi->sav.nr_loc == nr)
+    {
+        /* All ED atoms are local, so we can compute the forces on all of
+         * them as one matrix-vector product over the eigenvector matrix
+         * and then copy them into the local order */
+        rvec *fcoll;
 
-    /* Calculate the cartesian forces for the local atoms */
+        if (nullptr == edi->buf->ed_gemv)
+        {
+            snew(edi->buf->ed_gemv, 1);
+        }
+        if (nullptr == edi->buf->ed_gemv->fcoll)
+        {
+            snew(edi->buf->ed_gemv->fcoll, nr);
+        }
+        fcoll = edi->buf->ed_gemv->fcoll;
 
-    /* Clear forces first */
-    for (j = 0; j < edi->sav.nr_loc; j++)
-    {
-        clear_rvec(forces_cart[j]);
-    }
+#pragma omp parallel for num_threads(nth) schedule(static)
+        for (int th = 0; th < nth; th++)
+        {
+            try
+            {
+                int a0 = (nr*th)/nth;
+                int a1 = (nr*(th + 1))/nth;
 
-    /* Now compute atomwise */
-    for (j = 0; j < edi->sav.nr_loc; j++)
+                ed_gemv("N", (a1 - a0)*DIM, vecs->neig, 1, vecs->vec[0] + a0, ncomp, forces_sub, 0, fcoll[a0]);
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+        }
+
+#pragma omp parallel for num_threads(nth) schedule(static)
+        for (int j = 0; j < nr; j++)
+        {
+            // Trivial OpenMP region that cannot throw
+            copy_rvec(fcoll[edi->sav.c_ind[j]], forces_cart[j]);
+        }
+    }
+    else
     {
-        /* Compute forces_cart[edi->sav.anrs[j]] */
-        for (eig = 0; eig < edi->flood.vecs.neig; eig++)
+        /* Calculate the cartesian forces for the local atoms only */
+#pragma omp parallel for num_threads(nth) schedule(static)
+        for (int j = 0; j < edi->sav.nr_loc; j++)
         {
-            /* Force vector is force * eigenvector (compute only atom j) */
-            svmul(forces_sub[eig], edi->flood.vecs.vec[eig][edi->sav.c_ind[j]], dum);
-            /* Add this vector to the cartesian forces */
-            rvec_inc(forces_cart[j], dum);
+            // Trivial OpenMP region that cannot throw
+            rvec dum;
+
+            clear_rvec(forces_cart[j]);
+            /* Compute forces_cart[edi->sav.anrs[j]] */
+            for (int eig = 0; eig < vecs->neig; eig++)
+            {
+                /* Force vector is force * eigenvector (compute only atom j) */
+                svmul(forces_sub[eig], vecs->vec[eig][edi->sav.c_ind[j]], dum);
+                /* Add this vector to the cartesian forces */
+                rvec_inc(forces_cart[j], dum);
+            }
         }
     }
 }
@@ -961,7 +1134,6 @@ static void update_adaption(t_edpar *edi)
 
 static void do_single_flood(
         FILE           *edo,
-        rvec            x[],
         rvec            force[],
         t_edpar        *edi,
         gmx_int64_t     step,
@@ -980,17 +1152,16 @@ static void do_single_flood(
     buf = edi->buf->do_edsam;
 
 
-    /* Broadcast the positions of the AVERAGE structure such that they are known on
-     * every processor. Each node contributes its local positions x and stores them in
-     * the collective ED array buf->xcoll */
-    communicate_group_positions(cr, buf->xcoll, buf->shifts_xcoll, buf->extra_shifts_xcoll, bNS, x,
-                                edi->sav.nr, edi->sav.nr_loc, edi->sav.anrs_loc, edi->sav.c_ind, edi->sav.x_old, box);
+    /* The local positions of the AVERAGE structure have been summed over
+     * the nodes in buf->xcoll, see do_flood_local(), now make them whole */
+    communicate_group_positions_finish(buf->xcoll, buf->shifts_xcoll, buf->extra_shifts_xcoll, bNS,
+                                       edi->sav.nr, edi->sav.x_old, box);
 
     /* Only assembly REFERENCE positions if their indices differ from the average ones */
     if (!edi->bRefEqAv)
     {
-        communicate_group_positions(cr, buf->xc_ref, buf->shifts_xc_ref, buf->extra_shifts_xc_ref, bNS, x,
-                                    edi->sref.nr, edi->sref.nr_loc, edi->sref.anrs_loc, edi->sref.c_ind, edi->sref.x_old, box);
+        communicate_group_positions_finish(buf->xc_ref, buf->shifts_xc_ref, buf->extra_shifts_xc_ref, bNS,
+                                           edi->sref.nr, edi->sref.x_old, box);
     }
 
     /* If bUpdateShifts was TRUE, the shifts have just been updated in get_positions.
@@ -1063,10 +1234,42 @@ static void do_single_flood(
 }
 
 
+/* Register the local flooding positions for summation, called from do_force */
+extern void do_flood_local(gmx_cvreduce_t *cvr,
+                           rvec            x[],
+                           gmx_edsam_t     ed)
+{
+    t_edpar *edi;
+
+
+    if (ed->eEDtype != eEDflood)
+    {
+        return;
+    }
+
+    for (edi = ed->edpar; edi != nullptr; edi = edi->next_edi)
+    {
+        if (edi->flood.vecs.neig)
+        {
+            struct t_do_edsam *buf = edi->buf->do_edsam;
+
+            /* Each node contributes its local positions x to the collective
+             * ED arrays of the AVERAGE and REFERENCE structures. */
+            communicate_group_positions_start(cvr, buf->xcoll_gather, buf->xcoll, x,
+                                              edi->sav.nr, edi->sav.nr_loc, edi->sav.anrs_loc, edi->sav.c_ind);
+            if (!edi->bRefEqAv)
+            {
+                communicate_group_positions_start(cvr, buf->xc_ref_gather, buf->xc_ref, x,
+                                                  edi->sref.nr, edi->sref.nr_loc, edi->sref.anrs_loc, edi->sref.c_ind);
+            }
+        }
+    }
+}
+
+
 /* Main flooding routine, called from do_force */
 extern void do_flood(t_commrec        *cr,
                      const t_inputrec *ir,
-                     rvec              x[],
                      rvec              force[],
                      gmx_edsam_t       ed,
                      matrix            box,
@@ -1095,7 +1298,7 @@ extern void do_flood(t_commrec        *cr,
         /* Call flooding for one matrix */
         if (edi->flood.vecs.neig)
         {
-            do_single_flood(ed->edo, x, force, edi, step, box, cr, bNS);
+            do_single_flood(ed->edo, force, edi, step, box, cr, bNS);
         }
         edi = edi->next_edi;
     }
@@ -1190,6 +1393,7 @@ gmx_edsam_t ed_open(int natoms, ObservablesHistory *oh, int nfile, const t_filen
 
     /* Allocate space for the ED data structure */
     snew(ed, 1);
+    ed->cvr = init_cvreduce();
 
     /* We want to perform ED (this switch might later be upgraded to eEDflood) */
     ed->eEDtype = eEDedsam;
@@ -1283,8 +1487,6 @@ static void bc_ed_positions(t_commrec *cr, struct gmx_edx *s, int stype)
 /* Broadcasts the eigenvector data */
 static void bc_ed_vecs(t_commrec *cr, t_eigvec *ev, int length, gmx_bool bHarmonic)
 {
-    int i;
-
     snew_bc(cr, ev->ieig, ev->neig);     /* index numbers of eigenvector  */
     snew_bc(cr, ev->stpsz, ev->neig);    /* stepsizes per eigenvector     */
     snew_bc(cr, ev->xproj, ev->neig);    /* instantaneous x projection    */
@@ -1298,10 +1500,13 @@ static void bc_ed_vecs(t_commrec *cr, t_eigvec *ev, int length, gmx_bool bHarmon
     nblock_bc(cr, ev->neig, ev->refproj);
 
     snew_bc(cr, ev->vec, ev->neig);      /* Eigenvector components        */
-    for (i = 0; i < ev->neig; i++)
+    if (!MASTER(cr))
     {
-        snew_bc(cr, ev->vec[i], length);
-        nblock_bc(cr, length, ev->vec[i]);
+        alloc_eigvec_components(ev, length);
+    }
+    if (ev->neig > 0)
+    {
+        nblock_bc(cr, ev->neig*length, ev->vec[0]);
     }
 
     /* For harmonic restraints the reference projections can change with time */
@@ -1603,9 +1808,9 @@ static void read_edvec(FILE *in, int nr, t_eigvec *tvec, gmx_bool bReadRefproj,
             tvec->stpsz[i] = rdum;
         } /* end of loop over eigenvectors */
 
+        alloc_eigvec_components(tvec, nr);
         for (i = 0; (i < tvec->neig); i++)
         {
-            snew(tvec->vec[i], nr);
             scan_edvec(in, nr, tvec->vec[i]);
         }
     }
@@ -1928,6 +2133,9 @@ void dd_make_local_ed_indices(gmx_domdec_t *dd, struct gmx_edsam *ed)
             dd_make_local_group_indices(dd->ga2la, edi->sav.nr, edi->sav.anrs,
                                         &edi->sav.nr_loc, &edi->sav.anrs_loc, &edi->sav.nalloc_loc, edi->sav.c_ind);
 
+            group_gather_local_changed(edi->buf->do_edsam->xcoll_gather);
+            group_gather_local_changed(edi->buf->do_edsam->xc_ref_gather);
+
             /* Indicate that the ED shift vectors for this structure need to be updated
              * at the next call to communicate_group_positions, since obviously we are in a NS step */
             edi->buf->do_edsam->bUpdateShifts = TRUE;
@@ -2036,9 +2244,8 @@ static void do_linacc(rvec *xcoll, t_edpar *edi)
 
 static void do_radfix(rvec *xcoll, t_edpar *edi)
 {
-    int   i, j;
+    int   i;
     real *proj, rad = 0.0, ratio;
-    rvec  vec_dum;
 
 
     if (edi->vecs.radfix.neig == 0)
@@ -2048,11 +2255,13 @@ static void do_radfix(rvec *xcoll, t_edpar *edi)
 
     snew(proj, edi->vecs.radfix.neig);
 
+    /* calculate the projections on all radfix vectors at once */
+    project_mass_weighted(edi, mass_weight_positions(edi, xcoll, FALSE), &edi->vecs.radfix, proj);
+
     /* loop over radfix vectors */
     for (i = 0; i < edi->vecs.radfix.neig; i++)
     {
-        /* calculate the projections, radius */
-        proj[i] = projectx(edi, xcoll, edi->vecs.radfix.vec[i]);
+        /* calculate the radius */
         rad    += gmx::square(proj[i] - edi->vecs.radfix.refproj[i]);
     }
 
@@ -2068,12 +2277,8 @@ static void do_radfix(rvec *xcoll, t_edpar *edi)
         /* apply the correction */
         proj[i] /= edi->sav.sqrtm[i];
         proj[i] *= ratio;
-        for (j = 0; j < edi->sav.nr; j++)
-        {
-            svmul(proj[i], edi->vecs.radfix.vec[i][j], vec_dum);
-            rvec_inc(xcoll[j], vec_dum);
-        }
     }
+    add_eigvec_combination(edi, &edi->vecs.radfix, proj, xcoll);
 
     sfree(proj);
 }
@@ -2081,9 +2286,8 @@ static void do_radfix(rvec *xcoll, t_edpar *edi)
 
 static void do_radacc(rvec *xcoll, t_edpar *edi)
 {
-    int   i, j;
+    int   i;
     real *proj, rad = 0.0, ratio = 0.0;
-    rvec  vec_dum;
 
 
     if (edi->vecs.radacc.neig == 0)
@@ -2093,11 +2297,13 @@ static void do_radacc(rvec *xcoll, t_edpar *edi)
 
     snew(proj, edi->vecs.radacc.neig);
 
+    /* calculate the projections on all radacc vectors at once */
+    project_mass_weighted(edi, mass_weight_positions(edi, xcoll, FALSE), &edi->vecs.radacc, proj);
+
     /* loop over radacc vectors */
     for (i = 0; i < edi->vecs.radacc.neig; i++)
     {
-        /* calculate the projections, radius */
-        proj[i] = projectx(edi, xcoll, edi->vecs.radacc.vec[i]);
+        /* calculate the radius */
         rad    += gmx::square(proj[i] - edi->vecs.radacc.refproj[i]);
     }
     rad = sqrt(rad);
@@ -2120,12 +2326,8 @@ static void do_radacc(rvec *xcoll, t_edpar *edi)
         /* apply the correction */
         proj[i] /= edi->sav.sqrtm[i];
         proj[i] *= ratio;
-        for (j = 0; j < edi->sav.nr; j++)
-        {
-            svmul(proj[i], edi->vecs.radacc.vec[i][j], vec_dum);
-            rvec_inc(xcoll[j], vec_dum);
-        }
     }
+    add_eigvec_combination(edi, &edi->vecs.radacc, proj, xcoll);
     sfree(proj);
 }
 
@@ -2136,11 +2338,10 @@ struct t_do_radcon {
 
 static void do_radcon(rvec *xcoll, t_edpar *edi)
 {
-    int                 i, j;
+    int                 i;
     real                rad = 0.0, ratio = 0.0;
     struct t_do_radcon *loc;
     gmx_bool            bFirst;
-    rvec                vec_dum;
 
 
     if (edi->buf->do_radcon != nullptr)
@@ -2164,11 +2365,13 @@ static void do_radcon(rvec *xcoll, t_edpar *edi)
         snew(loc->proj, edi->vecs.radcon.neig);
     }
 
+    /* calculate the projections on all radcon vectors at once */
+    project_mass_weighted(edi, mass_weight_positions(edi, xcoll, FALSE), &edi->vecs.radcon, loc->proj);
+
     /* loop over radcon vectors */
     for (i = 0; i < edi->vecs.radcon.neig; i++)
     {
-        /* calculate the projections, radius */
-        loc->proj[i] = projectx(edi, xcoll, edi->vecs.radcon.vec[i]);
+        /* calculate the radius */
         rad         += gmx::square(loc->proj[i] - edi->vecs.radcon.refproj[i]);
     }
     rad = sqrt(rad);
@@ -2184,13 +2387,8 @@ static void do_radcon(rvec *xcoll, t_edpar *edi)
             loc->proj[i] -= edi->vecs.radcon.refproj[i];
             loc->proj[i] /= edi->sav.sqrtm[i];
             loc->proj[i] *= ratio;
-
-            for (j = 0; j < edi->sav.nr; j++)
-            {
-                svmul(loc->proj[i], edi->vecs.radcon.vec[i][j], vec_dum);
-                rvec_inc(xcoll[j], vec_dum);
-            }
         }
+        add_eigvec_combination(edi, &edi->vecs.radcon, loc->proj, xcoll);
 
     }
     else
@@ -2971,12 +3169,14 @@ void init_edsam(const gmx_mtop_t *mtop,
         snew(edi->buf->do_edsam->xcoll, edi->sav.nr);
         snew(edi->buf->do_edsam->shifts_xcoll, edi->sav.nr);            /* buffer for xcoll shifts */
         snew(edi->buf->do_edsam->extra_shifts_xcoll, edi->sav.nr);
+        edi->buf->do_edsam->xcoll_gather = init_group_gather(cr, edi->sav.nr);
         /* Collective positions of atoms with the reference indices */
         if (!edi->bRefEqAv)
         {
             snew(edi->buf->do_edsam->xc_ref, edi->sref.nr);
             snew(edi->buf->do_edsam->shifts_xc_ref, edi->sref.nr);       /* To store the shifts in */
             snew(edi->buf->do_edsam->extra_shifts_xc_ref, edi->sref.nr);
+            edi->buf->do_edsam->xc_ref_gather = init_group_gather(cr, edi->sref.nr);
         }
 
         /* Get memory for flooding forces */
@@ -3052,14 +3252,25 @@ void do_edsam(const t_inputrec *ir,
              * the collective buf->xcoll array. Note that for edinr > 1
              * xs could already have been modified by an earlier ED */
 
-            communicate_group_positions(cr, buf->xcoll, buf->shifts_xcoll, buf->extra_shifts_xcoll, PAR(cr) ? buf->bUpdateShifts : TRUE, xs,
-                                        edi->sav.nr, edi->sav.nr_loc, edi->sav.anrs_loc, edi->sav.c_ind, edi->sav.x_old,  box);
+            communicate_group_positions_start(ed->cvr, buf->xcoll_gather, buf->xcoll, xs,
+                                              edi->sav.nr, edi->sav.nr_loc, edi->sav.anrs_loc, edi->sav.c_ind);
 
             /* Only assembly reference positions if their indices differ from the average ones */
             if (!edi->bRefEqAv)
             {
-                communicate_group_positions(cr, buf->xc_ref, buf->shifts_xc_ref, buf->extra_shifts_xc_ref, PAR(cr) ? buf->bUpdateShifts : TRUE, xs,
-                                            edi->sref.nr, edi->sref.nr_loc, edi->sref.anrs_loc, edi->sref.c_ind, edi->sref.x_old, box);
+                communicate_group_positions_start(ed->cvr, buf->xc_ref_gather, buf->xc_ref, xs,
+                                                  edi->sref.nr, edi->sref.nr_loc, edi->sref.anrs_loc, edi->sref.c_ind);
+            }
+
+            /* Sum the average and reference positions with one collective call */
+            cvreduce_sum(ed->cvr, cr);
+
+            communicate_group_positions_finish(buf->xcoll, buf->shifts_xcoll, buf->extra_shifts_xcoll, PAR(cr) ? buf->bUpdateShifts : TRUE,
+                                               edi->sav.nr, edi->sav.x_old, box);
+            if (!edi->bRefEqAv)
+            {
+                communicate_group_positions_finish(buf->xc_ref, buf->shifts_xc_ref, buf->extra_shifts_xc_ref, PAR(cr) ? buf->bUpdateShifts : TRUE,
+                                                   edi->sref.nr, edi->sref.x_old, box);
             }
 
             /* If bUpdateShifts was TRUE then the shifts have just been updated in communicate_group_positions.
@@ -3190,6 +3401,15 @@ void done_ed(gmx_edsam_t *ed)
          * gmx_fio_fopen, so we use the least common denominator for
          * closing. */
         gmx_fio_fclose((*ed)->edo);
+        done_cvreduce((*ed)->cvr);
+        for (t_edpar *edi = (*ed)->edpar; edi != nullptr; edi = edi->next_edi)
+        {
+            if (edi->buf != nullptr && edi->buf->do_edsam != nullptr)
+            {
+                done_group_gather(edi->buf->do_edsam->xcoll_gather);
+                done_group_gather(edi->buf->do_edsam->xc_ref_gather);
+            }
+        }
     }
 
     /* TODO deallocate ed and set pointer to NULL */
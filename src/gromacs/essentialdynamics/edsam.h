@@ -59,6 +59,7 @@
 typedef struct gmx_edsam *gmx_edsam_t;
 
 struct edsamhistory_t;
+struct gmx_cvreduce_t;
 struct gmx_domdec_t;
 struct gmx_mtop_t;
 struct gmx_output_env_t;
@@ -125,18 +126,32 @@ void init_edsam(const gmx_mtop_t *mtop, const t_inputrec *ir, t_commrec *cr,
 void dd_make_local_ed_indices(gmx_domdec_t *dd, gmx_edsam_t ed);
 
 
+/*! \brief Register the local flooding positions for global summation.
+ *
+ * The local positions of all flooding groups are put in the collective
+ * arrays, which are registered with \p cvr for a single, fused, summation
+ * over the nodes. After cvreduce_finish() has been called on \p cvr,
+ * do_flood() should be called.
+ *
+ * \param cvr               The buffer for the fused global summation.
+ * \param x                 Positions on the local processor.
+ * \param ed                The essential dynamics data.
+ */
+void do_flood_local(gmx_cvreduce_t *cvr, rvec x[], gmx_edsam_t ed);
+
 /*! \brief Evaluate the flooding potential(s) and forces as requested in the .edi input file.
+ *
+ * The collective positions should have been summed, see do_flood_local().
  *
  * \param cr                Data needed for MPI communication.
  * \param ir                MD input parameter record.
- * \param x                 Positions on the local processor.
  * \param force             Forcefield forces to which the flooding forces are added.
  * \param ed                The essential dynamics data.
  * \param box               The simulation box.
  * \param step              Number of the time step.
  * \param bNS               Are we in a neighbor searching step?
  */
-void do_flood(t_commrec *cr, const t_inputrec *ir, rvec x[], rvec force[], gmx_edsam_t ed,
+void do_flood(t_commrec *cr, const t_inputrec *ir, rvec force[], gmx_edsam_t ed,
               matrix box, gmx_int64_t step, gmx_bool bNS);
 
 /*! \brief Clean up
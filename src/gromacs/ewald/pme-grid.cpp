@@ -41,7 +41,12 @@
 
 #include "config.h"
 
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
 
 #include "gromacs/ewald/pme.h"
 #include "gromacs/fft/parallel_3dfft.h"
@@ -63,13 +68,90 @@
  */
 #define GMX_CACHE_SEP 64
 
+/*! \brief The maximum magnitude of the compressed integer values */
+static const int c_pmeGridCompressionIntMax = 32767;
+
+int pme_grid_compressed_size(int n)
+{
+    int nblock = (n + c_pmeGridCompressionBlockSize - 1)/c_pmeGridCompressionBlockSize;
+
+    return nblock*sizeof(float) + n*sizeof(int16_t);
+}
+
+void pme_grid_compress(const real *src, int n, char *dest)
+{
+    for (int b = 0; b < n; b += c_pmeGridCompressionBlockSize)
+    {
+        int   bn     = std::min(c_pmeGridCompressionBlockSize, n - b);
+        real  absmax = 0;
+        for (int i = 0; i < bn; i++)
+        {
+            absmax = std::max(absmax, std::abs(src[b + i]));
+        }
+        float scale    = absmax/c_pmeGridCompressionIntMax;
+        real  invscale = (absmax > 0 ? c_pmeGridCompressionIntMax/absmax : 0);
+        std::memcpy(dest, &scale, sizeof(scale));
+        dest += sizeof(scale);
+        for (int i = 0; i < bn; i++)
+        {
+            int16_t value = static_cast<int16_t>(std::lround(src[b + i]*invscale));
+            std::memcpy(dest, &value, sizeof(value));
+            dest += sizeof(value);
+        }
+    }
+}
+
+void pme_grid_decompress(const char *src, int n, real *dest)
+{
+    for (int b = 0; b < n; b += c_pmeGridCompressionBlockSize)
+    {
+        int   bn = std::min(c_pmeGridCompressionBlockSize, n - b);
+        float scale;
+        std::memcpy(&scale, src, sizeof(scale));
+        src += sizeof(scale);
+        for (int i = 0; i < bn; i++)
+        {
+            int16_t value;
+            std::memcpy(&value, src, sizeof(value));
+            src         += sizeof(value);
+            dest[b + i]  = value*scale;
+        }
+    }
+}
+
 #if GMX_MPI
+void pme_grid_sendrecv(const gmx_pme_t *pme, const pme_overlap_t *overlap,
+                       real *sendbuf, int nsend, int send_id,
+                       real *recvbuf, int nrecv, int recv_id,
+                       int tag)
+{
+    MPI_Status stat;
+
+    if (pme->bCompressGridComm)
+    {
+        pme_grid_compress(sendbuf, nsend, overlap->sendbuf_compressed);
+        MPI_Sendrecv(overlap->sendbuf_compressed, pme_grid_compressed_size(nsend), MPI_BYTE,
+                     send_id, tag,
+                     overlap->recvbuf_compressed, pme_grid_compressed_size(nrecv), MPI_BYTE,
+                     recv_id, tag,
+                     overlap->mpi_comm, &stat);
+        pme_grid_decompress(overlap->recvbuf_compressed, nrecv, recvbuf);
+    }
+    else
+    {
+        MPI_Sendrecv(sendbuf, nsend, GMX_MPI_REAL,
+                     send_id, tag,
+                     recvbuf, nrecv, GMX_MPI_REAL,
+                     recv_id, tag,
+                     overlap->mpi_comm, &stat);
+    }
+}
+
 void gmx_sum_qgrid_dd(struct gmx_pme_t *pme, real *grid, int direction)
 {
     pme_overlap_t *overlap;
     int            send_index0, send_nindex;
     int            recv_index0, recv_nindex;
-    MPI_Status     stat;
     int            i, j, k, ix, iy, iz, icnt;
     int            ipulse, send_id, recv_id, datasize;
     real          *p;
@@ -128,11 +210,10 @@ void gmx_sum_qgrid_dd(struct gmx_pme_t *pme, real *grid, int direction)
 
         datasize      = pme->pmegrid_nx * pme->nkz;
 
-        MPI_Sendrecv(overlap->sendbuf, send_nindex*datasize, GMX_MPI_REAL,
-                     send_id, ipulse,
-                     overlap->recvbuf, recv_nindex*datasize, GMX_MPI_REAL,
-                     recv_id, ipulse,
-                     overlap->mpi_comm, &stat);
+        pme_grid_sendrecv(pme, overlap,
+                          overlap->sendbuf, send_nindex*datasize, send_id,
+                          overlap->recvbuf, recv_nindex*datasize, recv_id,
+                          ipulse);
 
         /* Get data from contiguous recv buffer */
         if (debug)
@@ -213,11 +294,10 @@ void gmx_sum_qgrid_dd(struct gmx_pme_t *pme, real *grid, int direction)
                     recv_index0-pme->pmegrid_start_ix+recv_nindex);
         }
 
-        MPI_Sendrecv(sendptr, send_nindex*datasize, GMX_MPI_REAL,
-                     send_id, ipulse,
-                     recvptr, recv_nindex*datasize, GMX_MPI_REAL,
-                     recv_id, ipulse,
-                     overlap->mpi_comm, &stat);
+        pme_grid_sendrecv(pme, overlap,
+                          sendptr, send_nindex*datasize, send_id,
+                          recvptr, recv_nindex*datasize, recv_id,
+                          ipulse);
 
         /* ADD data from contiguous recv buffer */
         if (direction == GMX_SUM_GRID_FORWARD)
@@ -56,10 +56,42 @@ constexpr int c_pmeMaxUnitcellShift = 2;
  */
 constexpr int c_pmeNeighborUnitcellCount = 2*c_pmeMaxUnitcellShift + 1;
 
+/*! \brief
+ * The number of grid values sharing a scaling factor in compressed grid communication.
+ */
+constexpr int c_pmeGridCompressionBlockSize = 32;
+
+/*! \brief Returns the number of bytes needed to store \p n grid values compressed
+ *
+ * The grid values are stored in blocks of c_pmeGridCompressionBlockSize
+ * values, each block with a single float scaling factor and 16-bit integers.
+ */
+int
+pme_grid_compressed_size(int n);
+
+/*! \brief Compresses \p n grid values from \p src into \p dest
+ *
+ * The absolute error in each value is at most the maximum absolute value
+ * in its block of c_pmeGridCompressionBlockSize values divided by 65534.
+ * \p dest should have space for pme_grid_compressed_size(n) bytes.
+ */
+void
+pme_grid_compress(const real *src, int n, char *dest);
+
+/*! \brief Decompresses \p n grid values from \p src, generated by pme_grid_compress(), into \p dest */
+void
+pme_grid_decompress(const char *src, int n, real *dest);
 
 #if GMX_MPI
 void
 gmx_sum_qgrid_dd(struct gmx_pme_t *pme, real *grid, int direction);
+
+/*! \brief Exchanges grid overlap data with MPI_Sendrecv, compressed when \p pme->bCompressGridComm is set */
+void
+pme_grid_sendrecv(const gmx_pme_t *pme, const pme_overlap_t *overlap,
+                  real *sendbuf, int nsend, int send_id,
+                  real *recvbuf, int nrecv, int recv_id,
+                  int tag);
 #endif
 
 int
@@ -142,6 +142,8 @@ typedef struct {
     pme_grid_comm_t *comm_data;
     real            *sendbuf;
     real            *recvbuf;
+    char            *sendbuf_compressed; /* Buffers for compressed communication, only used with bCompressGridComm */
+    char            *recvbuf_compressed;
 } pme_overlap_t;
 
 /*! \brief Data structure for organizing particle allocation to threads */
@@ -248,6 +250,7 @@ typedef struct gmx_pme_t {
 
     gmx_bool   bUseThreads;   /* Does any of the PME ranks have nthread>1 ?  */
     int        nthread;       /* The number of threads doing PME on our rank */
+    gmx_bool   bCompressGridComm; /* Communicate the grid overlap in compressed, reduced precision form */
 
     gmx_bool   bPPnode;       /* Node also does particle-particle forces */
     bool       doCoulomb;     /* Apply PME to electrostatics */
@@ -322,6 +325,9 @@ typedef struct gmx_pme_t {
     /* thread local work data for solve_pme */
     struct pme_solve_work_t *solve_work;
 
+    /* Multilevel summation solver, replaces the FFTs and solve_pme for Coulomb when set */
+    struct pme_multilevel_t *multilevel;
+
     /* Work data for sum_qgrid */
     real *   sum_qgrid_tmp;
     real *   sum_qgrid_dd_tmp;
@@ -329,6 +335,12 @@ typedef struct gmx_pme_t {
 
 //! @endcond
 
+/*! \brief Replaces the FFTs and solve for Coulomb by the multilevel solver with relative accuracy \p tolerance
+ *
+ * Should be called by all PME ranks, after gmx_pme_init().
+ */
+void gmx_pme_init_multilevel(gmx_pme_t *pme, real tolerance);
+
 /*! \brief Initialize the PME-only side of the PME <-> PP communication */
 gmx_pme_pp_t gmx_pme_pp_init(t_commrec *cr);
 
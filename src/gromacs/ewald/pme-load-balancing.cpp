@@ -62,6 +62,7 @@
 #include "gromacs/math/functions.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/mdlib/forcerec.h"
+#include "gromacs/mdlib/nb_verlet.h"
 #include "gromacs/mdlib/nbnxn_gpu_data_mgmt.h"
 #include "gromacs/mdlib/sim_util.h"
 #include "gromacs/mdtypes/commrec.h"
@@ -766,6 +767,13 @@ pme_load_balance(pme_load_balancing_t      *pme_lb,
 
     set = &pme_lb->setup[pme_lb->cur];
 
+    if (nbv != nullptr && nbv->bDynamicPruning)
+    {
+        /* Keep the buffer of the dynamically pruned inner list constant */
+        nbv->rlistInner = std::min(nbv->rlistInner + set->rcut_coulomb - ic->rcoulomb,
+                                   set->rlist);
+    }
+
     ic->rcoulomb     = set->rcut_coulomb;
     ic->rlist        = set->rlist;
     ic->ewaldcoeff_q = set->ewaldcoeff_q;
@@ -0,0 +1,1459 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements the multilevel summation solver for the PME grid.
+ *
+ * \ingroup module_ewald
+ */
+
+#include "gmxpre.h"
+
+#include "pme-multilevel.h"
+
+#include "config.h"
+
+#include <cmath>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "gromacs/math/gmxcomplex.h"
+#include "gromacs/math/units.h"
+#include "gromacs/math/utilities.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxmpi.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "calculate-spline-moduli.h"
+
+/*! \brief Grid dimensions are not coarsened below this size */
+static const int c_multilevelMinGridSize = 8;
+
+/*! \brief The stencils are recomputed when the box changed by more than this
+ * fraction of the tolerance, relative to the box size
+ */
+static const real c_stencilBoxChangeFraction = 0.1;
+
+/*! \brief The maximum number of Gauss-Legendre quadrature nodes per level */
+static const int c_multilevelMaxNodes = 9;
+
+/*! \brief The maximum error of the Gauss-Legendre quadrature of one level kernel
+ * relative to its maximum, indexed by the number of nodes.
+ */
+static const double c_multilevelQuadratureError[c_multilevelMaxNodes + 1] =
+{ 1, 1, 3.8e-4, 1.6e-5, 6.0e-7, 2.3e-8, 1.0e-9, 4.0e-11, 1.7e-12, 7.2e-14 };
+
+/*! \brief The number of decomposed dimensions, x and y */
+static const int c_multilevelNumDecompDims = 2;
+
+/*! \brief The MPI tag for the halo communication */
+static const int c_multilevelHaloTag = 4711;
+
+/*! \brief The 1D kernels of the stencils, x is the distance along the dimension */
+enum {
+    eKernelGauss,   /* exp(-t^2 x^2),     for the potential */
+    eKernelGaussX,  /* x exp(-t^2 x^2),   for the off-diagonal virial */
+    eKernelGaussX2, /* x^2 exp(-t^2 x^2), for the diagonal virial */
+    eKernelNR
+};
+
+/*! \brief The operations along one grid dimension */
+enum {
+    ePassCopy,       /* Copy, for dimensions that are not coarsened */
+    ePassRestrict,   /* Restrict the charges to a grid twice as coarse */
+    ePassProlongate, /* Prolongate the potential to a grid twice as fine */
+    ePassConvolve,   /* Convolve with a stencil */
+    ePassNR
+};
+
+/*! \brief A periodic 1D stencil acting along one grid dimension */
+struct pme_multilevel_stencil_t
+{
+    int               dmin; /* The first offset */
+    int               dmax; /* The last offset */
+    std::vector<real> s;    /* The stencil values at offsets dmin to dmax */
+    real              sum;  /* Sum of the values, the zero frequency component */
+};
+
+/*! \brief The data for one grid level
+ *
+ * With a decomposed PME grid each rank stores the block of each level
+ * given by rankStart, the z-dimension is never decomposed.
+ */
+struct pme_multilevel_level_t
+{
+    ivec              n;              /* Grid size */
+    ivec              coarsen;        /* Whether dimensions are halved for the next level */
+    real              beta;           /* The kernel erf(beta r)/r is handled from this level on */
+    std::vector<int>  rankStart[DIM]; /* The start index of each rank along each dimension, ends with n */
+    ivec              localStart;     /* The start of the local block of the grid */
+    ivec              localSize;      /* The size of the local block of the grid */
+    std::vector<real> bsp_mod[DIM];   /* B-spline moduli for this grid size */
+    std::vector<real> q;              /* Local charge grid */
+    std::vector<real> phi;            /* Local potential grid */
+    std::vector<real> t;              /* Gaussian exponents of the quadrature, not used on the top level */
+    std::vector<real> w;              /* Gaussian weights of the quadrature */
+    /* The 1D stencils, indexed by [node*eKernelNR + kernel][dim] */
+    std::vector < std::array < pme_multilevel_stencil_t, DIM>> stencil;
+    real              stencilSum;     /* The zero frequency component of the level kernel */
+};
+
+/*! \brief An operation along one dimension that maps a grid to another grid
+ *
+ * The input and output grids only differ in size along \p dim.
+ */
+struct pme_multilevel_pass_t
+{
+    int                             type;     /* The operation, ePass... */
+    int                             dim;      /* The dimension the operation acts along */
+    int                             nin;      /* The input grid size along dim */
+    int                             nout;     /* The output grid size along dim */
+    const std::vector<int>         *inStart;  /* The input rank start indices along dim */
+    const std::vector<int>         *outStart; /* The output rank start indices along dim */
+    const pme_multilevel_stencil_t *stencil;  /* The stencil, only for ePassConvolve */
+    real                            factor;   /* The stencil factor, only for ePassConvolve */
+};
+
+/*! \brief Thread local work data */
+struct pme_multilevel_work_t
+{
+    real              energy;  /* The energy contribution of this thread */
+    matrix            vir;     /* The virial contribution of this thread */
+};
+
+struct pme_multilevel_t
+{
+    ivec                                paddedSize; /* Size of the local (padded) PME FFT grid */
+    int                                 pme_order;  /* The PME interpolation order */
+    real                                elfac;      /* Electrostatics conversion factor */
+    real                                tolerance;  /* Relative tolerance for the stencils */
+    int                                 numRanks[c_multilevelNumDecompDims];  /* The number of PME ranks along x and y */
+    int                                 rankIndex[c_multilevelNumDecompDims]; /* Our rank index along x and y */
+    MPI_Comm                            comm[c_multilevelNumDecompDims];      /* The communicators along x and y */
+    gmx_bool                            bMaster;    /* Whether we are the first rank, which adds the global terms */
+    std::vector<real>                   twoScale;   /* B-spline two-scale coefficients */
+    std::vector<pme_multilevel_level_t> level;      /* The grid levels, the last is the top level */
+    std::vector<real>                   tmp[2];     /* Temporary grids for the separable passes */
+    std::vector<real>                   halo;       /* The input of a pass extended with its halo */
+    std::vector<real>                   sendBuf;    /* Halo send buffer */
+    std::vector<real>                   recvBuf;    /* Halo receive buffer */
+    rvec                                boxSize;    /* The current box size */
+    rvec                                stencilBoxSize; /* The box size used for the stencils */
+    std::vector<real>                   topLocal;   /* The full top level grid with only our block filled */
+    std::vector<real>                   topGlobal;  /* The full top level grid summed over the ranks */
+    std::vector<t_complex>              ctop;       /* Complex top level grid */
+    std::vector<real>                   cosTable[DIM]; /* cos(2 pi i/n) for the top level sizes */
+    std::vector<real>                   sinTable[DIM]; /* sin(2 pi i/n) for the top level sizes */
+    real                                qsum;       /* The total charge on the grid */
+    std::vector<pme_multilevel_work_t>  work;       /* Thread local work data */
+};
+
+/*! \brief Returns \p a divided by \p b, rounded down, for b > 0 */
+static int floor_div(int a, int b)
+{
+    return (a >= 0 ? a/b : -((b - 1 - a)/b));
+}
+
+/*! \brief Computes Gauss-Legendre quadrature nodes and weights on [0,1] */
+static void gauss_legendre(int n, std::vector<double> *x, std::vector<double> *w)
+{
+    x->resize(n);
+    w->resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        double z  = std::cos(M_PI*(i + 0.75)/(n + 0.5));
+        double dp = 1;
+        for (int iter = 0; iter < 100; iter++)
+        {
+            /* Evaluate the Legendre polynomial and its derivative at z */
+            double p0 = 1;
+            double p1 = z;
+            for (int k = 2; k <= n; k++)
+            {
+                double p2 = ((2*k - 1)*z*p1 - (k - 1)*p0)/k;
+                p0        = p1;
+                p1        = p2;
+            }
+            dp        = n*(z*p1 - p0)/(z*z - 1);
+            double dz = p1/dp;
+            z        -= dz;
+            if (std::abs(dz) < 1e-15)
+            {
+                break;
+            }
+        }
+        (*x)[i] = 0.5*(z + 1);
+        (*w)[i] = 1/((1 - z*z)*dp*dp);
+    }
+}
+
+/*! \brief Returns the Fourier transform of \p kernel with exponent \p t at wave number \p k
+ *
+ * For eKernelGaussX the imaginary part divided by -1 is returned.
+ */
+static double kernel_fourier(int kernel, double t, double k)
+{
+    double gaussian = std::sqrt(M_PI)/t*std::exp(-k*k/(4*t*t));
+
+    switch (kernel)
+    {
+        case eKernelGauss:   return gaussian;
+        case eKernelGaussX:  return k/(2*t*t)*gaussian;
+        case eKernelGaussX2: return gaussian/(2*t*t)*(1 - k*k/(2*t*t));
+    }
+
+    return 0;
+}
+
+/*! \brief Computes the periodic, B-spline deconvoluted and truncated stencil of \p kernel
+ *
+ * The stencil is evaluated from its Fourier series over the frequencies
+ * present on the grid, exactly as the influence function in solve_pme_yzx().
+ * Values below tolerance times the maximum value are truncated away.
+ */
+static void make_stencil(int n, real length, int kernel, double t,
+                         const real *bsp_mod, real tolerance,
+                         pme_multilevel_stencil_t *stencil)
+{
+    std::vector<double> coeff(n/2 + 1);
+    for (int m = 0; m <= n/2; m++)
+    {
+        coeff[m] = kernel_fourier(kernel, t, 2*M_PI*m/length)/(bsp_mod[m]*length);
+    }
+
+    /* Even kernels use cos, the odd kernel sin */
+    std::vector<double> table(n);
+    for (int i = 0; i < n; i++)
+    {
+        table[i] = (kernel == eKernelGaussX ? std::sin(2*M_PI*i/n) : std::cos(2*M_PI*i/n));
+    }
+
+    int                 dlo = -(n - 1)/2;
+    std::vector<double> value(n);
+    double              maxabs = 0;
+    for (int i = 0; i < n; i++)
+    {
+        int    d   = dlo + i;
+        int    dm  = (d + n) % n;
+        double sum = (kernel == eKernelGaussX ? 0 : coeff[0]);
+        for (int m = 1; m < (n + 1)/2; m++)
+        {
+            sum += 2*coeff[m]*table[(m*dm) % n];
+        }
+        if (n % 2 == 0 && kernel != eKernelGaussX)
+        {
+            /* The Nyquist frequency only occurs once */
+            sum += coeff[n/2]*table[((n/2)*dm) % n];
+        }
+        value[i] = sum;
+        maxabs   = std::max(maxabs, std::abs(sum));
+    }
+
+    int range = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (std::abs(value[i]) > tolerance*maxabs)
+        {
+            range = std::max(range, std::abs(dlo + i));
+        }
+    }
+    if (2*range + 1 < n)
+    {
+        stencil->dmin = -range;
+        stencil->dmax =  range;
+    }
+    else
+    {
+        stencil->dmin = dlo;
+        stencil->dmax = dlo + n - 1;
+    }
+    stencil->s.resize(stencil->dmax - stencil->dmin + 1);
+    stencil->sum = 0;
+    for (int d = stencil->dmin; d <= stencil->dmax; d++)
+    {
+        stencil->s[d - stencil->dmin] = value[d - dlo];
+        stencil->sum                 += value[d - dlo];
+    }
+}
+
+/*! \brief Returns our rank index along dimension \p dim */
+static int rank_index(const pme_multilevel_t *ml, int dim)
+{
+    return (dim < c_multilevelNumDecompDims ? ml->rankIndex[dim] : 0);
+}
+
+/*! \brief Returns the number of ranks along dimension \p dim */
+static int num_ranks(const pme_multilevel_t *ml, int dim)
+{
+    return (dim < c_multilevelNumDecompDims ? ml->numRanks[dim] : 1);
+}
+
+/*! \brief Sets \p *i0 and \p *i1 to the part of \p n elements for \p thread */
+static void thread_range(int n, int nthread, int thread, int *i0, int *i1)
+{
+    /* Use 64-bit integers, n*nthread can overflow for large grids */
+    *i0 = static_cast<int>((static_cast<gmx_int64_t>(n)* thread   )/nthread);
+    *i1 = static_cast<int>((static_cast<gmx_int64_t>(n)*(thread+1))/nthread);
+}
+
+pme_multilevel_t *pme_multilevel_init(const ivec gridSize, const ivec localOffset,
+                                      const ivec localSize, const ivec paddedLocalSize,
+                                      int pme_order, real ewaldcoeff, real epsilon_r,
+                                      real tolerance, int nthread,
+                                      const int numRanks[], const int rankIndex[],
+                                      const MPI_Comm comm[])
+{
+    pme_multilevel_t *ml = new pme_multilevel_t;
+
+    copy_ivec(paddedLocalSize, ml->paddedSize);
+    ml->pme_order = pme_order;
+    ml->elfac     = ONE_4PI_EPS0/epsilon_r;
+    ml->tolerance = tolerance;
+    for (int d = 0; d < c_multilevelNumDecompDims; d++)
+    {
+        ml->numRanks[d]  = numRanks[d];
+        ml->rankIndex[d] = rankIndex[d];
+        ml->comm[d]      = comm[d];
+    }
+    ml->bMaster   = (rankIndex[XX] == 0 && rankIndex[YY] == 0);
+    clear_rvec(ml->boxSize);
+    clear_rvec(ml->stencilBoxSize);
+    ml->qsum      = 0;
+
+    /* The B-spline two-scale relation: M(x/2) = sum_k 2^(1-p) binom(p,k) M(x - k) */
+    ml->twoScale.resize(pme_order + 1);
+    for (int k = 0; k <= pme_order; k++)
+    {
+        double binom = 1;
+        for (int i = 0; i < k; i++)
+        {
+            binom = binom*(pme_order - i)/(i + 1);
+        }
+        ml->twoScale[k] = binom*std::pow(2.0, 1 - pme_order);
+    }
+
+    /* Each level covers a factor two in the Gaussian exponents.
+     * We use the same number of nodes on all levels, which gives
+     * errors decreasing by a factor two per level, so the total error
+     * is at most twice that of the first level.
+     */
+    int nnode = 2;
+    while (nnode < c_multilevelMaxNodes &&
+           2*c_multilevelQuadratureError[nnode] > tolerance)
+    {
+        nnode++;
+    }
+    std::vector<double> s, omega;
+    gauss_legendre(nnode, &s, &omega);
+
+    const int minGridSize = std::max(c_multilevelMinGridSize, pme_order);
+
+    pme_multilevel_level_t level;
+    copy_ivec(gridSize, level.n);
+    level.beta = ewaldcoeff;
+    /* The finest level uses the decomposition of the PME FFT grid */
+    for (int d = 0; d < DIM; d++)
+    {
+        std::vector<int> &start = level.rankStart[d];
+        start.resize(num_ranks(ml, d) + 1);
+        start[0] = 0;
+#if GMX_MPI
+        if (num_ranks(ml, d) > 1)
+        {
+            /* Collect the offsets of all ranks, thread-MPI has no MPI_Allgather */
+            std::vector<int> offset(num_ranks(ml, d), 0);
+            offset[rank_index(ml, d)] = localOffset[d];
+            MPI_Allreduce(offset.data(), start.data(), offset.size(), MPI_INT, MPI_SUM, comm[d]);
+        }
+#endif
+        start.back() = gridSize[d];
+        GMX_RELEASE_ASSERT(start[rank_index(ml, d)] == localOffset[d] &&
+                           start[rank_index(ml, d) + 1] - start[rank_index(ml, d)] == localSize[d],
+                           "The local PME grid should match the grid decomposition");
+    }
+    while (true)
+    {
+        bool bCoarsen = false;
+        for (int d = 0; d < DIM; d++)
+        {
+            level.coarsen[d] = (level.n[d] % 2 == 0 && level.n[d]/2 >= minGridSize);
+            bCoarsen         = bCoarsen || level.coarsen[d];
+        }
+        for (int d = 0; d < DIM; d++)
+        {
+            level.localStart[d] = level.rankStart[d][rank_index(ml, d)];
+            level.localSize[d]  = level.rankStart[d][rank_index(ml, d) + 1] - level.localStart[d];
+        }
+        if (bCoarsen)
+        {
+            /* Quadrature of (erf(beta r) - erf(beta/2 r))/r = 2/sqrt(pi) int_beta/2^beta exp(-t^2 r^2) dt,
+             * with t = beta/2 2^s, s in [0,1].
+             */
+            for (int j = 0; j < nnode; j++)
+            {
+                double t = 0.5*level.beta*std::pow(2.0, s[j]);
+                level.t.push_back(t);
+                level.w.push_back(ml->elfac*2/std::sqrt(M_PI)*std::log(2.0)*omega[j]*t);
+            }
+            level.stencil.resize(nnode*eKernelNR);
+        }
+        ml->level.push_back(level);
+
+        if (!bCoarsen)
+        {
+            break;
+        }
+
+        for (int d = 0; d < DIM; d++)
+        {
+            if (level.coarsen[d])
+            {
+                level.n[d] /= 2;
+                /* Halving the start indices keeps the restriction halo small */
+                for (int &start : level.rankStart[d])
+                {
+                    start = (start + 1)/2;
+                }
+            }
+        }
+        level.beta *= 0.5;
+        level.t.clear();
+        level.w.clear();
+        level.stencil.clear();
+    }
+
+    for (auto &lev : ml->level)
+    {
+        splinevec bsp_mod;
+        for (int d = 0; d < DIM; d++)
+        {
+            snew(bsp_mod[d], lev.n[d]);
+        }
+        make_bspline_moduli(bsp_mod, lev.n[XX], lev.n[YY], lev.n[ZZ], pme_order);
+        for (int d = 0; d < DIM; d++)
+        {
+            lev.bsp_mod[d].assign(bsp_mod[d], bsp_mod[d] + lev.n[d]);
+            sfree(bsp_mod[d]);
+        }
+        lev.q.resize(lev.localSize[XX]*lev.localSize[YY]*lev.localSize[ZZ]);
+        lev.phi.resize(lev.q.size());
+    }
+    /* The coarser levels and the intermediate grids of the passes are not
+     * larger than the finest level.
+     */
+    for (int i = 0; i < 2; i++)
+    {
+        ml->tmp[i].resize(ml->level[0].q.size());
+    }
+
+    const pme_multilevel_level_t &top = ml->level.back();
+    ml->topLocal.resize(top.n[XX]*top.n[YY]*top.n[ZZ]);
+    ml->topGlobal.resize(ml->topLocal.size());
+    ml->ctop.resize(ml->topLocal.size());
+    for (int d = 0; d < DIM; d++)
+    {
+        ml->cosTable[d].resize(top.n[d]);
+        ml->sinTable[d].resize(top.n[d]);
+        for (int i = 0; i < top.n[d]; i++)
+        {
+            ml->cosTable[d][i] = std::cos(2*M_PI*i/top.n[d]);
+            ml->sinTable[d][i] = std::sin(2*M_PI*i/top.n[d]);
+        }
+    }
+
+    ml->work.resize(nthread);
+    for (auto &work : ml->work)
+    {
+        work.energy = 0;
+        clear_mat(work.vir);
+    }
+
+    return ml;
+}
+
+void pme_multilevel_destroy(pme_multilevel_t *ml)
+{
+    delete ml;
+}
+
+int pme_multilevel_nlevels(const pme_multilevel_t *ml)
+{
+    return ml->level.size();
+}
+
+/*! \brief The B-spline index offset in the two-scale relation
+ *
+ * The PME spreading puts weight M(u - g + pme_order - 1) on grid point g
+ * for a particle at scaled coordinate u, with M the cardinal B-spline.
+ */
+static int two_scale_offset(const pme_multilevel_t *ml)
+{
+    return ml->pme_order - 1;
+}
+
+/*! \brief Returns the pass along \p dim from level \p l to level \p l + 1 of the restriction */
+static pme_multilevel_pass_t restrict_pass(const pme_multilevel_t *ml, int l, int dim)
+{
+    const pme_multilevel_level_t &fine   = ml->level[l];
+    const pme_multilevel_level_t &coarse = ml->level[l + 1];
+    pme_multilevel_pass_t         pass;
+
+    pass.type     = (fine.coarsen[dim] ? ePassRestrict : ePassCopy);
+    pass.dim      = dim;
+    pass.nin      = fine.n[dim];
+    pass.nout     = coarse.n[dim];
+    pass.inStart  = &fine.rankStart[dim];
+    pass.outStart = &coarse.rankStart[dim];
+    pass.stencil  = nullptr;
+    pass.factor   = 1;
+
+    return pass;
+}
+
+/*! \brief Returns the pass along \p dim from level \p l + 1 to level \p l of the prolongation */
+static pme_multilevel_pass_t prolongate_pass(const pme_multilevel_t *ml, int l, int dim)
+{
+    const pme_multilevel_level_t &fine   = ml->level[l];
+    const pme_multilevel_level_t &coarse = ml->level[l + 1];
+    pme_multilevel_pass_t         pass;
+
+    pass.type     = (fine.coarsen[dim] ? ePassProlongate : ePassCopy);
+    pass.dim      = dim;
+    pass.nin      = coarse.n[dim];
+    pass.nout     = fine.n[dim];
+    pass.inStart  = &coarse.rankStart[dim];
+    pass.outStart = &fine.rankStart[dim];
+    pass.stencil  = nullptr;
+    pass.factor   = 1;
+
+    return pass;
+}
+
+/*! \brief Returns the convolution pass along \p dim on level \p lev */
+static pme_multilevel_pass_t convolve_pass(const pme_multilevel_level_t &lev, int dim,
+                                           const pme_multilevel_stencil_t *stencil,
+                                           real factor)
+{
+    pme_multilevel_pass_t pass;
+
+    pass.type     = ePassConvolve;
+    pass.dim      = dim;
+    pass.nin      = lev.n[dim];
+    pass.nout     = lev.n[dim];
+    pass.inStart  = &lev.rankStart[dim];
+    pass.outStart = &lev.rankStart[dim];
+    pass.stencil  = stencil;
+    pass.factor   = factor;
+
+    return pass;
+}
+
+/*! \brief Returns in [*wLo, *wHi) the input indices \p pass needs for output indices [lo, hi)
+ *
+ * The indices are not wrapped, so the range can extend beyond the grid
+ * on both sides and can be longer than the grid.
+ */
+static void pass_window(const pme_multilevel_t *ml, const pme_multilevel_pass_t &pass,
+                        int lo, int hi, int *wLo, int *wHi)
+{
+    if (hi <= lo)
+    {
+        *wLo = 0;
+        *wHi = 0;
+        return;
+    }
+
+    const int offset = two_scale_offset(ml);
+    switch (pass.type)
+    {
+        case ePassCopy:
+            *wLo = lo;
+            *wHi = hi;
+            break;
+        case ePassRestrict:
+            /* out[j] = sum_k c[k] in[2 j + k - offset] */
+            *wLo = 2*lo - offset;
+            *wHi = 2*(hi - 1) - offset + ml->pme_order + 1;
+            break;
+        case ePassProlongate:
+            /* out[i] = sum_k c[k] in[(i + offset - k)/2] for even i + offset - k */
+            *wLo = floor_div(lo + offset - ml->pme_order, 2);
+            *wHi = floor_div(hi - 1 + offset, 2) + 1;
+            break;
+        case ePassConvolve:
+            /* out[i] = sum_d s[d] in[i - d] */
+            *wLo = lo - pass.stencil->dmax;
+            *wHi = hi - pass.stencil->dmin;
+            break;
+    }
+}
+
+/*! \brief Calls \p f(w, g, length) for each part of the window [wLo, wHi) that lies in the owned range [ownLo, ownHi)
+ *
+ * The window indices are periodic with period \p n. The parts are passed
+ * in order of increasing window index, w is the index in the window
+ * relative to wLo and g is the corresponding grid index in [ownLo, ownHi).
+ */
+template <typename F>
+static void for_each_window_piece(int wLo, int wHi, int n, int ownLo, int ownHi, F f)
+{
+    if (wHi <= wLo || ownHi <= ownLo)
+    {
+        return;
+    }
+    for (int shift = floor_div(wLo, n)*n; shift < wHi; shift += n)
+    {
+        int lo = std::max(wLo, ownLo + shift);
+        int hi = std::min(wHi, ownHi + shift);
+        if (lo < hi)
+        {
+            f(lo - wLo, lo - shift, hi - lo);
+        }
+    }
+}
+
+/*! \brief Returns the size of the halo grid of \p pass with local input grid size \p nloc */
+static int pass_halo_size(const pme_multilevel_t *ml, const pme_multilevel_pass_t &pass,
+                          const ivec nloc)
+{
+    const int rank = rank_index(ml, pass.dim);
+    int       wLo, wHi;
+    pass_window(ml, pass, (*pass.outStart)[rank], (*pass.outStart)[rank + 1], &wLo, &wHi);
+
+    int       size = wHi - wLo;
+    for (int d = 0; d < DIM; d++)
+    {
+        if (d != pass.dim)
+        {
+            size *= nloc[d];
+        }
+    }
+
+    return size;
+}
+
+/*! \brief Makes sure the halo grid is large enough for all passes, should be called after setting the stencils */
+static void reserve_halo(pme_multilevel_t *ml)
+{
+    const int nlevel  = ml->level.size();
+    int       maxSize = 0;
+    ivec      nloc;
+
+    for (int l = 0; l < nlevel - 1; l++)
+    {
+        const pme_multilevel_level_t &fine   = ml->level[l];
+        const pme_multilevel_level_t &coarse = ml->level[l + 1];
+
+        copy_ivec(fine.localSize, nloc);
+        for (int d = 0; d < DIM; d++)
+        {
+            maxSize = std::max(maxSize, pass_halo_size(ml, restrict_pass(ml, l, d), nloc));
+            nloc[d] = coarse.localSize[d];
+        }
+        for (int d = ZZ; d >= 0; d--)
+        {
+            maxSize = std::max(maxSize, pass_halo_size(ml, prolongate_pass(ml, l, d), nloc));
+            nloc[d] = fine.localSize[d];
+        }
+        for (const auto &stencilDims : fine.stencil)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                maxSize = std::max(maxSize, pass_halo_size(ml, convolve_pass(fine, d, &stencilDims[d], 1),
+                                                           fine.localSize));
+            }
+        }
+    }
+
+    if (static_cast<size_t>(maxSize) > ml->halo.size())
+    {
+        ml->halo.resize(maxSize);
+    }
+}
+
+void pme_multilevel_set_box(pme_multilevel_t *ml, const matrix box)
+{
+    if (TRICLINIC(box))
+    {
+        gmx_fatal(FARGS, "The multilevel PME solver (GMX_PME_MULTILEVEL) only supports rectangular boxes");
+    }
+    for (int d = 0; d < DIM; d++)
+    {
+        ml->boxSize[d] = box[d][d];
+    }
+
+    /* With pressure coupling the box changes (slightly) every step.
+     * The error due to stencils computed for a box that differs by
+     * a relative amount delta is of order delta, so we only recompute
+     * the stencils of a dimension when it changed by more than
+     * a fraction of the tolerance since the stencils were computed.
+     * The top level always uses the actual box.
+     */
+    bool bChanged[DIM];
+    bool bAnyChanged = false;
+    for (int d = 0; d < DIM; d++)
+    {
+        bChanged[d] = (std::abs(ml->boxSize[d] - ml->stencilBoxSize[d]) >
+                       c_stencilBoxChangeFraction*ml->tolerance*ml->boxSize[d]);
+        if (bChanged[d])
+        {
+            ml->stencilBoxSize[d] = ml->boxSize[d];
+            bAnyChanged           = true;
+        }
+    }
+    if (!bAnyChanged)
+    {
+        return;
+    }
+
+    for (auto &lev : ml->level)
+    {
+        lev.stencilSum = 0;
+        for (size_t j = 0; j < lev.t.size(); j++)
+        {
+            for (int kernel = 0; kernel < eKernelNR; kernel++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    if (bChanged[d])
+                    {
+                        make_stencil(lev.n[d], ml->stencilBoxSize[d], kernel, lev.t[j],
+                                     lev.bsp_mod[d].data(), ml->tolerance,
+                                     &lev.stencil[j*eKernelNR + kernel][d]);
+                    }
+                }
+            }
+            const auto &stencil = lev.stencil[j*eKernelNR + eKernelGauss];
+            lev.stencilSum += lev.w[j]*stencil[XX].sum*stencil[YY].sum*stencil[ZZ].sum;
+        }
+    }
+
+    /* The stencil lengths set the halo sizes */
+    reserve_halo(ml);
+}
+
+/*! \brief Synchronizes the threads calling pme_multilevel_solve() */
+static void multilevel_barrier(int nthread)
+{
+    if (nthread > 1)
+    {
+#pragma omp barrier
+    }
+}
+
+/*! \brief Returns the number of grid lines and the line block size of a pass along \p dim
+ *
+ * The grid of local size \p nloc is seen as nouter blocks of lines along
+ * \p dim, with the elements of the lines stored block elements apart.
+ */
+static void pass_layout(const ivec nloc, int dim, int *nouter, int *block)
+{
+    *nouter = 1;
+    *block  = 1;
+    for (int d = 0; d < DIM; d++)
+    {
+        if (d < dim)
+        {
+            *nouter *= nloc[d];
+        }
+        else if (d > dim)
+        {
+            *block  *= nloc[d];
+        }
+    }
+}
+
+#if GMX_MPI
+/*! \brief Communicates the parts of the halo of \p pass that are owned by other ranks
+ *
+ * Every rank sends, to each rank along the pass dimension, the part of its
+ * input block that lies in the window of the other rank, so no rank needs
+ * to know more than the decomposition. Should be called by one thread.
+ */
+static void communicate_halo(pme_multilevel_t *ml, const pme_multilevel_pass_t &pass,
+                             const real *in, int nouter, int block, int wLo, int wHi)
+{
+    const int               dim      = pass.dim;
+    const int               numRanks = num_ranks(ml, dim);
+    const int               rank     = rank_index(ml, dim);
+    const std::vector<int> &inStart  = *pass.inStart;
+    const int               ownLo    = inStart[rank];
+    const int               ownHi    = inStart[rank + 1];
+    const int               ownLen   = ownHi - ownLo;
+    const int               nwin     = wHi - wLo;
+
+    std::vector<int>         sendCount(numRanks, 0);
+    std::vector<int>         recvCount(numRanks, 0);
+    std::vector<int>         peerWLo(numRanks), peerWHi(numRanks);
+    int                      sendTotal = 0;
+    int                      recvTotal = 0;
+    for (int p = 0; p < numRanks; p++)
+    {
+        if (p == rank)
+        {
+            continue;
+        }
+        pass_window(ml, pass, (*pass.outStart)[p], (*pass.outStart)[p + 1], &peerWLo[p], &peerWHi[p]);
+        for_each_window_piece(peerWLo[p], peerWHi[p], pass.nin, ownLo, ownHi,
+                              [&](int, int, int len)
+                              {
+                                  sendCount[p] += nouter*len*block;
+                              });
+        for_each_window_piece(wLo, wHi, pass.nin, inStart[p], inStart[p + 1],
+                              [&](int, int, int len)
+                              {
+                                  recvCount[p] += nouter*len*block;
+                              });
+        sendTotal += sendCount[p];
+        recvTotal += recvCount[p];
+    }
+    if (static_cast<size_t>(sendTotal) > ml->sendBuf.size())
+    {
+        ml->sendBuf.resize(sendTotal);
+    }
+    if (static_cast<size_t>(recvTotal) > ml->recvBuf.size())
+    {
+        ml->recvBuf.resize(recvTotal);
+    }
+
+    std::vector<MPI_Request> request;
+    int                      sendOffset = 0;
+    int                      recvOffset = 0;
+    for (int p = 0; p < numRanks; p++)
+    {
+        if (recvCount[p] > 0)
+        {
+            request.emplace_back();
+            MPI_Irecv(ml->recvBuf.data() + recvOffset, recvCount[p], GMX_MPI_REAL,
+                      p, c_multilevelHaloTag, ml->comm[dim], &request.back());
+            recvOffset += recvCount[p];
+        }
+    }
+    for (int p = 0; p < numRanks; p++)
+    {
+        if (sendCount[p] > 0)
+        {
+            real *buf = ml->sendBuf.data() + sendOffset;
+            for_each_window_piece(peerWLo[p], peerWHi[p], pass.nin, ownLo, ownHi,
+                                  [&](int, int g, int len)
+                                  {
+                                      for (int a = 0; a < nouter; a++)
+                                      {
+                                          const real *src = in + (a*ownLen + g - ownLo)*block;
+                                          buf = std::copy(src, src + len*block, buf);
+                                      }
+                                  });
+            request.emplace_back();
+            MPI_Isend(ml->sendBuf.data() + sendOffset, sendCount[p], GMX_MPI_REAL,
+                      p, c_multilevelHaloTag, ml->comm[dim], &request.back());
+            sendOffset += sendCount[p];
+        }
+    }
+    MPI_Waitall(request.size(), request.data(), MPI_STATUSES_IGNORE);
+
+    const real *buf = ml->recvBuf.data();
+    for (int p = 0; p < numRanks; p++)
+    {
+        if (recvCount[p] > 0)
+        {
+            for_each_window_piece(wLo, wHi, pass.nin, inStart[p], inStart[p + 1],
+                                  [&](int w, int, int len)
+                                  {
+                                      for (int a = 0; a < nouter; a++)
+                                      {
+                                          std::copy(buf, buf + len*block,
+                                                    ml->halo.begin() + (a*nwin + w)*block);
+                                          buf += len*block;
+                                      }
+                                  });
+        }
+    }
+}
+#endif
+
+/*! \brief Applies \p pass to \p in, with local size \p nloc, and stores or with \p bAdd adds the result to \p out
+ *
+ * The input is first copied, including the halo along the pass dimension,
+ * to ml->halo, with the parts owned by other ranks communicated.
+ * Then each output element is computed as a weighted sum of halo elements.
+ * Operates on the contiguous blocks of minor dimensions at once, which is
+ * much faster than extracting grid lines. The output may alias the input.
+ * Should be called by all threads, which are synchronized on return.
+ */
+static void apply_pass(pme_multilevel_t *ml, const pme_multilevel_pass_t &pass,
+                       const real *in, const ivec nloc, real *out, bool bAdd,
+                       int nthread, int thread)
+{
+    const int               dim     = pass.dim;
+    const int               rank    = rank_index(ml, dim);
+    const int               ownLo   = (*pass.inStart)[rank];
+    const int               ownHi   = (*pass.inStart)[rank + 1];
+    const int               ownLen  = ownHi - ownLo;
+    const int               lo      = (*pass.outStart)[rank];
+    const int               outLen  = (*pass.outStart)[rank + 1] - lo;
+    int                     nouter, block;
+    int                     wLo, wHi;
+
+    pass_layout(nloc, dim, &nouter, &block);
+    pass_window(ml, pass, lo, lo + outLen, &wLo, &wHi);
+    const int               nwin    = wHi - wLo;
+    real                   *halo    = ml->halo.data();
+
+    /* Copy the parts of the window we own ourselves, divided over the threads */
+    int selfLen = 0;
+    for_each_window_piece(wLo, wHi, pass.nin, ownLo, ownHi,
+                          [&](int, int, int len)
+                          {
+                              selfLen += len;
+                          });
+    int r0, r1;
+    thread_range(nouter*selfLen, nthread, thread, &r0, &r1);
+    int pieceOffset = 0;
+    for_each_window_piece(wLo, wHi, pass.nin, ownLo, ownHi,
+                          [&](int w, int g, int len)
+                          {
+                              for (int a = 0; a < nouter; a++)
+                              {
+                                  const int rowStart = a*selfLen + pieceOffset;
+                                  const int i0       = std::max(r0 - rowStart, 0);
+                                  const int i1       = std::min(r1 - rowStart, len);
+                                  if (i0 < i1)
+                                  {
+                                      const real *src = in + (a*ownLen + g - ownLo)*block;
+                                      std::copy(src + i0*block, src + i1*block,
+                                                halo + (a*nwin + w + i0)*block);
+                                  }
+                              }
+                              pieceOffset += len;
+                          });
+#if GMX_MPI
+    if (num_ranks(ml, dim) > 1 && thread == 0)
+    {
+        communicate_halo(ml, pass, in, nouter, block, wLo, wHi);
+    }
+#endif
+    multilevel_barrier(nthread);
+
+    /* The output element i uses the halo elements (mul*i)/div + termOffset[i % div][t] */
+    const int         offset = two_scale_offset(ml);
+    const real       *c      = ml->twoScale.data();
+    int               mul    = 1;
+    int               div    = 1;
+    std::vector<int>  termOffset[2];
+    std::vector<real> termCoeff[2];
+    switch (pass.type)
+    {
+        case ePassCopy:
+            termOffset[0].push_back(-wLo);
+            termCoeff[0].push_back(1);
+            break;
+        case ePassRestrict:
+            mul = 2;
+            for (int k = 0; k <= ml->pme_order; k++)
+            {
+                termOffset[0].push_back(k - offset - wLo);
+                termCoeff[0].push_back(c[k]);
+            }
+            break;
+        case ePassProlongate:
+            div = 2;
+            for (int r = 0; r < 2; r++)
+            {
+                for (int k = (r + offset) % 2; k <= ml->pme_order; k += 2)
+                {
+                    termOffset[r].push_back((r + offset - k)/2 - wLo);
+                    termCoeff[r].push_back(c[k]);
+                }
+            }
+            break;
+        case ePassConvolve:
+            for (int k = 0; k <= pass.stencil->dmax - pass.stencil->dmin; k++)
+            {
+                termOffset[0].push_back(-pass.stencil->dmin - k - wLo);
+                termCoeff[0].push_back(pass.factor*pass.stencil->s[k]);
+            }
+            break;
+    }
+
+    int j0, j1;
+    thread_range(nouter*block, nthread, thread, &j0, &j1);
+    for (int a = (block > 0 ? j0/block : nouter); a < nouter && a*block < j1; a++)
+    {
+        const int b0 = std::max(j0 - a*block, 0);
+        const int b1 = std::min(j1 - a*block, block);
+        for (int i = 0; i < outLen; i++)
+        {
+            const int  gi   = lo + i;
+            const int  r    = gi % div;
+            const int  base = (mul*gi)/div;
+            real      *o    = out + (a*outLen + i)*block;
+            if (!bAdd)
+            {
+                std::fill(o + b0, o + b1, 0);
+            }
+            for (size_t t = 0; t < termOffset[r].size(); t++)
+            {
+                const real *ip = halo + (a*nwin + base + termOffset[r][t])*block;
+                const real  ct = termCoeff[r][t];
+                for (int b = b0; b < b1; b++)
+                {
+                    o[b] += ct*ip[b];
+                }
+            }
+        }
+    }
+    multilevel_barrier(nthread);
+}
+
+/*! \brief Restricts the charges of level \p l to level \p l + 1 */
+static void restrict_grid(pme_multilevel_t *ml, int l, int nthread, int thread)
+{
+    pme_multilevel_level_t &fine   = ml->level[l];
+    pme_multilevel_level_t &coarse = ml->level[l + 1];
+    const real             *in     = fine.q.data();
+    ivec                    nloc;
+
+    copy_ivec(fine.localSize, nloc);
+    for (int d = 0; d < DIM; d++)
+    {
+        /* Pass along x to tmp[0], along y to tmp[1], along z to the coarse grid */
+        real *out = (d == ZZ ? coarse.q.data() : ml->tmp[d].data());
+        apply_pass(ml, restrict_pass(ml, l, d), in, nloc, out, false, nthread, thread);
+        nloc[d] = coarse.localSize[d];
+        in      = out;
+    }
+}
+
+/*! \brief Prolongates the potential of level \p l + 1 to level \p l, overwriting it */
+static void prolongate_grid(pme_multilevel_t *ml, int l, int nthread, int thread)
+{
+    pme_multilevel_level_t &fine   = ml->level[l];
+    pme_multilevel_level_t &coarse = ml->level[l + 1];
+    const real             *in     = coarse.phi.data();
+    ivec                    nloc;
+
+    copy_ivec(coarse.localSize, nloc);
+    for (int d = ZZ; d >= 0; d--)
+    {
+        /* Pass along z to tmp[0], along y to tmp[1], along x to the fine grid */
+        real *out = (d == XX ? fine.phi.data() : ml->tmp[ZZ - d].data());
+        apply_pass(ml, prolongate_pass(ml, l, d), in, nloc, out, false, nthread, thread);
+        nloc[d] = fine.localSize[d];
+        in      = out;
+    }
+}
+
+/*! \brief Convolves \p in with the separable stencil \p stencil times \p factor on level \p lev
+ *
+ * The result is stored in, or with \p bAdd added to, \p out, which should
+ * not be ml->tmp[1].
+ */
+static void convolve_grid(pme_multilevel_t *ml, const pme_multilevel_level_t &lev,
+                          const pme_multilevel_stencil_t * const stencil[DIM],
+                          real factor, const real *in, real *out, bool bAdd,
+                          int nthread, int thread)
+{
+    for (int d = ZZ; d >= 0; d--)
+    {
+        /* Pass along z to tmp[0], along y to tmp[1], along x to out */
+        real *passOut = (d == XX ? out : ml->tmp[ZZ - d].data());
+        apply_pass(ml, convolve_pass(lev, d, stencil[d], d == XX ? factor : 1),
+                   in, lev.localSize, passOut, bAdd && d == XX, nthread, thread);
+        in = passOut;
+    }
+}
+
+/*! \brief 1D discrete Fourier transform of the complex grid along \p dim */
+static void dft_along_dim(pme_multilevel_t *ml, const ivec n, int dim, int sign,
+                          std::vector<t_complex> *line)
+{
+    const int stride[DIM] = { n[YY]*n[ZZ], n[ZZ], 1 };
+    const int dimA        = (dim == XX ? YY : XX);
+    const int dimB        = (dim == ZZ ? YY : ZZ);
+    const int nd          = n[dim];
+    const real *cosTable  = ml->cosTable[dim].data();
+    const real *sinTable  = ml->sinTable[dim].data();
+
+    line->resize(nd);
+    for (int a = 0; a < n[dimA]; a++)
+    {
+        for (int b = 0; b < n[dimB]; b++)
+        {
+            t_complex *data = ml->ctop.data() + a*stride[dimA] + b*stride[dimB];
+            for (int i = 0; i < nd; i++)
+            {
+                (*line)[i] = data[i*stride[dim]];
+            }
+            for (int m = 0; m < nd; m++)
+            {
+                real re = 0;
+                real im = 0;
+                for (int i = 0; i < nd; i++)
+                {
+                    int  mi = (m*i) % nd;
+                    real c  = cosTable[mi];
+                    real s  = sign*sinTable[mi];
+                    re     += (*line)[i].re*c - (*line)[i].im*s;
+                    im     += (*line)[i].im*c + (*line)[i].re*s;
+                }
+                data[m*stride[dim]].re = re;
+                data[m*stride[dim]].im = im;
+            }
+        }
+    }
+}
+
+/*! \brief Calls \p f(local index, global index, length) for the z-lines of the local block of \p lev */
+template <typename F>
+static void for_each_local_point(const pme_multilevel_level_t &lev, F f)
+{
+    const int *n     = lev.n;
+    const int *start = lev.localStart;
+    const int *size  = lev.localSize;
+    for (int x = 0; x < size[XX]; x++)
+    {
+        for (int y = 0; y < size[YY]; y++)
+        {
+            f((x*size[YY] + y)*size[ZZ],
+              ((start[XX] + x)*n[YY] + start[YY] + y)*n[ZZ] + start[ZZ], size[ZZ]);
+        }
+    }
+}
+
+/*! \brief Solves the top level in reciprocal space, as solve_pme_yzx()
+ *
+ * The top level is small, so with a decomposed grid the charges are summed
+ * over all ranks and every rank solves the whole top level.
+ * Should only be called by one thread. Adds the virial to \p work.
+ */
+static void solve_top_level(pme_multilevel_t *ml, gmx_bool bEnerVir,
+                            pme_multilevel_work_t *work)
+{
+    pme_multilevel_level_t &top = ml->level.back();
+    const int              *n   = top.n;
+    std::vector<t_complex>  line;
+
+    std::fill(ml->topLocal.begin(), ml->topLocal.end(), 0);
+    for_each_local_point(top, [&](int local, int global, int len)
+                         {
+                             std::copy(top.q.begin() + local, top.q.begin() + local + len,
+                                       ml->topLocal.begin() + global);
+                         });
+    std::vector<real> *topGrid = &ml->topLocal;
+#if GMX_MPI
+    std::vector<real> *topSum  = &ml->topGlobal;
+    for (int d = 0; d < c_multilevelNumDecompDims; d++)
+    {
+        if (ml->numRanks[d] > 1)
+        {
+            MPI_Allreduce(topGrid->data(), topSum->data(), topGrid->size(), GMX_MPI_REAL,
+                          MPI_SUM, ml->comm[d]);
+            std::swap(topGrid, topSum);
+        }
+    }
+#endif
+
+    ml->qsum = 0;
+    for (size_t i = 0; i < topGrid->size(); i++)
+    {
+        ml->ctop[i].re  = (*topGrid)[i];
+        ml->ctop[i].im  = 0;
+        ml->qsum       += (*topGrid)[i];
+    }
+
+    for (int d = 0; d < DIM; d++)
+    {
+        dft_along_dim(ml, n, d, -1, &line);
+    }
+
+    const real factor = M_PI*M_PI/(top.beta*top.beta);
+    const real vol    = ml->boxSize[XX]*ml->boxSize[YY]*ml->boxSize[ZZ];
+    double     vir[DIM][DIM];
+    for (int d = 0; d < DIM; d++)
+    {
+        for (int e = 0; e < DIM; e++)
+        {
+            vir[d][e] = 0;
+        }
+    }
+    for (int kx = 0; kx < n[XX]; kx++)
+    {
+        for (int ky = 0; ky < n[YY]; ky++)
+        {
+            for (int kz = 0; kz < n[ZZ]; kz++)
+            {
+                t_complex *c = &ml->ctop[(kx*n[YY] + ky)*n[ZZ] + kz];
+                if (kx == 0 && ky == 0 && kz == 0)
+                {
+                    c->re = 0;
+                    c->im = 0;
+                    continue;
+                }
+                rvec mh;
+                mh[XX] = (kx < (n[XX] + 1)/2 ? kx : kx - n[XX])/ml->boxSize[XX];
+                mh[YY] = (ky < (n[YY] + 1)/2 ? ky : ky - n[YY])/ml->boxSize[YY];
+                mh[ZZ] = (kz < (n[ZZ] + 1)/2 ? kz : kz - n[ZZ])/ml->boxSize[ZZ];
+                real m2    = norm2(mh);
+                real denom = M_PI*vol*m2*top.bsp_mod[XX][kx]*top.bsp_mod[YY][ky]*top.bsp_mod[ZZ][kz];
+                real eterm = ml->elfac*std::exp(-factor*m2)/denom;
+
+                if (bEnerVir)
+                {
+                    real struct2 = c->re*c->re + c->im*c->im;
+                    real ets2    = eterm*struct2;
+                    real vfactor = (factor*m2 + 1.0)*2.0/m2;
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        for (int e = 0; e < DIM; e++)
+                        {
+                            vir[d][e] += ets2*(vfactor*mh[d]*mh[e] - (d == e ? 1 : 0));
+                        }
+                    }
+                }
+                c->re *= eterm;
+                c->im *= eterm;
+            }
+        }
+    }
+
+    for (int d = 0; d < DIM; d++)
+    {
+        dft_along_dim(ml, n, d, 1, &line);
+    }
+    for_each_local_point(top, [&](int local, int global, int len)
+                         {
+                             for (int i = 0; i < len; i++)
+                             {
+                                 top.phi[local + i] = ml->ctop[global + i].re;
+                             }
+                         });
+
+    /* All ranks computed the same top level virial, only count it once */
+    if (bEnerVir && ml->bMaster)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            for (int e = 0; e < DIM; e++)
+            {
+                work->vir[d][e] += 0.25*vir[d][e];
+            }
+        }
+    }
+}
+
+/*! \brief Returns the sum of a*b over the part of the grids of size \p n for this thread */
+static real thread_dot(const std::vector<real> &a, const real *b, int n,
+                       int nthread, int thread)
+{
+    int    i0, i1;
+    thread_range(n, nthread, thread, &i0, &i1);
+    /* Use double, since there is strong cancellation between terms */
+    double sum = 0;
+    for (int i = i0; i < i1; i++)
+    {
+        sum += a[i]*b[i];
+    }
+
+    return sum;
+}
+
+/*! \brief Returns the number of points of the whole grid of level \p lev */
+static int global_grid_size(const pme_multilevel_level_t &lev)
+{
+    return lev.n[XX]*lev.n[YY]*lev.n[ZZ];
+}
+
+/*! \brief Adds the virial of the Gaussian kernels of level \p l to the thread virial
+ *
+ * The virial of the pair potential sum_j w_j exp(-t_j^2 r^2) is
+ * 1/2 sum_pairs q q (-w_j t_j^2) r_a r_b exp(-t_j^2 r^2), which is separable
+ * in the same way as the potential.
+ */
+static int add_level_virial(pme_multilevel_t *ml, int l,
+                            pme_multilevel_work_t *work, int nthread, int thread)
+{
+    pme_multilevel_level_t &lev    = ml->level[l];
+    const int               nlocal = lev.q.size();
+    int                     count  = 0;
+
+    for (int a = 0; a < DIM; a++)
+    {
+        for (int b = a; b < DIM; b++)
+        {
+            for (size_t j = 0; j < lev.t.size(); j++)
+            {
+                const pme_multilevel_stencil_t *stencil[DIM];
+                real                            meanFactor = 1;
+                for (int d = 0; d < DIM; d++)
+                {
+                    int kernel = eKernelGauss;
+                    if (a == b && d == a)
+                    {
+                        kernel = eKernelGaussX2;
+                    }
+                    else if (a != b && (d == a || d == b))
+                    {
+                        kernel = eKernelGaussX;
+                    }
+                    stencil[d]  = &lev.stencil[j*eKernelNR + kernel][d];
+                    meanFactor *= stencil[d]->sum;
+                }
+                real weight = -lev.w[j]*lev.t[j]*lev.t[j];
+
+                convolve_grid(ml, lev, stencil, weight, lev.q.data(),
+                              ml->tmp[0].data(), false, nthread, thread);
+                work->vir[a][b] += 0.5*thread_dot(lev.q, ml->tmp[0].data(), nlocal, nthread, thread);
+                if (thread == 0 && ml->bMaster)
+                {
+                    /* Remove the zero frequency component, as in reciprocal space */
+                    work->vir[a][b] -= 0.5*weight*meanFactor*ml->qsum*ml->qsum/global_grid_size(lev);
+                }
+                multilevel_barrier(nthread);
+                count += nlocal/nthread;
+            }
+        }
+    }
+
+    return count;
+}
+
+int pme_multilevel_solve(pme_multilevel_t *ml, real *grid, gmx_bool bEnerVir,
+                         int nthread, int thread)
+{
+    pme_multilevel_work_t  *work   = &ml->work[thread];
+    pme_multilevel_level_t &lev0   = ml->level[0];
+    const int               nlevel = ml->level.size();
+    const int              *n      = lev0.localSize;
+    int                     x0, x1;
+    int                     count  = 0;
+
+    thread_range(n[XX], nthread, thread, &x0, &x1);
+
+    work->energy = 0;
+    clear_mat(work->vir);
+
+    for (int x = x0; x < x1; x++)
+    {
+        for (int y = 0; y < n[YY]; y++)
+        {
+            const real *gridLine = grid + (x*ml->paddedSize[YY] + y)*ml->paddedSize[ZZ];
+            std::copy(gridLine, gridLine + n[ZZ], lev0.q.begin() + (x*n[YY] + y)*n[ZZ]);
+        }
+    }
+    multilevel_barrier(nthread);
+
+    for (int l = 0; l < nlevel - 1; l++)
+    {
+        restrict_grid(ml, l, nthread, thread);
+    }
+
+    if (thread == 0)
+    {
+        solve_top_level(ml, bEnerVir, work);
+    }
+    multilevel_barrier(nthread);
+
+    for (int l = nlevel - 2; l >= 0; l--)
+    {
+        pme_multilevel_level_t &lev    = ml->level[l];
+        const int               nlocal = lev.q.size();
+
+        prolongate_grid(ml, l, nthread, thread);
+
+        for (size_t j = 0; j < lev.t.size(); j++)
+        {
+            const auto                     &stencilDims = lev.stencil[j*eKernelNR + eKernelGauss];
+            const pme_multilevel_stencil_t *stencil[DIM] = { &stencilDims[XX], &stencilDims[YY], &stencilDims[ZZ] };
+            convolve_grid(ml, lev, stencil, lev.w[j], lev.q.data(),
+                          lev.phi.data(), true, nthread, thread);
+            count += nlocal/nthread;
+        }
+
+        /* Remove the zero frequency component, as in reciprocal space */
+        const real shift = lev.stencilSum*ml->qsum/global_grid_size(lev);
+        int        i0, i1;
+        thread_range(nlocal, nthread, thread, &i0, &i1);
+        for (int i = i0; i < i1; i++)
+        {
+            lev.phi[i] -= shift;
+        }
+        multilevel_barrier(nthread);
+
+        if (bEnerVir)
+        {
+            count += add_level_virial(ml, l, work, nthread, thread);
+        }
+    }
+
+    for (int x = x0; x < x1; x++)
+    {
+        for (int y = 0; y < n[YY]; y++)
+        {
+            const real *phiLine = lev0.phi.data() + (x*n[YY] + y)*n[ZZ];
+            std::copy(phiLine, phiLine + n[ZZ], grid + (x*ml->paddedSize[YY] + y)*ml->paddedSize[ZZ]);
+        }
+    }
+
+    if (bEnerVir)
+    {
+        work->energy = 0.5*thread_dot(lev0.q, lev0.phi.data(), lev0.q.size(), nthread, thread);
+        for (int a = 0; a < DIM; a++)
+        {
+            for (int b = 0; b < a; b++)
+            {
+                work->vir[a][b] = work->vir[b][a];
+            }
+        }
+    }
+
+    return count;
+}
+
+void get_pme_multilevel_ener_vir(const pme_multilevel_t *ml, int nthread,
+                                 real *mesh_energy, matrix vir)
+{
+    *mesh_energy = 0;
+    clear_mat(vir);
+    for (int thread = 0; thread < nthread; thread++)
+    {
+        *mesh_energy += ml->work[thread].energy;
+        m_add(vir, ml->work[thread].vir, vir);
+    }
+}
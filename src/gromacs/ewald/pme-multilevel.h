@@ -0,0 +1,129 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Declares the multilevel summation solver for the PME grid.
+ *
+ * This is an alternative to the FFT-based solve in pme-solve.cpp.
+ * The long-range kernel erf(beta r)/r is split over a hierarchy of
+ * grids, each level twice as coarse as the previous one and handling
+ * the Gaussian-smoothed difference kernel
+ * (erf(beta_l r) - erf(beta_l/2 r))/r with beta_l = beta/2^l.
+ * These kernels decay fast, so each level only needs a convolution
+ * with a short stencil, i.e. communication with nearby grid points only.
+ * They are approximated by a sum of Gaussians, which makes the stencils
+ * separable into three 1D stencils. Only on the top level, which is small,
+ * is the remaining periodic kernel computed in reciprocal space.
+ * The charge grid is restricted to coarser levels, and the potential
+ * prolongated back, exactly using the two-scale relation of the PME
+ * B-splines, so the spreading and gathering of PME are used unchanged.
+ * With a decomposed PME grid, each operation along a decomposed dimension
+ * first communicates the halo it needs with the ranks along that dimension.
+ * The top level grid is summed over the ranks and solved by every rank,
+ * which is cheap, since it is small.
+ *
+ * \ingroup module_ewald
+ */
+#ifndef GMX_EWALD_PME_MULTILEVEL_H
+#define GMX_EWALD_PME_MULTILEVEL_H
+
+#include "gromacs/math/vectypes.h"
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/gmxmpi.h"
+#include "gromacs/utility/real.h"
+
+struct pme_multilevel_t;
+
+/*! \brief The default relative accuracy of the multilevel solver */
+constexpr real c_pmeMultilevelDefaultTolerance = 1e-5;
+
+/*! \brief Creates the multilevel solver for a, possibly decomposed, PME grid
+ *
+ * The PME grid can be decomposed along x and y, the local part of the grid
+ * should match the real-space decomposition of the PME FFT grid.
+ * With decomposition this is a collective call over the communicators.
+ *
+ * \param[in] gridSize        The size of the PME grid
+ * \param[in] localOffset     The offset of the local part of the PME grid
+ * \param[in] localSize       The size of the local part of the PME grid
+ * \param[in] paddedLocalSize The size of the local (padded) real FFT grid the charges are stored in
+ * \param[in] pme_order       The PME interpolation order
+ * \param[in] ewaldcoeff      The Ewald splitting coefficient
+ * \param[in] epsilon_r       The relative dielectric constant
+ * \param[in] tolerance       The maximum error in the long-range kernel relative to its maximum,
+ *                            this sets the quadrature order and the stencil lengths
+ * \param[in] nthread         The number of OpenMP threads that will call pme_multilevel_solve()
+ * \param[in] numRanks        The number of PME ranks along x and y
+ * \param[in] rankIndex       The index of this rank along x and y
+ * \param[in] comm            The communicators along x and y, only used with more than one rank
+ */
+pme_multilevel_t *pme_multilevel_init(const ivec gridSize, const ivec localOffset,
+                                      const ivec localSize, const ivec paddedLocalSize,
+                                      int pme_order, real ewaldcoeff, real epsilon_r,
+                                      real tolerance, int nthread,
+                                      const int numRanks[], const int rankIndex[],
+                                      const MPI_Comm comm[]);
+
+/*! \brief Frees the multilevel solver */
+void pme_multilevel_destroy(pme_multilevel_t *ml);
+
+/*! \brief Returns the number of grid levels, including the finest and the top level */
+int pme_multilevel_nlevels(const pme_multilevel_t *ml);
+
+/*! \brief Sets the box, updates the stencils when the box changed
+ *
+ * Only rectangular boxes are supported, gives a fatal error otherwise.
+ * Should be called outside OpenMP parallel regions.
+ */
+void pme_multilevel_set_box(pme_multilevel_t *ml, const matrix box);
+
+/*! \brief Replaces the charges on \p grid by the long-range potential
+ *
+ * Should be called by all \p nthread threads, inside an OpenMP parallel region
+ * when nthread > 1, and by all PME ranks. The grid has the layout of
+ * the local part of the real PME FFT grid.
+ * Returns the number of stencil operations done by this thread.
+ */
+int pme_multilevel_solve(pme_multilevel_t *ml, real *grid, gmx_bool bEnerVir,
+                         int nthread, int thread);
+
+/*! \brief Get the energy and virial of the last pme_multilevel_solve() call with bEnerVir=TRUE
+ *
+ * With decomposition these are the contributions of this rank.
+ */
+void get_pme_multilevel_ener_vir(const pme_multilevel_t *ml, int nthread,
+                                 real *mesh_energy, matrix vir);
+
+#endif
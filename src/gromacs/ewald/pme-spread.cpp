@@ -706,9 +706,6 @@ static void sum_fftgrid_dd(const gmx_pme_t *pme, real *fftgrid, int grid_index)
     ivec local_fft_ndata, local_fft_offset, local_fft_size;
     int  send_index0, send_nindex;
     int  recv_nindex;
-#if GMX_MPI
-    MPI_Status stat;
-#endif
     int  recv_size_y;
     int  ipulse, size_yx;
     real *sendptr, *recvptr;
@@ -767,11 +764,10 @@ static void sum_fftgrid_dd(const gmx_pme_t *pme, real *fftgrid, int grid_index)
 #if GMX_MPI
             int send_id = overlap->send_id[ipulse];
             int recv_id = overlap->recv_id[ipulse];
-            MPI_Sendrecv(sendptr, send_size_y*datasize, GMX_MPI_REAL,
-                         send_id, ipulse,
-                         recvptr, recv_size_y*datasize, GMX_MPI_REAL,
-                         recv_id, ipulse,
-                         overlap->mpi_comm, &stat);
+            pme_grid_sendrecv(pme, overlap,
+                              sendptr, send_size_y*datasize, send_id,
+                              recvptr, recv_size_y*datasize, recv_id,
+                              ipulse);
 #endif
 
             for (x = 0; x < local_fft_ndata[XX]; x++)
@@ -835,11 +831,10 @@ static void sum_fftgrid_dd(const gmx_pme_t *pme, real *fftgrid, int grid_index)
         int send_id  = overlap->send_id[ipulse];
         int recv_id  = overlap->recv_id[ipulse];
         sendptr      = overlap->sendbuf;
-        MPI_Sendrecv(sendptr, send_nindex*datasize, GMX_MPI_REAL,
-                     send_id, ipulse,
-                     recvptr, recv_nindex*datasize, GMX_MPI_REAL,
-                     recv_id, ipulse,
-                     overlap->mpi_comm, &stat);
+        pme_grid_sendrecv(pme, overlap,
+                          sendptr, send_nindex*datasize, send_id,
+                          recvptr, recv_nindex*datasize, recv_id,
+                          ipulse);
 #endif
 
         for (x = 0; x < recv_nindex; x++)
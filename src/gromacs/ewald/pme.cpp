@@ -112,6 +112,7 @@
 #include "pme-gather.h"
 #include "pme-grid.h"
 #include "pme-internal.h"
+#include "pme-multilevel.h"
 #include "pme-redistribute.h"
 #include "pme-solve.h"
 #include "pme-spline-work.h"
@@ -292,7 +293,8 @@ init_overlap_comm(pme_overlap_t *  ol,
                   int              nnodes,
                   int              nodeid,
                   int              ndata,
-                  int              commplainsize)
+                  int              commplainsize,
+                  gmx_bool         bCompress)
 {
     int              b, i;
     pme_grid_comm_t *pgc;
@@ -413,6 +415,11 @@ init_overlap_comm(pme_overlap_t *  ol,
     /* For non-divisible grid we need pme_order iso pme_order-1 */
     snew(ol->sendbuf, norder*commplainsize);
     snew(ol->recvbuf, norder*commplainsize);
+    if (bCompress)
+    {
+        snew(ol->sendbuf_compressed, pme_grid_compressed_size(norder*commplainsize));
+        snew(ol->recvbuf_compressed, pme_grid_compressed_size(norder*commplainsize));
+    }
 }
 
 /*! \brief Destroy data structure for communication */
@@ -426,6 +433,8 @@ destroy_overlap_comm(const pme_overlap_t *ol)
     sfree(ol->comm_data);
     sfree(ol->sendbuf);
     sfree(ol->recvbuf);
+    sfree(ol->sendbuf_compressed);
+    sfree(ol->recvbuf_compressed);
 }
 
 int minimalPmeGridSize(int pmeOrder)
@@ -502,6 +511,30 @@ static int div_round_up(int enumerator, int denominator)
     return (enumerator + denominator - 1)/denominator;
 }
 
+void gmx_pme_init_multilevel(gmx_pme_t *pme, real tolerance)
+{
+    ivec localSize, localOffset, paddedLocalSize;
+    gmx_parallel_3dfft_real_limits(pme->pfft_setup[PME_GRID_QA], localSize, localOffset, paddedLocalSize);
+
+    const ivec gridSize  = { pme->nkx, pme->nky, pme->nkz };
+    const int  numRanks[2]  = { pme->nnodes_major, pme->nnodes_minor };
+    const int  rankIndex[2] = { pme->nodeid_major, pme->nodeid_minor };
+#if GMX_MPI
+    const MPI_Comm *comm = pme->mpi_comm_d;
+#else
+    const MPI_Comm  comm[2] = { MPI_COMM_NULL, MPI_COMM_NULL };
+#endif
+    pme->multilevel = pme_multilevel_init(gridSize, localOffset, localSize, paddedLocalSize,
+                                          pme->pme_order, pme->ewaldcoeff_q, pme->epsilon_r,
+                                          tolerance, pme->nthread,
+                                          numRanks, rankIndex, comm);
+    if (debug)
+    {
+        fprintf(debug, "PME: using the multilevel solver with %d levels, tolerance %g\n",
+                pme_multilevel_nlevels(pme->multilevel), tolerance);
+    }
+}
+
 int gmx_pme_init(struct gmx_pme_t **pmedata,
                  t_commrec *        cr,
                  int                nnodes_major,
@@ -511,6 +544,7 @@ int gmx_pme_init(struct gmx_pme_t **pmedata,
                  gmx_bool           bFreeEnergy_q,
                  gmx_bool           bFreeEnergy_lj,
                  gmx_bool           bReproducible,
+                 gmx_bool           bCompressGridComm,
                  real               ewaldcoeff_q,
                  real               ewaldcoeff_lj,
                  int                nthread)
@@ -702,6 +736,9 @@ int gmx_pme_init(struct gmx_pme_t **pmedata,
         }
     }
 
+    /* Reduced precision grid overlap communication, see pme_grid_compress() */
+    pme->bCompressGridComm = (pme->nnodes > 1 && bCompressGridComm);
+
     /* For non-divisible grid we need pme_order iso pme_order-1 */
     /* In sum_qgrid_dd x overlap is copied in place: take padding into account.
      * y is always copied through a buffer: we don't need padding in z,
@@ -713,7 +750,8 @@ int gmx_pme_init(struct gmx_pme_t **pmedata,
 #endif
                       pme->nnodes_major, pme->nodeid_major,
                       pme->nkx,
-                      (div_round_up(pme->nky, pme->nnodes_minor)+pme->pme_order)*(pme->nkz+pme->pme_order-1));
+                      (div_round_up(pme->nky, pme->nnodes_minor)+pme->pme_order)*(pme->nkz+pme->pme_order-1),
+                      pme->bCompressGridComm);
 
     /* Along overlap dim 1 we can send in multiple pulses in sum_fftgrid_dd.
      * We do this with an offset buffer of equal size, so we need to allocate
@@ -725,7 +763,8 @@ int gmx_pme_init(struct gmx_pme_t **pmedata,
 #endif
                       pme->nnodes_minor, pme->nodeid_minor,
                       pme->nky,
-                      (div_round_up(pme->nkx, pme->nnodes_major)+pme->pme_order+1)*pme->nkz);
+                      (div_round_up(pme->nkx, pme->nnodes_major)+pme->pme_order+1)*pme->nkz,
+                      pme->bCompressGridComm);
 
     /* Double-check for a limitation of the (current) sum_fftgrid_dd code.
      * Note that gmx_pme_check_restrictions checked for this already.
@@ -842,6 +881,25 @@ int gmx_pme_init(struct gmx_pme_t **pmedata,
 
     pme_init_all_work(&pme->solve_work, pme->nthread, pme->nkx);
 
+    const char *multilevelEnv = getenv("GMX_PME_MULTILEVEL");
+    if (multilevelEnv != nullptr && pme->doCoulomb)
+    {
+        if (ir->epc != epcNO && ir->epct == epctANISOTROPIC)
+        {
+            gmx_fatal(FARGS, "The multilevel PME solver (GMX_PME_MULTILEVEL) only supports rectangular boxes and can not be used with anisotropic pressure coupling");
+        }
+        if (ir->deform[YY][XX] != 0 || ir->deform[ZZ][XX] != 0 || ir->deform[ZZ][YY] != 0)
+        {
+            gmx_fatal(FARGS, "The multilevel PME solver (GMX_PME_MULTILEVEL) only supports rectangular boxes and can not be used with off-diagonal box deformation");
+        }
+        real tolerance = strtod(multilevelEnv, nullptr);
+        if (tolerance <= 0)
+        {
+            tolerance = c_pmeMultilevelDefaultTolerance;
+        }
+        gmx_pme_init_multilevel(pme.get(), tolerance);
+    }
+
     // no exception was thrown during the init, so we hand over the PME structure handle
     *pmedata = pme.release();
 
@@ -886,7 +944,7 @@ int gmx_pme_reinit(struct gmx_pme_t **pmedata,
     try
     {
         ret = gmx_pme_init(pmedata, cr, pme_src->nnodes_major, pme_src->nnodes_minor,
-                           &irc, homenr, pme_src->bFEP_q, pme_src->bFEP_lj, FALSE, ewaldcoeff_q, ewaldcoeff_lj, pme_src->nthread);
+                           &irc, homenr, pme_src->bFEP_q, pme_src->bFEP_lj, FALSE, pme_src->bCompressGridComm, ewaldcoeff_q, ewaldcoeff_lj, pme_src->nthread);
     }
     GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
 
@@ -1033,6 +1091,10 @@ int gmx_pme_do(struct gmx_pme_t *pme,
     }
 
     gmx::invertBoxMatrix(box, pme->recipbox);
+    if (pme->multilevel)
+    {
+        pme_multilevel_set_box(pme->multilevel, box);
+    }
     bFirst = TRUE;
 
     /* For simplicity, we construct the splines for all particles if
@@ -1085,6 +1147,9 @@ int gmx_pme_do(struct gmx_pme_t *pme,
 
         grid = pmegrid->grid.grid;
 
+        /* The multilevel solver replaces the FFTs and solve for Coulomb */
+        const gmx_bool bMultilevel = (pme->multilevel != nullptr && grid_index < DO_Q);
+
         if (debug)
         {
             fprintf(debug, "PME: number of ranks = %d, rank = %d\n",
@@ -1165,7 +1230,39 @@ int gmx_pme_do(struct gmx_pme_t *pme,
             try
             {
                 thread = gmx_omp_get_thread_num();
-                if (flags & GMX_PME_SOLVE)
+                if (bMultilevel)
+                {
+                    /* Solve on the real grid, without FFTs */
+                    if (flags & GMX_PME_SOLVE)
+                    {
+                        if (thread == 0)
+                        {
+                            wallcycle_start(wcycle, ewcPME_SOLVE);
+                        }
+                        int loop_count =
+                            pme_multilevel_solve(pme->multilevel, fftgrid,
+                                                 bCalcEnerVir,
+                                                 pme->nthread, thread);
+                        if (thread == 0)
+                        {
+                            wallcycle_stop(wcycle, ewcPME_SOLVE);
+                            inc_nrnb(nrnb, eNR_SOLVEPME, loop_count);
+                        }
+                    }
+                    if (bBackFFT)
+                    {
+                        if (thread == 0)
+                        {
+                            /* Note: this wallcycle region is closed below
+                               outside an OpenMP region, so take care if
+                               refactoring code here. */
+                            wallcycle_start(wcycle, ewcPME_SPREADGATHER);
+                        }
+#pragma omp barrier
+                        copy_fftgrid_to_pmegrid(pme, fftgrid, grid, grid_index, pme->nthread, thread);
+                    }
+                }
+                else if (flags & GMX_PME_SOLVE)
                 {
                     int loop_count;
 
@@ -1212,7 +1309,7 @@ int gmx_pme_do(struct gmx_pme_t *pme,
                     }
                 }
 
-                if (bBackFFT)
+                if (bBackFFT && !bMultilevel)
                 {
                     /* do 3d-invfft */
                     if (thread == 0)
@@ -1301,7 +1398,11 @@ int gmx_pme_do(struct gmx_pme_t *pme,
             /* This should only be called on the master thread
              * and after the threads have synchronized.
              */
-            if (grid_index < 2)
+            if (bMultilevel)
+            {
+                get_pme_multilevel_ener_vir(pme->multilevel, pme->nthread, &energy_AB[grid_index], vir_AB[grid_index]);
+            }
+            else if (grid_index < 2)
             {
                 get_pme_ener_vir_q(pme->solve_work, pme->nthread, &energy_AB[grid_index], vir_AB[grid_index]);
             }
@@ -1724,6 +1825,11 @@ void gmx_pme_destroy(gmx_pme_t *pme)
 
     pme_free_all_work(&pme->solve_work, pme->nthread);
 
+    if (pme->multilevel)
+    {
+        pme_multilevel_destroy(pme->multilevel);
+    }
+
     sfree(pme->sum_qgrid_tmp);
     sfree(pme->sum_qgrid_dd_tmp);
 
@@ -85,6 +85,10 @@ bool gmx_pme_check_restrictions(int pme_order,
                                 bool errorsAreFatal);
 
 /*! \brief Initialize \p pmedata
+ *
+ * With \p bCompressGridComm the grid overlap between PME ranks is
+ * communicated in compressed, reduced precision form, see
+ * pme_grid_compress(). All PME ranks should pass the same value.
  *
  * \returns  0 indicates all well, non zero is an error code.
  * \throws   gmx::InconsistentInputError if input grid sizes/PME order are inconsistent.
@@ -93,7 +97,7 @@ int gmx_pme_init(struct gmx_pme_t **pmedata, struct t_commrec *cr,
                  int nnodes_major, int nnodes_minor,
                  const t_inputrec *ir, int homenr,
                  gmx_bool bFreeEnergy_q, gmx_bool bFreeEnergy_lj,
-                 gmx_bool bReproducible,
+                 gmx_bool bReproducible, gmx_bool bCompressGridComm,
                  real ewaldcoeff_q, real ewaldcoeff_lj,
                  int nthread);
 
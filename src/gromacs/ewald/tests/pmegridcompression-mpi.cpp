@@ -0,0 +1,188 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests that compressed PME grid overlap communication gives forces
+ * close to those with full-precision communication.
+ *
+ * \ingroup module_ewald
+ */
+
+#include "gmxpre.h"
+
+#include <cmath>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/domdec/domdec_struct.h"
+#include "gromacs/ewald/pme.h"
+#include "gromacs/ewald/pme-internal.h"
+#include "gromacs/gmxlib/network.h"
+#include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/math/calculate-ewald-splitting-coefficient.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdtypes/commrec.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/mpitest.h"
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of PME ranks
+const int  c_numRanks = 2;
+//! The total number of atoms
+const int  c_numAtoms = 200;
+//! The edge of the cubic box in nm
+const real c_boxSize  = 3.0;
+
+/*! \brief The maximum force error relative to the largest force
+ *
+ * The grid values are communicated with a relative precision of
+ * 1/65534 of the block maximum, the resulting force errors should be
+ * a few times smaller than this tolerance.
+ */
+const real c_relativeForceTolerance = 1e-4;
+
+/*! \brief Computes the PME mesh forces on the home atoms of this rank
+ *
+ * Rank r has atoms r, r + c_numRanks, ..., so most atoms need to be
+ * redistributed to the rank that owns their part of the grid.
+ */
+std::vector<RVec> computePmeForces(t_commrec *cr, const t_inputrec &ir, real ewaldCoeff,
+                                   bool bCompress, real *energy)
+{
+    std::vector<RVec> x;
+    std::vector<real> q;
+    for (int i = cr->nodeid; i < c_numAtoms; i += c_numRanks)
+    {
+        /* Deterministic, irregular positions and neutral charges */
+        x.push_back(RVec(c_boxSize*std::fmod(0.618034*i, 1.0),
+                         c_boxSize*std::fmod(0.414214*i + 0.1, 1.0),
+                         c_boxSize*std::fmod(0.732051*i + 0.2, 1.0)));
+        q.push_back(i % 2 == 0 ? 0.8 : -0.8);
+    }
+    int               homenr = x.size();
+    std::vector<RVec> f(homenr, RVec(0, 0, 0));
+
+    gmx_pme_t *pme = nullptr;
+    gmx_pme_init(&pme, cr, c_numRanks, 1, &ir, homenr,
+                 FALSE, FALSE, TRUE, bCompress, ewaldCoeff, 0, 1);
+    EXPECT_EQ(bCompress, static_cast<bool>(pme->bCompressGridComm));
+
+    matrix box = {{ 0 }};
+    for (int d = 0; d < DIM; d++)
+    {
+        box[d][d] = c_boxSize;
+    }
+    t_nrnb nrnb;
+    init_nrnb(&nrnb);
+    matrix vir_q, vir_lj;
+    clear_mat(vir_q);
+    clear_mat(vir_lj);
+    real   energy_q    = 0, energy_lj = 0;
+    real   dvdlambda_q = 0, dvdlambda_lj = 0;
+    gmx_pme_do(pme, 0, homenr, as_rvec_array(x.data()), as_rvec_array(f.data()),
+               q.data(), nullptr, nullptr, nullptr, nullptr, nullptr,
+               box, cr, 1, 0, &nrnb, nullptr,
+               vir_q, vir_lj, &energy_q, &energy_lj, 0, 0, &dvdlambda_q, &dvdlambda_lj,
+               GMX_PME_DO_ALL_F | GMX_PME_CALC_ENER_VIR);
+    gmx_pme_destroy(pme);
+
+    gmx_sum(1, &energy_q, cr);
+    *energy = energy_q;
+
+    return f;
+}
+
+TEST(PmeGridCompressionMpiTest, ForcesMatchFullPrecisionCommunication)
+{
+    GMX_MPI_TEST(c_numRanks);
+    t_commrec *cr = init_commrec();
+    /* With thread-MPI the commrec is only set up for the threads here */
+    gmx_fill_commrec_from_mpi(cr);
+    /* gmx_pme_do only redistributes atoms over the PME ranks with DD */
+    snew(cr->dd, 1);
+
+    t_inputrec ir;
+    ir.coulombtype = eelPME;
+    ir.nkx         = 28;
+    ir.nky         = 28;
+    ir.nkz         = 28;
+    ir.pme_order   = 4;
+    ir.epsilon_r   = 1;
+    real       ewaldCoeff = calc_ewaldcoeff_q(0.9, 1e-5);
+
+    real              energyRef, energy;
+    std::vector<RVec> fRef = computePmeForces(cr, ir, ewaldCoeff, false, &energyRef);
+    std::vector<RVec> f    = computePmeForces(cr, ir, ewaldCoeff, true, &energy);
+
+    real fMax = 0;
+    for (const RVec &fi : fRef)
+    {
+        fMax = std::max(fMax, norm(fi));
+    }
+    ASSERT_GT(fMax, 0);
+
+    FloatingPointTolerance tolerance = absoluteTolerance(c_relativeForceTolerance*fMax);
+    for (size_t i = 0; i < f.size(); i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_REAL_EQ_TOL(fRef[i][d], f[i][d], tolerance)
+            << "for atom " << cr->nodeid + i*c_numRanks << " dimension " << d;
+        }
+    }
+    EXPECT_REAL_EQ_TOL(energyRef, energy,
+                       relativeToleranceAsFloatingPoint(energyRef, c_relativeForceTolerance));
+
+    sfree(cr->dd);
+    cr->dd = nullptr;
+    done_commrec(cr);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -0,0 +1,139 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements tests for the compression of PME grid overlap communication.
+ *
+ * \ingroup module_ewald
+ */
+
+#include "gmxpre.h"
+
+#include <cmath>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/ewald/pme-grid.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! Compresses and decompresses \p input and returns the result
+std::vector<real> roundTrip(const std::vector<real> &input)
+{
+    int               n = input.size();
+    std::vector<char> compressed(pme_grid_compressed_size(n));
+    std::vector<real> output(n);
+
+    pme_grid_compress(input.data(), n, compressed.data());
+    pme_grid_decompress(compressed.data(), n, output.data());
+
+    return output;
+}
+
+TEST(PmeGridCompressionTest, SizeIsReduced)
+{
+    int n = 10*c_pmeGridCompressionBlockSize;
+
+    EXPECT_LT(pme_grid_compressed_size(n), static_cast<int>(0.6*n*sizeof(real)));
+    EXPECT_EQ(0, pme_grid_compressed_size(0));
+}
+
+TEST(PmeGridCompressionTest, ErrorIsBounded)
+{
+    /* Values spanning many orders of magnitude and both signs, with a partial last block */
+    int               n = 5*c_pmeGridCompressionBlockSize + 7;
+    std::vector<real> input(n);
+    for (int i = 0; i < n; i++)
+    {
+        input[i] = std::sin(0.37*i)*std::pow(10.0, (i % 11) - 5);
+    }
+
+    std::vector<real> output = roundTrip(input);
+
+    for (int b = 0; b < n; b += c_pmeGridCompressionBlockSize)
+    {
+        int  bEnd   = std::min(n, b + c_pmeGridCompressionBlockSize);
+        real absmax = 0;
+        for (int i = b; i < bEnd; i++)
+        {
+            absmax = std::max(absmax, std::abs(input[i]));
+        }
+        /* Allow for the float rounding of the scaling factor */
+        real tolerance = 1.001*absmax/65534;
+        for (int i = b; i < bEnd; i++)
+        {
+            EXPECT_NEAR(input[i], output[i], tolerance) << "for element " << i;
+        }
+    }
+}
+
+TEST(PmeGridCompressionTest, BlockMaximumIsExact)
+{
+    std::vector<real> input(c_pmeGridCompressionBlockSize, 0.25);
+    input[3] = -2.5;
+
+    std::vector<real> output = roundTrip(input);
+
+    EXPECT_REAL_EQ_TOL(-2.5, output[3], relativeToleranceAsFloatingPoint(2.5, 1e-6));
+}
+
+TEST(PmeGridCompressionTest, ZeroBlockStaysZero)
+{
+    std::vector<real> input(2*c_pmeGridCompressionBlockSize + 3, 0);
+    input[c_pmeGridCompressionBlockSize + 1] = 1;
+
+    std::vector<real> output = roundTrip(input);
+
+    for (int i = 0; i < c_pmeGridCompressionBlockSize; i++)
+    {
+        EXPECT_EQ(0, output[i]);
+    }
+    EXPECT_REAL_EQ_TOL(1, output[c_pmeGridCompressionBlockSize + 1], relativeToleranceAsFloatingPoint(1, 1e-6));
+    EXPECT_EQ(0, output[2*c_pmeGridCompressionBlockSize + 2]);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -0,0 +1,230 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests that the multilevel PME solver gives the same results with
+ * a PME grid decomposed over ranks as with a single rank.
+ *
+ * \ingroup module_ewald
+ */
+
+#include "gmxpre.h"
+
+#include <cmath>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/domdec/domdec_struct.h"
+#include "gromacs/ewald/pme.h"
+#include "gromacs/ewald/pme-internal.h"
+#include "gromacs/ewald/pme-multilevel.h"
+#include "gromacs/gmxlib/network.h"
+#include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/math/calculate-ewald-splitting-coefficient.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdtypes/commrec.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/mpitest.h"
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of PME ranks
+const int  c_numRanks = 2;
+//! The total number of atoms
+const int  c_numAtoms = 200;
+//! The box size in nm
+const rvec c_boxSize  = { 3.0, 3.2, 2.8 };
+
+/*! \brief The maximum difference relative to the largest value
+ *
+ * The decomposed solver does the same operations as the serial one,
+ * only the order of the summations over ranks and threads differs.
+ */
+const real c_relativeTolerance = 1e-5;
+
+/*! \brief Computes the multilevel PME mesh forces, energy and virial
+ *
+ * With \p numRanksX times \p numRanksY PME ranks, rank r has atoms
+ * r, r + c_numRanks, ..., otherwise this rank has all atoms.
+ * The energy and virial are summed over the ranks.
+ */
+std::vector<RVec> computeMultilevelForces(t_commrec *cr, const t_inputrec &ir, real ewaldCoeff,
+                                          int numRanksX, int numRanksY,
+                                          real *energy, matrix vir)
+{
+    const bool        bDecomposed = (numRanksX*numRanksY > 1);
+    std::vector<RVec> x;
+    std::vector<real> q;
+    for (int i = (bDecomposed ? cr->nodeid : 0); i < c_numAtoms; i += (bDecomposed ? c_numRanks : 1))
+    {
+        /* Deterministic, irregular positions and neutral charges */
+        x.push_back(RVec(c_boxSize[XX]*std::fmod(0.618034*i, 1.0),
+                         c_boxSize[YY]*std::fmod(0.414214*i + 0.1, 1.0),
+                         c_boxSize[ZZ]*std::fmod(0.732051*i + 0.2, 1.0)));
+        q.push_back(i % 2 == 0 ? 0.8 : -0.8);
+    }
+    int               homenr = x.size();
+    std::vector<RVec> f(homenr, RVec(0, 0, 0));
+
+    gmx_pme_t        *pme = nullptr;
+    gmx_pme_init(&pme, cr, numRanksX, numRanksY, &ir, homenr,
+                 FALSE, FALSE, TRUE, FALSE, ewaldCoeff, 0, 1);
+    gmx_pme_init_multilevel(pme, 1e-6);
+    /* 32, 36 and 30 give three levels, the coarser levels are split
+     * unevenly and their stencils reach beyond the neighboring rank.
+     */
+    EXPECT_EQ(3, pme_multilevel_nlevels(pme->multilevel));
+
+    matrix box = {{ 0 }};
+    for (int d = 0; d < DIM; d++)
+    {
+        box[d][d] = c_boxSize[d];
+    }
+    t_nrnb nrnb;
+    init_nrnb(&nrnb);
+    matrix vir_lj;
+    clear_mat(vir);
+    clear_mat(vir_lj);
+    real   energy_q    = 0, energy_lj = 0;
+    real   dvdlambda_q = 0, dvdlambda_lj = 0;
+    /* The atoms can be on any PME slab, so they can shift over all slabs */
+    gmx_pme_do(pme, 0, homenr, as_rvec_array(x.data()), as_rvec_array(f.data()),
+               q.data(), nullptr, nullptr, nullptr, nullptr, nullptr,
+               box, cr, numRanksX - 1, numRanksY - 1, &nrnb, nullptr,
+               vir, vir_lj, &energy_q, &energy_lj, 0, 0, &dvdlambda_q, &dvdlambda_lj,
+               GMX_PME_DO_ALL_F | GMX_PME_CALC_ENER_VIR);
+    gmx_pme_destroy(pme);
+
+    if (bDecomposed)
+    {
+        gmx_sum(1, &energy_q, cr);
+        gmx_sum(DIM*DIM, vir[0], cr);
+    }
+    *energy = energy_q;
+
+    return f;
+}
+
+/*! \brief Checks that the decomposed solver matches the serial solver */
+void checkDecomposedMatchesSerial(int numRanksX, int numRanksY)
+{
+    t_commrec *cr = init_commrec();
+    /* With thread-MPI the commrec is only set up for the threads here */
+    gmx_fill_commrec_from_mpi(cr);
+    /* gmx_pme_do only redistributes atoms over the PME ranks with DD */
+    snew(cr->dd, 1);
+
+    t_inputrec ir;
+    ir.coulombtype = eelPME;
+    ir.nkx         = 32;
+    ir.nky         = 36;
+    ir.nkz         = 30;
+    ir.pme_order   = 4;
+    ir.epsilon_r   = 1;
+    real       ewaldCoeff = calc_ewaldcoeff_q(0.9, 1e-5);
+
+    real              energyRef, energy;
+    matrix            virRef, vir;
+    std::vector<RVec> fRef = computeMultilevelForces(cr, ir, ewaldCoeff, 1, 1, &energyRef, virRef);
+    std::vector<RVec> f    = computeMultilevelForces(cr, ir, ewaldCoeff, numRanksX, numRanksY, &energy, vir);
+
+    real fMax = 0;
+    for (const RVec &fi : fRef)
+    {
+        fMax = std::max(fMax, norm(fi));
+    }
+    ASSERT_GT(fMax, 0);
+
+    FloatingPointTolerance tolerance = absoluteTolerance(c_relativeTolerance*fMax);
+    for (size_t i = 0; i < f.size(); i++)
+    {
+        int atom = cr->nodeid + i*c_numRanks;
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_REAL_EQ_TOL(fRef[atom][d], f[i][d], tolerance)
+            << "for atom " << atom << " dimension " << d;
+        }
+    }
+    EXPECT_REAL_EQ_TOL(energyRef, energy,
+                       relativeToleranceAsFloatingPoint(energyRef, c_relativeTolerance));
+    real virMax = 0;
+    for (int d = 0; d < DIM; d++)
+    {
+        for (int e = 0; e < DIM; e++)
+        {
+            virMax = std::max(virMax, std::abs(virRef[d][e]));
+        }
+    }
+    for (int d = 0; d < DIM; d++)
+    {
+        for (int e = 0; e < DIM; e++)
+        {
+            EXPECT_REAL_EQ_TOL(virRef[d][e], vir[d][e], absoluteTolerance(c_relativeTolerance*virMax))
+            << "virial element " << d << " " << e;
+        }
+    }
+
+    sfree(cr->dd);
+    cr->dd = nullptr;
+    done_commrec(cr);
+}
+
+TEST(PmeMultilevelMpiTest, DecompositionAlongXMatchesSingleRank)
+{
+    GMX_MPI_TEST(c_numRanks);
+    checkDecomposedMatchesSerial(c_numRanks, 1);
+}
+
+TEST(PmeMultilevelMpiTest, DecompositionAlongYMatchesSingleRank)
+{
+    GMX_MPI_TEST(c_numRanks);
+    checkDecomposedMatchesSerial(1, c_numRanks);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
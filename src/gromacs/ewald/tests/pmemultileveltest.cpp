@@ -0,0 +1,191 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements tests for the multilevel PME grid solver.
+ *
+ * \ingroup module_ewald
+ */
+
+#include "gmxpre.h"
+
+#include <cmath>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/ewald/pme-internal.h"
+#include "gromacs/ewald/pme-multilevel.h"
+#include "gromacs/ewald/pme-solve.h"
+#include "gromacs/fft/parallel_3dfft.h"
+#include "gromacs/math/calculate-ewald-splitting-coefficient.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformrealdistribution.h"
+
+#include "testutils/testasserts.h"
+
+#include "pmetestcommon.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+/*! \brief Compares the multilevel solver to the FFT solver on the same charge grid */
+class PmeMultilevelTest : public ::testing::Test
+{
+    public:
+        //! Sets up random neutral charges in a rectangular box
+        PmeMultilevelTest() : boxSize_ { 3.0, 3.2, 2.8 }
+        {
+            gmx::ThreeFry2x64<64>               rng(123456, gmx::RandomDomain::Other);
+            gmx::UniformRealDistribution<real>  dist;
+
+            const int atomCount = 40;
+            for (int i = 0; i < atomCount; i++)
+            {
+                coordinates_.push_back({ dist(rng)*boxSize_[XX], dist(rng)*boxSize_[YY], dist(rng)*boxSize_[ZZ] });
+                charges_.push_back(i % 2 == 0 ? 0.8 : -0.8);
+            }
+        }
+
+        //! Runs spreading, the solver and gathering, returns the energy, virial and forces
+        void runPme(bool useMultilevel, real *energy, matrix vir, std::vector<RVec> *forces)
+        {
+            t_inputrec inputRec;
+            inputRec.nkx         = 32;
+            inputRec.nky         = 36;
+            inputRec.nkz         = 30;
+            inputRec.pme_order   = 4;
+            inputRec.coulombtype = eelPME;
+            inputRec.epsilon_r   = 1;
+
+            Matrix3x3  box        = {{ boxSize_[XX], 0, 0, 0, boxSize_[YY], 0, 0, 0, boxSize_[ZZ] }};
+            matrix     boxMatrix  = {{ boxSize_[XX], 0, 0 }, { 0, boxSize_[YY], 0 }, { 0, 0, boxSize_[ZZ] }};
+            const real ewaldCoeff = calc_ewaldcoeff_q(0.9, 1e-5);
+
+            PmeSafePointer pme = pmeInitWithAtoms(&inputRec, coordinates_, charges_, box, ewaldCoeff);
+            pmePerformSplineAndSpread(pme.get(), CodePath::CPU, true, true);
+
+            if (useMultilevel)
+            {
+                ivec           gridSize, gridOffset, paddedGridSize;
+                gmx_parallel_3dfft_real_limits(pme->pfft_setup[0], gridSize, gridOffset, paddedGridSize);
+                const int      numRanks[2]  = { 1, 1 };
+                const int      rankIndex[2] = { 0, 0 };
+                const MPI_Comm comm[2]      = { MPI_COMM_NULL, MPI_COMM_NULL };
+                pme_multilevel_t *ml = pme_multilevel_init(gridSize, gridOffset, gridSize, paddedGridSize,
+                                                           inputRec.pme_order, ewaldCoeff, inputRec.epsilon_r,
+                                                           1e-6, 1, numRanks, rankIndex, comm);
+                /* 32, 36 and 30 can be halved twice, once and once */
+                EXPECT_EQ(3, pme_multilevel_nlevels(ml));
+                pme_multilevel_set_box(ml, boxMatrix);
+                pme_multilevel_solve(ml, pme->fftgrid[0], TRUE, 1, 0);
+                get_pme_multilevel_ener_vir(ml, 1, energy, vir);
+                pme_multilevel_destroy(ml);
+            }
+            else
+            {
+                gmx_parallel_3dfft_execute(pme->pfft_setup[0], GMX_FFT_REAL_TO_COMPLEX, 0, nullptr);
+                solve_pme_yzx(pme.get(), pme->cfftgrid[0], boxSize_[XX]*boxSize_[YY]*boxSize_[ZZ], TRUE, 1, 0);
+                gmx_parallel_3dfft_execute(pme->pfft_setup[0], GMX_FFT_COMPLEX_TO_REAL, 0, nullptr);
+                get_pme_ener_vir_q(pme->solve_work, 1, energy, vir);
+            }
+
+            forces->resize(coordinates_.size());
+            ForcesVector forcesRef(*forces);
+            pmePerformGather(pme.get(), CodePath::CPU, PmeGatherInputHandling::Overwrite, forcesRef);
+        }
+
+    private:
+        RVec                boxSize_;
+        CoordinatesVector   coordinates_;
+        std::vector<real>   charges_;
+};
+
+TEST_F(PmeMultilevelTest, AgreesWithFftSolver)
+{
+    real              energyFft, energyMultilevel;
+    matrix            virFft, virMultilevel;
+    std::vector<RVec> forcesFft, forcesMultilevel;
+
+    runPme(false, &energyFft, virFft, &forcesFft);
+    runPme(true, &energyMultilevel, virMultilevel, &forcesMultilevel);
+
+    /* The multilevel grid discretization errors are about twice those of PME
+     * with the same grid, with this grid these are a few times 1e-4.
+     */
+    EXPECT_REAL_EQ_TOL(energyFft, energyMultilevel, relativeToleranceAsFloatingPoint(energyFft, 1e-3));
+
+    real virMax = 0;
+    for (int d = 0; d < DIM; d++)
+    {
+        for (int e = 0; e < DIM; e++)
+        {
+            virMax = std::max(virMax, std::abs(virFft[d][e]));
+        }
+    }
+    for (int d = 0; d < DIM; d++)
+    {
+        for (int e = 0; e < DIM; e++)
+        {
+            EXPECT_NEAR(virFft[d][e], virMultilevel[d][e], 5e-3*virMax) << "virial element " << d << " " << e;
+        }
+    }
+
+    real forceMax = 0;
+    for (const auto &f : forcesFft)
+    {
+        forceMax = std::max(forceMax, norm(f));
+    }
+    for (size_t i = 0; i < forcesFft.size(); i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_NEAR(forcesFft[i][d], forcesMultilevel[i][d], 5e-3*forceMax) << "force on atom " << i;
+        }
+    }
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
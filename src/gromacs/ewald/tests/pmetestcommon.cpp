@@ -63,11 +63,12 @@ namespace test
 {
 
 //! PME initialization - internal
-static PmeSafePointer pmeInitInternal(const t_inputrec *inputRec, size_t atomCount)
+static PmeSafePointer pmeInitInternal(const t_inputrec *inputRec, size_t atomCount,
+                                      real ewaldCoeff_q = 0.0)
 {
     gmx_pme_t *pmeDataRaw = nullptr;
     gmx_pme_init(&pmeDataRaw, nullptr, 1, 1, inputRec,
-                 atomCount, false, false, true, 0.0, 0.0, 1);
+                 atomCount, false, false, true, false, ewaldCoeff_q, 0.0, 1);
     PmeSafePointer pme(pmeDataRaw); // taking ownership
     return pme;
 }
@@ -83,12 +84,13 @@ PmeSafePointer pmeInitEmpty(const t_inputrec *inputRec)
 PmeSafePointer pmeInitWithAtoms(const t_inputrec        *inputRec,
                                 const CoordinatesVector &coordinates,
                                 const ChargesVector     &charges,
-                                const Matrix3x3          box
+                                const Matrix3x3          box,
+                                real                     ewaldCoeff_q
                                 )
 {
     const size_t    atomCount = coordinates.size();
     GMX_RELEASE_ASSERT(atomCount == charges.size(), "Mismatch in atom data");
-    PmeSafePointer  pmeSafe = pmeInitInternal(inputRec, atomCount);
+    PmeSafePointer  pmeSafe = pmeInitInternal(inputRec, atomCount, ewaldCoeff_q);
     pme_atomcomm_t *atc     = &(pmeSafe->atc[0]);
     atc->x           = const_cast<rvec *>(as_rvec_array(coordinates.data()));
     atc->coefficient = const_cast<real *>(charges.data());
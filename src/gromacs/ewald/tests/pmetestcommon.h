@@ -113,7 +113,8 @@ PmeSafePointer pmeInitEmpty(const t_inputrec *inputRec);
 PmeSafePointer pmeInitWithAtoms(const t_inputrec        *inputRec,
                                 const CoordinatesVector &coordinates,
                                 const ChargesVector     &charges,
-                                const Matrix3x3          box
+                                const Matrix3x3          box,
+                                real                     ewaldCoeff_q = 0.0
                                 );
 //! PME spline computation and charge spreading
 void pmePerformSplineAndSpread(gmx_pme_t *pme, CodePath mode,
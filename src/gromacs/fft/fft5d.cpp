@@ -46,10 +46,13 @@
 #include <string.h>
 
 #include <algorithm>
+#include <vector>
 
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/gmxmpi.h"
+#include "gromacs/utility/gmxomp.h"
+#include "gromacs/utility/mutex.h"
 #include "gromacs/utility/smalloc.h"
 
 #ifdef NOGMX
@@ -80,8 +83,6 @@ FILE* debug = 0;
 
 #if GMX_FFT_FFTW3
 
-#include "gromacs/utility/exceptions.h"
-#include "gromacs/utility/mutex.h"
 /* none of the fftw3 calls, except execute(), are thread-safe, so
    we need to serialize them with this mutex. */
 static gmx::Mutex big_fftw_mutex;
@@ -163,6 +164,8 @@ static int vmax(int* a, int s)
 }
 
 
+static void fft5d_tune_pipeline(fft5d_plan plan);
+
 /* NxMxK the size of the data
  * comm communicator to use for fft5d
  * P0 number of processor in 1st axes (can be null for automatic)
@@ -670,12 +673,23 @@ fft5d_plan fft5d_plan_3d(int NG, int MG, int KG, MPI_Comm comm[2], int flags, t_
     plan->direction=direction;
     plan->realcomplex=realcomplex;
  */
-    plan->flags    = flags;
-    plan->nthreads = nthreads;
-    *rlin          = lin;
-    *rlout         = lout;
-    *rlout2        = lout2;
-    *rlout3        = lout3;
+    plan->flags     = flags;
+    plan->nthreads  = nthreads;
+    plan->lsize     = lsize;
+    plan->nchunk[0] = 1;
+    plan->nchunk[1] = 1;
+    *rlin           = lin;
+    *rlout          = lout;
+    *rlout2         = lout2;
+    *rlout3         = lout3;
+
+#if GMX_FFT_FFTW3
+    if (!plan->p3d)
+#endif
+    {
+        fft5d_tune_pipeline(plan);
+    }
+
     return plan;
 }
 
@@ -967,6 +981,193 @@ static void print_localdata(const t_complex* lin, const char* txt, int s, fft5d_
     }
 }
 
+/*whether the transpose of step s communicates between ranks*/
+static int is_parallel_step(fft5d_plan plan, int s)
+{
+#if GMX_MPI
+    return (GMX_PARALLEL_ENV_INITIALIZED && plan->cart[s] != MPI_COMM_NULL && plan->P[s] > 1);
+#else
+    GMX_UNUSED_VALUE(plan);
+    GMX_UNUSED_VALUE(s);
+    return 0;
+#endif
+}
+
+/*range of the K-planes of chunk c*/
+static void chunk_range(int nz, int nchunk, int c, int* z0, int* z1)
+{
+    *z0 = (c*nz)/nchunk;
+    *z1 = ((c+1)*nz)/nchunk;
+}
+
+/*range of the 1D FFT lines of thread t in chunk c for step s*/
+static void chunk_thread_lines(fft5d_plan plan, int s, int c, int t, int* l0, int* l1)
+{
+    int z0, z1, n;
+
+    chunk_range(plan->K[s], plan->nchunk[s], c, &z0, &z1);
+    z0  = std::min(z0, plan->pK[s])*plan->pM[s];
+    z1  = std::min(z1, plan->pK[s])*plan->pM[s];
+    n   = z1 - z0;
+    *l0 = z0 + (t*n)/plan->nthreads;
+    *l1 = z0 + ((t+1)*n)/plan->nthreads;
+}
+
+static void destroy_chunk_plans(fft5d_plan plan)
+{
+    int s, i;
+
+    for (s = 0; s < 2; s++)
+    {
+        if (plan->p1dChunk[s])
+        {
+            for (i = 0; i < plan->nchunk[s]*plan->nthreads; i++)
+            {
+                if (plan->p1dChunk[s][i])
+                {
+                    gmx_many_fft_destroy(plan->p1dChunk[s][i]);
+                }
+            }
+            free(plan->p1dChunk[s]);
+            plan->p1dChunk[s] = nullptr;
+        }
+        plan->nchunk[s] = 1;
+    }
+}
+
+/*set the number of pipeline chunks for the parallel transposes and create the 1D plans for the chunks,
+  needs no communication, but all ranks in the FFT communicators should set the same number*/
+void fft5d_set_pipeline_nchunk(fft5d_plan plan, int nchunk)
+{
+    int s, c, t, l0, l1;
+
+    destroy_chunk_plans(plan);
+
+    for (s = 0; s < 2; s++)
+    {
+        if (!is_parallel_step(plan, s))
+        {
+            continue;
+        }
+        plan->nchunk[s] = std::max(1, std::min(nchunk, plan->K[s]));
+        if (plan->nchunk[s] == 1)
+        {
+            continue;
+        }
+        plan->p1dChunk[s] = (gmx_fft_t*)calloc(plan->nchunk[s]*plan->nthreads, sizeof(gmx_fft_t));
+        for (c = 0; c < plan->nchunk[s]; c++)
+        {
+            for (t = 0; t < plan->nthreads; t++)
+            {
+                chunk_thread_lines(plan, s, c, t, &l0, &l1);
+                if (l1 == l0)
+                {
+                    continue;
+                }
+                if ((plan->flags&FFT5D_REALCOMPLEX) && !(plan->flags&FFT5D_BACKWARD) && s == 0)
+                {
+                    gmx_fft_init_many_1d_real(&plan->p1dChunk[s][c*plan->nthreads+t], plan->rC[s], l1 - l0, (plan->flags&FFT5D_NOMEASURE) ? GMX_FFT_FLAG_CONSERVATIVE : 0);
+                }
+                else
+                {
+                    gmx_fft_init_many_1d     (&plan->p1dChunk[s][c*plan->nthreads+t], plan->C[s], l1 - l0, (plan->flags&FFT5D_NOMEASURE) ? GMX_FFT_FLAG_CONSERVATIVE : 0);
+                }
+            }
+        }
+        if (plan->lsend == nullptr)
+        {
+            /*the pipelined transposes can not reuse the FFT buffers*/
+            if (plan->lout2 != plan->lin && plan->lout3 != plan->lout)
+            {
+                plan->lsend = plan->lout2;
+                plan->lrecv = plan->lout3;
+            }
+            else
+            {
+                snew_aligned(plan->lsend, plan->lsize, 32);
+                snew_aligned(plan->lrecv, plan->lsize, 32);
+                plan->bOwnChunkBuffers = 1;
+            }
+        }
+    }
+}
+
+/*FFT of step s followed by the split and transpose, in chunks along K.
+  The non-blocking transfer of a chunk overlaps with the FFT and split of the next chunk.
+  All threads call this, thread 0 does the communication. */
+static void fft5d_fft_transpose_chunked(fft5d_plan plan, int s, int thread, fft5d_time gmx_unused times)
+{
+    t_complex *lin   = plan->lin;
+    t_complex *lout  = plan->lout;
+    int       *pM    = plan->pM;
+    int        C     = plan->C[s];
+    int        c, l0, l1;
+#if GMX_MPI
+    int        P     = plan->P[s];
+    /*size of the data for one rank and for one K-plane, in reals*/
+    int        blk   = plan->N[s]*plan->M[s]*plan->K[s]*sizeof(t_complex)/sizeof(real);
+    int        plane = plan->N[s]*plan->M[s]*sizeof(t_complex)/sizeof(real);
+    int        i, z0, z1, nreq = 0;
+    std::vector<MPI_Request> req;
+
+    if (thread == 0)
+    {
+        wallcycle_start(times, ewcPME_FFTCOMM);
+        req.resize(2*P*plan->nchunk[s]);
+        for (c = 0; c < plan->nchunk[s]; c++)
+        {
+            chunk_range(plan->K[s], plan->nchunk[s], c, &z0, &z1);
+            for (i = 0; i < P; i++)
+            {
+                MPI_Irecv((real *)plan->lrecv + i*blk + z0*plane, (z1 - z0)*plane, GMX_MPI_REAL, i, c, plan->cart[s], &req[nreq++]);
+            }
+        }
+        wallcycle_stop(times, ewcPME_FFTCOMM);
+    }
+#endif
+
+    for (c = 0; c < plan->nchunk[s]; c++)
+    {
+        chunk_thread_lines(plan, s, c, thread, &l0, &l1);
+        if (l1 > l0)
+        {
+            if ((plan->flags&FFT5D_REALCOMPLEX) && !(plan->flags&FFT5D_BACKWARD) && s == 0)
+            {
+                gmx_fft_many_1d_real(plan->p1dChunk[s][c*plan->nthreads+thread], GMX_FFT_REAL_TO_COMPLEX, lin+l0*C, lout+l0*C);
+            }
+            else
+            {
+                gmx_fft_many_1d(     plan->p1dChunk[s][c*plan->nthreads+thread], (plan->flags&FFT5D_BACKWARD) ? GMX_FFT_BACKWARD : GMX_FFT_FORWARD, lin+l0*C, lout+l0*C);
+            }
+            splitaxes(plan->lsend, lout, plan->N[s], plan->M[s], plan->K[s], pM[s], plan->P[s], C, plan->iNout[s], plan->oNout[s], l0%pM[s], l0/pM[s], l1%pM[s], l1/pM[s]);
+        }
+#pragma omp barrier /*the whole chunk has to be split before sending*/
+#if GMX_MPI
+        if (thread == 0)
+        {
+            wallcycle_start(times, ewcPME_FFTCOMM);
+            chunk_range(plan->K[s], plan->nchunk[s], c, &z0, &z1);
+            for (i = 0; i < P; i++)
+            {
+                MPI_Isend((real *)plan->lsend + i*blk + z0*plane, (z1 - z0)*plane, GMX_MPI_REAL, i, c, plan->cart[s], &req[nreq++]);
+            }
+            wallcycle_stop(times, ewcPME_FFTCOMM);
+        }
+#endif
+    }
+
+#if GMX_MPI
+    if (thread == 0)
+    {
+        wallcycle_start(times, ewcPME_FFTCOMM);
+        MPI_Waitall(nreq, req.data(), MPI_STATUSES_IGNORE);
+        wallcycle_stop(times, ewcPME_FFTCOMM);
+    }
+#else
+    gmx_incons("fft5d MPI call without MPI configuration");
+#endif
+}
+
 void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times)
 {
     t_complex  *lin   = plan->lin;
@@ -987,7 +1188,7 @@ void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times)
 #endif
     int   *N = plan->N, *M = plan->M, *K = plan->K, *pN = plan->pN, *pM = plan->pM, *pK = plan->pK,
     *C       = plan->C, *P = plan->P, **iNin = plan->iNin, **oNin = plan->oNin, **iNout = plan->iNout, **oNout = plan->oNout;
-    int    s = 0, tstart, tend, bParallelDim;
+    int    s = 0, tstart, tend, bParallelDim, bChunked;
 
 
 #if GMX_FFT_FFTW3
@@ -1035,118 +1236,128 @@ void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times)
             bParallelDim = 0;
         }
 
-        /* ---------- START FFT ------------ */
-#ifdef NOGMX
-        if (times != 0 && thread == 0)
-        {
-            time = MPI_Wtime();
-        }
-#endif
+        bChunked = (bParallelDim && plan->nchunk[s] > 1);
 
-        if (bParallelDim || plan->nthreads == 1)
+        if (bChunked)
         {
-            fftout = lout;
+            /* FFT, split and transpose in chunks with overlapping communication */
+            fft5d_fft_transpose_chunked(plan, s, thread, times);
         }
         else
         {
-            if (s == 0)
+            /* ---------- START FFT ------------ */
+#ifdef NOGMX
+            if (times != 0 && thread == 0)
+            {
+                time = MPI_Wtime();
+            }
+#endif
+
+            if (bParallelDim || plan->nthreads == 1)
             {
-                fftout = lout3;
+                fftout = lout;
             }
             else
             {
-                fftout = lout2;
+                if (s == 0)
+                {
+                    fftout = lout3;
+                }
+                else
+                {
+                    fftout = lout2;
+                }
             }
-        }
 
-        tstart = (thread*pM[s]*pK[s]/plan->nthreads)*C[s];
-        if ((plan->flags&FFT5D_REALCOMPLEX) && !(plan->flags&FFT5D_BACKWARD) && s == 0)
-        {
-            gmx_fft_many_1d_real(p1d[s][thread], (plan->flags&FFT5D_BACKWARD) ? GMX_FFT_COMPLEX_TO_REAL : GMX_FFT_REAL_TO_COMPLEX, lin+tstart, fftout+tstart);
-        }
-        else
-        {
-            gmx_fft_many_1d(     p1d[s][thread], (plan->flags&FFT5D_BACKWARD) ? GMX_FFT_BACKWARD : GMX_FFT_FORWARD,               lin+tstart, fftout+tstart);
-
-        }
-
-#ifdef NOGMX
-        if (times != NULL && thread == 0)
-        {
-            time_fft += MPI_Wtime()-time;
-        }
-#endif
-        if ((plan->flags&FFT5D_DEBUG) && thread == 0)
-        {
-            print_localdata(lout, "%d %d: FFT %d\n", s, plan);
-        }
-        /* ---------- END FFT ------------ */
-
-        /* ---------- START SPLIT + TRANSPOSE------------ (if parallel in in this dimension)*/
-        if (bParallelDim)
-        {
-#ifdef NOGMX
-            if (times != NULL && thread == 0)
+            tstart = (thread*pM[s]*pK[s]/plan->nthreads)*C[s];
+            if ((plan->flags&FFT5D_REALCOMPLEX) && !(plan->flags&FFT5D_BACKWARD) && s == 0)
             {
-                time = MPI_Wtime();
+                gmx_fft_many_1d_real(p1d[s][thread], (plan->flags&FFT5D_BACKWARD) ? GMX_FFT_COMPLEX_TO_REAL : GMX_FFT_REAL_TO_COMPLEX, lin+tstart, fftout+tstart);
             }
-#endif
-            /*prepare for A
-               llToAll
-               1. (most outer) axes (x) is split into P[s] parts of size N[s]
-               for sending*/
-            if (pM[s] > 0)
+            else
             {
-                tend    = ((thread+1)*pM[s]*pK[s]/plan->nthreads);
-                tstart /= C[s];
-                splitaxes(lout2, lout, N[s], M[s], K[s], pM[s], P[s], C[s], iNout[s], oNout[s], tstart%pM[s], tstart/pM[s], tend%pM[s], tend/pM[s]);
+                gmx_fft_many_1d(     p1d[s][thread], (plan->flags&FFT5D_BACKWARD) ? GMX_FFT_BACKWARD : GMX_FFT_FORWARD,               lin+tstart, fftout+tstart);
+
             }
-#pragma omp barrier /*barrier required before AllToAll (all input has to be their) - before timing to make timing more acurate*/
+
 #ifdef NOGMX
             if (times != NULL && thread == 0)
             {
-                time_local += MPI_Wtime()-time;
+                time_fft += MPI_Wtime()-time;
             }
 #endif
+            if ((plan->flags&FFT5D_DEBUG) && thread == 0)
+            {
+                print_localdata(lout, "%d %d: FFT %d\n", s, plan);
+            }
+            /* ---------- END FFT ------------ */
 
-            /* ---------- END SPLIT , START TRANSPOSE------------ */
-
-            if (thread == 0)
+            /* ---------- START SPLIT + TRANSPOSE------------ (if parallel in in this dimension)*/
+            if (bParallelDim)
             {
 #ifdef NOGMX
-                if (times != 0)
+                if (times != NULL && thread == 0)
                 {
                     time = MPI_Wtime();
                 }
-#else
-                wallcycle_start(times, ewcPME_FFTCOMM);
 #endif
-#ifdef FFT5D_MPI_TRANSPOSE
-                FFTW(execute)(mpip[s]);
-#else
-#if GMX_MPI
-                if ((s == 0 && !(plan->flags&FFT5D_ORDER_YZ)) || (s == 1 && (plan->flags&FFT5D_ORDER_YZ)))
+                /*prepare for A
+                   llToAll
+                   1. (most outer) axes (x) is split into P[s] parts of size N[s]
+                   for sending*/
+                if (pM[s] > 0)
                 {
-                    MPI_Alltoall((real *)lout2, N[s]*pM[s]*K[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, (real *)lout3, N[s]*pM[s]*K[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, cart[s]);
+                    tend    = ((thread+1)*pM[s]*pK[s]/plan->nthreads);
+                    tstart /= C[s];
+                    splitaxes(lout2, lout, N[s], M[s], K[s], pM[s], P[s], C[s], iNout[s], oNout[s], tstart%pM[s], tstart/pM[s], tend%pM[s], tend/pM[s]);
                 }
-                else
+#pragma omp barrier /*barrier required before AllToAll (all input has to be their) - before timing to make timing more acurate*/
+#ifdef NOGMX
+                if (times != NULL && thread == 0)
                 {
-                    MPI_Alltoall((real *)lout2, N[s]*M[s]*pK[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, (real *)lout3, N[s]*M[s]*pK[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, cart[s]);
+                    time_local += MPI_Wtime()-time;
                 }
+#endif
+
+                /* ---------- END SPLIT , START TRANSPOSE------------ */
+
+                if (thread == 0)
+                {
+#ifdef NOGMX
+                    if (times != 0)
+                    {
+                        time = MPI_Wtime();
+                    }
+#else
+                    wallcycle_start(times, ewcPME_FFTCOMM);
+#endif
+#ifdef FFT5D_MPI_TRANSPOSE
+                    FFTW(execute)(mpip[s]);
+#else
+#if GMX_MPI
+                    if ((s == 0 && !(plan->flags&FFT5D_ORDER_YZ)) || (s == 1 && (plan->flags&FFT5D_ORDER_YZ)))
+                    {
+                        MPI_Alltoall((real *)lout2, N[s]*pM[s]*K[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, (real *)lout3, N[s]*pM[s]*K[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, cart[s]);
+                    }
+                    else
+                    {
+                        MPI_Alltoall((real *)lout2, N[s]*M[s]*pK[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, (real *)lout3, N[s]*M[s]*pK[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, cart[s]);
+                    }
 #else
-                gmx_incons("fft5d MPI call without MPI configuration");
+                    gmx_incons("fft5d MPI call without MPI configuration");
 #endif /*GMX_MPI*/
 #endif /*FFT5D_MPI_TRANSPOSE*/
 #ifdef NOGMX
-                if (times != 0)
-                {
-                    time_mpi[s] = MPI_Wtime()-time;
-                }
+                    if (times != 0)
+                    {
+                        time_mpi[s] = MPI_Wtime()-time;
+                    }
 #else
-                wallcycle_stop(times, ewcPME_FFTCOMM);
+                    wallcycle_stop(times, ewcPME_FFTCOMM);
 #endif
-            } /*master*/
-        }     /* bPrallelDim */
+                } /*master*/
+            }     /* bPrallelDim */
+        }
 #pragma omp barrier  /*both needed for parallel and non-parallel dimension (either have to wait on data from AlltoAll or from last FFT*/
 
         /* ---------- END SPLIT + TRANSPOSE------------ */
@@ -1159,7 +1370,11 @@ void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times)
         }
 #endif
 
-        if (bParallelDim)
+        if (bChunked)
+        {
+            joinin = plan->lrecv;
+        }
+        else if (bParallelDim)
         {
             joinin = lout3;
         }
@@ -1247,10 +1462,161 @@ void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times)
     }
 }
 
+#if GMX_MPI && !defined FFT5D_MPI_TRANSPOSE
+/*the measured number of chunks for a plan geometry*/
+struct pipeline_tuning_t
+{
+    int NG, MG, KG, P[2], flags, nthreads;
+    int nchunk;
+};
+
+/*Plans with the same geometry are set up repeatedly, e.g. when PME load
+  balancing switches between grids, so the measured number of chunks is
+  stored to measure each geometry only once. All ranks of an FFT create
+  the same sequence of plans, so they all find the same stored entries.*/
+static std::vector<pipeline_tuning_t> pipeline_tuning;
+static gmx::Mutex                     pipeline_tuning_mutex;
+
+static bool same_pipeline_geometry(const pipeline_tuning_t &t, fft5d_plan plan)
+{
+    return (t.NG == plan->NG && t.MG == plan->MG && t.KG == plan->KG &&
+            t.P[0] == plan->P[0] && t.P[1] == plan->P[1] &&
+            t.flags == plan->flags && t.nthreads == plan->nthreads);
+}
+#endif
+
+/*Choose the number of chunks for pipelining the transposes.
+  GMX_FFT5D_NCHUNK sets the number directly, otherwise the fastest of a few
+  choices is measured when a plan of this geometry is first created, unless
+  FFT5D_NOMEASURE is set.
+  All ranks in the FFT communicators need to call this at the same time. */
+static void fft5d_tune_pipeline(fft5d_plan plan)
+{
+#if GMX_MPI && !defined FFT5D_MPI_TRANSPOSE
+    const int   c_nchunkMax = 8;
+    const int   c_ntune     = 3;
+    int         s, nchunk, nchunk_best, nz_min, rep;
+    double      time, time_best = 0;
+    const char *env;
+
+    nz_min = -1;
+    for (s = 0; s < 2; s++)
+    {
+        if (is_parallel_step(plan, s))
+        {
+            nz_min = (nz_min < 0 ? plan->K[s] : std::min(nz_min, plan->K[s]));
+        }
+    }
+    if (nz_min <= 1)
+    {
+        return;
+    }
+
+    env = getenv("GMX_FFT5D_NCHUNK");
+    if (env != nullptr)
+    {
+        fft5d_set_pipeline_nchunk(plan, strtol(env, nullptr, 10));
+        return;
+    }
+    if (plan->flags&FFT5D_NOMEASURE)
+    {
+        return;
+    }
+
+    {
+        gmx::lock_guard<gmx::Mutex> lock(pipeline_tuning_mutex);
+        for (const pipeline_tuning_t &t : pipeline_tuning)
+        {
+            if (same_pipeline_geometry(t, plan))
+            {
+                fft5d_set_pipeline_nchunk(plan, t.nchunk);
+                return;
+            }
+        }
+    }
+
+    nchunk_best = 1;
+    for (nchunk = 1; nchunk <= std::min(nz_min, c_nchunkMax); nchunk *= 2)
+    {
+        fft5d_set_pipeline_nchunk(plan, nchunk);
+        for (s = 0; s < 2; s++)
+        {
+            if (is_parallel_step(plan, s))
+            {
+                MPI_Barrier(plan->cart[s]);
+            }
+        }
+        time = 0;
+        /*the first execution is a warm-up that is not timed*/
+        for (rep = 0; rep < 1 + c_ntune; rep++)
+        {
+            double t0 = MPI_Wtime();
+#pragma omp parallel num_threads(plan->nthreads)
+            {
+                try
+                {
+                    fft5d_execute(plan, gmx_omp_get_thread_num(), nullptr);
+                }
+                GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+            }
+            if (rep > 0)
+            {
+                time += MPI_Wtime() - t0;
+            }
+        }
+        /*all ranks need to make the same choice, so use the slowest rank*/
+        for (s = 0; s < 2; s++)
+        {
+            if (is_parallel_step(plan, s))
+            {
+                double time_max;
+                MPI_Allreduce(&time, &time_max, 1, MPI_DOUBLE, MPI_MAX, plan->cart[s]);
+                time = time_max;
+            }
+        }
+        if (debug)
+        {
+            fprintf(debug, "FFT5D: %d chunk(s) for the transposes: %.3f ms\n", nchunk, time*1000/c_ntune);
+        }
+        if (nchunk == 1 || time < time_best)
+        {
+            nchunk_best = nchunk;
+            time_best   = time;
+        }
+    }
+    fft5d_set_pipeline_nchunk(plan, nchunk_best);
+    if (debug)
+    {
+        fprintf(debug, "FFT5D: Using %d chunk(s) for the transposes\n", nchunk_best);
+    }
+
+    pipeline_tuning_t tuning;
+    tuning.NG       = plan->NG;
+    tuning.MG       = plan->MG;
+    tuning.KG       = plan->KG;
+    tuning.P[0]     = plan->P[0];
+    tuning.P[1]     = plan->P[1];
+    tuning.flags    = plan->flags;
+    tuning.nthreads = plan->nthreads;
+    tuning.nchunk   = nchunk_best;
+    gmx::lock_guard<gmx::Mutex> lock(pipeline_tuning_mutex);
+    pipeline_tuning.push_back(tuning);
+#else
+    GMX_UNUSED_VALUE(plan);
+#endif
+}
+
 void fft5d_destroy(fft5d_plan plan)
 {
     int s, t;
 
+    destroy_chunk_plans(plan);
+    if (plan->bOwnChunkBuffers)
+    {
+        sfree_aligned(plan->lsend);
+        sfree_aligned(plan->lrecv);
+    }
+
     for (s = 0; s < 3; s++)
     {
         if (plan->p1d[s])
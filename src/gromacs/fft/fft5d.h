@@ -117,6 +117,13 @@ struct fft5d_plan_t {
     /*int P[2];*/
     int coor[2];
     int nthreads;
+    int lsize;                                        /*size of the local buffers*/
+    /* Pipelined transposes: the FFT and transpose of step s are split in nchunk[s] chunks along K,
+       the communication of a chunk overlaps with the FFT of the next chunk */
+    int        nchunk[2];                             /*number of chunks, 1 means no pipelining*/
+    gmx_fft_t* p1dChunk[2];                           /*1D plans for each chunk and thread*/
+    t_complex *lsend, *lrecv;                         /*send and receive buffers for the pipelined transposes*/
+    int        bOwnChunkBuffers;                      /*whether lsend and lrecv are allocated by the plan*/
 };
 
 typedef struct fft5d_plan_t *fft5d_plan;
@@ -125,6 +132,7 @@ void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times);
 fft5d_plan fft5d_plan_3d(int N, int M, int K, MPI_Comm comm[2], int flags, t_complex**lin, t_complex**lin2, t_complex**lout2, t_complex**lout3, int nthreads);
 void fft5d_local_size(fft5d_plan plan, int* N1, int* M0, int* K0, int* K1, int** coor);
 void fft5d_destroy(fft5d_plan plan);
+void fft5d_set_pipeline_nchunk(fft5d_plan plan, int nchunk);
 fft5d_plan fft5d_plan_3d_cart(int N, int M, int K, MPI_Comm comm, int P0, int flags, t_complex** lin, t_complex** lin2, t_complex** lout2, t_complex** lout3, int nthreads);
 void fft5d_compare_data(const t_complex* lin, const t_complex* in, fft5d_plan plan, int bothLocal, int normarlize);
 
@@ -183,6 +183,14 @@ gmx_parallel_3dfft_execute(gmx_parallel_3dfft_t    pfft_setup,
     return 0;
 }
 
+void
+gmx_parallel_3dfft_set_pipeline_nchunk(gmx_parallel_3dfft_t    pfft_setup,
+                                       int                     nchunk)
+{
+    fft5d_set_pipeline_nchunk(pfft_setup->p1, nchunk);
+    fft5d_set_pipeline_nchunk(pfft_setup->p2, nchunk);
+}
+
 int
 gmx_parallel_3dfft_destroy(gmx_parallel_3dfft_t    pfft_setup)
 {
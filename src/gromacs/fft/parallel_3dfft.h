@@ -109,6 +109,19 @@ gmx_parallel_3dfft_complex_limits(gmx_parallel_3dfft_t      pfft_setup,
                                   ivec                      local_size);
 
 
+/*! \brief Set the number of chunks the parallel transposes are pipelined in
+ *
+ *  This overrides the number chosen when the setup was initialized.
+ *  All ranks in the FFT communicators need to set the same number.
+ *
+ *  \param pfft_setup Parallel 3dfft setup.
+ *  \param nchunk     Number of chunks, 1 disables pipelining.
+ */
+void
+gmx_parallel_3dfft_set_pipeline_nchunk(gmx_parallel_3dfft_t    pfft_setup,
+                                       int                     nchunk);
+
+
 int
 gmx_parallel_3dfft_execute(gmx_parallel_3dfft_t    pfft_setup,
                            enum gmx_fft_direction  dir,
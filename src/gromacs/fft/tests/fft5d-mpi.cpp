@@ -0,0 +1,169 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests that pipelined fft5d transposes give the same result as
+ * unpipelined transposes.
+ *
+ * \ingroup module_fft
+ */
+#include "gmxpre.h"
+
+#include <cmath>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fft/parallel_3dfft.h"
+#include "gromacs/utility/gmxmpi.h"
+
+#include "testutils/mpitest.h"
+#include "testutils/testasserts.h"
+
+namespace
+{
+
+//! The number of ranks along each of the two decomposed dimensions
+const int c_numRanksPerDim = 2;
+
+//! Results of a forward and backward 3D FFT on the local part of the grid
+struct FftResult
+{
+    //! The local complex grid after the real to complex transform
+    std::vector<real> forward;
+    //! The local real grid after the transform back
+    std::vector<real> backward;
+};
+
+/*! \brief Runs a real 3D FFT and back with the transposes split into \p nchunk chunks
+ *
+ * The setup is created without measuring, so the number of chunks
+ * is only set through the plan, identically on all ranks.
+ */
+FftResult runFft(MPI_Comm comm[2], int nchunk)
+{
+    ivec                 ndata = { 20, 18, 16 };
+    gmx_parallel_3dfft_t fft;
+    real                *rdata;
+    t_complex           *cdata;
+    gmx_parallel_3dfft_init(&fft, ndata, &rdata, &cdata, comm, TRUE, 1);
+    gmx_parallel_3dfft_set_pipeline_nchunk(fft, nchunk);
+
+    ivec rndata, roffset, rsize;
+    gmx_parallel_3dfft_real_limits(fft, rndata, roffset, rsize);
+    for (int ix = 0; ix < rndata[XX]; ix++)
+    {
+        for (int iy = 0; iy < rndata[YY]; iy++)
+        {
+            for (int iz = 0; iz < rndata[ZZ]; iz++)
+            {
+                int x = roffset[XX] + ix, y = roffset[YY] + iy, z = roffset[ZZ] + iz;
+                rdata[(ix*rsize[YY] + iy)*rsize[ZZ] + iz] = std::sin(0.3*x + 0.7*y*y + 1.1*z) + 0.01*x*z;
+            }
+        }
+    }
+
+    FftResult result;
+    gmx_parallel_3dfft_execute(fft, GMX_FFT_REAL_TO_COMPLEX, 0, nullptr);
+    /* The complex grid is stored in y, z, x order */
+    ivec corder, cndata, coffset, csize;
+    gmx_parallel_3dfft_complex_limits(fft, corder, cndata, coffset, csize);
+    for (int iy = 0; iy < cndata[YY]; iy++)
+    {
+        for (int iz = 0; iz < cndata[ZZ]; iz++)
+        {
+            for (int ix = 0; ix < cndata[XX]; ix++)
+            {
+                const t_complex &c = cdata[(iy*csize[ZZ] + iz)*csize[XX] + ix];
+                result.forward.push_back(c.re);
+                result.forward.push_back(c.im);
+            }
+        }
+    }
+    gmx_parallel_3dfft_execute(fft, GMX_FFT_COMPLEX_TO_REAL, 0, nullptr);
+    for (int ix = 0; ix < rndata[XX]; ix++)
+    {
+        for (int iy = 0; iy < rndata[YY]; iy++)
+        {
+            for (int iz = 0; iz < rndata[ZZ]; iz++)
+            {
+                result.backward.push_back(rdata[(ix*rsize[YY] + iy)*rsize[ZZ] + iz]);
+            }
+        }
+    }
+    gmx_parallel_3dfft_destroy(fft);
+
+    return result;
+}
+
+//! Checks that \p result matches \p reference within \p tolerance
+void checkResult(const std::vector<real> &reference, const std::vector<real> &result,
+                 const gmx::test::FloatingPointTolerance &tolerance, const char *name)
+{
+    ASSERT_EQ(reference.size(), result.size());
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+        EXPECT_REAL_EQ_TOL(reference[i], result[i], tolerance) << "for " << name << " element " << i;
+    }
+}
+
+TEST(Fft5dPipelineTest, ChunkedTransposesMatchSingleChunk)
+{
+    GMX_MPI_TEST(c_numRanksPerDim*c_numRanksPerDim);
+    int      rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    /* A 2x2 decomposition, so both transposes are done over ranks */
+    MPI_Comm comm[2];
+    MPI_Comm_split(MPI_COMM_WORLD, rank % c_numRanksPerDim, rank, &comm[0]);
+    MPI_Comm_split(MPI_COMM_WORLD, rank/c_numRanksPerDim, rank, &comm[1]);
+
+    FftResult reference = runFft(comm, 1);
+    /* The chunked 1D FFTs use different plans, which can change the rounding */
+    gmx::test::FloatingPointTolerance tolerance = gmx::test::relativeToleranceAsFloatingPoint(100, 1e-6);
+    for (int nchunk : { 2, 3, 4 })
+    {
+        SCOPED_TRACE("with " + std::to_string(nchunk) + " chunks");
+        FftResult result = runFft(comm, nchunk);
+        checkResult(reference.forward, result.forward, tolerance, "forward");
+        checkResult(reference.backward, result.backward, tolerance, "backward");
+    }
+
+    MPI_Comm_free(&comm[0]);
+    MPI_Comm_free(&comm[1]);
+}
+
+} // namespace
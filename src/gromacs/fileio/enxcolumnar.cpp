@@ -0,0 +1,1244 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include "enxcolumnar.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <string>
+#include <vector>
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/utility/cstringutil.h"
+#include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/smalloc.h"
+
+/* The source code in this file should be thread-safe.
+         Please keep it that way. */
+
+/* This number should be increased whenever the file format changes! */
+static const int          ecol_version = 1;
+
+/* Magic numbers, these read as "GECL", "CHNK", "CDIR" and "CEND" */
+static const unsigned int ecol_magic_file  = 0x4c434547;
+static const unsigned int ecol_magic_chunk = 0x4b4e4843;
+static const unsigned int ecol_magic_dir   = 0x52494443;
+static const unsigned int ecol_magic_end   = 0x444e4543;
+
+/* The number of frames buffered before a chunk is written */
+static const int          ecol_frames_per_chunk = 1000;
+
+/* The encodings of floating-point columns */
+enum {
+    ecolencXOR, ecolencRAW
+};
+
+/* The columns before the energy terms */
+enum {
+    ecolTIME, ecolSTEP, ecolNSUM, ecolNSTEPS, ecolDT, ecolNRE, ecolBLOCKS, ecolNR
+};
+
+/* The size of the chunk header without the column sizes */
+static const int ecol_chunk_header_size = 4 + 4 + 8 + 8 + 4;
+/* The size of the footer */
+static const int ecol_footer_size       = 8 + 4;
+
+typedef struct {
+    gmx_off_t   offset;    /* Offset of the chunk in the file */
+    int         nframes;   /* Number of frames in the chunk */
+    gmx_int64_t firstStep; /* Step of the first frame */
+    gmx_int64_t lastStep;  /* Step of the last frame */
+} t_ecol_chunk;
+
+struct ener_columnar
+{
+    t_fileio                         *fio; /* Only used for writing */
+    FILE                             *fp;
+    std::string                       fn;
+    gmx_bool                          bRead;
+    gmx_bool                          bTruncateAtFirstFrame;
+    int                               precision; /* Size of the energy values in bytes */
+    gmx_off_t                         dataEnd;
+    std::vector<std::string>          name;
+    std::vector<std::string>          unit;
+    std::vector<t_ecol_chunk>         chunk;
+    /* Frames that have not been written yet, or the chunk being read */
+    std::vector<double>               t;
+    std::vector<gmx_int64_t>          step;
+    std::vector<gmx_int64_t>          nsum;
+    std::vector<gmx_int64_t>          nsteps;
+    std::vector<double>               dt;
+    std::vector<gmx_int64_t>          nre;
+    std::vector<unsigned char>        blocks; /* The serialized blocks of all frames */
+    std::vector<std::vector<double> > value;
+    /* The reading position */
+    size_t                            readChunk;
+    size_t                            readFrame;
+    size_t                            readBlockPos;
+};
+
+static int ecol_ncolumns(const ener_columnar *ec)
+{
+    return ecolNR + ecolfNR*static_cast<int>(ec->name.size());
+}
+
+/* Little-endian serialization, so files are portable */
+
+static void put_uint32(std::vector<unsigned char> *buf, unsigned int v)
+{
+    for (int b = 0; b < 4; b++)
+    {
+        buf->push_back(static_cast<unsigned char>(v >> (8*b)));
+    }
+}
+
+static void put_int64(std::vector<unsigned char> *buf, gmx_int64_t v)
+{
+    gmx_uint64_t u = static_cast<gmx_uint64_t>(v);
+    for (int b = 0; b < 8; b++)
+    {
+        buf->push_back(static_cast<unsigned char>(u >> (8*b)));
+    }
+}
+
+static void put_string(std::vector<unsigned char> *buf, const std::string &s)
+{
+    put_uint32(buf, s.size());
+    buf->insert(buf->end(), s.begin(), s.end());
+}
+
+static unsigned int get_uint32(const unsigned char **p)
+{
+    unsigned int v = 0;
+    for (int b = 0; b < 4; b++)
+    {
+        v |= static_cast<unsigned int>((*p)[b]) << (8*b);
+    }
+    *p += 4;
+    return v;
+}
+
+static gmx_int64_t get_int64(const unsigned char **p)
+{
+    gmx_uint64_t u = 0;
+    for (int b = 0; b < 8; b++)
+    {
+        u |= static_cast<gmx_uint64_t>((*p)[b]) << (8*b);
+    }
+    *p += 8;
+    return static_cast<gmx_int64_t>(u);
+}
+
+/* The blocks of a frame are stored as the number of blocks followed,
+ * for each block, by the id and the number of subblocks and, for each
+ * subblock, by the type, the number of values and the values.
+ */
+static void put_blocks(std::vector<unsigned char> *buf, const t_enxframe *fr)
+{
+    put_uint32(buf, fr->nblock);
+    for (int b = 0; b < fr->nblock; b++)
+    {
+        const t_enxblock *eb = &fr->block[b];
+        put_uint32(buf, eb->id);
+        put_uint32(buf, eb->nsub);
+        for (int i = 0; i < eb->nsub; i++)
+        {
+            const t_enxsubblock *sub = &eb->sub[i];
+            put_uint32(buf, sub->type);
+            put_uint32(buf, sub->nr);
+            for (int j = 0; j < sub->nr; j++)
+            {
+                switch (sub->type)
+                {
+                    case xdr_datatype_float:
+                    {
+                        unsigned int bits;
+                        std::memcpy(&bits, &sub->fval[j], sizeof(bits));
+                        put_uint32(buf, bits);
+                        break;
+                    }
+                    case xdr_datatype_double:
+                    {
+                        gmx_int64_t bits;
+                        std::memcpy(&bits, &sub->dval[j], sizeof(bits));
+                        put_int64(buf, bits);
+                        break;
+                    }
+                    case xdr_datatype_int:
+                        put_uint32(buf, sub->ival[j]);
+                        break;
+                    case xdr_datatype_int64:
+                        put_int64(buf, sub->lval[j]);
+                        break;
+                    case xdr_datatype_char:
+                        buf->push_back(sub->cval[j]);
+                        break;
+                    case xdr_datatype_string:
+                        put_string(buf, sub->sval[j] != nullptr ? sub->sval[j] : "");
+                        break;
+                    default:
+                        gmx_incons("Writing unknown block data type");
+                }
+            }
+        }
+    }
+}
+
+/* Returns whether n more bytes are available at pos in buf */
+static gmx_bool have_bytes(const std::vector<unsigned char> &buf, size_t pos, size_t n)
+{
+    return (pos + n <= buf.size());
+}
+
+/* Reads the blocks of a frame at *pos in buf into fr, or skips them
+ * when fr is nullptr. Returns FALSE when the data is incomplete.
+ */
+static gmx_bool get_blocks(const std::vector<unsigned char> &buf, size_t *pos,
+                           t_enxframe *fr)
+{
+    const unsigned char *p = buf.data() + *pos;
+
+    if (!have_bytes(buf, *pos, 4))
+    {
+        return FALSE;
+    }
+    int nblock = get_uint32(&p);
+    if (fr != nullptr)
+    {
+        add_blocks_enxframe(fr, nblock);
+    }
+    for (int b = 0; b < nblock; b++)
+    {
+        if (!have_bytes(buf, p - buf.data(), 8))
+        {
+            return FALSE;
+        }
+        int id   = get_uint32(&p);
+        int nsub = get_uint32(&p);
+        if (fr != nullptr)
+        {
+            fr->block[b].id = id;
+            add_subblocks_enxblock(&fr->block[b], nsub);
+        }
+        for (int i = 0; i < nsub; i++)
+        {
+            if (!have_bytes(buf, p - buf.data(), 8))
+            {
+                return FALSE;
+            }
+            t_enxsubblock sub;
+            sub.type = static_cast<xdr_datatype>(get_uint32(&p));
+            sub.nr   = get_uint32(&p);
+            size_t size;
+            switch (sub.type)
+            {
+                case xdr_datatype_float:
+                case xdr_datatype_int:
+                    size = 4;
+                    break;
+                case xdr_datatype_double:
+                case xdr_datatype_int64:
+                    size = 8;
+                    break;
+                case xdr_datatype_char:
+                    size = 1;
+                    break;
+                case xdr_datatype_string:
+                    /* Checked per string below */
+                    size = 4;
+                    break;
+                default:
+                    return FALSE;
+            }
+            if (!have_bytes(buf, p - buf.data(), size*sub.nr))
+            {
+                return FALSE;
+            }
+            t_enxsubblock *dest = nullptr;
+            if (fr != nullptr)
+            {
+                dest       = &fr->block[b].sub[i];
+                dest->type = sub.type;
+                dest->nr   = sub.nr;
+                enxsubblock_alloc(dest);
+            }
+            for (int j = 0; j < sub.nr; j++)
+            {
+                switch (sub.type)
+                {
+                    case xdr_datatype_float:
+                    {
+                        unsigned int bits = get_uint32(&p);
+                        if (dest != nullptr)
+                        {
+                            std::memcpy(&dest->fval[j], &bits, sizeof(bits));
+                        }
+                        break;
+                    }
+                    case xdr_datatype_double:
+                    {
+                        gmx_int64_t bits = get_int64(&p);
+                        if (dest != nullptr)
+                        {
+                            std::memcpy(&dest->dval[j], &bits, sizeof(bits));
+                        }
+                        break;
+                    }
+                    case xdr_datatype_int:
+                    {
+                        int v = get_uint32(&p);
+                        if (dest != nullptr)
+                        {
+                            dest->ival[j] = v;
+                        }
+                        break;
+                    }
+                    case xdr_datatype_int64:
+                    {
+                        gmx_int64_t v = get_int64(&p);
+                        if (dest != nullptr)
+                        {
+                            dest->lval[j] = v;
+                        }
+                        break;
+                    }
+                    case xdr_datatype_char:
+                        if (dest != nullptr)
+                        {
+                            dest->cval[j] = *p;
+                        }
+                        p++;
+                        break;
+                    case xdr_datatype_string:
+                    {
+                        if (!have_bytes(buf, p - buf.data(), 4))
+                        {
+                            return FALSE;
+                        }
+                        unsigned int len = get_uint32(&p);
+                        if (!have_bytes(buf, p - buf.data(), len))
+                        {
+                            return FALSE;
+                        }
+                        if (dest != nullptr)
+                        {
+                            sfree(dest->sval[j]);
+                            dest->sval[j] = gmx_strdup(std::string(p, p + len).c_str());
+                        }
+                        p += len;
+                        break;
+                    }
+                    default:
+                        return FALSE;
+                }
+            }
+        }
+    }
+    *pos = p - buf.data();
+
+    return TRUE;
+}
+
+/* Opens the file. Files for writing are opened through gmx_fio, so they
+ * are included with their offset and checksum in checkpoints, which is
+ * needed for appending.
+ */
+static void open_file(ener_columnar *ec, const char *mode)
+{
+    if (ec->bRead)
+    {
+        ec->fio = nullptr;
+        ec->fp  = gmx_ffopen(ec->fn.c_str(), "rb");
+    }
+    else
+    {
+        ec->fio = gmx_fio_open(ec->fn.c_str(), mode);
+        ec->fp  = gmx_fio_getfp(ec->fio);
+    }
+}
+
+static int close_file(ener_columnar *ec)
+{
+    int rc = (ec->fio != nullptr ? gmx_fio_close(ec->fio) : gmx_ffclose(ec->fp));
+    ec->fio = nullptr;
+    ec->fp  = nullptr;
+
+    return rc;
+}
+
+/* Reads n bytes, returns FALSE when the file is too short */
+static gmx_bool read_bytes(FILE *fp, size_t n, std::vector<unsigned char> *buf)
+{
+    buf->resize(n);
+    return (n == 0 || fread(buf->data(), 1, n, fp) == n);
+}
+
+static void write_bytes(ener_columnar *ec, const std::vector<unsigned char> &buf)
+{
+    if (fwrite(buf.data(), 1, buf.size(), ec->fp) != buf.size())
+    {
+        gmx_file("Cannot write columnar energy file; maybe you are out of disk space?");
+    }
+}
+
+/* Returns the bit pattern of x stored with width bytes */
+static gmx_uint64_t real_bits(double x, int width)
+{
+    gmx_uint64_t bits;
+    if (width == sizeof(float))
+    {
+        float        xf = x;
+        unsigned int bitsf;
+        std::memcpy(&bitsf, &xf, sizeof(bitsf));
+        bits = bitsf;
+    }
+    else
+    {
+        std::memcpy(&bits, &x, sizeof(bits));
+    }
+    return bits;
+}
+
+/* Floating-point columns are stored with width 4 (float) or 8 (double)
+ * bytes and XOR-ed with the previous value. Only the bytes between the
+ * leading and trailing zero bytes of the result are stored, preceded
+ * by a byte with the trailing zero byte count in the high and
+ * the stored byte count in the low nibble. Constant and slowly varying
+ * values have many zero bytes. Noisy values would take more space than
+ * the values themselves, for such columns the raw values are stored.
+ * The first byte of the column data signals which of the two is used.
+ */
+static void encode_real_column(const std::vector<double> &v, int width,
+                               std::vector<unsigned char> *buf)
+{
+    size_t start = buf->size();
+
+    buf->push_back(ecolencXOR);
+    gmx_uint64_t prev = 0;
+    for (double x : v)
+    {
+        gmx_uint64_t bits = real_bits(x, width);
+        gmx_uint64_t diff = bits ^ prev;
+        prev              = bits;
+        if (diff == 0)
+        {
+            buf->push_back(0);
+            continue;
+        }
+        int lz = 0;
+        while (((diff >> (8*(width - 1 - lz))) & 0xff) == 0)
+        {
+            lz++;
+        }
+        int tz = 0;
+        while (((diff >> (8*tz)) & 0xff) == 0)
+        {
+            tz++;
+        }
+        int n = width - lz - tz;
+        buf->push_back(static_cast<unsigned char>((tz << 4) | n));
+        for (int b = 0; b < n; b++)
+        {
+            buf->push_back(static_cast<unsigned char>(diff >> (8*(tz + b))));
+        }
+    }
+
+    if (buf->size() - start > 1 + width*v.size())
+    {
+        buf->resize(start);
+        buf->push_back(ecolencRAW);
+        for (double x : v)
+        {
+            gmx_uint64_t bits = real_bits(x, width);
+            for (int b = 0; b < width; b++)
+            {
+                buf->push_back(static_cast<unsigned char>(bits >> (8*b)));
+            }
+        }
+    }
+}
+
+static gmx_bool decode_real_column(const std::vector<unsigned char> &buf,
+                                   int width, int n, double *v)
+{
+    if (buf.empty() || (buf[0] != ecolencXOR && buf[0] != ecolencRAW) ||
+        (buf[0] == ecolencRAW && buf.size() != 1 + static_cast<size_t>(width*n)))
+    {
+        return FALSE;
+    }
+    gmx_bool     bRaw = (buf[0] == ecolencRAW);
+    gmx_uint64_t prev = 0;
+    size_t       i    = 1;
+    for (int f = 0; f < n; f++)
+    {
+        if (i >= buf.size())
+        {
+            return FALSE;
+        }
+        int          tz   = 0;
+        int          nb   = width;
+        gmx_uint64_t diff = 0;
+        if (!bRaw)
+        {
+            tz   = buf[i] >> 4;
+            nb   = buf[i] & 0xf;
+            i++;
+        }
+        if (tz + nb > width || i + nb > buf.size())
+        {
+            return FALSE;
+        }
+        for (int b = 0; b < nb; b++)
+        {
+            diff |= static_cast<gmx_uint64_t>(buf[i + b]) << (8*(tz + b));
+        }
+        i   += nb;
+        prev = (bRaw ? diff : prev ^ diff);
+        if (width == sizeof(float))
+        {
+            unsigned int bitsf = prev;
+            float        xf;
+            std::memcpy(&xf, &bitsf, sizeof(xf));
+            v[f] = xf;
+        }
+        else
+        {
+            std::memcpy(&v[f], &prev, sizeof(prev));
+        }
+    }
+    return TRUE;
+}
+
+/* Integer columns, such as the step, are stored as zigzag varint
+ * delta-of-deltas, which is a single zero byte for regular output.
+ */
+static void encode_int_column(const std::vector<gmx_int64_t> &v,
+                              std::vector<unsigned char> *buf)
+{
+    gmx_uint64_t prev      = 0;
+    gmx_uint64_t prevDelta = 0;
+    for (gmx_int64_t x : v)
+    {
+        gmx_uint64_t delta = static_cast<gmx_uint64_t>(x) - prev;
+        gmx_uint64_t dd    = delta - prevDelta;
+        gmx_uint64_t zz    = (dd << 1) ^ (static_cast<gmx_int64_t>(dd) < 0 ? ~static_cast<gmx_uint64_t>(0) : 0);
+        prev               = static_cast<gmx_uint64_t>(x);
+        prevDelta          = delta;
+        while (zz >= 0x80)
+        {
+            buf->push_back(static_cast<unsigned char>(zz | 0x80));
+            zz >>= 7;
+        }
+        buf->push_back(static_cast<unsigned char>(zz));
+    }
+}
+
+static gmx_bool decode_int_column(const std::vector<unsigned char> &buf,
+                                  int n, gmx_int64_t *v)
+{
+    gmx_uint64_t prev      = 0;
+    gmx_uint64_t prevDelta = 0;
+    size_t       i         = 0;
+    for (int f = 0; f < n; f++)
+    {
+        gmx_uint64_t zz    = 0;
+        int          shift = 0;
+        do
+        {
+            if (i >= buf.size() || shift >= 64)
+            {
+                return FALSE;
+            }
+            zz    |= static_cast<gmx_uint64_t>(buf[i] & 0x7f) << shift;
+            shift += 7;
+        }
+        while (buf[i++] & 0x80);
+
+        gmx_uint64_t dd = (zz >> 1) ^ (~(zz & 1) + 1);
+        prevDelta       = prevDelta + dd;
+        prev            = prev + prevDelta;
+        v[f]            = static_cast<gmx_int64_t>(prev);
+    }
+    return TRUE;
+}
+
+static void write_header(ener_columnar *ec)
+{
+    std::vector<unsigned char> buf;
+
+    put_uint32(&buf, ecol_magic_file);
+    put_uint32(&buf, ecol_version);
+    put_uint32(&buf, ec->precision);
+    put_uint32(&buf, ec->name.size());
+    for (size_t i = 0; i < ec->name.size(); i++)
+    {
+        put_string(&buf, ec->name[i]);
+        put_string(&buf, ec->unit[i]);
+    }
+    write_bytes(ec, buf);
+    ec->dataEnd = gmx_ftell(ec->fp);
+}
+
+static void read_header(ener_columnar *ec)
+{
+    std::vector<unsigned char> buf;
+    const unsigned char       *p;
+
+    if (!read_bytes(ec->fp, 16, &buf))
+    {
+        gmx_fatal(FARGS, "File %s is empty or not a columnar energy file", ec->fn.c_str());
+    }
+    p = buf.data();
+    if (get_uint32(&p) != ecol_magic_file)
+    {
+        gmx_fatal(FARGS, "File %s is not a columnar energy file", ec->fn.c_str());
+    }
+    int file_version = get_uint32(&p);
+    if (file_version > ecol_version)
+    {
+        gmx_fatal(FARGS, "reading columnar energy file (%s) version %d with version %d program",
+                  ec->fn.c_str(), file_version, ecol_version);
+    }
+    ec->precision = get_uint32(&p);
+    if (ec->precision != sizeof(float) && ec->precision != sizeof(double))
+    {
+        gmx_fatal(FARGS, "Columnar energy file %s has an invalid precision of %d bytes",
+                  ec->fn.c_str(), ec->precision);
+    }
+    int nre = get_uint32(&p);
+    for (int i = 0; i < 2*nre; i++)
+    {
+        if (!read_bytes(ec->fp, 4, &buf))
+        {
+            gmx_file("Cannot read columnar energy file header. Corrupt file?");
+        }
+        p = buf.data();
+        unsigned int len = get_uint32(&p);
+        if (!read_bytes(ec->fp, len, &buf))
+        {
+            gmx_file("Cannot read columnar energy file header. Corrupt file?");
+        }
+        std::string s(buf.begin(), buf.end());
+        if (i % 2 == 0)
+        {
+            ec->name.push_back(s);
+        }
+        else
+        {
+            ec->unit.push_back(s);
+        }
+    }
+    ec->dataEnd = gmx_ftell(ec->fp);
+}
+
+/* Reads the chunk header at offset, returns FALSE when it is
+ * incomplete, fileSize is used to check that the data is complete.
+ */
+static gmx_bool read_chunk_header(ener_columnar *ec, gmx_off_t offset,
+                                  gmx_off_t fileSize,
+                                  t_ecol_chunk *chunk,
+                                  std::vector<gmx_off_t> *columnOffset)
+{
+    std::vector<unsigned char> buf;
+    const unsigned char       *p;
+    int                        ncol = ecol_ncolumns(ec);
+
+    if (gmx_fseek(ec->fp, offset, SEEK_SET) != 0 ||
+        !read_bytes(ec->fp, ecol_chunk_header_size + 4*ncol, &buf))
+    {
+        return FALSE;
+    }
+    p = buf.data();
+    if (get_uint32(&p) != ecol_magic_chunk)
+    {
+        return FALSE;
+    }
+    chunk->offset    = offset;
+    chunk->nframes   = get_uint32(&p);
+    chunk->firstStep = get_int64(&p);
+    chunk->lastStep  = get_int64(&p);
+    if (static_cast<int>(get_uint32(&p)) != ncol)
+    {
+        return FALSE;
+    }
+    gmx_off_t pos = offset + ecol_chunk_header_size + 4*ncol;
+    columnOffset->resize(ncol + 1);
+    for (int c = 0; c < ncol; c++)
+    {
+        (*columnOffset)[c] = pos;
+        pos               += get_uint32(&p);
+    }
+    (*columnOffset)[ncol] = pos;
+
+    return (pos <= fileSize);
+}
+
+/* Reads the chunk directory from the footer or, when the file was
+ * not closed properly, by scanning the chunks.
+ */
+static void read_directory(ener_columnar *ec)
+{
+    std::vector<unsigned char> buf;
+    const unsigned char       *p;
+    gmx_off_t                  dataStart = ec->dataEnd;
+
+    gmx_fseek(ec->fp, 0, SEEK_END);
+    gmx_off_t fileSize = gmx_ftell(ec->fp);
+
+    if (fileSize >= dataStart + ecol_footer_size &&
+        gmx_fseek(ec->fp, fileSize - ecol_footer_size, SEEK_SET) == 0 &&
+        read_bytes(ec->fp, ecol_footer_size, &buf))
+    {
+        p = buf.data();
+        gmx_off_t dirOffset = get_int64(&p);
+        if (get_uint32(&p) == ecol_magic_end &&
+            dirOffset >= dataStart && dirOffset < fileSize &&
+            gmx_fseek(ec->fp, dirOffset, SEEK_SET) == 0 &&
+            read_bytes(ec->fp, 8, &buf))
+        {
+            p = buf.data();
+            unsigned int magic   = get_uint32(&p);
+            int          nchunk  = get_uint32(&p);
+            if (magic == ecol_magic_dir &&
+                read_bytes(ec->fp, nchunk*(8 + 4 + 8 + 8), &buf))
+            {
+                p = buf.data();
+                for (int c = 0; c < nchunk; c++)
+                {
+                    t_ecol_chunk chunk;
+                    chunk.offset    = get_int64(&p);
+                    chunk.nframes   = get_uint32(&p);
+                    chunk.firstStep = get_int64(&p);
+                    chunk.lastStep  = get_int64(&p);
+                    ec->chunk.push_back(chunk);
+                }
+                ec->dataEnd = dirOffset;
+                return;
+            }
+        }
+    }
+
+    fprintf(stderr, "\nWARNING: No directory found in columnar energy file %s, scanning the file\n",
+            ec->fn.c_str());
+
+    std::vector<gmx_off_t> columnOffset;
+    t_ecol_chunk           chunk;
+    while (read_chunk_header(ec, ec->dataEnd, fileSize, &chunk, &columnOffset))
+    {
+        ec->chunk.push_back(chunk);
+        ec->dataEnd = columnOffset.back();
+    }
+}
+
+/* Clears the frame buffers */
+static void clear_frames(ener_columnar *ec)
+{
+    ec->t.clear();
+    ec->step.clear();
+    ec->nsum.clear();
+    ec->nsteps.clear();
+    ec->dt.clear();
+    ec->nre.clear();
+    ec->blocks.clear();
+    for (auto &v : ec->value)
+    {
+        v.clear();
+    }
+}
+
+static void write_chunk(ener_columnar *ec)
+{
+    int nframes = ec->t.size();
+    if (nframes == 0)
+    {
+        return;
+    }
+
+    int                                      ncol = ecol_ncolumns(ec);
+    std::vector<std::vector<unsigned char> > column(ncol);
+
+    encode_real_column(ec->t, sizeof(double), &column[ecolTIME]);
+    encode_int_column(ec->step, &column[ecolSTEP]);
+    encode_int_column(ec->nsum, &column[ecolNSUM]);
+    encode_int_column(ec->nsteps, &column[ecolNSTEPS]);
+    encode_real_column(ec->dt, sizeof(double), &column[ecolDT]);
+    encode_int_column(ec->nre, &column[ecolNRE]);
+    column[ecolBLOCKS] = ec->blocks;
+    for (int c = ecolNR; c < ncol; c++)
+    {
+        encode_real_column(ec->value[c - ecolNR], ec->precision, &column[c]);
+    }
+
+    std::vector<unsigned char> buf;
+    put_uint32(&buf, ecol_magic_chunk);
+    put_uint32(&buf, nframes);
+    put_int64(&buf, ec->step.front());
+    put_int64(&buf, ec->step.back());
+    put_uint32(&buf, ncol);
+    for (int c = 0; c < ncol; c++)
+    {
+        put_uint32(&buf, column[c].size());
+    }
+    for (int c = 0; c < ncol; c++)
+    {
+        buf.insert(buf.end(), column[c].begin(), column[c].end());
+    }
+
+    t_ecol_chunk chunk;
+    chunk.offset    = ec->dataEnd;
+    chunk.nframes   = nframes;
+    chunk.firstStep = ec->step.front();
+    chunk.lastStep  = ec->step.back();
+    ec->chunk.push_back(chunk);
+
+    gmx_fseek(ec->fp, ec->dataEnd, SEEK_SET);
+    write_bytes(ec, buf);
+    fflush(ec->fp);
+    ec->dataEnd += buf.size();
+
+    clear_frames(ec);
+}
+
+static void write_directory(ener_columnar *ec)
+{
+    std::vector<unsigned char> buf;
+
+    put_uint32(&buf, ecol_magic_dir);
+    put_uint32(&buf, ec->chunk.size());
+    for (const t_ecol_chunk &chunk : ec->chunk)
+    {
+        put_int64(&buf, chunk.offset);
+        put_uint32(&buf, chunk.nframes);
+        put_int64(&buf, chunk.firstStep);
+        put_int64(&buf, chunk.lastStep);
+    }
+    put_int64(&buf, ec->dataEnd);
+    put_uint32(&buf, ecol_magic_end);
+
+    gmx_fseek(ec->fp, ec->dataEnd, SEEK_SET);
+    write_bytes(ec, buf);
+}
+
+/* Reads column col of chunk c into the buffer, returns the column data */
+static void read_chunk_column(ener_columnar *ec, int c, int col,
+                              std::vector<unsigned char> *buf)
+{
+    std::vector<gmx_off_t> columnOffset;
+    t_ecol_chunk           chunk;
+
+    if (!read_chunk_header(ec, ec->chunk[c].offset, ec->dataEnd, &chunk, &columnOffset) ||
+        chunk.nframes != ec->chunk[c].nframes ||
+        gmx_fseek(ec->fp, columnOffset[col], SEEK_SET) != 0 ||
+        !read_bytes(ec->fp, columnOffset[col + 1] - columnOffset[col], buf))
+    {
+        gmx_fatal(FARGS, "Cannot read chunk %d of columnar energy file %s. Corrupt file?",
+                  c, ec->fn.c_str());
+    }
+}
+
+static void read_real_column(ener_columnar *ec, int col, int width, double *values)
+{
+    std::vector<unsigned char> buf;
+
+    for (size_t c = 0; c < ec->chunk.size(); c++)
+    {
+        read_chunk_column(ec, c, col, &buf);
+        if (!decode_real_column(buf, width, ec->chunk[c].nframes, values))
+        {
+            gmx_fatal(FARGS, "Cannot decode chunk %d of columnar energy file %s. Corrupt file?",
+                      static_cast<int>(c), ec->fn.c_str());
+        }
+        values += ec->chunk[c].nframes;
+    }
+}
+
+static void read_int_column(ener_columnar *ec, int col, gmx_int64_t *values)
+{
+    std::vector<unsigned char> buf;
+
+    for (size_t c = 0; c < ec->chunk.size(); c++)
+    {
+        read_chunk_column(ec, c, col, &buf);
+        if (!decode_int_column(buf, ec->chunk[c].nframes, values))
+        {
+            gmx_fatal(FARGS, "Cannot decode chunk %d of columnar energy file %s. Corrupt file?",
+                      static_cast<int>(c), ec->fn.c_str());
+        }
+        values += ec->chunk[c].nframes;
+    }
+}
+
+/* Reads all columns of chunk c into the frame buffers */
+static void load_chunk(ener_columnar *ec, int c)
+{
+    int                        nframes = ec->chunk[c].nframes;
+    int                        ncol    = ecol_ncolumns(ec);
+    std::vector<unsigned char> buf;
+
+    clear_frames(ec);
+    ec->t.resize(nframes);
+    ec->step.resize(nframes);
+    ec->nsum.resize(nframes);
+    ec->nsteps.resize(nframes);
+    ec->dt.resize(nframes);
+    ec->nre.resize(nframes);
+    ec->value.resize(ncol - ecolNR);
+
+    read_chunk_column(ec, c, ecolTIME, &buf);
+    gmx_bool bOK = decode_real_column(buf, sizeof(double), nframes, ec->t.data());
+    read_chunk_column(ec, c, ecolSTEP, &buf);
+    bOK = bOK && decode_int_column(buf, nframes, ec->step.data());
+    read_chunk_column(ec, c, ecolNSUM, &buf);
+    bOK = bOK && decode_int_column(buf, nframes, ec->nsum.data());
+    read_chunk_column(ec, c, ecolNSTEPS, &buf);
+    bOK = bOK && decode_int_column(buf, nframes, ec->nsteps.data());
+    read_chunk_column(ec, c, ecolDT, &buf);
+    bOK = bOK && decode_real_column(buf, sizeof(double), nframes, ec->dt.data());
+    read_chunk_column(ec, c, ecolNRE, &buf);
+    bOK = bOK && decode_int_column(buf, nframes, ec->nre.data());
+    read_chunk_column(ec, c, ecolBLOCKS, &ec->blocks);
+    for (int col = ecolNR; col < ncol; col++)
+    {
+        ec->value[col - ecolNR].resize(nframes);
+        read_chunk_column(ec, c, col, &buf);
+        bOK = bOK && decode_real_column(buf, ec->precision, nframes, ec->value[col - ecolNR].data());
+    }
+    if (!bOK)
+    {
+        gmx_fatal(FARGS, "Cannot decode chunk %d of columnar energy file %s. Corrupt file?",
+                  c, ec->fn.c_str());
+    }
+}
+
+/* Removes all frames with step >= step, for appending after a restart */
+static void truncate_frames(ener_columnar *ec, gmx_int64_t step)
+{
+    size_t c = 0;
+    while (c < ec->chunk.size() && ec->chunk[c].lastStep < step)
+    {
+        c++;
+    }
+    if (c == ec->chunk.size())
+    {
+        return;
+    }
+
+    /* Read the chunk that contains the step back into the buffers
+     * and keep the frames before the step.
+     */
+    load_chunk(ec, c);
+    size_t nframes  = 0;
+    size_t blockEnd = 0;
+    while (nframes < ec->step.size() && ec->step[nframes] < step)
+    {
+        if (!get_blocks(ec->blocks, &blockEnd, nullptr))
+        {
+            gmx_fatal(FARGS, "Cannot decode columnar energy file %s for appending", ec->fn.c_str());
+        }
+        nframes++;
+    }
+    ec->t.resize(nframes);
+    ec->step.resize(nframes);
+    ec->nsum.resize(nframes);
+    ec->nsteps.resize(nframes);
+    ec->dt.resize(nframes);
+    ec->nre.resize(nframes);
+    ec->blocks.resize(blockEnd);
+    for (auto &v : ec->value)
+    {
+        v.resize(nframes);
+    }
+
+    ec->dataEnd = ec->chunk[c].offset;
+    ec->chunk.resize(c);
+
+    /* Remove the old data from the file */
+    close_file(ec);
+    if (gmx_truncate(ec->fn.c_str(), ec->dataEnd) != 0)
+    {
+        gmx_fatal(FARGS, "Cannot truncate columnar energy file %s for appending", ec->fn.c_str());
+    }
+    open_file(ec, "r+");
+}
+
+gmx_bool is_ener_columnar(const char *fn)
+{
+    std::vector<unsigned char> buf;
+    const unsigned char       *p;
+    gmx_bool                   bColumnar = FALSE;
+
+    FILE                      *fp = gmx_ffopen(fn, "rb");
+    if (read_bytes(fp, 4, &buf))
+    {
+        p         = buf.data();
+        bColumnar = (get_uint32(&p) == ecol_magic_file);
+    }
+    gmx_ffclose(fp);
+
+    return bColumnar;
+}
+
+ener_columnar_t open_ener_columnar(const char *fn, const char *mode)
+{
+    ener_columnar *ec = new ener_columnar;
+
+    ec->fn                    = fn;
+    ec->bRead                 = (mode[0] == 'r');
+    ec->bTruncateAtFirstFrame = FALSE;
+    ec->dataEnd               = 0;
+    ec->readChunk             = 0;
+    ec->readFrame             = 0;
+    ec->readBlockPos          = 0;
+    /* As in edr files, the energies are stored with the precision of real */
+    ec->precision             = sizeof(real);
+
+    if (mode[0] == 'w')
+    {
+        open_file(ec, "w+");
+    }
+    else
+    {
+        open_file(ec, "r+");
+        read_header(ec);
+        read_directory(ec);
+        if (mode[0] == 'a')
+        {
+            /* Remove the directory, it is written again at close */
+            close_file(ec);
+            if (gmx_truncate(fn, ec->dataEnd) != 0)
+            {
+                gmx_fatal(FARGS, "Cannot truncate columnar energy file %s for appending", fn);
+            }
+            open_file(ec, "r+");
+            ec->value.resize(ecol_ncolumns(ec) - ecolNR);
+            ec->bTruncateAtFirstFrame = TRUE;
+        }
+    }
+
+    return ec;
+}
+
+void close_ener_columnar(ener_columnar_t ec)
+{
+    if (ec == nullptr)
+    {
+        return;
+    }
+    if (!ec->bRead)
+    {
+        write_chunk(ec);
+        write_directory(ec);
+    }
+    if (close_file(ec) != 0)
+    {
+        gmx_file("Cannot close columnar energy file; it might be corrupt, or maybe you are out of disk space?");
+    }
+    delete ec;
+}
+
+void ener_columnar_set_terms(ener_columnar_t ec, int nre, const gmx_enxnm_t *nms)
+{
+    GMX_RELEASE_ASSERT(!ec->bRead && ec->name.empty() && ec->chunk.empty(),
+                       "Energy terms can only be set once for a new file");
+
+    for (int i = 0; i < nre; i++)
+    {
+        ec->name.push_back(nms[i].name);
+        ec->unit.push_back(nms[i].unit != nullptr ? nms[i].unit : "");
+    }
+    ec->value.resize(ecol_ncolumns(ec) - ecolNR);
+    write_header(ec);
+}
+
+void ener_columnar_add_frame(ener_columnar_t ec, const t_enxframe *fr)
+{
+    int nre = ec->name.size();
+
+    GMX_RELEASE_ASSERT(!ec->bRead && ec->dataEnd > 0,
+                       "The energy terms should be set before adding frames");
+    /* Frames with only blocks have no energies */
+    if (fr->nre != nre && fr->nre != 0)
+    {
+        gmx_fatal(FARGS, "Adding a frame with %d energies to columnar energy file %s with %d energies",
+                  fr->nre, ec->fn.c_str(), nre);
+    }
+    if (ec->bTruncateAtFirstFrame)
+    {
+        truncate_frames(ec, fr->step);
+        ec->bTruncateAtFirstFrame = FALSE;
+    }
+
+    /* As in edr files, sums of length 1 are not stored, since
+     * they do not add information. Zeros cost one byte per value.
+     */
+    gmx_bool bSum = (fr->nsum > 1);
+    ec->t.push_back(fr->t);
+    ec->step.push_back(fr->step);
+    ec->nsum.push_back(bSum ? fr->nsum : 0);
+    ec->nsteps.push_back(fr->nsteps);
+    ec->dt.push_back(fr->dt);
+    ec->nre.push_back(fr->nre);
+    put_blocks(&ec->blocks, fr);
+    for (int i = 0; i < nre; i++)
+    {
+        gmx_bool bE = (i < fr->nre);
+        ec->value[ecolfNR*i + ecolfE].push_back(bE ? fr->ener[i].e : 0);
+        ec->value[ecolfNR*i + ecolfAV].push_back(bE && bSum ? fr->ener[i].eav : 0);
+        ec->value[ecolfNR*i + ecolfSUM].push_back(bE && bSum ? fr->ener[i].esum : 0);
+    }
+
+    if (static_cast<int>(ec->t.size()) >= ecol_frames_per_chunk)
+    {
+        write_chunk(ec);
+    }
+}
+
+void ener_columnar_flush(ener_columnar_t ec)
+{
+    if (!ec->bRead)
+    {
+        write_chunk(ec);
+    }
+}
+
+gmx_bool ener_columnar_read_frame(ener_columnar_t ec, t_enxframe *fr)
+{
+    GMX_RELEASE_ASSERT(ec->bRead, "Can only read from a columnar energy file opened for reading");
+
+    if (ec->readFrame == ec->t.size())
+    {
+        if (ec->readChunk == ec->chunk.size())
+        {
+            return FALSE;
+        }
+        load_chunk(ec, ec->readChunk);
+        ec->readChunk++;
+        ec->readFrame    = 0;
+        ec->readBlockPos = 0;
+    }
+    size_t f = ec->readFrame;
+    ec->readFrame++;
+
+    fr->t      = ec->t[f];
+    fr->step   = ec->step[f];
+    fr->nsum   = ec->nsum[f];
+    fr->nsteps = ec->nsteps[f];
+    fr->dt     = ec->dt[f];
+    fr->nre    = ec->nre[f];
+    if (fr->nre > fr->e_alloc)
+    {
+        srenew(fr->ener, fr->nre);
+        fr->e_alloc = fr->nre;
+    }
+    for (int i = 0; i < fr->nre; i++)
+    {
+        fr->ener[i].e    = ec->value[ecolfNR*i + ecolfE][f];
+        fr->ener[i].eav  = ec->value[ecolfNR*i + ecolfAV][f];
+        fr->ener[i].esum = ec->value[ecolfNR*i + ecolfSUM][f];
+    }
+    fr->e_size = fr->nre*sizeof(fr->ener[0].e)*4;
+    if (!get_blocks(ec->blocks, &ec->readBlockPos, fr))
+    {
+        char buf[STEPSTRSIZE];
+        gmx_fatal(FARGS, "Cannot decode the blocks at step %s of columnar energy file %s. Corrupt file?",
+                  gmx_step_str(fr->step, buf), ec->fn.c_str());
+    }
+
+    return TRUE;
+}
+
+void ener_columnar_get_terms(ener_columnar_t ec, int *nre, gmx_enxnm_t **nms)
+{
+    *nre = ec->name.size();
+    snew(*nms, *nre);
+    for (int i = 0; i < *nre; i++)
+    {
+        (*nms)[i].name = gmx_strdup(ec->name[i].c_str());
+        (*nms)[i].unit = gmx_strdup(ec->unit[i].c_str());
+    }
+}
+
+gmx_int64_t ener_columnar_nframes(ener_columnar_t ec)
+{
+    /* When reading, the buffers contain frames already in the chunks */
+    gmx_int64_t nframes = (ec->bRead ? 0 : ec->t.size());
+    for (const t_ecol_chunk &chunk : ec->chunk)
+    {
+        nframes += chunk.nframes;
+    }
+    return nframes;
+}
+
+void ener_columnar_read_frames(ener_columnar_t ec,
+                               double *t, gmx_int64_t *step, int *nsum)
+{
+    GMX_RELEASE_ASSERT(ec->bRead, "Can only read from a columnar energy file opened for reading");
+
+    if (t != nullptr)
+    {
+        read_real_column(ec, ecolTIME, sizeof(double), t);
+    }
+    if (step != nullptr)
+    {
+        read_int_column(ec, ecolSTEP, step);
+    }
+    if (nsum != nullptr)
+    {
+        std::vector<gmx_int64_t> buf(ener_columnar_nframes(ec));
+        read_int_column(ec, ecolNSUM, buf.data());
+        for (size_t f = 0; f < buf.size(); f++)
+        {
+            nsum[f] = buf[f];
+        }
+    }
+}
+
+void ener_columnar_read_term(ener_columnar_t ec, int term, int field,
+                             double *values)
+{
+    GMX_RELEASE_ASSERT(ec->bRead, "Can only read from a columnar energy file opened for reading");
+
+    if (term < 0 || term >= static_cast<int>(ec->name.size()) ||
+        field < 0 || field >= ecolfNR)
+    {
+        gmx_fatal(FARGS, "Energy term %d field %d not present in columnar energy file %s",
+                  term, field, ec->fn.c_str());
+    }
+    read_real_column(ec, ecolNR + ecolfNR*term + field, ec->precision, values);
+}
@@ -0,0 +1,126 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifndef GMX_FILEIO_ENXCOLUMNAR_H
+#define GMX_FILEIO_ENXCOLUMNAR_H
+
+#include "gromacs/fileio/enxio.h"
+#include "gromacs/utility/basedefinitions.h"
+
+/**************************************************************
+ * Columnar energy files.
+ *
+ * These contain the same frames as an edr file, but the energy
+ * terms are stored per term instead of per frame. Frames are collected
+ * in chunks; within a chunk every column (time, step, nsum, nsteps, dt,
+ * the number of energies, the blocks and e, eav and esum of every term)
+ * is stored separately: energies are
+ * stored with the precision of real, as in edr files, floating-point
+ * values are XOR-ed with the previous value and stored without their
+ * leading and trailing zero bytes, integers are stored as varint
+ * delta-of-deltas. A directory with the chunk offsets is written at
+ * close, so a reader only needs to read the columns it uses.
+ *
+ * Each chunk is self-describing, so a file that was not closed
+ * properly can still be read up to the last complete chunk.
+ * The blocks (e.g. free-energy data) of each frame are stored
+ * uncompressed in a single column.
+ *
+ * Files opened for writing are registered with gmx_fio, so checkpoints
+ * store their offset and checksum, as for other output files.
+ *
+ * When the environment variable GMX_ENER_COLUMNAR is set, open_enx
+ * writes energy files in this format instead of the XDR format.
+ * open_enx detects the format when reading, so all tools that use
+ * do_enx can read such files.
+ **************************************************************/
+
+/* The fields stored for each energy term */
+enum {
+    ecolfE, ecolfAV, ecolfSUM, ecolfNR
+};
+
+typedef struct ener_columnar *ener_columnar_t;
+
+gmx_bool is_ener_columnar(const char *fn);
+/* Returns whether the existing file fn is a columnar energy file */
+
+ener_columnar_t open_ener_columnar(const char *fn, const char *mode);
+/* Opens a columnar energy file with mode "r", "w" or "a".
+ * With "a" the names are taken from the file. When the first frame
+ * appended has a step that is not larger than the last step in the
+ * file, the frames from that step onwards are removed, as is needed
+ * for continuing from a checkpoint.
+ */
+
+void close_ener_columnar(ener_columnar_t ec);
+/* Writes the remaining frames and the directory, closes the file
+ * and frees ec.
+ */
+
+void ener_columnar_set_terms(ener_columnar_t ec, int nre, const gmx_enxnm_t *nms);
+/* Sets the energy term names, should be called once before adding
+ * frames to a newly written file.
+ */
+
+void ener_columnar_add_frame(ener_columnar_t ec, const t_enxframe *fr);
+/* Adds frame fr, the number of energies should match or be zero */
+
+void ener_columnar_flush(ener_columnar_t ec);
+/* Writes the frames added so far to the file */
+
+gmx_bool ener_columnar_read_frame(ener_columnar_t ec, t_enxframe *fr);
+/* Reads the next frame into fr, memory in fr is (re)allocated
+ * if necessary. Returns FALSE when all frames have been read.
+ */
+
+void ener_columnar_get_terms(ener_columnar_t ec, int *nre, gmx_enxnm_t **nms);
+/* Returns the term names, free with free_enxnms */
+
+gmx_int64_t ener_columnar_nframes(ener_columnar_t ec);
+/* Returns the number of frames in the file */
+
+void ener_columnar_read_frames(ener_columnar_t ec,
+                               double *t, gmx_int64_t *step, int *nsum);
+/* Reads the time, step and number of summed steps of all frames,
+ * each of the arrays can be nullptr when not needed.
+ */
+
+void ener_columnar_read_term(ener_columnar_t ec, int term, int field,
+                             double *values);
+/* Reads field (ecolfE, ecolfAV or ecolfSUM) of energy term
+ * number term for all frames, reading only the data for this column.
+ */
+
+#endif
@@ -43,6 +43,7 @@
 
 #include <algorithm>
 
+#include "gromacs/fileio/enxcolumnar.h"
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/fileio/gmxfio-xdr.h"
 #include "gromacs/fileio/xdrf.h"
@@ -88,10 +89,12 @@ typedef struct {
 
 struct ener_file
 {
-    ener_old_t eo;
-    t_fileio  *fio;
-    int        framenr;
-    real       frametime;
+    ener_old_t      eo;
+    t_fileio       *fio;
+    int             framenr;
+    real            frametime;
+    ener_columnar_t columnar;      /* The columnar file, when not using fio */
+    gmx_bool        bReadColumnar; /* Whether columnar is opened for reading */
 };
 
 static void enxsubblock_init(t_enxsubblock *sb)
@@ -166,7 +169,7 @@ static void enxsubblock_free(t_enxsubblock *sb)
 }
 
 /* allocate the appropriate amount of memory for the given type and nr */
-static void enxsubblock_alloc(t_enxsubblock *sb)
+void enxsubblock_alloc(t_enxsubblock *sb)
 {
     /* allocate the appropriate amount of memory */
     switch (sb->type)
@@ -389,10 +392,24 @@ void do_enxnms(ener_file_t ef, int *nre, gmx_enxnm_t **nms)
 {
     int      magic = -55555;
     XDR     *xdr;
-    gmx_bool bRead = gmx_fio_getread(ef->fio);
+    gmx_bool bRead;
     int      file_version;
 
-    xdr = gmx_fio_getxdr(ef->fio);
+    if (ef->columnar != nullptr)
+    {
+        if (ef->bReadColumnar)
+        {
+            ener_columnar_get_terms(ef->columnar, nre, nms);
+        }
+        else
+        {
+            ener_columnar_set_terms(ef->columnar, *nre, *nms);
+        }
+        return;
+    }
+
+    bRead = gmx_fio_getread(ef->fio);
+    xdr   = gmx_fio_getxdr(ef->fio);
 
     if (!xdr_int(xdr, &magic))
     {
@@ -752,6 +769,12 @@ void close_enx(ener_file_t ef)
         // Nothing to do
         return;
     }
+    if (ef->columnar != nullptr)
+    {
+        close_ener_columnar(ef->columnar);
+        ef->columnar = nullptr;
+        return;
+    }
     if (gmx_fio_close(ef->fio) != 0)
     {
         gmx_file("Cannot close energy file; it might be corrupt, or maybe you are out of disk space?");
@@ -804,7 +827,21 @@ ener_file_t open_enx(const char *fn, const char *mode)
 
     snew(ef, 1);
 
-    if (mode[0] == 'r')
+    /* When appending, the format of the existing file is continued */
+    if ((mode[0] == 'r' || mode[0] == 'a') && gmx_fexist(fn) && is_ener_columnar(fn))
+    {
+        ef->columnar      = open_ener_columnar(fn, mode[0] == 'r' ? "r" : "a");
+        ef->bReadColumnar = (mode[0] == 'r');
+        if (ef->bReadColumnar && debug)
+        {
+            fprintf(debug, "Opened %s as columnar energy file\n", fn);
+        }
+    }
+    else if (mode[0] == 'w' && getenv("GMX_ENER_COLUMNAR") != nullptr)
+    {
+        ef->columnar = open_ener_columnar(fn, "w");
+    }
+    else if (mode[0] == 'r')
     {
         ef->fio = gmx_fio_open(fn, mode);
         gmx_fio_setprecision(ef->fio, FALSE);
@@ -944,6 +981,20 @@ static void convert_full_sums(ener_old_t *ener_old, t_enxframe *fr)
     ener_old->step_prev = fr->step;
 }
 
+/* Prints the progress of reading and counts the frame read */
+static void print_read_progress(ener_file_t ef, const t_enxframe *fr)
+{
+    if ((ef->framenr <   20 || ef->framenr %   10 == 0) &&
+        (ef->framenr <  200 || ef->framenr %  100 == 0) &&
+        (ef->framenr < 2000 || ef->framenr % 1000 == 0))
+    {
+        fprintf(stderr, "\rReading energy frame %6d time %8.3f         ",
+                ef->framenr, fr->t);
+    }
+    ef->framenr++;
+    ef->frametime = fr->t;
+}
+
 gmx_bool do_enx(ener_file_t ef, t_enxframe *fr)
 {
     int           file_version = -1;
@@ -952,6 +1003,24 @@ gmx_bool do_enx(ener_file_t ef, t_enxframe *fr)
     real          tmp1, tmp2, rdum;
     /*int       d_size;*/
 
+    if (ef->columnar != nullptr)
+    {
+        if (!ef->bReadColumnar)
+        {
+            ener_columnar_add_frame(ef->columnar, fr);
+            return TRUE;
+        }
+        if (!ener_columnar_read_frame(ef->columnar, fr))
+        {
+            fprintf(stderr, "\rLast energy frame read %d time %8.3f         ",
+                    ef->framenr-1, ef->frametime);
+            fflush(stderr);
+            return FALSE;
+        }
+        print_read_progress(ef, fr);
+        return TRUE;
+    }
+
     bOK   = TRUE;
     bRead = gmx_fio_getread(ef->fio);
     if (!bRead)
@@ -983,15 +1052,7 @@ gmx_bool do_enx(ener_file_t ef, t_enxframe *fr)
     }
     if (bRead)
     {
-        if ((ef->framenr <   20 || ef->framenr %   10 == 0) &&
-            (ef->framenr <  200 || ef->framenr %  100 == 0) &&
-            (ef->framenr < 2000 || ef->framenr % 1000 == 0))
-        {
-            fprintf(stderr, "\rReading energy frame %6d time %8.3f         ",
-                    ef->framenr, fr->t);
-        }
-        ef->framenr++;
-        ef->frametime = fr->t;
+        print_read_progress(ef, fr);
     }
     /* Check sanity of this header */
     bSane = fr->nre > 0;
@@ -1131,6 +1192,18 @@ gmx_bool do_enx(ener_file_t ef, t_enxframe *fr)
     return TRUE;
 }
 
+void flush_enx(ener_file_t ef)
+{
+    if (ef->columnar != nullptr)
+    {
+        ener_columnar_flush(ef->columnar);
+    }
+    else if (gmx_fio_flush(ef->fio) != 0)
+    {
+        gmx_file("Cannot write energy file; maybe you are out of disk space?");
+    }
+}
+
 static real find_energy(const char *name, int nre, gmx_enxnm_t *enm,
                         t_enxframe *fr)
 {
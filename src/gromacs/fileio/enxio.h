@@ -172,6 +172,7 @@ void free_enxframe(t_enxframe *ef);
 
 ener_file_t open_enx(const char *fn, const char *mode);
 
+/* Returns nullptr for columnar energy files, see enxcolumnar.h */
 struct t_fileio *enx_file_pointer(const ener_file_t ef);
 
 /* Free the contents of ef */
@@ -188,6 +189,11 @@ void free_enxnms(int n, gmx_enxnm_t *nms);
 gmx_bool do_enx(ener_file_t ef, t_enxframe *fr);
 /* Reads enx_frames, memory in fr is (re)allocated if necessary */
 
+void flush_enx(ener_file_t ef);
+/* Ensures all frames written so far are in the file, as needed
+ * for checkpointing.
+ */
+
 void get_enx_state(const char *fn, real t,
                    const gmx_groups_t *groups, t_inputrec *ir,
                    t_state *state);
@@ -213,6 +219,9 @@ t_enxblock *find_block_id_enxframe(t_enxframe *ef, int id, t_enxblock *prev);
    subbblocks. */
 void add_subblocks_enxblock(t_enxblock *eb, int n);
 
+/* allocate the values of a subblock for its type and nr (if neccesary) */
+void enxsubblock_alloc(t_enxsubblock *sb);
+
 void comp_enx(const char *fn1, const char *fn2, real ftol, real abstol,
               const char *lastener);
 /* Compare two binary energy files */
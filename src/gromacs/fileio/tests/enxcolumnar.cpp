@@ -0,0 +1,479 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for reading and writing columnar energy files.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/enxcolumnar.h"
+
+#include <cmath>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/enxio.h"
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/utility/cstringutil.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace
+{
+
+//! The number of energy terms in the test files
+const int c_numTerms = 3;
+
+class EnerColumnarTest : public ::testing::Test
+{
+    public:
+        EnerColumnarTest()
+        {
+            fileName_ = fileManager_.getTemporaryFilePath("ener.edr");
+            init_enxframe(&frame_);
+            snew(frame_.ener, c_numTerms);
+            frame_.e_alloc = c_numTerms;
+        }
+        ~EnerColumnarTest()
+        {
+            free_enxframe(&frame_);
+        }
+
+        //! Returns a reference energy of term i at step
+        static real energy(int i, gmx_int64_t step, real offset)
+        {
+            return offset + (i + 1)*std::sin(0.01*step) - 100*i;
+        }
+
+        //! Returns whether the frame at step only contains blocks
+        static bool hasOnlyBlocks(gmx_int64_t step)
+        {
+            return (step % 30 == 20);
+        }
+
+        /*! \brief Sets fr to the reference frame at step
+         *
+         * Frames contain blocks of different types, with different
+         * numbers of values, and some frames contain only blocks,
+         * as with free-energy output at a different interval.
+         * String subblocks are only added with \p withStrings, since
+         * the XDR format does not read them back.
+         */
+        static void setFrame(t_enxframe *fr, gmx_int64_t step, real offset,
+                             bool withStrings = true)
+        {
+            fr->step   = step;
+            fr->t      = 0.002*step;
+            fr->nsum   = (step == 0 ? 1 : 10);
+            fr->nsteps = (step == 0 ? 1 : 10);
+            fr->dt     = 0.002;
+            fr->nre    = (hasOnlyBlocks(step) ? 0 : c_numTerms);
+            for (int i = 0; i < fr->nre; i++)
+            {
+                fr->ener[i].e    = energy(i, step, offset);
+                fr->ener[i].eav  = 0.1*step + i;
+                fr->ener[i].esum = step + offset;
+            }
+
+            if (step % 20 == 0)
+            {
+                add_blocks_enxframe(fr, 1);
+                fr->block[0].id = enxDHCOLL;
+                add_subblocks_enxblock(&fr->block[0], withStrings ? 3 : 2);
+                fr->block[0].sub[0].type = xdr_datatype_double;
+                fr->block[0].sub[0].nr   = 2;
+                fr->block[0].sub[1].type = xdr_datatype_int64;
+                fr->block[0].sub[1].nr   = 1;
+                enxsubblock_alloc(&fr->block[0].sub[0]);
+                enxsubblock_alloc(&fr->block[0].sub[1]);
+                fr->block[0].sub[0].dval[0] = 0.5*step;
+                fr->block[0].sub[0].dval[1] = offset;
+                fr->block[0].sub[1].lval[0] = 1000000000000LL + step;
+                if (withStrings)
+                {
+                    fr->block[0].sub[2].type = xdr_datatype_string;
+                    fr->block[0].sub[2].nr   = 1;
+                    enxsubblock_alloc(&fr->block[0].sub[2]);
+                    sfree(fr->block[0].sub[2].sval[0]);
+                    fr->block[0].sub[2].sval[0] = gmx_strdup(step % 40 == 0 ? "lambda" : "");
+                }
+            }
+            else
+            {
+                const int n = 1 + step % 7;
+                add_blocks_enxframe(fr, 2);
+                fr->block[0].id = enxDH;
+                add_subblocks_enxblock(&fr->block[0], 2);
+                fr->block[0].sub[0].type = xdr_datatype_float;
+                fr->block[0].sub[0].nr   = n;
+                fr->block[0].sub[1].type = xdr_datatype_char;
+                fr->block[0].sub[1].nr   = n;
+                enxsubblock_alloc(&fr->block[0].sub[0]);
+                enxsubblock_alloc(&fr->block[0].sub[1]);
+                for (int j = 0; j < n; j++)
+                {
+                    fr->block[0].sub[0].fval[j] = std::cos(0.1*step + j) + offset;
+                    fr->block[0].sub[1].cval[j] = (step + j) % 256;
+                }
+                fr->block[1].id = enxDISRE;
+                add_subblocks_enxblock(&fr->block[1], 1);
+                fr->block[1].sub[0].type = xdr_datatype_int;
+                fr->block[1].sub[0].nr   = 1;
+                enxsubblock_alloc(&fr->block[1].sub[0]);
+                fr->block[1].sub[0].ival[0] = -step;
+            }
+        }
+
+        //! Writes frames with steps from first up to last with interval 10
+        void writeFrames(ener_columnar_t ec, gmx_int64_t first, gmx_int64_t last, real offset,
+                         bool withStrings = true)
+        {
+            for (gmx_int64_t step = first; step < last; step += 10)
+            {
+                setFrame(&frame_, step, offset, withStrings);
+                ener_columnar_add_frame(ec, &frame_);
+            }
+        }
+
+        //! Returns the term names, the caller should not free them
+        static gmx_enxnm_t *termNames()
+        {
+            static gmx_enxnm_t nms[c_numTerms] = {
+                { const_cast<char *>("Bond"), const_cast<char *>("kJ/mol") },
+                { const_cast<char *>("LJ (SR)"), const_cast<char *>("kJ/mol") },
+                { const_cast<char *>("Pressure"), const_cast<char *>("bar") }
+            };
+            return nms;
+        }
+
+        //! Writes a new file with frames with steps in [0, last)
+        void writeFile(gmx_int64_t last, bool withStrings = true)
+        {
+            ener_columnar_t ec = open_ener_columnar(fileName_.c_str(), "w");
+            ener_columnar_set_terms(ec, c_numTerms, termNames());
+            writeFrames(ec, 0, last, 0, withStrings);
+            close_ener_columnar(ec);
+        }
+
+        //! Checks that fr equals reference frame ref as read back from an energy file
+        static void checkFrame(const t_enxframe &ref, const t_enxframe &fr)
+        {
+            ASSERT_EQ(ref.step, fr.step);
+            EXPECT_EQ(ref.t, fr.t);
+            /* Sums of length 1 are stored as 0 */
+            EXPECT_EQ(ref.nsum > 1 ? ref.nsum : 0, fr.nsum);
+            EXPECT_EQ(ref.nsteps, fr.nsteps);
+            EXPECT_EQ(ref.dt, fr.dt);
+            ASSERT_EQ(ref.nre, fr.nre);
+            for (int i = 0; i < ref.nre; i++)
+            {
+                EXPECT_EQ(ref.ener[i].e, fr.ener[i].e);
+                if (ref.nsum > 1)
+                {
+                    EXPECT_EQ(ref.ener[i].eav, fr.ener[i].eav);
+                    EXPECT_EQ(ref.ener[i].esum, fr.ener[i].esum);
+                }
+            }
+            ASSERT_EQ(ref.nblock, fr.nblock);
+            for (int b = 0; b < ref.nblock; b++)
+            {
+                EXPECT_EQ(ref.block[b].id, fr.block[b].id);
+                ASSERT_EQ(ref.block[b].nsub, fr.block[b].nsub);
+                for (int s = 0; s < ref.block[b].nsub; s++)
+                {
+                    const t_enxsubblock &subRef = ref.block[b].sub[s];
+                    const t_enxsubblock &sub    = fr.block[b].sub[s];
+                    ASSERT_EQ(subRef.type, sub.type);
+                    ASSERT_EQ(subRef.nr, sub.nr);
+                    for (int j = 0; j < subRef.nr; j++)
+                    {
+                        switch (subRef.type)
+                        {
+                            case xdr_datatype_float:
+                                EXPECT_EQ(subRef.fval[j], sub.fval[j]);
+                                break;
+                            case xdr_datatype_double:
+                                EXPECT_EQ(subRef.dval[j], sub.dval[j]);
+                                break;
+                            case xdr_datatype_int:
+                                EXPECT_EQ(subRef.ival[j], sub.ival[j]);
+                                break;
+                            case xdr_datatype_int64:
+                                EXPECT_EQ(subRef.lval[j], sub.lval[j]);
+                                break;
+                            case xdr_datatype_char:
+                                EXPECT_EQ(subRef.cval[j], sub.cval[j]);
+                                break;
+                            default:
+                                EXPECT_STREQ(subRef.sval[j], sub.sval[j]);
+                                break;
+                        }
+                    }
+                }
+            }
+        }
+
+        /*! \brief Checks all frames in the file, as read by open_enx
+         *
+         * Frames from step switchStep on have offset.
+         */
+        void checkFile(int numFrames, gmx_int64_t switchStep, real offset)
+        {
+            ener_file_t  ef = open_enx(fileName_.c_str(), "r");
+
+            int          nre;
+            gmx_enxnm_t *nms = nullptr;
+            do_enxnms(ef, &nre, &nms);
+            ASSERT_EQ(c_numTerms, nre);
+            EXPECT_STREQ("LJ (SR)", nms[1].name);
+            EXPECT_STREQ("bar", nms[2].unit);
+            free_enxnms(nre, nms);
+
+            t_enxframe fr, ref;
+            init_enxframe(&fr);
+            init_enxframe(&ref);
+            snew(ref.ener, c_numTerms);
+            ref.e_alloc = c_numTerms;
+            int f = 0;
+            while (do_enx(ef, &fr))
+            {
+                setFrame(&ref, 10*f, (10*f >= switchStep ? offset : 0));
+                checkFrame(ref, fr);
+                f++;
+            }
+            EXPECT_EQ(numFrames, f);
+            free_enxframe(&ref);
+            free_enxframe(&fr);
+            done_ener_file(ef);
+        }
+
+        //! Checks the columns in the file, frames from step switchStep on have offset
+        void checkColumns(int numFrames, gmx_int64_t switchStep, real offset)
+        {
+            ener_columnar_t ec = open_ener_columnar(fileName_.c_str(), "r");
+
+            ASSERT_EQ(numFrames, ener_columnar_nframes(ec));
+            std::vector<double>      t(numFrames);
+            std::vector<gmx_int64_t> step(numFrames);
+            std::vector<int>         nsum(numFrames);
+            ener_columnar_read_frames(ec, t.data(), step.data(), nsum.data());
+            for (int f = 0; f < numFrames; f++)
+            {
+                EXPECT_EQ(10*f, step[f]);
+                EXPECT_EQ(0.002*step[f], t[f]);
+                /* As in edr files, sums of length 1 are stored as 0 */
+                EXPECT_EQ(f == 0 ? 0 : 10, nsum[f]);
+            }
+
+            std::vector<double> e(numFrames), esum(numFrames);
+            for (int i = 0; i < c_numTerms; i++)
+            {
+                ener_columnar_read_term(ec, i, ecolfE, e.data());
+                ener_columnar_read_term(ec, i, ecolfSUM, esum.data());
+                for (int f = 0; f < numFrames; f++)
+                {
+                    if (hasOnlyBlocks(step[f]))
+                    {
+                        continue;
+                    }
+                    real o = (step[f] >= switchStep ? offset : 0);
+                    EXPECT_EQ(energy(i, step[f], o), e[f]);
+                    if (nsum[f] > 1)
+                    {
+                        EXPECT_EQ(step[f] + o, esum[f]);
+                    }
+                }
+            }
+            close_ener_columnar(ec);
+        }
+
+        gmx::test::TestFileManager      fileManager_;
+        std::string                     fileName_;
+        t_enxframe                      frame_;
+};
+
+TEST_F(EnerColumnarTest, RoundTrips)
+{
+    /* Several chunks plus a partial chunk */
+    writeFile(25000);
+    checkColumns(2500, 25000, 0);
+    checkFile(2500, 25000, 0);
+}
+
+TEST_F(EnerColumnarTest, ReadsAsXdrEnergyFile)
+{
+    /* Write the same frames to an XDR edr file */
+    std::string xdrFileName = fileManager_.getTemporaryFilePath("xdr.edr");
+    ener_file_t ef          = open_enx(xdrFileName.c_str(), "w");
+    int         nre         = c_numTerms;
+    gmx_enxnm_t *nms        = termNames();
+    do_enxnms(ef, &nre, &nms);
+    for (gmx_int64_t step = 0; step < 2500; step += 10)
+    {
+        setFrame(&frame_, step, 0, false);
+        do_enx(ef, &frame_);
+    }
+    done_ener_file(ef);
+    writeFile(2500, false);
+
+    /* Both files give the same frames through the same interface */
+    ener_file_t efXdr      = open_enx(xdrFileName.c_str(), "r");
+    ener_file_t efColumnar = open_enx(fileName_.c_str(), "r");
+    gmx_enxnm_t *nmsXdr    = nullptr, *nmsColumnar = nullptr;
+    int          nreXdr, nreColumnar;
+    do_enxnms(efXdr, &nreXdr, &nmsXdr);
+    do_enxnms(efColumnar, &nreColumnar, &nmsColumnar);
+    ASSERT_EQ(nreXdr, nreColumnar);
+    for (int i = 0; i < nreXdr; i++)
+    {
+        EXPECT_STREQ(nmsXdr[i].name, nmsColumnar[i].name);
+        EXPECT_STREQ(nmsXdr[i].unit, nmsColumnar[i].unit);
+    }
+    free_enxnms(nreXdr, nmsXdr);
+    free_enxnms(nreColumnar, nmsColumnar);
+
+    t_enxframe frXdr, frColumnar;
+    init_enxframe(&frXdr);
+    init_enxframe(&frColumnar);
+    int        numFrames = 0;
+    while (do_enx(efXdr, &frXdr))
+    {
+        ASSERT_TRUE(do_enx(efColumnar, &frColumnar));
+        checkFrame(frXdr, frColumnar);
+        numFrames++;
+    }
+    EXPECT_FALSE(do_enx(efColumnar, &frColumnar));
+    EXPECT_EQ(250, numFrames);
+    free_enxframe(&frXdr);
+    free_enxframe(&frColumnar);
+    done_ener_file(efXdr);
+    done_ener_file(efColumnar);
+}
+
+TEST_F(EnerColumnarTest, AppendingReplacesFramesAfterRestart)
+{
+    writeFile(15000);
+
+    /* Continue from step 12010, as after a restart from a checkpoint,
+     * within a chunk and through open_enx, which detects the format.
+     */
+    ener_file_t ef = open_enx(fileName_.c_str(), "a");
+    for (gmx_int64_t step = 12010; step < 20000; step += 10)
+    {
+        setFrame(&frame_, step, 5);
+        do_enx(ef, &frame_);
+    }
+    done_ener_file(ef);
+
+    checkColumns(2000, 12010, 5);
+    checkFile(2000, 12010, 5);
+}
+
+TEST_F(EnerColumnarTest, FlushedFramesCanBeRead)
+{
+    ener_columnar_t ec = open_ener_columnar(fileName_.c_str(), "w");
+    ener_columnar_set_terms(ec, c_numTerms, termNames());
+    writeFrames(ec, 0, 500, 0);
+    ener_columnar_flush(ec);
+
+    /* Without closing, the flushed frames are in the file */
+    checkFile(50, 500, 0);
+
+    writeFrames(ec, 500, 1000, 0);
+    close_ener_columnar(ec);
+    checkFile(100, 1000, 0);
+}
+
+TEST_F(EnerColumnarTest, AppendsAfterTruncationAtCheckpointPosition)
+{
+    ener_columnar_t ec = open_ener_columnar(fileName_.c_str(), "w");
+    ener_columnar_set_terms(ec, c_numTerms, termNames());
+    writeFrames(ec, 0, 500, 0);
+    ener_columnar_flush(ec);
+
+    /* As write_checkpoint, get the position of the open output files */
+    gmx_file_position_t *outputFiles;
+    int                  numOutputFiles;
+    gmx_fio_get_output_file_positions(&outputFiles, &numOutputFiles);
+    gmx_off_t            offset = -1;
+    for (int i = 0; i < numOutputFiles; i++)
+    {
+        if (fileName_ == outputFiles[i].filename)
+        {
+            offset = outputFiles[i].offset;
+            EXPECT_GT(outputFiles[i].chksum_size, 0);
+        }
+    }
+    sfree(outputFiles);
+    ASSERT_GT(offset, 0) << "The columnar file should be in the output file list";
+
+    writeFrames(ec, 500, 1000, 0);
+    close_ener_columnar(ec);
+
+    /* As a restart with appending, truncate at the checkpoint position */
+    ASSERT_EQ(0, gmx_truncate(fileName_.c_str(), offset));
+    ener_file_t ef = open_enx(fileName_.c_str(), "a");
+    for (gmx_int64_t step = 500; step < 1000; step += 10)
+    {
+        setFrame(&frame_, step, 5);
+        do_enx(ef, &frame_);
+    }
+    done_ener_file(ef);
+
+    checkFile(100, 500, 5);
+}
+
+TEST_F(EnerColumnarTest, ReadsFileWithoutDirectory)
+{
+    writeFile(25000);
+
+    /* Break the footer, as with a file that was not closed */
+    FILE *fp = gmx_ffopen(fileName_.c_str(), "rb");
+    gmx_fseek(fp, 0, SEEK_END);
+    gmx_off_t size = gmx_ftell(fp);
+    gmx_ffclose(fp);
+    ASSERT_EQ(0, gmx_truncate(fileName_.c_str(), size - 1));
+
+    checkFile(2500, 25000, 0);
+}
+
+} // namespace
@@ -935,6 +935,307 @@ static enerdata_t *calc_sum(int nset, enerdata_t *edat, int nbmin, int nbmax)
     return esum;
 }
 
+/* Running statistics of a single energy term, used with -stream.
+ * Index 0 of mom and blocks accumulates the single frame values,
+ * index 1 the exact sums from the energy file. Which of the two
+ * is used is only known after the last frame has been read.
+ */
+typedef struct {
+    gmx_int64_t     np;
+    double          sum;
+    double          sum2;
+    double          sx, sy, sxx, sxy;
+} ener_moments_t;
+
+/* Online block averaging for nb blocks: at most 2*nb blocks of nfr frames
+ * are kept. When all of them have been filled, pairs of blocks are merged
+ * and nfr is doubled.
+ */
+typedef struct {
+    gmx_int64_t     nfr;
+    ee_sum_t       *block;
+} ener_blocks_t;
+
+typedef struct {
+    ener_moments_t  mom[2];
+    ener_blocks_t  *blocks[2];
+    gmx_bool        bNonZeroSum;
+    gmx_bool        bAllZero;
+    double          expMax;
+    double          expSum;
+} ener_stream_t;
+
+typedef struct {
+    int             nset;
+    gmx_bool        bSum;
+    int             nbmin;
+    int             nbmax;
+    double          beta;
+    ener_stream_t  *s;
+    int             iVol;
+    int             iEnth;
+    double          vh_sum;
+} enerstream_t;
+
+static void init_enerstream(enerstream_t *estr, int nset, gmx_bool bSum,
+                            int nbmin, int nbmax, double beta, char **leg)
+{
+    int nstream = nset + (bSum ? 1 : 0);
+
+    estr->nset  = nset;
+    estr->bSum  = bSum;
+    estr->nbmin = nbmin;
+    estr->nbmax = nbmax;
+    estr->beta  = beta;
+    snew(estr->s, nstream);
+    for (int i = 0; i < nstream; i++)
+    {
+        ener_stream_t *es = &estr->s[i];
+
+        for (int e = 0; e < 2; e++)
+        {
+            snew(es->blocks[e], nbmax - nbmin + 1);
+            for (int nb = nbmin; nb <= nbmax; nb++)
+            {
+                es->blocks[e][nb - nbmin].nfr = 1;
+                snew(es->blocks[e][nb - nbmin].block, 2*nb);
+            }
+        }
+        es->bNonZeroSum = FALSE;
+        es->bAllZero    = TRUE;
+    }
+
+    /* For the thermal expansion coefficient with -fluct_props */
+    estr->iVol   = -1;
+    estr->iEnth  = -1;
+    estr->vh_sum = 0;
+    for (int i = 0; i < nset; i++)
+    {
+        if (gmx_strcasecmp(leg[i], "Volume") == 0)
+        {
+            estr->iVol = i;
+        }
+        else if (gmx_strcasecmp(leg[i], "Enthalpy") == 0)
+        {
+            estr->iEnth = i;
+        }
+    }
+}
+
+static void done_enerstream(enerstream_t *estr)
+{
+    int nstream = estr->nset + (estr->bSum ? 1 : 0);
+
+    for (int i = 0; i < nstream; i++)
+    {
+        for (int e = 0; e < 2; e++)
+        {
+            for (int nb = estr->nbmin; nb <= estr->nbmax; nb++)
+            {
+                sfree(estr->s[i].blocks[e][nb - estr->nbmin].block);
+            }
+            sfree(estr->s[i].blocks[e]);
+        }
+    }
+    sfree(estr->s);
+}
+
+static void add_ener_moments(ener_moments_t *m, gmx_bool bExact, double x,
+                             gmx_int64_t p, double sump, double sum2)
+{
+    /* The same accumulation as in calc_averages */
+    if (bExact)
+    {
+        m->sum2 += sum2;
+        if (m->np > 0)
+        {
+            m->sum2 += gmx::square(m->sum/m->np - (m->sum + sump)/(m->np + p))
+                *m->np*(m->np + p)/p;
+        }
+    }
+    else
+    {
+        m->sum2 += gmx::square(sump);
+    }
+    m->np  += p;
+    m->sum += sump;
+    m->sx  += p*x;
+    m->sy  += sump;
+    m->sxx += p*x*x;
+    m->sxy += x*sump;
+}
+
+static void add_ener_blocks(ener_blocks_t *eb, int nb, gmx_int64_t frame,
+                            double sump, gmx_int64_t p)
+{
+    gmx_int64_t b = frame/eb->nfr;
+
+    if (b == 2*nb)
+    {
+        for (int i = 0; i < nb; i++)
+        {
+            eb->block[i].np  = eb->block[2*i].np  + eb->block[2*i + 1].np;
+            eb->block[i].sum = eb->block[2*i].sum + eb->block[2*i + 1].sum;
+        }
+        for (int i = nb; i < 2*nb; i++)
+        {
+            clear_ee_sum(&eb->block[i]);
+        }
+        eb->nfr *= 2;
+        b        = frame/eb->nfr;
+    }
+    eb->block[b].np  += p;
+    eb->block[b].sum += sump;
+}
+
+static void add_ener_stream(ener_stream_t *es, int nbmin, int nbmax,
+                            gmx_int64_t frame, double x, gmx_int64_t p,
+                            double e, double esum, double esum2, double expE)
+{
+    add_ener_moments(&es->mom[0], FALSE, x, 1, e, 0);
+    add_ener_moments(&es->mom[1], TRUE, x, p, esum, esum2);
+    for (int nb = nbmin; nb <= nbmax; nb++)
+    {
+        add_ener_blocks(&es->blocks[0][nb - nbmin], nb, frame, e, 1);
+        add_ener_blocks(&es->blocks[1][nb - nbmin], nb, frame, esum, p);
+    }
+    if (esum != 0)
+    {
+        es->bNonZeroSum = TRUE;
+    }
+    if (e != 0)
+    {
+        es->bAllZero = FALSE;
+    }
+
+    /* Running sum of exp(expE), shifted by its maximum to avoid overflow */
+    if (frame == 0 || expE > es->expMax)
+    {
+        es->expSum = (frame == 0 ? 0 : es->expSum*std::exp(es->expMax - expE));
+        es->expMax = expE;
+    }
+    es->expSum += std::exp(expE - es->expMax);
+}
+
+/* Adds frame nfr of edat, which is stored exactly as without streaming,
+ * as frame number frame to the running statistics.
+ */
+static void add_enerstream_frame(enerstream_t *estr, const enerdata_t *edat,
+                                 int nfr, gmx_int64_t frame, int nmol)
+{
+    double      x, e, esum, sum, sumes;
+    gmx_int64_t p;
+
+    x     = edat->step[nfr] - 0.5*(edat->steps[nfr] - 1);
+    p     = edat->points[nfr];
+    sum   = 0;
+    sumes = 0;
+    for (int i = 0; i < estr->nset; i++)
+    {
+        e     = edat->s[i].ener[nfr];
+        esum  = edat->s[i].es[nfr].sum;
+        add_ener_stream(&estr->s[i], estr->nbmin, estr->nbmax, frame, x, p,
+                        e, esum, edat->s[i].es[nfr].sum2, estr->beta*e/nmol);
+        sum   += e;
+        sumes += esum;
+    }
+    if (estr->bSum)
+    {
+        /* As in calc_sum, the sum has no variance within a frame */
+        add_ener_stream(&estr->s[estr->nset], estr->nbmin, estr->nbmax, frame, x, p,
+                        sum, sumes, 0, estr->beta*sum/nmol);
+    }
+    if (estr->iVol >= 0 && estr->iEnth >= 0)
+    {
+        estr->vh_sum += static_cast<double>(edat->s[estr->iVol].ener[nfr])*edat->s[estr->iEnth].ener[nfr];
+    }
+}
+
+static void calc_enerstream_stats(const ener_stream_t *es, const enerdata_t *edat,
+                                  int nbmin, int nbmax, enerdat_t *ed)
+{
+    const ener_moments_t *m;
+    ee_sum_t              ees;
+    double                see2;
+    int                   e, nee;
+    gmx_int64_t           nblock;
+
+    ed->bExactStat = (edat->bHaveSums && (es->bNonZeroSum || es->bAllZero));
+    e              = (ed->bExactStat ? 1 : 0);
+    m              = &es->mom[e];
+
+    ed->av = m->sum/m->np;
+    if (ed->bExactStat)
+    {
+        ed->rmsd = std::sqrt(m->sum2/m->np);
+    }
+    else
+    {
+        ed->rmsd = std::sqrt(m->sum2/m->np - gmx::square(ed->av));
+    }
+    if (edat->nframes > 1)
+    {
+        ed->slope = (m->np*m->sxy - m->sx*m->sy)/(m->np*m->sxx - m->sx*m->sx);
+    }
+    else
+    {
+        ed->slope = 0;
+    }
+
+    /* Use only the completely filled blocks, between nb and 2*nb
+     * blocks of equal length.
+     */
+    nee  = 0;
+    see2 = 0;
+    for (int nb = nbmin; nb <= nbmax; nb++)
+    {
+        const ener_blocks_t *eb = &es->blocks[e][nb - nbmin];
+
+        nblock = edat->nframes/eb->nfr;
+        if (debug)
+        {
+            fprintf(debug, "Requested %d blocks, we have %d blocks of %d frames\n",
+                    nb, static_cast<int>(nblock), static_cast<int>(eb->nfr));
+        }
+        if (nblock >= nb && nblock >= 2)
+        {
+            clear_ee_sum(&ees);
+            for (int b = 0; b < nblock; b++)
+            {
+                ees.np  = eb->block[b].np;
+                ees.sum = eb->block[b].sum;
+                add_ee_av(&ees);
+            }
+            see2 += calc_ee2(nblock, &ees);
+            nee++;
+        }
+    }
+    if (nee > 0)
+    {
+        ed->ee = std::sqrt(see2/nee);
+    }
+    else
+    {
+        ed->ee = -1;
+    }
+}
+
+/* Sets the statistics of edat, and of esum when summing, from estr */
+static void calc_enerstream_averages(const enerstream_t *estr, enerdata_t *edat,
+                                     enerdata_t *esum)
+{
+    for (int i = 0; i < estr->nset; i++)
+    {
+        calc_enerstream_stats(&estr->s[i], edat, estr->nbmin, estr->nbmax,
+                              &edat->s[i]);
+    }
+    if (estr->bSum)
+    {
+        calc_enerstream_stats(&estr->s[estr->nset], edat, estr->nbmin, estr->nbmax,
+                              &esum->s[0]);
+    }
+}
+
 static void ee_pr(double ee, int buflen, char *buf)
 {
     snprintf(buf, buflen, "%s", "--");
@@ -984,6 +1285,7 @@ static void calc_fluctuation_props(FILE *fp,
                                    gmx_bool bDriftCorr, real dt,
                                    int nset, int nmol,
                                    char **leg, enerdata_t *edat,
+                                   const enerstream_t *estr,
                                    int nbmin, int nbmax)
 {
     int    i, j;
@@ -1055,13 +1357,22 @@ static void calc_fluctuation_props(FILE *fp,
     {
         double v_sum, h_sum, vh_sum, v_aver, h_aver, vh_aver;
         vh_sum = v_sum = h_sum = 0;
-        for (j = 0; (j < edat->nframes); j++)
+        if (estr != nullptr)
+        {
+            v_sum  = estr->s[ii[eVol]].mom[0].sy*NANO3;
+            h_sum  = KILO*estr->s[ii[eEnth]].mom[0].sy/AVOGADRO;
+            vh_sum = estr->vh_sum*NANO3*KILO/AVOGADRO;
+        }
+        else
         {
-            v       = edat->s[ii[eVol]].ener[j]*NANO3;
-            h       = KILO*edat->s[ii[eEnth]].ener[j]/AVOGADRO;
-            v_sum  += v;
-            h_sum  += h;
-            vh_sum += (v*h);
+            for (j = 0; (j < edat->nframes); j++)
+            {
+                v       = edat->s[ii[eVol]].ener[j]*NANO3;
+                h       = KILO*edat->s[ii[eEnth]].ener[j]/AVOGADRO;
+                v_sum  += v;
+                h_sum  += h;
+                vh_sum += (v*h);
+            }
         }
         vh_aver = vh_sum / edat->nframes;
         v_aver  = v_sum  / edat->nframes;
@@ -1143,7 +1454,7 @@ static void analyse_ener(gmx_bool bCorr, const char *corrfn,
                          gmx_int64_t start_step, double start_t,
                          gmx_int64_t step, double t,
                          real reftemp,
-                         enerdata_t *edat,
+                         enerdata_t *edat, const enerstream_t *estr,
                          int nset, int set[], gmx_bool *bIsEner,
                          char **leg, gmx_enxnm_t *enm,
                          real Vaver, real ezero,
@@ -1176,11 +1487,24 @@ static void analyse_ener(gmx_bool bCorr, const char *corrfn,
         fprintf(stdout, "\nStatistics over %s steps [ %.4f through %.4f ps ], %d data sets\n",
                 gmx_step_str(nsteps, buf), start_t, t, nset);
 
-        calc_averages(nset, edat, nbmin, nbmax);
-
-        if (bSum)
+        if (estr != nullptr)
         {
-            esum = calc_sum(nset, edat, nbmin, nbmax);
+            if (bSum)
+            {
+                snew(esum, 1);
+                *esum = *edat;
+                snew(esum->s, 1);
+            }
+            calc_enerstream_averages(estr, edat, esum);
+        }
+        else
+        {
+            calc_averages(nset, edat, nbmin, nbmax);
+
+            if (bSum)
+            {
+                esum = calc_sum(nset, edat, nbmin, nbmax);
+            }
         }
 
         if (!edat->bHaveSums)
@@ -1259,10 +1583,17 @@ static void analyse_ener(gmx_bool bCorr, const char *corrfn,
 
             if (bFee)
             {
-                expE = 0;
-                for (j = 0; (j < edat->nframes); j++)
+                if (estr != nullptr)
                 {
-                    expE += std::exp(beta*(edat->s[i].ener[j] - aver)/nmol);
+                    expE = estr->s[i].expSum*std::exp(estr->s[i].expMax - beta*aver/nmol);
+                }
+                else
+                {
+                    expE = 0;
+                    for (j = 0; (j < edat->nframes); j++)
+                    {
+                        expE += std::exp(beta*(edat->s[i].ener[j] - aver)/nmol);
+                    }
                 }
                 if (bSum)
                 {
@@ -1313,7 +1644,7 @@ static void analyse_ener(gmx_bool bCorr, const char *corrfn,
 
             fprintf(stdout, "  (%s)\n", enm[set[i]].unit);
 
-            if (bFluct)
+            if (bFluct && estr == nullptr)
             {
                 for (j = 0; (j < edat->nframes); j++)
                 {
@@ -1877,6 +2208,16 @@ int gmx_energy(int argc, char *argv[])
 
         "The term fluctuation gives the RMSD around the least-squares fit.[PAR]",
 
+        "With [TT]-stream[tt] the statistics are accumulated in a single pass",
+        "over the energy file, so the memory usage does not depend on the",
+        "number of frames. Averages, RMSD and drift are the same as",
+        "without streaming, up to rounding. As the length of the run is not known in advance,",
+        "the error estimate for a number of blocks nb uses between nb and 2 nb",
+        "blocks of equal length, which will differ slightly from the normal",
+        "estimate. Options that need the complete time series,",
+        "[TT]-vis[tt], [TT]-driftcorr[tt] and [TT]-f2[tt], can not be used",
+        "with [TT]-stream[tt].[PAR]",
+
         "Some fluctuation-dependent properties can be calculated provided",
         "the correct energy terms are selected, and that the command line option",
         "[TT]-fluct_props[tt] is given. The following properties",
@@ -1955,6 +2296,7 @@ int gmx_energy(int argc, char *argv[])
     static gmx_bool    bDp     = FALSE, bMutot = FALSE, bOrinst = FALSE, bOvec = FALSE, bFluctProps = FALSE;
     static int         skip    = 0, nmol = 1, nbmin = 5, nbmax = 5;
     static real        reftemp = 300.0, ezero = 0;
+    gmx_bool           bStream = FALSE;
     t_pargs            pa[]    = {
         { "-fee",   FALSE, etBOOL,  {&bFee},
           "Do a free energy estimate" },
@@ -1982,6 +2324,8 @@ int gmx_energy(int argc, char *argv[])
           "Compute properties based on energy fluctuations, like heat capacity" },
         { "-driftcorr", FALSE, etBOOL, {&bDriftCorr},
           "Useful only for calculations of fluctuation properties. The drift in the observables will be subtracted before computing the fluctuation properties."},
+        { "-stream", FALSE, etBOOL, {&bStream},
+          "Compute the statistics in a single pass, using memory independent of the number of frames" },
         { "-fluc", FALSE, etBOOL, {&bFluct},
           "Calculate autocorrelation of energy fluctuations rather than energy itself" },
         { "-orinst", FALSE, etBOOL, {&bOrinst},
@@ -2006,6 +2350,7 @@ int gmx_energy(int argc, char *argv[])
     gmx_mtop_t         mtop;
     gmx_localtop_t    *top = nullptr;
     enerdata_t         edat;
+    enerstream_t       estr;
     gmx_enxnm_t       *enm = nullptr;
     t_enxframe        *frame, *fr = nullptr;
     int                cur = 0;
@@ -2081,6 +2426,24 @@ int gmx_energy(int argc, char *argv[])
     bOTEN  = opt2bSet("-oten", NFILE, fnm);
     bDHDL  = opt2bSet("-odh", NFILE, fnm);
 
+    /* Streaming only applies to the statistics of energy terms */
+    bStream = bStream && !bDisRe && !bDHDL;
+    if (bStream)
+    {
+        const char *noStreamOpt[] = { "-vis", "-f2" };
+        for (const char *opt : noStreamOpt)
+        {
+            if (opt2bSet(opt, NFILE, fnm))
+            {
+                gmx_fatal(FARGS, "Option %s needs the complete time series and can not be combined with -stream", opt);
+            }
+        }
+        if (bDriftCorr)
+        {
+            gmx_fatal(FARGS, "Option -driftcorr needs the complete time series and can not be combined with -stream");
+        }
+    }
+
     nset = 0;
 
     snew(frame, 2);
@@ -2347,6 +2710,19 @@ int gmx_energy(int argc, char *argv[])
     edat.points    = nullptr;
     edat.bHaveSums = TRUE;
     snew(edat.s, nset);
+    if (bStream)
+    {
+        /* Only the current frame is stored */
+        snew(edat.step, 1);
+        snew(edat.steps, 1);
+        snew(edat.points, 1);
+        for (i = 0; i < nset; i++)
+        {
+            snew(edat.s[i].ener, 1);
+            snew(edat.s[i].es, 1);
+        }
+        init_enerstream(&estr, nset, bSum, nbmin, nbmax, 1.0/(BOLTZ*reftemp), leg);
+    }
 
     /* Initiate counters */
     teller       = 0;
@@ -2379,7 +2755,16 @@ int gmx_energy(int argc, char *argv[])
                 /* The frame contains energies, so update cur */
                 cur  = NEXT;
 
-                if (edat.nframes % 1000 == 0)
+                if (bStream)
+                {
+                    edat.points[0] = 0;
+                    for (i = 0; i < nset; i++)
+                    {
+                        edat.s[i].es[0].sum  = 0;
+                        edat.s[i].es[0].sum2 = 0;
+                    }
+                }
+                else if (edat.nframes % 1000 == 0)
                 {
                     srenew(edat.step, edat.nframes+1000);
                     std::memset(&(edat.step[edat.nframes]), 0, 1000*sizeof(edat.step[0]));
@@ -2399,7 +2784,7 @@ int gmx_energy(int argc, char *argv[])
                     }
                 }
 
-                nfr            = edat.nframes;
+                nfr            = (bStream ? 0 : edat.nframes);
                 edat.step[nfr] = fr->step;
 
                 if (!bFoundStart)
@@ -2465,6 +2850,10 @@ int gmx_energy(int argc, char *argv[])
                 {
                     edat.s[i].ener[nfr] = fr->ener[set[i]].e;
                 }
+                if (bStream)
+                {
+                    add_enerstream_frame(&estr, &edat, nfr, edat.nframes, nmol);
+                }
             }
             /*
              * Define distance restraint legends. Can only be done after
@@ -2520,11 +2909,14 @@ int gmx_energy(int argc, char *argv[])
              */
             if (!bDisRe && !bDHDL && (fr->nre > 0))
             {
-                if (edat.nframes % 1000 == 0)
+                if (!bStream)
                 {
-                    srenew(time, edat.nframes+1000);
+                    if (edat.nframes % 1000 == 0)
+                    {
+                        srenew(time, edat.nframes+1000);
+                    }
+                    time[edat.nframes] = fr->t;
                 }
-                time[edat.nframes] = fr->t;
                 edat.nframes++;
             }
             /*
@@ -2836,13 +3228,13 @@ int gmx_energy(int argc, char *argv[])
                      bVisco, opt2fn("-vis", NFILE, fnm),
                      nmol,
                      start_step, start_t, frame[cur].step, frame[cur].t,
-                     reftemp, &edat,
+                     reftemp, &edat, bStream ? &estr : nullptr,
                      nset, set, bIsEner, leg, enm, Vaver, ezero, nbmin, nbmax,
                      oenv);
         if (bFluctProps)
         {
             calc_fluctuation_props(stdout, bDriftCorr, dt, nset, nmol, leg, &edat,
-                                   nbmin, nbmax);
+                                   bStream ? &estr : nullptr, nbmin, nbmax);
         }
     }
     if (opt2bSet("-f2", NFILE, fnm))
@@ -2851,6 +3243,10 @@ int gmx_energy(int argc, char *argv[])
             reftemp, nset, set, leg, &edat, time, oenv);
     }
     // Clean up!
+    if (bStream)
+    {
+        done_enerstream(&estr);
+    }
     done_enerdata_t(nset, &edat);
     sfree(time);
     free_enxframe(&frame[0]);
@@ -350,14 +350,33 @@ void check_ir(const char *mdparin, t_inputrec *ir, t_gromppopts *opts,
             }
         }
 
-        if (!(ir->vdwtype == evdwCUT || ir->vdwtype == evdwPME))
+        if (!(ir->vdwtype == evdwCUT || ir->vdwtype == evdwPME || ir->vdwtype == evdwUSER))
         {
-            warning_error(wi, "With Verlet lists only cut-off and PME LJ interactions are supported");
+            warning_error(wi, "With Verlet lists only cut-off, PME and user LJ interactions are supported");
         }
         if (!(ir->coulombtype == eelCUT || EEL_RF(ir->coulombtype) ||
-              EEL_PME(ir->coulombtype) || ir->coulombtype == eelEWALD))
+              EEL_PME(ir->coulombtype) || ir->coulombtype == eelEWALD ||
+              ir->coulombtype == eelUSER))
         {
-            warning_error(wi, "With Verlet lists only cut-off, reaction-field, PME and Ewald electrostatics are supported");
+            warning_error(wi, "With Verlet lists only cut-off, reaction-field, PME, Ewald and user electrostatics are supported");
+        }
+        if ((ir->coulombtype == eelUSER) != (ir->vdwtype == evdwUSER))
+        {
+            warning_error(wi, "With Verlet lists user tables are only supported with both coulombtype and vdwtype set to User");
+        }
+        if (ir->coulombtype == eelUSER && ir->efep != efepNO)
+        {
+            warning_error(wi, "With Verlet lists user tables are not supported with free-energy calculations");
+        }
+        if (ir->coulombtype == eelUSER || ir->vdwtype == evdwUSER)
+        {
+            if (ir->coulomb_modifier != eintmodNONE || ir->vdw_modifier != eintmodNONE)
+            {
+                sprintf(warn_buf, "With Verlet lists and user tables the potential modifiers are not applied, but coulomb-modifier=%s and vdw-modifier=%s. Shift or switch the potentials in the table instead and set both modifiers to %s.",
+                        eintmod_names[ir->coulomb_modifier], eintmod_names[ir->vdw_modifier], eintmod_names[eintmodNONE]);
+                warning(wi, warn_buf);
+            }
+            warning_note(wi, "With Verlet lists and user tables excluded atom pairs do not interact, as with the group scheme. The tables are only applied to non-excluded pairs within the cut-off.");
         }
         if (!(ir->coulomb_modifier == eintmodNONE ||
               ir->coulomb_modifier == eintmodPOTSHIFT))
@@ -1379,7 +1398,7 @@ void check_ir(const char *mdparin, t_inputrec *ir, t_gromppopts *opts,
     {
         if (ir->cutoff_scheme != ecutsGROUP)
         {
-            warning_error(wi, "QMMM is currently only supported with cutoff-scheme=group");
+            warning_note(wi, "QMMM with cutoff-scheme=Verlet is only supported with an in-process QM engine, which is selected at run time with the environment variable GMX_QM_ENGINE, and on a single rank");
         }
         if (!EI_DYNAMICS(ir->eI))
         {
@@ -54,6 +54,12 @@
 #include <errno.h>
 #include <string.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #if GMX_NATIVE_WINDOWS
 #include <windows.h>
 #else
@@ -67,6 +73,7 @@
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/fileio/xvgr.h"
 #include "gromacs/gmxlib/network.h"
+#include "gromacs/imd/imdframequeue.h"
 #include "gromacs/imd/imdsocket.h"
 #include "gromacs/math/units.h"
 #include "gromacs/math/vec.h"
@@ -96,6 +103,19 @@
 /*! \brief IMD Protocol Version. */
 #define IMDVERSION 2
 
+/*! \brief How many frames can be queued for sending before old ones are dropped.
+ *
+ * The MD loop never waits for a slow client. When this many frames are still
+ * waiting to be sent, the oldest of them is replaced by the new frame.
+ */
+static const int c_imdFrameQueueSize = 4;
+
+/*! \brief How many seconds to wait at the end of the run for the client
+ * to accept the frames that are still queued. */
+static const int c_imdFlushTimeout = 10;
+
+class ImdFrameSender;
+
 
 /*! \internal
  * \brief
@@ -183,8 +203,8 @@ typedef struct t_gmx_IMD
     rvec           *f;               /**< The IMD pulling forces.                     */
 
     char           *forcesendbuf;    /**< Buffer for force sending.                   */
-    char           *coordsendbuf;    /**< Buffer for coordinate sending.              */
-    char           *energysendbuf;   /**< Send buffer for energies.                   */
+    ImdFrameSender *sender;          /**< Sends positions and energies to the client
+                                          from a separate thread while connected.     */
     rvec           *sendxbuf;        /**< Buffer to make molecules whole before
                                           sending.                                    */
 
@@ -366,8 +386,8 @@ static int imd_handshake(IMDSocket *socket)
 }
 
 
-/*! \brief Send energies using the energy block and the send buffer. */
-static int imd_send_energies(IMDSocket *socket, const IMDEnergyBlock *energies, char *buffer)
+/*! \brief Puts the energy block with its header into the send buffer, returns the record size. */
+static gmx_int32_t imd_pack_energies(const IMDEnergyBlock *energies, char *buffer)
 {
     gmx_int32_t recsize;
 
@@ -376,7 +396,7 @@ static int imd_send_energies(IMDSocket *socket, const IMDEnergyBlock *energies,
     fill_header((IMDHeader *) buffer, IMD_ENERGIES, 1);
     memcpy(buffer + HEADERSIZE, energies, sizeof(IMDEnergyBlock));
 
-    return (imd_write_multiple(socket, buffer, recsize) != recsize);
+    return recsize;
 }
 
 
@@ -461,11 +481,11 @@ void dd_make_local_IMD_atoms(gmx_bool bIMD, gmx_domdec_t *dd, t_IMD *imd)
 
 
 #ifdef GMX_IMD
-/*! \brief Send positions from rvec.
+/*! \brief Puts the positions with their header into the send buffer, returns the record size.
  *
  * We need a separate send buffer and conversion to Angstrom.
  */
-static int imd_send_rvecs(IMDSocket *socket, int nat, rvec *x, char *buffer)
+static gmx_int32_t imd_pack_rvecs(int nat, const rvec *x, char *buffer)
 {
     gmx_int32_t size;
     int         i;
@@ -486,7 +506,126 @@ static int imd_send_rvecs(IMDSocket *socket, int nat, rvec *x, char *buffer)
         memcpy(buffer + HEADERSIZE + i * tuplesize, sendx, tuplesize);
     }
 
-    return (imd_write_multiple(socket, buffer, size) != size);
+    return size;
+}
+
+
+/*! \internal
+ * \brief Sends IMD frames to the client from a separate thread.
+ *
+ * Writing to the socket blocks when the client does not keep up. So that
+ * this never stalls the simulation, the master rank only packs the energies
+ * and positions of an IMD step into a frame and puts it in a small queue,
+ * and a thread owned by this object writes the queued frames to the client
+ * socket. When the queue is full, the oldest unsent frame is dropped.
+ */
+class ImdFrameSender
+{
+    public:
+        //! Starts the sending thread for frames of \p nat positions to \p socket.
+        ImdFrameSender(IMDSocket *socket, int nat);
+        /*! \brief Sends the frames still queued and stops the thread.
+         *
+         * Waits at most c_imdFlushTimeout seconds for the client. After
+         * that the socket is shut down, so a pending write returns and
+         * the remaining frames are not sent.
+         */
+        ~ImdFrameSender();
+
+        /*! \brief Queues energies and positions for sending.
+         *
+         * Never waits for the client. Returns false when the oldest
+         * queued frame had to be dropped because the queue is full.
+         */
+        bool push(const IMDEnergyBlock *energies, int nat, const rvec *x);
+        //! Returns whether writing to the socket has failed.
+        bool failed() const { return failed_.load(std::memory_order_acquire); }
+        //! Returns the number of frames that were queued.
+        int numFrames() const { return numFrames_; }
+        //! Returns the number of frames that were dropped.
+        int numDropped() const { return numDropped_; }
+
+    private:
+        //! The sending loop that runs on thread_.
+        void run();
+
+        IMDSocket                *socket_;
+        ImdFrameQueue             queue_;
+        //! The frame the MD loop packs, only used by the producer.
+        ImdFrame                  packed_;
+        //! The frame that is being sent, only used by the sending thread.
+        ImdFrame                  sending_;
+        std::atomic<bool>         failed_;
+        //! Whether the sending thread has finished, protected by mutex_.
+        bool                      done_;
+        std::mutex                mutex_;
+        std::condition_variable   cond_;
+        int                       numFrames_;
+        int                       numDropped_;
+        std::thread               thread_;
+};
+
+ImdFrameSender::ImdFrameSender(IMDSocket *socket, int nat)
+    : socket_(socket),
+      queue_(c_imdFrameQueueSize, HEADERSIZE + sizeof(IMDEnergyBlock), HEADERSIZE + 3 * sizeof(float) * nat),
+      packed_(HEADERSIZE + sizeof(IMDEnergyBlock), HEADERSIZE + 3 * sizeof(float) * nat),
+      sending_(HEADERSIZE + sizeof(IMDEnergyBlock), HEADERSIZE + 3 * sizeof(float) * nat),
+      failed_(false), done_(false), numFrames_(0), numDropped_(0)
+{
+    thread_ = std::thread(&ImdFrameSender::run, this);
+}
+
+ImdFrameSender::~ImdFrameSender()
+{
+    queue_.close();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!cond_.wait_for(lock, std::chrono::seconds(c_imdFlushTimeout),
+                            [this] { return done_; }))
+        {
+            fprintf(stderr, "%s The client did not accept the remaining frames within %d s, not sending them.\n",
+                    IMDstr, c_imdFlushTimeout);
+            /* This makes the pending write of the sending thread return */
+            imdsock_shutdown(socket_);
+        }
+    }
+    thread_.join();
+}
+
+bool ImdFrameSender::push(const IMDEnergyBlock *energies, int nat, const rvec *x)
+{
+    imd_pack_energies(energies, packed_.energyRecord.data());
+    imd_pack_rvecs(nat, x, packed_.coordRecord.data());
+
+    numFrames_++;
+    if (!queue_.push(&packed_))
+    {
+        numDropped_++;
+        return false;
+    }
+
+    return true;
+}
+
+void ImdFrameSender::run()
+{
+    while (queue_.pop(&sending_))
+    {
+        gmx_int32_t esize = sending_.energyRecord.size();
+        gmx_int32_t xsize = sending_.coordRecord.size();
+        if (imd_write_multiple(socket_, sending_.energyRecord.data(), esize) != esize ||
+            imd_write_multiple(socket_, sending_.coordRecord.data(), xsize) != xsize)
+        {
+            failed_.store(true, std::memory_order_release);
+            break;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+    }
+    cond_.notify_one();
 }
 
 
@@ -568,14 +707,37 @@ static void imd_prepare_master_socket(t_gmx_IMD_setup *IMDsetup)
 }
 
 
+/*! \brief Stops the sending thread and reports how many frames were dropped. */
+static void imd_stop_sender(t_gmx_IMD_setup *IMDsetup)
+{
+    if (IMDsetup->sender == nullptr)
+    {
+        return;
+    }
+
+    int nframes  = IMDsetup->sender->numFrames();
+    int ndropped = IMDsetup->sender->numDropped();
+    delete IMDsetup->sender;
+    IMDsetup->sender = nullptr;
+
+    if (ndropped > 0)
+    {
+        fprintf(stderr, "%s %d of %d frames were not sent, because the client did not keep up.\n",
+                IMDstr, ndropped, nframes);
+    }
+}
+
+
 /*! \brief Disconnect the client. */
 static void imd_disconnect(t_gmx_IMD_setup *IMDsetup)
 {
     /* Write out any buffered pulling data */
     fflush(IMDsetup->outf);
 
-    /* we first try to shut down the clientsocket */
+    /* we first try to shut down the clientsocket, this also makes
+     * a pending write of the sending thread return */
     imdsock_shutdown(IMDsetup->clientsocket);
+    imd_stop_sender(IMDsetup);
     if (!imdsock_destroy(IMDsetup->clientsocket))
     {
         fprintf(stderr, "%s Failed to destroy socket.\n", IMDstr);
@@ -631,6 +793,12 @@ static gmx_bool imd_tryconnect(t_gmx_IMD_setup *IMDsetup)
         /* IMD connected */
         IMDsetup->bConnected = TRUE;
 
+        /* From now on, positions and energies are sent by a separate thread */
+        if (IMDsetup->clientsocket)
+        {
+            IMDsetup->sender = new ImdFrameSender(IMDsetup->clientsocket, IMDsetup->nat);
+        }
+
         return TRUE;
     }
 
@@ -1061,6 +1229,10 @@ void IMD_finalize(gmx_bool bIMD, t_IMD *imd)
 {
     if (bIMD)
     {
+#ifdef GMX_IMD
+        /* Send the frames that are still queued */
+        imd_stop_sender(imd->setup);
+#endif
         if (imd->setup->outf)
         {
             gmx_fio_fclose(imd->setup->outf);
@@ -1327,7 +1499,6 @@ void init_IMD(t_inputrec             *ir,
     int              i;
     int              nat_total;
     t_gmx_IMD_setup *IMDsetup;
-    gmx_int32_t      bufxsize;
     gmx_bool         bIMD = FALSE;
 
 
@@ -1428,10 +1599,6 @@ void init_IMD(t_inputrec             *ir,
     /* read environment on master and prepare socket for incoming connections */
     if (MASTER(cr))
     {
-        /* we allocate memory for our IMD energy structure */
-        gmx_int32_t recsize = HEADERSIZE + sizeof(IMDEnergyBlock);
-        snew(IMDsetup->energysendbuf, recsize);
-
         /* Shall we wait for a connection? */
         if (Flags & MD_IMDWAIT)
         {
@@ -1456,8 +1623,6 @@ void init_IMD(t_inputrec             *ir,
         /* Initialize send buffers with constant size */
         snew(IMDsetup->sendxbuf, IMDsetup->nat);
         snew(IMDsetup->energies, 1);
-        bufxsize = HEADERSIZE + 3 * sizeof(float) * IMDsetup->nat;
-        snew(IMDsetup->coordsendbuf, bufxsize);
     }
 
     /* do we allow interactive pulling? If so let the other nodes know. */
@@ -1633,18 +1798,17 @@ void IMD_send_positions(t_IMD *imd)
 
     IMDsetup = imd->setup;
 
-    if (IMDsetup->clientsocket)
+    /* Did the sending thread fail to send earlier frames? */
+    if (IMDsetup->sender && IMDsetup->sender->failed())
     {
+        imd_fatal(IMDsetup, "Error sending updated positions and energies. Disconnecting client.\n");
+    }
 
-        if (imd_send_energies(IMDsetup->clientsocket, IMDsetup->energies, IMDsetup->energysendbuf))
-        {
-            imd_fatal(IMDsetup, "Error sending updated energies. Disconnecting client.\n");
-        }
-
-        if (imd_send_rvecs(IMDsetup->clientsocket, IMDsetup->nat, IMDsetup->xa, IMDsetup->coordsendbuf))
-        {
-            imd_fatal(IMDsetup, "Error sending updated positions. Disconnecting client.\n");
-        }
+    /* Only queue the frame, the sending thread writes it to the client.
+     * If the client is too slow, the oldest queued frame is dropped. */
+    if (IMDsetup->sender)
+    {
+        IMDsetup->sender->push(IMDsetup->energies, IMDsetup->nat, IMDsetup->xa);
     }
 #else
     gmx_incons("IMD_send_positions called without IMD support.");
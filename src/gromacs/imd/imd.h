@@ -205,6 +205,12 @@ void IMD_fill_energy_record(gmx_bool bIMD, t_IMD *imd, gmx_enerdata_t *enerd,
 
 
 /*! \brief Send positions and energies to the client.
+ *
+ * The positions and energies are only queued here and are written to the
+ * client socket by a separate thread, so a slow client never stalls the
+ * simulation. When the client lags behind by several frames, the oldest
+ * unsent frame is overwritten, so the client always gets the most recent
+ * positions.
  *
  * \param imd              The IMD data structure.
  */
@@ -229,7 +235,8 @@ void IMD_prep_energies_send_positions(gmx_bool bIMD, gmx_bool bIMDstep,
 
 /*! \brief Finalize IMD and do some cleaning up.
  *
- * Currently, IMD finalize closes the force output file.
+ * Currently, IMD finalize sends the frames that are still queued for
+ * the client and closes the force output file.
  *
  * \param bIMD         Returns directly if bIMD is FALSE.
  * \param imd          The IMD data structure.
@@ -0,0 +1,112 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+/*! \internal \file
+ *
+ * \brief
+ * Implements the IMD frame queue.
+ *
+ * \ingroup module_imd
+ */
+
+#include "gmxpre.h"
+
+#include "imdframequeue.h"
+
+#include <utility>
+
+#include "gromacs/utility/gmxassert.h"
+
+ImdFrameQueue::ImdFrameQueue(int size, int energyRecordSize, int coordRecordSize)
+    : frames_(size, ImdFrame(energyRecordSize, coordRecordSize)),
+      first_(0), count_(0), closed_(false)
+{
+    GMX_RELEASE_ASSERT(size > 0, "The IMD frame queue needs at least one frame");
+}
+
+bool ImdFrameQueue::push(ImdFrame *frame)
+{
+    int  size        = frames_.size();
+    bool overwritten = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (count_ == size)
+        {
+            /* Drop the oldest frame, the client prefers recent ones */
+            first_      = (first_ + 1) % size;
+            count_--;
+            overwritten = true;
+        }
+        std::swap(*frame, frames_[(first_ + count_) % size]);
+        count_++;
+    }
+    cond_.notify_one();
+
+    return !overwritten;
+}
+
+bool ImdFrameQueue::pop(ImdFrame *frame)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    cond_.wait(lock, [this] { return closed_ || count_ > 0; });
+    if (count_ == 0)
+    {
+        return false;
+    }
+    std::swap(*frame, frames_[first_]);
+    first_ = (first_ + 1) % frames_.size();
+    count_--;
+
+    return true;
+}
+
+void ImdFrameQueue::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    cond_.notify_all();
+}
+
+int ImdFrameQueue::numQueued()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return count_;
+}
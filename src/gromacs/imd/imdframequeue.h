@@ -0,0 +1,121 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+/*! \internal \file
+ *
+ * \brief
+ * Declares a fixed-size queue of IMD frames for handing frames from the
+ * MD loop to the sending thread.
+ *
+ * \ingroup module_imd
+ */
+
+#ifndef GMX_IMD_IMDFRAMEQUEUE_H
+#define GMX_IMD_IMDFRAMEQUEUE_H
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+/*! \internal
+ * \brief An energy and a position record as they are sent to the client.
+ */
+struct ImdFrame
+{
+    //! Allocates the records with their final sizes.
+    ImdFrame(int energyRecordSize, int coordRecordSize)
+        : energyRecord(energyRecordSize), coordRecord(coordRecordSize)
+    {
+    }
+
+    //! The energy record, including the IMD header.
+    std::vector<char> energyRecord;
+    //! The position record, including the IMD header.
+    std::vector<char> coordRecord;
+};
+
+/*! \internal
+ * \brief A ring of IMD frames with one producer and one consumer.
+ *
+ * Frames are exchanged with the queue by swapping buffers, so packing
+ * and writing a frame happen outside the lock and no data is copied.
+ * When the queue is full, push() overwrites the oldest frame that has
+ * not been taken by the consumer, so the client always receives the
+ * most recent frames.
+ *
+ * A mutex and a condition variable are used instead of a lock-free ring.
+ * The lock is only held for swapping two buffers and a few index updates
+ * and the MD loop pushes at most one frame every IMD step, so contention
+ * costs far less than packing a frame. The condition variable lets the
+ * sending thread sleep while there is nothing to send. Overwriting the
+ * oldest frame means the producer also moves the consumer's read index,
+ * which a single-producer single-consumer lock-free ring cannot do
+ * without the same kind of synchronization.
+ */
+class ImdFrameQueue
+{
+    public:
+        //! Creates a queue of \p size frames with records of the given sizes.
+        ImdFrameQueue(int size, int energyRecordSize, int coordRecordSize);
+
+        /*! \brief Puts \p frame at the end of the queue.
+         *
+         * \p frame is swapped with an unused frame buffer of the queue.
+         * Returns false when the oldest queued frame had to be overwritten.
+         */
+        bool push(ImdFrame *frame);
+        /*! \brief Takes the oldest frame from the queue into \p frame.
+         *
+         * Waits until a frame is available. Returns false, without
+         * changing \p frame, when the queue is empty and has been closed.
+         */
+        bool pop(ImdFrame *frame);
+        //! Lets pop() return false once the remaining frames have been taken.
+        void close();
+        //! Returns the number of frames in the queue.
+        int numQueued();
+
+    private:
+        std::vector<ImdFrame>   frames_;
+        //! Index of the oldest frame in frames_.
+        int                     first_;
+        //! Number of frames in the queue.
+        int                     count_;
+        bool                    closed_;
+        std::mutex              mutex_;
+        std::condition_variable cond_;
+};
+
+#endif
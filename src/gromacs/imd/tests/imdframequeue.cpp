@@ -0,0 +1,196 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Tests for the IMD frame queue
+ *
+ * \ingroup module_imd
+ */
+#include "gmxpre.h"
+
+#include "gromacs/imd/imdframequeue.h"
+
+#include <cstring>
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+//! Size of the energy records of the test frames.
+const int c_energySize = sizeof(int);
+//! Size of the position records of the test frames.
+const int c_coordSize  = 2*sizeof(int);
+
+//! Returns the tag that identifies a test frame.
+int frameTag(const ImdFrame &frame)
+{
+    int tag;
+
+    std::memcpy(&tag, frame.energyRecord.data(), sizeof(tag));
+
+    return tag;
+}
+
+//! Returns the tag stored in the position record of a test frame.
+int coordTag(const ImdFrame &frame)
+{
+    int tag;
+
+    std::memcpy(&tag, frame.coordRecord.data() + sizeof(int), sizeof(tag));
+
+    return tag;
+}
+
+//! Tags both records of \p frame with \p tag.
+void setFrameTag(ImdFrame *frame, int tag)
+{
+    std::memcpy(frame->energyRecord.data(), &tag, sizeof(tag));
+    std::memcpy(frame->coordRecord.data() + sizeof(int), &tag, sizeof(tag));
+}
+
+TEST(ImdFrameQueueTest, ReturnsFramesInOrder)
+{
+    ImdFrameQueue queue(4, c_energySize, c_coordSize);
+    ImdFrame      frame(c_energySize, c_coordSize);
+
+    for (int i = 0; i < 3; i++)
+    {
+        setFrameTag(&frame, i);
+        EXPECT_TRUE(queue.push(&frame));
+    }
+    EXPECT_EQ(3, queue.numQueued());
+    for (int i = 0; i < 3; i++)
+    {
+        ASSERT_TRUE(queue.pop(&frame));
+        EXPECT_EQ(i, frameTag(frame));
+        EXPECT_EQ(i, coordTag(frame));
+    }
+    EXPECT_EQ(0, queue.numQueued());
+}
+
+TEST(ImdFrameQueueTest, OverwritesOldestFrameWhenFull)
+{
+    ImdFrameQueue queue(4, c_energySize, c_coordSize);
+    ImdFrame      frame(c_energySize, c_coordSize);
+
+    for (int i = 0; i < 4; i++)
+    {
+        setFrameTag(&frame, i);
+        EXPECT_TRUE(queue.push(&frame));
+    }
+    for (int i = 4; i < 7; i++)
+    {
+        setFrameTag(&frame, i);
+        EXPECT_FALSE(queue.push(&frame));
+    }
+    EXPECT_EQ(4, queue.numQueued());
+    for (int i = 3; i < 7; i++)
+    {
+        ASSERT_TRUE(queue.pop(&frame));
+        EXPECT_EQ(i, frameTag(frame));
+    }
+}
+
+TEST(ImdFrameQueueTest, KeepsRecordSizesWhenSwapping)
+{
+    ImdFrameQueue queue(2, c_energySize, c_coordSize);
+    ImdFrame      frame(c_energySize, c_coordSize);
+
+    for (int i = 0; i < 5; i++)
+    {
+        EXPECT_EQ(i < 2, queue.push(&frame));
+        EXPECT_EQ(static_cast<size_t>(c_energySize), frame.energyRecord.size());
+        EXPECT_EQ(static_cast<size_t>(c_coordSize), frame.coordRecord.size());
+    }
+    ASSERT_TRUE(queue.pop(&frame));
+    EXPECT_EQ(static_cast<size_t>(c_energySize), frame.energyRecord.size());
+    EXPECT_EQ(static_cast<size_t>(c_coordSize), frame.coordRecord.size());
+}
+
+TEST(ImdFrameQueueTest, PopReturnsRemainingFramesAfterClose)
+{
+    ImdFrameQueue queue(4, c_energySize, c_coordSize);
+    ImdFrame      frame(c_energySize, c_coordSize);
+
+    setFrameTag(&frame, 1);
+    queue.push(&frame);
+    queue.close();
+    ASSERT_TRUE(queue.pop(&frame));
+    EXPECT_EQ(1, frameTag(frame));
+    EXPECT_FALSE(queue.pop(&frame));
+    EXPECT_EQ(1, frameTag(frame));
+}
+
+TEST(ImdFrameQueueTest, ConsumerThreadReceivesIncreasingFrames)
+{
+    const int     numFrames = 10000;
+    ImdFrameQueue queue(4, c_energySize, c_coordSize);
+    int           numReceived = 0;
+    bool          inOrder     = true;
+    bool          consistent  = true;
+
+    std::thread   consumer([&] {
+                               ImdFrame frame(c_energySize, c_coordSize);
+                               int      lastTag = -1;
+                               while (queue.pop(&frame))
+                               {
+                                   inOrder    = inOrder && frameTag(frame) > lastTag;
+                                   consistent = consistent && coordTag(frame) == frameTag(frame);
+                                   lastTag    = frameTag(frame);
+                                   numReceived++;
+                               }
+                           });
+
+    ImdFrame      frame(c_energySize, c_coordSize);
+    int           numDropped = 0;
+    for (int i = 0; i < numFrames; i++)
+    {
+        setFrameTag(&frame, i);
+        if (!queue.push(&frame))
+        {
+            numDropped++;
+        }
+    }
+    queue.close();
+    consumer.join();
+
+    EXPECT_TRUE(inOrder);
+    EXPECT_TRUE(consistent);
+    EXPECT_EQ(numFrames, numReceived + numDropped);
+}
+
+} // namespace
@@ -50,6 +50,7 @@
 #include "gromacs/gmxlib/network.h"
 #include "gromacs/math/functions.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/cvreduce.h"
 #include "gromacs/mdlib/main.h"
 #include "gromacs/mdtypes/commrec.h"
 #include "gromacs/mdtypes/fcdata.h"
@@ -62,6 +63,7 @@
 #include "gromacs/topology/mtop_util.h"
 #include "gromacs/topology/topology.h"
 #include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/futil.h"
 #include "gromacs/utility/gmxassert.h"
 #include "gromacs/utility/pleasecite.h"
@@ -178,6 +180,9 @@ void init_disres(FILE *fplog, const gmx_mtop_t *mtop,
 
     snew(dd->rt, dd->npair);
 
+    dd->nthread_alloc = 0;
+    dd->Rt_6_thread   = nullptr;
+
     if (dd->dr_tau != 0.0)
     {
         hist = &state->hist;
@@ -283,45 +288,33 @@ void calc_disres_R_6(const t_commrec *cr,
                      const rvec x[], const t_pbc *pbc,
                      t_fcdata *fcd, history_t *hist)
 {
-    rvec            dx;
-    real           *rt, *rm3tav, *Rtl_6, *Rt_6, *Rtav_6;
-    t_disresdata   *dd;
-    real            ETerm, ETerm1, cf1 = 0, cf2 = 0;
-    gmx_bool        bTav;
-
-    dd           = &(fcd->disres);
-    bTav         = (dd->dr_tau != 0);
-    ETerm        = dd->ETerm;
-    ETerm1       = dd->ETerm1;
-    rt           = dd->rt;
-    rm3tav       = dd->rm3tav;
-    Rtl_6        = dd->Rtl_6;
-    Rt_6         = dd->Rt_6;
-    Rtav_6       = dd->Rtav_6;
-
-    if (bTav)
-    {
-        /* scaling factor to smoothly turn on the restraint forces *
-         * when using time averaging                               */
-        dd->exp_min_t_tau = hist->disre_initf*ETerm;
-
-        cf1 = dd->exp_min_t_tau;
-        cf2 = 1.0/(1.0 - dd->exp_min_t_tau);
-    }
-
-    for (int res = 0; res < dd->nres; res++)
-    {
-        Rtav_6[res] = 0.0;
-        Rt_6[res]   = 0.0;
-    }
+    calc_disres_R_6_local(cr, 1, nfa, forceatoms, x, pbc, fcd, hist, nullptr);
+    calc_disres_R_6_finish(cr, fcd);
+}
 
-    /* 'loop' over all atom pairs (pair_nr=fa/3) involved in restraints, *
-     * the total number of atoms pairs is nfa/3                          */
-    for (int fa = 0; fa < nfa; fa += 3)
+/*! \brief Computes the pair data for pairs \p pair0 to \p pair1 and
+ * adds the r^-6 sums to Rt_6 and Rtav_6, which should be cleared.
+ */
+static void calc_disres_R_6_pairs(const t_disresdata *dd,
+                                  int pair0, int pair1,
+                                  const t_iatom forceatoms[],
+                                  const rvec x[], const t_pbc *pbc,
+                                  const history_t *hist,
+                                  real cf1, real cf2,
+                                  real *Rt_6, real *Rtav_6)
+{
+    gmx_bool  bTav   = (dd->dr_tau != 0);
+    real      ETerm  = dd->ETerm;
+    real      ETerm1 = dd->ETerm1;
+    real     *rt     = dd->rt;
+    real     *rm3tav = dd->rm3tav;
+    rvec      dx;
+
+    for (int pair = pair0; pair < pair1; pair++)
     {
+        int fa   = pair*3;
         int type = forceatoms[fa];
         int res  = type - dd->type_min;
-        int pair = fa/3;
         int ai   = forceatoms[fa+1];
         int aj   = forceatoms[fa+2];
 
@@ -353,37 +346,113 @@ void calc_disres_R_6(const t_commrec *cr,
             rm3tav[pair] = rt_3;
         }
 
-        /* Currently divide_bondeds_over_threads() ensures that pairs within
-         * the same restraint get assigned to the same thread, so we could
-         * run this loop thread-parallel.
-         */
         Rt_6[res]       += rt_3*rt_3;
         Rtav_6[res]     += rm3tav[pair]*rm3tav[pair];
     }
+}
+
+void calc_disres_R_6_local(const t_commrec *cr, int nthreads,
+                           int nfa, const t_iatom forceatoms[],
+                           const rvec x[], const t_pbc *pbc,
+                           t_fcdata *fcd, history_t *hist,
+                           gmx_cvreduce_t *ensembleReduce)
+{
+    t_disresdata   *dd;
+    real            cf1 = 0, cf2 = 0;
+
+    dd           = &(fcd->disres);
+
+    if (dd->dr_tau != 0)
+    {
+        /* scaling factor to smoothly turn on the restraint forces *
+         * when using time averaging                               */
+        dd->exp_min_t_tau = hist->disre_initf*dd->ETerm;
+
+        cf1 = dd->exp_min_t_tau;
+        cf2 = 1.0/(1.0 - dd->exp_min_t_tau);
+    }
+
+    /* 'loop' over all atom pairs (pair_nr=fa/3) involved in restraints, *
+     * the total number of atoms pairs is nfa/3.
+     * With ensemble averaging pairs in different copies of a molecule
+     * contribute to the same restraint, so with multiple threads each
+     * thread sums into its own buffer, which we reduce afterwards.
+     */
+    int npair = nfa/3;
+    int nres2 = 2*dd->nres;
+
+    if (nthreads > 1 && nthreads > dd->nthread_alloc)
+    {
+        dd->nthread_alloc = nthreads;
+        srenew(dd->Rt_6_thread, dd->nthread_alloc*nres2);
+    }
+
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+    for (int th = 0; th < nthreads; th++)
+    {
+        try
+        {
+            /* NOTE: Rt_6 and Rtav_6 are stored consecutively in memory */
+            real *Rt_6 = (nthreads == 1 ? dd->Rt_6 : dd->Rt_6_thread + th*nres2);
+
+            for (int res = 0; res < nres2; res++)
+            {
+                Rt_6[res] = 0.0;
+            }
+
+            calc_disres_R_6_pairs(dd,
+                                  (npair*th)/nthreads, (npair*(th + 1))/nthreads,
+                                  forceatoms, x, pbc, hist, cf1, cf2,
+                                  Rt_6, Rt_6 + dd->nres);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    if (nthreads > 1)
+    {
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+        for (int res = 0; res < nres2; res++)
+        {
+            real sum = 0;
+            for (int th = 0; th < nthreads; th++)
+            {
+                sum += dd->Rt_6_thread[th*nres2 + res];
+            }
+            dd->Rt_6[res] = sum;
+        }
+    }
 
     /* NOTE: Rt_6 and Rtav_6 are stored consecutively in memory */
     if (cr && DOMAINDECOMP(cr))
     {
-        gmx_sum(2*dd->nres, dd->Rt_6, cr);
+        gmx_sum(nres2, dd->Rt_6, cr);
     }
 
-    if (fcd->disres.nsystems > 1)
+    if (dd->nsystems > 1)
     {
         real invn = 1.0/dd->nsystems;
 
         for (int res = 0; res < dd->nres; res++)
         {
-            Rtl_6[res]   = Rt_6[res];
-            Rt_6[res]   *= invn;
-            Rtav_6[res] *= invn;
+            dd->Rtl_6[res]   = dd->Rt_6[res];
+            dd->Rt_6[res]   *= invn;
+            dd->Rtav_6[res] *= invn;
         }
 
         GMX_ASSERT(cr != NULL && cr->ms != NULL, "We need multisim with nsystems>1");
-        gmx_sum_sim(2*dd->nres, dd->Rt_6, cr->ms);
-
-        if (DOMAINDECOMP(cr))
+        /* Only the master ranks take part in the ensemble summation,
+         * calc_disres_R_6_finish() broadcasts the result.
+         */
+        if (MASTER(cr))
         {
-            gmx_bcast(2*dd->nres, dd->Rt_6, cr);
+            if (ensembleReduce != nullptr)
+            {
+                cvreduce_add_real(ensembleReduce, nres2, dd->Rt_6);
+            }
+            else
+            {
+                gmx_sum_sim(nres2, dd->Rt_6, cr->ms);
+            }
         }
     }
 
@@ -396,6 +465,16 @@ void calc_disres_R_6(const t_commrec *cr,
     dd->sumviol         = 0;
 }
 
+void calc_disres_R_6_finish(const t_commrec *cr, t_fcdata *fcd)
+{
+    const t_disresdata *dd = &(fcd->disres);
+
+    if (dd->nsystems > 1 && DOMAINDECOMP(cr))
+    {
+        gmx_bcast(2*dd->nres*sizeof(real), dd->Rt_6, cr);
+    }
+}
+
 real ta_disres(int nfa, const t_iatom forceatoms[], const t_iparams ip[],
                const rvec x[], rvec4 f[], rvec fshift[],
                const t_pbc *pbc, const t_graph *g,
@@ -49,6 +49,7 @@
 #include "gromacs/topology/ifunc.h"
 #include "gromacs/utility/basedefinitions.h"
 
+struct gmx_cvreduce_t;
 struct gmx_mtop_t;
 class history_t;
 struct t_commrec;
@@ -79,6 +80,23 @@ void calc_disres_R_6(const t_commrec *cr,
                      const rvec *x, const t_pbc *pbc,
                      t_fcdata *fcd, history_t *hist);
 
+/*! \brief
+ * Calculates the local part of calc_disres_R_6() using \p nthreads OpenMP threads
+ *
+ * With ensemble averaging the r^-6 sums are registered on the master rank
+ * with \p ensembleReduce for summation over the simulations, which should
+ * be completed before calling calc_disres_R_6_finish(). When
+ * \p ensembleReduce is nullptr, they are summed here.
+ */
+void calc_disres_R_6_local(const t_commrec *cr, int nthreads,
+                           int nfa, const t_iatom *fa,
+                           const rvec *x, const t_pbc *pbc,
+                           t_fcdata *fcd, history_t *hist,
+                           gmx_cvreduce_t *ensembleReduce);
+
+//! Distributes the ensemble averages over the ranks of the simulation.
+void calc_disres_R_6_finish(const t_commrec *cr, t_fcdata *fcd);
+
 //! Calculates the distance restraint forces, return the potential.
 t_ifunc ta_disres;
 
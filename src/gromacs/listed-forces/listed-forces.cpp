@@ -57,6 +57,7 @@
 #include "gromacs/listed-forces/pairs.h"
 #include "gromacs/listed-forces/position-restraints.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/cvreduce.h"
 #include "gromacs/mdlib/force.h"
 #include "gromacs/mdlib/force_flags.h"
 #include "gromacs/mdtypes/commrec.h"
@@ -461,6 +462,29 @@ void calc_listed(const t_commrec             *cr,
            restraints, anyway. */
         wallcycle_sub_start(wcycle, ewcsRESTRAINTS);
 
+        /* Do pre force calculation stuff which might require communication.
+         * With ensemble averaging the orientation and distance restraint
+         * averages are summed over the simulations in a single message,
+         * which is in flight while we compute the position restraints.
+         */
+        if (fcd->orires.nr > 0)
+        {
+            calc_orires_dev_local(cr->ms, bt->nthreads,
+                                  idef->il[F_ORIRES].nr,
+                                  idef->il[F_ORIRES].iatoms,
+                                  idef->iparams, md, x,
+                                  pbc_null, fcd, fr->ensemblereduce);
+        }
+        if (fcd->disres.nres > 0)
+        {
+            calc_disres_R_6_local(cr, bt->nthreads,
+                                  idef->il[F_DISRES].nr,
+                                  idef->il[F_DISRES].iatoms,
+                                  x, pbc_null,
+                                  fcd, hist, fr->ensemblereduce);
+        }
+        cvreduce_start_sim(fr->ensemblereduce, cr->ms);
+
         if (idef->il[F_POSRES].nr > 0)
         {
             posres_wrapper(nrnb, idef, pbc_full, x, enerd, lambda, fr);
@@ -471,22 +495,18 @@ void calc_listed(const t_commrec             *cr,
             fbposres_wrapper(nrnb, idef, pbc_full, x, enerd, fr);
         }
 
-        /* Do pre force calculation stuff which might require communication */
+        cvreduce_finish_sim(fr->ensemblereduce, cr->ms);
         if (fcd->orires.nr > 0)
         {
             enerd->term[F_ORIRESDEV] =
-                calc_orires_dev(cr->ms, idef->il[F_ORIRES].nr,
-                                idef->il[F_ORIRES].iatoms,
-                                idef->iparams, md, x,
-                                pbc_null, fcd, hist);
+                calc_orires_dev_finish(cr->ms, bt->nthreads,
+                                       idef->il[F_ORIRES].nr,
+                                       idef->il[F_ORIRES].iatoms,
+                                       idef->iparams, fcd, hist);
         }
         if (fcd->disres.nres > 0)
         {
-            calc_disres_R_6(cr,
-                            idef->il[F_DISRES].nr,
-                            idef->il[F_DISRES].iatoms,
-                            x, pbc_null,
-                            fcd, hist);
+            calc_disres_R_6_finish(cr, fcd);
         }
 
         wallcycle_sub_stop(wcycle, ewcsRESTRAINTS);
@@ -45,6 +45,7 @@
 #include "gromacs/math/do_fit.h"
 #include "gromacs/math/functions.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/cvreduce.h"
 #include "gromacs/mdlib/main.h"
 #include "gromacs/mdtypes/commrec.h"
 #include "gromacs/mdtypes/fcdata.h"
@@ -57,6 +58,7 @@
 #include "gromacs/topology/ifunc.h"
 #include "gromacs/topology/mtop_util.h"
 #include "gromacs/topology/topology.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/pleasecite.h"
 #include "gromacs/utility/smalloc.h"
@@ -200,6 +202,10 @@ void init_orires(FILE *fplog, const gmx_mtop_t *mtop,
 
     snew(od->eig, od->nex*12);
 
+    od->nthread_alloc   = 0;
+    od->tmp_thread      = nullptr;
+    od->forceatomsStart = nullptr;
+
     /* Determine the reference structure on the master node.
      * Copy it to the other nodes after checking multi compatibility,
      * so we are sure the subsystems match before copying.
@@ -361,16 +367,23 @@ real calc_orires_dev(const gmx_multisim_t *ms,
                      const t_mdatoms *md, const rvec x[], const t_pbc *pbc,
                      t_fcdata *fcd, history_t *hist)
 {
-    int              fa, d, i, j, type, ex, nref;
-    real             edt, edt_1, invn, pfac, r2, invr, corrfac, weight, wsv2, sw, dev;
-    tensor          *S, R, TMP;
-    rvec5           *Dinsl, *Dins, *Dtav, *rhs;
-    real            *mref, ***T;
+    calc_orires_dev_local(ms, 1, nfa, forceatoms, ip, md, x, pbc, fcd, nullptr);
+
+    return calc_orires_dev_finish(ms, 1, nfa, forceatoms, ip, fcd, hist);
+}
+
+void calc_orires_dev_local(const gmx_multisim_t *ms, int nthreads,
+                           int nfa, const t_iatom forceatoms[], const t_iparams ip[],
+                           const t_mdatoms *md, const rvec x[], const t_pbc *pbc,
+                           t_fcdata *fcd, gmx_cvreduce_t *ensembleReduce)
+{
+    int              d, i, j, nref;
+    real             invn;
+    rvec5           *Dinsl, *Dins;
+    real            *mref;
     double           mtot;
-    rvec            *xref, *xtmp, com, r_unrot, r;
+    rvec            *xref, *xtmp, com;
     t_oriresdata    *od;
-    gmx_bool         bTAV;
-    const real       two_thr = 2.0/3.0;
 
     od = &(fcd->orires);
 
@@ -380,34 +393,13 @@ real calc_orires_dev(const gmx_multisim_t *ms,
         gmx_fatal(FARGS, "Orientation restraints are only supported on the master rank, use fewer ranks");
     }
 
-    bTAV  = (od->edt != 0);
-    edt   = od->edt;
-    edt_1 = od->edt_1;
-    S     = od->S;
     Dinsl = od->Dinsl;
     Dins  = od->Dins;
-    Dtav  = od->Dtav;
-    T     = od->TMP;
-    rhs   = od->tmp;
     nref  = od->nref;
     mref  = od->mref;
     xref  = od->xref;
     xtmp  = od->xtmp;
 
-    if (bTAV)
-    {
-        od->exp_min_t_tau = hist->orire_initf*edt;
-
-        /* Correction factor to correct for the lack of history
-         * at short times.
-         */
-        corrfac = 1.0/(1.0 - od->exp_min_t_tau);
-    }
-    else
-    {
-        corrfac = 1.0;
-    }
-
     if (ms)
     {
         invn = 1.0/ms->nsim;
@@ -440,53 +432,163 @@ real calc_orires_dev(const gmx_multisim_t *ms,
         rvec_dec(xtmp[j], com);
     }
     /* Calculate the rotation matrix to rotate x to the reference orientation */
-    calc_fit_R(DIM, nref, mref, xref, xtmp, R);
-    copy_mat(R, od->R);
+    calc_fit_R(DIM, nref, mref, xref, xtmp, od->R);
 
-    d = 0;
-    for (fa = 0; fa < nfa; fa += 3)
+    const int nrestr = nfa/3;
+
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+    for (int restr = 0; restr < nrestr; restr++)
     {
-        type = forceatoms[fa];
-        if (pbc)
+        try
         {
-            pbc_dx_aiuc(pbc, x[forceatoms[fa+1]], x[forceatoms[fa+2]], r_unrot);
+            const t_iatom *fa = forceatoms + restr*3;
+            int            type = fa[0];
+            rvec           r_unrot, r;
+
+            if (pbc)
+            {
+                pbc_dx_aiuc(pbc, x[fa[1]], x[fa[2]], r_unrot);
+            }
+            else
+            {
+                rvec_sub(x[fa[1]], x[fa[2]], r_unrot);
+            }
+            mvmul(od->R, r_unrot, r);
+            real r2   = norm2(r);
+            real invr = gmx::invsqrt(r2);
+            /* Calculate the prefactor for the D tensor, this includes the factor 3! */
+            real pfac = ip[type].orires.c*invr*invr*3;
+            for (int p = 0; p < ip[type].orires.power; p++)
+            {
+                pfac *= invr;
+            }
+            Dinsl[restr][0] = pfac*(2*r[0]*r[0] + r[1]*r[1] - r2);
+            Dinsl[restr][1] = pfac*(2*r[0]*r[1]);
+            Dinsl[restr][2] = pfac*(2*r[0]*r[2]);
+            Dinsl[restr][3] = pfac*(2*r[1]*r[1] + r[0]*r[0] - r2);
+            Dinsl[restr][4] = pfac*(2*r[1]*r[2]);
+
+            if (ms)
+            {
+                for (int k = 0; k < 5; k++)
+                {
+                    Dins[restr][k] = Dinsl[restr][k]*invn;
+                }
+            }
         }
-        else
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    if (ms)
+    {
+        if (ensembleReduce != nullptr)
         {
-            rvec_sub(x[forceatoms[fa+1]], x[forceatoms[fa+2]], r_unrot);
+            cvreduce_add_real(ensembleReduce, 5*od->nr, Dins[0]);
         }
-        mvmul(R, r_unrot, r);
-        r2   = norm2(r);
-        invr = gmx::invsqrt(r2);
-        /* Calculate the prefactor for the D tensor, this includes the factor 3! */
-        pfac = ip[type].orires.c*invr*invr*3;
-        for (i = 0; i < ip[type].orires.power; i++)
+        else
         {
-            pfac *= invr;
+            gmx_sum_sim(5*od->nr, Dins[0], ms);
         }
-        Dinsl[d][0] = pfac*(2*r[0]*r[0] + r[1]*r[1] - r2);
-        Dinsl[d][1] = pfac*(2*r[0]*r[1]);
-        Dinsl[d][2] = pfac*(2*r[0]*r[2]);
-        Dinsl[d][3] = pfac*(2*r[1]*r[1] + r[0]*r[0] - r2);
-        Dinsl[d][4] = pfac*(2*r[1]*r[2]);
+    }
+}
+
+real calc_orires_dev_finish(const gmx_multisim_t *ms, int nthreads,
+                            int nfa, const t_iatom forceatoms[], const t_iparams ip[],
+                            t_fcdata *fcd, history_t *hist)
+{
+    int              i, j, ex;
+    real             edt, edt_1, corrfac, wsv2, sw;
+    tensor          *S, TMP;
+    rvec5           *Dinsl, *Dins, *Dtav, *rhs;
+    real          ***T;
+    t_oriresdata    *od;
+    gmx_bool         bTAV;
+    const real       two_thr = 2.0/3.0;
+
+    od = &(fcd->orires);
 
-        if (ms)
+    bTAV  = (od->edt != 0);
+    edt   = od->edt;
+    edt_1 = od->edt_1;
+    S     = od->S;
+    Dinsl = od->Dinsl;
+    Dins  = od->Dins;
+    Dtav  = od->Dtav;
+    T     = od->TMP;
+    rhs   = od->tmp;
+
+    if (bTAV)
+    {
+        od->exp_min_t_tau = hist->orire_initf*edt;
+
+        /* Correction factor to correct for the lack of history
+         * at short times.
+         */
+        corrfac = 1.0/(1.0 - od->exp_min_t_tau);
+    }
+    else
+    {
+        corrfac = 1.0;
+    }
+
+    /* Calculate the order tensor S for each experiment via optimization.
+     * Each thread sums the vector rhs and half the matrix T for
+     * the 5 equations of each experiment into its own buffer
+     * of nex times 5 + 15 elements.
+     */
+    const int nrestr = nfa/3;
+    const int nsum   = 5 + 15;
+
+    if (nthreads > od->nthread_alloc)
+    {
+        od->nthread_alloc = nthreads;
+        srenew(od->tmp_thread, od->nthread_alloc*od->nex*nsum);
+    }
+
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+    for (int th = 0; th < nthreads; th++)
+    {
+        try
         {
-            for (i = 0; i < 5; i++)
+            real *sum_th = od->tmp_thread + th*od->nex*nsum;
+
+            for (int k = 0; k < od->nex*nsum; k++)
             {
-                Dins[d][i] = Dinsl[d][i]*invn;
+                sum_th[k] = 0;
             }
-        }
 
-        d++;
-    }
+            for (int restr = (nrestr*th)/nthreads; restr < (nrestr*(th + 1))/nthreads; restr++)
+            {
+                if (bTAV)
+                {
+                    /* Here we update Dtav in t_fcdata using the data in history_t.
+                     * Thus the results stay correct when this routine
+                     * is called multiple times.
+                     */
+                    for (int k = 0; k < 5; k++)
+                    {
+                        Dtav[restr][k] = edt*hist->orire_Dtav[restr*5+k] + edt_1*Dins[restr][k];
+                    }
+                }
 
-    if (ms)
-    {
-        gmx_sum_sim(5*od->nr, Dins[0], ms);
+                int   type   = forceatoms[restr*3];
+                real  weight = ip[type].orires.kfac;
+                real *rhs_th = sum_th + ip[type].orires.ex*nsum;
+                real *T_th   = rhs_th + 5;
+                for (int k = 0; k < 5; k++)
+                {
+                    rhs_th[k] += Dtav[restr][k]*ip[type].orires.obs*weight;
+                    for (int l = 0; l <= k; l++)
+                    {
+                        *T_th++ += Dtav[restr][k]*Dtav[restr][l]*weight;
+                    }
+                }
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
     }
 
-    /* Calculate the order tensor S for each experiment via optimization */
+    /* Reduce the thread sums */
     for (ex = 0; ex < od->nex; ex++)
     {
         for (i = 0; i < 5; i++)
@@ -497,36 +599,21 @@ real calc_orires_dev(const gmx_multisim_t *ms,
                 T[ex][i][j] = 0;
             }
         }
-    }
-    d = 0;
-    for (fa = 0; fa < nfa; fa += 3)
-    {
-        if (bTAV)
+        for (int th = 0; th < nthreads; th++)
         {
-            /* Here we update Dtav in t_fcdata using the data in history_t.
-             * Thus the results stay correct when this routine
-             * is called multiple times.
-             */
+            const real *rhs_th = od->tmp_thread + (th*od->nex + ex)*nsum;
+            const real *T_th   = rhs_th + 5;
             for (i = 0; i < 5; i++)
             {
-                Dtav[d][i] = edt*hist->orire_Dtav[d*5+i] + edt_1*Dins[d][i];
-            }
-        }
-
-        type   = forceatoms[fa];
-        ex     = ip[type].orires.ex;
-        weight = ip[type].orires.kfac;
-        /* Calculate the vector rhs and half the matrix T for the 5 equations */
-        for (i = 0; i < 5; i++)
-        {
-            rhs[ex][i] += Dtav[d][i]*ip[type].orires.obs*weight;
-            for (j = 0; j <= i; j++)
-            {
-                T[ex][i][j] += Dtav[d][i]*Dtav[d][j]*weight;
+                rhs[ex][i] += rhs_th[i];
+                for (j = 0; j <= i; j++)
+                {
+                    T[ex][i][j] += *T_th++;
+                }
             }
         }
-        d++;
     }
+
     /* Now we have all the data we can calculate S */
     for (ex = 0; ex < od->nex; ex++)
     {
@@ -565,49 +652,56 @@ real calc_orires_dev(const gmx_multisim_t *ms,
     wsv2 = 0;
     sw   = 0;
 
-    d = 0;
-    for (fa = 0; fa < nfa; fa += 3)
+#pragma omp parallel for num_threads(nthreads) schedule(static) reduction(+:wsv2, sw)
+    for (int restr = 0; restr < nrestr; restr++)
     {
-        type = forceatoms[fa];
-        ex   = ip[type].orires.ex;
-
-        od->otav[d] = two_thr*
-            corrfac*(S[ex][0][0]*Dtav[d][0] + S[ex][0][1]*Dtav[d][1] +
-                     S[ex][0][2]*Dtav[d][2] + S[ex][1][1]*Dtav[d][3] +
-                     S[ex][1][2]*Dtav[d][4]);
-        if (bTAV)
+        try
         {
-            od->oins[d] = two_thr*(S[ex][0][0]*Dins[d][0] + S[ex][0][1]*Dins[d][1] +
-                                   S[ex][0][2]*Dins[d][2] + S[ex][1][1]*Dins[d][3] +
-                                   S[ex][1][2]*Dins[d][4]);
-        }
-        if (ms)
-        {
-            /* When ensemble averaging is used recalculate the local orientation
-             * for output to the energy file.
-             */
-            od->oinsl[d] = two_thr*
-                (S[ex][0][0]*Dinsl[d][0] + S[ex][0][1]*Dinsl[d][1] +
-                 S[ex][0][2]*Dinsl[d][2] + S[ex][1][1]*Dinsl[d][3] +
-                 S[ex][1][2]*Dinsl[d][4]);
-        }
+            int type = forceatoms[restr*3];
+            int e    = ip[type].orires.ex;
 
-        dev = od->otav[d] - ip[type].orires.obs;
+            od->otav[restr] = two_thr*
+                corrfac*(S[e][0][0]*Dtav[restr][0] + S[e][0][1]*Dtav[restr][1] +
+                         S[e][0][2]*Dtav[restr][2] + S[e][1][1]*Dtav[restr][3] +
+                         S[e][1][2]*Dtav[restr][4]);
+            if (bTAV)
+            {
+                od->oins[restr] = two_thr*(S[e][0][0]*Dins[restr][0] + S[e][0][1]*Dins[restr][1] +
+                                           S[e][0][2]*Dins[restr][2] + S[e][1][1]*Dins[restr][3] +
+                                           S[e][1][2]*Dins[restr][4]);
+            }
+            if (ms)
+            {
+                /* When ensemble averaging is used recalculate the local orientation
+                 * for output to the energy file.
+                 */
+                od->oinsl[restr] = two_thr*
+                    (S[e][0][0]*Dinsl[restr][0] + S[e][0][1]*Dinsl[restr][1] +
+                     S[e][0][2]*Dinsl[restr][2] + S[e][1][1]*Dinsl[restr][3] +
+                     S[e][1][2]*Dinsl[restr][4]);
+            }
 
-        wsv2 += ip[type].orires.kfac*gmx::square(dev);
-        sw   += ip[type].orires.kfac;
+            real dev = od->otav[restr] - ip[type].orires.obs;
 
-        d++;
+            wsv2 += ip[type].orires.kfac*gmx::square(dev);
+            sw   += ip[type].orires.kfac;
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
     }
     od->rmsdev = std::sqrt(wsv2/sw);
 
     /* Rotate the S matrices back, so we get the correct grad(tr(S D)) */
     for (ex = 0; ex < od->nex; ex++)
     {
-        tmmul(R, S[ex], TMP);
-        mmul(TMP, R, S[ex]);
+        tmmul(od->R, S[ex], TMP);
+        mmul(TMP, od->R, S[ex]);
     }
 
+    /* Store the base forceatoms pointer, so we can re-calculate the
+     * restraint index in orires() when using thread parallelization.
+     */
+    od->forceatomsStart = forceatoms;
+
     return od->rmsdev;
 
     /* Approx. 120*nfa/3 flops */
@@ -643,7 +737,10 @@ real orires(int nfa, const t_iatom forceatoms[], const t_iparams ip[],
             smooth_fc *= (1.0 - od->exp_min_t_tau);
         }
 
-        d = 0;
+        /* The restraint index is the forceatoms index relative to
+         * the start of the orires forceatoms, divided by 3.
+         */
+        d = static_cast<int>(forceatoms - od->forceatomsStart)/3;
         for (fa = 0; fa < nfa; fa += 3)
         {
             type  = forceatoms[fa];
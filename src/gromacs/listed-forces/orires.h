@@ -48,6 +48,7 @@
 
 #include "gromacs/topology/ifunc.h"
 
+struct gmx_cvreduce_t;
 struct gmx_mtop_t;
 struct gmx_multisim_t;
 class history_t;
@@ -79,6 +80,30 @@ real calc_orires_dev(const gmx_multisim_t *ms,
                      const t_mdatoms *md, const rvec x[],
                      const t_pbc *pbc, t_fcdata *fcd, history_t *hist);
 
+/*! \brief
+ * Calculates the instantaneous D matrices, the first part of calc_orires_dev()
+ *
+ * Uses \p nthreads OpenMP threads. With ensemble averaging the D matrices
+ * are registered with \p ensembleReduce for summation over the simulations,
+ * which should be completed before calling calc_orires_dev_finish().
+ * When \p ensembleReduce is nullptr, they are summed here.
+ */
+void calc_orires_dev_local(const gmx_multisim_t *ms, int nthreads,
+                           int nfa, const t_iatom fa[], const t_iparams ip[],
+                           const t_mdatoms *md, const rvec x[],
+                           const t_pbc *pbc, t_fcdata *fcd,
+                           gmx_cvreduce_t *ensembleReduce);
+
+/*! \brief
+ * Calculates the time averaged D matrices and the S matrices from the
+ * ensemble averaged D matrices, the second part of calc_orires_dev()
+ *
+ * Returns the weighted RMS deviation of the orientation restraints.
+ */
+real calc_orires_dev_finish(const gmx_multisim_t *ms, int nthreads,
+                            int nfa, const t_iatom fa[], const t_iparams ip[],
+                            t_fcdata *fcd, history_t *hist);
+
 /*! \brief
  * Diagonalizes the order tensor(s) of the orienation restraints.
  *
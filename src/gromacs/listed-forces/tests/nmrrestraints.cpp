@@ -0,0 +1,388 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests that the threaded distance and orientation restraint averaging
+ * gives the same results as a single thread.
+ *
+ * \ingroup module_listed-forces
+ */
+#include "gmxpre.h"
+
+#include <cmath>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxlib/network.h"
+#include "gromacs/listed-forces/disre.h"
+#include "gromacs/listed-forces/orires.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdtypes/commrec.h"
+#include "gromacs/mdtypes/fcdata.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/mdtypes/mdatom.h"
+#include "gromacs/mdtypes/state.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/real.h"
+
+#include "testutils/testasserts.h"
+#include "testutils/testfilemanager.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of atoms in the restrained molecule
+const int c_numAtomsPerMolecule = 4;
+//! The number of copies of the molecule
+const int c_numMolecules        = 7;
+//! The thread counts to compare with a single thread
+const int c_threadCounts[]      = { 2, 3, 4 };
+
+/*! \brief Test fixture with copies of a molecule with distance and
+ * orientation restraints
+ *
+ * Distance restraint 0 has two pairs, restraint 1 one pair. With
+ * ensemble averaging the copies contribute to the same restraints.
+ * There are two orientation experiments with two and three restraints.
+ */
+class NmrRestraintsTest : public ::testing::Test
+{
+    public:
+        //! Sets up the topology, coordinates and MD input
+        NmrRestraintsTest() : atoms_(c_numAtomsPerMolecule), iparams_(7), functype_(7),
+                              moltype_ {}, molblock_ {}, mtop_ {}, md_ {}, cr_(init_commrec())
+        {
+            for (t_atom &atom : atoms_)
+            {
+                atom       = t_atom {};
+                atom.m     = 12;
+                atom.ptype = eptAtom;
+            }
+            moltype_.atoms.nr   = atoms_.size();
+            moltype_.atoms.atom = atoms_.data();
+
+            /* Distance restraints: type, pairs */
+            for (int type = 0; type < 2; type++)
+            {
+                functype_[type]              = F_DISRES;
+                iparams_[type].disres.label  = type;
+                iparams_[type].disres.npair  = 2 - type;
+                iparams_[type].disres.low    = 0;
+                iparams_[type].disres.up1    = 0.3;
+                iparams_[type].disres.up2    = 0.4;
+                iparams_[type].disres.kfac   = 1;
+            }
+            disresIatoms_ = { 0, 0, 2, 0, 1, 3, 1, 0, 3 };
+
+            /* Orientation restraints of two experiments */
+            const int  ex[5]  = { 0, 0, 1, 1, 1 };
+            const real obs[5] = { 0.3, -0.2, 0.1, 0.25, -0.4 };
+            for (int i = 0; i < 5; i++)
+            {
+                int type = 2 + i;
+                functype_[type]             = F_ORIRES;
+                iparams_[type].orires.ex    = ex[i];
+                iparams_[type].orires.label = i;
+                iparams_[type].orires.power = 3;
+                iparams_[type].orires.c     = 0.05;
+                iparams_[type].orires.obs   = obs[i];
+                iparams_[type].orires.kfac  = 1 + 0.5*i;
+            }
+            oriresIatoms_ = { 2, 0, 1, 3, 1, 2, 4, 2, 3, 5, 0, 3, 6, 1, 3 };
+
+            moltype_.ilist[F_DISRES].nr     = disresIatoms_.size();
+            moltype_.ilist[F_DISRES].iatoms = disresIatoms_.data();
+            moltype_.ilist[F_ORIRES].nr     = oriresIatoms_.size();
+            moltype_.ilist[F_ORIRES].iatoms = oriresIatoms_.data();
+
+            molblock_.type       = 0;
+            molblock_.nmol       = c_numMolecules;
+            molblock_.natoms_mol = c_numAtomsPerMolecule;
+
+            mtop_.nmoltype          = 1;
+            mtop_.moltype           = &moltype_;
+            mtop_.nmolblock         = 1;
+            mtop_.molblock          = &molblock_;
+            mtop_.natoms            = c_numMolecules*c_numAtomsPerMolecule;
+            mtop_.ffparams.ntypes   = iparams_.size();
+            mtop_.ffparams.functype = functype_.data();
+            mtop_.ffparams.iparams  = iparams_.data();
+
+            /* The restraints of all molecule copies, as in the local topology */
+            for (int mol = 0; mol < c_numMolecules; mol++)
+            {
+                int offset = mol*c_numAtomsPerMolecule;
+                addRestraints(disresIatoms_, offset, &disresForceatoms_);
+                addRestraints(oriresIatoms_, offset, &oriresForceatoms_);
+            }
+
+            /* Irregular molecule conformations and a shifted reference */
+            for (int i = 0; i < mtop_.natoms; i++)
+            {
+                x_.push_back(RVec(0.15*(i % c_numAtomsPerMolecule) + 0.02*std::sin(1.3*i),
+                                  0.1*std::cos(0.7*i),
+                                  0.05*(i % 3) + 0.03*std::sin(0.4*i*i)));
+                xref_.push_back(RVec(x_[i][XX] + 0.01*std::cos(2.1*i), x_[i][YY], x_[i][ZZ]));
+                massT_.push_back(atoms_[i % c_numAtomsPerMolecule].m);
+                cORF_.push_back(0);
+            }
+            md_.nr    = mtop_.natoms;
+            md_.massT = massT_.data();
+            md_.cORF  = cORF_.data();
+
+            ir_.eI              = eiMD;
+            ir_.delta_t         = 0.002;
+            ir_.eDisre          = edrEnsemble;
+            ir_.eDisreWeighting = edrwConservative;
+            ir_.dr_fc           = 1000;
+            ir_.orires_fc       = 1000;
+        }
+
+        ~NmrRestraintsTest()
+        {
+            done_commrec(cr_);
+        }
+
+        //! Adds the restraints in \p iatoms with atoms shifted by \p offset to \p forceatoms
+        static void addRestraints(const std::vector<t_iatom> &iatoms, int offset,
+                                  std::vector<t_iatom> *forceatoms)
+        {
+            for (size_t i = 0; i < iatoms.size(); i += 3)
+            {
+                forceatoms->push_back(iatoms[i]);
+                forceatoms->push_back(iatoms[i + 1] + offset);
+                forceatoms->push_back(iatoms[i + 2] + offset);
+            }
+        }
+
+        //! Sets up the distance restraints with time constant \p tau
+        void initDisres(real tau)
+        {
+            ir_.dr_tau = tau;
+            init_disres(nullptr, &mtop_, &ir_, cr_, &fcd_, &state_, FALSE);
+            /* Start time averaging from a history that differs from the current distances */
+            for (int i = 0; i < state_.hist.ndisrepairs; i++)
+            {
+                state_.hist.disre_rm3tav[i] = 10 + i;
+            }
+            state_.hist.disre_initf = 0.5;
+        }
+
+        //! Sets up the orientation restraints with time constant \p tau
+        void initOrires(real tau)
+        {
+            ir_.orires_tau = tau;
+            FILE *fplog = gmx_ffopen(fileManager_.getTemporaryFilePath("log").c_str(), "w");
+            init_orires(fplog, &mtop_, as_rvec_array(xref_.data()), &ir_, cr_, &fcd_.orires, &state_);
+            gmx_ffclose(fplog);
+            for (int i = 0; i < state_.hist.norire_Dtav; i++)
+            {
+                state_.hist.orire_Dtav[i] = 10*std::sin(0.9*i);
+            }
+            state_.hist.orire_initf = 0.5;
+        }
+
+        //! Checks the distance restraint averages with threads against a single thread
+        void checkDisresThreads()
+        {
+            const t_disresdata &dd = fcd_.disres;
+            ASSERT_EQ(2, dd.nres);
+            ASSERT_EQ(3*c_numMolecules, dd.npair);
+
+            calc_disres_R_6_local(cr_, 1, disresForceatoms_.size(), disresForceatoms_.data(),
+                                  as_rvec_array(x_.data()), nullptr, &fcd_, &state_.hist, nullptr);
+            calc_disres_R_6_finish(cr_, &fcd_);
+            std::vector<real> Rt_6Ref(dd.Rt_6, dd.Rt_6 + 2*dd.nres);
+            std::vector<real> rtRef(dd.rt, dd.rt + dd.npair);
+            std::vector<real> rm3tavRef(dd.rm3tav, dd.rm3tav + dd.npair);
+
+            for (int nthreads : c_threadCounts)
+            {
+                SCOPED_TRACE("with " + std::to_string(nthreads) + " threads");
+                calc_disres_R_6_local(cr_, nthreads, disresForceatoms_.size(), disresForceatoms_.data(),
+                                      as_rvec_array(x_.data()), nullptr, &fcd_, &state_.hist, nullptr);
+                calc_disres_R_6_finish(cr_, &fcd_);
+
+                /* Only the summation order of the r^-6 sums differs */
+                for (int res = 0; res < 2*dd.nres; res++)
+                {
+                    EXPECT_REAL_EQ_TOL(Rt_6Ref[res], dd.Rt_6[res], relativeToleranceAsUlp(Rt_6Ref[res], 16));
+                }
+                for (int pair = 0; pair < dd.npair; pair++)
+                {
+                    EXPECT_EQ(rtRef[pair], dd.rt[pair]);
+                    EXPECT_EQ(rm3tavRef[pair], dd.rm3tav[pair]);
+                }
+            }
+        }
+
+        //! Checks the orientation restraint averages with threads against a single thread
+        void checkOriresThreads()
+        {
+            const t_oriresdata &od = fcd_.orires;
+            ASSERT_EQ(5*c_numMolecules, od.nr);
+            ASSERT_EQ(2, od.nex);
+
+            calc_orires_dev_local(nullptr, 1, oriresForceatoms_.size(), oriresForceatoms_.data(),
+                                  iparams_.data(), &md_, as_rvec_array(x_.data()), nullptr, &fcd_, nullptr);
+            real              rmsdevRef = calc_orires_dev_finish(nullptr, 1, oriresForceatoms_.size(),
+                                                                 oriresForceatoms_.data(), iparams_.data(),
+                                                                 &fcd_, &state_.hist);
+            std::vector<real> otavRef(od.otav, od.otav + od.nr);
+            std::vector<real> oinsRef(od.oins, od.oins + od.nr);
+            std::vector<real> SRef;
+            for (int ex = 0; ex < od.nex; ex++)
+            {
+                for (int d1 = 0; d1 < DIM; d1++)
+                {
+                    for (int d2 = 0; d2 < DIM; d2++)
+                    {
+                        SRef.push_back(od.S[ex][d1][d2]);
+                    }
+                }
+            }
+
+            /* The S matrices are solved from sums over restraints, so they
+             * are sensitive to the summation order. Allow a relative
+             * deviation that is still far below any physical effect.
+             */
+            FloatingPointTolerance tolerance = relativeToleranceAsFloatingPoint(1, 100*GMX_REAL_EPS);
+            for (int nthreads : c_threadCounts)
+            {
+                SCOPED_TRACE("with " + std::to_string(nthreads) + " threads");
+                calc_orires_dev_local(nullptr, nthreads, oriresForceatoms_.size(), oriresForceatoms_.data(),
+                                      iparams_.data(), &md_, as_rvec_array(x_.data()), nullptr, &fcd_, nullptr);
+                real rmsdev = calc_orires_dev_finish(nullptr, nthreads, oriresForceatoms_.size(),
+                                                     oriresForceatoms_.data(), iparams_.data(),
+                                                     &fcd_, &state_.hist);
+
+                EXPECT_REAL_EQ_TOL(rmsdevRef, rmsdev, tolerance);
+                for (int ex = 0; ex < od.nex; ex++)
+                {
+                    for (int d1 = 0; d1 < DIM; d1++)
+                    {
+                        for (int d2 = 0; d2 < DIM; d2++)
+                        {
+                            EXPECT_REAL_EQ_TOL(SRef[(ex*DIM + d1)*DIM + d2], od.S[ex][d1][d2], tolerance);
+                        }
+                    }
+                }
+                for (int restr = 0; restr < od.nr; restr++)
+                {
+                    EXPECT_REAL_EQ_TOL(otavRef[restr], od.otav[restr], tolerance);
+                    EXPECT_REAL_EQ_TOL(oinsRef[restr], od.oins[restr], tolerance);
+                }
+            }
+        }
+
+        //! The atoms of the molecule type
+        std::vector<t_atom>         atoms_;
+        //! The interaction parameters
+        std::vector<t_iparams>      iparams_;
+        //! The interaction function types
+        std::vector<t_functype>     functype_;
+        //! The distance restraints of the molecule type
+        std::vector<t_iatom>        disresIatoms_;
+        //! The orientation restraints of the molecule type
+        std::vector<t_iatom>        oriresIatoms_;
+        //! The molecule type
+        gmx_moltype_t               moltype_;
+        //! The molecule block
+        gmx_molblock_t              molblock_;
+        //! The system topology
+        gmx_mtop_t                  mtop_;
+        //! The distance restraints of all molecules
+        std::vector<t_iatom>        disresForceatoms_;
+        //! The orientation restraints of all molecules
+        std::vector<t_iatom>        oriresForceatoms_;
+        //! The coordinates
+        std::vector<RVec>           x_;
+        //! The orientation restraint reference coordinates
+        std::vector<RVec>           xref_;
+        //! The masses for the MD atoms
+        std::vector<real>           massT_;
+        //! The orientation restraint fit groups for the MD atoms
+        std::vector<unsigned short> cORF_;
+        //! The MD atoms
+        t_mdatoms                   md_;
+        //! The MD input
+        t_inputrec                  ir_;
+        //! The communication record for a single rank
+        t_commrec                  *cr_;
+        //! The restraint data
+        t_fcdata                    fcd_ {};
+        //! The state with the restraint history
+        t_state                     state_;
+        //! Manager for the log file of init_orires()
+        TestFileManager             fileManager_;
+};
+
+TEST_F(NmrRestraintsTest, DisresAveragingWithThreadsMatchesSingleThread)
+{
+    initDisres(0);
+    checkDisresThreads();
+}
+
+TEST_F(NmrRestraintsTest, TimeAveragedDisresWithThreadsMatchesSingleThread)
+{
+    initDisres(10);
+    checkDisresThreads();
+}
+
+TEST_F(NmrRestraintsTest, OriresAveragingWithThreadsMatchesSingleThread)
+{
+    initOrires(0);
+    checkOriresThreads();
+}
+
+TEST_F(NmrRestraintsTest, TimeAveragedOriresWithThreadsMatchesSingleThread)
+{
+    initOrires(10);
+    checkOriresThreads();
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
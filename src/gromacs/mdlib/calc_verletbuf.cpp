@@ -819,12 +819,16 @@ static real md3_force_switch(real p, real rswitch, real rc)
     return md3_pot + md3_sw;
 }
 
-void calc_verlet_buffer_size(const gmx_mtop_t *mtop, real boxvol,
-                             const t_inputrec *ir,
-                             real reference_temperature,
-                             const verletbuf_list_setup_t *list_setup,
-                             int *n_nonlin_vsite,
-                             real *rlist)
+/* Returns the pair-list cut-off for a list that is used for list_lifetime
+ * steps after the step at which it was constructed or pruned.
+ * See calc_verlet_buffer_size for the other parameters.
+ */
+static real calc_verlet_buffer_size_lifetime(const gmx_mtop_t *mtop, real boxvol,
+                                             const t_inputrec *ir,
+                                             int list_lifetime,
+                                             real reference_temperature,
+                                             const verletbuf_list_setup_t *list_setup,
+                                             int *n_nonlin_vsite)
 {
     double                resolution;
     char                 *env;
@@ -922,11 +926,14 @@ void calc_verlet_buffer_size(const gmx_mtop_t *mtop, real boxvol,
     pot_derivatives_t ljRep  = { 0, 0, 0 };
     real              repPow = mtop->ffparams.reppow;
 
-    if (ir->vdwtype == evdwCUT)
+    if (ir->vdwtype == evdwCUT || ir->vdwtype == evdwUSER)
     {
         real sw_range, md3_pswf;
 
-        switch (ir->vdw_modifier)
+        /* We do not know the shape of user potentials, so we estimate
+         * the buffer as for plain LJ, modifiers are not applied to these.
+         */
+        switch (ir->vdwtype == evdwUSER ? eintmodNONE : ir->vdw_modifier)
         {
             case eintmodNONE:
             case eintmodPOTSHIFT:
@@ -979,11 +986,13 @@ void calc_verlet_buffer_size(const gmx_mtop_t *mtop, real boxvol,
     // Determine the 1st and 2nd derivative for the electostatics
     pot_derivatives_t elec = { 0, 0, 0 };
 
-    if (ir->coulombtype == eelCUT || EEL_RF(ir->coulombtype))
+    if (ir->coulombtype == eelCUT || EEL_RF(ir->coulombtype) ||
+        ir->coulombtype == eelUSER)
     {
         real eps_rf, k_rf;
 
-        if (ir->coulombtype == eelCUT)
+        /* User potentials are estimated as plain cut-off */
+        if (ir->coulombtype == eelCUT || ir->coulombtype == eelUSER)
         {
             eps_rf = 1;
             k_rf   = 0;
@@ -1024,7 +1033,7 @@ void calc_verlet_buffer_size(const gmx_mtop_t *mtop, real boxvol,
     }
 
     /* Determine the variance of the atomic displacement
-     * over nstlist-1 steps: kT_fac
+     * over list_lifetime steps: kT_fac
      * For inertial dynamics (not Brownian dynamics) the mass factor
      * is not included in kT_fac, it is added later.
      */
@@ -1035,7 +1044,7 @@ void calc_verlet_buffer_size(const gmx_mtop_t *mtop, real boxvol,
          * should be negligible (unless nstlist is extremely large, which
          * you wouldn't do anyhow).
          */
-        kT_fac = 2*BOLTZ*reference_temperature*(ir->nstlist-1)*ir->delta_t;
+        kT_fac = 2*BOLTZ*reference_temperature*list_lifetime*ir->delta_t;
         if (ir->bd_fric > 0)
         {
             /* This is directly sigma^2 of the displacement */
@@ -1066,7 +1075,7 @@ void calc_verlet_buffer_size(const gmx_mtop_t *mtop, real boxvol,
     }
     else
     {
-        kT_fac = BOLTZ*reference_temperature*gmx::square((ir->nstlist-1)*ir->delta_t);
+        kT_fac = BOLTZ*reference_temperature*gmx::square(list_lifetime*ir->delta_t);
     }
 
     mass_min = att[0].prop.mass;
@@ -1096,7 +1105,7 @@ void calc_verlet_buffer_size(const gmx_mtop_t *mtop, real boxvol,
         rl = std::max(ir->rvdw, ir->rcoulomb) + rb;
 
         /* Calculate the average energy drift at the last step
-         * of the nstlist steps at which the pair-list is used.
+         * of the list_lifetime + 1 steps at which the pair-list is used.
          */
         drift = energyDrift(att, natt, &mtop->ffparams,
                             kT_fac,
@@ -1116,7 +1125,7 @@ void calc_verlet_buffer_size(const gmx_mtop_t *mtop, real boxvol,
         drift *= nb_clust_frac_pairs_not_in_list_at_cutoff;
 
         /* Convert the drift to drift per unit time per atom */
-        drift /= ir->nstlist*ir->delta_t*mtop->natoms;
+        drift /= (list_lifetime + 1)*ir->delta_t*mtop->natoms;
 
         if (debug)
         {
@@ -1139,5 +1148,36 @@ void calc_verlet_buffer_size(const gmx_mtop_t *mtop, real boxvol,
 
     sfree(att);
 
-    *rlist = std::max(ir->rvdw, ir->rcoulomb) + ib1*resolution;
+    return std::max(ir->rvdw, ir->rcoulomb) + ib1*resolution;
+}
+
+void calc_verlet_buffer_size(const gmx_mtop_t *mtop, real boxvol,
+                             const t_inputrec *ir,
+                             real reference_temperature,
+                             const verletbuf_list_setup_t *list_setup,
+                             int *n_nonlin_vsite,
+                             real *rlist)
+{
+    *rlist = calc_verlet_buffer_size_lifetime(mtop, boxvol, ir, ir->nstlist - 1,
+                                              reference_temperature, list_setup,
+                                              n_nonlin_vsite);
+}
+
+void calc_verlet_buffer_size_pruned(const gmx_mtop_t *mtop, real boxvol,
+                                    const t_inputrec *ir,
+                                    int nstlistPrune,
+                                    real reference_temperature,
+                                    const verletbuf_list_setup_t *list_setup,
+                                    real *rlistOuter,
+                                    real *rlistInner)
+{
+    if (rlistOuter != nullptr)
+    {
+        *rlistOuter = calc_verlet_buffer_size_lifetime(mtop, boxvol, ir, ir->nstlist - 1,
+                                                       reference_temperature, list_setup,
+                                                       nullptr);
+    }
+    *rlistInner = calc_verlet_buffer_size_lifetime(mtop, boxvol, ir, nstlistPrune - 1,
+                                                   reference_temperature, list_setup,
+                                                   nullptr);
 }
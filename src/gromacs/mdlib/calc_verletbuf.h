@@ -91,6 +91,22 @@ void calc_verlet_buffer_size(const gmx_mtop_t *mtop, real boxvol,
                              int *n_nonlin_vsite,
                              real *rlist);
 
+/* Calculate the pair-list buffers for dynamic pruning of the pair list.
+ * The outer list, with cut-off *rlistOuter, is constructed every
+ * ir->nstlist steps. Every nstlistPrune steps the outer list is pruned
+ * to an inner list with cut-off *rlistInner, which is used for computing
+ * the interactions. Both buffers are set for a drift of ir->verletbuf_tol.
+ * rlistOuter can be nullptr when only the inner buffer is needed.
+ * The other parameters are as for calc_verlet_buffer_size.
+ */
+void calc_verlet_buffer_size_pruned(const gmx_mtop_t *mtop, real boxvol,
+                                    const t_inputrec *ir,
+                                    int nstlistPrune,
+                                    real reference_temperature,
+                                    const verletbuf_list_setup_t *list_setup,
+                                    real *rlistOuter,
+                                    real *rlistInner);
+
 #ifdef __cplusplus
 }
 #endif
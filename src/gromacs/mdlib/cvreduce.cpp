@@ -0,0 +1,239 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ *
+ * \brief Implements the fused global summation of collective-variable sums.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "cvreduce.h"
+
+#include "config.h"
+
+#include <vector>
+
+#include "gromacs/gmxlib/network.h"
+#include "gromacs/mdtypes/commrec.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxmpi.h"
+
+//! Use non-blocking collectives when the MPI library supports them
+#if GMX_LIB_MPI && defined MPI_VERSION && MPI_VERSION >= 3
+#define GMX_CVREDUCE_NONBLOCKING 1
+#else
+#define GMX_CVREDUCE_NONBLOCKING 0
+#endif
+
+/*! \brief A registered array, either of real or of double type */
+struct cvreduce_entry_t
+{
+    int     n;     /**< The number of elements */
+    real   *rdata; /**< Pointer to real data, or nullptr */
+    double *ddata; /**< Pointer to double data, or nullptr */
+};
+
+struct gmx_cvreduce_t
+{
+    std::vector<cvreduce_entry_t> entries;          /**< The registered arrays */
+    std::vector<double>           buf;              /**< Packed buffer for summation */
+    gmx_bool                      bStarted = FALSE; /**< Has the summation started? */
+#if GMX_CVREDUCE_NONBLOCKING
+    MPI_Request                   request;          /**< Request for the non-blocking sum */
+    gmx_bool                      bNonBlocking;     /**< Did we start a non-blocking sum? */
+#endif
+};
+
+gmx_cvreduce_t *init_cvreduce()
+{
+    return new gmx_cvreduce_t;
+}
+
+void done_cvreduce(gmx_cvreduce_t *cvr)
+{
+    delete cvr;
+}
+
+void cvreduce_add_real(gmx_cvreduce_t *cvr, int n, real *data)
+{
+    GMX_ASSERT(!cvr->bStarted, "Can not register sums during summation");
+
+    cvr->entries.push_back({ n, data, nullptr });
+}
+
+void cvreduce_add_double(gmx_cvreduce_t *cvr, int n, double *data)
+{
+    GMX_ASSERT(!cvr->bStarted, "Can not register sums during summation");
+
+    cvr->entries.push_back({ n, nullptr, data });
+}
+
+gmx_bool cvreduce_have_sums(const gmx_cvreduce_t *cvr)
+{
+    return !cvr->entries.empty();
+}
+
+/*! \brief Packs all registered arrays into the summation buffer, returns the size */
+static int cvreduce_pack(gmx_cvreduce_t *cvr)
+{
+    int n = 0;
+    for (const cvreduce_entry_t &e : cvr->entries)
+    {
+        n += e.n;
+    }
+    cvr->buf.resize(n);
+    double *buf = cvr->buf.data();
+    for (const cvreduce_entry_t &e : cvr->entries)
+    {
+        for (int i = 0; i < e.n; i++)
+        {
+            buf[i] = (e.rdata != nullptr ? e.rdata[i] : e.ddata[i]);
+        }
+        buf += e.n;
+    }
+
+    return n;
+}
+
+/*! \brief Unpacks the summation buffer into the registered arrays */
+static void cvreduce_unpack(const gmx_cvreduce_t *cvr)
+{
+    const double *buf = cvr->buf.data();
+    for (const cvreduce_entry_t &e : cvr->entries)
+    {
+        for (int i = 0; i < e.n; i++)
+        {
+            if (e.rdata != nullptr)
+            {
+                e.rdata[i] = buf[i];
+            }
+            else
+            {
+                e.ddata[i] = buf[i];
+            }
+        }
+        buf += e.n;
+    }
+}
+
+void cvreduce_start(gmx_cvreduce_t *cvr, const t_commrec *cr)
+{
+    GMX_ASSERT(!cvr->bStarted, "The summation has already been started");
+
+    cvr->bStarted = TRUE;
+
+    if (!PAR(cr) || cvr->entries.empty())
+    {
+        /* The local contributions are the sums */
+        return;
+    }
+
+    int n = cvreduce_pack(cvr);
+
+#if GMX_CVREDUCE_NONBLOCKING
+    /* The two-step intra/inter node summation is only done blocking */
+    cvr->bNonBlocking = !cr->nc.bUse;
+    if (cvr->bNonBlocking)
+    {
+        MPI_Iallreduce(MPI_IN_PLACE, cvr->buf.data(), n, MPI_DOUBLE, MPI_SUM,
+                       cr->mpi_comm_mygroup, &cvr->request);
+        return;
+    }
+#endif
+    gmx_sumd(n, cvr->buf.data(), cr);
+}
+
+void cvreduce_finish(gmx_cvreduce_t *cvr, const t_commrec *cr)
+{
+    GMX_ASSERT(cvr->bStarted, "The summation should have been started");
+
+    if (PAR(cr) && !cvr->entries.empty())
+    {
+#if GMX_CVREDUCE_NONBLOCKING
+        if (cvr->bNonBlocking)
+        {
+            MPI_Wait(&cvr->request, MPI_STATUS_IGNORE);
+        }
+#endif
+        cvreduce_unpack(cvr);
+    }
+
+    cvr->entries.clear();
+    cvr->bStarted = FALSE;
+}
+
+void cvreduce_start_sim(gmx_cvreduce_t *cvr, const gmx_multisim_t *ms)
+{
+    GMX_ASSERT(!cvr->bStarted, "The summation has already been started");
+
+    cvr->bStarted = TRUE;
+
+    if (ms == nullptr || cvr->entries.empty())
+    {
+        return;
+    }
+
+    int n = cvreduce_pack(cvr);
+
+#if GMX_CVREDUCE_NONBLOCKING
+    MPI_Iallreduce(MPI_IN_PLACE, cvr->buf.data(), n, MPI_DOUBLE, MPI_SUM,
+                   ms->mpi_comm_masters, &cvr->request);
+#else
+    gmx_sumd_sim(n, cvr->buf.data(), ms);
+#endif
+}
+
+void cvreduce_finish_sim(gmx_cvreduce_t *cvr, const gmx_multisim_t *ms)
+{
+    GMX_ASSERT(cvr->bStarted, "The summation should have been started");
+
+    if (ms != nullptr && !cvr->entries.empty())
+    {
+#if GMX_CVREDUCE_NONBLOCKING
+        MPI_Wait(&cvr->request, MPI_STATUS_IGNORE);
+#endif
+        cvreduce_unpack(cvr);
+    }
+
+    cvr->entries.clear();
+    cvr->bStarted = FALSE;
+}
+
+void cvreduce_sum(gmx_cvreduce_t *cvr, const t_commrec *cr)
+{
+    cvreduce_start(cvr, cr);
+    cvreduce_finish(cvr, cr);
+}
@@ -0,0 +1,118 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ *
+ * \brief Declares a buffer for fusing the global sums of collective-variable modules.
+ *
+ * Modules such as pulling, enforced rotation, essential dynamics and
+ * computational electrophysiology need global sums of local contributions,
+ * e.g. of assembled group positions or of centers of mass, every step.
+ * Instead of each module, or each group within a module, calling gmx_sum(),
+ * the modules register their arrays of partial sums with a gmx_cvreduce_t
+ * and all registered arrays are summed with a single collective call.
+ * With an MPI library that supports MPI-3 the summation is non-blocking,
+ * so other work can be done between cvreduce_start() and cvreduce_finish().
+ *
+ * The NMR restraints use the same mechanism for their ensemble averages
+ * over the simulations of a multi-simulation, see cvreduce_start_sim().
+ *
+ * The registered arrays are summed in place. They should not be accessed
+ * between cvreduce_start() and cvreduce_finish().
+ *
+ * \inlibraryapi
+ * \ingroup module_mdlib
+ */
+
+#ifndef GMX_MDLIB_CVREDUCE_H
+#define GMX_MDLIB_CVREDUCE_H
+
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/real.h"
+
+struct gmx_multisim_t;
+struct t_commrec;
+
+/*! \brief Buffer for the fused global summation of registered arrays */
+struct gmx_cvreduce_t;
+
+/*! \brief Returns a new, empty, reduction buffer */
+gmx_cvreduce_t *init_cvreduce();
+
+/*! \brief Frees a reduction buffer */
+void done_cvreduce(gmx_cvreduce_t *cvr);
+
+/*! \brief Registers \p n reals at \p data for summation over the ranks
+ *
+ * The values are summed in double precision.
+ */
+void cvreduce_add_real(gmx_cvreduce_t *cvr, int n, real *data);
+
+/*! \brief Registers \p n doubles at \p data for summation over the ranks */
+void cvreduce_add_double(gmx_cvreduce_t *cvr, int n, double *data);
+
+/*! \brief Returns whether arrays have been registered and not yet summed */
+gmx_bool cvreduce_have_sums(const gmx_cvreduce_t *cvr);
+
+/*! \brief Starts the summation of all registered arrays over the PP ranks
+ *
+ * With a single rank nothing needs to be done. Without non-blocking
+ * collectives the sum is complete on return.
+ */
+void cvreduce_start(gmx_cvreduce_t *cvr, const t_commrec *cr);
+
+/*! \brief Completes the summation and stores the sums in the registered arrays
+ *
+ * After this call the registration list is empty.
+ */
+void cvreduce_finish(gmx_cvreduce_t *cvr, const t_commrec *cr);
+
+/*! \brief Starts the summation of all registered arrays over the simulations of \p ms
+ *
+ * Sums over the master ranks of a multi-simulation, so only the master
+ * rank of each simulation should register arrays. Does nothing with
+ * \p ms = nullptr or when no arrays are registered.
+ */
+void cvreduce_start_sim(gmx_cvreduce_t *cvr, const gmx_multisim_t *ms);
+
+/*! \brief Completes the summation started with cvreduce_start_sim()
+ *
+ * After this call the registration list is empty.
+ */
+void cvreduce_finish_sim(gmx_cvreduce_t *cvr, const gmx_multisim_t *ms);
+
+/*! \brief Sums all registered arrays over the PP ranks, blocking */
+void cvreduce_sum(gmx_cvreduce_t *cvr, const t_commrec *cr);
+
+#endif
@@ -42,12 +42,15 @@
 #include <math.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include "gromacs/math/units.h"
 #include "gromacs/math/utilities.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/topology/ifunc.h"
 #include "gromacs/utility/cstringutil.h"
 #include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/gmxassert.h"
 #include "gromacs/utility/smalloc.h"
 
 t_ebin *mk_ebin(void)
@@ -168,6 +171,48 @@ void add_ebin(t_ebin *eb, int index, int nener, real ener[], gmx_bool bSum)
     }
 }
 
+void add_ebin_block(t_ebin *eb, int index, int nener,
+                    const double esum[], const double esum2[], int nstep)
+{
+    int       i;
+    double    m, n, m2, diff;
+    t_energy *eg, *egs;
+
+    if ((index+nener > eb->nener) || (index < 0))
+    {
+        gmx_fatal(FARGS, "%s-%d: Energies out of range: index=%d nener=%d maxener=%d",
+                  __FILE__, __LINE__, index, nener, eb->nener);
+    }
+    GMX_ASSERT(nstep > 0 && nstep <= eb->nsum, "The steps of the block should have been counted");
+
+    eg  = &(eb->e[index]);
+    egs = &(eb->e_sim[index]);
+
+    /* The number of steps in the sums before the block */
+    m = eb->nsum - nstep;
+    n = nstep;
+
+    for (i = 0; (i < nener); i++)
+    {
+        /* Sum of squared deviations within the block */
+        m2 = std::max(esum2[i] - esum[i]*esum[i]/n, 0.0);
+
+        if (m == 0)
+        {
+            eg[i].eav   = m2;
+            eg[i].esum  = esum[i];
+        }
+        else
+        {
+            /* Merge the deviations of the two sets of steps */
+            diff         = eg[i].esum*n - esum[i]*m;
+            eg[i].eav   += m2 + diff*diff/(m*n*(m + n));
+            eg[i].esum  += esum[i];
+        }
+        egs[i].esum += esum[i];
+    }
+}
+
 void ebin_increase_count(t_ebin *eb, gmx_bool bSum)
 {
     eb->nsteps++;
@@ -78,6 +78,14 @@ void add_ebin(t_ebin *eb, int index, int nener, real ener[], gmx_bool bSum);
  * and sum of squares.
  */
 
+void add_ebin_block(t_ebin *eb, int index, int nener,
+                    const double esum[], const double esum2[], int nstep);
+/* Add the sums esum over the nstep most recent steps, which have already
+ * been counted with ebin_increase_count, to the sums of the energy bin
+ * at position index. esum2 are the sums of the squares of the energies.
+ * Should be called before add_ebin for the current step.
+ */
+
 void ebin_increase_count(t_ebin *eb, gmx_bool bSum);
 /* Increase the counters for the sums.
  * This routine should be called AFTER all add_ebin calls for this step.
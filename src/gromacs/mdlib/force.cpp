@@ -660,7 +660,11 @@ void init_enerdata(int ngener, int n_lambda, gmx_enerdata_t *enerd)
     {
         snew(enerd->grpp.ener[i], n2);
         snew(enerd->foreign_grpp.ener[i], n2);
+        snew(enerd->grpp_sum.esum[i], n2);
+        snew(enerd->grpp_sum.esum2[i], n2);
     }
+    enerd->grpp_sum.nstep     = 0;
+    enerd->grpp_sum.bDeferred = FALSE;
 
     if (n_lambda)
     {
@@ -685,6 +689,8 @@ void destroy_enerdata(gmx_enerdata_t *enerd)
     for (i = 0; (i < egNR); i++)
     {
         sfree(enerd->foreign_grpp.ener[i]);
+        sfree(enerd->grpp_sum.esum[i]);
+        sfree(enerd->grpp_sum.esum2[i]);
     }
 
     if (enerd->n_lambda)
@@ -890,3 +896,32 @@ void reset_enerdata(gmx_enerdata_t *enerd)
     /* reset foreign energy data - separate function since we also call it elsewhere */
     reset_foreign_enerdata(enerd);
 }
+
+void accumulate_grpp_sum(gmx_enerdata_t *enerd)
+{
+    gmx_grppairener_sum_t *grpp_sum = &enerd->grpp_sum;
+    int                    i, j;
+    double                 e;
+
+    if (grpp_sum->nstep == 0)
+    {
+        for (i = 0; (i < egNR); i++)
+        {
+            for (j = 0; (j < enerd->grpp.nener); j++)
+            {
+                grpp_sum->esum[i][j]  = 0;
+                grpp_sum->esum2[i][j] = 0;
+            }
+        }
+    }
+    for (i = 0; (i < egNR); i++)
+    {
+        for (j = 0; (j < enerd->grpp.nener); j++)
+        {
+            e                      = enerd->grpp.ener[i][j];
+            grpp_sum->esum[i][j]  += e;
+            grpp_sum->esum2[i][j] += e*e;
+        }
+    }
+    grpp_sum->nstep++;
+}
@@ -147,6 +147,9 @@ void reset_foreign_enerdata(gmx_enerdata_t *enerd);
 void reset_enerdata(gmx_enerdata_t *enerd);
 /* Resets the energy data */
 
+void accumulate_grpp_sum(gmx_enerdata_t *enerd);
+/* Adds the local energy group pair energies of this step to enerd->grpp_sum */
+
 void sum_epot(gmx_grppairener_t *grpp, real *epot);
 /* Locally sum the non-bonded potential energy terms */
 
@@ -64,6 +64,7 @@
 #include "gromacs/math/units.h"
 #include "gromacs/math/utilities.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/cvreduce.h"
 #include "gromacs/mdlib/force.h"
 #include "gromacs/mdlib/forcerec-threading.h"
 #include "gromacs/mdlib/gmx_omp_nthreads.h"
@@ -1580,6 +1581,11 @@ gmx_bool nbnxn_gpu_acceleration_supported(const gmx::MDLogger &mdlog,
         GMX_LOG(mdlog.warning).asParagraph().appendText("Rerun with energy groups is not implemented for GPUs, falling back to the CPU");
         return FALSE;
     }
+    if (ir->coulombtype == eelUSER)
+    {
+        GMX_LOG(mdlog.warning).asParagraph().appendText("User tables are not supported with GPUs, falling back to the CPU");
+        return FALSE;
+    }
 
     return TRUE;
 }
@@ -1595,6 +1601,14 @@ gmx_bool nbnxn_simd_supported(const gmx::MDLogger &mdlog,
         GMX_LOG(mdlog.warning).asParagraph().appendText("LJ-PME with Lorentz-Berthelot is not supported with SIMD kernels, falling back to plain C kernels");
         return FALSE;
     }
+#ifndef GMX_NBNXN_SIMD_4XN
+    if (ir->coulombtype == eelUSER)
+    {
+        /* User tables only have a SIMD 4xN kernel */
+        GMX_LOG(mdlog.warning).asParagraph().appendText("User tables are only supported with SIMD 4xN kernels, falling back to plain C kernels");
+        return FALSE;
+    }
+#endif
 
     return TRUE;
 }
@@ -1664,6 +1678,13 @@ static void pick_nbnxn_kernel_cpu(const t_inputrec gmx_unused *ir,
             gmx_fatal(FARGS, "SIMD 2x(N+N) kernels requested, but GROMACS has been compiled without support for these kernels");
 #endif
         }
+#ifdef GMX_NBNXN_SIMD_4XN
+        if (ir->coulombtype == eelUSER)
+        {
+            /* User tables only have a SIMD 4xN kernel */
+            *kernel_type = nbnxnk4xN_SIMD_4xN;
+        }
+#endif
 
         /* Analytical Ewald exclusion correction is only an option in
          * the SIMD kernel.
@@ -2128,6 +2149,13 @@ static void init_nb_verlet(FILE                *fp,
     nbv->nbs             = nullptr;
     nbv->min_ci_balanced = 0;
 
+    /* Dynamic pruning is set up later, when the buffers are known */
+    nbv->bDynamicPruning = FALSE;
+    nbv->nstlistPrune    = 0;
+    nbv->rlistInner      = 0;
+    nbv->searchStep      = 0;
+    nbv->userTable       = nullptr;
+
     nbv->ngrp = (DOMAINDECOMP(cr) ? 2 : 1);
     for (i = 0; i < nbv->ngrp; i++)
     {
@@ -3149,6 +3177,9 @@ void init_forcerec(FILE                *fp,
     fr->bQMMM      = ir->bQMMM;
     fr->qr         = mk_QMMMrec();
 
+    fr->cvreduce       = init_cvreduce();
+    fr->ensemblereduce = init_cvreduce();
+
     /* Set all the static charge group info */
     fr->cginfo_mb = init_cginfo_mb(fp, mtop, fr, bNoSolvOpt,
                                    &bFEP_NonBonded,
@@ -3210,6 +3241,22 @@ void init_forcerec(FILE                *fp,
         }
 
         init_nb_verlet(fp, mdlog, &fr->nbv, bFEP_NonBonded, ir, fr, cr, nbpu_opt);
+
+        if (ir->coulombtype == eelUSER)
+        {
+            /* grompp checked that vdwtype is also User */
+            for (int i = 0; i < fr->nbv->ngrp; i++)
+            {
+                if (fr->nbv->grp[i].kernel_type == nbnxnk8x8x8_GPU ||
+                    fr->nbv->grp[i].kernel_type == nbnxnk8x8x8_PlainC)
+                {
+                    gmx_fatal(FARGS, "User tables with the Verlet cut-off scheme are only supported with CPU non-bonded kernels");
+                }
+            }
+            fr->nbv->userTable = makeUserSplineTable(fp, tabfn,
+                                                     std::max(ir->rcoulomb, ir->rvdw),
+                                                     rtab);
+        }
     }
 
     if (ir->eDispCorr != edispcNO)
@@ -38,15 +38,46 @@
 
 #include "groupcoord.h"
 
+#include <cstdlib>
+
 #include "gromacs/domdec/ga2la.h"
 #include "gromacs/gmxlib/network.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/cvreduce.h"
 #include "gromacs/mdtypes/commrec.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/utility/gmxmpi.h"
 #include "gromacs/utility/smalloc.h"
 
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 
+/*! \brief Groups with fewer atoms than this are collected by summation
+ *
+ * For small groups the communication is latency bound and summation,
+ * which can be fused with other global sums, is faster.
+ */
+static const int c_groupGatherMinAtoms = 1000;
+
+/* Data for collecting the positions of a group with all-gather communication */
+struct gmx_group_gather_t
+{
+    int       nr;           /* Total number of atoms in the group                */
+    int       nranks;       /* Number of ranks in the communicator               */
+#if GMX_MPI
+    MPI_Comm  mpi_comm;     /* The communicator to gather over                   */
+#endif
+    gmx_bool  bLayoutValid; /* Are count, displ and coll_ind up to date?         */
+    int      *count;        /* Number of reals received from each rank           */
+    int      *displ;        /* Displacement in reals of the data of each rank    */
+    int      *nr_loc_rank;  /* Number of group atoms on each rank                */
+    int      *scount;       /* Send counts, only used with thread-MPI            */
+    int      *sdispl;       /* Send displacements, only used with thread-MPI     */
+    int      *coll_ind;     /* Collective index of each received position [0..nr] */
+    rvec     *xsend;        /* Local positions to send                           */
+    int       nalloc_send;  /* Allocation size of xsend                          */
+    rvec     *xrecv;        /* Received positions [0..nr]                        */
+};
+
 
 
 /* Select the indices of the group's atoms which are local and store them in
@@ -101,29 +132,231 @@ void dd_make_local_group_indices(gmx_ga2la_t     *ga2la,
 }
 
 
-static void get_shifts_group(
-        int     npbcdim,
-        matrix  box,
-        rvec   *xcoll,     /* IN:  Collective set of positions [0..nr] */
-        int     nr,        /* IN:  Total number of atoms in the group */
-        rvec   *xcoll_old, /* IN:  Positions from the last time step [0...nr] */
-        ivec   *shifts)    /* OUT: Shifts for xcoll */
+gmx_group_gather_t *init_group_gather(const t_commrec *cr, int nr)
 {
-    int  i, m, d;
-    rvec dx;
+    gmx_group_gather_t *gg;
+    int                 nmin;
+    char               *env;
 
+    if (!PAR(cr))
+    {
+        return nullptr;
+    }
 
-    /* Get the shifts such that each atom is within closest
-     * distance to its position at the last NS time step after shifting.
-     * If we start with a whole group, and always keep track of
-     * shift changes, the group will stay whole this way */
-    for (i = 0; i < nr; i++)
+    nmin = c_groupGatherMinAtoms;
+    if ((env = getenv("GMX_GROUP_GATHER_NATOMS")) != nullptr)
+    {
+        nmin = strtol(env, nullptr, 10);
+    }
+    if (nr < nmin)
+    {
+        return nullptr;
+    }
+
+    snew(gg, 1);
+    gg->nr           = nr;
+    gg->bLayoutValid = FALSE;
+#if GMX_MPI
+    gg->mpi_comm = cr->mpi_comm_mygroup;
+    MPI_Comm_size(gg->mpi_comm, &gg->nranks);
+#else
+    gg->nranks = 1;
+#endif
+    snew(gg->count, gg->nranks);
+    snew(gg->displ, gg->nranks);
+    snew(gg->nr_loc_rank, gg->nranks);
+    snew(gg->scount, gg->nranks);
+    snew(gg->sdispl, gg->nranks);
+    snew(gg->coll_ind, nr);
+    gg->nalloc_send = 1;
+    snew(gg->xsend, gg->nalloc_send);
+    snew(gg->xrecv, nr);
+
+    return gg;
+}
+
+
+void done_group_gather(gmx_group_gather_t *gg)
+{
+    if (gg == nullptr)
+    {
+        return;
+    }
+    sfree(gg->count);
+    sfree(gg->displ);
+    sfree(gg->nr_loc_rank);
+    sfree(gg->scount);
+    sfree(gg->sdispl);
+    sfree(gg->coll_ind);
+    sfree(gg->xsend);
+    sfree(gg->xrecv);
+    sfree(gg);
+}
+
+
+void group_gather_local_changed(gmx_group_gather_t *gg)
+{
+    if (gg != nullptr)
+    {
+        gg->bLayoutValid = FALSE;
+    }
+}
+
+
+#if GMX_MPI
+/* Gather sendcount elements of type from each rank into recvbuf.
+ * Thread-MPI does not provide MPI_Allgatherv, there we use
+ * MPI_Alltoallv with the same send buffer for all ranks. */
+static void group_gather_allgatherv(gmx_group_gather_t *gg,
+                                    void *sendbuf, int sendcount,
+                                    void *recvbuf, int *recvcount, int *displ,
+                                    MPI_Datatype type)
+{
+#if GMX_LIB_MPI
+    MPI_Allgatherv(sendbuf, sendcount, type,
+                   recvbuf, recvcount, displ, type, gg->mpi_comm);
+#else
+    for (int r = 0; r < gg->nranks; r++)
+    {
+        gg->scount[r] = sendcount;
+        gg->sdispl[r] = 0;
+    }
+    MPI_Alltoallv(sendbuf, gg->scount, gg->sdispl, type,
+                  recvbuf, recvcount, displ, type, gg->mpi_comm);
+#endif
+}
+#endif
+
+
+/* Exchange the number of local atoms and their collective indices,
+ * which only change after domain re-decomposition */
+static void group_gather_update_layout(gmx_group_gather_t *gg,
+                                       int nr_loc, int *coll_ind)
+{
+#if GMX_MPI
+    int r;
+
+    for (r = 0; r < gg->nranks; r++)
+    {
+        gg->count[r] = 1;
+        gg->displ[r] = r;
+    }
+    group_gather_allgatherv(gg, &nr_loc, 1, gg->nr_loc_rank, gg->count, gg->displ, MPI_INT);
+
+    for (r = 0; r < gg->nranks; r++)
+    {
+        gg->count[r] = gg->nr_loc_rank[r];
+    }
+    gg->displ[0] = 0;
+    for (r = 1; r < gg->nranks; r++)
+    {
+        gg->displ[r] = gg->displ[r - 1] + gg->count[r - 1];
+    }
+    group_gather_allgatherv(gg, coll_ind, nr_loc, gg->coll_ind, gg->count, gg->displ, MPI_INT);
+
+    /* From now on we communicate positions, 3 reals per atom */
+    for (r = 0; r < gg->nranks; r++)
+    {
+        gg->count[r] *= DIM;
+        gg->displ[r] *= DIM;
+    }
+#else
+    GMX_UNUSED_VALUE(nr_loc);
+    GMX_UNUSED_VALUE(coll_ind);
+#endif
+
+    gg->bLayoutValid = TRUE;
+}
+
+
+/* Collect the positions of all atoms of the group in xcoll by
+ * only communicating the local positions of each rank */
+static void group_gather_positions(gmx_group_gather_t *gg,
+                                   rvec *xcoll, rvec *x_loc,
+                                   const int nr_loc, int *anrs_loc, int *coll_ind)
+{
+    int i;
+
+    if (!gg->bLayoutValid)
+    {
+        group_gather_update_layout(gg, nr_loc, coll_ind);
+    }
+
+    if (nr_loc > gg->nalloc_send)
+    {
+        gg->nalloc_send = over_alloc_dd(nr_loc);
+        srenew(gg->xsend, gg->nalloc_send);
+    }
+    for (i = 0; i < nr_loc; i++)
+    {
+        copy_rvec(x_loc[anrs_loc[i]], gg->xsend[i]);
+    }
+
+#if GMX_MPI
+    group_gather_allgatherv(gg, gg->xsend[0], nr_loc*DIM, gg->xrecv[0],
+                            gg->count, gg->displ, GMX_MPI_REAL);
+#endif
+
+    /* Put the positions in the collective order */
+    for (i = 0; i < gg->nr; i++)
+    {
+        copy_rvec(gg->xrecv[i], xcoll[gg->coll_ind[i]]);
+    }
+}
+
+
+/* Shift the position x by the box vectors times the shift is */
+static inline void shift_position(matrix box, gmx_bool bTric, rvec x, const ivec is)
+{
+    int tx, ty, tz;
+
+    tx = is[XX];
+    ty = is[YY];
+    tz = is[ZZ];
+
+    if (bTric)
+    {
+        x[XX] = x[XX]+tx*box[XX][XX]+ty*box[YY][XX]+tz*box[ZZ][XX];
+        x[YY] = x[YY]+ty*box[YY][YY]+tz*box[ZZ][YY];
+        x[ZZ] = x[ZZ]+tz*box[ZZ][ZZ];
+    }
+    else
     {
-        clear_ivec(shifts[i]);
+        x[XX] = x[XX]+tx*box[XX][XX];
+        x[YY] = x[YY]+ty*box[YY][YY];
+        x[ZZ] = x[ZZ]+tz*box[ZZ][ZZ];
     }
+}
+
+
+/* Apply the saved shifts to xcoll, get the extra shifts such that each atom
+ * is within closest distance to its position at the last NS time step,
+ * apply those and add them to the saved shifts. Finally store the shifted
+ * positions in xcoll_old. This is all done in a single pass over the group.
+ * If we start with a whole group, and always keep track of shift changes,
+ * the group will stay whole this way. */
+static void update_shifts_group(
+        int     npbcdim,
+        matrix  box,
+        rvec   *xcoll,        /* IN+OUT: Collective set of positions [0..nr] */
+        int     nr,           /* IN:  Total number of atoms in the group */
+        rvec   *xcoll_old,    /* IN+OUT: Positions from the last NS step [0...nr] */
+        ivec   *shifts,       /* IN+OUT: Shifts for xcoll */
+        ivec   *extra_shifts) /* OUT: Shifts since the last NS step */
+{
+    int      i, m, d;
+    rvec     dx;
+    gmx_bool bTric;
+
+
+    bTric = TRICLINIC(box);
 
     for (i = 0; i < nr; i++)
     {
+        shift_position(box, bTric, xcoll[i], shifts[i]);
+
+        clear_ivec(extra_shifts[i]);
+
         /* The distance this atom moved since the last time step */
         /* If this is more than just a bit, it has changed its home pbc box */
         rvec_sub(xcoll[i], xcoll_old[i], dx);
@@ -136,7 +369,7 @@ static void get_shifts_group(
                 {
                     dx[d] += box[m][d];
                 }
-                shifts[i][m]++;
+                extra_shifts[i][m]++;
             }
             while (dx[m] >= 0.5*box[m][m])
             {
@@ -144,9 +377,19 @@ static void get_shifts_group(
                 {
                     dx[d] -= box[m][d];
                 }
-                shifts[i][m]--;
+                extra_shifts[i][m]--;
             }
         }
+
+        /* Shift with the additional shifts such that the atom is at closest
+         * distance to its old position and add them for the next time step */
+        shift_position(box, bTric, xcoll[i], extra_shifts[i]);
+        shifts[i][XX] += extra_shifts[i][XX];
+        shifts[i][YY] += extra_shifts[i][YY];
+        shifts[i][ZZ] += extra_shifts[i][ZZ];
+
+        /* Store the correctly-shifted position for comparison in the next NS time step */
+        copy_rvec(xcoll[i], xcoll_old[i]);
     }
 }
 
@@ -190,6 +433,26 @@ static void shift_positions_group(
 }
 
 
+/* Put the local positions that this node has into the right place of
+ * the collective array, which is zeroed out first.
+ * Note that in the serial case, coll_ind[i] = i */
+static void copy_local_group_positions(
+        rvec          *xcoll,
+        rvec          *x_loc,
+        const int      nr,
+        const int      nr_loc,
+        int           *anrs_loc,
+        int           *coll_ind)
+{
+    clear_rvecs(nr, xcoll);
+
+    for (int i = 0; i < nr_loc; i++)
+    {
+        copy_rvec(x_loc[anrs_loc[i]], xcoll[coll_ind[i]]);
+    }
+}
+
+
 /* Assemble the positions of the group such that every node has all of them.
  * The atom indices are retrieved from anrs_loc[0..nr_loc]
  * Note that coll_ind[i] = i is needed in the serial case */
@@ -208,24 +471,56 @@ extern void communicate_group_positions(
                                         used to make group whole */
         matrix         box)          /* (optional) The box */
 {
-    int i;
-
-
-    /* Zero out the groups' global position array */
-    clear_rvecs(nr, xcoll);
-
-    /* Put the local positions that this node has into the right place of
-     * the collective array. Note that in the serial case, coll_ind[i] = i */
-    for (i = 0; i < nr_loc; i++)
-    {
-        copy_rvec(x_loc[anrs_loc[i]], xcoll[coll_ind[i]]);
-    }
+    copy_local_group_positions(xcoll, x_loc, nr, nr_loc, anrs_loc, coll_ind);
 
     if (PAR(cr))
     {
         /* Add the arrays from all nodes together */
         gmx_sum(nr*3, xcoll[0], cr);
     }
+
+    communicate_group_positions_finish(xcoll, shifts, extra_shifts, bNS,
+                                       nr, xcoll_old, box);
+}
+
+
+/* Put the local positions in the collective array and register it
+ * for summation over the nodes, or gather the positions directly
+ * when gg is set */
+extern void communicate_group_positions_start(
+        gmx_cvreduce_t     *cvr,
+        gmx_group_gather_t *gg,
+        rvec               *xcoll,
+        rvec               *x_loc,
+        const int           nr,
+        const int           nr_loc,
+        int                *anrs_loc,
+        int                *coll_ind)
+{
+    if (gg != nullptr)
+    {
+        group_gather_positions(gg, xcoll, x_loc, nr_loc, anrs_loc, coll_ind);
+
+        return;
+    }
+
+    copy_local_group_positions(xcoll, x_loc, nr, nr_loc, anrs_loc, coll_ind);
+
+    cvreduce_add_real(cvr, nr*3, xcoll[0]);
+}
+
+
+/* Make the group whole, after the local positions of all nodes
+ * have been summed into xcoll */
+extern void communicate_group_positions_finish(
+        rvec          *xcoll,
+        ivec          *shifts,
+        ivec          *extra_shifts,
+        const gmx_bool bNS,
+        const int      nr,
+        rvec          *xcoll_old,
+        matrix         box)
+{
     /* Now we have all the positions of the group in the xcoll array present on all
      * nodes.
      *
@@ -236,33 +531,17 @@ extern void communicate_group_positions(
     {
         /* To make the group whole, start with a whole group and each
          * step move the assembled positions at closest distance to the positions
-         * from the last step. First shift the positions with the saved shift
-         * vectors (these are 0 when this routine is called for the first time!) */
-        shift_positions_group(box, xcoll, shifts, nr);
-
-        /* Now check if some shifts changed since the last step.
-         * This only needs to be done when the shifts are expected to have changed,
-         * i.e. after neighbor searching */
+         * from the last step. Shift the positions with the saved shift
+         * vectors (these are 0 when this routine is called for the first time!).
+         * The shifts only need to be updated when they are expected to have
+         * changed, i.e. after neighbor searching. */
         if (bNS)
         {
-            get_shifts_group(3, box, xcoll, nr, xcoll_old, extra_shifts);
-
-            /* Shift with the additional shifts such that we get a whole group now */
-            shift_positions_group(box, xcoll, extra_shifts, nr);
-
-            /* Add the shift vectors together for the next time step */
-            for (i = 0; i < nr; i++)
-            {
-                shifts[i][XX] += extra_shifts[i][XX];
-                shifts[i][YY] += extra_shifts[i][YY];
-                shifts[i][ZZ] += extra_shifts[i][ZZ];
-            }
-
-            /* Store current correctly-shifted positions for comparison in the next NS time step */
-            for (i = 0; i < nr; i++)
-            {
-                copy_rvec(xcoll[i], xcoll_old[i]);
-            }
+            update_shifts_group(3, box, xcoll, nr, xcoll_old, shifts, extra_shifts);
+        }
+        else
+        {
+            shift_positions_group(box, xcoll, shifts, nr);
         }
     }
 }
@@ -330,6 +609,23 @@ extern void get_center(rvec x[], real weight[], const int nr, rvec rcenter)
 }
 
 
+/* Store the local weighted sum of positions in buf[0..2]
+ * and the sum of weights in buf[3] */
+static void get_center_comm_local_sums(
+        rvec       x_loc[],
+        real       weight_loc[],
+        int        nr_loc,
+        double     buf[4])
+{
+    dvec dsumvec;
+
+    buf[3] = get_sum_of_positions(x_loc, weight_loc, nr_loc, dsumvec);
+    buf[0] = dsumvec[XX];
+    buf[1] = dsumvec[YY];
+    buf[2] = dsumvec[ZZ];
+}
+
+
 /* Get the center from local positions that already have the correct
  * PBC representation */
 extern void get_center_comm(
@@ -340,44 +636,60 @@ extern void get_center_comm(
         int        nr_group,     /* Total number of atoms of the group */
         rvec       center)       /* Weighted center */
 {
-    double weight_sum, denom;
-    dvec   dsumvec;
     double buf[4];
 
 
-    weight_sum = get_sum_of_positions(x_loc, weight_loc, nr_loc, dsumvec);
+    get_center_comm_local_sums(x_loc, weight_loc, nr_loc, buf);
 
     /* Add the local contributions from all nodes. Put the sum vector and the
      * weight in a buffer array so that we get along with a single communication
      * call. */
     if (PAR(cr))
     {
-        buf[0] = dsumvec[XX];
-        buf[1] = dsumvec[YY];
-        buf[2] = dsumvec[ZZ];
-        buf[3] = weight_sum;
-
         /* Communicate buffer */
         gmx_sumd(4, buf, cr);
-
-        dsumvec[XX] = buf[0];
-        dsumvec[YY] = buf[1];
-        dsumvec[ZZ] = buf[2];
-        weight_sum  = buf[3];
     }
 
-    if (weight_loc != nullptr)
+    get_center_comm_finish(buf, weight_loc != nullptr, nr_group, center);
+}
+
+
+/* Compute the local sums and register them for summation over the nodes */
+extern void get_center_comm_start(
+        gmx_cvreduce_t *cvr,
+        rvec            x_loc[],
+        real            weight_loc[],
+        int             nr_loc,
+        double          buf[4])
+{
+    get_center_comm_local_sums(x_loc, weight_loc, nr_loc, buf);
+
+    cvreduce_add_double(cvr, 4, buf);
+}
+
+
+/* Compute the center from the sums over all nodes in buf */
+extern void get_center_comm_finish(
+        const double buf[4],
+        gmx_bool     bWeighted,
+        int          nr_group,
+        rvec         center)
+{
+    double denom;
+
+
+    if (bWeighted)
     {
-        denom = 1.0/weight_sum; /* Divide by the sum of weight to get center of mass e.g. */
+        denom = 1.0/buf[3]; /* Divide by the sum of weight to get center of mass e.g. */
     }
     else
     {
         denom = 1.0/nr_group;   /* Divide by the number of atoms to get the geometrical center */
 
     }
-    center[XX] = dsumvec[XX]*denom;
-    center[YY] = dsumvec[YY]*denom;
-    center[ZZ] = dsumvec[ZZ]*denom;
+    center[XX] = buf[0]*denom;
+    center[YY] = buf[1]*denom;
+    center[ZZ] = buf[2]*denom;
 }
 
 
@@ -52,7 +52,9 @@
 #include "gromacs/math/vectypes.h"
 #include "gromacs/utility/basedefinitions.h"
 
+struct gmx_cvreduce_t;
 struct gmx_ga2la_t;
+struct gmx_group_gather_t;
 struct t_commrec;
 
 #ifdef __cplusplus
@@ -133,6 +135,64 @@ extern void communicate_group_positions(t_commrec *cr, rvec *xcoll, ivec *shifts
                                         int *anrs_loc, int *coll_ind, rvec *xcoll_old,
                                         matrix box);
 
+/*! \brief Sets up collecting the positions of a large group by all-gather.
+ *
+ * Summing the collective array over the nodes communicates nr*3 reals,
+ * while each atom is present on one node only. For large groups it is
+ * cheaper to only communicate the local positions. Their collective indices
+ * only change after domain re-decomposition and are communicated then.
+ *
+ * \param[in] cr  Pointer to MPI communication data.
+ * \param[in] nr  Total number of atoms in the group.
+ * \returns nullptr when the group should be collected by summation, i.e.
+ *          when running serially or with fewer atoms than the threshold set
+ *          by the environment variable GMX_GROUP_GATHER_NATOMS (default 1000).
+ */
+extern gmx_group_gather_t *init_group_gather(const t_commrec *cr, int nr);
+
+/*! \brief Frees the all-gather data, \p gg can be nullptr. */
+extern void done_group_gather(gmx_group_gather_t *gg);
+
+/*! \brief Signals that the local atoms of the group have changed.
+ *
+ * Should be called on all nodes after dd_make_local_group_indices(),
+ * \p gg can be nullptr.
+ */
+extern void group_gather_local_changed(gmx_group_gather_t *gg);
+
+/*! \brief Put the local positions in the collective array and register it for summation.
+ *
+ * This is the first half of communicate_group_positions(), which allows the
+ * summation over the nodes to be fused with that of other groups or modules.
+ * After cvreduce_finish() has been called on \p cvr,
+ * communicate_group_positions_finish() should be called.
+ * When \p gg is not nullptr, the positions are instead collected
+ * directly with all-gather communication and nothing is registered with \p cvr.
+ *
+ * \param[in]     cvr          The buffer for the fused summation.
+ * \param[in]     gg           All-gather data from init_group_gather(), can be nullptr.
+ * \param[out]    xcoll        Collective array of positions.
+ * \param[in]     x_loc        Pointer to the local atom positions this node has.
+ * \param[in]     nr           Total number of atoms in the group.
+ * \param[in]     nr_loc       Number of group atoms on the local node.
+ * \param[in]     anrs_loc     Array of the local atom indices.
+ * \param[in]     coll_ind     The collective index of each local atom.
+ */
+extern void communicate_group_positions_start(gmx_cvreduce_t *cvr, gmx_group_gather_t *gg,
+                                              rvec *xcoll, rvec *x_loc,
+                                              const int nr, const int nr_loc,
+                                              int *anrs_loc, int *coll_ind);
+
+/*! \brief Make the summed collective positions whole.
+ *
+ * This is the second half of communicate_group_positions(), see there
+ * for the description of the parameters.
+ */
+extern void communicate_group_positions_finish(rvec *xcoll, ivec *shifts,
+                                               ivec *extra_shifts, const gmx_bool bNS,
+                                               const int nr, rvec *xcoll_old,
+                                               matrix box);
+
 /*! \brief Calculates the center of the positions x locally.
  *
  * Calculates the center of mass (if masses are given in the weight array) or
@@ -186,6 +246,34 @@ extern void get_center_comm(t_commrec *cr, rvec x_loc[], real weight_loc[],
                             int nr_loc, int nr_group, rvec center);
 
 
+/*! \brief Computes the local contributions to the center and registers them for summation.
+ *
+ * This is the first half of get_center_comm(). The local weighted sum of
+ * positions and weights are stored in \p buf, which is registered with \p cvr.
+ * After cvreduce_finish() has been called on \p cvr, call
+ * get_center_comm_finish() to obtain the center.
+ *
+ * \param[in]   cvr          The buffer for the fused summation.
+ * \param[in]   x_loc        Array of local positions [0..nr_loc].
+ * \param[in]   weight_loc   Array of local weights, can be NULL.
+ * \param[in]   nr_loc       The number of positions on the local node.
+ * \param[out]  buf          Buffer for the sums, should stay valid until
+ *                           get_center_comm_finish() is called.
+ */
+extern void get_center_comm_start(gmx_cvreduce_t *cvr, rvec x_loc[], real weight_loc[],
+                                  int nr_loc, double buf[4]);
+
+/*! \brief Computes the center from the summed buffer of get_center_comm_start().
+ *
+ * \param[in]   buf          The sums over all nodes.
+ * \param[in]   bWeighted    Whether weights were passed to get_center_comm_start().
+ * \param[in]   nr_group     The number of positions in the whole group.
+ * \param[out]  center       The (weighted) center of the group.
+ */
+extern void get_center_comm_finish(const double buf[4], gmx_bool bWeighted,
+                                   int nr_group, rvec center);
+
+
 /*! \brief Translate positions.
  *
  * Add a translation vector to the positions x.
@@ -47,6 +47,7 @@
 #include "gromacs/gmxlib/network.h"
 #include "gromacs/gmxlib/nrnb.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/force.h"
 #include "gromacs/mdlib/mdrun.h"
 #include "gromacs/mdlib/sim_util.h"
 #include "gromacs/mdlib/simulationsignal.h"
@@ -207,6 +208,18 @@ void compute_globals(FILE *fplog, gmx_global_stat *gstat, t_commrec *cr, t_input
                      as_rvec_array(state->x.data()), as_rvec_array(state->v.data()), vcm);
     }
 
+    if (bEner)
+    {
+        /* Deferred group pair energies are only added to the local sums,
+         * these are added to the averages at the next energy output step.
+         */
+        enerd->grpp_sum.bDeferred = ((flags & CGLO_DEFERGRPP) != 0);
+        if (enerd->grpp_sum.bDeferred)
+        {
+            accumulate_grpp_sum(enerd);
+        }
+    }
+
     if (bTemp || bStopCM || bPres || bEner || bConstrain)
     {
         if (!bGStat)
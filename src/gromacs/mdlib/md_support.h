@@ -86,6 +86,10 @@ class SimulationSignaller;
  * global reduction of the total number of bonded interactions that
  * will be computed, to check none are missing. */
 #define CGLO_CHECK_NUMBER_OF_BONDED_INTERACTIONS (1<<12)
+/* Add the energy group pair energies to local sums instead of to the
+ * energy averages, the sums are added at the next energy step without
+ * this flag. Only for use without summation over ranks. */
+#define CGLO_DEFERGRPP      (1<<13)
 
 
 /*! \brief Return the number of steps that will take place between
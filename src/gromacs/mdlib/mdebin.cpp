@@ -1004,7 +1004,10 @@ void upd_mdebin(t_mdebin       *md,
                  *dens*gmx::square(box[ZZ][ZZ]*NANO/(2*M_PI)));
         add_ebin(md->ebin, md->ivisc, 1, &tmp, bSum);
     }
-    if (md->nE > 1)
+    /* With CGLO_DEFERGRPP the group pair energies of this step are only
+     * in the local sums, they are added by upd_mdebin_grpp_sum later.
+     */
+    if (md->nE > 1 && !enerd->grpp_sum.bDeferred)
     {
         n = 0;
         for (i = 0; (i < md->nEg); i++)
@@ -1197,6 +1200,38 @@ void upd_mdebin(t_mdebin       *md,
 }
 
 
+void upd_mdebin_grpp_sum(t_mdebin *md, gmx_enerdata_t *enerd)
+{
+    gmx_grppairener_sum_t *grpp_sum = &enerd->grpp_sum;
+    double                 esum[egNR], esum2[egNR];
+    int                    i, j, k, kk, n, gid;
+
+    if (md->nE > 1 && grpp_sum->nstep > 0)
+    {
+        n = 0;
+        for (i = 0; (i < md->nEg); i++)
+        {
+            for (j = i; (j < md->nEg); j++)
+            {
+                gid = GID(i, j, md->nEg);
+                for (k = kk = 0; (k < egNR); k++)
+                {
+                    if (md->bEInd[k])
+                    {
+                        esum[kk]  = grpp_sum->esum[k][gid];
+                        esum2[kk] = grpp_sum->esum2[k][gid];
+                        kk++;
+                    }
+                }
+                add_ebin_block(md->ebin, md->igrp[n], md->nEc,
+                               esum, esum2, grpp_sum->nstep);
+                n++;
+            }
+        }
+    }
+    grpp_sum->nstep = 0;
+}
+
 void upd_mdebin_step(t_mdebin *md)
 {
     ebin_increase_count(md->ebin, FALSE);
@@ -144,6 +144,12 @@ void upd_mdebin(t_mdebin                 *md,
                 rvec                      mu_tot,
                 gmx_constr               *constr);
 
+void upd_mdebin_grpp_sum(t_mdebin *md, gmx_enerdata_t *enerd);
+/* Adds the sums of the energy group pair energies of earlier steps,
+ * which were accumulated with CGLO_DEFERGRPP, and clears the sums.
+ * Should be called before upd_mdebin for the current step.
+ */
+
 void upd_mdebin_step(t_mdebin *md);
 /* Updates only the step count in md */
 
@@ -293,6 +293,10 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
         {
             fflush_tng(of->tng);
             fflush_tng(of->tng_low_prec);
+            if (of->fp_ene != nullptr)
+            {
+                flush_enx(of->fp_ene);
+            }
             ivec one_ivec = { 1, 1, 1 };
             write_checkpoint(of->fn_cpt, of->bKeepAndNumCPT,
                              fplog, cr,
@@ -89,6 +89,11 @@
 #include "gromacs/mdlib/nbnxn_pairlist.h"
 
 #ifdef __cplusplus
+namespace gmx
+{
+class CubicSplineTable;
+}
+
 extern "C" {
 #endif
 
@@ -174,6 +179,15 @@ typedef struct nonbonded_verlet_t {
     gmx_nbnxn_gpu_t         *gpu_nbv;         /**< pointer to GPU nb verlet data     */
     int                      min_ci_balanced; /**< pair list balancing parameter
                                                    used for the 8x8x8 GPU kernels    */
+
+    gmx_bool                 bDynamicPruning; /**< TRUE when the CPU pair lists are pruned
+                                                   dynamically every nstlistPrune steps */
+    int                      nstlistPrune;    /**< the interval in steps for dynamic pruning */
+    real                     rlistInner;      /**< the cut-off for the dynamically pruned list */
+    gmx_int64_t              searchStep;      /**< the step of the last pair search */
+
+    gmx::CubicSplineTable   *userTable;       /**< user Coulomb, dispersion and repulsion
+                                                   tables, nullptr when not used */
 } nonbonded_verlet_t;
 
 /*! \brief Getter for bUseGPU */
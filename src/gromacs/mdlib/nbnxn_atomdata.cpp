@@ -56,6 +56,7 @@
 #include "gromacs/mdlib/nbnxn_internal.h"
 #include "gromacs/mdlib/nbnxn_search.h"
 #include "gromacs/mdlib/nbnxn_util.h"
+#include "gromacs/mdtypes/iforceprovider.h"
 #include "gromacs/pbcutil/ishift.h"
 #include "gromacs/simd/simd.h"
 #include "gromacs/utility/exceptions.h"
@@ -165,7 +166,14 @@ static void nbnxn_atomdata_output_init(nbnxn_atomdata_output_t *out,
         nb_kernel_type == nbnxnk4xN_SIMD_2xNN)
     {
         int cj_size  = nbnxn_kernel_to_cluster_j_size(nb_kernel_type);
-        out->nVS = nenergrp*nenergrp*stride*(cj_size>>1)*cj_size;
+        /* The 2xNN kernels process two i-atoms per SIMD register */
+        int simd_width = (nb_kernel_type == nbnxnk4xN_SIMD_2xNN ? 2 : 1)*cj_size;
+        /* The per-atom-pair group buffer is followed by a compact buffer
+         * with one SIMD register per group pair, used for cluster pairs
+         * with all i-atoms and all j-atoms in a single energy group.
+         */
+        out->nVS = nenergrp*nenergrp*stride*(cj_size>>1)*cj_size +
+            nenergrp*nenergrp*simd_width;
         ma((void **)&out->VSvdw, out->nVS*sizeof(*out->VSvdw));
         ma((void **)&out->VSc, out->nVS*sizeof(*out->VSc  ));
     }
@@ -1595,7 +1603,8 @@ static void nbnxn_atomdata_add_nbat_f_to_f_stdreduce(const nbnxn_atomdata_t *nba
 void nbnxn_atomdata_add_nbat_f_to_f(const nbnxn_search_t    nbs,
                                     int                     locality,
                                     const nbnxn_atomdata_t *nbat,
-                                    rvec                   *f)
+                                    rvec                   *f,
+                                    IForceProvider         *forceProvider)
 {
     int a0 = 0, na = 0;
 
@@ -1643,12 +1652,25 @@ void nbnxn_atomdata_add_nbat_f_to_f(const nbnxn_search_t    nbs,
     {
         try
         {
+            int a_start = a0 + ((th + 0)*na)/nth;
+            int a_end   = a0 + ((th + 1)*na)/nth;
+
             nbnxn_atomdata_add_nbat_f_to_f_part(nbs, nbat,
                                                 nbat->out,
                                                 1,
-                                                a0+((th+0)*na)/nth,
-                                                a0+((th+1)*na)/nth,
+                                                a_start,
+                                                a_end,
                                                 f);
+
+            if (forceProvider != nullptr)
+            {
+                /* Add the provider forces on the local atoms of our block */
+                a_end = std::min(a_end, nbs->natoms_local);
+                if (a_start < a_end)
+                {
+                    forceProvider->calculateForcesForAtomRange(a_start, a_end);
+                }
+            }
         }
         GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
     }
@@ -43,6 +43,7 @@
 #include "gromacs/utility/basedefinitions.h"
 #include "gromacs/utility/real.h"
 
+struct IForceProvider;
 struct t_mdatoms;
 
 /* Default nbnxn allocation routine, allocates 32 byte aligned,
@@ -110,11 +111,17 @@ void nbnxn_atomdata_copy_x_to_nbat_x(const nbnxn_search_t nbs,
                                      rvec                *x,
                                      nbnxn_atomdata_t    *nbat);
 
-/* Add the forces stored in nbat to f, zeros the forces in nbat */
+/* Add the forces stored in nbat to f, zeros the forces in nbat.
+ * When forceProvider != NULL, its calculateForcesForAtomRange() is called
+ * on the local atoms of the same thread blocks, so the provider forces
+ * are computed while these atoms are in cache. The provider should have
+ * been prepared with prepareForcesForAtomRanges().
+ */
 void nbnxn_atomdata_add_nbat_f_to_f(const nbnxn_search_t    nbs,
                                     int                     locality,
                                     const nbnxn_atomdata_t *nbat,
-                                    rvec                   *f);
+                                    rvec                   *f,
+                                    IForceProvider         *forceProvider);
 
 /* Add the fshift force stored in nbat to fshift */
 void nbnxn_atomdata_add_nbat_fshift_to_fshift(const nbnxn_atomdata_t *nbat,
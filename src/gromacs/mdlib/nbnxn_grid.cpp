@@ -248,29 +248,33 @@ static int set_grid_size_xy(const nbnxn_search_t nbs,
 }
 
 /* We need to sort paricles in grid columns on z-coordinate.
- * As particle are very often distributed homogeneously, we a sorting
- * algorithm similar to pigeonhole sort. We multiply the z-coordinate
- * by a factor, cast to an int and try to store in that hole. If the hole
- * is full, we move this or another particle. A second pass is needed to make
- * contiguous elements. SORT_GRID_OVERSIZE is the ratio of holes to particles.
- * 4 is the optimal value for homogeneous particle distribution and allows
- * for an O(#particles) sort up till distributions were all particles are
- * concentrated in 1/4 of the space. No NlogN fallback is implemented,
- * as it can be expensive to detect imhomogeneous particle distributions.
- * SGSF is the maximum ratio of holes used, in the worst case all particles
- * end up in the last hole and we need #particles extra holes at the end.
+ * We use a least-significant-digit radix sort on a quantized coordinate
+ * key, which is O(#particles) independently of the particle distribution.
+ * The key is the coordinate multiplied by a factor and cast to an int.
+ * SORT_GRID_OVERSIZE is the ratio of key values to particles, 4 ensures
+ * that most keys are unique for homogeneous particle distributions.
+ * Particles with identical keys are ordered on coordinate and index
+ * in a final insertion sort pass, which is cheap as such runs are short.
+ * The radix sort uses digits of SORT_RADIX_BITS bits, so with up
+ * to 256/SORT_GRID_OVERSIZE particles per column we only need one pass.
  */
 #define SORT_GRID_OVERSIZE 4
-#define SGSF (SORT_GRID_OVERSIZE + 1)
+#define SORT_RADIX_BITS    8
+#define SORT_RADIX         (1 << SORT_RADIX_BITS)
+
+/* Returns the size of the sort work array required for sorting n particles */
+static int sort_work_size(int n)
+{
+    return 3*n + SORT_RADIX;
+}
 
 /* Sort particle index a on coordinates x along dim.
  * Backwards tells if we want decreasing iso increasing coordinates.
  * h0 is the minimum of the coordinate range.
  * invh is the 1/length of the sorting range.
  * n_per_h (>=n) is the expected average number of particles per 1/invh
- * sort is the sorting work array.
- * sort should have a size of at least n_per_h*SORT_GRID_OVERSIZE + n,
- * or easier, allocate at least n*SGSF elements.
+ * sort is the sorting work array, which should have a size
+ * of at least sort_work_size(n).
  */
 static void sort_atoms(int dim, gmx_bool Backwards,
                        int gmx_unused dd_zone,
@@ -291,19 +295,17 @@ static void sort_atoms(int dim, gmx_bool Backwards,
     }
 #endif
 
-    /* Transform the inverse range height into the inverse hole height */
+    /* Transform the inverse range height into the inverse key height */
     invh *= n_per_h*SORT_GRID_OVERSIZE;
 
-    /* Set nsort to the maximum possible number of holes used.
-     * In worst case all n elements end up in the last bin.
-     */
-    int nsort = n_per_h*SORT_GRID_OVERSIZE + n;
+    /* The maximum key value, particles beyond the range get this key */
+    int  key_max  = n_per_h*SORT_GRID_OVERSIZE;
 
-    /* Determine the index range used, so we can limit it for the second pass */
-    int zi_min = INT_MAX;
-    int zi_max = -1;
+    int *key      = sort;
+    int *a_tmp    = sort + n;
+    int *key_tmp  = sort + 2*n;
+    int *count    = sort + 3*n;
 
-    /* Sort the particles using a simple index sort */
     for (int i = 0; i < n; i++)
     {
         /* The cast takes care of float-point rounding effects below zero.
@@ -314,7 +316,7 @@ static void sort_atoms(int dim, gmx_bool Backwards,
 
 #ifndef NDEBUG
         /* As we can have rounding effect, we use > iso >= here */
-        if (zi < 0 || (dd_zone == 0 && zi > n_per_h*SORT_GRID_OVERSIZE))
+        if (zi < 0 || (dd_zone == 0 && zi > key_max))
         {
             gmx_fatal(FARGS, "(int)((x[%d][%c]=%f - %f)*%f) = %d, not in 0 - %d*%d\n",
                       a[i], 'x'+dim, x[a[i]][dim], h0, invh, zi,
@@ -324,84 +326,66 @@ static void sort_atoms(int dim, gmx_bool Backwards,
 
         /* In a non-local domain, particles communcated for bonded interactions
          * can be far beyond the grid size, which is set by the non-bonded
-         * cut-off distance. We sort such particles into the last cell.
+         * cut-off distance. We sort such particles into the last key.
          */
-        if (zi > n_per_h*SORT_GRID_OVERSIZE)
+        key[i] = std::max(std::min(zi, key_max), 0);
+    }
+
+    /* Stable counting sort on each radix digit, starting with the lowest */
+    for (int shift = 0; (key_max >> shift) > 0; shift += SORT_RADIX_BITS)
+    {
+        for (int d = 0; d < SORT_RADIX; d++)
         {
-            zi = n_per_h*SORT_GRID_OVERSIZE;
+            count[d] = 0;
         }
-
-        /* Ideally this particle should go in sort cell zi,
-         * but that might already be in use,
-         * in that case find the first empty cell higher up
-         */
-        if (sort[zi] < 0)
+        for (int i = 0; i < n; i++)
         {
-            sort[zi] = a[i];
-            zi_min   = std::min(zi_min, zi);
-            zi_max   = std::max(zi_max, zi);
+            count[(key[i] >> shift) & (SORT_RADIX - 1)]++;
         }
-        else
+        /* Convert the counts to start indices */
+        int sum = 0;
+        for (int d = 0; d < SORT_RADIX; d++)
         {
-            /* We have multiple atoms in the same sorting slot.
-             * Sort on real z for minimal bounding box size.
-             * There is an extra check for identical z to ensure
-             * well-defined output order, independent of input order
-             * to ensure binary reproducibility after restarts.
-             */
-            while (sort[zi] >= 0 && ( x[a[i]][dim] >  x[sort[zi]][dim] ||
-                                      (x[a[i]][dim] == x[sort[zi]][dim] &&
-                                       a[i] > sort[zi])))
-            {
-                zi++;
-            }
-
-            if (sort[zi] >= 0)
-            {
-                /* Shift all elements by one slot until we find an empty slot */
-                int cp  = sort[zi];
-                int zim = zi + 1;
-                while (sort[zim] >= 0)
-                {
-                    int tmp   = sort[zim];
-                    sort[zim] = cp;
-                    cp        = tmp;
-                    zim++;
-                }
-                sort[zim] = cp;
-                zi_max    = std::max(zi_max, zim);
-            }
-            sort[zi] = a[i];
-            zi_max   = std::max(zi_max, zi);
+            int c    = count[d];
+            count[d] = sum;
+            sum     += c;
         }
-    }
-
-    int c = 0;
-    if (!Backwards)
-    {
-        for (int zi = 0; zi < nsort; zi++)
+        for (int i = 0; i < n; i++)
         {
-            if (sort[zi] >= 0)
-            {
-                a[c++]   = sort[zi];
-                sort[zi] = -1;
-            }
+            int j      = count[(key[i] >> shift) & (SORT_RADIX - 1)]++;
+            a_tmp[j]   = a[i];
+            key_tmp[j] = key[i];
+        }
+        for (int i = 0; i < n; i++)
+        {
+            a[i]   = a_tmp[i];
+            key[i] = key_tmp[i];
         }
     }
-    else
-    {
-        for (int zi = zi_max; zi >= zi_min; zi--)
+
+    /* Sort particles with identical keys on real coordinate for minimal
+     * bounding box size. There is an extra check for identical coordinates
+     * to ensure well-defined output order, independent of input order
+     * to ensure binary reproducibility after restarts.
+     */
+    for (int i = 1; i < n; i++)
+    {
+        int  ai = a[i];
+        real xi = x[ai][dim];
+        int  j  = i;
+        while (j > 0 && key[j - 1] == key[i] &&
+               (x[a[j - 1]][dim] > xi ||
+                (x[a[j - 1]][dim] == xi && a[j - 1] > ai)))
         {
-            if (sort[zi] >= 0)
-            {
-                a[c++]   = sort[zi];
-                sort[zi] = -1;
-            }
+            a[j] = a[j - 1];
+            j--;
         }
+        a[j] = ai;
     }
-    if (c < n)
+
+    if (Backwards)
     {
-        gmx_incons("Lost particles while sorting");
+        std::reverse(a, a + n);
     }
 }
 
@@ -1140,6 +1124,64 @@ static void sort_columns_supersub(const nbnxn_search_t nbs,
     }
 }
 
+#if GMX_SIMD_HAVE_REAL
+/* Sets the, grid local, column indices in cell for atoms i0 up to i1
+ * using SIMD. Particles outside the grid are put in the border columns.
+ * Only full SIMD-width blocks for which the coordinate loads stay below
+ * atom index a1 are processed, the index of the first unprocessed atom
+ * is returned.
+ */
+static int calc_column_indices_simd(const nbnxn_grid_t *grid,
+                                    int i0, int i1, int a1,
+                                    const rvec *x,
+                                    int *cell)
+{
+    // TODO: During SIMDv2 transition only some archs use namespace (remove when done)
+    using namespace gmx;
+
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH) offset[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH) cxy[GMX_SIMD_REAL_WIDTH];
+
+    const SimdReal c0x_S(grid->c0[XX]);
+    const SimdReal c0y_S(grid->c0[YY]);
+    const SimdReal inv_sx_S(grid->inv_sx);
+    const SimdReal inv_sy_S(grid->inv_sy);
+    const SimdReal cx_max_S(grid->ncx - 1);
+    const SimdReal cy_max_S(grid->ncy - 1);
+    const SimdReal ncy_S(grid->ncy);
+    const SimdReal zero_S(0.0);
+
+    /* gatherLoadUTranspose might load up to a full SIMD width of reals
+     * starting at the last offset, we avoid reading beyond atom a1.
+     */
+    int i = i0;
+    for (; i + 2*GMX_SIMD_REAL_WIDTH <= std::min(i1 + GMX_SIMD_REAL_WIDTH, a1); i += GMX_SIMD_REAL_WIDTH)
+    {
+        for (int j = 0; j < GMX_SIMD_REAL_WIDTH; j++)
+        {
+            offset[j] = i + j;
+        }
+        SimdReal x_S, y_S, z_S;
+        gatherLoadUTranspose<DIM>(x[0], offset, &x_S, &y_S, &z_S);
+
+        /* The max with zero takes care of rounding below zero,
+         * the min with the maximum index of rounding issues
+         * at the upper bound.
+         */
+        SimdReal cx_S = trunc(min(max((x_S - c0x_S)*inv_sx_S, zero_S), cx_max_S));
+        SimdReal cy_S = trunc(min(max((y_S - c0y_S)*inv_sy_S, zero_S), cy_max_S));
+
+        store(cxy, cvttR2I(fma(cx_S, ncy_S, cy_S)));
+        for (int j = 0; j < GMX_SIMD_REAL_WIDTH; j++)
+        {
+            cell[i + j] = cxy[j];
+        }
+    }
+
+    return i;
+}
+#endif
+
 /* Determine in which grid column atoms should go */
 static void calc_column_indices(nbnxn_grid_t *grid,
                                 int a0, int a1,
@@ -1157,12 +1199,28 @@ static void calc_column_indices(nbnxn_grid_t *grid,
 
     int n0 = a0 + static_cast<int>((thread+0)*(a1 - a0))/nthread;
     int n1 = a0 + static_cast<int>((thread+1)*(a1 - a0))/nthread;
+
+    /* With SIMD we compute the column indices of most atoms up front,
+     * the loops below only count them and handle moved particles.
+     */
+    int n_simd = n0;
+#if GMX_SIMD_HAVE_REAL
+    n_simd = calc_column_indices_simd(grid, n0, n1, a1, x, cell);
+#endif
+
     if (dd_zone == 0)
     {
         /* Home zone */
         for (int i = n0; i < n1; i++)
         {
-            if (move == nullptr || move[i] >= 0)
+            if (move != nullptr && move[i] < 0)
+            {
+                /* Put this moved particle after the end of the grid,
+                 * so we can process it later without using conditionals.
+                 */
+                cell[i] = grid->ncx*grid->ncy;
+            }
+            else if (i >= n_simd)
             {
                 /* We need to be careful with rounding,
                  * particles might be a few bits outside the local zone.
@@ -1192,13 +1250,6 @@ static void calc_column_indices(nbnxn_grid_t *grid,
                  */
                 cell[i] = cx*grid->ncy + cy;
             }
-            else
-            {
-                /* Put this moved particle after the end of the grid,
-                 * so we can process it later without using conditionals.
-                 */
-                cell[i] = grid->ncx*grid->ncy;
-            }
 
             cxy_na[cell[i]]++;
         }
@@ -1206,7 +1257,11 @@ static void calc_column_indices(nbnxn_grid_t *grid,
     else
     {
         /* Non-home zone */
-        for (int i = n0; i < n1; i++)
+        for (int i = n0; i < n_simd; i++)
+        {
+            cxy_na[cell[i]]++;
+        }
+        for (int i = n_simd; i < n1; i++)
         {
             int cx = static_cast<int>((x[i][XX] - grid->c0[XX])*grid->inv_sx);
             int cy = static_cast<int>((x[i][YY] - grid->c0[YY])*grid->inv_sy);
@@ -1243,9 +1298,8 @@ static void calc_cell_indices(const nbnxn_search_t nbs,
                               nbnxn_atomdata_t *nbat)
 {
     int   n0, n1;
-    int   cx, cy, cxy, ncz_max, ncz;
+    int   cx, cy, ncz_max, ncz;
     int   nthread;
-    int   cxy_na_i;
 
     nthread = gmx_omp_nthreads_get(emntPairsearch);
 
@@ -1260,36 +1314,83 @@ static void calc_cell_indices(const nbnxn_search_t nbs,
         GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
     }
 
-    /* Make the cell index as a function of x and y */
-    ncz_max          = 0;
-    ncz              = 0;
-    grid->cxy_ind[0] = 0;
-    for (int i = 0; i < grid->ncx*grid->ncy+1; i++)
+    /* Make the cell index as a function of x and y.
+     * We use a parallel prefix sum over the columns: each thread first
+     * sums the cell counts of its column range, the thread offsets are
+     * then summed serially and finally each thread sets the cell indices
+     * of its columns. We include the extra column grid->ncx*grid->ncy
+     * with moved particles, which do not need to be ordered on the grid.
+     */
+    int ncxy = grid->ncx*grid->ncy;
+
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (int thread = 0; thread < nthread; thread++)
     {
-        /* We set ncz_max at the beginning of the loop iso at the end
-         * to skip i=grid->ncx*grid->ncy which are moved particles
-         * that do not need to be ordered on the grid.
-         */
-        if (ncz > ncz_max)
-        {
-            ncz_max = ncz;
-        }
-        cxy_na_i = nbs->work[0].cxy_na[i];
-        for (int thread = 1; thread < nthread; thread++)
+        try
         {
-            cxy_na_i += nbs->work[thread].cxy_na[i];
+            nbnxn_search_work_t *work = &nbs->work[thread];
+
+            work->ncz_sum = 0;
+            work->ncz_max = 0;
+            for (int i = ((thread+0)*(ncxy + 1))/nthread; i < ((thread+1)*(ncxy + 1))/nthread; i++)
+            {
+                /* Convert the per-thread atom counts for this column
+                 * to the atom offsets of each thread within the column.
+                 */
+                int cxy_na_i = 0;
+                for (int t = 0; t < nthread; t++)
+                {
+                    int na_t               = nbs->work[t].cxy_na[i];
+                    nbs->work[t].cxy_na[i] = cxy_na_i;
+                    cxy_na_i              += na_t;
+                }
+                grid->cxy_na[i] = cxy_na_i;
+
+                int ncz = (cxy_na_i + grid->na_sc - 1)/grid->na_sc;
+                if (nbat->XFormat == nbatX8)
+                {
+                    /* Make the number of cell a multiple of 2 */
+                    ncz = (ncz + 1) & ~1;
+                }
+                /* Temporarily store the cell count of this column */
+                grid->cxy_ind[i+1] = ncz;
+                work->ncz_sum     += ncz;
+                if (i < ncxy)
+                {
+                    work->ncz_max = std::max(work->ncz_max, ncz);
+                }
+            }
         }
-        ncz = (cxy_na_i + grid->na_sc - 1)/grid->na_sc;
-        if (nbat->XFormat == nbatX8)
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    ncz_max = 0;
+    ncz     = 0;
+    for (int thread = 0; thread < nthread; thread++)
+    {
+        /* Convert the per-thread sums to thread offsets */
+        int ncz_sum                 = nbs->work[thread].ncz_sum;
+        nbs->work[thread].ncz_sum   = ncz;
+        ncz                        += ncz_sum;
+        ncz_max                     = std::max(ncz_max, nbs->work[thread].ncz_max);
+    }
+
+    grid->cxy_ind[0] = 0;
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (int thread = 0; thread < nthread; thread++)
+    {
+        try
         {
-            /* Make the number of cell a multiple of 2 */
-            ncz = (ncz + 1) & ~1;
+            int offset = nbs->work[thread].ncz_sum;
+            for (int i = ((thread+0)*(ncxy + 1))/nthread; i < ((thread+1)*(ncxy + 1))/nthread; i++)
+            {
+                offset            += grid->cxy_ind[i+1];
+                grid->cxy_ind[i+1] = offset;
+            }
         }
-        grid->cxy_ind[i+1] = grid->cxy_ind[i] + ncz;
-        /* Clear cxy_na, so we can reuse the array below */
-        grid->cxy_na[i] = 0;
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
     }
-    grid->nc = grid->cxy_ind[grid->ncx*grid->ncy] - grid->cxy_ind[0];
+    grid->nc = grid->cxy_ind[ncxy] - grid->cxy_ind[0];
 
     nbat->natoms = (grid->cell0 + grid->nc)*grid->na_sc;
 
@@ -1315,43 +1416,50 @@ static void calc_cell_indices(const nbnxn_search_t nbs,
     }
 
     /* Make sure the work array for sorting is large enough */
-    if (ncz_max*grid->na_sc*SGSF > nbs->work[0].sort_work_nalloc)
+    if (sort_work_size(ncz_max*grid->na_sc) > nbs->work[0].sort_work_nalloc)
     {
         for (int thread = 0; thread < nbs->nthread_max; thread++)
         {
             nbs->work[thread].sort_work_nalloc =
-                over_alloc_large(ncz_max*grid->na_sc*SGSF);
+                over_alloc_large(sort_work_size(ncz_max*grid->na_sc));
             srenew(nbs->work[thread].sort_work,
                    nbs->work[thread].sort_work_nalloc);
-            /* When not in use, all elements should be -1 */
-            for (int i = 0; i < nbs->work[thread].sort_work_nalloc; i++)
-            {
-                nbs->work[thread].sort_work[i] = -1;
-            }
         }
     }
 
     /* Now we know the dimensions we can fill the grid.
      * This is the first, unsorted fill. We sort the columns after this.
+     * Each thread fills the atoms it assigned to columns above,
+     * starting at its atom offset within each column. This gives
+     * the same atom order as a serial fill.
      */
-    for (int i = a0; i < a1; i++)
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (int thread = 0; thread < nthread; thread++)
     {
-        /* At this point nbs->cell contains the local grid x,y indices */
-        cxy = nbs->cell[i];
-        nbs->a[(grid->cell0 + grid->cxy_ind[cxy])*grid->na_sc + grid->cxy_na[cxy]++] = i;
+        try
+        {
+            int *cxy_offset = nbs->work[thread].cxy_na;
+
+            int  t_n0       = a0 + static_cast<int>((thread+0)*(a1 - a0))/nthread;
+            int  t_n1       = a0 + static_cast<int>((thread+1)*(a1 - a0))/nthread;
+            for (int i = t_n0; i < t_n1; i++)
+            {
+                /* At this point nbs->cell contains the local grid x,y indices */
+                int cxy = nbs->cell[i];
+                nbs->a[(grid->cell0 + grid->cxy_ind[cxy])*grid->na_sc + cxy_offset[cxy]++] = i;
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
     }
 
     if (dd_zone == 0)
     {
         /* Set the cell indices for the moved particles */
         n0 = grid->nc*grid->na_sc;
-        n1 = grid->nc*grid->na_sc+grid->cxy_na[grid->ncx*grid->ncy];
-        if (dd_zone == 0)
+        n1 = grid->nc*grid->na_sc+grid->cxy_na[ncxy];
+        for (int i = n0; i < n1; i++)
         {
-            for (int i = n0; i < n1; i++)
-            {
-                nbs->cell[nbs->a[i]] = i;
-            }
+            nbs->cell[nbs->a[i]] = i;
         }
     }
 
@@ -1688,6 +1796,97 @@ void nbnxn_get_atomorder(const nbnxn_search_t nbs, const int **a, int *n)
     *n = grid->cxy_ind[grid->ncx*grid->ncy]*grid->na_sc;
 }
 
+/* Returns the squared distance of x to the range [lower, upper),
+ * the range is open at the grid edges, where a few atoms might
+ * be located slightly outside the grid due to rounding.
+ */
+static real column_distance2(real x, int c, int nc, real c0, real s)
+{
+    real lower = c0 + c*s;
+    real upper = lower + s;
+    real d     = 0;
+
+    if (c > 0 && x < lower)
+    {
+        d = lower - x;
+    }
+    else if (c < nc - 1 && x > upper)
+    {
+        d = x - upper;
+    }
+
+    return d*d;
+}
+
+void nbnxn_get_atoms_within_distance(const nbnxn_search_t nbs,
+                                     const rvec *x, const rvec x0, real rc,
+                                     std::vector<int> *atoms)
+{
+    const nbnxn_grid_t *grid = &nbs->grid[0];
+    real                rc2  = rc*rc;
+
+    /* Quick return when the sphere does not overlap with the columns.
+     * Atoms up to a column width outside the grid along x or y are put
+     * in the border columns. Along z the cell bounding boxes are used.
+     */
+    if (x0[XX] + rc < grid->c0[XX] - grid->sx ||
+        x0[XX] - rc > grid->c1[XX] + grid->sx ||
+        x0[YY] + rc < grid->c0[YY] - grid->sy ||
+        x0[YY] - rc > grid->c1[YY] + grid->sy)
+    {
+        return;
+    }
+
+    int cx0 = std::min(std::max(static_cast<int>((x0[XX] - rc - grid->c0[XX])*grid->inv_sx), 0), grid->ncx - 1);
+    int cx1 = std::min(static_cast<int>((x0[XX] + rc - grid->c0[XX])*grid->inv_sx), grid->ncx - 1);
+    int cy0 = std::min(std::max(static_cast<int>((x0[YY] - rc - grid->c0[YY])*grid->inv_sy), 0), grid->ncy - 1);
+    int cy1 = std::min(static_cast<int>((x0[YY] + rc - grid->c0[YY])*grid->inv_sy), grid->ncy - 1);
+
+    for (int cx = cx0; cx <= cx1; cx++)
+    {
+        real dx2 = column_distance2(x0[XX], cx, grid->ncx, grid->c0[XX], grid->sx);
+
+        for (int cy = cy0; cy <= cy1; cy++)
+        {
+            real dxy2 = dx2 + column_distance2(x0[YY], cy, grid->ncy, grid->c0[YY], grid->sy);
+            if (dxy2 >= rc2)
+            {
+                continue;
+            }
+
+            int cxy = cx*grid->ncy + cy;
+            for (int c = grid->cxy_ind[cxy]; c < grid->cxy_ind[cxy + 1]; c++)
+            {
+                /* The cells in a column are sorted along z */
+                real dz = 0;
+                if (x0[ZZ] < grid->bbcz[c*NNBSBB_D])
+                {
+                    dz = grid->bbcz[c*NNBSBB_D] - x0[ZZ];
+                }
+                else if (x0[ZZ] > grid->bbcz[c*NNBSBB_D + 1])
+                {
+                    dz = x0[ZZ] - grid->bbcz[c*NNBSBB_D + 1];
+                }
+                if (dxy2 + dz*dz >= rc2)
+                {
+                    continue;
+                }
+
+                int a0 = (grid->cell0 + c)*grid->na_sc;
+                for (int a = a0; a < a0 + grid->na_sc; a++)
+                {
+                    int ai = nbs->a[a];
+                    /* Skip the filler particles */
+                    if (ai >= 0 && distance2(x[ai], x0) < rc2)
+                    {
+                        atoms->push_back(ai);
+                    }
+                }
+            }
+        }
+    }
+}
+
 void nbnxn_set_atomorder(nbnxn_search_t nbs)
 {
     /* Set the atom order for the home cell (index 0) */
@@ -36,6 +36,8 @@
 #ifndef _nbnxn_grid_h
 #define _nbnxn_grid_h
 
+#include <vector>
+
 #include "gromacs/math/vectypes.h"
 #include "gromacs/mdlib/nbnxn_consts.h"
 #include "gromacs/mdlib/nbnxn_internal.h"
@@ -91,4 +93,13 @@ void nbnxn_get_atomorder(const nbnxn_search_t nbs, const int **a, int *n);
 /* Renumber the atom indices on the grid to consecutive order */
 void nbnxn_set_atomorder(nbnxn_search_t nbs);
 
+/* Append the indices of the local atoms within distance rc of x0 to *atoms.
+ * Uses the local grid set up by the last call to nbnxn_put_on_grid,
+ * x should contain the coordinates passed to that call.
+ * Periodic images are not considered, the caller should shift x0.
+ */
+void nbnxn_get_atoms_within_distance(const nbnxn_search_t nbs,
+                                     const rvec *x, const rvec x0, real rc,
+                                     std::vector<int> *atoms);
+
 #endif
@@ -252,6 +252,9 @@ typedef struct {
     int                 *cxy_na;
     int                  cxy_na_nalloc;
 
+    int                  ncz_sum;      /* Cell count sum/offset for the parallel prefix sum over columns */
+    int                  ncz_max;      /* The maximum cell count of the columns of this thread */
+
     int                 *sort_work;
     int                  sort_work_nalloc;
 
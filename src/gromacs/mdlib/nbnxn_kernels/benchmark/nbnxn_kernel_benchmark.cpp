@@ -0,0 +1,337 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Micro-benchmark for the template reference nbnxn kernel
+ *
+ * Times the kernel for several cluster geometries and interaction
+ * flavors on a random liquid-like system without periodicity.
+ * Usage: nbnxn-kernel-benchmark [number of atoms] [number of iterations]
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "gromacs/math/units.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdlib/forcerec.h"
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_template.h"
+#include "gromacs/mdtypes/interaction_const.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/timing/walltime_accounting.h"
+#include "gromacs/utility/smalloc.h"
+
+namespace
+{
+
+//! The cut-off distance
+const real c_rcut     = 1.0;
+//! The atom density in atoms/nm^3, similar to water
+const real c_density  = 100;
+
+//! The benchmark system
+struct BenchmarkSystem
+{
+    //! Coordinates
+    std::vector<real>   x;
+    //! Charges
+    std::vector<real>   q;
+    //! Atom types
+    std::vector<int>    type;
+    //! LJ parameters
+    std::vector<real>   nbfp;
+    //! LJ parameters per type for LJ-PME
+    std::vector<real>   nbfpComb;
+    //! Energy groups per cluster, all zero
+    std::vector<int>    energrp;
+    //! The atom data
+    nbnxn_atomdata_t    nbat = {};
+    //! The interaction constants
+    interaction_const_t ic   = {};
+    //! The shift vectors, only the central one is non-zero
+    rvec                shiftVec[SHIFTS];
+};
+
+//! Generates random atoms, ordered by grid cell for spatial locality
+void initSystem(BenchmarkSystem *sys, int numAtoms)
+{
+    const real                       boxSize = std::cbrt(numAtoms/c_density);
+    const int                        numCells = std::max(1, static_cast<int>(boxSize/0.5));
+    std::mt19937                     rng(1234);
+    std::uniform_real_distribution<> uniform(0, boxSize);
+
+    std::vector<gmx::RVec>                pos(numAtoms);
+    for (auto &p : pos)
+    {
+        p = { real(uniform(rng)), real(uniform(rng)), real(uniform(rng)) };
+    }
+    auto cellIndex = [&](const gmx::RVec &p)
+    {
+        int c[DIM];
+        for (int d = 0; d < DIM; d++)
+        {
+            c[d] = std::min(numCells - 1, static_cast<int>(p[d]*numCells/boxSize));
+        }
+        return (c[ZZ]*numCells + c[YY])*numCells + c[XX];
+    };
+    std::sort(pos.begin(), pos.end(), [&](const gmx::RVec &a, const gmx::RVec &b)
+              { return cellIndex(a) < cellIndex(b); });
+
+    sys->x.resize(numAtoms*DIM);
+    sys->q.resize(numAtoms);
+    sys->type.resize(numAtoms);
+    for (int a = 0; a < numAtoms; a++)
+    {
+        copy_rvec(pos[a], &sys->x[a*DIM]);
+        sys->q[a]    = (a % 3 == 0 ? -0.8 : 0.4);
+        sys->type[a] = (a % 3 == 0 ? 1 : 0);
+    }
+    const int  numTypes       = 2;
+    const real c6[numTypes]   = { 0, 0.0026 };
+    const real c12[numTypes]  = { 0, 2.6e-6 };
+    sys->nbfp.resize(numTypes*numTypes*2);
+    sys->nbfpComb.resize(numTypes*2);
+    for (int ti = 0; ti < numTypes; ti++)
+    {
+        for (int tj = 0; tj < numTypes; tj++)
+        {
+            sys->nbfp[(ti*numTypes + tj)*2]     = 6*std::sqrt(c6[ti]*c6[tj]);
+            sys->nbfp[(ti*numTypes + tj)*2 + 1] = 12*std::sqrt(c12[ti]*c12[tj]);
+        }
+        sys->nbfpComb[ti*2]     = std::sqrt(6*c6[ti]);
+        sys->nbfpComb[ti*2 + 1] = 0;
+    }
+    sys->energrp.assign(numAtoms/NBNXN_CPU_CLUSTER_I_SIZE, 0);
+
+    nbnxn_atomdata_t *nbat = &sys->nbat;
+    nbat->ntype     = numTypes;
+    nbat->nbfp      = sys->nbfp.data();
+    nbat->nbfp_comb = sys->nbfpComb.data();
+    nbat->type      = sys->type.data();
+    nbat->q         = sys->q.data();
+    nbat->x         = sys->x.data();
+    nbat->na_c      = NBNXN_CPU_CLUSTER_I_SIZE;
+    nbat->nenergrp  = 1;
+    nbat->neg_2log  = 1;
+    nbat->energrp   = sys->energrp.data();
+    nbat->xstride   = DIM;
+    nbat->fstride   = DIM;
+
+    interaction_const_t *ic = &sys->ic;
+    ic->cutoff_scheme         = ecutsVERLET;
+    ic->eeltype               = eelPME;
+    ic->vdwtype               = evdwPME;
+    ic->rcoulomb              = c_rcut;
+    ic->rvdw                  = c_rcut;
+    ic->epsfac                = ONE_4PI_EPS0;
+    ic->k_rf                  = 0.5/(c_rcut*c_rcut*c_rcut);
+    ic->c_rf                  = 1/c_rcut + ic->k_rf*c_rcut*c_rcut;
+    ic->dispersion_shift.cpot = -1/std::pow(c_rcut, 6);
+    ic->repulsion_shift.cpot  = -1/std::pow(c_rcut, 12);
+    ic->ewaldcoeff_q          = 3.12;
+    ic->sh_ewald              = std::erfc(ic->ewaldcoeff_q*c_rcut)/c_rcut;
+    ic->ewaldcoeff_lj         = 2.5;
+    init_interaction_const_tables(nullptr, ic, 0);
+
+    clear_rvecs(SHIFTS, sys->shiftVec);
+}
+
+//! A half pair list of clusters within the cut-off
+struct BenchmarkPairlist
+{
+    //! The i-entries
+    std::vector<nbnxn_ci_t> ci;
+    //! The j-entries
+    std::vector<nbnxn_cj_t> cj;
+    //! The list in kernel format
+    nbnxn_pairlist_t        nbl = {};
+};
+
+//! Returns the squared distance between the bounding boxes of two clusters
+real clusterBoundingBoxDistance2(const std::vector<real> &x,
+                                 int a0, int na, int b0, int nb)
+{
+    real d2 = 0;
+    for (int d = 0; d < DIM; d++)
+    {
+        real aMin = GMX_REAL_MAX, aMax = -GMX_REAL_MAX;
+        real bMin = GMX_REAL_MAX, bMax = -GMX_REAL_MAX;
+        for (int a = a0; a < a0 + na; a++)
+        {
+            aMin = std::min(aMin, x[a*DIM + d]);
+            aMax = std::max(aMax, x[a*DIM + d]);
+        }
+        for (int b = b0; b < b0 + nb; b++)
+        {
+            bMin = std::min(bMin, x[b*DIM + d]);
+            bMax = std::max(bMax, x[b*DIM + d]);
+        }
+        real gap = std::max(std::max(aMin - bMax, bMin - aMax), real(0));
+        d2      += gap*gap;
+    }
+    return d2;
+}
+
+//! Builds a half pair list for the given cluster geometry
+template<int c_iClusterSize, int c_jClusterSize>
+void makePairlist(const BenchmarkSystem &sys, BenchmarkPairlist *list)
+{
+    const int numAtoms = sys.q.size();
+    list->ci.clear();
+    list->cj.clear();
+    for (int ci = 0; ci < numAtoms/c_iClusterSize; ci++)
+    {
+        nbnxn_ci_t ciEntry;
+        ciEntry.ci           = ci;
+        ciEntry.shift        = CENTRAL | NBNXN_CI_DO_LJ(0) | NBNXN_CI_DO_COUL(0);
+        ciEntry.cj_ind_start = list->cj.size();
+        for (int cj = 0; cj < numAtoms/c_jClusterSize; cj++)
+        {
+            if ((cj + 1)*c_jClusterSize <= ci*c_iClusterSize ||
+                clusterBoundingBoxDistance2(sys.x, ci*c_iClusterSize, c_iClusterSize,
+                                            cj*c_jClusterSize, c_jClusterSize) >= c_rcut*c_rcut)
+            {
+                continue;
+            }
+            unsigned int excl = 0;
+            for (int i = 0; i < c_iClusterSize; i++)
+            {
+                for (int j = 0; j < c_jClusterSize; j++)
+                {
+                    if (cj*c_jClusterSize + j > ci*c_iClusterSize + i)
+                    {
+                        excl |= (1U << (i*c_jClusterSize + j));
+                    }
+                }
+            }
+            list->cj.push_back({ cj, excl });
+        }
+        ciEntry.cj_ind_end = list->cj.size();
+        list->ci.push_back(ciEntry);
+    }
+    list->nbl.nci = list->ci.size();
+    list->nbl.ci  = list->ci.data();
+    list->nbl.ncj = list->cj.size();
+    list->nbl.cj  = list->cj.data();
+}
+
+//! Times one kernel flavor and prints the result
+template<int c_iClusterSize, int c_jClusterSize,
+         NbnxnRefCoulomb coulombType, NbnxnRefVdw vdwType, NbnxnRefEnergy energyType>
+void runBenchmark(const BenchmarkSystem &sys, int numIterations, const char *name)
+{
+    BenchmarkPairlist list;
+    makePairlist<c_iClusterSize, c_jClusterSize>(sys, &list);
+
+    std::vector<real> f(sys.x.size());
+    real              fshift[SHIFTS*DIM];
+    real              Vvdw, Vc;
+
+    double            start = gmx_gettime();
+    for (int iter = 0; iter < numIterations; iter++)
+    {
+        std::fill(f.begin(), f.end(), 0);
+        std::fill(fshift, fshift + SHIFTS*DIM, 0);
+        Vvdw = 0;
+        Vc   = 0;
+        nbnxn_kernel_ref_template<c_iClusterSize, c_jClusterSize,
+                                  coulombType, vdwType, energyType>
+            (&list.nbl, &sys.nbat, &sys.ic, sys.shiftVec, f.data(), fshift, &Vvdw, &Vc);
+    }
+    double time            = (gmx_gettime() - start)/numIterations;
+    double numClusterPairs = list.cj.size();
+
+    printf("%2dx%-2d %-26s %9.3f ms %8.2f ns/cluster-pair %7.3f ns/atom-pair  Vc %12.5e\n",
+           c_iClusterSize, c_jClusterSize, name, time*1e3,
+           time*1e9/numClusterPairs,
+           time*1e9/(numClusterPairs*c_iClusterSize*c_jClusterSize), Vc);
+}
+
+//! Times all flavors for one cluster geometry
+template<int c_iClusterSize, int c_jClusterSize>
+void runGeometry(const BenchmarkSystem &sys, int numIterations)
+{
+    runBenchmark<c_iClusterSize, c_jClusterSize, NbnxnRefCoulomb::ReactionField, NbnxnRefVdw::Cut, NbnxnRefEnergy::None>
+        (sys, numIterations, "RF, LJ cut");
+    runBenchmark<c_iClusterSize, c_jClusterSize, NbnxnRefCoulomb::ReactionField, NbnxnRefVdw::Cut, NbnxnRefEnergy::Total>
+        (sys, numIterations, "RF, LJ cut, energy");
+    runBenchmark<c_iClusterSize, c_jClusterSize, NbnxnRefCoulomb::Table, NbnxnRefVdw::Cut, NbnxnRefEnergy::None>
+        (sys, numIterations, "Ewald tab, LJ cut");
+    runBenchmark<c_iClusterSize, c_jClusterSize, NbnxnRefCoulomb::Table, NbnxnRefVdw::Cut, NbnxnRefEnergy::Total>
+        (sys, numIterations, "Ewald tab, LJ cut, energy");
+    runBenchmark<c_iClusterSize, c_jClusterSize, NbnxnRefCoulomb::Table, NbnxnRefVdw::EwaldGeom, NbnxnRefEnergy::None>
+        (sys, numIterations, "Ewald tab, LJ-PME");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int numAtoms      = (argc > 1 ? std::atoi(argv[1]) : 3000);
+    int numIterations = (argc > 2 ? std::atoi(argv[2]) : 20);
+
+    /* All cluster sizes should divide the number of atoms */
+    numAtoms = std::max(32, numAtoms - numAtoms % 32);
+
+    BenchmarkSystem sys;
+    initSystem(&sys, numAtoms);
+
+    printf("Template reference nbnxn kernel, %d atoms, %d iterations, cut-off %.2f nm\n\n",
+           numAtoms, numIterations, c_rcut);
+
+    runGeometry<4, 4>(sys, numIterations);
+    runGeometry<4, 2>(sys, numIterations);
+    runGeometry<4, 8>(sys, numIterations);
+    runGeometry<8, 4>(sys, numIterations);
+    runGeometry<2, 16>(sys, numIterations);
+
+    sfree_aligned(sys.ic.tabq_coul_F);
+    sfree_aligned(sys.ic.tabq_coul_V);
+    sfree_aligned(sys.ic.tabq_coul_FDV0);
+    sfree_aligned(sys.ic.tabq_vdw_F);
+    sfree_aligned(sys.ic.tabq_vdw_V);
+    sfree_aligned(sys.ic.tabq_vdw_FDV0);
+
+    return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+#include "gmxpre.h"
+
+#include "nbnxn_kernel_prune.h"
+
+#include "config.h"
+
+#include <algorithm>
+
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
+#include "gromacs/mdlib/nb_verlet.h"
+#include "gromacs/mdlib/nbnxn_atomdata.h"
+#include "gromacs/mdlib/nbnxn_consts.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/utility/gmxassert.h"
+
+/* Moves the list generated by the search to the outer list, when this
+ * has not been done yet, and ensures the inner list can store all
+ * entries of the outer list.
+ */
+static void nbnxn_pairlist_prepare_prune(nbnxn_pairlist_t *nbl)
+{
+    if (nbl->nciOuter < 0)
+    {
+        std::swap(nbl->ci, nbl->ciOuter);
+        std::swap(nbl->ci_nalloc, nbl->ciOuter_nalloc);
+        std::swap(nbl->cj, nbl->cjOuter);
+        std::swap(nbl->cj_nalloc, nbl->cjOuter_nalloc);
+        nbl->nciOuter = nbl->nci;
+        nbl->ncjOuter = nbl->ncj;
+    }
+
+    /* The inner list is a sub-list, so it never needs more space */
+    if (nbl->nciOuter > nbl->ci_nalloc)
+    {
+        nbl->ci_nalloc = nbl->ciOuter_nalloc;
+        nbnxn_realloc_void((void **)&nbl->ci, 0,
+                           nbl->ci_nalloc*sizeof(*nbl->ci),
+                           nbl->alloc, nbl->free);
+    }
+    if (nbl->ncjOuter > nbl->cj_nalloc)
+    {
+        nbl->cj_nalloc = nbl->cjOuter_nalloc;
+        nbnxn_realloc_void((void **)&nbl->cj, 0,
+                           nbl->cj_nalloc*sizeof(*nbl->cj),
+                           nbl->alloc, nbl->free);
+    }
+}
+
+void nbnxn_kernel_prune_ref(nbnxn_pairlist_t       *nbl,
+                            const nbnxn_atomdata_t *nbat,
+                            const rvec             *shift_vec,
+                            real                    rlistInner)
+{
+    const nbnxn_ci_t *ciOuter  = nbl->ciOuter;
+    nbnxn_ci_t       *ciInner  = nbl->ci;
+    const nbnxn_cj_t *cjOuter  = nbl->cjOuter;
+    nbnxn_cj_t       *cjInner  = nbl->cj;
+    const real       *x        = nbat->x;
+    const int         xstride  = nbat->xstride;
+    const int         na_ci    = nbl->na_ci;
+    const int         na_cj    = nbl->na_cj;
+    const real        rlist2   = rlistInner*rlistInner;
+
+    GMX_ASSERT(na_ci == NBNXN_CPU_CLUSTER_I_SIZE, "The reference prune kernel only supports CPU i-clusters");
+    GMX_ASSERT(nbat->XFormat == nbatXYZ || nbat->XFormat == nbatXYZQ, "The reference prune kernel requires xyz(q) coordinates");
+
+    /* Initialize the new list as empty and add pairs that are in range */
+    int nciInner = 0;
+    int ncjInner = 0;
+    for (int ciIndex = 0; ciIndex < nbl->nciOuter; ciIndex++)
+    {
+        const nbnxn_ci_t &ciEntry = ciOuter[ciIndex];
+
+        /* Copy the original list entry to the pruned entry */
+        nbnxn_ci_t       &ciEntryInner = ciInner[nciInner];
+        ciEntryInner.ci           = ciEntry.ci;
+        ciEntryInner.shift        = ciEntry.shift;
+        ciEntryInner.cj_ind_start = ncjInner;
+
+        /* Load the shifted i-atom coordinates */
+        const int ish = (ciEntry.shift & NBNXN_CI_SHIFT);
+        real      xi[NBNXN_CPU_CLUSTER_I_SIZE*DIM];
+        for (int i = 0; i < na_ci; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                xi[i*DIM + d] = x[(ciEntry.ci*na_ci + i)*xstride + d] + shift_vec[ish][d];
+            }
+        }
+
+        for (int cjind = ciEntry.cj_ind_start; cjind < ciEntry.cj_ind_end; cjind++)
+        {
+            const int cj        = cjOuter[cjind].cj;
+
+            bool      isInRange = false;
+            for (int i = 0; i < na_ci && !isInRange; i++)
+            {
+                for (int j = 0; j < na_cj; j++)
+                {
+                    const real *xj  = x + (cj*na_cj + j)*xstride;
+                    real        dx  = xi[i*DIM + XX] - xj[XX];
+                    real        dy  = xi[i*DIM + YY] - xj[YY];
+                    real        dz  = xi[i*DIM + ZZ] - xj[ZZ];
+                    real        rsq = dx*dx + dy*dy + dz*dz;
+                    if (rsq < rlist2)
+                    {
+                        isInRange = true;
+                        break;
+                    }
+                }
+            }
+
+            if (isInRange)
+            {
+                /* This cluster pair is within the inner cut-off */
+                cjInner[ncjInner] = cjOuter[cjind];
+                ncjInner++;
+            }
+        }
+
+        ciEntryInner.cj_ind_end = ncjInner;
+
+        /* Keep the ci entry only if it contains any cj */
+        if (ciEntryInner.cj_ind_end > ciEntryInner.cj_ind_start)
+        {
+            nciInner++;
+        }
+    }
+
+    nbl->nci      = nciInner;
+    nbl->ncj      = ncjInner;
+    nbl->ncjInUse = ncjInner;
+}
+
+void nbnxn_kernel_cpu_prune(nbnxn_pairlist_set_t   *nbl_list,
+                            const nbnxn_atomdata_t *nbat,
+                            const rvec             *shift_vec,
+                            real                    rlistInner,
+                            int                     kernel_type)
+{
+    nbnxn_pairlist_t **nbl  = nbl_list->nbl;
+    const int          nnbl = nbl_list->nnbl;
+
+    GMX_RELEASE_ASSERT(nbl_list->bSimple, "Dynamic pruning is only supported for CPU pair lists");
+
+    // cppcheck-suppress unreadVariable
+    int nthreads = gmx_omp_nthreads_get(emntNonbonded);
+#pragma omp parallel for schedule(static) num_threads(nthreads)
+    for (int i = 0; i < nnbl; i++)
+    {
+        // The prune kernels do not call code that can throw
+        nbnxn_pairlist_prepare_prune(nbl[i]);
+
+        switch (kernel_type)
+        {
+            case nbnxnk4xN_SIMD_4xN:
+                nbnxn_kernel_prune_4xn(nbl[i], nbat, shift_vec, rlistInner);
+                break;
+            case nbnxnk4xN_SIMD_2xNN:
+                nbnxn_kernel_prune_2xnn(nbl[i], nbat, shift_vec, rlistInner);
+                break;
+            case nbnxnk4x4_PlainC:
+                nbnxn_kernel_prune_ref(nbl[i], nbat, shift_vec, rlistInner);
+                break;
+            default:
+                GMX_RELEASE_ASSERT(false, "kernel type not handled (yet)");
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+/*! \internal \file
+ *
+ * \brief Declares the kernels for dynamic pruning of the nbnxn pair lists.
+ *
+ * With dynamic pruning the list produced by the pair search, with a
+ * buffer sufficient for nstlist steps, is kept as the outer list.
+ * Every nstlistPrune steps the cluster pairs that have no atom pair
+ * within the inner cut-off are removed, which gives the inner list
+ * that is used by the non-bonded kernels.
+ *
+ * \ingroup __module_nb_verlet
+ */
+
+#ifndef _nbnxn_kernel_prune_h
+#define _nbnxn_kernel_prune_h
+
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdlib/nbnxn_pairlist.h"
+#include "gromacs/utility/real.h"
+
+/*! \brief Prunes all lists in \p nbl_list with cut-off \p rlistInner
+ *
+ * When a list has not been pruned since it was generated by the search,
+ * it is first moved to the outer list. The inner list is then (re)built
+ * from the outer list using the current coordinates in \p nbat.
+ * Only supports lists for CPU (non-GPU) kernels.
+ */
+void nbnxn_kernel_cpu_prune(nbnxn_pairlist_set_t   *nbl_list,
+                            const nbnxn_atomdata_t *nbat,
+                            const rvec             *shift_vec,
+                            real                    rlistInner,
+                            int                     kernel_type);
+
+/*! \brief Prune kernel for the plain-C 4x4 atom layout */
+void nbnxn_kernel_prune_ref(nbnxn_pairlist_t       *nbl,
+                            const nbnxn_atomdata_t *nbat,
+                            const rvec             *shift_vec,
+                            real                    rlistInner);
+
+/*! \brief Prune kernel for the SIMD 4xN atom layout */
+void nbnxn_kernel_prune_4xn(nbnxn_pairlist_t       *nbl,
+                            const nbnxn_atomdata_t *nbat,
+                            const rvec             *shift_vec,
+                            real                    rlistInner);
+
+/*! \brief Prune kernel for the SIMD 2x(N+N) atom layout */
+void nbnxn_kernel_prune_2xnn(nbnxn_pairlist_t       *nbl,
+                             const nbnxn_atomdata_t *nbat,
+                             const rvec             *shift_vec,
+                             real                    rlistInner);
+
+#endif
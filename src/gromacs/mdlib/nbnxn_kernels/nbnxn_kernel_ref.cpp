@@ -56,94 +56,18 @@
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/smalloc.h"
 
-/*! \brief Typedefs for declaring lookup tables of kernel functions.
- */
-
-typedef void (*p_nbk_func_noener)(const nbnxn_pairlist_t     *nbl,
-                                  const nbnxn_atomdata_t     *nbat,
-                                  const interaction_const_t  *ic,
-                                  rvec                       *shift_vec,
-                                  real                       *f,
-                                  real                       *fshift);
-
-typedef void (*p_nbk_func_ener)(const nbnxn_pairlist_t     *nbl,
-                                const nbnxn_atomdata_t     *nbat,
-                                const interaction_const_t  *ic,
-                                rvec                       *shift_vec,
-                                real                       *f,
-                                real                       *fshift,
-                                real                       *Vvdw,
-                                real                       *Vc);
-
-/* Analytical reaction-field kernels */
-#define CALC_COUL_RF
-#define LJ_CUT
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_CUT
-#define LJ_FORCE_SWITCH
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_FORCE_SWITCH
-#define LJ_POT_SWITCH
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_POT_SWITCH
-#define LJ_EWALD
-#define LJ_CUT
-#define LJ_EWALD_COMB_GEOM
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_EWALD_COMB_GEOM
-#define LJ_EWALD_COMB_LB
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_EWALD_COMB_LB
-#undef LJ_CUT
-#undef LJ_EWALD
-#undef CALC_COUL_RF
-
-
-/* Tabulated exclusion interaction electrostatics kernels */
-#define CALC_COUL_TAB
-#define LJ_CUT
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_CUT
-#define LJ_FORCE_SWITCH
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_FORCE_SWITCH
-#define LJ_POT_SWITCH
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_POT_SWITCH
-#define LJ_EWALD
-#define LJ_CUT
-#define LJ_EWALD_COMB_GEOM
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_EWALD_COMB_GEOM
-#define LJ_EWALD_COMB_LB
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_EWALD_COMB_LB
-#undef LJ_CUT
-#undef LJ_EWALD
-/* Twin-range cut-off kernels */
-#define VDW_CUTOFF_CHECK
-#define LJ_CUT
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_CUT
-#define LJ_FORCE_SWITCH
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_FORCE_SWITCH
-#define LJ_POT_SWITCH
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_POT_SWITCH
-#define LJ_EWALD
-#define LJ_CUT
-#define LJ_EWALD_COMB_GEOM
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_EWALD_COMB_GEOM
-#define LJ_EWALD_COMB_LB
-#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_includes.h"
-#undef LJ_EWALD_COMB_LB
-#undef LJ_CUT
-#undef LJ_EWALD
-#undef VDW_CUTOFF_CHECK
-#undef CALC_COUL_TAB
+#include "nbnxn_kernel_ref_template.h"
 
+/*! \brief Typedef for declaring lookup tables of kernel functions.
+ */
+typedef void (*p_nbk_func)(const nbnxn_pairlist_t     *nbl,
+                           const nbnxn_atomdata_t     *nbat,
+                           const interaction_const_t  *ic,
+                           const rvec                 *shift_vec,
+                           real                       *f,
+                           real                       *fshift,
+                           real                       *Vvdw,
+                           real                       *Vc);
 
 enum {
     coultRF, coultTAB, coultTAB_TWIN, coultNR
@@ -153,27 +77,54 @@ enum {
     vdwtCUT, vdwtFSWITCH, vdwtPSWITCH, vdwtEWALDGEOM, vdwtEWALDLB, vdwtNR
 };
 
-p_nbk_func_noener p_nbk_c_noener[coultNR][vdwtNR] =
-{
-    { nbnxn_kernel_ElecRF_VdwLJ_F_ref,           nbnxn_kernel_ElecRF_VdwLJFsw_F_ref,           nbnxn_kernel_ElecRF_VdwLJPsw_F_ref,           nbnxn_kernel_ElecRF_VdwLJEwCombGeom_F_ref,           nbnxn_kernel_ElecRF_VdwLJEwCombLB_F_ref           },
-    { nbnxn_kernel_ElecQSTab_VdwLJ_F_ref,        nbnxn_kernel_ElecQSTab_VdwLJFsw_F_ref,        nbnxn_kernel_ElecQSTab_VdwLJPsw_F_ref,        nbnxn_kernel_ElecQSTab_VdwLJEwCombGeom_F_ref,        nbnxn_kernel_ElecQSTab_VdwLJEwCombLB_F_ref        },
-    { nbnxn_kernel_ElecQSTabTwinCut_VdwLJ_F_ref, nbnxn_kernel_ElecQSTabTwinCut_VdwLJFsw_F_ref, nbnxn_kernel_ElecQSTabTwinCut_VdwLJPsw_F_ref, nbnxn_kernel_ElecQSTabTwinCut_VdwLJEwCombGeom_F_ref, nbnxn_kernel_ElecQSTabTwinCut_VdwLJEwCombLB_F_ref }
+enum {
+    enertNONE, enertTOTAL, enertGROUPS, enertNR
 };
 
-p_nbk_func_ener p_nbk_c_ener[coultNR][vdwtNR] =
+//! The reference kernel for the plain-C cluster setup
+template<NbnxnRefCoulomb coulombType, NbnxnRefVdw vdwType, NbnxnRefEnergy energyType>
+static void nbnxn_kernel_ref_4x4(const nbnxn_pairlist_t     *nbl,
+                                 const nbnxn_atomdata_t     *nbat,
+                                 const interaction_const_t  *ic,
+                                 const rvec                 *shift_vec,
+                                 real                       *f,
+                                 real                       *fshift,
+                                 real                       *Vvdw,
+                                 real                       *Vc)
 {
-    { nbnxn_kernel_ElecRF_VdwLJ_VF_ref,           nbnxn_kernel_ElecRF_VdwLJFsw_VF_ref,           nbnxn_kernel_ElecRF_VdwLJPsw_VF_ref,           nbnxn_kernel_ElecRF_VdwLJEwCombGeom_VF_ref,           nbnxn_kernel_ElecRF_VdwLJEwCombLB_VF_ref            },
-    { nbnxn_kernel_ElecQSTab_VdwLJ_VF_ref,        nbnxn_kernel_ElecQSTab_VdwLJFsw_VF_ref,        nbnxn_kernel_ElecQSTab_VdwLJPsw_VF_ref,        nbnxn_kernel_ElecQSTab_VdwLJEwCombGeom_VF_ref,        nbnxn_kernel_ElecQSTab_VdwLJEwCombLB_VF_ref         },
-    { nbnxn_kernel_ElecQSTabTwinCut_VdwLJ_VF_ref, nbnxn_kernel_ElecQSTabTwinCut_VdwLJFsw_VF_ref, nbnxn_kernel_ElecQSTabTwinCut_VdwLJPsw_VF_ref, nbnxn_kernel_ElecQSTabTwinCut_VdwLJEwCombGeom_VF_ref, nbnxn_kernel_ElecQSTabTwinCut_VdwLJEwCombLB_VF_ref  }
-};
+    nbnxn_kernel_ref_template<NBNXN_CPU_CLUSTER_I_SIZE, NBNXN_CPU_CLUSTER_I_SIZE,
+                              coulombType, vdwType, energyType>(nbl, nbat, ic, shift_vec,
+                                                                f, fshift, Vvdw, Vc);
+}
+
+//! Declares the kernels for all VdW types, for one Coulomb and energy type
+#define NBK_VDW_TYPES(coul, ener) \
+    { \
+        nbnxn_kernel_ref_4x4<NbnxnRefCoulomb::coul, NbnxnRefVdw::Cut, NbnxnRefEnergy::ener>, \
+        nbnxn_kernel_ref_4x4<NbnxnRefCoulomb::coul, NbnxnRefVdw::ForceSwitch, NbnxnRefEnergy::ener>, \
+        nbnxn_kernel_ref_4x4<NbnxnRefCoulomb::coul, NbnxnRefVdw::PotentialSwitch, NbnxnRefEnergy::ener>, \
+        nbnxn_kernel_ref_4x4<NbnxnRefCoulomb::coul, NbnxnRefVdw::EwaldGeom, NbnxnRefEnergy::ener>, \
+        nbnxn_kernel_ref_4x4<NbnxnRefCoulomb::coul, NbnxnRefVdw::EwaldLB, NbnxnRefEnergy::ener> \
+    }
 
-p_nbk_func_ener p_nbk_c_energrp[coultNR][vdwtNR] =
+//! Declares the kernels for all energy and VdW types, for one Coulomb type
+#define NBK_ENER_VDW_TYPES(coul) \
+    { \
+        NBK_VDW_TYPES(coul, None), \
+        NBK_VDW_TYPES(coul, Total), \
+        NBK_VDW_TYPES(coul, Groups) \
+    }
+
+static const p_nbk_func p_nbk_c[coultNR][enertNR][vdwtNR] =
 {
-    { nbnxn_kernel_ElecRF_VdwLJ_VgrpF_ref,           nbnxn_kernel_ElecRF_VdwLJFsw_VgrpF_ref,           nbnxn_kernel_ElecRF_VdwLJPsw_VgrpF_ref,           nbnxn_kernel_ElecRF_VdwLJEwCombGeom_VgrpF_ref,           nbnxn_kernel_ElecRF_VdwLJEwCombLB_VgrpF_ref           },
-    { nbnxn_kernel_ElecQSTab_VdwLJ_VgrpF_ref,        nbnxn_kernel_ElecQSTab_VdwLJFsw_VgrpF_ref,        nbnxn_kernel_ElecQSTab_VdwLJPsw_VgrpF_ref,        nbnxn_kernel_ElecQSTab_VdwLJEwCombGeom_VgrpF_ref,        nbnxn_kernel_ElecQSTab_VdwLJEwCombLB_VgrpF_ref        },
-    { nbnxn_kernel_ElecQSTabTwinCut_VdwLJ_VgrpF_ref, nbnxn_kernel_ElecQSTabTwinCut_VdwLJFsw_VgrpF_ref, nbnxn_kernel_ElecQSTabTwinCut_VdwLJPsw_VgrpF_ref, nbnxn_kernel_ElecQSTabTwinCut_VdwLJEwCombGeom_VgrpF_ref, nbnxn_kernel_ElecQSTabTwinCut_VdwLJEwCombLB_VgrpF_ref }
+    NBK_ENER_VDW_TYPES(ReactionField),
+    NBK_ENER_VDW_TYPES(Table),
+    NBK_ENER_VDW_TYPES(TableTwinCut)
 };
 
+#undef NBK_ENER_VDW_TYPES
+#undef NBK_VDW_TYPES
+
 void
 nbnxn_kernel_ref(const nbnxn_pairlist_set_t *nbl_list,
                  const nbnxn_atomdata_t     *nbat,
@@ -279,14 +230,11 @@ nbnxn_kernel_ref(const nbnxn_pairlist_set_t *nbl_list,
             }
         }
 
+        int enert;
         if (!(force_flags & GMX_FORCE_ENERGY))
         {
             /* Don't calculate energies */
-            p_nbk_c_noener[coult][vdwt](nbl[nb], nbat,
-                                        ic,
-                                        shift_vec,
-                                        out->f,
-                                        fshift_p);
+            enert = enertNONE;
         }
         else if (out->nV == 1)
         {
@@ -294,13 +242,7 @@ nbnxn_kernel_ref(const nbnxn_pairlist_set_t *nbl_list,
             out->Vvdw[0] = 0;
             out->Vc[0]   = 0;
 
-            p_nbk_c_ener[coult][vdwt](nbl[nb], nbat,
-                                      ic,
-                                      shift_vec,
-                                      out->f,
-                                      fshift_p,
-                                      out->Vvdw,
-                                      out->Vc);
+            enert        = enertTOTAL;
         }
         else
         {
@@ -316,14 +258,16 @@ nbnxn_kernel_ref(const nbnxn_pairlist_set_t *nbl_list,
                 out->Vc[i] = 0;
             }
 
-            p_nbk_c_energrp[coult][vdwt](nbl[nb], nbat,
-                                         ic,
-                                         shift_vec,
-                                         out->f,
-                                         fshift_p,
-                                         out->Vvdw,
-                                         out->Vc);
+            enert = enertGROUPS;
         }
+
+        p_nbk_c[coult][enert][vdwt](nbl[nb], nbat,
+                                    ic,
+                                    shift_vec,
+                                    out->f,
+                                    fshift_p,
+                                    out->Vvdw,
+                                    out->Vc);
     }
 
     if (force_flags & GMX_FORCE_ENERGY)
@@ -0,0 +1,646 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2012,2013,2014,2015,2016,2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ *
+ * \brief Defines the plain C++ reference nbnxn kernel as a template
+ *
+ * The kernel is specialized at compile time over the Coulomb and VdW
+ * treatment, the energy output, the exclusion handling and the cluster
+ * geometry. Any i- and j-cluster size can be used, as long as the
+ * cluster pair interaction mask fits in the 32-bit exclusion mask of
+ * nbnxn_cj_t. The atom indices are cluster index times cluster size
+ * plus the atom index in the cluster, the coordinates and forces are
+ * stored with stride 3.
+ *
+ * \ingroup module_mdlib
+ */
+#ifndef GMX_MDLIB_NBNXN_KERNELS_NBNXN_KERNEL_REF_TEMPLATE_H
+#define GMX_MDLIB_NBNXN_KERNELS_NBNXN_KERNEL_REF_TEMPLATE_H
+
+#include <cmath>
+
+#include <algorithm>
+
+#include "gromacs/math/functions.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdlib/nbnxn_consts.h"
+#include "gromacs/mdlib/nbnxn_pairlist.h"
+#include "gromacs/mdtypes/interaction_const.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/utility/real.h"
+
+//! The Coulomb treatments of the reference kernel
+enum class NbnxnRefCoulomb
+{
+    ReactionField, //!< Reaction-field, also used for plain cut-off
+    Table,         //!< Tabulated Ewald correction
+    TableTwinCut   //!< Tabulated Ewald correction with rvdw < rcoulomb
+};
+
+//! The VdW treatments of the reference kernel
+enum class NbnxnRefVdw
+{
+    Cut,             //!< Plain or potential-shifted LJ cut-off
+    ForceSwitch,     //!< LJ with force switch
+    PotentialSwitch, //!< LJ with potential switch
+    EwaldGeom,       //!< LJ-PME with geometric combination rule for the grid part
+    EwaldLB          //!< LJ-PME with Lorentz-Berthelot combination rule for the grid part
+};
+
+//! The energy output of the reference kernel
+enum class NbnxnRefEnergy
+{
+    None,  //!< Only forces
+    Total, //!< Forces and total energies
+    Groups //!< Forces and energies per energy group pair
+};
+
+/*! \brief Interaction parameters used by the reference kernel, set once per call */
+struct nbnxn_ref_kernel_params_t
+{
+    real        rcut2;        //!< The square of the cut-off
+    real        rvdw2;        //!< The square of the VdW cut-off, used with twin cut-off
+    real        facel;        //!< The electrostatics conversion factor
+    real        swV3;         //!< Potential switch coefficients
+    real        swV4;         //!< Potential switch coefficients
+    real        swV5;         //!< Potential switch coefficients
+    real        swF2;         //!< Potential switch force coefficients
+    real        swF3;         //!< Potential switch force coefficients
+    real        swF4;         //!< Potential switch force coefficients
+    real        lje_coeff2;   //!< LJ-PME coefficient squared
+    real        lje_coeff6_6; //!< LJ-PME coefficient to the power 6 over 6
+    real        lje_vc;       //!< LJ-PME potential shift
+    real        k_rf;         //!< Reaction-field constant
+    real        k_rf2;        //!< Twice the reaction-field constant
+    real        c_rf;         //!< Reaction-field potential shift
+    real        halfsp;       //!< Half the Coulomb table spacing
+};
+
+//! Sets the kernel parameters from \p ic
+static inline void nbnxn_ref_kernel_params_init(nbnxn_ref_kernel_params_t *p,
+                                                const interaction_const_t *ic)
+{
+    p->rcut2        = ic->rcoulomb*ic->rcoulomb;
+    p->rvdw2        = ic->rvdw*ic->rvdw;
+    p->facel        = ic->epsfac;
+    p->swV3         = ic->vdw_switch.c3;
+    p->swV4         = ic->vdw_switch.c4;
+    p->swV5         = ic->vdw_switch.c5;
+    p->swF2         = 3*ic->vdw_switch.c3;
+    p->swF3         = 4*ic->vdw_switch.c4;
+    p->swF4         = 5*ic->vdw_switch.c5;
+    p->lje_coeff2   = ic->ewaldcoeff_lj*ic->ewaldcoeff_lj;
+    p->lje_coeff6_6 = p->lje_coeff2*p->lje_coeff2*p->lje_coeff2/6.0;
+    p->lje_vc       = ic->sh_lj_ewald;
+    p->k_rf         = ic->k_rf;
+    p->k_rf2        = 2*ic->k_rf;
+    p->c_rf         = ic->c_rf;
+    p->halfsp       = (ic->tabq_scale > 0 ? 0.5/ic->tabq_scale : 0);
+}
+
+//! Returns the energy group of atom \p a, stored per cluster of nbat->na_c atoms
+static inline int nbnxn_ref_energygroup(const nbnxn_atomdata_t *nbat, int a)
+{
+    const int egp_mask = (1 << nbat->neg_2log) - 1;
+
+    return (nbat->energrp[a/nbat->na_c] >> ((a % nbat->na_c)*nbat->neg_2log)) & egp_mask;
+}
+
+//! Returns whether the i- and j-cluster contain common atoms
+template<int c_iClusterSize, int c_jClusterSize>
+static inline bool nbnxn_ref_clusters_overlap(int ci, int cj)
+{
+    return (cj*c_jClusterSize < (ci + 1)*c_iClusterSize &&
+            (cj + 1)*c_jClusterSize > ci*c_iClusterSize);
+}
+
+/*! \brief Computes the interactions of i-cluster \p ci with one j-cluster
+ *
+ * With \p checkExclusions the exclusion mask of \p cjEntry is applied.
+ * With \p calcCoulomb Coulomb interactions are computed.
+ * With \p halfLJ LJ is only computed for the first half of the i-atoms.
+ */
+template<int c_iClusterSize, int c_jClusterSize,
+         NbnxnRefCoulomb coulombType, NbnxnRefVdw vdwType, NbnxnRefEnergy energyType,
+         bool checkExclusions, bool calcCoulomb, bool halfLJ>
+static inline void
+nbnxn_ref_cluster_pair(const nbnxn_ref_kernel_params_t &p,
+                       const nbnxn_atomdata_t          *nbat,
+                       const interaction_const_t       *ic,
+                       int                              ci,
+                       bool                             isDiagonal,
+                       const nbnxn_cj_t                &cjEntry,
+                       const real                      *xi,
+                       const real                      *qi,
+                       const int                       *egp_sh_i,
+                       real                            *fi,
+                       real                            *f,
+                       real                            *Vvdw,
+                       real                            *Vc)
+{
+    constexpr bool calcEnergies = (energyType != NbnxnRefEnergy::None);
+    constexpr bool ljEwald      = (vdwType == NbnxnRefVdw::EwaldGeom || vdwType == NbnxnRefVdw::EwaldLB);
+    constexpr bool ljSwitch     = (vdwType == NbnxnRefVdw::ForceSwitch || vdwType == NbnxnRefVdw::PotentialSwitch);
+    /* When calculating RF or Ewald interactions we calculate the electrostatic
+     * forces and energies on excluded atom pairs here in the non-bonded loops.
+     */
+    constexpr bool exclForces   = (checkExclusions && (calcCoulomb || ljEwald));
+    constexpr bool twinCut      = (coulombType == NbnxnRefCoulomb::TableTwinCut);
+
+    const int     *type   = nbat->type;
+    const real    *q      = nbat->q;
+    const real    *x      = nbat->x;
+    const real    *nbfp   = nbat->nbfp;
+    const real    *ljc    = nbat->nbfp_comb;
+    const int      ntype2 = nbat->ntype*2;
+    const int      cj     = cjEntry.cj;
+
+    for (int i = 0; i < c_iClusterSize; i++)
+    {
+        const int ai         = ci*c_iClusterSize + i;
+        const int type_i_off = type[ai]*ntype2;
+
+        for (int j = 0; j < c_jClusterSize; j++)
+        {
+            const int aj     = cj*c_jClusterSize + j;
+            real      FrLJ6  = 0, FrLJ12 = 0, frLJ = 0;
+            real      VLJ    = 0;
+            real      fcoul  = 0;
+            real      vcoul  = 0;
+
+            /* A multiply mask used to zero an interaction
+             * when either the distance cutoff is exceeded, or
+             * (if appropriate) the i and j indices are
+             * unsuitable for this kind of inner loop.
+             * interact is a multiply mask used to zero an interaction
+             * when that interaction should be excluded
+             * (e.g. because of bonding).
+             */
+            real skipmask = 1.0;
+            real interact = 1.0;
+            if (checkExclusions)
+            {
+                interact = ((cjEntry.excl >> (i*c_jClusterSize + j)) & 1);
+                if (!exclForces)
+                {
+                    skipmask = interact;
+                }
+                else
+                {
+                    skipmask = (isDiagonal && aj <= ai) ? 0.0 : 1.0;
+                }
+            }
+
+            real dx  = xi[i*DIM + XX] - x[aj*DIM + XX];
+            real dy  = xi[i*DIM + YY] - x[aj*DIM + YY];
+            real dz  = xi[i*DIM + ZZ] - x[aj*DIM + ZZ];
+
+            real rsq = dx*dx + dy*dy + dz*dz;
+
+            /* Prepare to enforce the cut-off. */
+            skipmask = (rsq >= p.rcut2) ? 0 : skipmask;
+
+            // Ensure the distances do not fall below the limit where r^-12 overflows.
+            // This should never happen for normal interactions.
+            rsq = std::max(rsq, NBNXN_MIN_RSQ);
+
+            real rinv = gmx::invsqrt(rsq);
+
+            /* Partially enforce the cut-off (and perhaps
+             * exclusions) to avoid possible overflow of
+             * rinvsix when computing LJ, and/or overflowing
+             * the Coulomb table during lookup. */
+            rinv = rinv * skipmask;
+
+            real rinvsq  = rinv*rinv;
+
+            const int egp_ind = (energyType == NbnxnRefEnergy::Groups ?
+                                 egp_sh_i[i] + nbnxn_ref_energygroup(nbat, aj) : 0);
+
+            if (!halfLJ || i < c_iClusterSize/2)
+            {
+                real c6      = nbfp[type_i_off + type[aj]*2    ];
+                real c12     = nbfp[type_i_off + type[aj]*2 + 1];
+
+                real rinvsix = interact*rinvsq*rinvsq*rinvsq;
+                FrLJ6        = c6*rinvsix;
+                FrLJ12       = c12*rinvsix*rinvsix;
+                frLJ         = FrLJ12 - FrLJ6;
+                if (calcEnergies || vdwType == NbnxnRefVdw::PotentialSwitch)
+                {
+                    VLJ      = (FrLJ12 + c12*ic->repulsion_shift.cpot)/12 -
+                        (FrLJ6 + c6*ic->dispersion_shift.cpot)/6;
+                }
+
+                real r = 0, rsw = 0;
+                if (ljSwitch)
+                {
+                    /* Force or potential switching from ic->rvdw_switch */
+                    r       = rsq*rinv;
+                    rsw     = r - ic->rvdw_switch;
+                    rsw     = (rsw >= 0.0 ? rsw : 0.0);
+                }
+                if (vdwType == NbnxnRefVdw::ForceSwitch)
+                {
+                    frLJ   +=
+                        -c6*(ic->dispersion_shift.c2 + ic->dispersion_shift.c3*rsw)*rsw*rsw*r
+                        + c12*(ic->repulsion_shift.c2 + ic->repulsion_shift.c3*rsw)*rsw*rsw*r;
+                    if (calcEnergies)
+                    {
+                        VLJ    +=
+                            -c6*(-ic->dispersion_shift.c2/3 - ic->dispersion_shift.c3/4*rsw)*rsw*rsw*rsw
+                            + c12*(-ic->repulsion_shift.c2/3 - ic->repulsion_shift.c3/4*rsw)*rsw*rsw*rsw;
+                    }
+                }
+
+                if (calcEnergies || vdwType == NbnxnRefVdw::PotentialSwitch)
+                {
+                    /* Masking should be done after force switching,
+                     * but before potential switching.
+                     */
+                    /* Need to zero the interaction if there should be exclusion. */
+                    VLJ     = VLJ * interact;
+                }
+
+                if (vdwType == NbnxnRefVdw::PotentialSwitch)
+                {
+                    real sw, dsw;
+
+                    sw    = 1.0 + (p.swV3 + (p.swV4+ p.swV5*rsw)*rsw)*rsw*rsw*rsw;
+                    dsw   = (p.swF2 + (p.swF3 + p.swF4*rsw)*rsw)*rsw*rsw;
+
+                    frLJ  = frLJ*sw - r*VLJ*dsw;
+                    VLJ  *= sw;
+                }
+
+                if (ljEwald)
+                {
+                    real c6grid;
+
+                    if (vdwType == NbnxnRefVdw::EwaldGeom)
+                    {
+                        c6grid       = ljc[type[ai]*2]*ljc[type[aj]*2];
+                    }
+                    else
+                    {
+                        /* These sigma and epsilon are scaled to give 6*C6 */
+                        real sigma   = ljc[type[ai]*2] + ljc[type[aj]*2];
+                        real epsilon = ljc[type[ai]*2 + 1]*ljc[type[aj]*2 + 1];
+
+                        real sigma2  = sigma*sigma;
+                        c6grid       = epsilon*sigma2*sigma2*sigma2;
+                    }
+
+                    /* Recalculate rinvsix without exclusion mask, when needed */
+                    real rinvsix_nm = (checkExclusions ? rinvsq*rinvsq*rinvsq : rinvsix);
+                    real cr2        = p.lje_coeff2*rsq;
+                    real expmcr2    = std::exp(-cr2);
+                    real poly       = 1 + cr2 + 0.5*cr2*cr2;
+
+                    /* Subtract the grid force from the total LJ force */
+                    frLJ           += c6grid*(rinvsix_nm - expmcr2*(rinvsix_nm*poly + p.lje_coeff6_6));
+                    if (calcEnergies)
+                    {
+                        /* Shift should only be applied to real LJ pairs */
+                        real sh_mask = p.lje_vc*interact;
+
+                        VLJ         += c6grid/6*(rinvsix_nm*(1 - expmcr2*poly) + sh_mask);
+                    }
+                }
+
+                if (twinCut)
+                {
+                    /* Mask for VdW cut-off shorter than Coulomb cut-off */
+                    real skipmask_rvdw = (rsq < p.rvdw2) ? 1.0 : 0.0;
+                    frLJ              *= skipmask_rvdw;
+                    if (calcEnergies)
+                    {
+                        VLJ           *= skipmask_rvdw;
+                    }
+                }
+                else if (calcEnergies)
+                {
+                    /* Need to zero the interaction if r >= rcut */
+                    VLJ     = VLJ * skipmask;
+                }
+
+                if (calcEnergies)
+                {
+                    Vvdw[egp_ind] += VLJ;
+                }
+            }
+
+            if (calcCoulomb)
+            {
+                /* Enforce the cut-off and perhaps exclusions. In
+                 * those cases, rinv is zero because of skipmask,
+                 * but fcoul and vcoul will later be non-zero (in
+                 * both RF and table cases) because of the
+                 * contributions that do not depend on rinv. These
+                 * contributions cannot be allowed to accumulate
+                 * to the force and potential, and the easiest way
+                 * to do this is to zero the charges in
+                 * advance. */
+                real qq = skipmask * qi[i] * q[aj];
+
+                if (coulombType == NbnxnRefCoulomb::ReactionField)
+                {
+                    fcoul  = qq*(interact*rinv*rinvsq - p.k_rf2);
+                    if (calcEnergies)
+                    {
+                        vcoul  = qq*(interact*rinv + p.k_rf*rsq - p.c_rf);
+                    }
+                }
+                else
+                {
+                    real rs     = rsq*rinv*ic->tabq_scale;
+                    int  ri     = static_cast<int>(rs);
+                    real frac   = rs - ri;
+#if !GMX_DOUBLE
+                    const real *tab_coul_FDV0 = ic->tabq_coul_FDV0;
+                    /* fexcl = F_i + frac * (F_(i+1)-F_i) */
+                    real        fexcl         = tab_coul_FDV0[ri*4] + frac*tab_coul_FDV0[ri*4 + 1];
+#else
+                    const real *tab_coul_F    = ic->tabq_coul_F;
+                    const real *tab_coul_V    = ic->tabq_coul_V;
+                    /* fexcl = (1-frac) * F_i + frac * F_(i+1) */
+                    real        fexcl         = (1 - frac)*tab_coul_F[ri] + frac*tab_coul_F[ri + 1];
+#endif
+                    fcoul  = interact*rinvsq - fexcl;
+                    if (calcEnergies)
+                    {
+#if !GMX_DOUBLE
+                        vcoul  = qq*(interact*(rinv - ic->sh_ewald)
+                                     -(tab_coul_FDV0[ri*4 + 2]
+                                       -p.halfsp*frac*(tab_coul_FDV0[ri*4] + fexcl)));
+#else
+                        vcoul  = qq*(interact*(rinv - ic->sh_ewald)
+                                     -(tab_coul_V[ri]
+                                       -p.halfsp*frac*(tab_coul_F[ri] + fexcl)));
+#endif
+                    }
+                    fcoul *= qq*rinv;
+                }
+
+                if (calcEnergies)
+                {
+                    Vc[egp_ind] += vcoul;
+                }
+            }
+
+            real fscal;
+            if (calcCoulomb && halfLJ && i >= c_iClusterSize/2)
+            {
+                fscal = fcoul;
+            }
+            else if (calcCoulomb)
+            {
+                fscal = frLJ*rinvsq + fcoul;
+            }
+            else
+            {
+                fscal = frLJ*rinvsq;
+            }
+            real fx = fscal*dx;
+            real fy = fscal*dy;
+            real fz = fscal*dz;
+
+            /* Increment i-atom force */
+            fi[i*DIM + XX] += fx;
+            fi[i*DIM + YY] += fy;
+            fi[i*DIM + ZZ] += fz;
+            /* Decrement j-atom force */
+            f[aj*DIM + XX] -= fx;
+            f[aj*DIM + YY] -= fy;
+            f[aj*DIM + ZZ] -= fz;
+        }
+    }
+}
+
+/*! \brief Plain C++ reference kernel for one pair list
+ *
+ * \p Vvdw and \p Vc are only used with energy output. With
+ * NbnxnRefEnergy::Total the single energy terms are incremented,
+ * with NbnxnRefEnergy::Groups the energy group pair matrices.
+ */
+template<int c_iClusterSize, int c_jClusterSize,
+         NbnxnRefCoulomb coulombType, NbnxnRefVdw vdwType, NbnxnRefEnergy energyType>
+void
+nbnxn_kernel_ref_template(const nbnxn_pairlist_t     *nbl,
+                          const nbnxn_atomdata_t     *nbat,
+                          const interaction_const_t  *ic,
+                          const rvec                 *shift_vec,
+                          real                       *f,
+                          real                       *fshift,
+                          real                       *Vvdw,
+                          real                       *Vc)
+{
+    static_assert(c_iClusterSize*c_jClusterSize <= 32,
+                  "The cluster pair interaction mask should fit in the 32-bit exclusion mask");
+
+    constexpr bool         calcEnergies = (energyType != NbnxnRefEnergy::None);
+    constexpr bool         ljEwald      = (vdwType == NbnxnRefVdw::EwaldGeom || vdwType == NbnxnRefVdw::EwaldLB);
+    /* The mask for a cluster pair without exclusions */
+    constexpr unsigned int fullMask     =
+        (c_iClusterSize*c_jClusterSize == 32 ? 0xffffffffU :
+         (1U << (c_iClusterSize*c_jClusterSize)) - 1);
+
+    nbnxn_ref_kernel_params_t p;
+    nbnxn_ref_kernel_params_init(&p, ic);
+
+    const real *q        = nbat->q;
+    const real *x        = nbat->x;
+    const real *shiftvec = shift_vec[0];
+    const nbnxn_cj_t *l_cj = nbl->cj;
+
+    for (int n = 0; n < nbl->nci; n++)
+    {
+        const nbnxn_ci_t *nbln = &nbl->ci[n];
+
+        const int ish    = (nbln->shift & NBNXN_CI_SHIFT);
+        /* x, f and fshift are assumed to be stored with stride 3 */
+        const int ishf   = ish*DIM;
+        const int cjind0 = nbln->cj_ind_start;
+        const int cjind1 = nbln->cj_ind_end;
+        const int ci     = nbln->ci;
+
+        /* We have 5 LJ/C combinations, but use only three inner loops,
+         * as the other combinations are unlikely and/or not much faster:
+         * inner half-LJ + C for half-LJ + C / no-LJ + C
+         * inner LJ + C      for full-LJ + C
+         * inner LJ          for full-LJ + no-C / half-LJ + no-C
+         */
+        const bool do_LJ   = (nbln->shift & NBNXN_CI_DO_LJ(0));
+        const bool do_coul = (nbln->shift & NBNXN_CI_DO_COUL(0));
+        const bool half_LJ = ((nbln->shift & NBNXN_CI_HALF_LJ(0)) || !do_LJ) && do_coul;
+
+        real       xi[c_iClusterSize*DIM];
+        real       fi[c_iClusterSize*DIM];
+        real       qi[c_iClusterSize];
+        int        egp_sh_i[c_iClusterSize];
+
+        /* Without energy groups all energies go to a local accumulator */
+        real       Vvdw_ci   = 0;
+        real       Vc_ci     = 0;
+        real      *Vvdw_p    = (energyType == NbnxnRefEnergy::Groups ? Vvdw : &Vvdw_ci);
+        real      *Vc_p      = (energyType == NbnxnRefEnergy::Groups ? Vc : &Vc_ci);
+
+        for (int i = 0; i < c_iClusterSize; i++)
+        {
+            const int ai = ci*c_iClusterSize + i;
+
+            for (int d = 0; d < DIM; d++)
+            {
+                xi[i*DIM + d] = x[ai*DIM + d] + shiftvec[ishf + d];
+                fi[i*DIM + d] = 0;
+            }
+
+            qi[i]       = p.facel*q[ai];
+            egp_sh_i[i] = (energyType == NbnxnRefEnergy::Groups ?
+                           nbnxn_ref_energygroup(nbat, ai)*nbat->nenergrp : 0);
+        }
+
+        /* Only in the central image can clusters contain common atoms */
+        auto isDiagonal = [ish, ci](int cj)
+        {
+            return (ish == CENTRAL &&
+                    nbnxn_ref_clusters_overlap<c_iClusterSize, c_jClusterSize>(ci, cj));
+        };
+
+        if (calcEnergies && (ljEwald || do_coul) && cjind0 < cjind1 &&
+            isDiagonal(l_cj[cjind0].cj))
+        {
+            real Vc_sub_self;
+
+            if (coulombType == NbnxnRefCoulomb::ReactionField)
+            {
+                Vc_sub_self = 0.5*p.c_rf;
+            }
+            else
+            {
+#if GMX_DOUBLE
+                Vc_sub_self = 0.5*ic->tabq_coul_V[0];
+#else
+                Vc_sub_self = 0.5*ic->tabq_coul_FDV0[2];
+#endif
+            }
+
+            for (int i = 0; i < c_iClusterSize; i++)
+            {
+                const int ai      = ci*c_iClusterSize + i;
+                const int egp_ind = (energyType == NbnxnRefEnergy::Groups ?
+                                     egp_sh_i[i] + nbnxn_ref_energygroup(nbat, ai) : 0);
+
+                /* Coulomb self interaction */
+                Vc[egp_ind]   -= qi[i]*q[ai]*Vc_sub_self;
+
+                if (ljEwald)
+                {
+                    /* LJ Ewald self interaction */
+                    Vvdw[egp_ind] += 0.5*nbat->nbfp[nbat->type[ai]*(nbat->ntype + 1)*2]/6*p.lje_coeff6_6;
+                }
+            }
+        }
+
+        int cjind = cjind0;
+        while (cjind < cjind1 && l_cj[cjind].excl != fullMask)
+        {
+            const bool diag = isDiagonal(l_cj[cjind].cj);
+            if (half_LJ)
+            {
+                nbnxn_ref_cluster_pair<c_iClusterSize, c_jClusterSize, coulombType, vdwType, energyType, true, true, true>
+                    (p, nbat, ic, ci, diag, l_cj[cjind], xi, qi, egp_sh_i, fi, f, Vvdw_p, Vc_p);
+            }
+            else if (do_coul)
+            {
+                nbnxn_ref_cluster_pair<c_iClusterSize, c_jClusterSize, coulombType, vdwType, energyType, true, true, false>
+                    (p, nbat, ic, ci, diag, l_cj[cjind], xi, qi, egp_sh_i, fi, f, Vvdw_p, Vc_p);
+            }
+            else
+            {
+                nbnxn_ref_cluster_pair<c_iClusterSize, c_jClusterSize, coulombType, vdwType, energyType, true, false, false>
+                    (p, nbat, ic, ci, diag, l_cj[cjind], xi, qi, egp_sh_i, fi, f, Vvdw_p, Vc_p);
+            }
+            cjind++;
+        }
+
+        for (; cjind < cjind1; cjind++)
+        {
+            if (half_LJ)
+            {
+                nbnxn_ref_cluster_pair<c_iClusterSize, c_jClusterSize, coulombType, vdwType, energyType, false, true, true>
+                    (p, nbat, ic, ci, false, l_cj[cjind], xi, qi, egp_sh_i, fi, f, Vvdw_p, Vc_p);
+            }
+            else if (do_coul)
+            {
+                nbnxn_ref_cluster_pair<c_iClusterSize, c_jClusterSize, coulombType, vdwType, energyType, false, true, false>
+                    (p, nbat, ic, ci, false, l_cj[cjind], xi, qi, egp_sh_i, fi, f, Vvdw_p, Vc_p);
+            }
+            else
+            {
+                nbnxn_ref_cluster_pair<c_iClusterSize, c_jClusterSize, coulombType, vdwType, energyType, false, false, false>
+                    (p, nbat, ic, ci, false, l_cj[cjind], xi, qi, egp_sh_i, fi, f, Vvdw_p, Vc_p);
+            }
+        }
+
+        /* Add accumulated i-forces to the force array */
+        for (int i = 0; i < c_iClusterSize; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                f[(ci*c_iClusterSize + i)*DIM + d] += fi[i*DIM + d];
+            }
+        }
+        if (fshift != nullptr)
+        {
+            /* Add i forces to shifted force list */
+            for (int i = 0; i < c_iClusterSize; i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    fshift[ishf + d] += fi[i*DIM + d];
+                }
+            }
+        }
+
+        if (energyType == NbnxnRefEnergy::Total)
+        {
+            *Vvdw += Vvdw_ci;
+            *Vc   += Vc_ci;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+#include "gmxpre.h"
+
+#include "nbnxn_kernel_usertab.h"
+
+#include "config.h"
+
+#include <algorithm>
+
+#include "gromacs/math/functions.h"
+#include "gromacs/mdlib/force_flags.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
+#include "gromacs/mdlib/nb_verlet.h"
+#include "gromacs/mdlib/nbnxn_consts.h"
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_common.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/tables/cubicsplinetable.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxassert.h"
+
+void
+nbnxn_kernel_usertab(const nbnxn_pairlist_set_t  *nbl_list,
+                     const nbnxn_atomdata_t      *nbat,
+                     const interaction_const_t   *ic,
+                     const gmx::CubicSplineTable &table,
+                     rvec                        *shift_vec,
+                     int                          kernel_type,
+                     int                          force_flags,
+                     int                          clearF,
+                     real                        *fshift,
+                     real                        *Vc,
+                     real                        *Vvdw)
+{
+    const int nnbl = nbl_list->nnbl;
+
+    GMX_RELEASE_ASSERT(kernel_type == nbnxnk4x4_PlainC ||
+                       kernel_type == nbnxnk4xN_SIMD_4xN,
+                       "User tables are only supported with plain-C and SIMD 4xN kernels");
+
+    int gmx_unused nthreads = gmx_omp_nthreads_get(emntNonbonded);
+#pragma omp parallel for schedule(static) num_threads(nthreads)
+    for (int nb = 0; nb < nnbl; nb++)
+    {
+        try
+        {
+            nbnxn_atomdata_output_t *out = &nbat->out[nb];
+
+            if (clearF == enbvClearFYes)
+            {
+                clear_f(nbat, nb, out->f);
+            }
+
+            real *fshift_p;
+            if ((force_flags & GMX_FORCE_VIRIAL) && nnbl == 1)
+            {
+                fshift_p = fshift;
+            }
+            else
+            {
+                fshift_p = out->fshift;
+
+                if (clearF == enbvClearFYes)
+                {
+                    clear_fshift(fshift_p);
+                }
+            }
+
+            /* Both kernels accumulate energies in the energy group pair
+             * layout of out->Vc and out->Vvdw, also without energy groups.
+             */
+            real *Vc_p   = nullptr;
+            real *Vvdw_p = nullptr;
+            if (force_flags & GMX_FORCE_ENERGY)
+            {
+                for (int i = 0; i < out->nV; i++)
+                {
+                    out->Vc[i]   = 0;
+                    out->Vvdw[i] = 0;
+                }
+                Vc_p   = out->Vc;
+                Vvdw_p = out->Vvdw;
+            }
+
+            if (kernel_type == nbnxnk4xN_SIMD_4xN)
+            {
+                nbnxn_kernel_usertab_4xn(nbl_list->nbl[nb], nbat, ic, table,
+                                         shift_vec, out->f, fshift_p,
+                                         Vc_p, Vvdw_p);
+            }
+            else
+            {
+                nbnxn_kernel_usertab_ref(nbl_list->nbl[nb], nbat, ic, table,
+                                         shift_vec, out->f, fshift_p,
+                                         Vc_p, Vvdw_p);
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    if (force_flags & GMX_FORCE_ENERGY)
+    {
+        reduce_energies_over_lists(nbat, nnbl, Vvdw, Vc);
+    }
+}
+
+void
+nbnxn_kernel_usertab_ref(const nbnxn_pairlist_t      *nbl,
+                         const nbnxn_atomdata_t      *nbat,
+                         const interaction_const_t   *ic,
+                         const gmx::CubicSplineTable &table,
+                         const rvec                  *shift_vec,
+                         real                        *f,
+                         real                        *fshift,
+                         real                        *Vc,
+                         real                        *Vvdw)
+{
+    const int   na_c         = NBNXN_CPU_CLUSTER_I_SIZE;
+    const int  *type         = nbat->type;
+    const real *q            = nbat->q;
+    const real *x            = nbat->x;
+    const real *nbfp         = nbat->nbfp;
+    const real *shiftvec     = shift_vec[0];
+    const int   xstride      = nbat->xstride;
+    const int   fstride      = nbat->fstride;
+    const int   ntype2       = nbat->ntype*2;
+    const real  facel        = ic->epsfac;
+    const real  rcut2        = ic->rcoulomb*ic->rcoulomb;
+    const bool  useEnergrp   = (nbat->nenergrp > 1);
+    const int   egp_mask     = (1 << nbat->neg_2log) - 1;
+
+    GMX_ASSERT(nbl->na_ci == na_c && nbl->na_cj == na_c, "The reference user table kernel only supports 4x4 clusters");
+
+    for (int n = 0; n < nbl->nci; n++)
+    {
+        const nbnxn_ci_t &ciEntry = nbl->ci[n];
+        const int         ish     = (ciEntry.shift & NBNXN_CI_SHIFT);
+        const int         ci      = ciEntry.ci;
+
+        real              xi[na_c*DIM];
+        real              fi[na_c*DIM];
+        real              qi[na_c];
+        int               egp_sh_i[na_c];
+        for (int i = 0; i < na_c; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                xi[i*DIM + d] = x[(ci*na_c + i)*xstride + d] + shiftvec[ish*DIM + d];
+                fi[i*DIM + d] = 0;
+            }
+            qi[i]       = facel*q[ci*na_c + i];
+            egp_sh_i[i] = 0;
+            if (useEnergrp)
+            {
+                egp_sh_i[i] = ((nbat->energrp[ci] >> (i*nbat->neg_2log)) & egp_mask)*nbat->nenergrp;
+            }
+        }
+
+        for (int cjind = ciEntry.cj_ind_start; cjind < ciEntry.cj_ind_end; cjind++)
+        {
+            const int          cj   = nbl->cj[cjind].cj;
+            const unsigned int excl = nbl->cj[cjind].excl;
+
+            for (int i = 0; i < na_c; i++)
+            {
+                const real *nbfp_i = nbfp + type[ci*na_c + i]*ntype2;
+
+                for (int j = 0; j < na_c; j++)
+                {
+                    /* Excluded pairs are skipped, as with user tables
+                     * in the group scheme.
+                     */
+                    if (!((excl >> (i*na_c + j)) & 1))
+                    {
+                        continue;
+                    }
+
+                    const int aj  = cj*na_c + j;
+                    real      dx  = xi[i*DIM + XX] - x[aj*xstride + XX];
+                    real      dy  = xi[i*DIM + YY] - x[aj*xstride + YY];
+                    real      dz  = xi[i*DIM + ZZ] - x[aj*xstride + ZZ];
+                    real      rsq = dx*dx + dy*dy + dz*dz;
+
+                    if (rsq >= rcut2)
+                    {
+                        continue;
+                    }
+
+                    // Ensure the distances do not fall below the limit where r^-12 overflows.
+                    rsq = std::max(rsq, NBNXN_MIN_RSQ);
+
+                    real rinv = gmx::invsqrt(rsq);
+                    real r    = rsq*rinv;
+                    real qq   = qi[i]*q[aj];
+                    real c6   = nbfp_i[type[aj]*2];
+                    real c12  = nbfp_i[type[aj]*2 + 1];
+
+                    real vcoul, dcoul, vdisp, ddisp, vrep, drep;
+                    table.evaluateFunctionAndDerivative(r, &vcoul, &dcoul, &vdisp, &ddisp, &vrep, &drep);
+
+                    real fscal = -(qq*dcoul + c6*ddisp + c12*drep)*rinv;
+
+                    real fx = fscal*dx;
+                    real fy = fscal*dy;
+                    real fz = fscal*dz;
+
+                    fi[i*DIM + XX]       += fx;
+                    fi[i*DIM + YY]       += fy;
+                    fi[i*DIM + ZZ]       += fz;
+                    f[aj*fstride + XX]   -= fx;
+                    f[aj*fstride + YY]   -= fy;
+                    f[aj*fstride + ZZ]   -= fz;
+
+                    if (Vc != nullptr)
+                    {
+                        int egp_ind = egp_sh_i[i];
+                        if (useEnergrp)
+                        {
+                            egp_ind += (nbat->energrp[cj] >> (j*nbat->neg_2log)) & egp_mask;
+                        }
+                        Vc[egp_ind]   += qq*vcoul;
+                        Vvdw[egp_ind] += c6*vdisp + c12*vrep;
+                    }
+                }
+            }
+        }
+
+        /* Add accumulated i-forces to the force array and the shift force */
+        for (int i = 0; i < na_c; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                f[(ci*na_c + i)*fstride + d] += fi[i*DIM + d];
+                fshift[ish*DIM + d]          += fi[i*DIM + d];
+            }
+        }
+    }
+}
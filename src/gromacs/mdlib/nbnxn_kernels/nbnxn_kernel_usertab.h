@@ -0,0 +1,107 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ *
+ * \brief Declares the nbnxn kernels for user-supplied tabulated interactions.
+ *
+ * The Coulomb, dispersion and repulsion functions are read from the user
+ * table file into a gmx::CubicSplineTable. Interactions are computed
+ * up to the cut-off; exclusions are skipped and no modifiers are applied,
+ * as with user tables in the group scheme.
+ *
+ * \ingroup __module_nb_verlet
+ */
+
+#ifndef _nbnxn_kernel_usertab_h
+#define _nbnxn_kernel_usertab_h
+
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdlib/nbnxn_pairlist.h"
+#include "gromacs/mdtypes/interaction_const.h"
+#include "gromacs/utility/real.h"
+
+namespace gmx
+{
+class CubicSplineTable;
+}
+
+/*! \brief Wrapper call for the user table kernels
+ *
+ * Calls the kernel for the atom layout of \p kernel_type for all
+ * lists in \p nbl_list, which can be plain-C 4x4 or SIMD 4xN.
+ */
+void
+nbnxn_kernel_usertab(const nbnxn_pairlist_set_t  *nbl_list,
+                     const nbnxn_atomdata_t      *nbat,
+                     const interaction_const_t   *ic,
+                     const gmx::CubicSplineTable &table,
+                     rvec                        *shift_vec,
+                     int                          kernel_type,
+                     int                          force_flags,
+                     int                          clearF,
+                     real                        *fshift,
+                     real                        *Vc,
+                     real                        *Vvdw);
+
+/*! \brief User table kernel for the plain-C 4x4 atom layout
+ *
+ * With \p Vc and \p Vvdw set to nullptr no energies are computed.
+ * The energies are accumulated in the energy group pair layout
+ * of nbnxn_atomdata_output_t, i.e. without energy groups in element 0.
+ */
+void
+nbnxn_kernel_usertab_ref(const nbnxn_pairlist_t      *nbl,
+                         const nbnxn_atomdata_t      *nbat,
+                         const interaction_const_t   *ic,
+                         const gmx::CubicSplineTable &table,
+                         const rvec                  *shift_vec,
+                         real                        *f,
+                         real                        *fshift,
+                         real                        *Vc,
+                         real                        *Vvdw);
+
+/*! \brief User table kernel for the SIMD 4xN atom layout, see nbnxn_kernel_usertab_ref */
+void
+nbnxn_kernel_usertab_4xn(const nbnxn_pairlist_t      *nbl,
+                         const nbnxn_atomdata_t      *nbat,
+                         const interaction_const_t   *ic,
+                         const gmx::CubicSplineTable &table,
+                         const rvec                  *shift_vec,
+                         real                        *f,
+                         real                        *fshift,
+                         real                        *Vc,
+                         real                        *Vvdw);
+
+#endif
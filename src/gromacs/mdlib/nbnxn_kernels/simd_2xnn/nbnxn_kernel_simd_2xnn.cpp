@@ -227,7 +227,7 @@ reduce_group_energies(int ng, int ng_2log,
     ng_p2 = (1<<ng_2log);
 
     /* The size of the x86 SIMD energy group buffer array is:
-     * ng*ng*ng_p2*unrollj_half*simd_width
+     * ng*ng*ng_p2*unrollj_half*simd_width + ng*ng*simd_width
      */
     for (i = 0; i < ng; i++)
     {
@@ -253,6 +253,20 @@ reduce_group_energies(int ng, int ng_2log,
             }
         }
     }
+
+    /* Add the compact buffer, used for cluster pairs with all atoms
+     * in a single group pair, stored after the atom pair buffer.
+     */
+    c = ng*ng*ng_p2*unrollj_half*unrollj;
+    for (i = 0; i < ng*ng; i++)
+    {
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            Vvdw[i] += VSvdw[c];
+            Vc[i]   += VSc[c];
+            c++;
+        }
+    }
 }
 
 #else /* GMX_NBNXN_SIMD_2XNN */
@@ -83,6 +83,14 @@ add_ener_grp_halves(SimdReal e_S, real *v0, real *v1, const int *offset_jj)
                       v1+offset_jj[jj]+jj*GMX_SIMD_REAL_WIDTH/2, e_S);
     }
 }
+
+/* Add energy register to a single group pair entry in the compact buffer,
+ * used when all atoms in the cluster pair are in the same group pair.
+ */
+static gmx_inline void add_ener_grp_compact(SimdReal e_S, real *v)
+{
+    store(v, load(v) + e_S);
+}
 #endif
 
 #if GMX_SIMD_HAVE_INT32_LOGICAL
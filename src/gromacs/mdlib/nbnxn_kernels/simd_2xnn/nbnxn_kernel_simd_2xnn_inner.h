@@ -68,6 +68,8 @@
 #ifdef ENERGY_GROUPS
     /* Energy group indices for two atoms packed into one int */
     int        egp_jj[UNROLLJ/2];
+    /* Offset in the compact buffer for a single group pair, -1 otherwise */
+    int        egp_cp;
 #endif
 
 #ifdef CHECK_EXCLS
@@ -797,12 +799,19 @@
      */
     {
         int egps_j;
+        /* Check if all j-atoms are in the same group as the first one */
+        int egp_j0;
+        int bUniformJ = (egp_i_uniform >= 0);
 #if UNROLLJ == 2
         egps_j    = nbat->energrp[cj>>1];
         egp_jj[0] = ((egps_j >> ((cj & 1)*egps_jshift)) & egps_jmask)*egps_jstride;
+        egp_j0    = (egps_j >> ((cj & 1)*egps_jshift)) & egps_imask;
+        bUniformJ = bUniformJ &&
+            ((egps_j >> ((cj & 1)*egps_jshift)) & egps_jmask) == egp_j0*(1 + (1<<egps_ishift));
 #else
         /* We assume UNROLLI <= UNROLLJ */
         int jdi;
+        egp_j0 = nbat->energrp[cj*(UNROLLJ/UNROLLI)] & egps_imask;
         for (jdi = 0; jdi < UNROLLJ/UNROLLI; jdi++)
         {
             int jj;
@@ -811,8 +820,10 @@
             {
                 egp_jj[jdi*(UNROLLI/2)+jj] = ((egps_j >> (jj*egps_jshift)) & egps_jmask)*egps_jstride;
             }
+            bUniformJ = bUniformJ && (egps_j == egp_j0*egps_iuniform);
         }
 #endif
+        egp_cp = (bUniformJ ? (egp_i_uniform + egp_j0)*GMX_SIMD_REAL_WIDTH : -1);
     }
 #endif
 
@@ -820,8 +831,15 @@
 #ifndef ENERGY_GROUPS
     vctot_S      = vctot_S + vcoul_S0 + vcoul_S2;
 #else
-    add_ener_grp_halves(vcoul_S0, vctp[0], vctp[1], egp_jj);
-    add_ener_grp_halves(vcoul_S2, vctp[2], vctp[3], egp_jj);
+    if (egp_cp >= 0)
+    {
+        add_ener_grp_compact(vcoul_S0 + vcoul_S2, vc_compact + egp_cp);
+    }
+    else
+    {
+        add_ener_grp_halves(vcoul_S0, vctp[0], vctp[1], egp_jj);
+        add_ener_grp_halves(vcoul_S2, vctp[2], vctp[3], egp_jj);
+    }
 #endif
 #endif
 
@@ -833,10 +851,21 @@
 #endif
     ;
 #else
-    add_ener_grp_halves(VLJ_S0, vvdwtp[0], vvdwtp[1], egp_jj);
+    if (egp_cp >= 0)
+    {
 #ifndef HALF_LJ
-    add_ener_grp_halves(VLJ_S2, vvdwtp[2], vvdwtp[3], egp_jj);
+        add_ener_grp_compact(VLJ_S0 + VLJ_S2, vvdw_compact + egp_cp);
+#else
+        add_ener_grp_compact(VLJ_S0, vvdw_compact + egp_cp);
 #endif
+    }
+    else
+    {
+        add_ener_grp_halves(VLJ_S0, vvdwtp[0], vvdwtp[1], egp_jj);
+#ifndef HALF_LJ
+        add_ener_grp_halves(VLJ_S2, vvdwtp[2], vvdwtp[3], egp_jj);
+#endif
+    }
 #endif
 #endif /* CALC_LJ */
 #endif /* CALC_ENERGIES */
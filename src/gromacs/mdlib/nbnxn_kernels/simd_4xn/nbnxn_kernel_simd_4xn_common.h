@@ -89,6 +89,14 @@ static gmx_inline void add_ener_grp(SimdReal e_S, real *v, const int *offset_jj)
         store(v+offset_jj[jj]+jj*GMX_SIMD_REAL_WIDTH, v_S + e_S);
     }
 }
+
+/* Add energy register to a single group pair entry in the compact buffer,
+ * used when all atoms in the cluster pair are in the same group pair.
+ */
+static gmx_inline void add_ener_grp_compact(SimdReal e_S, real *v)
+{
+    store(v, load(v) + e_S);
+}
 #endif
 
 #if GMX_SIMD_HAVE_INT32_LOGICAL
@@ -62,6 +62,8 @@
 #ifdef ENERGY_GROUPS
     /* Energy group indices for two atoms packed into one int */
     int        egp_jj[UNROLLJ/2];
+    /* Offset in the compact buffer for a single group pair, -1 otherwise */
+    int        egp_cp;
 #endif
 
 #ifdef CHECK_EXCLS
@@ -1063,12 +1065,19 @@
      */
     {
         int egps_j;
+        /* Check if all j-atoms are in the same group as the first one */
+        int egp_j0;
+        int bUniformJ = (egp_i_uniform >= 0);
 #if UNROLLJ == 2
         egps_j    = nbat->energrp[cj>>1];
         egp_jj[0] = ((egps_j >> ((cj & 1)*egps_jshift)) & egps_jmask)*egps_jstride;
+        egp_j0    = (egps_j >> ((cj & 1)*egps_jshift)) & egps_imask;
+        bUniformJ = bUniformJ &&
+            ((egps_j >> ((cj & 1)*egps_jshift)) & egps_jmask) == egp_j0*(1 + (1<<egps_ishift));
 #else
         /* We assume UNROLLI <= UNROLLJ */
         int jdi;
+        egp_j0 = nbat->energrp[cj*(UNROLLJ/UNROLLI)] & egps_imask;
         for (jdi = 0; jdi < UNROLLJ/UNROLLI; jdi++)
         {
             int jj;
@@ -1077,8 +1086,10 @@
             {
                 egp_jj[jdi*(UNROLLI/2)+jj] = ((egps_j >> (jj*egps_jshift)) & egps_jmask)*egps_jstride;
             }
+            bUniformJ = bUniformJ && (egps_j == egp_j0*egps_iuniform);
         }
 #endif
+        egp_cp = (bUniformJ ? (egp_i_uniform + egp_j0)*GMX_SIMD_REAL_WIDTH : -1);
     }
 #endif
 
@@ -1086,10 +1097,17 @@
 #ifndef ENERGY_GROUPS
     vctot_S      = vctot_S + vcoul_S0 + vcoul_S1 + vcoul_S2 + vcoul_S3;
 #else
-    add_ener_grp(vcoul_S0, vctp[0], egp_jj);
-    add_ener_grp(vcoul_S1, vctp[1], egp_jj);
-    add_ener_grp(vcoul_S2, vctp[2], egp_jj);
-    add_ener_grp(vcoul_S3, vctp[3], egp_jj);
+    if (egp_cp >= 0)
+    {
+        add_ener_grp_compact(vcoul_S0 + vcoul_S1 + vcoul_S2 + vcoul_S3, vc_compact + egp_cp);
+    }
+    else
+    {
+        add_ener_grp(vcoul_S0, vctp[0], egp_jj);
+        add_ener_grp(vcoul_S1, vctp[1], egp_jj);
+        add_ener_grp(vcoul_S2, vctp[2], egp_jj);
+        add_ener_grp(vcoul_S3, vctp[3], egp_jj);
+    }
 #endif
 #endif
 
@@ -1102,12 +1120,23 @@
     Vvdwtot_S   = Vvdwtot_S + VLJ_S0 + VLJ_S1;
 #endif
 #else
-    add_ener_grp(VLJ_S0, vvdwtp[0], egp_jj);
-    add_ener_grp(VLJ_S1, vvdwtp[1], egp_jj);
+    if (egp_cp >= 0)
+    {
 #ifndef HALF_LJ
-    add_ener_grp(VLJ_S2, vvdwtp[2], egp_jj);
-    add_ener_grp(VLJ_S3, vvdwtp[3], egp_jj);
+        add_ener_grp_compact(VLJ_S0 + VLJ_S1 + VLJ_S2 + VLJ_S3, vvdw_compact + egp_cp);
+#else
+        add_ener_grp_compact(VLJ_S0 + VLJ_S1, vvdw_compact + egp_cp);
 #endif
+    }
+    else
+    {
+        add_ener_grp(VLJ_S0, vvdwtp[0], egp_jj);
+        add_ener_grp(VLJ_S1, vvdwtp[1], egp_jj);
+#ifndef HALF_LJ
+        add_ener_grp(VLJ_S2, vvdwtp[2], egp_jj);
+        add_ener_grp(VLJ_S3, vvdwtp[3], egp_jj);
+#endif
+    }
 #endif
 #endif /* CALC_LJ */
 #endif /* CALC_ENERGIES */
@@ -53,6 +53,8 @@
     int         egps_i;
     real       *vvdwtp[UNROLLI];
     real       *vctp[UNROLLI];
+    int         egps_iuniform, egp_i_uniform;
+    real       *vvdw_compact, *vc_compact;
 #endif
 
     SimdReal  shX_S;
@@ -368,6 +370,17 @@
     egps_jstride = (UNROLLJ>>1)*UNROLLJ;
     /* Major division is over i-particle energy groups, determine the stride */
     Vstride_i    = nbat->nenergrp*(1<<nbat->neg_2log)*egps_jstride;
+    /* The packed group indices of a cluster with all atoms in group g
+     * are g*egps_iuniform.
+     */
+    egps_iuniform = 0;
+    for (int ia = 0; ia < UNROLLI; ia++)
+    {
+        egps_iuniform |= 1<<(ia*egps_ishift);
+    }
+    /* The compact group pair buffer is stored after the atom pair buffer */
+    vvdw_compact = Vvdw + nbat->nenergrp*Vstride_i;
+    vc_compact   = Vc   + nbat->nenergrp*Vstride_i;
 #endif
 
     l_cj = nbl->cj;
@@ -426,6 +439,14 @@
                 vctp[ia]   = Vc   + egp_ia*Vstride_i;
             }
         }
+        /* When all i-atoms are in the same group, store the group index
+         * times the number of groups, for indexing the compact buffer.
+         */
+        egp_i_uniform = -1;
+        if (egps_i == (egps_i & egps_imask)*egps_iuniform)
+        {
+            egp_i_uniform = (egps_i & egps_imask)*nbat->nenergrp;
+        }
 #endif
 
 #ifdef CALC_ENERGIES
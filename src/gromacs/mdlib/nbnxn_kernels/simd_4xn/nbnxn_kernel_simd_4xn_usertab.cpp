@@ -0,0 +1,375 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+#include "gmxpre.h"
+
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_usertab.h"
+
+#include "gromacs/mdlib/nbnxn_consts.h"
+#include "gromacs/mdlib/nbnxn_simd.h"
+#include "gromacs/tables/cubicsplinetable.h"
+#include "gromacs/utility/gmxassert.h"
+
+#ifdef GMX_NBNXN_SIMD_4XN
+#define GMX_SIMD_J_UNROLL_SIZE 1
+#include "gromacs/mdlib/nbnxn_kernels/simd_4xn/nbnxn_kernel_simd_4xn_common.h"
+
+/* Computes the scalar force and the energies, masked with \p wco_S,
+ * for one i-atom with all j-atoms using the user table.
+ */
+static gmx_inline void gmx_simdcall
+usertab_interactions(const gmx::CubicSplineTable &table,
+                     SimdReal                     rsq_S,
+                     SimdBool                     wco_S,
+                     SimdReal                     qq_S,
+                     SimdReal                     c6_S,
+                     SimdReal                     c12_S,
+                     SimdReal                    *fscal_S,
+                     SimdReal                    *vcoul_S,
+                     SimdReal                    *vvdw_S)
+{
+    // Ensure the distances do not fall below the limit where r^-12 overflows.
+    // This should never happen for normal interactions.
+    rsq_S = max(rsq_S, SimdReal(NBNXN_MIN_RSQ));
+
+    /* Masked pairs get r=0, which is always within the table */
+    SimdReal rinv_S = selectByMask(invsqrt(rsq_S), wco_S);
+    SimdReal r_S    = rsq_S*rinv_S;
+
+    SimdReal vc_S, dc_S, vd_S, dd_S, vr_S, dr_S;
+    table.evaluateFunctionAndDerivative(r_S, &vc_S, &dc_S, &vd_S, &dd_S, &vr_S, &dr_S);
+
+    *fscal_S = -rinv_S*fma(qq_S, dc_S, fma(c6_S, dd_S, c12_S*dr_S));
+    *vcoul_S = selectByMask(qq_S*vc_S, wco_S);
+    *vvdw_S  = selectByMask(fma(c6_S, vd_S, c12_S*vr_S), wco_S);
+}
+
+/* Adds the energies of i-atom \p egp_sh_i with the j-atoms in \p egp_j
+ * to the energy group pair output.
+ */
+static void
+add_energies_usertab(SimdReal   vcoul_S,
+                     SimdReal   vvdw_S,
+                     int        egp_sh_i,
+                     const int *egp_j,
+                     real      *Vc,
+                     real      *Vvdw)
+{
+    GMX_ALIGNED(real, GMX_SIMD_REAL_WIDTH) vcoul[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(real, GMX_SIMD_REAL_WIDTH) vvdw[GMX_SIMD_REAL_WIDTH];
+
+    store(vcoul, vcoul_S);
+    store(vvdw, vvdw_S);
+    for (int j = 0; j < UNROLLJ; j++)
+    {
+        Vc[egp_sh_i + egp_j[j]]   += vcoul[j];
+        Vvdw[egp_sh_i + egp_j[j]] += vvdw[j];
+    }
+}
+#endif /* GMX_NBNXN_SIMD_4XN */
+
+void
+nbnxn_kernel_usertab_4xn(const nbnxn_pairlist_t gmx_unused      *nbl,
+                         const nbnxn_atomdata_t gmx_unused      *nbat,
+                         const interaction_const_t gmx_unused   *ic,
+                         const gmx::CubicSplineTable gmx_unused &table,
+                         const rvec gmx_unused                  *shift_vec,
+                         real gmx_unused                        *f,
+                         real gmx_unused                        *fshift,
+                         real gmx_unused                        *Vc,
+                         real gmx_unused                        *Vvdw)
+{
+#ifdef GMX_NBNXN_SIMD_4XN
+    const nbnxn_cj_t * gmx_restrict l_cj     = nbl->cj;
+    const int        * gmx_restrict type     = nbat->type;
+    const real       * gmx_restrict q        = nbat->q;
+    const real       * gmx_restrict x        = nbat->x;
+    const real       * gmx_restrict nbfp_ptr = nbat->nbfp_aligned;
+    const real       * gmx_restrict shiftvec = shift_vec[0];
+    const real                      facel    = ic->epsfac;
+    const bool                      useEnergrp = (nbat->nenergrp > 1);
+    const int                       egp_mask   = (1 << nbat->neg_2log) - 1;
+
+    const SimdReal                  rc2_S(ic->rcoulomb*ic->rcoulomb);
+
+#if GMX_DOUBLE && !GMX_SIMD_HAVE_INT32_LOGICAL
+    const std::uint64_t            *exclusion_filter = nbat->simd_exclusion_filter64;
+#else
+    const std::uint32_t            *exclusion_filter = nbat->simd_exclusion_filter;
+#endif
+
+    /* Here we cast the exclusion filters from unsigned * to int * or real *.
+     * Since we only check bits, the actual value they represent does not
+     * matter, as long as both filter and mask data are treated the same way.
+     */
+#if GMX_SIMD_HAVE_INT32_LOGICAL
+    SimdBitMask filter_S0 = load(reinterpret_cast<const int *>(exclusion_filter + 0*UNROLLJ));
+    SimdBitMask filter_S1 = load(reinterpret_cast<const int *>(exclusion_filter + 1*UNROLLJ));
+    SimdBitMask filter_S2 = load(reinterpret_cast<const int *>(exclusion_filter + 2*UNROLLJ));
+    SimdBitMask filter_S3 = load(reinterpret_cast<const int *>(exclusion_filter + 3*UNROLLJ));
+#else
+    SimdBitMask filter_S0 = load(reinterpret_cast<const real *>(exclusion_filter + 0*UNROLLJ));
+    SimdBitMask filter_S1 = load(reinterpret_cast<const real *>(exclusion_filter + 1*UNROLLJ));
+    SimdBitMask filter_S2 = load(reinterpret_cast<const real *>(exclusion_filter + 2*UNROLLJ));
+    SimdBitMask filter_S3 = load(reinterpret_cast<const real *>(exclusion_filter + 3*UNROLLJ));
+#endif
+
+    for (int n = 0; n < nbl->nci; n++)
+    {
+        const nbnxn_ci_t * gmx_restrict nbln = &nbl->ci[n];
+
+        int ish = (nbln->shift & NBNXN_CI_SHIFT);
+        int ci  = nbln->ci;
+
+        SimdReal shX_S(shiftvec[ish*DIM + XX]);
+        SimdReal shY_S(shiftvec[ish*DIM + YY]);
+        SimdReal shZ_S(shiftvec[ish*DIM + ZZ]);
+
+#if UNROLLJ <= 4
+        int sci  = ci*STRIDE;
+        int scix = sci*DIM;
+#else
+        int sci  = (ci >> 1)*STRIDE;
+        int scix = sci*DIM + (ci & 1)*(STRIDE >> 1);
+        sci     += (ci & 1)*(STRIDE >> 1);
+#endif
+
+        /* Load i atom data */
+        int      sciy  = scix + STRIDE;
+        int      sciz  = sciy + STRIDE;
+        SimdReal ix_S0 = SimdReal(x[scix    ]) + shX_S;
+        SimdReal ix_S1 = SimdReal(x[scix + 1]) + shX_S;
+        SimdReal ix_S2 = SimdReal(x[scix + 2]) + shX_S;
+        SimdReal ix_S3 = SimdReal(x[scix + 3]) + shX_S;
+        SimdReal iy_S0 = SimdReal(x[sciy    ]) + shY_S;
+        SimdReal iy_S1 = SimdReal(x[sciy + 1]) + shY_S;
+        SimdReal iy_S2 = SimdReal(x[sciy + 2]) + shY_S;
+        SimdReal iy_S3 = SimdReal(x[sciy + 3]) + shY_S;
+        SimdReal iz_S0 = SimdReal(x[sciz    ]) + shZ_S;
+        SimdReal iz_S1 = SimdReal(x[sciz + 1]) + shZ_S;
+        SimdReal iz_S2 = SimdReal(x[sciz + 2]) + shZ_S;
+        SimdReal iz_S3 = SimdReal(x[sciz + 3]) + shZ_S;
+
+        SimdReal iq_S0 = SimdReal(facel*q[sci    ]);
+        SimdReal iq_S1 = SimdReal(facel*q[sci + 1]);
+        SimdReal iq_S2 = SimdReal(facel*q[sci + 2]);
+        SimdReal iq_S3 = SimdReal(facel*q[sci + 3]);
+
+        const real *nbfp0 = nbfp_ptr + type[sci    ]*nbat->ntype*c_simdBestPairAlignment;
+        const real *nbfp1 = nbfp_ptr + type[sci + 1]*nbat->ntype*c_simdBestPairAlignment;
+        const real *nbfp2 = nbfp_ptr + type[sci + 2]*nbat->ntype*c_simdBestPairAlignment;
+        const real *nbfp3 = nbfp_ptr + type[sci + 3]*nbat->ntype*c_simdBestPairAlignment;
+
+        int egp_sh_i[UNROLLI] = { 0 };
+        if (useEnergrp)
+        {
+            for (int i = 0; i < UNROLLI; i++)
+            {
+                egp_sh_i[i] = ((nbat->energrp[ci] >> (i*nbat->neg_2log)) & egp_mask)*nbat->nenergrp;
+            }
+        }
+
+        SimdReal vctot_S   = setZero();
+        SimdReal Vvdwtot_S = setZero();
+
+        SimdReal fix_S0    = setZero();
+        SimdReal fix_S1    = setZero();
+        SimdReal fix_S2    = setZero();
+        SimdReal fix_S3    = setZero();
+        SimdReal fiy_S0    = setZero();
+        SimdReal fiy_S1    = setZero();
+        SimdReal fiy_S2    = setZero();
+        SimdReal fiy_S3    = setZero();
+        SimdReal fiz_S0    = setZero();
+        SimdReal fiz_S1    = setZero();
+        SimdReal fiz_S2    = setZero();
+        SimdReal fiz_S3    = setZero();
+
+        for (int cjind = nbln->cj_ind_start; cjind < nbln->cj_ind_end; cjind++)
+        {
+            /* j-cluster index */
+            int cj  = l_cj[cjind].cj;
+
+            /* Atom indices (of the first atom in the cluster) */
+            int aj  = cj*UNROLLJ;
+#if UNROLLJ == STRIDE
+            int ajx = aj*DIM;
+#else
+            int ajx = (cj >> 1)*DIM*STRIDE + (cj & 1)*UNROLLJ;
+#endif
+            int ajy = ajx + STRIDE;
+            int ajz = ajy + STRIDE;
+
+            /* Excluded pairs are skipped, as with user tables
+             * in the group scheme.
+             */
+            SimdBool interact_S0, interact_S1, interact_S2, interact_S3;
+            gmx_load_simd_4xn_interactions(l_cj[cjind].excl,
+                                           filter_S0, filter_S1,
+                                           filter_S2, filter_S3,
+                                           nbat->simd_interaction_array,
+                                           &interact_S0, &interact_S1,
+                                           &interact_S2, &interact_S3);
+
+            /* load j atom coordinates */
+            SimdReal jx_S  = load(x + ajx);
+            SimdReal jy_S  = load(x + ajy);
+            SimdReal jz_S  = load(x + ajz);
+
+            /* Calculate distance */
+            SimdReal dx_S0 = ix_S0 - jx_S;
+            SimdReal dy_S0 = iy_S0 - jy_S;
+            SimdReal dz_S0 = iz_S0 - jz_S;
+            SimdReal dx_S1 = ix_S1 - jx_S;
+            SimdReal dy_S1 = iy_S1 - jy_S;
+            SimdReal dz_S1 = iz_S1 - jz_S;
+            SimdReal dx_S2 = ix_S2 - jx_S;
+            SimdReal dy_S2 = iy_S2 - jy_S;
+            SimdReal dz_S2 = iz_S2 - jz_S;
+            SimdReal dx_S3 = ix_S3 - jx_S;
+            SimdReal dy_S3 = iy_S3 - jy_S;
+            SimdReal dz_S3 = iz_S3 - jz_S;
+
+            /* rsq = dx*dx+dy*dy+dz*dz */
+            SimdReal rsq_S0 = norm2(dx_S0, dy_S0, dz_S0);
+            SimdReal rsq_S1 = norm2(dx_S1, dy_S1, dz_S1);
+            SimdReal rsq_S2 = norm2(dx_S2, dy_S2, dz_S2);
+            SimdReal rsq_S3 = norm2(dx_S3, dy_S3, dz_S3);
+
+            /* Do the cut-off check and remove excluded pairs */
+            SimdBool wco_S0 = (rsq_S0 < rc2_S) && interact_S0;
+            SimdBool wco_S1 = (rsq_S1 < rc2_S) && interact_S1;
+            SimdBool wco_S2 = (rsq_S2 < rc2_S) && interact_S2;
+            SimdBool wco_S3 = (rsq_S3 < rc2_S) && interact_S3;
+
+            /* Load j atom charges and the LJ parameters */
+            SimdReal jq_S   = load(q + aj);
+            SimdReal c6_S0, c6_S1, c6_S2, c6_S3;
+            SimdReal c12_S0, c12_S1, c12_S2, c12_S3;
+            gatherLoadTranspose<c_simdBestPairAlignment>(nbfp0, type + aj, &c6_S0, &c12_S0);
+            gatherLoadTranspose<c_simdBestPairAlignment>(nbfp1, type + aj, &c6_S1, &c12_S1);
+            gatherLoadTranspose<c_simdBestPairAlignment>(nbfp2, type + aj, &c6_S2, &c12_S2);
+            gatherLoadTranspose<c_simdBestPairAlignment>(nbfp3, type + aj, &c6_S3, &c12_S3);
+
+            SimdReal fscal_S0, vcoul_S0, vvdw_S0;
+            SimdReal fscal_S1, vcoul_S1, vvdw_S1;
+            SimdReal fscal_S2, vcoul_S2, vvdw_S2;
+            SimdReal fscal_S3, vcoul_S3, vvdw_S3;
+            usertab_interactions(table, rsq_S0, wco_S0, iq_S0*jq_S, c6_S0, c12_S0,
+                                 &fscal_S0, &vcoul_S0, &vvdw_S0);
+            usertab_interactions(table, rsq_S1, wco_S1, iq_S1*jq_S, c6_S1, c12_S1,
+                                 &fscal_S1, &vcoul_S1, &vvdw_S1);
+            usertab_interactions(table, rsq_S2, wco_S2, iq_S2*jq_S, c6_S2, c12_S2,
+                                 &fscal_S2, &vcoul_S2, &vvdw_S2);
+            usertab_interactions(table, rsq_S3, wco_S3, iq_S3*jq_S, c6_S3, c12_S3,
+                                 &fscal_S3, &vcoul_S3, &vvdw_S3);
+
+            if (Vc != nullptr)
+            {
+                if (!useEnergrp)
+                {
+                    vctot_S   = vctot_S + vcoul_S0 + vcoul_S1 + vcoul_S2 + vcoul_S3;
+                    Vvdwtot_S = Vvdwtot_S + vvdw_S0 + vvdw_S1 + vvdw_S2 + vvdw_S3;
+                }
+                else
+                {
+                    int egp_j[UNROLLJ];
+                    for (int j = 0; j < UNROLLJ; j++)
+                    {
+                        egp_j[j] = (nbat->energrp[(aj + j)/UNROLLI] >> (((aj + j) % UNROLLI)*nbat->neg_2log)) & egp_mask;
+                    }
+                    add_energies_usertab(vcoul_S0, vvdw_S0, egp_sh_i[0], egp_j, Vc, Vvdw);
+                    add_energies_usertab(vcoul_S1, vvdw_S1, egp_sh_i[1], egp_j, Vc, Vvdw);
+                    add_energies_usertab(vcoul_S2, vvdw_S2, egp_sh_i[2], egp_j, Vc, Vvdw);
+                    add_energies_usertab(vcoul_S3, vvdw_S3, egp_sh_i[3], egp_j, Vc, Vvdw);
+                }
+            }
+
+            /* Calculate temporary vectorial force */
+            SimdReal tx_S0 = fscal_S0*dx_S0;
+            SimdReal tx_S1 = fscal_S1*dx_S1;
+            SimdReal tx_S2 = fscal_S2*dx_S2;
+            SimdReal tx_S3 = fscal_S3*dx_S3;
+            SimdReal ty_S0 = fscal_S0*dy_S0;
+            SimdReal ty_S1 = fscal_S1*dy_S1;
+            SimdReal ty_S2 = fscal_S2*dy_S2;
+            SimdReal ty_S3 = fscal_S3*dy_S3;
+            SimdReal tz_S0 = fscal_S0*dz_S0;
+            SimdReal tz_S1 = fscal_S1*dz_S1;
+            SimdReal tz_S2 = fscal_S2*dz_S2;
+            SimdReal tz_S3 = fscal_S3*dz_S3;
+
+            /* Increment i atom force */
+            fix_S0 = fix_S0 + tx_S0;
+            fix_S1 = fix_S1 + tx_S1;
+            fix_S2 = fix_S2 + tx_S2;
+            fix_S3 = fix_S3 + tx_S3;
+            fiy_S0 = fiy_S0 + ty_S0;
+            fiy_S1 = fiy_S1 + ty_S1;
+            fiy_S2 = fiy_S2 + ty_S2;
+            fiy_S3 = fiy_S3 + ty_S3;
+            fiz_S0 = fiz_S0 + tz_S0;
+            fiz_S1 = fiz_S1 + tz_S1;
+            fiz_S2 = fiz_S2 + tz_S2;
+            fiz_S3 = fiz_S3 + tz_S3;
+
+            /* Decrement j atom force */
+            store(f + ajx, load(f + ajx) - (tx_S0 + tx_S1 + tx_S2 + tx_S3));
+            store(f + ajy, load(f + ajy) - (ty_S0 + ty_S1 + ty_S2 + ty_S3));
+            store(f + ajz, load(f + ajz) - (tz_S0 + tz_S1 + tz_S2 + tz_S3));
+        }
+
+        /* Add accumulated i-forces to the force array */
+        real fShiftX = reduceIncr4ReturnSum(f + scix, fix_S0, fix_S1, fix_S2, fix_S3);
+        real fShiftY = reduceIncr4ReturnSum(f + sciy, fiy_S0, fiy_S1, fiy_S2, fiy_S3);
+        real fShiftZ = reduceIncr4ReturnSum(f + sciz, fiz_S0, fiz_S1, fiz_S2, fiz_S3);
+
+        fshift[ish*DIM + XX] += fShiftX;
+        fshift[ish*DIM + YY] += fShiftY;
+        fshift[ish*DIM + ZZ] += fShiftZ;
+
+        if (Vc != nullptr && !useEnergrp)
+        {
+            Vc[0]   += reduce(vctot_S);
+            Vvdw[0] += reduce(Vvdwtot_S);
+        }
+    }
+
+#else  /* GMX_NBNXN_SIMD_4XN */
+
+    GMX_RELEASE_ASSERT(false, "4xN kernel called without 4xN support");
+
+#endif /* GMX_NBNXN_SIMD_4XN */
+}
@@ -170,6 +170,16 @@ typedef struct nbnxn_pairlist_t {
     int                     cj_nalloc;   /* The allocation size of cj                */
     int                     ncjInUse;    /* The number of j-clusters that are used by ci entries in this list, will be <= ncj */
 
+    /* With dynamic pruning, the list built by the search is moved to
+     * the outer list below and ci/cj contain the pruned, inner list.
+     */
+    int                     nciOuter;       /* The number of i-clusters in the outer list, -1 when the list has not been pruned since the search */
+    nbnxn_ci_t             *ciOuter;        /* The outer i-cluster list, size nciOuter  */
+    int                     ciOuter_nalloc; /* The allocation size of ciOuter           */
+    int                     ncjOuter;       /* The number of j-clusters in the outer list */
+    nbnxn_cj_t             *cjOuter;        /* The outer j-cluster list, size ncjOuter  */
+    int                     cjOuter_nalloc; /* The allocation size of cjOuter           */
+
     int                     ncj4;        /* The total number of 4*j clusters         */
     nbnxn_cj4_t            *cj4;         /* The 4*j cluster list, size ncj4          */
     int                     cj4_nalloc;  /* The allocation size of cj4               */
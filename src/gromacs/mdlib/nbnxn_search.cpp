@@ -824,6 +824,12 @@ static void nbnxn_init_pairlist(nbnxn_pairlist_t *nbl,
     nbl->ncjInUse    = 0;
     nbl->cj          = nullptr;
     nbl->cj_nalloc   = 0;
+    nbl->nciOuter       = -1;
+    nbl->ciOuter        = nullptr;
+    nbl->ciOuter_nalloc = 0;
+    nbl->ncjOuter       = 0;
+    nbl->cjOuter        = nullptr;
+    nbl->cjOuter_nalloc = 0;
     nbl->ncj4        = 0;
     /* We need one element extra in sj, so alloc initially with 1 */
     nbl->cj4_nalloc  = 0;
@@ -2391,6 +2397,8 @@ static void clear_pairlist(nbnxn_pairlist_t *nbl)
     nbl->ncj4          = 0;
     nbl->nci_tot       = 0;
     nbl->nexcl         = 1;
+    /* A new list has not been pruned */
+    nbl->nciOuter      = -1;
 
     nbl->work->ncj_noq = 0;
     nbl->work->ncj_hlj = 0;
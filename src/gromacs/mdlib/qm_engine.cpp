@@ -0,0 +1,324 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ *
+ * \brief Implements the support for in-process QM engines in QM/MM.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "qm_engine.h"
+
+#include "config.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <vector>
+
+#include "gromacs/math/units.h"
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/fatalerror.h"
+
+#if GMX_USE_PLUGINS
+#include "external/vmd_molfile/vmddlopen.h"
+#endif
+
+struct t_QMengine
+{
+    const gmx_qm_engine_functions_t *functions;     /* The engine callbacks                    */
+    void                            *engineData;    /* Data set by the engine in init          */
+    void                            *libraryHandle; /* Handle of the engine library, or NULL   */
+    std::vector<double>              xQM;           /* QM coordinates passed to the engine     */
+    std::vector<double>              qQM;           /* QM force-field charges                  */
+    std::vector<double>              xMM;           /* MM coordinates passed to the engine     */
+    std::vector<double>              qMM;           /* MM point charges                        */
+    std::vector<double>              gradQM;        /* Gradients on the QM atoms               */
+    std::vector<double>              gradMM;        /* Gradients on the MM atoms               */
+};
+
+/* The damping length of the Coulomb interactions of the point-charge engine, in nm */
+static const double c_pointChargeDamping = 0.05;
+
+/* Adds the damped Coulomb gradient of a pair of charges to gi and gj,
+ * returns the energy.
+ */
+static double pointcharge_pair(const double *xi, double qi,
+                             const double *xj, double qj,
+                             double *gi, double *gj)
+{
+    double dx[DIM];
+    double r2 = c_pointChargeDamping*c_pointChargeDamping;
+    for (int d = 0; d < DIM; d++)
+    {
+        dx[d] = xi[d] - xj[d];
+        r2   += dx[d]*dx[d];
+    }
+    double rinv   = 1/std::sqrt(r2);
+    double energy = ONE_4PI_EPS0*qi*qj*rinv;
+    double fscal  = energy*rinv*rinv;
+    for (int d = 0; d < DIM; d++)
+    {
+        gi[d] -= fscal*dx[d];
+        gj[d] += fscal*dx[d];
+    }
+
+    return energy;
+}
+
+static int pointcharge_init(const gmx_qm_system_t gmx_unused *system,
+                          void                              **engineData)
+{
+    *engineData = nullptr;
+
+    return 0;
+}
+
+static int pointcharge_calculate(void gmx_unused        *engineData,
+                               const gmx_qm_system_t  *system,
+                               double                 *energy,
+                               double                 *gradQM,
+                               double                 *gradMM)
+{
+    for (int i = 0; i < DIM*system->nQM; i++)
+    {
+        gradQM[i] = 0;
+    }
+    for (int i = 0; i < DIM*system->nMM; i++)
+    {
+        gradMM[i] = 0;
+    }
+
+    *energy = 0;
+    for (int i = 0; i < system->nQM; i++)
+    {
+        const double *xi = system->xQM + DIM*i;
+        double        qi = system->qQM[i];
+        for (int j = i + 1; j < system->nQM; j++)
+        {
+            *energy += pointcharge_pair(xi, qi, system->xQM + DIM*j, system->qQM[j],
+                                      gradQM + DIM*i, gradQM + DIM*j);
+        }
+        for (int j = 0; j < system->nMM; j++)
+        {
+            *energy += pointcharge_pair(xi, qi, system->xMM + DIM*j, system->qMM[j],
+                                      gradQM + DIM*i, gradMM + DIM*j);
+        }
+    }
+
+    return 0;
+}
+
+const gmx_qm_engine_functions_t *gmx_qm_pointcharge_engine()
+{
+    static const gmx_qm_engine_functions_t functions = {
+        GMX_QM_ENGINE_INTERFACE_VERSION,
+        "pointcharge",
+        pointcharge_init,
+        pointcharge_calculate,
+        nullptr
+    };
+
+    return &functions;
+}
+
+/* Loads an engine library and returns its functions */
+static const gmx_qm_engine_functions_t *
+load_QMengine_library(const char *fileName, void **libraryHandle)
+{
+#if GMX_USE_PLUGINS
+    *libraryHandle = vmddlopen(fileName);
+    if (*libraryHandle == nullptr)
+    {
+        gmx_fatal(FARGS, "Could not load the QM engine library '%s': %s",
+                  fileName, vmddlerror());
+    }
+    void *entry = vmddlsym(*libraryHandle, GMX_QM_ENGINE_ENTRY_NAME);
+    if (entry == nullptr)
+    {
+        gmx_fatal(FARGS, "The QM engine library '%s' does not provide the function %s",
+                  fileName, GMX_QM_ENGINE_ENTRY_NAME);
+    }
+
+    return ((gmx_qm_engine_entry_t *)entry)();
+#else
+    GMX_UNUSED_VALUE(libraryHandle);
+    gmx_fatal(FARGS, "Can not load the QM engine library '%s', since this GROMACS "
+              "build does not support loading shared libraries", fileName);
+
+    return nullptr;
+#endif
+}
+
+/* Fills the engine buffers and returns the system description for the engine */
+static gmx_qm_system_t set_QMsystem(t_QMengine    *engine,
+                                    const t_QMrec *qm,
+                                    const t_MMrec *mm)
+{
+    gmx_qm_system_t system;
+
+    engine->xQM.resize(DIM*qm->nrQMatoms);
+    engine->qQM.resize(qm->nrQMatoms);
+    for (int i = 0; i < qm->nrQMatoms; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            engine->xQM[DIM*i + d] = qm->xQM[i][d];
+        }
+        engine->qQM[i] = (qm->QMcharges ? qm->QMcharges[i] : 0);
+    }
+    int nMM = (mm != nullptr ? mm->nrMMatoms : 0);
+    engine->xMM.resize(DIM*nMM);
+    engine->qMM.resize(nMM);
+    for (int i = 0; i < nMM; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            engine->xMM[DIM*i + d] = mm->xMM[i][d];
+        }
+        engine->qMM[i] = mm->MMcharges[i];
+    }
+
+    system.nQM          = qm->nrQMatoms;
+    system.atomicNumber = qm->atomicnumberQM;
+    system.xQM          = engine->xQM.data();
+    system.qQM          = engine->qQM.data();
+    system.charge       = qm->QMcharge;
+    system.multiplicity = qm->multiplicity;
+    system.method       = qm->QMmethod;
+    system.basis        = qm->QMbasis;
+    system.nMM          = nMM;
+    system.xMM          = engine->xMM.data();
+    system.qMM          = engine->qMM.data();
+
+    return system;
+}
+
+t_QMengine *init_QMengine(const t_QMrec *qm)
+{
+    const char *name = getenv("GMX_QM_ENGINE");
+
+    if (name == nullptr)
+    {
+        return nullptr;
+    }
+
+    t_QMengine *engine    = new t_QMengine;
+    engine->libraryHandle = nullptr;
+    if (strcmp(name, "pointcharge") == 0)
+    {
+        engine->functions = gmx_qm_pointcharge_engine();
+    }
+    else
+    {
+        engine->functions = load_QMengine_library(name, &engine->libraryHandle);
+    }
+    if (engine->functions == nullptr ||
+        engine->functions->interfaceVersion != GMX_QM_ENGINE_INTERFACE_VERSION)
+    {
+        gmx_fatal(FARGS, "The QM engine '%s' does not implement version %d of the QM engine interface",
+                  name, GMX_QM_ENGINE_INTERFACE_VERSION);
+    }
+    fprintf(stderr, "Using the in-process QM engine '%s'\n", engine->functions->name);
+
+    gmx_qm_system_t system = set_QMsystem(engine, qm, nullptr);
+    engine->engineData     = nullptr;
+    int             rc     = engine->functions->init(&system, &engine->engineData);
+    if (rc != 0)
+    {
+        gmx_fatal(FARGS, "Initializing the QM engine '%s' failed with error code %d",
+                  engine->functions->name, rc);
+    }
+
+    return engine;
+}
+
+real call_QMengine(t_QMengine *engine,
+                   const t_QMrec *qm, const t_MMrec *mm,
+                   rvec f[], rvec fshift[])
+{
+    gmx_qm_system_t system = set_QMsystem(engine, qm, mm);
+
+    engine->gradQM.resize(DIM*system.nQM);
+    engine->gradMM.resize(DIM*system.nMM);
+
+    double          energy = 0;
+    int             rc     = engine->functions->calculate(engine->engineData, &system,
+                                                          &energy,
+                                                          engine->gradQM.data(),
+                                                          engine->gradMM.data());
+    if (rc != 0)
+    {
+        gmx_fatal(FARGS, "The QM engine '%s' failed with error code %d",
+                  engine->functions->name, rc);
+    }
+
+    for (int i = 0; i < system.nQM; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            f[i][d]      = engine->gradQM[DIM*i + d];
+            fshift[i][d] = engine->gradQM[DIM*i + d];
+        }
+    }
+    for (int i = 0; i < system.nMM; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            f[system.nQM + i][d]      = engine->gradMM[DIM*i + d];
+            fshift[system.nQM + i][d] = engine->gradMM[DIM*i + d];
+        }
+    }
+
+    return energy;
+}
+
+void done_QMengine(t_QMengine *engine)
+{
+    if (engine->functions->finalize != nullptr)
+    {
+        engine->functions->finalize(engine->engineData);
+    }
+#if GMX_USE_PLUGINS
+    if (engine->libraryHandle != nullptr)
+    {
+        vmddlclose(engine->libraryHandle);
+    }
+#endif
+    delete engine;
+}
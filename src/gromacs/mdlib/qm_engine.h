@@ -0,0 +1,84 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ *
+ * \brief Declares the support for in-process QM engines in QM/MM.
+ *
+ * \ingroup module_mdlib
+ */
+
+#ifndef GMX_MDLIB_QM_ENGINE_H
+#define GMX_MDLIB_QM_ENGINE_H
+
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdlib/qm_engine_api.h"
+#include "gromacs/mdlib/qmmm.h"
+
+/*! \brief Data for an in-process QM engine */
+struct t_QMengine;
+
+/*! \brief Returns the functions of the built-in point-charge test engine
+ *
+ * The point-charge engine is only a stub for testing the engine
+ * interface and the QM/MM setup, it does not do any quantum chemistry.
+ * It returns the Coulomb energy between the force-field charges of the
+ * QM atoms and between those and the MM point charges, damped as
+ * 1/sqrt(r^2 + d^2) to avoid the singularity at short distance.
+ */
+const gmx_qm_engine_functions_t *gmx_qm_pointcharge_engine();
+
+/*! \brief Set up the QM engine selected with GMX_QM_ENGINE
+ *
+ * With GMX_QM_ENGINE=pointcharge the built-in point-charge test engine is used,
+ * any other value is the file name of an engine library.
+ * Returns nullptr when GMX_QM_ENGINE is not set, in which case
+ * the interfaces to the external QM programs are used.
+ */
+t_QMengine *init_QMengine(const t_QMrec *qm);
+
+/*! \brief Compute the QM energy and gradients with an in-process engine
+ *
+ * Returns the energy in kJ/mol and stores the gradients on the QM atoms,
+ * followed by those on the MM atoms, in f and fshift, as the interfaces
+ * to the external programs do.
+ */
+real call_QMengine(t_QMengine *engine,
+                   const t_QMrec *qm, const t_MMrec *mm,
+                   rvec f[], rvec fshift[]);
+
+/*! \brief Finalize the engine and free engine */
+void done_QMengine(t_QMengine *engine);
+
+#endif
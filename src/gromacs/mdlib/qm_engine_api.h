@@ -0,0 +1,113 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ *
+ * \brief Declares the C interface for in-process QM engines.
+ *
+ * A QM engine computes the energy and gradients of the QM subsystem
+ * in the field of the MM point charges. mdrun passes the coordinates
+ * and charges in memory, instead of through input and output files
+ * of an external program. An engine is either built into mdrun or
+ * loaded from a shared library that exports a function named
+ * GMX_QM_ENGINE_ENTRY_NAME of type gmx_qm_engine_entry_t.
+ * Only plain C types are used, so engines can be written in C or
+ * Fortran and do not depend on the precision GROMACS is compiled in.
+ *
+ * All coordinates are in nm, charges in units of e, energies
+ * in kJ/mol and gradients in kJ mol^-1 nm^-1.
+ *
+ * \inlibraryapi
+ * \ingroup module_mdlib
+ */
+
+#ifndef GMX_MDLIB_QM_ENGINE_API_H
+#define GMX_MDLIB_QM_ENGINE_API_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \brief The version of this interface, should be set by engines */
+#define GMX_QM_ENGINE_INTERFACE_VERSION 1
+
+/*! \brief The name of the entry function of an engine library */
+#define GMX_QM_ENGINE_ENTRY_NAME "gmx_qm_engine_functions"
+
+/*! \brief The QM subsystem with the MM point charges
+ *
+ * The arrays are owned by mdrun and are only valid during a call.
+ */
+typedef struct gmx_qm_system_t
+{
+    int           nQM;           /**< The number of QM atoms */
+    const int    *atomicNumber;  /**< The atomic numbers of the QM atoms */
+    const double *xQM;           /**< The QM coordinates, size 3*nQM */
+    const double *qQM;           /**< The force-field charges of the QM atoms */
+    int           charge;        /**< The total charge of the QM subsystem */
+    int           multiplicity;  /**< The spin multiplicity */
+    int           method;        /**< The QM method, see eQMmethod in md_enums.h */
+    int           basis;         /**< The basis set, see eQMbasis in md_enums.h */
+    int           nMM;           /**< The number of MM point charges */
+    const double *xMM;           /**< The MM coordinates, size 3*nMM */
+    const double *qMM;           /**< The MM point charges */
+} gmx_qm_system_t;
+
+/*! \brief The functions an engine provides
+ *
+ * init is called once before the first step with the initial system,
+ * which has no MM atoms yet; the engine can store its own data
+ * in *engineData. calculate is called at every step and should
+ * return the energy and the energy gradients on the QM and MM atoms.
+ * finalize, which can be NULL, is called at the end of the run.
+ * init and calculate return 0 on success.
+ */
+typedef struct gmx_qm_engine_functions_t
+{
+    int         interfaceVersion; /**< Should be GMX_QM_ENGINE_INTERFACE_VERSION */
+    const char *name;             /**< Name of the engine for the log output */
+    int       (*init)(const gmx_qm_system_t *system, void **engineData);
+    int       (*calculate)(void *engineData, const gmx_qm_system_t *system,
+                           double *energy, double *gradQM, double *gradMM);
+    void      (*finalize)(void *engineData);
+} gmx_qm_engine_functions_t;
+
+/*! \brief The type of the entry function of an engine library */
+typedef const gmx_qm_engine_functions_t *gmx_qm_engine_entry_t (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
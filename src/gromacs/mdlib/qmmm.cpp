@@ -48,6 +48,7 @@
 #include <cmath>
 
 #include <algorithm>
+#include <vector>
 
 #include "gromacs/domdec/domdec_struct.h"
 #include "gromacs/fileio/confio.h"
@@ -57,7 +58,10 @@
 #include "gromacs/math/units.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/mdlib/force.h"
+#include "gromacs/mdlib/nb_verlet.h"
+#include "gromacs/mdlib/nbnxn_grid.h"
 #include "gromacs/mdlib/ns.h"
+#include "gromacs/mdlib/qm_engine.h"
 #include "gromacs/mdtypes/commrec.h"
 #include "gromacs/mdtypes/inputrec.h"
 #include "gromacs/mdtypes/md_enums.h"
@@ -148,6 +152,12 @@ real call_QMroutine(t_commrec gmx_unused *cr, t_forcerec gmx_unused *fr, t_QMrec
     real
         QMener = 0.0;
 
+    /* an in-process engine, when selected, handles all methods */
+    if (fr->qr->engine != nullptr)
+    {
+        return call_QMengine(fr->qr->engine, qm, mm, f, fshift);
+    }
+
     /* do a semi-empiprical calculation */
 
     if (qm->QMmethod < eQMmethodRHF && !(mm->nrMMatoms))
@@ -327,12 +337,14 @@ static void init_QMrec(int grpnr, t_QMrec *qm, int nr, int *atomarray,
     }
 
     snew(qm->atomicnumberQM, nr);
+    snew(qm->QMcharges, nr);
     int molb = 0;
     for (int i = 0; i < qm->nrQMatoms; i++)
     {
         const t_atom &atom = mtopGetAtomParameters(mtop, qm->indexQM[i], &molb);
         qm->nelectrons       += mtop->atomtypes.atomnumber[atom.type];
         qm->atomicnumberQM[i] = mtop->atomtypes.atomnumber[atom.type];
+        qm->QMcharges[i]      = atom.q;
     }
 
     qm->QMcharge       = ir->opts.QMcharge[grpnr];
@@ -383,12 +395,14 @@ t_QMrec *copy_QMrec(t_QMrec *qm)
     snew(qmcopy->xQM, qmcopy->nrQMatoms);
     snew(qmcopy->indexQM, qmcopy->nrQMatoms);
     snew(qmcopy->atomicnumberQM, qm->nrQMatoms);
+    snew(qmcopy->QMcharges, qm->nrQMatoms);
     snew(qmcopy->shiftQM, qmcopy->nrQMatoms); /* the shifts */
     for (i = 0; i < qmcopy->nrQMatoms; i++)
     {
         qmcopy->shiftQM[i]        = qm->shiftQM[i];
         qmcopy->indexQM[i]        = qm->indexQM[i];
         qmcopy->atomicnumberQM[i] = qm->atomicnumberQM[i];
+        qmcopy->QMcharges[i]      = qm->QMcharges[i];
     }
     qmcopy->nelectrons   = qm->nelectrons;
     qmcopy->multiplicity = qm->multiplicity;
@@ -466,10 +480,6 @@ void init_QMMMrec(t_commrec  *cr,
     int                      a_offset;
     t_ilist                 *ilist_mol;
 
-    if (ir->cutoff_scheme != ecutsGROUP)
-    {
-        gmx_fatal(FARGS, "QMMM is currently only supported with cutoff-scheme=group");
-    }
     if (!EI_DYNAMICS(ir->eI))
     {
         gmx_fatal(FARGS, "QMMM is only supported with dynamics");
@@ -659,6 +669,11 @@ void init_QMMMrec(t_commrec  *cr,
          * TODO: Consider doing this in grompp instead.
          */
 
+        qr->qm[0] = mk_QMrec();
+        /* store QM atoms in the QMrec and initialise, this stores
+         * the force-field charges before they are set to zero below
+         */
+        init_QMrec(0, qr->qm[0], qm_nr, qm_arr, mtop, ir);
         int molb = 0;
         for (k = 0; k < qm_nr; k++)
         {
@@ -668,10 +683,6 @@ void init_QMMMrec(t_commrec  *cr,
             atom->q  = 0.0;
             atom->qB = 0.0;
         }
-        qr->qm[0] = mk_QMrec();
-        /* store QM atoms in the QMrec and initialise
-         */
-        init_QMrec(0, qr->qm[0], qm_nr, qm_arr, mtop, ir);
         if (qr->qm[0]->bOPT || qr->qm[0]->bTS)
         {
             for (i = 0; i < qm_nr; i++)
@@ -732,9 +743,25 @@ void init_QMMMrec(t_commrec  *cr,
         qr->mm           = mm;
     }
 
+    /* an in-process engine, when selected, replaces the external programs */
+    qr->engine = init_QMengine(qr->qm[0]);
+    if (ir->cutoff_scheme != ecutsGROUP && qr->engine == nullptr)
+    {
+        gmx_fatal(FARGS, "QMMM with cutoff-scheme=%s is only supported with an in-process QM engine, "
+                  "select one with the environment variable GMX_QM_ENGINE",
+                  ECUTSCHEME(ir->cutoff_scheme));
+    }
+    if (ir->cutoff_scheme == ecutsVERLET && DOMAINDECOMP(cr))
+    {
+        /* search_QMMM_nbnxn uses global atom indices and only searches
+         * the home zone of the nbnxn grid */
+        gmx_fatal(FARGS, "QMMM with cutoff-scheme=%s does not support domain decomposition, use a single rank instead",
+                  ECUTSCHEME(ir->cutoff_scheme));
+    }
+
     /* these variables get updated in the update QMMMrec */
 
-    if (qr->nrQMlayers == 1)
+    if (qr->nrQMlayers == 1 && qr->engine == nullptr)
     {
         /* with only one layer there is only one initialisation
          * needed. Multilayer is a bit more complicated as it requires
@@ -766,12 +793,100 @@ void init_QMMMrec(t_commrec  *cr,
     }
 } /* init_QMMMrec */
 
+static bool j_particle_comp(const t_j_particle &a, const t_j_particle &b)
+{
+    return a.j < b.j;
+}
+
+/* Finds the MM atoms within the pair-list cut-off of the QM atoms on
+ * the nbnxn search grid and stores them, with their shifts, in mm.
+ * Also sets the shifts of the QM atoms with respect to the first QM atom.
+ * The Verlet scheme only puts the atoms in the box at search steps,
+ * so all these shifts remain valid until the next search step.
+ * Only works without domain decomposition, since the QM atoms are
+ * accessed by global index and only grid 0 is searched.
+ */
+static void search_QMMM_nbnxn(const t_forcerec *fr,
+                              const t_pbc      *pbc,
+                              rvec              x[],
+                              const t_mdatoms  *md,
+                              t_QMrec          *qm,
+                              t_MMrec          *mm)
+{
+    std::vector<int>          neighbors;
+    std::vector<t_j_particle> mm_j_particles;
+    rvec                      dx, xq, xs;
+
+    qm->shiftQM[0] = CENTRAL;
+    for (int i = 1; i < qm->nrQMatoms; i++)
+    {
+        qm->shiftQM[i] = pbc_dx_aiuc(pbc, x[qm->indexQM[0]], x[qm->indexQM[i]], dx);
+    }
+
+    /* Search around all periodic images of the QM atoms, the MM atom
+     * x[j] - shift_vec[is] is then close to the shifted QM atom.
+     */
+    int npbcdim = ePBC2npbcdim(fr->ePBC);
+    for (int i = 0; i < qm->nrQMatoms; i++)
+    {
+        rvec_sub(x[qm->indexQM[i]], fr->shift_vec[qm->shiftQM[i]], xq);
+        for (int is = 0; is < SHIFTS; is++)
+        {
+            if ((npbcdim <= XX && IS2X(is) != 0) ||
+                (npbcdim <= YY && IS2Y(is) != 0) ||
+                (npbcdim <= ZZ && IS2Z(is) != 0))
+            {
+                continue;
+            }
+            rvec_add(xq, fr->shift_vec[is], xs);
+            neighbors.clear();
+            nbnxn_get_atoms_within_distance(fr->nbv->nbs, x, xs, fr->ic->rlist,
+                                            &neighbors);
+            for (int j : neighbors)
+            {
+                /* as with the group scheme, we skip uncharged MM atoms
+                 * unless the QM program needs their LJ parameters
+                 */
+                if (!md->bQM[j] &&
+                    (qm->bTS || qm->bOPT || md->chargeA[j] ||
+                     (md->chargeB && md->chargeB[j])))
+                {
+                    mm_j_particles.push_back({ j, is });
+                }
+            }
+        }
+    }
+
+    /* sort on atom index and remove multiple entries, an MM atom close
+     * to several QM atoms gets the shift of its first occurrence
+     */
+    std::stable_sort(mm_j_particles.begin(), mm_j_particles.end(), j_particle_comp);
+    int mm_nr = 0;
+    for (size_t i = 0; i < mm_j_particles.size(); i++)
+    {
+        if (i == 0 || mm_j_particles[i].j != mm_j_particles[i-1].j)
+        {
+            mm_j_particles[mm_nr++] = mm_j_particles[i];
+        }
+    }
+
+    mm->nrMMatoms = mm_nr;
+    srenew(mm->shiftMM, mm_nr);
+    srenew(mm->indexMM, mm_nr);
+    for (int i = 0; i < mm_nr; i++)
+    {
+        mm->indexMM[i] = mm_j_particles[i].j;
+        mm->shiftMM[i] = mm_j_particles[i].shift;
+    }
+}
+
 void update_QMMMrec(t_commrec      *cr,
                     t_forcerec     *fr,
                     rvec            x[],
                     t_mdatoms      *md,
                     matrix          box,
-                    gmx_localtop_t *top)
+                    gmx_localtop_t *top,
+                    gmx_bool        bNS)
 {
     /* updates the coordinates of both QM atoms and MM atoms and stores
      * them in the QMMMrec.
@@ -840,181 +955,191 @@ void update_QMMMrec(t_commrec      *cr,
          * the shifts are used for computing virial of the QM/MM particles.
          */
         qm = qr->qm[0]; /* in case of normal QMMM, there is only one group */
-        snew(qm_i_particles, QMMMlist->nri);
-        if (QMMMlist->nri)
+        if (fr->cutoff_scheme == ecutsVERLET)
         {
-            qm_i_particles[0].shift = XYZ2IS(0, 0, 0);
-            for (i = 0; i < QMMMlist->nri; i++)
+            if (bNS)
             {
-                qm_i_particles[i].j     = QMMMlist->iinr[i];
-
-                if (i)
+                search_QMMM_nbnxn(fr, &pbc, x, md, qm, mm);
+            }
+        }
+        else
+        {
+            snew(qm_i_particles, QMMMlist->nri);
+            if (QMMMlist->nri)
+            {
+                qm_i_particles[0].shift = XYZ2IS(0, 0, 0);
+                for (i = 0; i < QMMMlist->nri; i++)
                 {
-                    qm_i_particles[i].shift = pbc_dx_aiuc(&pbc, x[QMMMlist->iinr[0]],
-                                                          x[QMMMlist->iinr[i]], dx);
-
-                }
-                /* However, since nri >= nrQMatoms, we do a quicksort, and throw
-                 * out double, triple, etc. entries later, as we do for the MM
-                 * list too.
-                 */
+                    qm_i_particles[i].j     = QMMMlist->iinr[i];
 
-                /* compute the shift for the MM j-particles with respect to
-                 * the QM i-particle and store them.
-                 */
-
-                crd[0] = IS2X(QMMMlist->shift[i]) + IS2X(qm_i_particles[i].shift);
-                crd[1] = IS2Y(QMMMlist->shift[i]) + IS2Y(qm_i_particles[i].shift);
-                crd[2] = IS2Z(QMMMlist->shift[i]) + IS2Z(qm_i_particles[i].shift);
-                is     = static_cast<int>(XYZ2IS(crd[0], crd[1], crd[2]));
-                for (j = QMMMlist->jindex[i];
-                     j < QMMMlist->jindex[i+1];
-                     j++)
-                {
-                    if (mm_nr >= mm_max)
+                    if (i)
                     {
-                        mm_max += 1000;
-                        srenew(mm_j_particles, mm_max);
+                        qm_i_particles[i].shift = pbc_dx_aiuc(&pbc, x[QMMMlist->iinr[0]],
+                                                              x[QMMMlist->iinr[i]], dx);
+
                     }
+                    /* However, since nri >= nrQMatoms, we do a quicksort, and throw
+                     * out double, triple, etc. entries later, as we do for the MM
+                     * list too.
+                     */
+
+                    /* compute the shift for the MM j-particles with respect to
+                     * the QM i-particle and store them.
+                     */
+
+                    crd[0] = IS2X(QMMMlist->shift[i]) + IS2X(qm_i_particles[i].shift);
+                    crd[1] = IS2Y(QMMMlist->shift[i]) + IS2Y(qm_i_particles[i].shift);
+                    crd[2] = IS2Z(QMMMlist->shift[i]) + IS2Z(qm_i_particles[i].shift);
+                    is     = static_cast<int>(XYZ2IS(crd[0], crd[1], crd[2]));
+                    for (j = QMMMlist->jindex[i];
+                         j < QMMMlist->jindex[i+1];
+                         j++)
+                    {
+                        if (mm_nr >= mm_max)
+                        {
+                            mm_max += 1000;
+                            srenew(mm_j_particles, mm_max);
+                        }
 
-                    mm_j_particles[mm_nr].j     = QMMMlist->jjnr[j];
-                    mm_j_particles[mm_nr].shift = is;
-                    mm_nr++;
+                        mm_j_particles[mm_nr].j     = QMMMlist->jjnr[j];
+                        mm_j_particles[mm_nr].shift = is;
+                        mm_nr++;
+                    }
                 }
-            }
 
-            /* quicksort QM and MM shift arrays and throw away multiple entries */
+                /* quicksort QM and MM shift arrays and throw away multiple entries */
 
 
 
-            qsort(qm_i_particles, QMMMlist->nri,
-                  (size_t)sizeof(qm_i_particles[0]),
-                  struct_comp);
-            /* The mm_j_particles argument to qsort is not allowed to be NULL */
-            if (mm_nr > 0)
-            {
-                qsort(mm_j_particles, mm_nr,
-                      (size_t)sizeof(mm_j_particles[0]),
+                qsort(qm_i_particles, QMMMlist->nri,
+                      (size_t)sizeof(qm_i_particles[0]),
                       struct_comp);
-            }
-            /* remove multiples in the QM shift array, since in init_QMMM() we
-             * went through the atom numbers from 0 to md.nr, the order sorted
-             * here matches the one of QMindex already.
-             */
-            j = 0;
-            for (i = 0; i < QMMMlist->nri; i++)
-            {
-                if (i == 0 || qm_i_particles[i].j != qm_i_particles[i-1].j)
+                /* The mm_j_particles argument to qsort is not allowed to be NULL */
+                if (mm_nr > 0)
                 {
-                    qm_i_particles[j++] = qm_i_particles[i];
+                    qsort(mm_j_particles, mm_nr,
+                          (size_t)sizeof(mm_j_particles[0]),
+                          struct_comp);
                 }
-            }
-            mm_nr_new = 0;
-            if (qm->bTS || qm->bOPT)
-            {
-                /* only remove double entries for the MM array */
-                for (i = 0; i < mm_nr; i++)
+                /* remove multiples in the QM shift array, since in init_QMMM() we
+                 * went through the atom numbers from 0 to md.nr, the order sorted
+                 * here matches the one of QMindex already.
+                 */
+                j = 0;
+                for (i = 0; i < QMMMlist->nri; i++)
                 {
-                    if ((i == 0 || mm_j_particles[i].j != mm_j_particles[i-1].j)
-                        && !md->bQM[mm_j_particles[i].j])
+                    if (i == 0 || qm_i_particles[i].j != qm_i_particles[i-1].j)
                     {
-                        mm_j_particles[mm_nr_new++] = mm_j_particles[i];
+                        qm_i_particles[j++] = qm_i_particles[i];
                     }
                 }
-            }
-            /* we also remove mm atoms that have no charges!
-             * actually this is already done in the ns.c
-             */
-            else
-            {
-                for (i = 0; i < mm_nr; i++)
+                mm_nr_new = 0;
+                if (qm->bTS || qm->bOPT)
                 {
-                    if ((i == 0 || mm_j_particles[i].j != mm_j_particles[i-1].j)
-                        && !md->bQM[mm_j_particles[i].j]
-                        && (md->chargeA[mm_j_particles[i].j]
-                            || (md->chargeB && md->chargeB[mm_j_particles[i].j])))
+                    /* only remove double entries for the MM array */
+                    for (i = 0; i < mm_nr; i++)
                     {
-                        mm_j_particles[mm_nr_new++] = mm_j_particles[i];
+                        if ((i == 0 || mm_j_particles[i].j != mm_j_particles[i-1].j)
+                            && !md->bQM[mm_j_particles[i].j])
+                        {
+                            mm_j_particles[mm_nr_new++] = mm_j_particles[i];
+                        }
                     }
                 }
-            }
-            mm_nr = mm_nr_new;
-            /* store the data retrieved above into the QMMMrec
-             */
-            k = 0;
-            /* Keep the compiler happy,
-             * shift will always be set in the loop for i=0
-             */
-            shift = 0;
-            for (i = 0; i < qm->nrQMatoms; i++)
-            {
-                /* not all qm particles might have appeared as i
-                 * particles. They might have been part of the same charge
-                 * group for instance.
+                /* we also remove mm atoms that have no charges!
+                 * actually this is already done in the ns.c
                  */
-                if (qm->indexQM[i] == qm_i_particles[k].j)
+                else
                 {
-                    shift = qm_i_particles[k++].shift;
+                    for (i = 0; i < mm_nr; i++)
+                    {
+                        if ((i == 0 || mm_j_particles[i].j != mm_j_particles[i-1].j)
+                            && !md->bQM[mm_j_particles[i].j]
+                            && (md->chargeA[mm_j_particles[i].j]
+                                || (md->chargeB && md->chargeB[mm_j_particles[i].j])))
+                        {
+                            mm_j_particles[mm_nr_new++] = mm_j_particles[i];
+                        }
+                    }
                 }
-                /* use previous shift, assuming they belong the same charge
-                 * group anyway,
+                mm_nr = mm_nr_new;
+                /* store the data retrieved above into the QMMMrec
                  */
+                k = 0;
+                /* Keep the compiler happy,
+                 * shift will always be set in the loop for i=0
+                 */
+                shift = 0;
+                for (i = 0; i < qm->nrQMatoms; i++)
+                {
+                    /* not all qm particles might have appeared as i
+                     * particles. They might have been part of the same charge
+                     * group for instance.
+                     */
+                    if (qm->indexQM[i] == qm_i_particles[k].j)
+                    {
+                        shift = qm_i_particles[k++].shift;
+                    }
+                    /* use previous shift, assuming they belong the same charge
+                     * group anyway,
+                     */
 
-                qm->shiftQM[i] = shift;
+                    qm->shiftQM[i] = shift;
+                }
             }
-        }
-        /* parallel excecution */
-        if (PAR(cr))
-        {
-            snew(parallelMMarray, 2*(md->nr));
-            /* only MM particles have a 1 at their atomnumber. The second part
-             * of the array contains the shifts. Thus:
-             * p[i]=1/0 depending on wether atomnumber i is a MM particle in the QM
-             * step or not. p[i+md->nr] is the shift of atomnumber i.
-             */
-            for (i = 0; i < 2*(md->nr); i++)
+            /* parallel excecution */
+            if (PAR(cr))
             {
-                parallelMMarray[i] = 0;
-            }
+                snew(parallelMMarray, 2*(md->nr));
+                /* only MM particles have a 1 at their atomnumber. The second part
+                 * of the array contains the shifts. Thus:
+                 * p[i]=1/0 depending on wether atomnumber i is a MM particle in the QM
+                 * step or not. p[i+md->nr] is the shift of atomnumber i.
+                 */
+                for (i = 0; i < 2*(md->nr); i++)
+                {
+                    parallelMMarray[i] = 0;
+                }
 
-            for (i = 0; i < mm_nr; i++)
-            {
-                parallelMMarray[mm_j_particles[i].j]          = 1;
-                parallelMMarray[mm_j_particles[i].j+(md->nr)] = mm_j_particles[i].shift;
-            }
-            gmx_sumi(md->nr, parallelMMarray, cr);
-            mm_nr = 0;
+                for (i = 0; i < mm_nr; i++)
+                {
+                    parallelMMarray[mm_j_particles[i].j]          = 1;
+                    parallelMMarray[mm_j_particles[i].j+(md->nr)] = mm_j_particles[i].shift;
+                }
+                gmx_sumi(md->nr, parallelMMarray, cr);
+                mm_nr = 0;
 
-            mm_max = 0;
-            for (i = 0; i < md->nr; i++)
-            {
-                if (parallelMMarray[i])
+                mm_max = 0;
+                for (i = 0; i < md->nr; i++)
                 {
-                    if (mm_nr >= mm_max)
+                    if (parallelMMarray[i])
                     {
-                        mm_max += 1000;
-                        srenew(mm->indexMM, mm_max);
-                        srenew(mm->shiftMM, mm_max);
+                        if (mm_nr >= mm_max)
+                        {
+                            mm_max += 1000;
+                            srenew(mm->indexMM, mm_max);
+                            srenew(mm->shiftMM, mm_max);
+                        }
+                        mm->indexMM[mm_nr]   = i;
+                        mm->shiftMM[mm_nr++] = parallelMMarray[i+md->nr]/parallelMMarray[i];
                     }
-                    mm->indexMM[mm_nr]   = i;
-                    mm->shiftMM[mm_nr++] = parallelMMarray[i+md->nr]/parallelMMarray[i];
                 }
+                mm->nrMMatoms = mm_nr;
+                free(parallelMMarray);
             }
-            mm->nrMMatoms = mm_nr;
-            free(parallelMMarray);
-        }
-        /* serial execution */
-        else
-        {
-            mm->nrMMatoms = mm_nr;
-            srenew(mm->shiftMM, mm_nr);
-            srenew(mm->indexMM, mm_nr);
-            for (i = 0; i < mm_nr; i++)
+            /* serial execution */
+            else
             {
-                mm->indexMM[i] = mm_j_particles[i].j;
-                mm->shiftMM[i] = mm_j_particles[i].shift;
-            }
+                mm->nrMMatoms = mm_nr;
+                srenew(mm->shiftMM, mm_nr);
+                srenew(mm->indexMM, mm_nr);
+                for (i = 0; i < mm_nr; i++)
+                {
+                    mm->indexMM[i] = mm_j_particles[i].j;
+                    mm->shiftMM[i] = mm_j_particles[i].shift;
+                }
 
+            }
         }
         /* (re) allocate memory for the MM coordiate array. The QM
          * coordinate array was already allocated in init_QMMM, and is
@@ -1152,13 +1277,19 @@ real calculate_QMMM(t_commrec *cr,
             srenew(forces, qm->nrQMatoms);
             srenew(fshift, qm->nrQMatoms);
             /* we need to re-initialize the QMroutine every step... */
-            init_QMroutine(cr, qm, mm);
+            if (qr->engine == nullptr)
+            {
+                init_QMroutine(cr, qm, mm);
+            }
             QMener += call_QMroutine(cr, fr, qm, mm, forces, fshift);
 
             /* this layer at the lower level of theory */
             srenew(forces2, qm->nrQMatoms);
             srenew(fshift2, qm->nrQMatoms);
-            init_QMroutine(cr, qm2, mm);
+            if (qr->engine == nullptr)
+            {
+                init_QMroutine(cr, qm2, mm);
+            }
             QMener -= call_QMroutine(cr, fr, qm2, mm, forces2, fshift2);
             /* E = E1high-E1low The next layer includes the current layer at
              * the lower level of theory, which provides + E2low
@@ -1176,7 +1307,10 @@ real calculate_QMMM(t_commrec *cr,
         }
         /* now the last layer still needs to be done: */
         qm      = qr->qm[qr->nrQMlayers-1]; /* C counts from 0 */
-        init_QMroutine(cr, qm, mm);
+        if (qr->engine == nullptr)
+        {
+            init_QMroutine(cr, qm, mm);
+        }
         srenew(forces, qm->nrQMatoms);
         srenew(fshift, qm->nrQMatoms);
         QMener += call_QMroutine(cr, fr, qm, mm, forces, fshift);
@@ -1209,4 +1343,13 @@ real calculate_QMMM(t_commrec *cr,
     return(QMener);
 } /* calculate_QMMM */
 
+void done_QMMMrec(t_QMMMrec *qr)
+{
+    if (qr->engine != nullptr)
+    {
+        done_QMengine(qr->engine);
+        qr->engine = nullptr;
+    }
+} /* done_QMMMrec */
+
 /* end of QMMM core routines */
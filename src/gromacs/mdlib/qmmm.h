@@ -47,13 +47,14 @@ struct t_forcerec;
 struct t_inputrec;
 struct t_mdatoms;
 struct t_QMMMrec;
+struct t_QMengine;
 
 typedef struct {
     int                nrQMatoms;      /* total nr of QM atoms              */
     rvec              *xQM;            /* shifted to center of box          */
     int               *indexQM;        /* atom i = atom indexQM[i] in mdrun */
     int               *atomicnumberQM; /* atomic numbers of QM atoms        */
-    real              *QMcharges;      /* atomic charges of QM atoms(ONIOM) */
+    real              *QMcharges;      /* force-field charges of QM atoms   */
     int               *shiftQM;
     int                QMcharge;       /* charge of the QM system           */
     int                multiplicity;   /* multipicity (no of unpaired eln)  */
@@ -110,6 +111,7 @@ typedef struct t_QMMMrec {
     int             nrQMlayers; /* number of QM layers (total layers +1 (MM)) */
     t_QMrec       **qm;         /* atoms and run params for each QM group */
     t_MMrec        *mm;         /* there can only be one MM subsystem !   */
+    t_QMengine     *engine;     /* in-process QM engine, NULL when external QM programs are used */
 } t_QMMMrec;
 
 void atomic_number(int nr, char ***atomtype, int *nucnum);
@@ -134,10 +136,13 @@ void update_QMMMrec(t_commrec      *cr,
                     rvec            x[],
                     t_mdatoms      *md,
                     matrix          box,
-                    gmx_localtop_t *top);
+                    gmx_localtop_t *top,
+                    gmx_bool        bNS);
 
 /* update_QMMMrec fills the MM stuff in QMMMrec. The MM atoms are
- * taken froom the neighbourlists of the QM atoms. In a QMMM run this
+ * taken froom the neighbourlists of the QM atoms. With the Verlet
+ * cut-off scheme the MM atoms are searched on the nbnxn grid at
+ * neighbor search steps, indicated by bNS. In a QMMM run this
  * routine should be called at every step, since it updates the MM
  * elements of the t_QMMMrec struct.
  */
@@ -153,4 +158,8 @@ real calculate_QMMM(t_commrec *cr,
  * called by system().
  */
 
+void done_QMMMrec(t_QMMMrec *qr);
+
+/* done_QMMMrec finalizes the in-process QM engine, if any */
+
 #endif
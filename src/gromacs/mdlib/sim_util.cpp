@@ -69,6 +69,7 @@
 #include "gromacs/math/vecdump.h"
 #include "gromacs/mdlib/calcmu.h"
 #include "gromacs/mdlib/constr.h"
+#include "gromacs/mdlib/cvreduce.h"
 #include "gromacs/mdlib/force.h"
 #include "gromacs/mdlib/forcerec.h"
 #include "gromacs/mdlib/genborn.h"
@@ -82,7 +83,9 @@
 #include "gromacs/mdlib/qmmm.h"
 #include "gromacs/mdlib/update.h"
 #include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_gpu_ref.h"
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_prune.h"
 #include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref.h"
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_usertab.h"
 #include "gromacs/mdlib/nbnxn_kernels/simd_2xnn/nbnxn_kernel_simd_2xnn.h"
 #include "gromacs/mdlib/nbnxn_kernels/simd_4xn/nbnxn_kernel_simd_4xn.h"
 #include "gromacs/mdtypes/commrec.h"
@@ -288,6 +291,78 @@ static void pull_potential_wrapper(t_commrec *cr,
     wallcycle_stop(wcycle, ewcPULLPOT);
 }
 
+/*! \brief Computes the local contributions to the global sums of the collective-variable modules and starts their summation
+ *
+ * The local sums of enforced rotation, essential dynamics flooding and
+ * pulling are summed over the ranks in a single, fused, call.
+ * The summation is completed after the force computation in
+ * cv_sums_finish(), which allows overlap of communication and
+ * computation when non-blocking collectives are supported.
+ * With a graph the coordinates are shifted during the force computation.
+ * Flooding and pulling use the shifted coordinates, so they are then
+ * only summed in cv_sums_finish() or in pull_potential().
+ */
+static void cv_sums_start(t_commrec *cr, t_inputrec *ir,
+                          t_mdatoms *mdatoms, matrix box, rvec x[],
+                          double t, gmx_edsam_t ed, gmx_bool bNS,
+                          const t_graph *graph, gmx_cvreduce_t *cvr,
+                          gmx_wallcycle_t wcycle)
+{
+    if (ir->bRot)
+    {
+        wallcycle_start(wcycle, ewcROT);
+        do_rotation_local(cvr, ir, box, x, t, bNS);
+        wallcycle_stop(wcycle, ewcROT);
+    }
+
+    if (graph == nullptr)
+    {
+        if (ed)
+        {
+            do_flood_local(cvr, x, ed);
+        }
+
+        if (ir->bPull && pull_have_potential(ir->pull_work))
+        {
+            t_pbc pbc;
+
+            wallcycle_start(wcycle, ewcPULLPOT);
+            set_pbc(&pbc, ir->ePBC, box);
+            pull_calc_coms_local(cr, ir->pull_work, mdatoms, &pbc, x, cvr);
+            wallcycle_stop(wcycle, ewcPULLPOT);
+        }
+    }
+
+    cvreduce_start(cvr, cr);
+}
+
+/*! \brief Completes the summation started in cv_sums_start() and computes the rotation potential */
+static void cv_sums_finish(t_commrec *cr, t_inputrec *ir,
+                           matrix box, rvec x[], double t,
+                           gmx_int64_t step, gmx_edsam_t ed, gmx_bool bNS,
+                           const t_graph *graph, gmx_cvreduce_t *cvr,
+                           gmx_wallcycle_t wcycle)
+{
+    cvreduce_finish(cvr, cr);
+
+    if (ir->bRot)
+    {
+        /* Enforced rotation has its own cycle counter that starts after the collective
+         * coordinates have been communicated. It is added to ddCyclF to allow
+         * for proper load-balancing */
+        wallcycle_start(wcycle, ewcROT);
+        do_rotation(cr, ir, box, x, t, step, wcycle, bNS);
+        wallcycle_stop(wcycle, ewcROT);
+    }
+
+    if (ed && graph != nullptr)
+    {
+        /* The flooding positions should be taken from the shifted coordinates */
+        do_flood_local(cvr, x, ed);
+        cvreduce_sum(cvr, cr);
+    }
+}
+
 static void pme_receive_force_ener(t_commrec      *cr,
                                    gmx_wallcycle_t wcycle,
                                    gmx_enerdata_t *enerd,
@@ -409,7 +484,7 @@ static void post_process_forces(t_commrec *cr,
 static void do_nb_verlet(t_forcerec *fr,
                          interaction_const_t *ic,
                          gmx_enerdata_t *enerd,
-                         int flags, int ilocality,
+                         int flags, gmx_int64_t step, int ilocality,
                          int clearF,
                          t_nrnb *nrnb,
                          gmx_wallcycle_t wcycle)
@@ -434,73 +509,99 @@ static void do_nb_verlet(t_forcerec *fr,
 
     bUsingGpuKernels = (nbvg->kernel_type == nbnxnk8x8x8_GPU);
 
+    if (fr->nbv->bDynamicPruning && !bUsingGpuKernels &&
+        (step - fr->nbv->searchStep) % fr->nbv->nstlistPrune == 0)
+    {
+        /* Prune the outer list to the inner list with the current coordinates */
+        wallcycle_sub_start(wcycle, ewcsNONBONDED_PRUNING);
+        nbnxn_kernel_cpu_prune(&nbvg->nbl_lists, nbvg->nbat, fr->shift_vec,
+                               fr->nbv->rlistInner, nbvg->kernel_type);
+        wallcycle_sub_stop(wcycle, ewcsNONBONDED_PRUNING);
+    }
+
     if (!bUsingGpuKernels)
     {
         wallcycle_sub_start(wcycle, ewcsNONBONDED);
     }
-    switch (nbvg->kernel_type)
+    if (fr->nbv->userTable != nullptr)
     {
-        case nbnxnk4x4_PlainC:
-            nbnxn_kernel_ref(&nbvg->nbl_lists,
+        nbnxn_kernel_usertab(&nbvg->nbl_lists,
                              nbvg->nbat, ic,
+                             *fr->nbv->userTable,
                              fr->shift_vec,
+                             nbvg->kernel_type,
                              flags,
                              clearF,
                              fr->fshift[0],
                              enerd->grpp.ener[egCOULSR],
-                             fr->bBHAM ?
-                             enerd->grpp.ener[egBHAMSR] :
                              enerd->grpp.ener[egLJSR]);
-            break;
-
-        case nbnxnk4xN_SIMD_4xN:
-            nbnxn_kernel_simd_4xn(&nbvg->nbl_lists,
-                                  nbvg->nbat, ic,
-                                  nbvg->ewald_excl,
-                                  fr->shift_vec,
-                                  flags,
-                                  clearF,
-                                  fr->fshift[0],
-                                  enerd->grpp.ener[egCOULSR],
-                                  fr->bBHAM ?
-                                  enerd->grpp.ener[egBHAMSR] :
-                                  enerd->grpp.ener[egLJSR]);
-            break;
-        case nbnxnk4xN_SIMD_2xNN:
-            nbnxn_kernel_simd_2xnn(&nbvg->nbl_lists,
-                                   nbvg->nbat, ic,
-                                   nbvg->ewald_excl,
-                                   fr->shift_vec,
-                                   flags,
-                                   clearF,
-                                   fr->fshift[0],
-                                   enerd->grpp.ener[egCOULSR],
-                                   fr->bBHAM ?
-                                   enerd->grpp.ener[egBHAMSR] :
-                                   enerd->grpp.ener[egLJSR]);
-            break;
-
-        case nbnxnk8x8x8_GPU:
-            nbnxn_gpu_launch_kernel(fr->nbv->gpu_nbv, nbvg->nbat, flags, ilocality);
-            break;
-
-        case nbnxnk8x8x8_PlainC:
-            nbnxn_kernel_gpu_ref(nbvg->nbl_lists.nbl[0],
+    }
+    else
+    {
+        switch (nbvg->kernel_type)
+        {
+            case nbnxnk4x4_PlainC:
+                nbnxn_kernel_ref(&nbvg->nbl_lists,
                                  nbvg->nbat, ic,
                                  fr->shift_vec,
                                  flags,
                                  clearF,
-                                 nbvg->nbat->out[0].f,
                                  fr->fshift[0],
                                  enerd->grpp.ener[egCOULSR],
                                  fr->bBHAM ?
                                  enerd->grpp.ener[egBHAMSR] :
                                  enerd->grpp.ener[egLJSR]);
-            break;
-
-        default:
-            gmx_incons("Invalid nonbonded kernel type passed!");
+                break;
+
+            case nbnxnk4xN_SIMD_4xN:
+                nbnxn_kernel_simd_4xn(&nbvg->nbl_lists,
+                                      nbvg->nbat, ic,
+                                      nbvg->ewald_excl,
+                                      fr->shift_vec,
+                                      flags,
+                                      clearF,
+                                      fr->fshift[0],
+                                      enerd->grpp.ener[egCOULSR],
+                                      fr->bBHAM ?
+                                      enerd->grpp.ener[egBHAMSR] :
+                                      enerd->grpp.ener[egLJSR]);
+                break;
+            case nbnxnk4xN_SIMD_2xNN:
+                nbnxn_kernel_simd_2xnn(&nbvg->nbl_lists,
+                                       nbvg->nbat, ic,
+                                       nbvg->ewald_excl,
+                                       fr->shift_vec,
+                                       flags,
+                                       clearF,
+                                       fr->fshift[0],
+                                       enerd->grpp.ener[egCOULSR],
+                                       fr->bBHAM ?
+                                       enerd->grpp.ener[egBHAMSR] :
+                                       enerd->grpp.ener[egLJSR]);
+                break;
+
+            case nbnxnk8x8x8_GPU:
+                nbnxn_gpu_launch_kernel(fr->nbv->gpu_nbv, nbvg->nbat, flags, ilocality);
+                break;
+
+            case nbnxnk8x8x8_PlainC:
+                nbnxn_kernel_gpu_ref(nbvg->nbl_lists.nbl[0],
+                                     nbvg->nbat, ic,
+                                     fr->shift_vec,
+                                     flags,
+                                     clearF,
+                                     nbvg->nbat->out[0].f,
+                                     fr->fshift[0],
+                                     enerd->grpp.ener[egCOULSR],
+                                     fr->bBHAM ?
+                                     enerd->grpp.ener[egBHAMSR] :
+                                     enerd->grpp.ener[egLJSR]);
+                break;
+
+            default:
+                gmx_incons("Invalid nonbonded kernel type passed!");
 
+        }
     }
     if (!bUsingGpuKernels)
     {
@@ -511,6 +612,10 @@ static void do_nb_verlet(t_forcerec *fr,
     {
         enr_nbnxn_kernel_ljc = eNR_NBNXN_LJ_RF;
     }
+    else if (ic->eeltype == eelUSER)
+    {
+        enr_nbnxn_kernel_ljc = eNR_NBNXN_LJ_TAB;
+    }
     else if ((!bUsingGpuKernels && nbvg->ewald_excl == ewaldexclAnalytical) ||
              (bUsingGpuKernels && nbnxn_gpu_is_kernel_ewald_analytical(fr->nbv->gpu_nbv)))
     {
@@ -747,6 +852,8 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
      * also be used by gmx_wallcycle_t */
     gmx_cycles_t        cycleCountBeforeLocalWorkCompletes = 0;
     nonbonded_verlet_t *nbv;
+    /* Force provider that is applied during the non-bonded force reduction */
+    IForceProvider     *fusedForceProvider = nullptr;
 
     cycles_force    = 0;
     cycles_wait_gpu = 0;
@@ -917,6 +1024,8 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
     /* do local pair search */
     if (bNS)
     {
+        nbv->searchStep = step;
+
         wallcycle_start_nocount(wcycle, ewcNS);
         wallcycle_sub_start(wcycle, ewcsNBS_SEARCH_LOCAL);
         nbnxn_make_pairlist(nbv->nbs, nbv->grp[eintLocal].nbat,
@@ -952,7 +1061,7 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
     {
         wallcycle_start(wcycle, ewcLAUNCH_GPU_NB);
         /* launch local nonbonded F on GPU */
-        do_nb_verlet(fr, ic, enerd, flags, eintLocal, enbvClearFNo,
+        do_nb_verlet(fr, ic, enerd, flags, step, eintLocal, enbvClearFNo,
                      nrnb, wcycle);
         wallcycle_stop(wcycle, ewcLAUNCH_GPU_NB);
     }
@@ -1027,7 +1136,7 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
         {
             wallcycle_start(wcycle, ewcLAUNCH_GPU_NB);
             /* launch non-local nonbonded F on GPU */
-            do_nb_verlet(fr, ic, enerd, flags, eintNonlocal, enbvClearFNo,
+            do_nb_verlet(fr, ic, enerd, flags, step, eintNonlocal, enbvClearFNo,
                          nrnb, wcycle);
             cycles_force += wallcycle_stop(wcycle, ewcLAUNCH_GPU_NB);
         }
@@ -1086,15 +1195,9 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
         dd_force_flop_start(cr->dd, nrnb);
     }
 
-    if (inputrec->bRot)
-    {
-        /* Enforced rotation has its own cycle counter that starts after the collective
-         * coordinates have been communicated. It is added to ddCyclF to allow
-         * for proper load-balancing */
-        wallcycle_start(wcycle, ewcROT);
-        do_rotation(cr, inputrec, box, x, t, step, wcycle, bNS);
-        wallcycle_stop(wcycle, ewcROT);
-    }
+    /* Start the fused global summation for the collective-variable modules */
+    cv_sums_start(cr, inputrec, mdatoms, box, x, t, ed, bNS, graph,
+                  fr->cvreduce, wcycle);
 
     /* Temporary solution until all routines take PaddedRVecVector */
     rvec *f = as_rvec_array(force->data());
@@ -1137,6 +1240,16 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
         /* Clear the short- and long-range forces */
         clear_rvecs_omp(fr->natoms_force_constr, f);
 
+        /* The electric field forces are computed on the local atoms
+         * during the non-bonded force reduction below, so we avoid
+         * a separate pass over all atoms.
+         */
+        if (fr->efield != nullptr)
+        {
+            fr->efield->prepareForcesForAtomRanges(cr, mdatoms, fr->f_novirsum, t);
+            fusedForceProvider = fr->efield;
+        }
+
         clear_rvec(fr->vir_diag_posres);
     }
 
@@ -1156,7 +1269,7 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
     if (!bUseOrEmulGPU)
     {
         /* Maybe we should move this into do_force_lowlevel */
-        do_nb_verlet(fr, ic, enerd, flags, eintLocal, enbvClearFYes,
+        do_nb_verlet(fr, ic, enerd, flags, step, eintLocal, enbvClearFYes,
                      nrnb, wcycle);
     }
 
@@ -1189,7 +1302,7 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
 
         if (DOMAINDECOMP(cr))
         {
-            do_nb_verlet(fr, ic, enerd, flags, eintNonlocal,
+            do_nb_verlet(fr, ic, enerd, flags, step, eintNonlocal,
                          bDiffKernels ? enbvClearFYes : enbvClearFNo,
                          nrnb, wcycle);
         }
@@ -1210,7 +1323,8 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
         cycles_force += wallcycle_stop(wcycle, ewcFORCE);
         wallcycle_start(wcycle, ewcNB_XF_BUF_OPS);
         wallcycle_sub_start(wcycle, ewcsNB_F_BUF_OPS);
-        nbnxn_atomdata_add_nbat_f_to_f(nbv->nbs, eatAll, nbv->grp[aloc].nbat, f);
+        nbnxn_atomdata_add_nbat_f_to_f(nbv->nbs, eatAll, nbv->grp[aloc].nbat, f,
+                                       bUseOrEmulGPU ? nullptr : fusedForceProvider);
         wallcycle_sub_stop(wcycle, ewcsNB_F_BUF_OPS);
         cycles_force += wallcycle_stop(wcycle, ewcNB_XF_BUF_OPS);
         wallcycle_start_nocount(wcycle, ewcFORCE);
@@ -1229,7 +1343,7 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
     /* update QMMMrec, if necessary */
     if (fr->bQMMM)
     {
-        update_QMMMrec(cr, fr, x, mdatoms, box, top);
+        update_QMMMrec(cr, fr, x, mdatoms, box, top, bNS);
     }
 
     /* Compute the bonded and non-bonded energies and optionally forces */
@@ -1242,9 +1356,12 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
 
     cycles_force += wallcycle_stop(wcycle, ewcFORCE);
 
+    cv_sums_finish(cr, inputrec, box, x, t, step, ed, bNS, graph,
+                   fr->cvreduce, wcycle);
+
     if (ed)
     {
-        do_flood(cr, inputrec, x, f, ed, box, step, bNS);
+        do_flood(cr, inputrec, f, ed, box, step, bNS);
     }
 
     if (bUseOrEmulGPU && !bDiffKernels)
@@ -1268,7 +1385,7 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
             else
             {
                 wallcycle_start_nocount(wcycle, ewcFORCE);
-                do_nb_verlet(fr, ic, enerd, flags, eintNonlocal, enbvClearFYes,
+                do_nb_verlet(fr, ic, enerd, flags, step, eintNonlocal, enbvClearFYes,
                              nrnb, wcycle);
                 cycles_force += wallcycle_stop(wcycle, ewcFORCE);
             }
@@ -1278,7 +1395,8 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
             if (nbv->grp[eintNonlocal].nbl_lists.nbl[0]->nsci > 0)
             {
                 nbnxn_atomdata_add_nbat_f_to_f(nbv->nbs, eatNonlocal,
-                                               nbv->grp[eintNonlocal].nbat, f);
+                                               nbv->grp[eintNonlocal].nbat, f,
+                                               nullptr);
             }
             wallcycle_sub_stop(wcycle, ewcsNB_F_BUF_OPS);
             cycles_force += wallcycle_stop(wcycle, ewcNB_XF_BUF_OPS);
@@ -1359,7 +1477,7 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
         else
         {
             wallcycle_start_nocount(wcycle, ewcFORCE);
-            do_nb_verlet(fr, ic, enerd, flags, eintLocal,
+            do_nb_verlet(fr, ic, enerd, flags, step, eintLocal,
                          DOMAINDECOMP(cr) ? enbvClearFNo : enbvClearFYes,
                          nrnb, wcycle);
             wallcycle_stop(wcycle, ewcFORCE);
@@ -1367,7 +1485,8 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
         wallcycle_start(wcycle, ewcNB_XF_BUF_OPS);
         wallcycle_sub_start(wcycle, ewcsNB_F_BUF_OPS);
         nbnxn_atomdata_add_nbat_f_to_f(nbv->nbs, eatLocal,
-                                       nbv->grp[eintLocal].nbat, f);
+                                       nbv->grp[eintLocal].nbat, f,
+                                       fusedForceProvider);
         wallcycle_sub_stop(wcycle, ewcsNB_F_BUF_OPS);
         wallcycle_stop(wcycle, ewcNB_XF_BUF_OPS);
     }
@@ -1387,12 +1506,6 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
 
     if (bDoForces)
     {
-        /* Compute forces due to electric field */
-        if (fr->efield != nullptr)
-        {
-            fr->efield->calculateForces(cr, mdatoms, fr->f_novirsum, t);
-        }
-
         /* If we have NoVirSum forces, but we do not calculate the virial,
          * we sum fr->f_novirsum=f later.
          */
@@ -1658,15 +1771,9 @@ void do_force_cutsGROUP(FILE *fplog, t_commrec *cr,
         dd_force_flop_start(cr->dd, nrnb);
     }
 
-    if (inputrec->bRot)
-    {
-        /* Enforced rotation has its own cycle counter that starts after the collective
-         * coordinates have been communicated. It is added to ddCyclF to allow
-         * for proper load-balancing */
-        wallcycle_start(wcycle, ewcROT);
-        do_rotation(cr, inputrec, box, x, t, step, wcycle, bNS);
-        wallcycle_stop(wcycle, ewcROT);
-    }
+    /* Start the fused global summation for the collective-variable modules */
+    cv_sums_start(cr, inputrec, mdatoms, box, x, t, ed, bNS, graph,
+                  fr->cvreduce, wcycle);
 
     /* Temporary solution until all routines take PaddedRVecVector */
     rvec *f = as_rvec_array(force->data());
@@ -1714,7 +1821,7 @@ void do_force_cutsGROUP(FILE *fplog, t_commrec *cr,
     /* update QMMMrec, if necessary */
     if (fr->bQMMM)
     {
-        update_QMMMrec(cr, fr, x, mdatoms, box, top);
+        update_QMMMrec(cr, fr, x, mdatoms, box, top, bNS);
     }
 
     /* Compute the bonded and non-bonded energies and optionally forces */
@@ -1729,9 +1836,12 @@ void do_force_cutsGROUP(FILE *fplog, t_commrec *cr,
 
     cycles_force = wallcycle_stop(wcycle, ewcFORCE);
 
+    cv_sums_finish(cr, inputrec, box, x, t, step, ed, bNS, graph,
+                   fr->cvreduce, wcycle);
+
     if (ed)
     {
-        do_flood(cr, inputrec, x, f, ed, box, step, bNS);
+        do_flood(cr, inputrec, f, ed, box, step, bNS);
     }
 
     if (DOMAINDECOMP(cr))
@@ -0,0 +1,154 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Tests for the fused global summation of collective-variable sums
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxlib/network.h"
+#include "gromacs/mdlib/cvreduce.h"
+#include "gromacs/mdtypes/commrec.h"
+
+#include "testutils/mpitest.h"
+
+namespace
+{
+
+TEST(CvReduceTest, SumsRegisteredArraysOverRanks)
+{
+    GMX_MPI_TEST(4);
+    t_commrec      *cr   = init_commrec();
+    /* With thread-MPI the commrec is only set up for the threads here */
+    gmx_fill_commrec_from_mpi(cr);
+    gmx_cvreduce_t *cvr  = init_cvreduce();
+    const int       rank = cr->nodeid;
+
+    real            r[3] = { real(rank), 1, real(2*rank) };
+    double          d[2] = { 0.5*rank, 1 };
+
+    cvreduce_add_real(cvr, 3, r);
+    cvreduce_add_double(cvr, 2, d);
+    EXPECT_TRUE(cvreduce_have_sums(cvr));
+    cvreduce_start(cvr, cr);
+    cvreduce_finish(cvr, cr);
+    EXPECT_FALSE(cvreduce_have_sums(cvr));
+
+    EXPECT_EQ(6, r[0]);
+    EXPECT_EQ(4, r[1]);
+    EXPECT_EQ(12, r[2]);
+    EXPECT_DOUBLE_EQ(3, d[0]);
+    EXPECT_DOUBLE_EQ(4, d[1]);
+
+    /* The registrations are cleared after a summation */
+    double e[1] = { 1 };
+    cvreduce_add_double(cvr, 1, e);
+    cvreduce_sum(cvr, cr);
+    EXPECT_DOUBLE_EQ(4, e[0]);
+    EXPECT_DOUBLE_EQ(3, d[0]);
+
+    done_cvreduce(cvr);
+    done_commrec(cr);
+}
+
+TEST(CvReduceTest, SumsRegisteredArraysOverSimulationMasters)
+{
+    GMX_MPI_TEST(4);
+    t_commrec      *cr   = init_commrec();
+    gmx_fill_commrec_from_mpi(cr);
+    gmx_cvreduce_t *cvr  = init_cvreduce();
+
+    /* Two simulations of two ranks each, the masters are ranks 0 and 2 */
+    gmx_multisim_t  ms;
+    ms.nsim              = 2;
+    ms.sim               = cr->nodeid/2;
+    ms.mpi_group_masters = MPI_GROUP_NULL;
+    ms.mpb               = nullptr;
+    bool            bMaster = (cr->nodeid % 2 == 0);
+    MPI_Comm_split(cr->mpi_comm_mysim, bMaster ? 0 : MPI_UNDEFINED, cr->nodeid,
+                   &ms.mpi_comm_masters);
+
+    real            r[2] = { real(ms.sim + 1), 1 };
+    double          d[1] = { 0.25*ms.sim };
+
+    /* Only the masters take part in the summation */
+    if (bMaster)
+    {
+        cvreduce_add_real(cvr, 2, r);
+        cvreduce_add_double(cvr, 1, d);
+    }
+    cvreduce_start_sim(cvr, &ms);
+    cvreduce_finish_sim(cvr, &ms);
+    EXPECT_FALSE(cvreduce_have_sums(cvr));
+
+    if (bMaster)
+    {
+        EXPECT_EQ(3, r[0]);
+        EXPECT_EQ(2, r[1]);
+        EXPECT_DOUBLE_EQ(0.25, d[0]);
+        MPI_Comm_free(&ms.mpi_comm_masters);
+    }
+    else
+    {
+        EXPECT_EQ(ms.sim + 1, r[0]);
+        EXPECT_EQ(1, r[1]);
+        EXPECT_DOUBLE_EQ(0.25*ms.sim, d[0]);
+    }
+
+    done_cvreduce(cvr);
+    done_commrec(cr);
+}
+
+TEST(CvReduceTest, LeavesArraysUnchangedWithoutMultiSim)
+{
+    gmx_cvreduce_t *cvr  = init_cvreduce();
+
+    real            r[2] = { 1, 2 };
+
+    cvreduce_add_real(cvr, 2, r);
+    cvreduce_start_sim(cvr, nullptr);
+    cvreduce_finish_sim(cvr, nullptr);
+    EXPECT_FALSE(cvreduce_have_sums(cvr));
+
+    EXPECT_EQ(1, r[0]);
+    EXPECT_EQ(2, r[1]);
+
+    done_cvreduce(cvr);
+}
+
+} // namespace
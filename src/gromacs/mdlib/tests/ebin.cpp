@@ -0,0 +1,184 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for adding deferred energy group pair sums to the energy averages
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "gromacs/mdlib/ebin.h"
+
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/mdlib/force.h"
+#include "gromacs/mdtypes/forcerec.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+
+namespace test
+{
+
+namespace
+{
+
+//! The number of energy groups
+const int c_numEnergyGroups = 2;
+//! The number of steps between energy output
+const int c_nstenergy       = 10;
+//! The number of steps to run
+const int c_numSteps        = 3*c_nstenergy + 1;
+
+//! Names for the group pair energies, one per pair
+const char *c_pairNames[c_numEnergyGroups*c_numEnergyGroups] = { "0-0", "0-1", "1-0", "1-1" };
+
+//! Sets fluctuating group pair energies for \p step
+void setGroupPairEnergies(gmx_grppairener_t *grpp, int step)
+{
+    for (int k = 0; k < egNR; k++)
+    {
+        for (int j = 0; j < grpp->nener; j++)
+        {
+            grpp->ener[k][j] = 100*std::sin(0.7*step + 1.3*k + 0.4*j) - 500*j - 20*k;
+        }
+    }
+}
+
+//! Returns a new energy bin with one block of group pair energies per energy type
+t_ebin *makeGroupPairEbin(int nener, int index[])
+{
+    t_ebin *eb = mk_ebin();
+
+    for (int k = 0; k < egNR; k++)
+    {
+        index[k] = get_ebin_space(eb, nener, c_pairNames, "kJ/mol");
+    }
+
+    return eb;
+}
+
+/*! \brief Checks the energy averages of the deferred path against the per-step path
+ *
+ * Energy output steps add the energies per step, the other steps are
+ * deferred: added to the running sums of gmx_enerdata_t and added to
+ * the energy bin as one block at the next output step, as mdrun does.
+ */
+TEST(DeferredGroupPairEnergiesTest, AveragesAndFluctuationsMatchPerStep)
+{
+    gmx_enerdata_t enerd;
+    int            indexPerStep[egNR], indexDeferred[egNR];
+
+    init_enerdata(c_numEnergyGroups, 0, &enerd);
+    const int      nener        = enerd.grpp.nener;
+    t_ebin        *ebinPerStep  = makeGroupPairEbin(nener, indexPerStep);
+    t_ebin        *ebinDeferred = makeGroupPairEbin(nener, indexDeferred);
+
+    for (int step = 0; step < c_numSteps; step++)
+    {
+        setGroupPairEnergies(&enerd.grpp, step);
+
+        for (int k = 0; k < egNR; k++)
+        {
+            add_ebin(ebinPerStep, indexPerStep[k], nener, enerd.grpp.ener[k], TRUE);
+        }
+        ebin_increase_count(ebinPerStep, TRUE);
+
+        bool bOutput = (step % c_nstenergy == 0);
+        if (!bOutput)
+        {
+            accumulate_grpp_sum(&enerd);
+        }
+        else
+        {
+            if (enerd.grpp_sum.nstep > 0)
+            {
+                for (int k = 0; k < egNR; k++)
+                {
+                    add_ebin_block(ebinDeferred, indexDeferred[k], nener,
+                                   enerd.grpp_sum.esum[k], enerd.grpp_sum.esum2[k],
+                                   enerd.grpp_sum.nstep);
+                }
+                enerd.grpp_sum.nstep = 0;
+            }
+            for (int k = 0; k < egNR; k++)
+            {
+                add_ebin(ebinDeferred, indexDeferred[k], nener, enerd.grpp.ener[k], TRUE);
+            }
+        }
+        ebin_increase_count(ebinDeferred, TRUE);
+
+        if (bOutput)
+        {
+            ASSERT_EQ(ebinPerStep->nsum, ebinDeferred->nsum);
+            for (int k = 0; k < egNR; k++)
+            {
+                for (int j = 0; j < nener; j++)
+                {
+                    const t_energy &ePerStep  = ebinPerStep->e[indexPerStep[k] + j];
+                    const t_energy &eDeferred = ebinDeferred->e[indexDeferred[k] + j];
+                    const double    magnitude = std::fabs(ePerStep.esum) + 1;
+
+                    EXPECT_DOUBLE_EQ_TOL(ePerStep.esum, eDeferred.esum,
+                                         relativeToleranceAsFloatingPoint(magnitude, 1e-12))
+                    << "average at step " << step;
+                    EXPECT_DOUBLE_EQ_TOL(ebinPerStep->e_sim[indexPerStep[k] + j].esum,
+                                         ebinDeferred->e_sim[indexDeferred[k] + j].esum,
+                                         relativeToleranceAsFloatingPoint(magnitude*step, 1e-12))
+                    << "simulation average at step " << step;
+                    EXPECT_DOUBLE_EQ_TOL(ePerStep.eav, eDeferred.eav,
+                                         relativeToleranceAsFloatingPoint(ePerStep.eav, 1e-9))
+                    << "fluctuation at step " << step;
+                }
+            }
+            /* As after writing an energy frame */
+            reset_ebin_sums(ebinPerStep);
+            reset_ebin_sums(ebinDeferred);
+        }
+    }
+
+    destroy_enerdata(&enerd);
+}
+
+} // namespace
+
+} // namespace test
+
+} // namespace gmx
@@ -0,0 +1,133 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Tests for collecting group positions over ranks
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxlib/network.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdlib/cvreduce.h"
+#include "gromacs/mdlib/groupcoord.h"
+#include "gromacs/mdtypes/commrec.h"
+
+#include "testutils/mpitest.h"
+
+namespace
+{
+
+//! Number of atoms in the test group, large enough to use all-gather
+const int c_numAtoms = 1500;
+
+/*! \brief Sets up the local atoms of the group for this rank
+ *
+ * Atom i is local on rank (i + offset) % nranks. The local atoms are
+ * stored in reverse order in x_loc to test the index handling.
+ */
+void setLocalAtoms(const t_commrec *cr, int offset,
+                   std::vector<gmx::RVec> *x_loc,
+                   std::vector<int> *anrs_loc, std::vector<int> *coll_ind)
+{
+    x_loc->clear();
+    anrs_loc->clear();
+    coll_ind->clear();
+    for (int i = c_numAtoms - 1; i >= 0; i--)
+    {
+        if ((i + offset) % cr->nnodes == cr->nodeid)
+        {
+            anrs_loc->push_back(x_loc->size());
+            coll_ind->push_back(i);
+            x_loc->push_back(gmx::RVec(0.5*i, 1 - i, 0.25*i*i));
+        }
+    }
+}
+
+//! Collects the group positions with \p gg and checks the result
+void checkCollectedPositions(const t_commrec *cr, gmx_group_gather_t *gg, int offset)
+{
+    std::vector<gmx::RVec> x_loc, xcoll(c_numAtoms);
+    std::vector<int>       anrs_loc, coll_ind;
+    gmx_cvreduce_t        *cvr = init_cvreduce();
+
+    setLocalAtoms(cr, offset, &x_loc, &anrs_loc, &coll_ind);
+    group_gather_local_changed(gg);
+    communicate_group_positions_start(cvr, gg, as_rvec_array(xcoll.data()),
+                                      as_rvec_array(x_loc.data()),
+                                      c_numAtoms, anrs_loc.size(),
+                                      anrs_loc.data(), coll_ind.data());
+    /* With all-gather nothing should be left to sum */
+    EXPECT_EQ(gg == nullptr, cvreduce_have_sums(cvr));
+    cvreduce_sum(cvr, cr);
+
+    for (int i = 0; i < c_numAtoms; i++)
+    {
+        EXPECT_EQ(real(0.5*i), xcoll[i][XX]);
+        EXPECT_EQ(real(1 - i), xcoll[i][YY]);
+        EXPECT_EQ(real(0.25*i*i), xcoll[i][ZZ]);
+    }
+
+    done_cvreduce(cvr);
+}
+
+TEST(GroupCoordTest, GathersPositionsOverRanks)
+{
+    GMX_MPI_TEST(4);
+    t_commrec          *cr = init_commrec();
+    /* With thread-MPI the commrec is only set up for the threads here */
+    gmx_fill_commrec_from_mpi(cr);
+
+    /* Small groups are summed */
+    EXPECT_EQ(nullptr, init_group_gather(cr, 10));
+
+    gmx_group_gather_t *gg = init_group_gather(cr, c_numAtoms);
+    ASSERT_NE(nullptr, gg);
+
+    checkCollectedPositions(cr, gg, 0);
+    /* Redistribute the atoms, as after domain re-decomposition */
+    checkCollectedPositions(cr, gg, 1);
+    /* The summation path should give the same result */
+    checkCollectedPositions(cr, nullptr, 2);
+
+    done_group_gather(gg);
+    done_commrec(cr);
+}
+
+} // namespace
@@ -0,0 +1,179 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Tests for the distance search on the nbnxn grid
+ *
+ * Checks that nbnxn_get_atoms_within_distance finds the same atoms as
+ * a brute-force search, also for atoms on and slightly outside the grid
+ * edges, which end up in the border columns, and for search centers
+ * outside the grid.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/vec.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
+#include "gromacs/mdlib/nb_verlet.h"
+#include "gromacs/mdlib/nbnxn_atomdata.h"
+#include "gromacs/mdlib/nbnxn_grid.h"
+#include "gromacs/mdlib/nbnxn_search.h"
+#include "gromacs/mdtypes/forcerec.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformrealdistribution.h"
+
+namespace
+{
+
+//! Returns the indices of the atoms in \p x within distance \p rc of \p x0
+std::vector<int> bruteForceSearch(const std::vector<gmx::RVec> &x, const rvec x0, real rc)
+{
+    std::vector<int> atoms;
+    for (size_t a = 0; a < x.size(); a++)
+    {
+        if (distance2(x[a], x0) < rc*rc)
+        {
+            atoms.push_back(a);
+        }
+    }
+
+    return atoms;
+}
+
+/*! \brief Puts random atoms on the grid for \p kernelType and compares the searches
+ *
+ * Besides the random atoms, atoms are placed on the lower grid edges
+ * and outside the grid by less than a column width, which the grid puts
+ * in the border columns. The search centers include points up to the
+ * search distance from those atoms.
+ */
+void checkSearchMatchesBruteForce(int kernelType)
+{
+    const rvec                     boxSize = { 3.0, 2.6, 2.2 };
+    matrix                         box     = {{ boxSize[XX], 0, 0 }, { 0, boxSize[YY], 0 }, { 0, 0, boxSize[ZZ] }};
+    gmx::ThreeFry2x64<64>          rng(123456, gmx::RandomDomain::Other);
+    gmx::UniformRealDistribution<real> dist;
+
+    std::vector<gmx::RVec>         x;
+    std::vector<gmx::RVec>         outward;
+    for (int a = 0; a < 2000; a++)
+    {
+        x.push_back({ dist(rng)*boxSize[XX], dist(rng)*boxSize[YY], dist(rng)*boxSize[ZZ] });
+    }
+    const real edgeOffset = 0.05;
+    for (int a = 0; a < 60; a++)
+    {
+        gmx::RVec xa = { dist(rng)*boxSize[XX], dist(rng)*boxSize[YY], dist(rng)*boxSize[ZZ] };
+        gmx::RVec na = { 0, 0, 0 };
+        int       d  = a % DIM;
+        switch ((a/DIM) % 3)
+        {
+            case 0: xa[d] = 0; na[d] = -1; break;
+            case 1: xa[d] = -edgeOffset; na[d] = -1; break;
+            case 2: xa[d] = boxSize[d] + edgeOffset; na[d] = 1; break;
+        }
+        x.push_back(xa);
+        outward.push_back(na);
+    }
+    const int                      numAtomsInside = x.size() - outward.size();
+    const int                      numAtoms = x.size();
+
+    gmx_omp_nthreads_set(emntPairsearch, 1);
+
+    nbnxn_search_t                 nbs;
+    nbnxn_init_search(&nbs, nullptr, nullptr, FALSE, 1);
+    nbnxn_atomdata_t               nbat;
+    real                           nbfp[2] = { 0, 0 };
+    nbnxn_atomdata_init(nullptr, &nbat, kernelType, enbnxninitcombruleNONE,
+                        1, nbfp, 1, 1, nullptr, nullptr);
+
+    std::vector<int>               atinfo(numAtoms, 0);
+    rvec                           corner0 = { 0, 0, 0 };
+    rvec                           corner1 = { boxSize[XX], boxSize[YY], boxSize[ZZ] };
+    nbnxn_put_on_grid(nbs, epbcXYZ, box, 0, corner0, corner1, 0, numAtoms, -1,
+                      atinfo.data(), as_rvec_array(x.data()), 0, nullptr,
+                      kernelType, &nbat);
+
+    int                            ncx, ncy;
+    nbnxn_get_ncells(nbs, &ncx, &ncy);
+    ASSERT_GT(ncx, 2) << "The test needs border and inner columns";
+    ASSERT_GT(ncy, 2) << "The test needs border and inner columns";
+
+    for (real rc : { 0.3, 0.7 })
+    {
+        /* Random centers, followed by centers just within range outside
+         * each edge atom, which are further from the border column than rc.
+         */
+        for (int i = 0; i < 200 + numAtoms - numAtomsInside; i++)
+        {
+            rvec x0;
+            for (int d = 0; d < DIM; d++)
+            {
+                if (i < 200)
+                {
+                    x0[d] = -rc - edgeOffset + dist(rng)*(boxSize[d] + 2*(rc + edgeOffset));
+                }
+                else
+                {
+                    x0[d] = x[numAtomsInside + i - 200][d] + 0.9*rc*outward[i - 200][d];
+                }
+            }
+            std::vector<int> atoms;
+            nbnxn_get_atoms_within_distance(nbs, as_rvec_array(x.data()), x0, rc, &atoms);
+            std::sort(atoms.begin(), atoms.end());
+
+            EXPECT_EQ(bruteForceSearch(x, x0, rc), atoms)
+            << "around " << x0[XX] << " " << x0[YY] << " " << x0[ZZ] << " with distance " << rc;
+        }
+    }
+}
+
+TEST(NbnxnGridSearchTest, AtomsWithinDistanceMatchBruteForceOnCpuGrid)
+{
+    checkSearchMatchesBruteForce(nbnxnk4x4_PlainC);
+}
+
+TEST(NbnxnGridSearchTest, AtomsWithinDistanceMatchBruteForceOnGpuGrid)
+{
+    checkSearchMatchesBruteForce(nbnxnk8x8x8_PlainC);
+}
+
+} // namespace
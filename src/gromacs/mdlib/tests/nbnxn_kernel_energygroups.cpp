@@ -0,0 +1,312 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Tests for the energy group output of the SIMD nbnxn kernels
+ *
+ * The SIMD kernels add the energies of cluster pairs with all atoms
+ * in a single group pair to a compact buffer, and those of other
+ * cluster pairs to a buffer per atom pair. Checks that the group pair
+ * energies match the template reference kernel when both paths are used.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include <cmath>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/units.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdlib/force_flags.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
+#include "gromacs/mdlib/nb_verlet.h"
+#include "gromacs/mdlib/nbnxn_atomdata.h"
+#include "gromacs/mdlib/nbnxn_consts.h"
+#include "gromacs/mdlib/nbnxn_simd.h"
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_template.h"
+#include "gromacs/mdlib/nbnxn_kernels/simd_2xnn/nbnxn_kernel_simd_2xnn.h"
+#include "gromacs/mdlib/nbnxn_kernels/simd_4xn/nbnxn_kernel_simd_4xn.h"
+#include "gromacs/mdtypes/interaction_const.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/pbcutil/ishift.h"
+
+#include "testutils/testasserts.h"
+
+#include "nbnxn_testsystem.h"
+
+namespace
+{
+
+using gmx::test::c_nbnxnTestNumAtoms;
+using gmx::test::c_nbnxnTestNumTypes;
+
+//! The number of energy groups
+const int c_numEnergyGrps = 3;
+//! The number of bits per atom in the packed energy groups
+const int c_neg2log       = 2;
+
+/*! \brief Returns the energy group of atom \p a
+ *
+ * Blocks of 8 atoms share a group, so most cluster pairs have all atoms
+ * in one group pair, for i- and j-clusters of up to 8 atoms. A few atoms
+ * are moved to another group, which makes the clusters they are in mixed.
+ */
+int energyGroup(int a)
+{
+    int g = (a/8) % c_numEnergyGrps;
+    if (a == 13 || a == 42 || a == 77)
+    {
+        g = (g + 1) % c_numEnergyGrps;
+    }
+    return g;
+}
+
+/*! \brief The shared nbnxn test system with three energy groups */
+class NbnxnKernelEnergyGroupsTest : public ::testing::Test
+{
+    public:
+        //! Sets up the energy groups and the interaction constants
+        NbnxnKernelEnergyGroupsTest()
+        {
+            /* Energy groups are stored per cluster of 4 atoms,
+             * with 2 bits per atom for 3 groups.
+             */
+            energrp_.assign(c_nbnxnTestNumAtoms/NBNXN_CPU_CLUSTER_I_SIZE, 0);
+            for (int a = 0; a < c_nbnxnTestNumAtoms; a++)
+            {
+                energrp_[a/NBNXN_CPU_CLUSTER_I_SIZE] |=
+                    (energyGroup(a) << ((a % NBNXN_CPU_CLUSTER_I_SIZE)*c_neg2log));
+            }
+
+            const real rc             = 0.9;
+            ic_.cutoff_scheme         = ecutsVERLET;
+            ic_.eeltype               = eelRF;
+            ic_.vdwtype               = evdwCUT;
+            ic_.vdw_modifier          = eintmodPOTSHIFT;
+            ic_.rcoulomb              = rc;
+            ic_.rvdw                  = rc;
+            ic_.epsfac                = ONE_4PI_EPS0;
+            ic_.k_rf                  = 0.5/(rc*rc*rc);
+            ic_.c_rf                  = 1/rc + ic_.k_rf*rc*rc;
+            ic_.dispersion_shift.cpot = -1/std::pow(rc, 6);
+            ic_.repulsion_shift.cpot  = -1/std::pow(rc, 12);
+
+            clear_rvecs(SHIFTS, shiftVec_);
+
+            gmx_omp_nthreads_set(emntNonbonded, 1);
+        }
+
+        //! Builds a pair list with all atom pairs for the given cluster sizes
+        void makePairlist(int iClusterSize, int jClusterSize)
+        {
+            gmx::test::makeNbnxnAllPairsList(c_nbnxnTestNumAtoms, iClusterSize, jClusterSize,
+                                             &ci_, &cj_);
+            nbl_.na_ci = iClusterSize;
+            nbl_.na_cj = jClusterSize;
+            nbl_.nci   = ci_.size();
+            nbl_.ci    = ci_.data();
+            nbl_.ncj   = cj_.size();
+            nbl_.cj    = cj_.data();
+        }
+
+        /*! \brief Adds the lower triangle of the group pair matrices to the upper
+         *
+         * This is how the SIMD kernels return the group pair energies.
+         */
+        static void foldGroupPairs(std::vector<real> *V)
+        {
+            for (int i = 0; i < c_numEnergyGrps; i++)
+            {
+                for (int j = i + 1; j < c_numEnergyGrps; j++)
+                {
+                    (*V)[i*c_numEnergyGrps + j] += (*V)[j*c_numEnergyGrps + i];
+                    (*V)[j*c_numEnergyGrps + i]  = 0;
+                }
+            }
+        }
+
+        //! Runs the template reference kernel and returns the group pair energies
+        void runRefKernel(std::vector<real> *Vc, std::vector<real> *Vvdw)
+        {
+            std::vector<real> nbfpComb(c_nbnxnTestNumTypes*2, 0);
+            nbnxn_atomdata_t  nbat = {};
+            nbat.ntype     = c_nbnxnTestNumTypes;
+            nbat.nbfp      = system_.nbfp.data();
+            nbat.nbfp_comb = nbfpComb.data();
+            nbat.type      = system_.type.data();
+            nbat.q         = system_.q.data();
+            nbat.x         = system_.x.data();
+            nbat.na_c      = NBNXN_CPU_CLUSTER_I_SIZE;
+            nbat.nenergrp  = c_numEnergyGrps;
+            nbat.neg_2log  = c_neg2log;
+            nbat.energrp   = energrp_.data();
+            nbat.xstride   = DIM;
+            nbat.fstride   = DIM;
+
+            makePairlist(NBNXN_CPU_CLUSTER_I_SIZE, NBNXN_CPU_CLUSTER_I_SIZE);
+
+            std::vector<real> f(c_nbnxnTestNumAtoms*DIM, 0);
+            real              fshift[SHIFTS*DIM] = { 0 };
+            Vc->assign(c_numEnergyGrps*c_numEnergyGrps, 0);
+            Vvdw->assign(c_numEnergyGrps*c_numEnergyGrps, 0);
+            nbnxn_kernel_ref_template<NBNXN_CPU_CLUSTER_I_SIZE, NBNXN_CPU_CLUSTER_I_SIZE,
+                                      NbnxnRefCoulomb::ReactionField, NbnxnRefVdw::Cut,
+                                      NbnxnRefEnergy::Groups>
+                (&nbl_, &nbat, &ic_, shiftVec_, f.data(), fshift, Vvdw->data(), Vc->data());
+            foldGroupPairs(Vc);
+            foldGroupPairs(Vvdw);
+        }
+
+        //! Runs the SIMD kernel for \p kernelType and returns the group pair energies
+        void runSimdKernel(int kernelType, std::vector<real> *Vc, std::vector<real> *Vvdw)
+        {
+            nbnxn_atomdata_t nbat = {};
+
+            nbnxn_atomdata_init(nullptr, &nbat, kernelType, enbnxninitcombruleNONE,
+                                c_nbnxnTestNumTypes, system_.nbfp.data(), c_numEnergyGrps,
+                                1, nullptr, nullptr);
+            /* The cluster size is normally set with the grid */
+            nbat.na_c   = NBNXN_CPU_CLUSTER_I_SIZE;
+            nbnxn_atomdata_realloc(&nbat, c_nbnxnTestNumAtoms);
+            nbat.natoms = c_nbnxnTestNumAtoms;
+            ASSERT_EQ(c_neg2log, nbat.neg_2log);
+
+            /* With packed coordinates x, y and z are stored in packs */
+            const int packSize = (nbat.XFormat == nbatX8 ? 8 : 4);
+            for (int a = 0; a < c_nbnxnTestNumAtoms; a++)
+            {
+                const int xIndex = DIM*(a & ~(packSize - 1)) + (a & (packSize - 1));
+                for (int d = 0; d < DIM; d++)
+                {
+                    nbat.x[xIndex + d*packSize] = system_.x[a*DIM + d];
+                }
+                nbat.q[a]    = system_.q[a];
+                nbat.type[a] = system_.type[a];
+            }
+            for (size_t c = 0; c < energrp_.size(); c++)
+            {
+                nbat.energrp[c] = energrp_[c];
+            }
+
+            const int            jClusterSize = (kernelType == nbnxnk4xN_SIMD_4xN ?
+                                                 GMX_SIMD_REAL_WIDTH : GMX_SIMD_REAL_WIDTH/2);
+            makePairlist(NBNXN_CPU_CLUSTER_I_SIZE, jClusterSize);
+            nbnxn_pairlist_t    *nblPtr   = &nbl_;
+            nbnxn_pairlist_set_t nblList  = {};
+            nblList.nnbl                  = 1;
+            nblList.nbl                   = &nblPtr;
+
+            real fshift[SHIFTS*DIM] = { 0 };
+            Vc->assign(c_numEnergyGrps*c_numEnergyGrps, 0);
+            Vvdw->assign(c_numEnergyGrps*c_numEnergyGrps, 0);
+            if (kernelType == nbnxnk4xN_SIMD_4xN)
+            {
+                nbnxn_kernel_simd_4xn(&nblList, &nbat, &ic_, ewaldexclAnalytical, shiftVec_,
+                                      GMX_FORCE_FORCES | GMX_FORCE_ENERGY, enbvClearFYes,
+                                      fshift, Vc->data(), Vvdw->data());
+            }
+            else
+            {
+                nbnxn_kernel_simd_2xnn(&nblList, &nbat, &ic_, ewaldexclAnalytical, shiftVec_,
+                                       GMX_FORCE_FORCES | GMX_FORCE_ENERGY, enbvClearFYes,
+                                       fshift, Vc->data(), Vvdw->data());
+            }
+        }
+
+        //! Checks that each group pair energy matches the reference
+        void compare(const std::vector<real> &VRef, const std::vector<real> &V, const char *name)
+        {
+            real VMax = 0;
+            for (real v : VRef)
+            {
+                VMax = std::max(VMax, std::abs(v));
+            }
+            /* Only the summation order differs */
+            gmx::test::FloatingPointTolerance tol =
+                gmx::test::absoluteTolerance(VMax*(GMX_DOUBLE ? 1e-10 : 1e-5));
+            ASSERT_EQ(VRef.size(), V.size());
+            for (size_t i = 0; i < VRef.size(); i++)
+            {
+                EXPECT_REAL_EQ_TOL(VRef[i], V[i], tol)
+                << name << " for group pair " << i/c_numEnergyGrps << " " << i % c_numEnergyGrps;
+            }
+        }
+
+        //! Checks that the SIMD kernel \p kernelType matches the reference kernel
+        void testKernel(int kernelType)
+        {
+            std::vector<real> VcRef, VvdwRef, Vc, Vvdw;
+
+            runRefKernel(&VcRef, &VvdwRef);
+            runSimdKernel(kernelType, &Vc, &Vvdw);
+
+            compare(VcRef, Vc, "Coulomb energy");
+            compare(VvdwRef, Vvdw, "LJ energy");
+        }
+
+        //! The atoms and their parameters
+        gmx::test::NbnxnTestSystem system_;
+        //! Energy groups per cluster of 4 atoms
+        std::vector<int>           energrp_;
+        //! The interaction constants
+        interaction_const_t        ic_ = {};
+        //! The shift vectors, only the central one is non-zero
+        rvec                       shiftVec_[SHIFTS];
+        //! The i-entries of the pair list
+        std::vector<nbnxn_ci_t>    ci_;
+        //! The j-entries of the pair list
+        std::vector<nbnxn_cj_t>    cj_;
+        //! The pair list
+        nbnxn_pairlist_t           nbl_ = {};
+};
+
+#ifdef GMX_NBNXN_SIMD_4XN
+TEST_F(NbnxnKernelEnergyGroupsTest, Simd4xNMatchesReferenceKernel)
+{
+    testKernel(nbnxnk4xN_SIMD_4xN);
+}
+#endif
+
+#ifdef GMX_NBNXN_SIMD_2XNN
+TEST_F(NbnxnKernelEnergyGroupsTest, Simd2xNNMatchesReferenceKernel)
+{
+    testKernel(nbnxnk4xN_SIMD_2xNN);
+}
+#endif
+
+} // namespace
@@ -0,0 +1,269 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Tests for the nbnxn dynamic pruning kernels
+ *
+ * Checks that the prune kernels keep exactly the cluster pairs that
+ * have at least one atom pair within the inner cut-off, as determined
+ * by a brute-force distance check, for the plain-C and SIMD layouts.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/vec.h"
+#include "gromacs/mdlib/nb_verlet.h"
+#include "gromacs/mdlib/nbnxn_atomdata.h"
+#include "gromacs/mdlib/nbnxn_consts.h"
+#include "gromacs/mdlib/nbnxn_simd.h"
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_prune.h"
+#include "gromacs/pbcutil/ishift.h"
+
+#include "nbnxn_testsystem.h"
+
+namespace
+{
+
+using gmx::test::c_nbnxnTestNumAtoms;
+
+//! The inner cut-off used for pruning
+const real c_rlistInner  = 0.5;
+//! The shift index used for the shifted i-entries
+const int  c_shiftIndex  = CENTRAL + 1;
+
+/*! \brief The shared nbnxn test system with an outer list containing all
+ * cluster pairs, half of the i-entries with a shift
+ */
+class NbnxnKernelPruneTest : public ::testing::Test
+{
+    public:
+        //! Sets up the shift vectors
+        NbnxnKernelPruneTest()
+        {
+            clear_rvecs(SHIFTS, shiftVec_);
+            shiftVec_[c_shiftIndex][XX] = 1.1;
+            shiftVec_[c_shiftIndex][YY] = -0.3;
+        }
+
+        //! Builds the outer list with all cluster pairs
+        void makeOuterList(int iClusterSize, int jClusterSize)
+        {
+            ciOuter_.clear();
+            cjOuter_.clear();
+            for (int ci = 0; ci < c_nbnxnTestNumAtoms/iClusterSize; ci++)
+            {
+                nbnxn_ci_t ciEntry;
+                ciEntry.ci           = ci;
+                ciEntry.shift        = (ci % 2 == 0 ? CENTRAL : c_shiftIndex);
+                ciEntry.cj_ind_start = cjOuter_.size();
+                for (int cj = 0; cj < c_nbnxnTestNumAtoms/jClusterSize; cj++)
+                {
+                    nbnxn_cj_t cjEntry;
+                    cjEntry.cj   = cj;
+                    cjEntry.excl = NBNXN_INTERACTION_MASK_ALL;
+                    cjOuter_.push_back(cjEntry);
+                }
+                ciEntry.cj_ind_end = cjOuter_.size();
+                ciOuter_.push_back(ciEntry);
+            }
+
+            ciInner_.assign(ciOuter_.size(), nbnxn_ci_t());
+            cjInner_.assign(cjOuter_.size(), nbnxn_cj_t());
+
+            nbl_          = {};
+            nbl_.na_ci    = iClusterSize;
+            nbl_.na_cj    = jClusterSize;
+            nbl_.nciOuter = ciOuter_.size();
+            nbl_.ciOuter  = ciOuter_.data();
+            nbl_.ncjOuter = cjOuter_.size();
+            nbl_.cjOuter  = cjOuter_.data();
+            nbl_.ci       = ciInner_.data();
+            nbl_.cj       = cjInner_.data();
+        }
+
+        //! Returns whether any atom pair of \p ciEntry and \p cj is within the inner cut-off
+        bool clusterPairIsInRange(const nbnxn_ci_t &ciEntry, int cj) const
+        {
+            const int ish = (ciEntry.shift & NBNXN_CI_SHIFT);
+            for (int i = ciEntry.ci*nbl_.na_ci; i < (ciEntry.ci + 1)*nbl_.na_ci; i++)
+            {
+                for (int j = cj*nbl_.na_cj; j < (cj + 1)*nbl_.na_cj; j++)
+                {
+                    rvec dx;
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        dx[d] = system_.x[i*DIM + d] + shiftVec_[ish][d] - system_.x[j*DIM + d];
+                    }
+                    if (norm2(dx) < c_rlistInner*c_rlistInner)
+                    {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        //! Checks the pruned list in nbl_ against the brute-force result
+        void checkInnerList() const
+        {
+            int nciRef    = 0;
+            int ncjRef    = 0;
+            int ncjPruned = 0;
+            for (const nbnxn_ci_t &ciEntry : ciOuter_)
+            {
+                std::vector<int> cjRef;
+                for (int cjind = ciEntry.cj_ind_start; cjind < ciEntry.cj_ind_end; cjind++)
+                {
+                    if (clusterPairIsInRange(ciEntry, cjOuter_[cjind].cj))
+                    {
+                        cjRef.push_back(cjOuter_[cjind].cj);
+                    }
+                    else
+                    {
+                        ncjPruned++;
+                    }
+                }
+                if (cjRef.empty())
+                {
+                    continue;
+                }
+
+                ASSERT_LT(nciRef, nbl_.nci);
+                const nbnxn_ci_t &ciInner = nbl_.ci[nciRef];
+                EXPECT_EQ(ciEntry.ci, ciInner.ci);
+                EXPECT_EQ(ciEntry.shift, ciInner.shift);
+                ASSERT_EQ(static_cast<int>(cjRef.size()), ciInner.cj_ind_end - ciInner.cj_ind_start)
+                << "i-cluster " << ciEntry.ci;
+                for (size_t k = 0; k < cjRef.size(); k++)
+                {
+                    EXPECT_EQ(cjRef[k], nbl_.cj[ciInner.cj_ind_start + k].cj)
+                    << "i-cluster " << ciEntry.ci;
+                }
+                nciRef++;
+                ncjRef += cjRef.size();
+            }
+            EXPECT_EQ(nciRef, nbl_.nci);
+            EXPECT_EQ(ncjRef, nbl_.ncj);
+
+            /* Ensure the test actually prunes and keeps cluster pairs */
+            EXPECT_GT(ncjRef, 0);
+            EXPECT_GT(ncjPruned, 0);
+        }
+
+        //! Runs the SIMD prune kernel for \p kernelType with jClusterSize \p jClusterSize
+        void runSimdPrune(int kernelType, int jClusterSize)
+        {
+            nbnxn_atomdata_t nbat = {};
+            real             nbfp[2] = { 0 };
+
+            nbnxn_atomdata_init(nullptr, &nbat, kernelType, enbnxninitcombruleNONE,
+                                1, nbfp, 1, 1, nullptr, nullptr);
+            nbnxn_atomdata_realloc(&nbat, c_nbnxnTestNumAtoms);
+            nbat.natoms = c_nbnxnTestNumAtoms;
+
+            /* With packed coordinates x, y and z are stored in packs */
+            const int packSize = (nbat.XFormat == nbatX8 ? 8 : 4);
+            for (int a = 0; a < c_nbnxnTestNumAtoms; a++)
+            {
+                const int xIndex = DIM*(a & ~(packSize - 1)) + (a & (packSize - 1));
+                for (int d = 0; d < DIM; d++)
+                {
+                    nbat.x[xIndex + d*packSize] = system_.x[a*DIM + d];
+                }
+            }
+
+            makeOuterList(NBNXN_CPU_CLUSTER_I_SIZE, jClusterSize);
+            if (kernelType == nbnxnk4xN_SIMD_4xN)
+            {
+                nbnxn_kernel_prune_4xn(&nbl_, &nbat, shiftVec_, c_rlistInner);
+            }
+            else
+            {
+                nbnxn_kernel_prune_2xnn(&nbl_, &nbat, shiftVec_, c_rlistInner);
+            }
+        }
+
+        //! The atoms, only the coordinates are used
+        gmx::test::NbnxnTestSystem system_;
+        //! The shift vectors
+        rvec                    shiftVec_[SHIFTS];
+        //! The outer i-entries
+        std::vector<nbnxn_ci_t> ciOuter_;
+        //! The outer j-entries
+        std::vector<nbnxn_cj_t> cjOuter_;
+        //! Storage for the inner i-entries
+        std::vector<nbnxn_ci_t> ciInner_;
+        //! Storage for the inner j-entries
+        std::vector<nbnxn_cj_t> cjInner_;
+        //! The pair list
+        nbnxn_pairlist_t        nbl_ = {};
+};
+
+TEST_F(NbnxnKernelPruneTest, PlainCKeepsPairsInRange)
+{
+    nbnxn_atomdata_t nbat = {};
+    nbat.XFormat = nbatXYZ;
+    nbat.xstride = DIM;
+    nbat.x       = system_.x.data();
+
+    makeOuterList(NBNXN_CPU_CLUSTER_I_SIZE, NBNXN_CPU_CLUSTER_I_SIZE);
+    nbnxn_kernel_prune_ref(&nbl_, &nbat, shiftVec_, c_rlistInner);
+
+    checkInnerList();
+}
+
+#ifdef GMX_NBNXN_SIMD_4XN
+TEST_F(NbnxnKernelPruneTest, Simd4xNKeepsPairsInRange)
+{
+    runSimdPrune(nbnxnk4xN_SIMD_4xN, GMX_SIMD_REAL_WIDTH);
+
+    checkInnerList();
+}
+#endif
+
+#ifdef GMX_NBNXN_SIMD_2XNN
+TEST_F(NbnxnKernelPruneTest, Simd2xNNKeepsPairsInRange)
+{
+    runSimdPrune(nbnxnk4xN_SIMD_2xNN, GMX_SIMD_REAL_WIDTH/2);
+
+    checkInnerList();
+}
+#endif
+
+} // namespace
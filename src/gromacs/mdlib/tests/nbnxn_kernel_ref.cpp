@@ -0,0 +1,311 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Tests for the template reference nbnxn kernel
+ *
+ * Checks the kernel against a simple all-pairs loop and checks
+ * that all cluster geometries give the same forces and energies.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include <cmath>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/units.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdlib/forcerec.h"
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_template.h"
+#include "gromacs/mdtypes/interaction_const.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testasserts.h"
+
+#include "nbnxn_testsystem.h"
+
+namespace
+{
+
+using gmx::test::c_nbnxnTestNumAtoms;
+using gmx::test::c_nbnxnTestNumTypes;
+
+//! The number of energy groups
+const int c_numEnergyGrps = 2;
+
+/*! \brief The shared nbnxn test system with the kernel data set up for it */
+class NbnxnKernelRefTest : public ::testing::Test
+{
+    public:
+        //! Sets up the atoms and the interaction constants
+        NbnxnKernelRefTest() :
+            nbfpComb_(c_nbnxnTestNumTypes*2),
+            energrp_(c_nbnxnTestNumAtoms/NBNXN_CPU_CLUSTER_I_SIZE, 0)
+        {
+            for (int a = 0; a < c_nbnxnTestNumAtoms; a++)
+            {
+                /* Energy groups are stored per cluster of 4 atoms */
+                energrp_[a/NBNXN_CPU_CLUSTER_I_SIZE] |=
+                    ((a % 5 == 0 ? 1 : 0) << ((a % NBNXN_CPU_CLUSTER_I_SIZE)*1));
+            }
+            for (int ti = 0; ti < c_nbnxnTestNumTypes; ti++)
+            {
+                /* Only used for LJ-PME, where the values only need
+                 * to be consistent between the kernel flavors compared.
+                 */
+                nbfpComb_[ti*2]     = std::sqrt(6*system_.c6[ti]);
+                nbfpComb_[ti*2 + 1] = 0.6 + 0.1*ti;
+            }
+
+            nbat_.ntype     = c_nbnxnTestNumTypes;
+            nbat_.nbfp      = system_.nbfp.data();
+            nbat_.nbfp_comb = nbfpComb_.data();
+            nbat_.type      = system_.type.data();
+            nbat_.q         = system_.q.data();
+            nbat_.x         = system_.x.data();
+            nbat_.na_c      = NBNXN_CPU_CLUSTER_I_SIZE;
+            nbat_.nenergrp  = c_numEnergyGrps;
+            nbat_.neg_2log  = 1;
+            nbat_.energrp   = energrp_.data();
+            nbat_.xstride   = DIM;
+            nbat_.fstride   = DIM;
+
+            const real rc           = 0.9;
+            ic_.cutoff_scheme       = ecutsVERLET;
+            ic_.rcoulomb            = rc;
+            ic_.rvdw                = rc;
+            ic_.rvdw_switch         = 0.7;
+            ic_.epsfac              = ONE_4PI_EPS0;
+            ic_.k_rf                = 0.5/(rc*rc*rc);
+            ic_.c_rf                = 1/rc + ic_.k_rf*rc*rc;
+            ic_.dispersion_shift.cpot = -1/std::pow(rc, 6);
+            ic_.repulsion_shift.cpot  = -1/std::pow(rc, 12);
+            /* The switching constants only need to be consistent
+             * between the kernel flavors compared here.
+             */
+            ic_.dispersion_shift.c2 = -2.1;
+            ic_.dispersion_shift.c3 = 3.2;
+            ic_.repulsion_shift.c2  = -0.9;
+            ic_.repulsion_shift.c3  = 1.4;
+            ic_.vdw_switch.c3       = -80;
+            ic_.vdw_switch.c4       = 300;
+            ic_.vdw_switch.c5       = -280;
+            ic_.ewaldcoeff_lj       = 2.5;
+            ic_.sh_lj_ewald         = 0.1;
+
+            clear_rvecs(SHIFTS, shiftVec_);
+        }
+
+        //! Builds a pair list with all atom pairs, each pair once
+        template<int c_iClusterSize, int c_jClusterSize>
+        void makePairlist()
+        {
+            gmx::test::makeNbnxnAllPairsList(c_nbnxnTestNumAtoms, c_iClusterSize, c_jClusterSize,
+                                             &ci_, &cj_);
+            nbl_.nci = ci_.size();
+            nbl_.ci  = ci_.data();
+            nbl_.ncj = cj_.size();
+            nbl_.cj  = cj_.data();
+        }
+
+        //! Runs the kernel with cluster geometry and interaction types
+        template<int c_iClusterSize, int c_jClusterSize,
+                 NbnxnRefCoulomb coulombType, NbnxnRefVdw vdwType, NbnxnRefEnergy energyType>
+        void runKernel(std::vector<real> *f, std::vector<real> *Vvdw, std::vector<real> *Vc)
+        {
+            makePairlist<c_iClusterSize, c_jClusterSize>();
+
+            const int numEnergyTerms = (energyType == NbnxnRefEnergy::Groups ?
+                                        c_numEnergyGrps*c_numEnergyGrps : 1);
+            f->assign(c_nbnxnTestNumAtoms*DIM, 0);
+            Vvdw->assign(numEnergyTerms, 0);
+            Vc->assign(numEnergyTerms, 0);
+            real fshift[SHIFTS*DIM] = { 0 };
+
+            nbnxn_kernel_ref_template<c_iClusterSize, c_jClusterSize,
+                                      coulombType, vdwType, energyType>
+                (&nbl_, &nbat_, &ic_, shiftVec_, f->data(), fshift,
+                Vvdw->data(), Vc->data());
+        }
+
+        //! Checks that two sets of forces and energies match
+        void compare(const std::vector<real> &fRef, const std::vector<real> &f,
+                     const std::vector<real> &VRef, const std::vector<real> &V)
+        {
+            real fMax = 0;
+            for (real fi : fRef)
+            {
+                fMax = std::max(fMax, std::abs(fi));
+            }
+            gmx::test::FloatingPointTolerance fTol =
+                gmx::test::absoluteTolerance(fMax*(GMX_DOUBLE ? 1e-10 : 1e-5));
+            for (size_t i = 0; i < fRef.size(); i++)
+            {
+                EXPECT_REAL_EQ_TOL(fRef[i], f[i], fTol) << "force element " << i;
+            }
+            ASSERT_EQ(VRef.size(), V.size());
+            for (size_t i = 0; i < VRef.size(); i++)
+            {
+                EXPECT_REAL_EQ_TOL(VRef[i], V[i], gmx::test::relativeToleranceAsFloatingPoint(VRef[i], GMX_DOUBLE ? 1e-10 : 1e-5));
+            }
+        }
+
+        //! Checks that all geometries give the 4x4 result
+        template<NbnxnRefCoulomb coulombType, NbnxnRefVdw vdwType, NbnxnRefEnergy energyType>
+        void testGeometries()
+        {
+            std::vector<real> fRef, VvdwRef, VcRef;
+            std::vector<real> f, Vvdw, Vc;
+
+            runKernel<4, 4, coulombType, vdwType, energyType>(&fRef, &VvdwRef, &VcRef);
+
+            runKernel<4, 2, coulombType, vdwType, energyType>(&f, &Vvdw, &Vc);
+            compare(fRef, f, VvdwRef, Vvdw);
+            compare(fRef, f, VcRef, Vc);
+            runKernel<4, 8, coulombType, vdwType, energyType>(&f, &Vvdw, &Vc);
+            compare(fRef, f, VvdwRef, Vvdw);
+            compare(fRef, f, VcRef, Vc);
+            runKernel<8, 4, coulombType, vdwType, energyType>(&f, &Vvdw, &Vc);
+            compare(fRef, f, VvdwRef, Vvdw);
+            compare(fRef, f, VcRef, Vc);
+            runKernel<2, 16, coulombType, vdwType, energyType>(&f, &Vvdw, &Vc);
+            compare(fRef, f, VvdwRef, Vvdw);
+            compare(fRef, f, VcRef, Vc);
+        }
+
+        //! The atoms and their parameters
+        gmx::test::NbnxnTestSystem system_;
+        //! LJ parameters per type for LJ-PME
+        std::vector<real>         nbfpComb_;
+        //! Energy groups per cluster
+        std::vector<int>          energrp_;
+        //! The atom data
+        nbnxn_atomdata_t          nbat_ = {};
+        //! The interaction constants
+        interaction_const_t       ic_   = {};
+        //! The shift vectors, only the central one is non-zero
+        rvec                      shiftVec_[SHIFTS];
+        //! The i-entries of the pair list
+        std::vector<nbnxn_ci_t>   ci_;
+        //! The j-entries of the pair list
+        std::vector<nbnxn_cj_t>   cj_;
+        //! The pair list
+        nbnxn_pairlist_t          nbl_ = {};
+};
+
+TEST_F(NbnxnKernelRefTest, MatchesAllPairsReactionField)
+{
+    std::vector<real> f, Vvdw, Vc;
+    runKernel<4, 4, NbnxnRefCoulomb::ReactionField, NbnxnRefVdw::Cut, NbnxnRefEnergy::Total>(&f, &Vvdw, &Vc);
+
+    std::vector<real> fRef(c_nbnxnTestNumAtoms*DIM, 0);
+    double            VvdwRef = 0, VcRef = 0;
+    const double      rc2     = ic_.rcoulomb*ic_.rcoulomb;
+    for (int a = 0; a < c_nbnxnTestNumAtoms; a++)
+    {
+        /* Self term of the reaction field exclusion correction */
+        VcRef -= 0.5*ic_.epsfac*system_.q[a]*system_.q[a]*ic_.c_rf;
+        for (int b = a + 1; b < c_nbnxnTestNumAtoms; b++)
+        {
+            rvec dx;
+            rvec_sub(&system_.x[a*DIM], &system_.x[b*DIM], dx);
+            double rsq = norm2(dx);
+            if (rsq >= rc2)
+            {
+                continue;
+            }
+            double rinv    = 1/std::sqrt(rsq);
+            double rinvsq  = rinv*rinv;
+            double rinvsix = rinvsq*rinvsq*rinvsq;
+            double c6      = system_.nbfp[(system_.type[a]*c_nbnxnTestNumTypes + system_.type[b])*2];
+            double c12     = system_.nbfp[(system_.type[a]*c_nbnxnTestNumTypes + system_.type[b])*2 + 1];
+            double qq      = ic_.epsfac*system_.q[a]*system_.q[b];
+            double fscal   = (c12*rinvsix*rinvsix - c6*rinvsix)*rinvsq + qq*(rinv*rinvsq - 2*ic_.k_rf);
+            VvdwRef       += (c12*(rinvsix*rinvsix + ic_.repulsion_shift.cpot))/12 - (c6*(rinvsix + ic_.dispersion_shift.cpot))/6;
+            VcRef         += qq*(rinv + ic_.k_rf*rsq - ic_.c_rf);
+            for (int d = 0; d < DIM; d++)
+            {
+                fRef[a*DIM + d] += fscal*dx[d];
+                fRef[b*DIM + d] -= fscal*dx[d];
+            }
+        }
+    }
+
+    compare(fRef, f, { static_cast<real>(VvdwRef) }, Vvdw);
+    compare(fRef, f, { static_cast<real>(VcRef) }, Vc);
+}
+
+TEST_F(NbnxnKernelRefTest, GeometriesAgreeReactionField)
+{
+    testGeometries<NbnxnRefCoulomb::ReactionField, NbnxnRefVdw::Cut, NbnxnRefEnergy::Total>();
+}
+
+TEST_F(NbnxnKernelRefTest, GeometriesAgreeEnergyGroups)
+{
+    testGeometries<NbnxnRefCoulomb::ReactionField, NbnxnRefVdw::ForceSwitch, NbnxnRefEnergy::Groups>();
+}
+
+TEST_F(NbnxnKernelRefTest, GeometriesAgreePotentialSwitch)
+{
+    testGeometries<NbnxnRefCoulomb::ReactionField, NbnxnRefVdw::PotentialSwitch, NbnxnRefEnergy::Total>();
+}
+
+TEST_F(NbnxnKernelRefTest, GeometriesAgreeEwaldTable)
+{
+    ic_.eeltype      = eelPME;
+    ic_.vdwtype      = evdwPME;
+    ic_.ewaldcoeff_q = 3.47;
+    ic_.sh_ewald     = std::erfc(ic_.ewaldcoeff_q*ic_.rcoulomb)/ic_.rcoulomb;
+    init_interaction_const_tables(nullptr, &ic_, 0);
+
+    testGeometries<NbnxnRefCoulomb::Table, NbnxnRefVdw::EwaldGeom, NbnxnRefEnergy::Groups>();
+
+    ic_.rvdw = 0.8;
+    testGeometries<NbnxnRefCoulomb::TableTwinCut, NbnxnRefVdw::EwaldLB, NbnxnRefEnergy::Total>();
+
+    sfree_aligned(ic_.tabq_coul_F);
+    sfree_aligned(ic_.tabq_coul_V);
+    sfree_aligned(ic_.tabq_coul_FDV0);
+    sfree_aligned(ic_.tabq_vdw_F);
+    sfree_aligned(ic_.tabq_vdw_V);
+    sfree_aligned(ic_.tabq_vdw_FDV0);
+}
+
+} // namespace
@@ -0,0 +1,306 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Tests for the nbnxn user table kernels
+ *
+ * Checks the plain-C user table kernel against the template reference
+ * kernel with plain cut-off interactions tabulated in the user table,
+ * and checks that the SIMD 4xN kernel gives the plain-C result.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include <cmath>
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/units.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdlib/nb_verlet.h"
+#include "gromacs/mdlib/nbnxn_atomdata.h"
+#include "gromacs/mdlib/nbnxn_consts.h"
+#include "gromacs/mdlib/nbnxn_simd.h"
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref_template.h"
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_usertab.h"
+#include "gromacs/mdtypes/interaction_const.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/tables/cubicsplinetable.h"
+
+#include "testutils/testasserts.h"
+
+#include "nbnxn_testsystem.h"
+
+namespace
+{
+
+using gmx::test::c_nbnxnTestNumAtoms;
+using gmx::test::c_nbnxnTestNumTypes;
+
+//! The cut-off distance
+const real c_cutoff   = 0.9;
+//! The spacing of the user table, as in typical table files
+const real c_spacing  = 0.002;
+
+/*! \brief The shared nbnxn test system with a user table that contains
+ * plain Coulomb and LJ
+ */
+class NbnxnKernelUsertabTest : public ::testing::Test
+{
+    public:
+        //! Sets up the atoms, the interaction constants and the table
+        NbnxnKernelUsertabTest()
+        {
+            /* Reaction-field with k_rf=c_rf=0 is plain cut-off Coulomb,
+             * and without potential shifts the reference kernel computes
+             * what the user table below contains.
+             */
+            ic_.cutoff_scheme = ecutsVERLET;
+            ic_.rcoulomb      = c_cutoff;
+            ic_.rvdw          = c_cutoff;
+            ic_.epsfac        = ONE_4PI_EPS0;
+
+            clear_rvecs(SHIFTS, shiftVec_);
+
+            /* The user table as makeUserSplineTable() sets it up from
+             * a table file: the LJ functions are scaled by 1/6 and 1/12
+             * and the functions are zero close to the origin.
+             */
+            const real          rZero = 0.04;
+            std::vector<double> coul, coulDer, disp, dispDer, rep, repDer;
+            for (int i = 0; i*c_spacing <= c_cutoff + 3*c_spacing; i++)
+            {
+                double r     = i*c_spacing;
+                bool   bZero = (r < rZero);
+                coul.push_back(bZero ? 0 : 1/r);
+                coulDer.push_back(bZero ? 0 : -1/(r*r));
+                disp.push_back(bZero ? 0 : -1/(6*std::pow(r, 6)));
+                dispDer.push_back(bZero ? 0 : 1/std::pow(r, 7));
+                rep.push_back(bZero ? 0 : 1/(12*std::pow(r, 12)));
+                repDer.push_back(bZero ? 0 : -1/std::pow(r, 13));
+            }
+            table_.reset(new gmx::CubicSplineTable({{"Coulomb", coul, coulDer, c_spacing},
+                                                    {"Dispersion", disp, dispDer, c_spacing},
+                                                    {"Repulsion", rep, repDer, c_spacing}},
+                                                   { rZero + c_spacing, c_cutoff },
+                                                   gmx::CubicSplineTable::UseInputSpacing()));
+        }
+
+        //! Builds a pair list with all atom pairs, each pair once
+        void makePairlist(int iClusterSize, int jClusterSize)
+        {
+            gmx::test::makeNbnxnAllPairsList(c_nbnxnTestNumAtoms, iClusterSize, jClusterSize,
+                                             &ci_, &cj_);
+            nbl_.na_ci = iClusterSize;
+            nbl_.na_cj = jClusterSize;
+            nbl_.nci   = ci_.size();
+            nbl_.ci    = ci_.data();
+            nbl_.ncj   = cj_.size();
+            nbl_.cj    = cj_.data();
+        }
+
+        /*! \brief Runs the user table kernel for \p kernelType
+         *
+         * Returns the forces in rvec layout and the energies.
+         */
+        void runUsertabKernel(int kernelType, std::vector<real> *f, real *Vc, real *Vvdw)
+        {
+            nbnxn_atomdata_t nbat = {};
+
+            nbnxn_atomdata_init(nullptr, &nbat, kernelType, enbnxninitcombruleNONE,
+                                c_nbnxnTestNumTypes, system_.nbfp.data(), 1, 1, nullptr, nullptr);
+            nbnxn_atomdata_realloc(&nbat, c_nbnxnTestNumAtoms);
+            nbat.natoms = c_nbnxnTestNumAtoms;
+
+            /* With packed coordinates x, y and z are stored in packs */
+            int packSize = 1;
+            if (nbat.XFormat == nbatX4)
+            {
+                packSize = 4;
+            }
+            else if (nbat.XFormat == nbatX8)
+            {
+                packSize = 8;
+            }
+            std::vector<int> xIndex(c_nbnxnTestNumAtoms);
+            for (int a = 0; a < c_nbnxnTestNumAtoms; a++)
+            {
+                if (packSize == 1)
+                {
+                    xIndex[a] = a*nbat.xstride;
+                }
+                else
+                {
+                    xIndex[a] = DIM*(a & ~(packSize - 1)) + (a & (packSize - 1));
+                }
+                for (int d = 0; d < DIM; d++)
+                {
+                    nbat.x[xIndex[a] + d*packSize] = system_.x[a*DIM + d];
+                }
+                nbat.q[a]    = system_.q[a];
+                nbat.type[a] = system_.type[a];
+            }
+
+            real *fNbat = nbat.out[0].f;
+            for (int i = 0; i < c_nbnxnTestNumAtoms*nbat.fstride; i++)
+            {
+                fNbat[i] = 0;
+            }
+            real fshift[SHIFTS*DIM] = { 0 };
+            *Vc   = 0;
+            *Vvdw = 0;
+
+            if (kernelType == nbnxnk4xN_SIMD_4xN)
+            {
+                makePairlist(NBNXN_CPU_CLUSTER_I_SIZE, GMX_SIMD_REAL_WIDTH);
+                nbnxn_kernel_usertab_4xn(&nbl_, &nbat, &ic_, *table_, shiftVec_,
+                                         fNbat, fshift, Vc, Vvdw);
+            }
+            else
+            {
+                makePairlist(NBNXN_CPU_CLUSTER_I_SIZE, NBNXN_CPU_CLUSTER_I_SIZE);
+                nbnxn_kernel_usertab_ref(&nbl_, &nbat, &ic_, *table_, shiftVec_,
+                                         fNbat, fshift, Vc, Vvdw);
+            }
+
+            f->assign(c_nbnxnTestNumAtoms*DIM, 0);
+            for (int a = 0; a < c_nbnxnTestNumAtoms; a++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    (*f)[a*DIM + d] = fNbat[xIndex[a] + d*packSize];
+                }
+            }
+        }
+
+        //! Runs the template reference kernel with plain cut-off interactions
+        void runRefKernel(std::vector<real> *f, real *Vc, real *Vvdw)
+        {
+            std::vector<int>  energrp(c_nbnxnTestNumAtoms/NBNXN_CPU_CLUSTER_I_SIZE, 0);
+            std::vector<real> nbfpComb(c_nbnxnTestNumTypes*2, 0);
+            nbnxn_atomdata_t  nbat = {};
+            nbat.ntype     = c_nbnxnTestNumTypes;
+            nbat.nbfp      = system_.nbfp.data();
+            nbat.nbfp_comb = nbfpComb.data();
+            nbat.type      = system_.type.data();
+            nbat.q         = system_.q.data();
+            nbat.x         = system_.x.data();
+            nbat.na_c      = NBNXN_CPU_CLUSTER_I_SIZE;
+            nbat.nenergrp  = 1;
+            nbat.neg_2log  = 1;
+            nbat.energrp   = energrp.data();
+            nbat.xstride   = DIM;
+            nbat.fstride   = DIM;
+
+            makePairlist(NBNXN_CPU_CLUSTER_I_SIZE, NBNXN_CPU_CLUSTER_I_SIZE);
+
+            f->assign(c_nbnxnTestNumAtoms*DIM, 0);
+            real fshift[SHIFTS*DIM] = { 0 };
+            *Vc   = 0;
+            *Vvdw = 0;
+            nbnxn_kernel_ref_template<NBNXN_CPU_CLUSTER_I_SIZE, NBNXN_CPU_CLUSTER_I_SIZE,
+                                      NbnxnRefCoulomb::ReactionField, NbnxnRefVdw::Cut,
+                                      NbnxnRefEnergy::Total>
+                (&nbl_, &nbat, &ic_, shiftVec_, f->data(), fshift, Vvdw, Vc);
+        }
+
+        //! Checks that two sets of forces and energies match within \p relTol
+        void compare(const std::vector<real> &fRef, const std::vector<real> &f,
+                     real VcRef, real Vc, real VvdwRef, real Vvdw,
+                     double relTol)
+        {
+            real fMax = 0;
+            for (real fi : fRef)
+            {
+                fMax = std::max(fMax, std::abs(fi));
+            }
+            gmx::test::FloatingPointTolerance fTol = gmx::test::absoluteTolerance(fMax*relTol);
+            for (size_t i = 0; i < fRef.size(); i++)
+            {
+                EXPECT_REAL_EQ_TOL(fRef[i], f[i], fTol) << "force element " << i;
+            }
+            EXPECT_REAL_EQ_TOL(VcRef, Vc, gmx::test::relativeToleranceAsFloatingPoint(VcRef, relTol));
+            EXPECT_REAL_EQ_TOL(VvdwRef, Vvdw, gmx::test::relativeToleranceAsFloatingPoint(VvdwRef, relTol));
+        }
+
+        //! The atoms and their parameters
+        gmx::test::NbnxnTestSystem             system_;
+        //! The interaction constants
+        interaction_const_t                    ic_ = {};
+        //! The shift vectors, only the central one is non-zero
+        rvec                                   shiftVec_[SHIFTS];
+        //! The user table
+        std::unique_ptr<gmx::CubicSplineTable> table_;
+        //! The i-entries of the pair list
+        std::vector<nbnxn_ci_t>                ci_;
+        //! The j-entries of the pair list
+        std::vector<nbnxn_cj_t>                cj_;
+        //! The pair list
+        nbnxn_pairlist_t                       nbl_ = {};
+};
+
+TEST_F(NbnxnKernelUsertabTest, PlainCMatchesReferenceKernel)
+{
+    std::vector<real> fRef, f;
+    real              VcRef, VvdwRef, Vc, Vvdw;
+
+    runRefKernel(&fRef, &VcRef, &VvdwRef);
+    runUsertabKernel(nbnxnk4x4_PlainC, &f, &Vc, &Vvdw);
+
+    /* The difference is the cubic spline interpolation error of the
+     * table with the spacing of a table file.
+     */
+    compare(fRef, f, VcRef, Vc, VvdwRef, Vvdw, 1e-4);
+}
+
+#ifdef GMX_NBNXN_SIMD_4XN
+TEST_F(NbnxnKernelUsertabTest, Simd4xNMatchesPlainC)
+{
+    std::vector<real> fRef, f;
+    real              VcRef, VvdwRef, Vc, Vvdw;
+
+    runUsertabKernel(nbnxnk4x4_PlainC, &fRef, &VcRef, &VvdwRef);
+    runUsertabKernel(nbnxnk4xN_SIMD_4xN, &f, &Vc, &Vvdw);
+
+    /* Only the summation order differs */
+    compare(fRef, f, VcRef, Vc, VvdwRef, Vvdw, GMX_DOUBLE ? 1e-10 : 1e-5);
+}
+#endif
+
+} // namespace
@@ -0,0 +1,123 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Implements the test system and pair list shared by the nbnxn kernel tests
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "nbnxn_testsystem.h"
+
+#include <cmath>
+
+#include "gromacs/math/vectypes.h"
+#include "gromacs/pbcutil/ishift.h"
+
+namespace gmx
+{
+namespace test
+{
+
+NbnxnTestSystem::NbnxnTestSystem() :
+    x(c_nbnxnTestNumAtoms*DIM), q(c_nbnxnTestNumAtoms), type(c_nbnxnTestNumAtoms),
+    nbfp(c_nbnxnTestNumTypes*c_nbnxnTestNumTypes*2),
+    c6({ 0.0026, 0.0040 })
+{
+    const real spacing = 0.32;
+    for (int a = 0; a < c_nbnxnTestNumAtoms; a++)
+    {
+        const int ix = a % 4, iy = (a/4) % 4, iz = a/16;
+        /* Deterministic perturbations */
+        x[a*DIM + XX] = ix*spacing + 0.05*std::sin(1.3*a);
+        x[a*DIM + YY] = iy*spacing + 0.05*std::sin(2.1*a + 1);
+        x[a*DIM + ZZ] = iz*spacing + 0.05*std::sin(0.7*a + 2);
+        q[a]          = (a % 2 == 0 ? 0.4 : -0.4);
+        type[a]       = (a % 3 == 0 ? 1 : 0);
+    }
+    const real c12[c_nbnxnTestNumTypes] = { 2.6e-6, 4.1e-6 };
+    for (int ti = 0; ti < c_nbnxnTestNumTypes; ti++)
+    {
+        for (int tj = 0; tj < c_nbnxnTestNumTypes; tj++)
+        {
+            /* The kernels use 6*C6 and 12*C12 */
+            nbfp[(ti*c_nbnxnTestNumTypes + tj)*2]     = 6*std::sqrt(c6[ti]*c6[tj]);
+            nbfp[(ti*c_nbnxnTestNumTypes + tj)*2 + 1] = 12*std::sqrt(c12[ti]*c12[tj]);
+        }
+    }
+}
+
+void makeNbnxnAllPairsList(int numAtoms, int iClusterSize, int jClusterSize,
+                           std::vector<nbnxn_ci_t> *ci,
+                           std::vector<nbnxn_cj_t> *cj)
+{
+    ci->clear();
+    cj->clear();
+    for (int ciIndex = 0; ciIndex < numAtoms/iClusterSize; ciIndex++)
+    {
+        nbnxn_ci_t ciEntry;
+        ciEntry.ci           = ciIndex;
+        ciEntry.shift        = CENTRAL | NBNXN_CI_DO_LJ(0) | NBNXN_CI_DO_COUL(0);
+        ciEntry.cj_ind_start = cj->size();
+        for (int cjIndex = 0; cjIndex < numAtoms/jClusterSize; cjIndex++)
+        {
+            if ((cjIndex + 1)*jClusterSize <= ciIndex*iClusterSize)
+            {
+                /* All j-atoms are before all i-atoms */
+                continue;
+            }
+            unsigned int excl = 0;
+            for (int i = 0; i < iClusterSize; i++)
+            {
+                for (int j = 0; j < jClusterSize; j++)
+                {
+                    if (cjIndex*jClusterSize + j > ciIndex*iClusterSize + i)
+                    {
+                        excl |= (1U << (i*jClusterSize + j));
+                    }
+                }
+            }
+            nbnxn_cj_t cjEntry;
+            cjEntry.cj   = cjIndex;
+            cjEntry.excl = excl;
+            cj->push_back(cjEntry);
+        }
+        ciEntry.cj_ind_end = cj->size();
+        ci->push_back(ciEntry);
+    }
+}
+
+} // namespace test
+} // namespace gmx
@@ -0,0 +1,94 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Declares the test system and pair list shared by the nbnxn kernel tests
+ *
+ * \ingroup module_mdlib
+ */
+#ifndef GMX_MDLIB_TESTS_NBNXN_TESTSYSTEM_H
+#define GMX_MDLIB_TESTS_NBNXN_TESTSYSTEM_H
+
+#include <vector>
+
+#include "gromacs/mdlib/nbnxn_pairlist.h"
+#include "gromacs/utility/real.h"
+
+namespace gmx
+{
+namespace test
+{
+
+//! The number of atoms in the test system, a multiple of all cluster sizes tested
+const int c_nbnxnTestNumAtoms = 96;
+//! The number of atom types in the test system
+const int c_nbnxnTestNumTypes = 2;
+
+/*! \internal \brief
+ * Atoms on a perturbed 4x4x6 lattice without periodicity
+ *
+ * Charges alternate in sign and every third atom has the second,
+ * larger LJ type, so all interaction type pairs occur.
+ */
+struct NbnxnTestSystem
+{
+    //! Sets up the coordinates, charges, types and LJ parameters
+    NbnxnTestSystem();
+
+    //! Coordinates, stored as x, y, z per atom
+    std::vector<real> x;
+    //! Charges
+    std::vector<real> q;
+    //! Atom types
+    std::vector<int>  type;
+    //! LJ parameters per type pair, 6*C6 and 12*C12 as the kernels use them
+    std::vector<real> nbfp;
+    //! The C6 parameter per type
+    std::vector<real> c6;
+};
+
+/*! \brief Builds a pair list with all pairs of \p numAtoms atoms, each pair once
+ *
+ * Pairs are only included when the j-atom index is larger than
+ * the i-atom index, all other pairs in a cluster pair are masked
+ * out by the exclusion mask.
+ */
+void makeNbnxnAllPairsList(int numAtoms, int iClusterSize, int jClusterSize,
+                           std::vector<nbnxn_ci_t> *ci,
+                           std::vector<nbnxn_cj_t> *cj);
+
+} // namespace test
+} // namespace gmx
+
+#endif
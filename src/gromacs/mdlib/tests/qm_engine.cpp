@@ -0,0 +1,162 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the built-in point-charge test engine of the in-process QM engine interface
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "gromacs/mdlib/qm_engine.h"
+
+#include <cmath>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/units.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+
+namespace test
+{
+
+//! Test fixture with two QM atoms and one MM point charge
+class QMPointChargeEngineTest : public ::testing::Test
+{
+    public:
+        //! Constructor
+        QMPointChargeEngineTest() :
+            atomicNumber_ {8, 1},
+            xQM_ {0.0, 0.0, 0.0, 0.1, 0.0, 0.0},
+            qQM_ {-0.8, 0.4},
+            xMM_ {0.0, 0.3, 0.1},
+            qMM_ {0.5}
+        {
+            functions_           = gmx_qm_pointcharge_engine();
+            system_.nQM          = 2;
+            system_.atomicNumber = atomicNumber_.data();
+            system_.xQM          = xQM_.data();
+            system_.qQM          = qQM_.data();
+            system_.charge       = 0;
+            system_.multiplicity = 1;
+            system_.method       = 0;
+            system_.basis        = 0;
+            system_.nMM          = 1;
+            system_.xMM          = xMM_.data();
+            system_.qMM          = qMM_.data();
+        }
+
+        //! Returns the energy of the current system
+        double energy()
+        {
+            double              energy;
+            std::vector<double> gradQM(3*system_.nQM), gradMM(3*system_.nMM);
+            EXPECT_EQ(0, functions_->calculate(nullptr, &system_, &energy,
+                                               gradQM.data(), gradMM.data()));
+            return energy;
+        }
+
+        //! The engine functions
+        const gmx_qm_engine_functions_t *functions_;
+        //! The system description passed to the engine
+        gmx_qm_system_t                  system_;
+        //! Atomic numbers
+        std::vector<int>                 atomicNumber_;
+        //! QM coordinates
+        std::vector<double>              xQM_;
+        //! QM charges
+        std::vector<double>              qQM_;
+        //! MM coordinates
+        std::vector<double>              xMM_;
+        //! MM charges
+        std::vector<double>              qMM_;
+};
+
+TEST_F(QMPointChargeEngineTest, ImplementsTheInterface)
+{
+    ASSERT_NE(nullptr, functions_);
+    EXPECT_EQ(GMX_QM_ENGINE_INTERFACE_VERSION, functions_->interfaceVersion);
+
+    void *engineData = nullptr;
+    EXPECT_EQ(0, functions_->init(&system_, &engineData));
+}
+
+TEST_F(QMPointChargeEngineTest, EnergyIsDampedCoulomb)
+{
+    double d2        = 0.05*0.05;
+    double r01       = std::sqrt(0.1*0.1 + d2);
+    double r02       = std::sqrt(0.3*0.3 + 0.1*0.1 + d2);
+    double r12       = std::sqrt(0.1*0.1 + 0.3*0.3 + 0.1*0.1 + d2);
+    double reference = ONE_4PI_EPS0*(qQM_[0]*qQM_[1]/r01 +
+                                     qQM_[0]*qMM_[0]/r02 +
+                                     qQM_[1]*qMM_[0]/r12);
+
+    EXPECT_DOUBLE_EQ_TOL(reference, energy(), relativeToleranceAsFloatingPoint(reference, 1e-12));
+}
+
+TEST_F(QMPointChargeEngineTest, GradientsMatchFiniteDifferences)
+{
+    double              energy0;
+    std::vector<double> gradQM(3*system_.nQM), gradMM(3*system_.nMM);
+    ASSERT_EQ(0, functions_->calculate(nullptr, &system_, &energy0,
+                                       gradQM.data(), gradMM.data()));
+
+    const double        delta = 1e-6;
+    std::vector<double> gradient(gradQM);
+    gradient.insert(gradient.end(), gradMM.begin(), gradMM.end());
+    for (size_t i = 0; i < gradient.size(); i++)
+    {
+        double *x  = (i < xQM_.size() ? &xQM_[i] : &xMM_[i - xQM_.size()]);
+        double  x0 = *x;
+        *x = x0 + delta;
+        double  energyPlus  = energy();
+        *x = x0 - delta;
+        double  energyMinus = energy();
+        *x = x0;
+
+        double  numerical   = (energyPlus - energyMinus)/(2*delta);
+        EXPECT_NEAR(numerical, gradient[i], 1e-4*std::abs(energy0)) << "coordinate " << i;
+    }
+}
+
+} // namespace test
+
+} // namespace gmx
@@ -0,0 +1,278 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the displacement ratio and pair-list cut-off of the
+ * run-time Verlet buffer tuning
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "gromacs/mdlib/verletbuf_tuning.h"
+
+#include <cmath>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/units.h"
+#include "gromacs/mdlib/calc_verletbuf.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+
+namespace test
+{
+
+namespace
+{
+
+//! The list lifetime in ps
+const real c_listTime = 0.02;
+
+//! Returns the average sum of m*v^2 for \p numAtoms atoms at \p temperature
+double massVel2(int numAtoms, real temperature)
+{
+    return numAtoms*3*BOLTZ*temperature;
+}
+
+//! Returns the sum of m*dx^2 for displacements \p ratio times ballistic
+double massDisp2(int numAtoms, real temperature, real ratio)
+{
+    return ratio*massVel2(numAtoms, temperature)*c_listTime*c_listTime;
+}
+
+TEST(VerletBufferTuningRatioTest, RatioOfSingleTypeHasSafetyFactor)
+{
+    std::vector<double> sumMassDisp2 = { massDisp2(100, 300, 0.5) };
+    std::vector<double> sumMassVel2  = { massVel2(100, 300) };
+
+    EXPECT_REAL_EQ_TOL(1.1*0.5, verletbuf_tuning_ratio(sumMassDisp2, sumMassVel2, c_listTime),
+                       relativeToleranceAsFloatingPoint(1, 1e-5));
+}
+
+TEST(VerletBufferTuningRatioTest, RatioIsMaximumOverAtomTypes)
+{
+    /* Many damped heavy atoms and a few light atoms which move ballistically.
+     * A mass weighted ratio over all atoms would be close to 0.3.
+     */
+    std::vector<double> sumMassDisp2 = { massDisp2(1000, 300, 0.3), massDisp2(10, 300, 0.8) };
+    std::vector<double> sumMassVel2  = { massVel2(1000, 300), massVel2(10, 300) };
+
+    EXPECT_REAL_EQ_TOL(1.1*0.8, verletbuf_tuning_ratio(sumMassDisp2, sumMassVel2, c_listTime),
+                       relativeToleranceAsFloatingPoint(1, 1e-5));
+}
+
+TEST(VerletBufferTuningRatioTest, RatioIgnoresAtomTypesWithoutAtoms)
+{
+    std::vector<double> sumMassDisp2 = { 0, massDisp2(100, 300, 0.5), 0 };
+    std::vector<double> sumMassVel2  = { 0, massVel2(100, 300), 0 };
+
+    EXPECT_REAL_EQ_TOL(1.1*0.5, verletbuf_tuning_ratio(sumMassDisp2, sumMassVel2, c_listTime),
+                       relativeToleranceAsFloatingPoint(1, 1e-5));
+}
+
+TEST(VerletBufferTuningRatioTest, RatioIsAtMostOne)
+{
+    std::vector<double> sumMassDisp2 = { massDisp2(100, 300, 0.95), massDisp2(100, 300, 1.2) };
+    std::vector<double> sumMassVel2  = { massVel2(100, 300), massVel2(100, 300) };
+
+    EXPECT_EQ(1, verletbuf_tuning_ratio(sumMassDisp2, sumMassVel2, c_listTime));
+}
+
+//! Test fixture with a system of heavy and light atoms for the pair-list cut-off
+class VerletBufferTuningRlistTest : public ::testing::Test
+{
+    public:
+        //! The number of molecules with one heavy and one light atom
+        static const int c_numMolecules = 1000;
+
+        //! Sets up the topology and MD input
+        VerletBufferTuningRlistTest() : atoms_(2), iparams_(4), moltype_ {}, molblock_ {}, mtop_ {}
+        {
+            atoms_[0].m          = 40;
+            atoms_[0].q          = -0.5;
+            atoms_[0].type       = 0;
+            atoms_[0].ptype      = eptAtom;
+            atoms_[1].m          = 1;
+            atoms_[1].q          = 0.5;
+            atoms_[1].type       = 1;
+            atoms_[1].ptype      = eptAtom;
+            moltype_.atoms.nr    = atoms_.size();
+            moltype_.atoms.atom  = atoms_.data();
+
+            molblock_.type       = 0;
+            molblock_.nmol       = c_numMolecules;
+            molblock_.natoms_mol = atoms_.size();
+
+            mtop_.nmoltype       = 1;
+            mtop_.moltype        = &moltype_;
+            mtop_.nmolblock      = 1;
+            mtop_.molblock       = &molblock_;
+            mtop_.natoms         = c_numMolecules*atoms_.size();
+            mtop_.mols.nr        = c_numMolecules;
+
+            /* LJ parameters with geometric combination */
+            const real c6[2]  = { 6e-3, 1e-4 };
+            const real c12[2] = { 6e-6, 1e-8 };
+            for (int i = 0; i < 2; i++)
+            {
+                for (int j = 0; j < 2; j++)
+                {
+                    iparams_[i*2 + j].lj.c6  = std::sqrt(c6[i]*c6[j]);
+                    iparams_[i*2 + j].lj.c12 = std::sqrt(c12[i]*c12[j]);
+                }
+            }
+            mtop_.ffparams.atnr    = 2;
+            mtop_.ffparams.ntypes  = iparams_.size();
+            mtop_.ffparams.iparams = iparams_.data();
+            mtop_.ffparams.reppow  = 12;
+
+            ir_.eI            = eiMD;
+            ir_.etc           = etcVRESCALE;
+            ir_.delta_t       = 0.002;
+            ir_.nstlist       = 10;
+            ir_.verletbuf_tol = 0.005;
+            ir_.vdwtype       = evdwCUT;
+            ir_.vdw_modifier  = eintmodPOTSHIFT;
+            ir_.rvdw          = 0.9;
+            ir_.coulombtype   = eelRF;
+            ir_.epsilon_r     = 1;
+            ir_.epsilon_rf    = 0;
+            ir_.rcoulomb      = 0.9;
+            ir_.opts.ngtc     = 1;
+            snew(ir_.opts.ref_t, 1);
+            snew(ir_.opts.tau_t, 1);
+            ir_.opts.ref_t[0] = c_temperature;
+            ir_.opts.tau_t[0] = 0.1;
+        }
+
+        //! Returns the pair-list cut-off for ratio \p ratio
+        real rlist(real ratio)
+        {
+            real rlist, rlistInner;
+
+            verletbuf_tuning_calc_rlist(&mtop_, c_boxVolume, &ir_, c_temperature,
+                                        0, ratio, &rlist, &rlistInner);
+
+            return rlist;
+        }
+
+        //! The reference temperature
+        static constexpr real c_temperature = 300;
+        //! The volume of the system
+        static constexpr real c_boxVolume   = 30;
+
+        //! The atoms of the molecule type
+        std::vector<t_atom>    atoms_;
+        //! The interaction parameters
+        std::vector<t_iparams> iparams_;
+        //! The molecule type
+        gmx_moltype_t          moltype_;
+        //! The molecule block
+        gmx_molblock_t         molblock_;
+        //! The system topology
+        gmx_mtop_t             mtop_;
+        //! The MD input
+        t_inputrec             ir_;
+};
+
+constexpr real VerletBufferTuningRlistTest::c_temperature;
+constexpr real VerletBufferTuningRlistTest::c_boxVolume;
+
+TEST_F(VerletBufferTuningRlistTest, RatioOneGivesStaticEstimate)
+{
+    verletbuf_list_setup_t ls;
+    real                   rlistStatic;
+
+    verletbuf_get_list_setup(TRUE, FALSE, &ls);
+    calc_verlet_buffer_size(&mtop_, c_boxVolume, &ir_, c_temperature, &ls,
+                            nullptr, &rlistStatic);
+
+    EXPECT_REAL_EQ_TOL(rlistStatic, rlist(1), defaultRealTolerance());
+}
+
+TEST_F(VerletBufferTuningRlistTest, SmallerRatioGivesSmallerBuffer)
+{
+    real rlistFull = rlist(1);
+    real rlistHalf = rlist(0.5);
+
+    EXPECT_LT(rlistHalf, rlistFull);
+    EXPECT_GE(rlistHalf, ir_.rvdw);
+}
+
+TEST_F(VerletBufferTuningRlistTest, UndampedLightAtomsKeepTheFullBuffer)
+{
+    /* The heavy atoms are strongly damped, the light ones not at all */
+    std::vector<double> sumMassDisp2 = {
+        massDisp2(c_numMolecules, c_temperature, 0.2),
+        massDisp2(c_numMolecules, c_temperature, 1)
+    };
+    std::vector<double> sumMassVel2  = {
+        massVel2(c_numMolecules, c_temperature),
+        massVel2(c_numMolecules, c_temperature)
+    };
+
+    real ratio = verletbuf_tuning_ratio(sumMassDisp2, sumMassVel2, c_listTime);
+
+    EXPECT_REAL_EQ_TOL(rlist(1), rlist(ratio), defaultRealTolerance());
+}
+
+TEST_F(VerletBufferTuningRlistTest, PrunedListHasInnerCutoff)
+{
+    real rlistOuter, rlistInner;
+
+    verletbuf_tuning_calc_rlist(&mtop_, c_boxVolume, &ir_, c_temperature,
+                                2, 0.5, &rlistOuter, &rlistInner);
+
+    EXPECT_REAL_EQ_TOL(rlist(0.5), rlistOuter, defaultRealTolerance());
+    EXPECT_LE(rlistInner, rlistOuter);
+    EXPECT_GE(rlistInner, ir_.rvdw);
+}
+
+} // namespace
+
+} // namespace test
+
+} // namespace gmx
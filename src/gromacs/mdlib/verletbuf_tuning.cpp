@@ -0,0 +1,416 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ *
+ * \brief Defines functions for tuning the Verlet pair-list buffer
+ * at run time.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "verletbuf_tuning.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+#include <vector>
+
+#include "gromacs/domdec/domdec.h"
+#include "gromacs/gmxlib/network.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdlib/calc_verletbuf.h"
+#include "gromacs/mdlib/nb_verlet.h"
+#include "gromacs/mdlib/sim_util.h"
+#include "gromacs/mdtypes/commrec.h"
+#include "gromacs/mdtypes/forcerec.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/interaction_const.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/mdtypes/mdatom.h"
+#include "gromacs/mdtypes/state.h"
+#include "gromacs/utility/arrayref.h"
+#include "gromacs/utility/cstringutil.h"
+#include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/gmxassert.h"
+
+/*! \brief The default number of list lifetimes between buffer updates */
+static const int c_numMeasurementsPerUpdateDefault = 10;
+
+/*! \brief Safety factor applied to the measured displacement ratio
+ *
+ * The buffer estimate is sensitive to the tails of the displacement
+ * distribution, which are less certain than its variance.
+ */
+static const real c_displacementRatioSafetyFactor = 1.1;
+
+/*! \brief The minimum decrease in nm for which we change rlist */
+static const real c_rlistMinDecrease = 0.005;
+
+struct verletbuf_tuning_t
+{
+    int                    numMeasurementsPerUpdate; /**< Number of list lifetimes between updates */
+    real                   referenceTemperature;     /**< Temperature used by the static estimate */
+    real                   listTime;                 /**< The list lifetime in ps */
+    real                   rlistStatic;              /**< The static buffer estimate */
+    real                   rlistInnerStatic;         /**< The static estimate of the pruned list */
+    gmx_int64_t            storeStep;                /**< The step the coordinates were stored */
+    std::vector<gmx::RVec> x;                        /**< The home atom coordinates at storeStep */
+    std::vector<double>    storeMassVel2;            /**< Local sums of m*v^2 per atom type at storeStep */
+    std::vector<double>    sumMassDisp2;             /**< Local sums of m*dx^2 per atom type, since the last update */
+    std::vector<double>    sumMassVel2;              /**< Local sums of m*v^2 per atom type at the start of the measurements */
+    int                    numMeasurements;          /**< Number of measurements since the last update */
+    std::vector<double>    totMassDisp2;             /**< Global sums of m*dx^2 per atom type over all updates */
+    std::vector<double>    totMassVel2;              /**< Global sums of m*v^2 per atom type over all updates */
+    int                    numRatios;                /**< Number of measurements in the total sums */
+    real                   ratioApplied;             /**< The (safety corrected) ratio used for the current buffer */
+    int                    numChanges;               /**< The number of times rlist was changed */
+};
+
+/*! \brief Returns the number of list lifetimes between buffer updates
+ *
+ * Tuning is requested by setting GMX_VERLET_BUFFER_TUNING, optionally
+ * to the number of list lifetimes between updates.
+ * Returns 0 when tuning is not requested.
+ */
+static int get_verletbuf_tuning_env()
+{
+    const char *env = getenv("GMX_VERLET_BUFFER_TUNING");
+
+    if (env == nullptr)
+    {
+        return 0;
+    }
+    if (*env == '\0')
+    {
+        return c_numMeasurementsPerUpdateDefault;
+    }
+
+    char *end;
+    int   numMeasurements = strtol(env, &end, 10);
+    if (*end != '\0' || numMeasurements < 1)
+    {
+        gmx_fatal(FARGS, "Invalid value passed in GMX_VERLET_BUFFER_TUNING=%s, positive integer required", env);
+    }
+
+    return numMeasurements;
+}
+
+void init_verletbuf_tuning(verletbuf_tuning_t **vbt_p,
+                           FILE                *fplog,
+                           const t_commrec     *cr,
+                           const t_inputrec    *ir,
+                           const t_forcerec    *fr,
+                           gmx_bool             bPMETune)
+{
+    *vbt_p = nullptr;
+
+    const int numMeasurementsPerUpdate = get_verletbuf_tuning_env();
+    if (numMeasurementsPerUpdate == 0)
+    {
+        return;
+    }
+
+    const char *note = nullptr;
+    if (ir->cutoff_scheme != ecutsVERLET)
+    {
+        note = "it requires the Verlet cut-off scheme";
+    }
+    else if (!(EI_MD(ir->eI) || EI_SD(ir->eI)) || ir->nstlist <= 1)
+    {
+        note = "it requires MD or SD integration with nstlist > 1";
+    }
+    else if (ir->verletbuf_tol <= 0 || (EI_MD(ir->eI) && ir->etc == etcNO))
+    {
+        note = "it requires verlet-buffer-tolerance and a thermostat";
+    }
+    else if (use_GPU(fr->nbv))
+    {
+        note = "it is only supported with CPU non-bonded kernels";
+    }
+    else if (bPMETune)
+    {
+        note = "PME load balancing also changes the pair-list cut-off, use -notunepme";
+    }
+    if (note != nullptr)
+    {
+        if (MASTER(cr) && fplog != nullptr)
+        {
+            fprintf(fplog, "\nNOTE: Not tuning the Verlet buffer at run time, as %s\n", note);
+        }
+        return;
+    }
+
+    verletbuf_tuning_t *vbt = new verletbuf_tuning_t;
+
+    vbt->numMeasurementsPerUpdate = numMeasurementsPerUpdate;
+
+    /* As calc_verlet_buffer_size, use the maximum coupling temperature */
+    vbt->referenceTemperature = 0;
+    for (int g = 0; g < ir->opts.ngtc; g++)
+    {
+        if (ir->opts.tau_t[g] >= 0)
+        {
+            vbt->referenceTemperature = std::max(vbt->referenceTemperature,
+                                                 ir->opts.ref_t[g]);
+        }
+    }
+
+    vbt->listTime         = ir->nstlist*ir->delta_t;
+    vbt->rlistStatic      = fr->ic->rlist;
+    vbt->rlistInnerStatic = (fr->nbv->bDynamicPruning ? fr->nbv->rlistInner : 0);
+    vbt->storeStep        = -1;
+    vbt->storeMassVel2.resize(fr->ntype);
+    vbt->sumMassDisp2.assign(fr->ntype, 0);
+    vbt->sumMassVel2.assign(fr->ntype, 0);
+    vbt->numMeasurements  = 0;
+    vbt->totMassDisp2.assign(fr->ntype, 0);
+    vbt->totMassVel2.assign(fr->ntype, 0);
+    vbt->numRatios        = 0;
+    vbt->ratioApplied     = 1;
+    vbt->numChanges       = 0;
+
+    if (MASTER(cr) && fplog != nullptr)
+    {
+        fprintf(fplog, "\nTuning the Verlet buffer at run time, starting from rlist %g, updating every %d list lifetimes\n\n",
+                vbt->rlistStatic, vbt->numMeasurementsPerUpdate);
+    }
+
+    *vbt_p = vbt;
+}
+
+void verletbuf_tuning_store_x(verletbuf_tuning_t *vbt,
+                              gmx_int64_t         step,
+                              const t_mdatoms    *mdatoms,
+                              const rvec         *x,
+                              const rvec         *v)
+{
+    vbt->storeStep = step;
+    vbt->x.resize(mdatoms->homenr);
+    std::fill(vbt->storeMassVel2.begin(), vbt->storeMassVel2.end(), 0);
+    for (int i = 0; i < mdatoms->homenr; i++)
+    {
+        copy_rvec(x[i], vbt->x[i]);
+        /* The ballistic displacements are v*t */
+        vbt->storeMassVel2[mdatoms->typeA[i]] += mdatoms->massT[i]*norm2(v[i]);
+    }
+}
+
+/*! \brief Adds the mass weighted square displacements of the home atoms per atom type */
+static void measure_displacements(verletbuf_tuning_t *vbt,
+                                  const t_mdatoms    *mdatoms,
+                                  const rvec         *x)
+{
+    /* Between search steps atoms are not put back in the box,
+     * so we do not need to consider periodic images.
+     */
+    for (int i = 0; i < mdatoms->homenr; i++)
+    {
+        rvec dx;
+
+        rvec_sub(x[i], vbt->x[i], dx);
+        vbt->sumMassDisp2[mdatoms->typeA[i]] += mdatoms->massT[i]*norm2(dx);
+    }
+    for (size_t t = 0; t < vbt->sumMassVel2.size(); t++)
+    {
+        vbt->sumMassVel2[t] += vbt->storeMassVel2[t];
+    }
+
+    vbt->numMeasurements++;
+}
+
+real verletbuf_tuning_ratio(gmx::ConstArrayRef<double> sumMassDisp2,
+                            gmx::ConstArrayRef<double> sumMassVel2,
+                            real                       listTime)
+{
+    GMX_RELEASE_ASSERT(sumMassDisp2.size() == sumMassVel2.size(), "We need sums for all atom types");
+
+    real ratio = 0;
+    for (size_t t = 0; t < sumMassDisp2.size(); t++)
+    {
+        if (sumMassVel2[t] > 0)
+        {
+            ratio = std::max(ratio, static_cast<real>(sumMassDisp2[t]/(sumMassVel2[t]*listTime*listTime)));
+        }
+    }
+
+    return std::min(c_displacementRatioSafetyFactor*ratio, static_cast<real>(1));
+}
+
+void verletbuf_tuning_calc_rlist(const gmx_mtop_t *mtop,
+                                 real              boxVolume,
+                                 const t_inputrec *ir,
+                                 real              referenceTemperature,
+                                 int               nstlistPrune,
+                                 real              ratio,
+                                 real             *rlist,
+                                 real             *rlistInner)
+{
+    verletbuf_list_setup_t ls;
+
+    /* The displacement variance is proportional to the temperature */
+    real temperature = ratio*referenceTemperature;
+
+    /* As in prepare_verlet_scheme, we assume SIMD kernels */
+    verletbuf_get_list_setup(TRUE, FALSE, &ls);
+    if (nstlistPrune > 0)
+    {
+        calc_verlet_buffer_size_pruned(mtop, boxVolume, ir, nstlistPrune,
+                                       temperature, &ls,
+                                       rlist, rlistInner);
+    }
+    else
+    {
+        calc_verlet_buffer_size(mtop, boxVolume, ir, temperature, &ls,
+                                nullptr, rlist);
+    }
+}
+
+/*! \brief Sets the pair-list cut-off(s) for the current displacement ratio */
+static void update_rlist(verletbuf_tuning_t *vbt,
+                         FILE               *fplog,
+                         t_commrec          *cr,
+                         const t_inputrec   *ir,
+                         const gmx_mtop_t   *mtop,
+                         t_forcerec         *fr,
+                         t_state            *state,
+                         gmx_int64_t         step,
+                         real                ratio)
+{
+    interaction_const_t    *ic  = fr->ic;
+    nonbonded_verlet_t     *nbv = fr->nbv;
+    real                    rlistNew, rlistInnerNew = 0;
+
+    verletbuf_tuning_calc_rlist(mtop, det(state->box), ir, vbt->referenceTemperature,
+                                nbv->bDynamicPruning ? nbv->nstlistPrune : 0,
+                                ratio, &rlistNew, &rlistInnerNew);
+    rlistNew = std::min(rlistNew, vbt->rlistStatic);
+
+    /* Avoid frequent small changes, but always increase when needed */
+    if (rlistNew > ic->rlist - c_rlistMinDecrease && rlistNew <= ic->rlist)
+    {
+        return;
+    }
+
+    if (DOMAINDECOMP(cr) && !change_dd_cutoff(cr, state, ir, rlistNew))
+    {
+        /* This should not happen, as we never increase beyond the static
+         * buffer, but we can continue with the current buffer.
+         */
+        return;
+    }
+
+    if (MASTER(cr) && fplog != nullptr)
+    {
+        char buf[STEPSTRSIZE];
+
+        fprintf(fplog, "step %s: Verlet buffer tuning, displacement ratio %.3f, changing rlist from %g to %g\n",
+                gmx_step_str(step, buf), ratio, ic->rlist, rlistNew);
+    }
+
+    ic->rlist = rlistNew;
+    if (nbv->bDynamicPruning)
+    {
+        nbv->rlistInner = std::min(std::min(rlistInnerNew, vbt->rlistInnerStatic),
+                                   rlistNew);
+    }
+    vbt->ratioApplied = ratio;
+    vbt->numChanges++;
+}
+
+void verletbuf_tuning_do(verletbuf_tuning_t *vbt,
+                         FILE               *fplog,
+                         t_commrec          *cr,
+                         const t_inputrec   *ir,
+                         const gmx_mtop_t   *mtop,
+                         t_forcerec         *fr,
+                         t_state            *state,
+                         const t_mdatoms    *mdatoms,
+                         gmx_int64_t         step)
+{
+    /* We can only measure over a complete list lifetime without
+     * intermediate repartitioning, which reorders the atoms.
+     */
+    if (vbt->storeStep < 0 || step != vbt->storeStep + ir->nstlist ||
+        static_cast<int>(vbt->x.size()) != mdatoms->homenr)
+    {
+        return;
+    }
+
+    measure_displacements(vbt, mdatoms, as_rvec_array(state->x.data()));
+
+    if (vbt->numMeasurements < vbt->numMeasurementsPerUpdate)
+    {
+        return;
+    }
+
+    /* Sum the displacements and ballistic references per atom type */
+    const int           numTypes = vbt->sumMassDisp2.size();
+    std::vector<double> sums(vbt->sumMassDisp2);
+    sums.insert(sums.end(), vbt->sumMassVel2.begin(), vbt->sumMassVel2.end());
+    if (PAR(cr))
+    {
+        gmx_sumd(sums.size(), sums.data(), cr);
+    }
+    for (int t = 0; t < numTypes; t++)
+    {
+        vbt->totMassDisp2[t] += sums[t];
+        vbt->totMassVel2[t]  += sums[numTypes + t];
+    }
+    std::fill(vbt->sumMassDisp2.begin(), vbt->sumMassDisp2.end(), 0);
+    std::fill(vbt->sumMassVel2.begin(), vbt->sumMassVel2.end(), 0);
+    vbt->numRatios       += vbt->numMeasurements;
+    vbt->numMeasurements  = 0;
+
+    update_rlist(vbt, fplog, cr, ir, mtop, fr, state, step,
+                 verletbuf_tuning_ratio(vbt->totMassDisp2, vbt->totMassVel2,
+                                        vbt->listTime));
+}
+
+void done_verletbuf_tuning(verletbuf_tuning_t *vbt,
+                           FILE               *fplog)
+{
+    if (fplog != nullptr && vbt->numRatios > 0)
+    {
+        fprintf(fplog, "\nVerlet buffer tuning: displacement ratio %.3f over %d list lifetimes,\n"
+                "rlist changed %d times, last applied ratio %.3f\n\n",
+                verletbuf_tuning_ratio(vbt->totMassDisp2, vbt->totMassVel2,
+                                       vbt->listTime),
+                vbt->numRatios, vbt->numChanges, vbt->ratioApplied);
+    }
+
+    delete vbt;
+}
@@ -0,0 +1,153 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ *
+ * \brief Declares functions for tuning the Verlet pair-list buffer
+ * at run time.
+ *
+ * The buffer estimate of calc_verlet_buffer_size() assumes ballistic
+ * atom displacements over the list lifetime. In dense systems collisions
+ * make the actual displacements smaller. During the run the displacements
+ * of the home atoms are measured over the list lifetime and compared,
+ * per atom type, with the ballistic displacements given by the velocities
+ * at the start of the lifetime. The maximum ratio over the atom types is
+ * used to lower the effective temperature passed to the buffer estimate,
+ * which is then re-evaluated for the same drift tolerance. Taking the
+ * maximum ensures that light atoms, which are often less damped than
+ * heavy atoms, do not get a smaller buffer than they need.
+ * The buffer starts at the static estimate and is only ever decreased.
+ *
+ * \inlibraryapi
+ * \ingroup module_mdlib
+ */
+
+#ifndef GMX_MDLIB_VERLETBUF_TUNING_H
+#define GMX_MDLIB_VERLETBUF_TUNING_H
+
+#include <cstdio>
+
+#include "gromacs/math/vectypes.h"
+#include "gromacs/utility/arrayref.h"
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/real.h"
+
+struct gmx_mtop_t;
+struct t_commrec;
+struct t_forcerec;
+struct t_inputrec;
+struct t_mdatoms;
+class t_state;
+
+/*! \brief Object to manage the run-time Verlet buffer tuning */
+struct verletbuf_tuning_t;
+
+/*! \brief Initialize the Verlet buffer tuning, when requested
+ *
+ * Sets *vbt_p to nullptr when tuning is not requested with the
+ * environment variable GMX_VERLET_BUFFER_TUNING, or when it is
+ * not supported with the current setup, in which case a note
+ * is printed to fplog.
+ */
+void init_verletbuf_tuning(verletbuf_tuning_t **vbt_p,
+                           FILE                *fplog,
+                           const t_commrec     *cr,
+                           const t_inputrec    *ir,
+                           const t_forcerec    *fr,
+                           gmx_bool             bPMETune);
+
+/*! \brief Store the home atom coordinates at a search step
+ *
+ * Should be called after do_force() at every search step, after
+ * the atoms have been put in the box. The velocities \p v give
+ * the ballistic displacements over the list lifetime.
+ */
+void verletbuf_tuning_store_x(verletbuf_tuning_t *vbt,
+                              gmx_int64_t         step,
+                              const t_mdatoms    *mdatoms,
+                              const rvec         *x,
+                              const rvec         *v);
+
+/*! \brief Measure the displacements and adjust the buffer when needed
+ *
+ * Should be called at every step that is a multiple of nstlist,
+ * before any repartitioning. The displacements are measured when
+ * the coordinates were stored nstlist steps ago. Every so many
+ * measurements the estimate is updated, which involves a global
+ * summation, and the pair-list cut-off of the next list is changed.
+ */
+void verletbuf_tuning_do(verletbuf_tuning_t *vbt,
+                         FILE               *fplog,
+                         t_commrec          *cr,
+                         const t_inputrec   *ir,
+                         const gmx_mtop_t   *mtop,
+                         t_forcerec         *fr,
+                         t_state            *state,
+                         const t_mdatoms    *mdatoms,
+                         gmx_int64_t         step);
+
+/*! \brief Returns the displacement ratio to apply to the buffer estimate
+ *
+ * \p sumMassDisp2 and \p sumMassVel2 are the sums, per atom type, of
+ * the mass weighted square displacements over the list lifetime
+ * \p listTime and of the mass weighted square velocities at the start
+ * of the lifetime. Returns the maximum over the atom types of the ratio
+ * of the measured and ballistic displacements, with a safety factor
+ * applied and limited to 1.
+ */
+real verletbuf_tuning_ratio(gmx::ConstArrayRef<double> sumMassDisp2,
+                            gmx::ConstArrayRef<double> sumMassVel2,
+                            real                       listTime);
+
+/*! \brief Computes the pair-list cut-off(s) for displacement ratio \p ratio
+ *
+ * The displacement variance is proportional to the temperature, so
+ * the buffer is estimated for ratio times \p referenceTemperature.
+ * With \p nstlistPrune > 0 the outer and inner cut-off of the dynamically
+ * pruned list are returned, otherwise only \p rlist is set.
+ */
+void verletbuf_tuning_calc_rlist(const gmx_mtop_t *mtop,
+                                 real              boxVolume,
+                                 const t_inputrec *ir,
+                                 real              referenceTemperature,
+                                 int               nstlistPrune,
+                                 real              ratio,
+                                 real             *rlist,
+                                 real             *rlistInner);
+
+/*! \brief Print the final buffer settings to fplog and free vbt */
+void done_verletbuf_tuning(verletbuf_tuning_t *vbt,
+                           FILE               *fplog);
+
+#endif
@@ -93,6 +93,18 @@ class MDModules::Impl : public IMDOutputProvider, public IForceProvider
         {
             // not called currently
         }
+        virtual void prepareForcesForAtomRanges(const t_commrec  * /*cr*/,
+                                                const t_mdatoms  * /*mdatoms*/,
+                                                PaddedRVecVector * /*force*/,
+                                                double             /*t*/)
+        {
+            // not called currently
+        }
+        virtual void calculateForcesForAtomRange(int /*atomStart*/,
+                                                 int /*atomEnd*/)
+        {
+            // not called currently
+        }
 
         std::unique_ptr<IMDModule> field_;
 };
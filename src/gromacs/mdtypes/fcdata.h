@@ -70,6 +70,8 @@ typedef struct t_disresdata {
     real *Rt_6;            /* The instantaneous ensemble averaged r^-6 (nres)  */
     real *Rtav_6;          /* The time and ensemble averaged r^-6 (nres)       */
     int   nsystems;        /* The number of systems for ensemble averaging     */
+    int   nthread_alloc;   /* The number of threads Rt_6_thread is allocated for */
+    real *Rt_6_thread;     /* Thread-local Rt_6 and Rtav_6 (nthread x 2*nres)  */
 
     /* TODO: Implement a proper solution for parallel disre indexing */
     const t_iatom *forceatomsStart; /* Pointer to the start of the disre forceatoms */
@@ -100,6 +102,12 @@ typedef struct t_oriresdata {
     rvec5    *tmp;           /* An array of temporary 5-vectors (nex);             */
     real   ***TMP;           /* An array of temporary 5x5 matrices (nex);          */
     real     *eig;           /* Eigenvalues/vectors, for output only (nex x 12)    */
+    int       nthread_alloc; /* The number of threads tmp_thread is allocated for  */
+    real     *tmp_thread;    /* Thread-local sums of tmp and the lower half of TMP *
+                              * (nthread x nex x 20)                               */
+
+    /* Pointer to the start of the orires forceatoms, for the restraint index */
+    const t_iatom *forceatomsStart;
 
     /* variables for diagonalization with diagonalize_orires_tensors()*/
     double **M;
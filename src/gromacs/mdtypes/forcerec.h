@@ -55,6 +55,7 @@ struct gmx_ns_t;
 struct gmx_pme_t;
 struct nonbonded_verlet_t;
 struct bonded_threading_t;
+struct gmx_cvreduce_t;
 struct t_forcetable;
 struct t_nblist;
 struct t_nblists;
@@ -129,17 +130,30 @@ struct gmx_grppairener_t
     real *ener[egNR]; /* Energy terms for each pair of groups */
 };
 
+/* Running sums of the energy group pair energies over the energy
+ * steps without output. They are added to the averages at the next
+ * energy step that is not deferred, see CGLO_DEFERGRPP.
+ */
+struct gmx_grppairener_sum_t
+{
+    int      nstep;       /* The number of steps in the sums, 0 when empty      */
+    gmx_bool bDeferred;   /* Whether the last energy step was added to the sums */
+    double  *esum[egNR];  /* Sums of grpp.ener over the steps                   */
+    double  *esum2[egNR]; /* Sums of the squares of grpp.ener over the steps    */
+};
+
 struct gmx_enerdata_t
 {
-    real                     term[F_NRE];         /* The energies for all different interaction types */
-    struct gmx_grppairener_t grpp;
-    double                   dvdl_lin[efptNR];    /* Contributions to dvdl with linear lam-dependence */
-    double                   dvdl_nonlin[efptNR]; /* Idem, but non-linear dependence                  */
-    int                      n_lambda;
-    int                      fep_state;           /*current fep state -- just for printing */
-    double                  *enerpart_lambda;     /* Partial energy for lambda and flambda[] */
-    real                     foreign_term[F_NRE]; /* alternate array for storing foreign lambda energies */
-    struct gmx_grppairener_t foreign_grpp;        /* alternate array for storing foreign lambda energies */
+    real                           term[F_NRE];         /* The energies for all different interaction types */
+    struct gmx_grppairener_t       grpp;
+    struct gmx_grppairener_sum_t   grpp_sum;
+    double                         dvdl_lin[efptNR];    /* Contributions to dvdl with linear lam-dependence */
+    double                         dvdl_nonlin[efptNR]; /* Idem, but non-linear dependence                  */
+    int                            n_lambda;
+    int                            fep_state;           /*current fep state -- just for printing */
+    double                        *enerpart_lambda;     /* Partial energy for lambda and flambda[] */
+    real                           foreign_term[F_NRE]; /* alternate array for storing foreign lambda energies */
+    struct gmx_grppairener_t       foreign_grpp;        /* alternate array for storing foreign lambda energies */
 };
 /* The idea is that dvdl terms with linear lambda dependence will be added
  * automatically to enerpart_lambda. Terms with non-linear lambda dependence
@@ -439,6 +453,12 @@ struct t_forcerec {
     struct ewald_corr_thread_t *ewc_t;
 
     struct IForceProvider      *efield;
+
+    /* Buffer for the fused global sums of rotation, flooding and pulling */
+    struct gmx_cvreduce_t      *cvreduce;
+
+    /* Buffer for the fused ensemble sums of the NMR restraints over simulations */
+    struct gmx_cvreduce_t      *ensemblereduce;
 };
 
 /* Important: Starting with Gromacs-4.6, the values of c6 and c12 in the nbfp array have
@@ -93,6 +93,38 @@ struct IForceProvider
                                      PaddedRVecVector *force,
                                      double            t) = 0;
 
+        /*! \brief
+         * Prepares computing forces per range of home atoms.
+         *
+         * Together with calculateForcesForAtomRange() this computes the
+         * same forces as calculateForces(), but allows the caller to add
+         * them within another pass over the atoms, such as the threaded
+         * reduction of the nonbonded forces, instead of in a separate pass
+         * over the force array. Should be called once per step, before
+         * any call to calculateForcesForAtomRange().
+         *
+         * \param[in]    cr      Communication record for parallel operations
+         * \param[in]    mdatoms Atom information
+         * \param[inout] force   The forces
+         * \param[in]    t       The actual time in the simulation (ps)
+         */
+        virtual void prepareForcesForAtomRanges(const t_commrec  *cr,
+                                                const t_mdatoms  *mdatoms,
+                                                PaddedRVecVector *force,
+                                                double            t) = 0;
+
+        /*! \brief
+         * Computes forces on the home atoms in a range.
+         *
+         * Can be called concurrently from multiple threads for
+         * non-overlapping ranges. Atoms beyond the home atoms are ignored.
+         *
+         * \param[in] atomStart  The first atom of the range
+         * \param[in] atomEnd    One past the last atom of the range
+         */
+        virtual void calculateForcesForAtomRange(int atomStart,
+                                                 int atomEnd) = 0;
+
     protected:
         ~IForceProvider() {}
 };
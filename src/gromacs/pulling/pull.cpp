@@ -1702,7 +1702,16 @@ real pull_potential(struct pull_t *pull, t_mdatoms *md, t_pbc *pbc,
     {
         real dVdl = 0;
 
-        pull_calc_coms(cr, pull, md, pbc, t, x, nullptr);
+        if (pull->comm.bLocalComSums)
+        {
+            /* The local sums have already been summed over the ranks */
+            pull_calc_coms_finish(cr, pull, md, pbc, t, x, nullptr);
+            pull->comm.bLocalComSums = FALSE;
+        }
+        else
+        {
+            pull_calc_coms(cr, pull, md, pbc, t, x, nullptr);
+        }
 
         for (int c = 0; c < pull->ncoord; c++)
         {
@@ -62,6 +62,7 @@
 extern "C" {
 #endif
 
+struct gmx_cvreduce_t;
 struct gmx_mtop_t;
 struct gmx_output_env_t;
 struct pull_params_t;
@@ -277,6 +278,30 @@ void pull_calc_coms(t_commrec        *cr,
                     rvec             *xp);
 
 
+/*! \brief Computes the local contributions to the COMs and registers them for summation.
+ *
+ * This allows the global summation for the pull group COMs to be fused
+ * with the summations of other modules. After cvreduce_finish() has been
+ * called on \p cvr, pull_potential() completes the COM calculation.
+ * Registration is not possible when only a subset of the ranks
+ * participates in pulling.
+ *
+ * \param[in] cr       Struct for communication info.
+ * \param[in] pull     The pull data structure.
+ * \param[in] md       All atoms.
+ * \param[in] pbc      Information struct about periodicity.
+ * \param[in] x        The local positions.
+ * \param[in] cvr      The buffer for the fused global summation.
+ * \returns whether the sums were registered with \p cvr.
+ */
+gmx_bool pull_calc_coms_local(t_commrec        *cr,
+                              struct pull_t    *pull,
+                              t_mdatoms        *md,
+                              struct t_pbc     *pbc,
+                              rvec              x[],
+                              gmx_cvreduce_t   *cvr);
+
+
 /*! \brief Returns if we have pull coordinates with potential pulling.
  *
  * \param[in] pull     The pull data structure.
@@ -55,6 +55,10 @@
 #include "gromacs/mdtypes/pull-params.h"
 #include "gromacs/utility/gmxmpi.h"
 
+struct t_commrec;
+struct t_mdatoms;
+struct t_pbc;
+
 /*! \cond INTERNAL */
 
 /*! \brief Determines up to what local atom count a pull group gets processed single-threaded.
@@ -158,6 +162,9 @@ typedef struct {
     rvec       *rbuf;            /* COM calculation buffer */
     dvec       *dbuf;            /* COM calculation buffer */
     double     *dbuf_cyl;        /* cylinder ref. groups calculation buffer */
+
+    gmx_bool    bLocalComSums;   /* Have the local COM sums in dbuf been registered
+                                    for summation by pull_calc_coms_local()? */
 }
 pull_comm_t;
 
@@ -200,6 +207,18 @@ struct pull_t
     int                numExternalPotentialsStillToBeAppliedThisStep;
 };
 
+/*! \brief Completes the COM calculation after the sums in comm->dbuf have been summed over the ranks
+ *
+ * The parameters are the same as for pull_calc_coms().
+ */
+void pull_calc_coms_finish(t_commrec     *cr,
+                           struct pull_t *pull,
+                           t_mdatoms     *md,
+                           struct t_pbc  *pbc,
+                           double         t,
+                           rvec           x[],
+                           rvec          *xp);
+
 /*! \endcond */
 
 #endif
@@ -57,6 +57,7 @@
 #include "gromacs/math/functions.h"
 #include "gromacs/math/utilities.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
 #include "gromacs/mdlib/groupcoord.h"
 #include "gromacs/mdlib/mdrun.h"
 #include "gromacs/mdlib/sim_util.h"
@@ -66,6 +67,7 @@
 #include "gromacs/timing/cyclecounter.h"
 #include "gromacs/timing/wallcycle.h"
 #include "gromacs/topology/mtop_lookup.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/pleasecite.h"
 #include "gromacs/utility/qsort_threadsafe.h"
@@ -151,9 +153,12 @@ typedef struct gmx_enfrotgrp
     rvec   xc_center;       /* Center of the rotation group positions, may
                                be mass weighted                               */
     rvec   xc_ref_center;   /* dito, for the reference positions              */
+    double xc_center_buf[4]; /* Local sums for the center, summed over nodes  */
     rvec  *xc;              /* Current (collective) positions                 */
     ivec  *xc_shifts;       /* Current (collective) shifts                    */
     ivec  *xc_eshifts;      /* Extra shifts since last DD step                */
+    gmx_group_gather_t *xc_gather; /* For collecting xc by all-gather,
+                                      nullptr when summing over the nodes */
     rvec  *xc_old;          /* Old (collective) positions                     */
     rvec  *xc_norm;         /* Normalized form of the current positions       */
     rvec  *xc_ref_sorted;   /* Reference positions (sorted in the same order
@@ -192,9 +197,8 @@ typedef struct gmx_enfrotgrp
                                          minimum value the gaussian must have so that
                                          the force is actually evaluated max_beta is
                                          just another way to put it                     */
-    real           *gn_atom;          /* Precalculated gaussians for a single atom      */
-    int            *gn_slabind;       /* Tells to which slab each precalculated gaussian
-                                         belongs                                        */
+    int               nth;            /* Number of OpenMP threads for the potentials    */
+    struct gmx_flexthread *flex_th;   /* Per-thread data for the potentials             */
     rvec           *slab_innersumvec; /* Inner sum of the flexible2 potential per slab;
                                          this is precalculated for optimization reasons */
     t_gmx_slabdata *slab_data;        /* Holds atom positions and gaussian weights
@@ -205,6 +209,20 @@ typedef struct gmx_enfrotgrp
 } t_gmx_enfrotgrp;
 
 
+/* Per-thread data for the flexible rotation potentials */
+typedef struct gmx_flexthread
+{
+    real *gn_atom;       /* Precalculated gaussians for a single atom      */
+    int  *gn_slabind;    /* Tells to which slab each precalculated gaussian
+                            belongs                                        */
+    real *slab_torque_v; /* This thread's contribution to the torque of
+                            each slab                                      */
+    real *fit_V;         /* Contributions to the potential for the fit
+                            angles                                         */
+    real  V;             /* Contribution to the rotation potential         */
+} t_gmx_flexthread;
+
+
 /* Activate output of forces for correctness checks */
 /* #define PRINT_FORCES */
 #ifdef PRINT_FORCES
@@ -639,11 +657,21 @@ static void get_slab_centers(
 
     erg = rotg->enfrotgrp;
 
-    /* Loop over slabs */
+    /* Loop over slabs, the slabs are independent */
+#pragma omp parallel for num_threads(erg->nth) schedule(static)
+    for (int n = erg->slab_first; n <= erg->slab_last; n++)
+    {
+        try
+        {
+            int ind                = n - erg->slab_first;
+            erg->slab_weights[ind] = get_slab_weight(n, rotg, xc, mc, &erg->slab_center[ind]);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
     for (j = erg->slab_first; j <= erg->slab_last; j++)
     {
-        islab                    = j - erg->slab_first;
-        erg->slab_weights[islab] = get_slab_weight(j, rotg, xc, mc, &erg->slab_center[islab]);
+        islab = j - erg->slab_first;
 
         /* We can do the calculations ONLY if there is weight in the slab! */
         if (erg->slab_weights[islab] > WEIGHT_MIN)
@@ -1654,28 +1682,28 @@ static gmx_inline int get_homeslab(
 
 
 /* For a local atom determine the relevant slabs, i.e. slabs in
- * which the gaussian is larger than min_gaussian
+ * which the gaussian is larger than min_gaussian, and store the
+ * gaussians and slab indices in gn_atom and gn_slabind
  */
 static int get_single_atom_gaussians(
         rvec       curr_x,
-        t_rotgrp  *rotg)
+        t_rotgrp  *rotg,
+        real      *gn_atom,
+        int       *gn_slabind)
 {
     int             slab, homeslab;
     real            g;
     int             count = 0;
-    gmx_enfrotgrp_t erg;      /* Pointer to enforced rotation group data */
 
 
-    erg = rotg->enfrotgrp;
-
     /* Determine the 'home' slab of this atom: */
     homeslab = get_homeslab(curr_x, rotg->vec, rotg->slab_dist);
 
     /* First determine the weight in the atoms home slab: */
     g = gaussian_weight(curr_x, rotg, homeslab);
 
-    erg->gn_atom[count]    = g;
-    erg->gn_slabind[count] = homeslab;
+    gn_atom[count]    = g;
+    gn_slabind[count] = homeslab;
     count++;
 
 
@@ -1685,8 +1713,8 @@ static int get_single_atom_gaussians(
     {
         slab++;
         g = gaussian_weight(curr_x, rotg, slab);
-        erg->gn_slabind[count] = slab;
-        erg->gn_atom[count]    = g;
+        gn_slabind[count] = slab;
+        gn_atom[count]    = g;
         count++;
     }
     count--;
@@ -1697,8 +1725,8 @@ static int get_single_atom_gaussians(
     {
         slab--;
         g = gaussian_weight(curr_x, rotg, slab);
-        erg->gn_slabind[count] = slab;
-        erg->gn_atom[count]    = g;
+        gn_slabind[count] = slab;
+        gn_atom[count]    = g;
         count++;
     }
     while (g > rotg->min_gaussian);
@@ -1708,9 +1736,10 @@ static int get_single_atom_gaussians(
 }
 
 
-static void flex2_precalc_inner_sum(t_rotgrp *rotg)
+/* Precalculate the inner sum of the flexible2 potential for slab n */
+static void flex2_precalc_inner_sum_slab(t_rotgrp *rotg, int n)
 {
-    int             i, n, islab;
+    int             i, islab;
     rvec            xi;       /* positions in the i-sum                        */
     rvec            xcn, ycn; /* the current and the reference slab centers    */
     real            gaussian_xi;
@@ -1729,70 +1758,84 @@ static void flex2_precalc_inner_sum(t_rotgrp *rotg)
     erg = rotg->enfrotgrp;
     N_M = rotg->nat * erg->invmass;
 
-    /* Loop over all slabs that contain something */
-    for (n = erg->slab_first; n <= erg->slab_last; n++)
-    {
-        islab = n - erg->slab_first; /* slab index */
+    islab = n - erg->slab_first; /* slab index */
 
-        /* The current center of this slab is saved in xcn: */
-        copy_rvec(erg->slab_center[islab], xcn);
-        /* ... and the reference center in ycn: */
-        copy_rvec(erg->slab_center_ref[islab+erg->slab_buffer], ycn);
-
-        /*** D. Calculate the whole inner sum used for second and third sum */
-        /* For slab n, we need to loop over all atoms i again. Since we sorted
-         * the atoms with respect to the rotation vector, we know that it is sufficient
-         * to calculate from firstatom to lastatom only. All other contributions will
-         * be very small. */
-        clear_rvec(innersumvec);
-        for (i = erg->firstatom[islab]; i <= erg->lastatom[islab]; i++)
-        {
-            /* Coordinate xi of this atom */
-            copy_rvec(erg->xc[i], xi);
-
-            /* The i-weights */
-            gaussian_xi = gaussian_weight(xi, rotg, n);
-            mi          = erg->mc_sorted[i]; /* need the sorted mass here */
-            wi          = N_M*mi;
-
-            /* Calculate rin */
-            copy_rvec(erg->xc_ref_sorted[i], yi0); /* Reference position yi0   */
-            rvec_sub(yi0, ycn, tmpvec2);           /* tmpvec2 = yi0 - ycn      */
-            mvmul(erg->rotmat, tmpvec2, rin);      /* rin = Omega.(yi0 - ycn)  */
-
-            /* Calculate psi_i* and sin */
-            rvec_sub(xi, xcn, tmpvec2);           /* tmpvec2 = xi - xcn       */
-            cprod(rotg->vec, tmpvec2, tmpvec);    /* tmpvec = v x (xi - xcn)  */
-            OOpsiistar = norm2(tmpvec)+rotg->eps; /* OOpsii* = 1/psii* = |v x (xi-xcn)|^2 + eps */
-            OOpsii     = norm(tmpvec);            /* OOpsii = 1 / psii = |v x (xi - xcn)| */
-
-            /*                           *         v x (xi - xcn)          */
-            unitv(tmpvec, s_in);        /*  sin = ----------------         */
-                                        /*        |v x (xi - xcn)|         */
-
-            sin_rin = iprod(s_in, rin); /* sin_rin = sin . rin             */
-
-            /* Now the whole sum */
-            fac = OOpsii/OOpsiistar;
-            svmul(fac, rin, tmpvec);
-            fac2 = fac*fac*OOpsii;
-            svmul(fac2*sin_rin, s_in, tmpvec2);
-            rvec_dec(tmpvec, tmpvec2);
+    /* The current center of this slab is saved in xcn: */
+    copy_rvec(erg->slab_center[islab], xcn);
+    /* ... and the reference center in ycn: */
+    copy_rvec(erg->slab_center_ref[islab+erg->slab_buffer], ycn);
 
-            svmul(wi*gaussian_xi*sin_rin, tmpvec, tmpvec2);
+    /*** D. Calculate the whole inner sum used for second and third sum */
+    /* For slab n, we need to loop over all atoms i again. Since we sorted
+     * the atoms with respect to the rotation vector, we know that it is sufficient
+     * to calculate from firstatom to lastatom only. All other contributions will
+     * be very small. */
+    clear_rvec(innersumvec);
+    for (i = erg->firstatom[islab]; i <= erg->lastatom[islab]; i++)
+    {
+        /* Coordinate xi of this atom */
+        copy_rvec(erg->xc[i], xi);
+
+        /* The i-weights */
+        gaussian_xi = gaussian_weight(xi, rotg, n);
+        mi          = erg->mc_sorted[i]; /* need the sorted mass here */
+        wi          = N_M*mi;
+
+        /* Calculate rin */
+        copy_rvec(erg->xc_ref_sorted[i], yi0); /* Reference position yi0   */
+        rvec_sub(yi0, ycn, tmpvec2);           /* tmpvec2 = yi0 - ycn      */
+        mvmul(erg->rotmat, tmpvec2, rin);      /* rin = Omega.(yi0 - ycn)  */
+
+        /* Calculate psi_i* and sin */
+        rvec_sub(xi, xcn, tmpvec2);           /* tmpvec2 = xi - xcn       */
+        cprod(rotg->vec, tmpvec2, tmpvec);    /* tmpvec = v x (xi - xcn)  */
+        OOpsiistar = norm2(tmpvec)+rotg->eps; /* OOpsii* = 1/psii* = |v x (xi-xcn)|^2 + eps */
+        OOpsii     = norm(tmpvec);            /* OOpsii = 1 / psii = |v x (xi - xcn)| */
+
+        /*                           *         v x (xi - xcn)          */
+        unitv(tmpvec, s_in);        /*  sin = ----------------         */
+                                    /*        |v x (xi - xcn)|         */
+
+        sin_rin = iprod(s_in, rin); /* sin_rin = sin . rin             */
+
+        /* Now the whole sum */
+        fac = OOpsii/OOpsiistar;
+        svmul(fac, rin, tmpvec);
+        fac2 = fac*fac*OOpsii;
+        svmul(fac2*sin_rin, s_in, tmpvec2);
+        rvec_dec(tmpvec, tmpvec2);
 
-            rvec_inc(innersumvec, tmpvec2);
-        } /* now we have the inner sum, used both for sum2 and sum3 */
+        svmul(wi*gaussian_xi*sin_rin, tmpvec, tmpvec2);
 
-        /* Save it to be used in do_flex2_lowlevel */
-        copy_rvec(innersumvec, erg->slab_innersumvec[islab]);
-    } /* END of loop over slabs */
+        rvec_inc(innersumvec, tmpvec2);
+    } /* now we have the inner sum, used both for sum2 and sum3 */
+
+    /* Save it to be used in do_flex2_lowlevel */
+    copy_rvec(innersumvec, erg->slab_innersumvec[islab]);
 }
 
 
-static void flex_precalc_inner_sum(t_rotgrp *rotg)
+static void flex2_precalc_inner_sum(t_rotgrp *rotg)
 {
-    int             i, n, islab;
+    gmx_enfrotgrp_t erg = rotg->enfrotgrp;
+
+    /* Loop over all slabs that contain something, the slabs are independent */
+#pragma omp parallel for num_threads(erg->nth) schedule(static)
+    for (int n = erg->slab_first; n <= erg->slab_last; n++)
+    {
+        try
+        {
+            flex2_precalc_inner_sum_slab(rotg, n);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+}
+
+
+/* Precalculate the inner sum of the flexible potential for slab n */
+static void flex_precalc_inner_sum_slab(t_rotgrp *rotg, int n)
+{
+    int             i, islab;
     rvec            xi;       /* position                                      */
     rvec            xcn, ycn; /* the current and the reference slab centers    */
     rvec            qin, rin; /* q_i^n and r_i^n                               */
@@ -1809,62 +1852,139 @@ static void flex_precalc_inner_sum(t_rotgrp *rotg)
     erg = rotg->enfrotgrp;
     N_M = rotg->nat * erg->invmass;
 
-    /* Loop over all slabs that contain something */
-    for (n = erg->slab_first; n <= erg->slab_last; n++)
+    islab = n - erg->slab_first; /* slab index */
+
+    /* The current center of this slab is saved in xcn: */
+    copy_rvec(erg->slab_center[islab], xcn);
+    /* ... and the reference center in ycn: */
+    copy_rvec(erg->slab_center_ref[islab+erg->slab_buffer], ycn);
+
+    /* For slab n, we need to loop over all atoms i again. Since we sorted
+     * the atoms with respect to the rotation vector, we know that it is sufficient
+     * to calculate from firstatom to lastatom only. All other contributions will
+     * be very small. */
+    clear_rvec(innersumvec);
+    for (i = erg->firstatom[islab]; i <= erg->lastatom[islab]; i++)
     {
-        islab = n - erg->slab_first; /* slab index */
+        /* Coordinate xi of this atom */
+        copy_rvec(erg->xc[i], xi);
+
+        /* The i-weights */
+        gaussian_xi = gaussian_weight(xi, rotg, n);
+        mi          = erg->mc_sorted[i]; /* need the sorted mass here */
+        wi          = N_M*mi;
+
+        /* Calculate rin and qin */
+        rvec_sub(erg->xc_ref_sorted[i], ycn, tmpvec); /* tmpvec = yi0-ycn */
+        mvmul(erg->rotmat, tmpvec, rin);              /* rin = Omega.(yi0 - ycn)  */
+        cprod(rotg->vec, rin, tmpvec);                /* tmpvec = v x Omega*(yi0-ycn) */
 
-        /* The current center of this slab is saved in xcn: */
-        copy_rvec(erg->slab_center[islab], xcn);
-        /* ... and the reference center in ycn: */
-        copy_rvec(erg->slab_center_ref[islab+erg->slab_buffer], ycn);
+        /*                                *        v x Omega*(yi0-ycn)    */
+        unitv(tmpvec, qin);              /* qin = ---------------------   */
+                                         /*       |v x Omega*(yi0-ycn)|   */
+
+        /* Calculate bin */
+        rvec_sub(xi, xcn, tmpvec);            /* tmpvec = xi-xcn          */
+        bin = iprod(qin, tmpvec);             /* bin  = qin*(xi-xcn)      */
+
+        svmul(wi*gaussian_xi*bin, qin, tmpvec);
+
+        /* Add this contribution to the inner sum: */
+        rvec_add(innersumvec, tmpvec, innersumvec);
+    } /* now we have the inner sum vector S^n for this slab */
+    /* Save it to be used in do_flex_lowlevel */
+    copy_rvec(innersumvec, erg->slab_innersumvec[islab]);
+}
+
+
+static void flex_precalc_inner_sum(t_rotgrp *rotg)
+{
+    gmx_enfrotgrp_t erg = rotg->enfrotgrp;
 
-        /* For slab n, we need to loop over all atoms i again. Since we sorted
-         * the atoms with respect to the rotation vector, we know that it is sufficient
-         * to calculate from firstatom to lastatom only. All other contributions will
-         * be very small. */
-        clear_rvec(innersumvec);
-        for (i = erg->firstatom[islab]; i <= erg->lastatom[islab]; i++)
+    /* Loop over all slabs that contain something, the slabs are independent */
+#pragma omp parallel for num_threads(erg->nth) schedule(static)
+    for (int n = erg->slab_first; n <= erg->slab_last; n++)
+    {
+        try
         {
-            /* Coordinate xi of this atom */
-            copy_rvec(erg->xc[i], xi);
+            flex_precalc_inner_sum_slab(rotg, n);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+}
 
-            /* The i-weights */
-            gaussian_xi = gaussian_weight(xi, rotg, n);
-            mi          = erg->mc_sorted[i]; /* need the sorted mass here */
-            wi          = N_M*mi;
 
-            /* Calculate rin and qin */
-            rvec_sub(erg->xc_ref_sorted[i], ycn, tmpvec); /* tmpvec = yi0-ycn */
-            mvmul(erg->rotmat, tmpvec, rin);              /* rin = Omega.(yi0 - ycn)  */
-            cprod(rotg->vec, rin, tmpvec);                /* tmpvec = v x Omega*(yi0-ycn) */
+/* Clear the per-thread sums of the flexible potentials */
+static void clear_flex_thread_sums(t_rotgrp         *rotg,
+                                   t_gmx_flexthread *th,
+                                   gmx_bool          bOutstepRot,
+                                   gmx_bool          bCalcPotFit)
+{
+    gmx_enfrotgrp_t erg = rotg->enfrotgrp;
+
+    if (bOutstepRot)
+    {
+        for (int l = 0; l < erg->slab_last - erg->slab_first + 1; l++)
+        {
+            th->slab_torque_v[l] = 0.0;
+        }
+    }
+    if (bCalcPotFit)
+    {
+        for (int ifit = 0; ifit < rotg->PotAngle_nstep; ifit++)
+        {
+            th->fit_V[ifit] = 0.0;
+        }
+    }
+}
 
-            /*                                *        v x Omega*(yi0-ycn)    */
-            unitv(tmpvec, qin);              /* qin = ---------------------   */
-                                             /*       |v x Omega*(yi0-ycn)|   */
 
-            /* Calculate bin */
-            rvec_sub(xi, xcn, tmpvec);            /* tmpvec = xi-xcn          */
-            bin = iprod(qin, tmpvec);             /* bin  = qin*(xi-xcn)      */
+/* Add the contributions of all threads in a fixed order
+ * and return the rotation potential */
+static real reduce_flex_thread_sums(t_rotgrp *rotg,
+                                    gmx_bool  bOutstepRot,
+                                    gmx_bool  bCalcPotFit)
+{
+    gmx_enfrotgrp_t erg = rotg->enfrotgrp;
+    real            V   = 0.0;
 
-            svmul(wi*gaussian_xi*bin, qin, tmpvec);
+    for (int t = 0; t < erg->nth; t++)
+    {
+        const t_gmx_flexthread *th = &erg->flex_th[t];
 
-            /* Add this contribution to the inner sum: */
-            rvec_add(innersumvec, tmpvec, innersumvec);
-        } /* now we have the inner sum vector S^n for this slab */
-          /* Save it to be used in do_flex_lowlevel */
-        copy_rvec(innersumvec, erg->slab_innersumvec[islab]);
+        V += th->V;
+        if (bOutstepRot)
+        {
+            for (int l = 0; l < erg->slab_last - erg->slab_first + 1; l++)
+            {
+                erg->slab_torque_v[l] += th->slab_torque_v[l];
+            }
+        }
+        if (bCalcPotFit)
+        {
+            for (int ifit = 0; ifit < rotg->PotAngle_nstep; ifit++)
+            {
+                erg->PotAngleFit->V[ifit] += th->fit_V[ifit];
+            }
+        }
     }
+
+    return V;
 }
 
 
-static real do_flex2_lowlevel(
-        t_rotgrp  *rotg,
-        real       sigma,   /* The Gaussian width sigma */
-        rvec       x[],
-        gmx_bool   bOutstepRot,
-        gmx_bool   bOutstepSlab,
-        matrix     box)
+/* The flexible2 potential and forces for the local atoms jstart to jend,
+ * the potential and torque contributions are accumulated in th */
+static void do_flex2_lowlevel_atoms(
+        t_rotgrp         *rotg,
+        t_gmx_flexthread *th,
+        real              sigma,   /* The Gaussian width sigma */
+        rvec              x[],
+        int               jstart,
+        int               jend,
+        gmx_bool          bOutstepRot,
+        gmx_bool          bCalcPotFit,
+        matrix            box)
 {
     int             count, ic, ii, j, m, n, islab, iigrp, ifit;
     rvec            xj;          /* position in the i-sum                         */
@@ -1889,7 +2009,6 @@ static real do_flex2_lowlevel(
     real            mj, wj;  /* Mass-weighting of the positions               */
     real            N_M;     /* N/M                                           */
     real            Wjn;     /* g_n(x_j) m_j / Mjn                            */
-    gmx_bool        bCalcPotFit;
 
     /* To calculate the torque per slab */
     rvec slab_force;         /* Single force from slab n on one atom          */
@@ -1900,19 +2019,15 @@ static real do_flex2_lowlevel(
 
     erg = rotg->enfrotgrp;
 
-    /* Pre-calculate the inner sums, so that we do not have to calculate
-     * them again for every atom */
-    flex2_precalc_inner_sum(rotg);
-
-    bCalcPotFit = (bOutstepRot || bOutstepSlab) && (erotgFitPOT == rotg->eFittype);
+    clear_flex_thread_sums(rotg, th, bOutstepRot, bCalcPotFit);
 
-    /********************************************************/
-    /* Main loop over all local atoms of the rotation group */
-    /********************************************************/
+    /**************************************************************/
+    /* Main loop over this thread's local atoms of the rot. group */
+    /**************************************************************/
     N_M      = rotg->nat * erg->invmass;
     V        = 0.0;
     OOsigma2 = 1.0 / (sigma*sigma);
-    for (j = 0; j < erg->nat_loc; j++)
+    for (j = jstart; j < jend; j++)
     {
         /* Local index of a rotation group atom  */
         ii = erg->ind_loc[j];
@@ -1933,7 +2048,7 @@ static real do_flex2_lowlevel(
 
         /* Determine the slabs to loop over, i.e. the ones with contributions
          * larger than min_gaussian */
-        count = get_single_atom_gaussians(xj, rotg);
+        count = get_single_atom_gaussians(xj, rotg, th->gn_atom, th->gn_slabind);
 
         clear_rvec(sum1vec_part);
         clear_rvec(sum2vec_part);
@@ -1942,10 +2057,10 @@ static real do_flex2_lowlevel(
         /* Loop over the relevant slabs for this atom */
         for (ic = 0; ic < count; ic++)
         {
-            n = erg->gn_slabind[ic];
+            n = th->gn_slabind[ic];
 
             /* Get the precomputed Gaussian value of curr_slab for curr_x */
-            gaussian_xj = erg->gn_atom[ic];
+            gaussian_xj = th->gn_atom[ic];
 
             islab = n - erg->slab_first; /* slab index */
 
@@ -1997,7 +2112,7 @@ static real do_flex2_lowlevel(
                 {
                     mvmul(erg->PotAngleFit->rotmat[ifit], yj0_ycn, fit_rjn);
                     fit_numerator              = gmx::square(iprod(tmpvec, fit_rjn));
-                    erg->PotAngleFit->V[ifit] += 0.5*rotg->k*wj*gaussian_xj*fit_numerator/OOpsijstar;
+                    th->fit_V[ifit] += 0.5*rotg->k*wj*gaussian_xj*fit_numerator/OOpsijstar;
                 }
             }
 
@@ -2074,7 +2189,7 @@ static real do_flex2_lowlevel(
                     slab_force[m] = rotg->k * (-slab_sum1vec[m] + slab_sum2vec[m] - slab_sum3vec[m] + 0.5*slab_sum4vec[m]);
                 }
 
-                erg->slab_torque_v[islab] += torque(rotg->vec, slab_force, xj, xcn);
+                th->slab_torque_v[islab] += torque(rotg->vec, slab_force, xj, xcn);
             }
         } /* END of loop over slabs */
 
@@ -2102,17 +2217,22 @@ static real do_flex2_lowlevel(
 
     } /* END of loop over local atoms */
 
-    return V;
+    th->V = V;
 }
 
 
-static real do_flex_lowlevel(
-        t_rotgrp *rotg,
-        real      sigma,     /* The Gaussian width sigma                      */
-        rvec      x[],
-        gmx_bool  bOutstepRot,
-        gmx_bool  bOutstepSlab,
-        matrix    box)
+/* The flexible potential and forces for the local atoms jstart to jend,
+ * the potential and torque contributions are accumulated in th */
+static void do_flex_lowlevel_atoms(
+        t_rotgrp         *rotg,
+        t_gmx_flexthread *th,
+        real              sigma,     /* The Gaussian width sigma                      */
+        rvec              x[],
+        int               jstart,
+        int               jend,
+        gmx_bool          bOutstepRot,
+        gmx_bool          bCalcPotFit,
+        matrix            box)
 {
     int             count, ic, ifit, ii, j, m, n, islab, iigrp;
     rvec            xj, yj0;                /* current and reference position                */
@@ -2135,24 +2255,19 @@ static real do_flex_lowlevel(
     real            mj, wj;                 /* Mass-weighting of the positions               */
     real            N_M;                    /* N/M                                           */
     gmx_enfrotgrp_t erg;                    /* Pointer to enforced rotation group data       */
-    gmx_bool        bCalcPotFit;
 
 
     erg = rotg->enfrotgrp;
 
-    /* Pre-calculate the inner sums, so that we do not have to calculate
-     * them again for every atom */
-    flex_precalc_inner_sum(rotg);
-
-    bCalcPotFit = (bOutstepRot || bOutstepSlab) && (erotgFitPOT == rotg->eFittype);
+    clear_flex_thread_sums(rotg, th, bOutstepRot, bCalcPotFit);
 
-    /********************************************************/
-    /* Main loop over all local atoms of the rotation group */
-    /********************************************************/
+    /**************************************************************/
+    /* Main loop over this thread's local atoms of the rot. group */
+    /**************************************************************/
     OOsigma2 = 1.0/(sigma*sigma);
     N_M      = rotg->nat * erg->invmass;
     V        = 0.0;
-    for (j = 0; j < erg->nat_loc; j++)
+    for (j = jstart; j < jend; j++)
     {
         /* Local index of a rotation group atom  */
         ii = erg->ind_loc[j];
@@ -2173,7 +2288,7 @@ static real do_flex_lowlevel(
 
         /* Determine the slabs to loop over, i.e. the ones with contributions
          * larger than min_gaussian */
-        count = get_single_atom_gaussians(xj, rotg);
+        count = get_single_atom_gaussians(xj, rotg, th->gn_atom, th->gn_slabind);
 
         clear_rvec(sum_n1);
         clear_rvec(sum_n2);
@@ -2181,10 +2296,10 @@ static real do_flex_lowlevel(
         /* Loop over the relevant slabs for this atom */
         for (ic = 0; ic < count; ic++)
         {
-            n = erg->gn_slabind[ic];
+            n = th->gn_slabind[ic];
 
             /* Get the precomputed Gaussian for xj in slab n */
-            gaussian_xj = erg->gn_atom[ic];
+            gaussian_xj = th->gn_atom[ic];
 
             islab = n - erg->slab_first; /* slab index */
 
@@ -2245,7 +2360,7 @@ static real do_flex_lowlevel(
                                                                              /*            |v x Omega.(yj0-ycn)|   */
                     fit_bjn = iprod(fit_qjn, xj_xcn);                        /* fit_bjn = fit_qjn * (xj - xcn) */
                     /* Add to the rotation potential for this angle */
-                    erg->PotAngleFit->V[ifit] += 0.5*rotg->k*wj*gaussian_xj*gmx::square(fit_bjn);
+                    th->fit_V[ifit] += 0.5*rotg->k*wj*gaussian_xj*gmx::square(fit_bjn);
                 }
             }
 
@@ -2286,7 +2401,7 @@ static real do_flex_lowlevel(
                 svmul(-rotg->k*wj, tmpvec2, force_n1);     /* part 1 */
                 svmul( rotg->k*mj, innersumvec, force_n2); /* part 2 */
                 rvec_add(force_n1, force_n2, force_n);
-                erg->slab_torque_v[islab] += torque(rotg->vec, force_n, xj, xcn);
+                th->slab_torque_v[islab] += torque(rotg->vec, force_n, xj, xcn);
             }
         } /* END of loop over slabs */
 
@@ -2306,9 +2421,79 @@ static real do_flex_lowlevel(
 
     } /* END of loop over local atoms */
 
-    return V;
+    th->V = V;
+}
+
+static real do_flex2_lowlevel(
+        t_rotgrp  *rotg,
+        real       sigma,   /* The Gaussian width sigma */
+        rvec       x[],
+        gmx_bool   bOutstepRot,
+        gmx_bool   bOutstepSlab,
+        matrix     box)
+{
+    gmx_enfrotgrp_t erg = rotg->enfrotgrp;
+    gmx_bool        bCalcPotFit;
+
+
+    /* Pre-calculate the inner sums, so that we do not have to calculate
+     * them again for every atom */
+    flex2_precalc_inner_sum(rotg);
+
+    bCalcPotFit = (bOutstepRot || bOutstepSlab) && (erotgFitPOT == rotg->eFittype);
+
+    /* Divide the local atoms over the threads */
+#pragma omp parallel for num_threads(erg->nth) schedule(static)
+    for (int t = 0; t < erg->nth; t++)
+    {
+        try
+        {
+            do_flex2_lowlevel_atoms(rotg, &erg->flex_th[t], sigma, x,
+                                    (erg->nat_loc*t)/erg->nth, (erg->nat_loc*(t + 1))/erg->nth,
+                                    bOutstepRot, bCalcPotFit, box);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    return reduce_flex_thread_sums(rotg, bOutstepRot, bCalcPotFit);
+}
+
+
+static real do_flex_lowlevel(
+        t_rotgrp *rotg,
+        real      sigma,     /* The Gaussian width sigma                      */
+        rvec      x[],
+        gmx_bool  bOutstepRot,
+        gmx_bool  bOutstepSlab,
+        matrix    box)
+{
+    gmx_enfrotgrp_t erg = rotg->enfrotgrp;
+    gmx_bool        bCalcPotFit;
+
+
+    /* Pre-calculate the inner sums, so that we do not have to calculate
+     * them again for every atom */
+    flex_precalc_inner_sum(rotg);
+
+    bCalcPotFit = (bOutstepRot || bOutstepSlab) && (erotgFitPOT == rotg->eFittype);
+
+    /* Divide the local atoms over the threads */
+#pragma omp parallel for num_threads(erg->nth) schedule(static)
+    for (int t = 0; t < erg->nth; t++)
+    {
+        try
+        {
+            do_flex_lowlevel_atoms(rotg, &erg->flex_th[t], sigma, x,
+                                   (erg->nat_loc*t)/erg->nth, (erg->nat_loc*(t + 1))/erg->nth,
+                                   bOutstepRot, bCalcPotFit, box);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    return reduce_flex_thread_sums(rotg, bOutstepRot, bCalcPotFit);
 }
 
+
 #ifdef PRINT_COORDS
 static void print_coordinates(t_rotgrp *rotg, rvec x[], matrix box, int step)
 {
@@ -3293,8 +3478,16 @@ static void allocate_slabs(
     snew(erg->slab_weights, nslabs);
     snew(erg->slab_torque_v, nslabs);
     snew(erg->slab_data, nslabs);
-    snew(erg->gn_atom, nslabs);
-    snew(erg->gn_slabind, nslabs);
+    /* Per-thread data for the flexible potentials */
+    erg->nth = gmx_omp_nthreads_get(emntDefault);
+    snew(erg->flex_th, erg->nth);
+    for (i = 0; i < erg->nth; i++)
+    {
+        snew(erg->flex_th[i].gn_atom, nslabs);
+        snew(erg->flex_th[i].gn_slabind, nslabs);
+        snew(erg->flex_th[i].slab_torque_v, nslabs);
+        snew(erg->flex_th[i].fit_V, rotg->PotAngle_nstep);
+    }
     snew(erg->slab_innersumvec, nslabs);
     for (i = 0; i < nslabs; i++)
     {
@@ -3411,6 +3604,7 @@ static void init_rot_group(FILE *fplog, t_commrec *cr, int g, t_rotgrp *rotg,
         snew(erg->xc_shifts, rotg->nat);
         snew(erg->xc_eshifts, rotg->nat);
         snew(erg->xc_old, rotg->nat);
+        erg->xc_gather = init_group_gather(cr, rotg->nat);
 
         if (rotg->eFittype == erotgFitNORM)
         {
@@ -3613,6 +3807,7 @@ extern void dd_make_local_rotation_groups(gmx_domdec_t *dd, t_rot *rot)
 
         dd_make_local_group_indices(ga2la, rotg->nat, rotg->ind,
                                     &erg->nat_loc, &erg->ind_loc, &erg->nalloc_loc, erg->xc_ref_ind);
+        group_gather_local_changed(erg->xc_gather);
     }
 }
 
@@ -3824,6 +4019,14 @@ extern void finish_rot(t_rot *rot)
     {
         gmx_fio_fclose(er->out_torque);
     }
+
+    for (int g = 0; g < rot->ngrp; g++)
+    {
+        gmx_enfrotgrp_t erg = rot->grp[g].enfrotgrp;
+
+        done_group_gather(erg->xc_gather);
+        erg->xc_gather = nullptr;
+    }
 }
 
 
@@ -3881,71 +4084,41 @@ static void choose_pbc_image(rvec x[], t_rotgrp *rotg, matrix box, int npbcdim)
 }
 
 
-extern void do_rotation(
-        t_commrec      *cr,
+extern void do_rotation_local(
+        gmx_cvreduce_t *cvr,
         t_inputrec     *ir,
         matrix          box,
         rvec            x[],
         real            t,
-        gmx_int64_t     step,
-        gmx_wallcycle_t wcycle,
         gmx_bool        bNS)
 {
     int             g, i, ii;
     t_rot          *rot;
     t_rotgrp       *rotg;
-    gmx_bool        outstep_slab, outstep_rot;
-    gmx_bool        bColl;
-    gmx_enfrot_t    er;            /* Pointer to the enforced rotation buffer variables */
     gmx_enfrotgrp_t erg;           /* Pointer to enforced rotation group data           */
-    rvec            transvec;
-    t_gmx_potfit   *fit = nullptr; /* For fit type 'potential' determine the fit
-                                      angle via the potential minimum            */
 
-    /* Enforced rotation cycle counting: */
-    gmx_cycles_t cycles_comp;   /* Cycles for the enf. rotation computation
-                                   only, does not count communication. This
-                                   counter is used for load-balancing         */
-
-#ifdef TAKETIME
-    double t0;
-#endif
 
     rot = ir->rot;
-    er  = rot->enfrot;
-
-    /* When to output in main rotation output file */
-    outstep_rot  = do_per_step(step, rot->nstrout) && er->bOut;
-    /* When to output per-slab data */
-    outstep_slab = do_per_step(step, rot->nstsout) && er->bOut;
-
-    /* Output time into rotation output file */
-    if (outstep_rot && MASTER(cr))
-    {
-        fprintf(er->out_rot, "%12.3e", t);
-    }
 
-    /**************************************************************************/
-    /* First do ALL the communication! */
+    /* Register the local contributions of all groups for one global summation */
     for (g = 0; g < rot->ngrp; g++)
     {
         rotg = &rot->grp[g];
         erg  = rotg->enfrotgrp;
 
-        /* Do we use a collective (global) set of coordinates? */
-        bColl = ISCOLL(rotg);
-
         /* Calculate the rotation matrix for this angle: */
         erg->degangle = rotg->rate * t;
         calc_rotmat(rotg->vec, erg->degangle, erg->rotmat);
 
-        if (bColl)
+        /* Do we use a collective (global) set of coordinates? */
+        if (ISCOLL(rotg))
         {
             /* Transfer the rotation group's positions such that every node has
              * all of them. Every node contributes its local positions x and stores
              * it in the collective erg->xc array. */
-            communicate_group_positions(cr, erg->xc, erg->xc_shifts, erg->xc_eshifts, bNS,
-                                        x, rotg->nat, erg->nat_loc, erg->ind_loc, erg->xc_ref_ind, erg->xc_old, box);
+            communicate_group_positions_start(cvr, erg->xc_gather, erg->xc, x,
+                                              rotg->nat, erg->nat_loc,
+                                              erg->ind_loc, erg->xc_ref_ind);
         }
         else
         {
@@ -3971,11 +4144,76 @@ extern void do_rotation(
             /* Get the center of the rotation group */
             if ( (rotg->eType == erotgISOPF) || (rotg->eType == erotgPMPF) )
             {
-                get_center_comm(cr, erg->x_loc_pbc, erg->m_loc, erg->nat_loc, rotg->nat, erg->xc_center);
+                get_center_comm_start(cvr, erg->x_loc_pbc, erg->m_loc, erg->nat_loc,
+                                      erg->xc_center_buf);
             }
         }
+    }
+}
+
+
+extern void do_rotation(
+        t_commrec      *cr,
+        t_inputrec     *ir,
+        matrix          box,
+        rvec            x[],
+        real            t,
+        gmx_int64_t     step,
+        gmx_wallcycle_t wcycle,
+        gmx_bool        bNS)
+{
+    int             g, i;
+    t_rot          *rot;
+    t_rotgrp       *rotg;
+    gmx_bool        outstep_slab, outstep_rot;
+    gmx_enfrot_t    er;            /* Pointer to the enforced rotation buffer variables */
+    gmx_enfrotgrp_t erg;           /* Pointer to enforced rotation group data           */
+    rvec            transvec;
+    t_gmx_potfit   *fit = nullptr; /* For fit type 'potential' determine the fit
+                                      angle via the potential minimum            */
 
-    } /* End of loop over rotation groups */
+    /* Enforced rotation cycle counting: */
+    gmx_cycles_t cycles_comp;   /* Cycles for the enf. rotation computation
+                                   only, does not count communication. This
+                                   counter is used for load-balancing         */
+
+#ifdef TAKETIME
+    double t0;
+#endif
+
+    rot = ir->rot;
+    er  = rot->enfrot;
+
+    /* When to output in main rotation output file */
+    outstep_rot  = do_per_step(step, rot->nstrout) && er->bOut;
+    /* When to output per-slab data */
+    outstep_slab = do_per_step(step, rot->nstsout) && er->bOut;
+
+    /* Output time into rotation output file */
+    if (outstep_rot && MASTER(cr))
+    {
+        fprintf(er->out_rot, "%12.3e", t);
+    }
+
+    /**************************************************************************/
+    /* The local contributions have been summed over the nodes,
+     * complete the collective positions and centers */
+    for (g = 0; g < rot->ngrp; g++)
+    {
+        rotg = &rot->grp[g];
+        erg  = rotg->enfrotgrp;
+
+        if (ISCOLL(rotg))
+        {
+            communicate_group_positions_finish(erg->xc, erg->xc_shifts, erg->xc_eshifts, bNS,
+                                               rotg->nat, erg->xc_old, box);
+        }
+        else if ( (rotg->eType == erotgISOPF) || (rotg->eType == erotgPMPF) )
+        {
+            get_center_comm_finish(erg->xc_center_buf, erg->m_loc != nullptr, rotg->nat,
+                                   erg->xc_center);
+        }
+    }
 
     /**************************************************************************/
     /* Done communicating, we can start to count cycles for the load balancing now ... */
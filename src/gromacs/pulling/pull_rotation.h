@@ -51,6 +51,7 @@
 #include "gromacs/math/vectypes.h"
 #include "gromacs/timing/wallcycle.h"
 
+struct gmx_cvreduce_t;
 struct gmx_domdec_t;
 struct gmx_mtop_t;
 struct gmx_output_env_t;
@@ -100,11 +101,33 @@ extern void init_rot(FILE *fplog, t_inputrec *ir, int nfile, const t_filenm fnm[
 extern void dd_make_local_rotation_groups(struct gmx_domdec_t *dd, t_rot *rot);
 
 
+/*! \brief Computes the local contributions to the collective rotation data.
+ *
+ * Puts the local positions of the rotation groups into the collective
+ * arrays and computes local sums for the group centers. These are
+ * registered with \p cvr, so that they can be summed over the nodes
+ * in a single call, together with the sums of other modules.
+ * After cvreduce_finish() has been called on \p cvr, do_rotation()
+ * should be called.
+ *
+ * \param cvr     The buffer for the fused global summation.
+ * \param ir      Struct containing MD input parameters.
+ * \param box     Simulation box, needed to choose PBC images.
+ * \param x       The positions of all the local particles.
+ * \param t       Time.
+ * \param bNS     After domain decomposition / neighbor searching several
+ *                local arrays have to be updated (masses, shifts)
+ */
+extern void do_rotation_local(gmx_cvreduce_t *cvr, t_inputrec *ir, matrix box, rvec x[], real t,
+                              gmx_bool bNS);
+
+
 /*! \brief Calculates the enforced rotation potential(s).
  *
  * This is the main enforced rotation module which is called during every time
  * step. Here the rotation potential as well as the resulting forces are
- * calculated.
+ * calculated. The local contributions registered by do_rotation_local()
+ * should have been summed over the nodes before calling this routine.
  *
  * \param cr      Pointer to MPI communication data.
  * \param ir      Struct containing MD input parameters, among those
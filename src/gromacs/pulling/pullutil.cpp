@@ -48,12 +48,14 @@
 #include "gromacs/math/functions.h"
 #include "gromacs/math/utilities.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/cvreduce.h"
 #include "gromacs/mdtypes/commrec.h"
 #include "gromacs/mdtypes/md_enums.h"
 #include "gromacs/mdtypes/mdatom.h"
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/pulling/pull.h"
 #include "gromacs/pulling/pull_internal.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
 #include "gromacs/utility/gmxassert.h"
@@ -193,16 +195,142 @@ static void pull_set_pbcatoms(t_commrec *cr, struct pull_t *pull,
     }
 }
 
+/* The size and stride per coord for the cylinder reduction buffer */
+static const int c_cylBufferStride = 9;
+
+/* Determine the local atoms of the dynamic reference group of cylinder
+ * pull coordinate c and their weights, and store the local sums in dbuf.
+ * Only writes data of coordinate c, so coordinates can be handled
+ * in parallel.
+ */
+static void make_cyl_refgrp(struct pull_t *pull, int c, const t_mdatoms *md,
+                            const t_pbc *pbc, double t, const rvec *x,
+                            double inv_cyl_r2, double *dbuf)
+{
+    pull_coord_work_t       *pcrd;
+    const pull_group_work_t *pref, *pgrp;
+    pull_group_work_t       *pdyna;
+    int                      i, ii, m;
+    rvec                     g_x, dx, dir;
+    double                   sum_a, wmass, wwmass;
+    dvec                     radf_fac0, radf_fac1;
+
+    pcrd   = &pull->coord[c];
+
+    sum_a  = 0;
+    wmass  = 0;
+    wwmass = 0;
+    clear_dvec(radf_fac0);
+    clear_dvec(radf_fac1);
+
+    /* pref will be the same group for all pull coordinates */
+    pref  = &pull->group[pcrd->params.group[0]];
+    pgrp  = &pull->group[pcrd->params.group[1]];
+    pdyna = &pull->dyna[c];
+    copy_dvec_to_rvec(pcrd->vec, dir);
+    pdyna->nat_loc = 0;
+
+    /* We calculate distances with respect to the reference location
+     * of this cylinder group (g_x), which we already have now since
+     * we reduced the other group COM over the ranks. This resolves
+     * any PBC issues and we don't need to use a PBC-atom here.
+     */
+    if (pcrd->params.rate != 0)
+    {
+        /* With rate=0, value_ref is set initially */
+        pcrd->value_ref = pcrd->params.init + pcrd->params.rate*t;
+    }
+    for (m = 0; m < DIM; m++)
+    {
+        g_x[m] = pgrp->x[m] - pcrd->vec[m]*pcrd->value_ref;
+    }
+
+    /* Loop over the local atoms of the main ref group, these are
+     * ordered in the same way as the global atom indices.
+     */
+    for (i = 0; i < pref->nat_loc; i++)
+    {
+        double dr2, dr2_rel, inp;
+        dvec   dr;
+
+        ii = pref->ind_loc[i];
+
+        pbc_dx_aiuc(pbc, x[ii], g_x, dx);
+        inp = iprod(dir, dx);
+        dr2 = 0;
+        for (m = 0; m < DIM; m++)
+        {
+            /* Determine the radial components */
+            dr[m] = dx[m] - inp*dir[m];
+            dr2  += dr[m]*dr[m];
+        }
+        dr2_rel = dr2*inv_cyl_r2;
+
+        if (dr2_rel < 1)
+        {
+            double mass, weight, dweight_r;
+            dvec   mdw;
+
+            /* add to index, to sum of COM, to weight array */
+            if (pdyna->nat_loc >= pdyna->nalloc_loc)
+            {
+                pdyna->nalloc_loc = over_alloc_large(pdyna->nat_loc+1);
+                srenew(pdyna->ind_loc,    pdyna->nalloc_loc);
+                srenew(pdyna->weight_loc, pdyna->nalloc_loc);
+                srenew(pdyna->mdw,        pdyna->nalloc_loc);
+                srenew(pdyna->dv,         pdyna->nalloc_loc);
+            }
+            pdyna->ind_loc[pdyna->nat_loc] = ii;
+
+            mass      = md->massT[ii];
+            /* The radial weight function is 1-2x^2+x^4,
+             * where x=r/cylinder_r. Since this function depends
+             * on the radial component, we also get radial forces
+             * on both groups.
+             */
+            weight    = 1 + (-2 + dr2_rel)*dr2_rel;
+            dweight_r = (-4 + 4*dr2_rel)*inv_cyl_r2;
+            pdyna->weight_loc[pdyna->nat_loc] = weight;
+            sum_a    += mass*weight*inp;
+            wmass    += mass*weight;
+            wwmass   += mass*weight*weight;
+            dsvmul(mass*dweight_r, dr, mdw);
+            copy_dvec(mdw, pdyna->mdw[pdyna->nat_loc]);
+            /* Currently we only have the axial component of the
+             * distance (inp) up to an unkown offset. We add this
+             * offset after the reduction needs to determine the
+             * COM of the cylinder group.
+             */
+            pdyna->dv[pdyna->nat_loc] = inp;
+            for (m = 0; m < DIM; m++)
+            {
+                radf_fac0[m] += mdw[m];
+                radf_fac1[m] += mdw[m]*inp;
+            }
+            pdyna->nat_loc++;
+        }
+    }
+
+    dbuf[0] = wmass;
+    dbuf[1] = wwmass;
+    dbuf[2] = sum_a;
+    dbuf[3] = radf_fac0[XX];
+    dbuf[4] = radf_fac0[YY];
+    dbuf[5] = radf_fac0[ZZ];
+    dbuf[6] = radf_fac1[XX];
+    dbuf[7] = radf_fac1[YY];
+    dbuf[8] = radf_fac1[ZZ];
+}
+
 static void make_cyl_refgrps(t_commrec *cr, struct pull_t *pull, t_mdatoms *md,
                              t_pbc *pbc, double t, rvec *x)
 {
     /* The size and stride per coord for the reduction buffer */
-    const int       stride = 9;
-    int             c, i, ii, m, start, end;
-    rvec            g_x, dx, dir;
+    const int       stride = c_cylBufferStride;
+    int             c, m;
+    rvec            g_x;
     double          inv_cyl_r2;
     pull_comm_t    *comm;
-    gmx_ga2la_t    *ga2la = nullptr;
 
     comm = &pull->comm;
 
@@ -211,139 +339,30 @@ static void make_cyl_refgrps(t_commrec *cr, struct pull_t *pull, t_mdatoms *md,
         snew(comm->dbuf_cyl, pull->ncoord*stride);
     }
 
-    if (cr && DOMAINDECOMP(cr))
-    {
-        ga2la = cr->dd->ga2la;
-    }
-
-    start = 0;
-    end   = md->homenr;
-
     inv_cyl_r2 = 1.0/gmx::square(pull->params.cylinder_r);
 
-    /* loop over all groups to make a reference group for each*/
+    /* Make a reference group for each cylinder coordinate.
+     * The coordinates are independent, so we can run them in parallel.
+     */
+#pragma omp parallel for num_threads(pull->nthreads) schedule(dynamic)
     for (c = 0; c < pull->ncoord; c++)
     {
-        pull_coord_work_t *pcrd;
-        double             sum_a, wmass, wwmass;
-        dvec               radf_fac0, radf_fac1;
-
-        pcrd   = &pull->coord[c];
-
-        sum_a  = 0;
-        wmass  = 0;
-        wwmass = 0;
-        clear_dvec(radf_fac0);
-        clear_dvec(radf_fac1);
-
-        if (pcrd->params.eGeom == epullgCYL)
+        try
         {
-            pull_group_work_t *pref, *pgrp, *pdyna;
-
-            /* pref will be the same group for all pull coordinates */
-            pref  = &pull->group[pcrd->params.group[0]];
-            pgrp  = &pull->group[pcrd->params.group[1]];
-            pdyna = &pull->dyna[c];
-            copy_dvec_to_rvec(pcrd->vec, dir);
-            pdyna->nat_loc = 0;
-
-            /* We calculate distances with respect to the reference location
-             * of this cylinder group (g_x), which we already have now since
-             * we reduced the other group COM over the ranks. This resolves
-             * any PBC issues and we don't need to use a PBC-atom here.
-             */
-            if (pcrd->params.rate != 0)
-            {
-                /* With rate=0, value_ref is set initially */
-                pcrd->value_ref = pcrd->params.init + pcrd->params.rate*t;
-            }
-            for (m = 0; m < DIM; m++)
+            if (pull->coord[c].params.eGeom == epullgCYL)
             {
-                g_x[m] = pgrp->x[m] - pcrd->vec[m]*pcrd->value_ref;
+                make_cyl_refgrp(pull, c, md, pbc, t, x, inv_cyl_r2,
+                                comm->dbuf_cyl + c*stride);
             }
-
-            /* loop over all atoms in the main ref group */
-            for (i = 0; i < pref->params.nat; i++)
+            else
             {
-                ii = pref->params.ind[i];
-                if (ga2la)
+                for (int i = 0; i < stride; i++)
                 {
-                    if (!ga2la_get_home(ga2la, pref->params.ind[i], &ii))
-                    {
-                        ii = -1;
-                    }
-                }
-                if (ii >= start && ii < end)
-                {
-                    double dr2, dr2_rel, inp;
-                    dvec   dr;
-
-                    pbc_dx_aiuc(pbc, x[ii], g_x, dx);
-                    inp = iprod(dir, dx);
-                    dr2 = 0;
-                    for (m = 0; m < DIM; m++)
-                    {
-                        /* Determine the radial components */
-                        dr[m] = dx[m] - inp*dir[m];
-                        dr2  += dr[m]*dr[m];
-                    }
-                    dr2_rel = dr2*inv_cyl_r2;
-
-                    if (dr2_rel < 1)
-                    {
-                        double mass, weight, dweight_r;
-                        dvec   mdw;
-
-                        /* add to index, to sum of COM, to weight array */
-                        if (pdyna->nat_loc >= pdyna->nalloc_loc)
-                        {
-                            pdyna->nalloc_loc = over_alloc_large(pdyna->nat_loc+1);
-                            srenew(pdyna->ind_loc,    pdyna->nalloc_loc);
-                            srenew(pdyna->weight_loc, pdyna->nalloc_loc);
-                            srenew(pdyna->mdw,        pdyna->nalloc_loc);
-                            srenew(pdyna->dv,         pdyna->nalloc_loc);
-                        }
-                        pdyna->ind_loc[pdyna->nat_loc] = ii;
-
-                        mass      = md->massT[ii];
-                        /* The radial weight function is 1-2x^2+x^4,
-                         * where x=r/cylinder_r. Since this function depends
-                         * on the radial component, we also get radial forces
-                         * on both groups.
-                         */
-                        weight    = 1 + (-2 + dr2_rel)*dr2_rel;
-                        dweight_r = (-4 + 4*dr2_rel)*inv_cyl_r2;
-                        pdyna->weight_loc[pdyna->nat_loc] = weight;
-                        sum_a    += mass*weight*inp;
-                        wmass    += mass*weight;
-                        wwmass   += mass*weight*weight;
-                        dsvmul(mass*dweight_r, dr, mdw);
-                        copy_dvec(mdw, pdyna->mdw[pdyna->nat_loc]);
-                        /* Currently we only have the axial component of the
-                         * distance (inp) up to an unkown offset. We add this
-                         * offset after the reduction needs to determine the
-                         * COM of the cylinder group.
-                         */
-                        pdyna->dv[pdyna->nat_loc] = inp;
-                        for (m = 0; m < DIM; m++)
-                        {
-                            radf_fac0[m] += mdw[m];
-                            radf_fac1[m] += mdw[m]*inp;
-                        }
-                        pdyna->nat_loc++;
-                    }
+                    comm->dbuf_cyl[c*stride + i] = 0;
                 }
             }
         }
-        comm->dbuf_cyl[c*stride+0] = wmass;
-        comm->dbuf_cyl[c*stride+1] = wwmass;
-        comm->dbuf_cyl[c*stride+2] = sum_a;
-        comm->dbuf_cyl[c*stride+3] = radf_fac0[XX];
-        comm->dbuf_cyl[c*stride+4] = radf_fac0[YY];
-        comm->dbuf_cyl[c*stride+5] = radf_fac0[ZZ];
-        comm->dbuf_cyl[c*stride+6] = radf_fac1[XX];
-        comm->dbuf_cyl[c*stride+7] = radf_fac1[YY];
-        comm->dbuf_cyl[c*stride+8] = radf_fac1[ZZ];
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
     }
 
     if (cr != nullptr && PAR(cr))
@@ -548,10 +567,74 @@ static void sum_com_part_cosweight(const pull_group_work_t *pgrp,
     sum_com->sum_smp = sum_smp;
 }
 
-/* calculates center of mass of selection index from all coordinates x */
-void pull_calc_coms(t_commrec *cr,
-                    struct pull_t *pull, t_mdatoms *md, t_pbc *pbc, double t,
-                    rvec x[], rvec *xp)
+/* Copy the local sums of a group to a buffer for global summing */
+static void copy_sum_com_to_buffer(const pull_sum_com_t *sum_com, dvec *dbuf)
+{
+    copy_dvec(sum_com->sum_wmx,  dbuf[0]);
+    copy_dvec(sum_com->sum_wmxp, dbuf[1]);
+    dbuf[2][0] = sum_com->sum_wm;
+    dbuf[2][1] = sum_com->sum_wwm;
+    dbuf[2][2] = 0;
+}
+
+/* Computes the local COM sums of a group with few local atoms
+ * on a single thread. x_pbc is only used with a reference atom.
+ */
+static void sum_com_group_single_thread(const pull_group_work_t *pgrp,
+                                        const rvec x_pbc_refat,
+                                        const rvec *x, const rvec *xp,
+                                        const real *mass,
+                                        const t_pbc *pbc,
+                                        pull_sum_com_t *sum_com)
+{
+    rvec x_pbc = { 0, 0, 0 };
+
+    if (pgrp->epgrppbc == epgrppbcREFAT)
+    {
+        /* Set the pbc atom */
+        copy_rvec(x_pbc_refat, x_pbc);
+    }
+
+    clear_dvec(sum_com->sum_wmxp);
+
+    /* If we have a single-atom group the mass is irrelevant, so
+     * we can remove the mass factor to avoid division by zero.
+     * Note that with constraint pulling the mass does matter, but
+     * in that case a check group mass != 0 has been done before.
+     */
+    if (pgrp->params.nat == 1 &&
+        pgrp->nat_loc == 1 &&
+        mass[pgrp->ind_loc[0]] == 0)
+    {
+        GMX_ASSERT(xp == NULL, "We should not have groups with zero mass with constraints, i.e. xp!=NULL");
+
+        /* Copy the single atom coordinate */
+        for (int d = 0; d < DIM; d++)
+        {
+            sum_com->sum_wmx[d] = x[pgrp->ind_loc[0]][d];
+        }
+        /* Set all mass factors to 1 to get the correct COM */
+        sum_com->sum_wm  = 1;
+        sum_com->sum_wwm = 1;
+    }
+    else
+    {
+        sum_com_part(pgrp, 0, pgrp->nat_loc,
+                     x, xp, mass,
+                     pbc, x_pbc,
+                     sum_com);
+    }
+
+    if (pgrp->weight_loc == nullptr)
+    {
+        sum_com->sum_wwm = sum_com->sum_wm;
+    }
+}
+
+/* Computes the local contributions to the COMs in comm->dbuf */
+static void pull_calc_coms_local_sums(t_commrec *cr,
+                                      struct pull_t *pull, t_mdatoms *md, t_pbc *pbc,
+                                      rvec x[], rvec *xp)
 {
     int          g;
     real         twopi_box = 0;
@@ -601,6 +684,31 @@ void pull_calc_coms(t_commrec *cr,
         twopi_box = 2.0*M_PI/pbc->box[pull->cosdim][pull->cosdim];
     }
 
+    /* Groups with few local atoms are summed by a single thread each,
+     * but we sum different groups in parallel.
+     */
+#pragma omp parallel for num_threads(pull->nthreads) schedule(dynamic)
+    for (g = 0; g < pull->ngroup; g++)
+    {
+        try
+        {
+            const pull_group_work_t *pgrp = &pull->group[g];
+
+            if (pgrp->bCalcCOM && pgrp->epgrppbc != epgrppbcCOS &&
+                pgrp->nat_loc <= c_pullMaxNumLocalAtomsSingleThreaded)
+            {
+                pull_sum_com_t sum_com;
+
+                sum_com_group_single_thread(pgrp, comm->rbuf[g],
+                                            x, xp, md->massT, pbc,
+                                            &sum_com);
+
+                copy_sum_com_to_buffer(&sum_com, comm->dbuf + g*3);
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
     for (g = 0; g < pull->ngroup; g++)
     {
         pull_group_work_t *pgrp;
@@ -611,6 +719,12 @@ void pull_calc_coms(t_commrec *cr,
         {
             if (pgrp->epgrppbc != epgrppbcCOS)
             {
+                if (pgrp->nat_loc <= c_pullMaxNumLocalAtomsSingleThreaded)
+                {
+                    /* This group was summed above */
+                    continue;
+                }
+
                 rvec   x_pbc = { 0, 0, 0 };
 
                 if (pgrp->epgrppbc == epgrppbcREFAT)
@@ -622,54 +736,24 @@ void pull_calc_coms(t_commrec *cr,
                 /* The final sums should end up in sum_com[0] */
                 pull_sum_com_t *sum_com = &pull->sum_com[0];
 
-                /* If we have a single-atom group the mass is irrelevant, so
-                 * we can remove the mass factor to avoid division by zero.
-                 * Note that with constraint pulling the mass does matter, but
-                 * in that case a check group mass != 0 has been done before.
-                 */
-                if (pgrp->params.nat == 1 &&
-                    pgrp->nat_loc == 1 &&
-                    md->massT[pgrp->ind_loc[0]] == 0)
-                {
-                    GMX_ASSERT(xp == NULL, "We should not have groups with zero mass with constraints, i.e. xp!=NULL");
-
-                    /* Copy the single atom coordinate */
-                    for (int d = 0; d < DIM; d++)
-                    {
-                        sum_com->sum_wmx[d] = x[pgrp->ind_loc[0]][d];
-                    }
-                    /* Set all mass factors to 1 to get the correct COM */
-                    sum_com->sum_wm  = 1;
-                    sum_com->sum_wwm = 1;
-                }
-                else if (pgrp->nat_loc <= c_pullMaxNumLocalAtomsSingleThreaded)
+#pragma omp parallel for num_threads(pull->nthreads) schedule(static)
+                for (int t = 0; t < pull->nthreads; t++)
                 {
-                    sum_com_part(pgrp, 0, pgrp->nat_loc,
+                    int ind_start = (pgrp->nat_loc*(t + 0))/pull->nthreads;
+                    int ind_end   = (pgrp->nat_loc*(t + 1))/pull->nthreads;
+                    sum_com_part(pgrp, ind_start, ind_end,
                                  x, xp, md->massT,
                                  pbc, x_pbc,
-                                 sum_com);
+                                 &pull->sum_com[t]);
                 }
-                else
-                {
-#pragma omp parallel for num_threads(pull->nthreads) schedule(static)
-                    for (int t = 0; t < pull->nthreads; t++)
-                    {
-                        int ind_start = (pgrp->nat_loc*(t + 0))/pull->nthreads;
-                        int ind_end   = (pgrp->nat_loc*(t + 1))/pull->nthreads;
-                        sum_com_part(pgrp, ind_start, ind_end,
-                                     x, xp, md->massT,
-                                     pbc, x_pbc,
-                                     &pull->sum_com[t]);
-                    }
 
-                    /* Reduce the thread contributions to sum_com[0] */
-                    for (int t = 1; t < pull->nthreads; t++)
-                    {
-                        sum_com->sum_wm  += pull->sum_com[t].sum_wm;
-                        sum_com->sum_wwm += pull->sum_com[t].sum_wwm;
-                        dvec_inc(sum_com->sum_wmx, pull->sum_com[t].sum_wmx);
-                        dvec_inc(sum_com->sum_wmxp, pull->sum_com[t].sum_wmxp);
-                    }
+                /* Reduce the thread contributions to sum_com[0] */
+                for (int t = 1; t < pull->nthreads; t++)
+                {
+                    sum_com->sum_wm  += pull->sum_com[t].sum_wm;
+                    sum_com->sum_wwm += pull->sum_com[t].sum_wwm;
+                    dvec_inc(sum_com->sum_wmx, pull->sum_com[t].sum_wmx);
+                    dvec_inc(sum_com->sum_wmxp, pull->sum_com[t].sum_wmxp);
                 }
 
                 if (pgrp->weight_loc == nullptr)
@@ -677,12 +761,7 @@ void pull_calc_coms(t_commrec *cr,
                     sum_com->sum_wwm = sum_com->sum_wm;
                 }
 
-                /* Copy local sums to a buffer for global summing */
-                copy_dvec(sum_com->sum_wmx,  comm->dbuf[g*3]);
-                copy_dvec(sum_com->sum_wmxp, comm->dbuf[g*3 + 1]);
-                comm->dbuf[g*3 + 2][0] = sum_com->sum_wm;
-                comm->dbuf[g*3 + 2][1] = sum_com->sum_wwm;
-                comm->dbuf[g*3 + 2][2] = 0;
+                copy_sum_com_to_buffer(sum_com, comm->dbuf + g*3);
             }
             else
             {
@@ -727,8 +806,22 @@ void pull_calc_coms(t_commrec *cr,
             }
         }
     }
+}
+
+void pull_calc_coms_finish(t_commrec *cr,
+                           struct pull_t *pull, t_mdatoms *md, t_pbc *pbc, double t,
+                           rvec x[], rvec *xp)
+{
+    int          g;
+    real         twopi_box = 0;
+    pull_comm_t *comm;
+
+    comm = &pull->comm;
 
-    pull_reduce_double(cr, comm, pull->ngroup*3*DIM, comm->dbuf[0]);
+    if (pull->cosdim >= 0)
+    {
+        twopi_box = 2.0*M_PI/pbc->box[pull->cosdim][pull->cosdim];
+    }
 
     for (g = 0; g < pull->ngroup; g++)
     {
@@ -819,3 +912,37 @@ void pull_calc_coms(t_commrec *cr,
         make_cyl_refgrps(cr, pull, md, pbc, t, x);
     }
 }
+
+/* calculates center of mass of selection index from all coordinates x */
+void pull_calc_coms(t_commrec *cr,
+                    struct pull_t *pull, t_mdatoms *md, t_pbc *pbc, double t,
+                    rvec x[], rvec *xp)
+{
+    pull_calc_coms_local_sums(cr, pull, md, pbc, x, xp);
+
+    pull_reduce_double(cr, &pull->comm, pull->ngroup*3*DIM, pull->comm.dbuf[0]);
+
+    pull_calc_coms_finish(cr, pull, md, pbc, t, x, xp);
+}
+
+gmx_bool pull_calc_coms_local(t_commrec *cr,
+                              struct pull_t *pull, t_mdatoms *md, t_pbc *pbc,
+                              rvec x[], gmx_cvreduce_t *cvr)
+{
+    pull_comm_t *comm = &pull->comm;
+
+    /* We can only fuse the summation when all ranks participate */
+    if (!comm->bParticipate ||
+        (cr != nullptr && PAR(cr) && !comm->bParticipateAll))
+    {
+        return FALSE;
+    }
+
+    pull_calc_coms_local_sums(cr, pull, md, pbc, x, nullptr);
+
+    cvreduce_add_double(cvr, pull->ngroup*3*DIM, comm->dbuf[0]);
+
+    comm->bLocalComSums = TRUE;
+
+    return TRUE;
+}
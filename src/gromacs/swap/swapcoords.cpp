@@ -47,6 +47,7 @@
 #include <stdlib.h>
 #include <time.h>
 
+#include <algorithm>
 #include <string>
 
 #include "gromacs/domdec/domdec_struct.h"
@@ -55,6 +56,8 @@
 #include "gromacs/fileio/xvgr.h"
 #include "gromacs/gmxlib/network.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/cvreduce.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
 #include "gromacs/mdlib/groupcoord.h"
 #include "gromacs/mdlib/mdrun.h"
 #include "gromacs/mdlib/sim_util.h"
@@ -112,6 +115,10 @@ typedef struct swap_compartment
     int               *ind;                   /**< Indices to collective array of atoms.         */
     real              *dist;                  /**< Distance of atom to bulk layer, which is
                                                    normally the center layer of the compartment  */
+    int               *heap;                  /**< Binary heap of swap candidates, i.e. indices
+                                                   into ind and dist, closest to bulk layer on top */
+    int                nHeap;                 /**< Number of candidates left in the heap, -1 if
+                                                   the heap has to be built from the lists first */
     int                nalloc;                /**< Allocation size for ind array.                */
     int                inflow_net;            /**< Net inflow of ions into this compartment.     */
 } t_compartment;
@@ -134,6 +141,7 @@ typedef struct swap_group
     ivec             *xc_shifts;              /**< Current (collective) shifts (size nat)                */
     ivec             *xc_eshifts;             /**< Extra shifts since last DD step (size nat)            */
     rvec             *xc_old;                 /**< Old (collective) positions (size nat)                 */
+    gmx_group_gather_t *xc_gather;            /**< For collecting xc by all-gather, can be nullptr       */
     real              q;                      /**< Total charge of one molecule of this group            */
     int              *c_ind_loc;              /**< Position of local atoms in the
                                                    collective array, [0..nat_loc]                        */
@@ -145,6 +153,10 @@ typedef struct swap_group
     unsigned char    *comp_now;               /**< In which compartment this ion is now (size nMol)      */
     unsigned char    *channel_label;          /**< Which channel was passed at last by this ion?
                                                    (size nMol)                                           */
+    unsigned char    *mol_in_comp;            /**< Bit c is set if the first atom of this molecule is in
+                                                   compartment c (size nMol)                             */
+    real             *mol_dist;               /**< Distance of each molecule to the bulk layer of each
+                                                   compartment (size eCompNR*nMol)                       */
     rvec              center;                 /**< Center of the group; COM if masses are used           */
     t_compartment     comp[eCompNR];          /**< Distribution of particles of this group across
                                                     the two compartments                                 */
@@ -167,6 +179,7 @@ typedef struct t_swap
     t_swapgrp        *group;                         /**< Separate groups for channels, solvent, ions     */
     int               fluxleak;                      /**< Flux not going through any of the channels.     */
     real              deltaQ;                        /**< The charge imbalance between the compartments.  */
+    gmx_cvreduce_t   *cvr;                           /**< For fusing the sums of the group positions.     */
 } t_swap;
 
 
@@ -455,6 +468,7 @@ static void add_to_list(
         comp->nalloc = over_alloc_dd(nr+1);
         srenew(comp->ind, comp->nalloc);
         srenew(comp->dist, comp->nalloc);
+        srenew(comp->heap, comp->nalloc);
     }
     comp->ind[nr]  = ci;
     comp->dist[nr] = distance;
@@ -676,32 +690,62 @@ static void sortMoleculesIntoCompartments(
     int              nMolNotInComp[eCompNR]; /* consistency check */
     real             cyl0_r2 = sc->cyl0r * sc->cyl0r;
     real             cyl1_r2 = sc->cyl1r * sc->cyl1r;
+    int              nMol    = g->nat/g->apm;
+    int              sd      = s->swapdim;
+    real             left[eCompNR], right[eCompNR];
 
     /* Get us a counter that cycles in the range of [0 ... sc->nAverage[ */
     int replace = (step/sc->nstswap) % sc->nAverage;
 
+    if (g->mol_in_comp == nullptr)
+    {
+        snew(g->mol_in_comp, nMol);
+        snew(g->mol_dist, eCompNR*nMol);
+    }
+
     for (int comp = eCompA; comp <= eCompB; comp++)
     {
-        real left, right;
+        get_compartment_boundaries(comp, sc->si_priv, box, &left[comp], &right[comp]);
+    }
 
-        /* Get lists of atoms that match criteria for this compartment */
-        get_compartment_boundaries(comp, sc->si_priv, box, &left, &right);
+    /* Determine for all molecules in which compartment they are. This is
+     * independent for each molecule and is the only part that scales with
+     * the number of (solvent) molecules, so we do it in parallel. The
+     * bookkeeping below then only needs to look up the results. */
+    int nth = gmx_omp_nthreads_get(emntDefault);
+#pragma omp parallel for num_threads(nth) schedule(static)
+    for (int iMol = 0; iMol < nMol; iMol++)
+    {
+        // Trivial OpenMP region that cannot throw
+        real          posFirstAtom = g->xc[iMol*g->apm][sd];
+        unsigned char inComp       = 0;
+
+        for (int comp = eCompA; comp <= eCompB; comp++)
+        {
+            if (compartment_contains_atom(left[comp], right[comp], posFirstAtom, box[sd][sd],
+                                          sc->bulkOffset[comp], &g->mol_dist[comp*nMol + iMol]))
+            {
+                inComp |= (1 << comp);
+            }
+        }
+        g->mol_in_comp[iMol] = inComp;
+    }
 
+    for (int comp = eCompA; comp <= eCompB; comp++)
+    {
         /* First clear the ion molecule lists */
         g->comp[comp].nMol  = 0;
+        g->comp[comp].nHeap = -1;
         nMolNotInComp[comp] = 0; /* consistency check */
 
         /* Loop over the molecules and atoms of this group */
         for (int iMol = 0, iAtom = 0; iAtom < g->nat; iAtom += g->apm, iMol++)
         {
-            real dist;
-            int  sd = s->swapdim;
-
             /* Is this first atom of the molecule in the compartment that we look at? */
-            if (compartment_contains_atom(left, right, g->xc[iAtom][sd], box[sd][sd], sc->bulkOffset[comp], &dist) )
+            if (g->mol_in_comp[iMol] & (1 << comp))
             {
                 /* Add the first atom of this molecule to the list of molecules in this compartment */
-                add_to_list(iAtom, &g->comp[comp], dist);
+                add_to_list(iAtom, &g->comp[comp], g->mol_dist[comp*nMol + iMol]);
 
                 /* Master also checks for ion groups through which channel each ion has passed */
                 if (MASTER(cr) && (g->comp_now != nullptr) && !bIsSolvent)
@@ -1483,6 +1527,8 @@ void init_swapcoords(
     snew(sc->si_priv, 1);
     s = sc->si_priv;
 
+    s->cvr = init_cvreduce();
+
     if (bRerun)
     {
         if (PAR(cr))
@@ -1544,6 +1590,7 @@ void init_swapcoords(
         g = &s->group[i];
         snew(g->xc, g->nat);
         snew(g->c_ind_loc, g->nat);
+        g->xc_gather = init_group_gather(cr, g->nat);
 
         /* For the split groups (the channels) we need some extra memory to
          * be able to make the molecules whole even if they span more than
@@ -1745,6 +1792,8 @@ void init_swapcoords(
         for (int ic = 0; ic < eCompNR; ic++)
         {
             snew(g->comp[ic].nMolPast, sc->nAverage);
+            /* The candidate heap has to be built before its first use */
+            g->comp[ic].nHeap = -1;
         }
     }
 
@@ -1835,6 +1884,14 @@ void finish_swapcoords(t_swapcoords *sc)
         // Close the swap output file
         gmx_fio_fclose(sc->si_priv->fpout);
     }
+
+    for (int ig = 0; ig < sc->si_priv->ngrp; ig++)
+    {
+        t_swapgrp *g = &sc->si_priv->group[ig];
+
+        done_group_gather(g->xc_gather);
+        g->xc_gather = nullptr;
+    }
 }
 
 
@@ -1851,6 +1908,7 @@ void dd_make_local_swap_groups(gmx_domdec_t *dd, t_swapcoords *sc)
         g = &(sc->si_priv->group[ig]);
         dd_make_local_group_indices(dd->ga2la, g->nat, g->ind,
                                     &(g->nat_loc), &(g->ind_loc), &(g->nalloc_loc), g->c_ind_loc);
+        group_gather_local_changed(g->xc_gather);
     }
 }
 
@@ -1890,6 +1948,12 @@ static gmx_bool need_swap(t_swapcoords *sc)
  * that is near to the bulk layer to/from which the swaps take place.
  * Other atoms of the molecule (if any) will directly follow the returned index.
  *
+ * The candidates are kept in a binary heap that is built at the first call
+ * after the molecules were sorted into the compartments, such that each swap
+ * costs log(nMol) instead of a search through all molecules. Ties in the
+ * distance are broken by list position, which selects the same molecules
+ * in the same order as a linear search for the smallest distance would.
+ *
  * \param[in] comp    Structure containing compartment-specific data.
  * \param[in] molname Name of the molecule.
  *
@@ -1899,35 +1963,39 @@ static int get_index_of_distant_atom(
         t_compartment *comp,
         const char     molname[])
 {
-    int  ibest = -1;
-    real d     = GMX_REAL_MAX;
-
+    const real *dist            = comp->dist;
+    auto        fartherFromBulk = [dist](int a, int b)
+    {
+        return dist[a] > dist[b] || (dist[a] == dist[b] && a > b);
+    };
 
-    /* comp->nat contains the original number of atoms in this compartment
-     * prior to doing any swaps. Some of these atoms may already have been
-     * swapped out, but then they are marked with a distance of GMX_REAL_MAX
+    /* comp->nMolBefore contains the original number of molecules in this
+     * compartment prior to doing any swaps. Molecules that have already been
+     * swapped out in this step have been removed from the heap.
      */
-    for (int iMol  = 0; iMol < comp->nMolBefore; iMol++)
+    if (comp->nHeap < 0)
     {
-        if (comp->dist[iMol] < d)
+        for (int iMol = 0; iMol < comp->nMolBefore; iMol++)
         {
-            ibest = iMol;
-            d     = comp->dist[ibest];
+            comp->heap[iMol] = iMol;
         }
+        comp->nHeap = comp->nMolBefore;
+        std::make_heap(comp->heap, comp->heap + comp->nHeap, fartherFromBulk);
     }
 
-    if (ibest < 0)
+    if (comp->nHeap == 0)
     {
         gmx_fatal(FARGS, "Could not get index of %s atom. Compartment contains %d %s molecules before swaps.",
                   molname, comp->nMolBefore, molname);
     }
 
-    /* Set the distance of this index to infinity such that it won't get selected again in
-     * this time step
+    /* Remove the closest molecule from the heap such that it won't get
+     * selected again in this time step
      */
-    comp->dist[ibest] = GMX_REAL_MAX;
+    std::pop_heap(comp->heap, comp->heap + comp->nHeap, fartherFromBulk);
+    comp->nHeap--;
 
-    return comp->ind[ibest];
+    return comp->ind[comp->heap[comp->nHeap]];
 }
 
 
@@ -2011,27 +2079,40 @@ gmx_bool do_swapcoords(
     s   = sc->si_priv;
 
 
-    /* Assemble the positions of the split groups, i.e. the channels.
-     * Here we also pass a shifts array to communicate_group_positions(), so that it can make
+    /* Assemble the positions of the split groups, i.e. the channels,
+     * and of the ions (ig = 3, 4, ...). The local positions of all these
+     * groups are summed over the nodes with a single collective call. */
+    for (ig = eGrpSplit0; ig < s->ngrp; ig++)
+    {
+        if (ig == eGrpSolvent)
+        {
+            continue;
+        }
+        g = &(s->group[ig]);
+        communicate_group_positions_start(s->cvr, g->xc_gather, g->xc, x,
+                                          g->nat, g->nat_loc,
+                                          g->ind_loc, g->c_ind_loc);
+    }
+    cvreduce_sum(s->cvr, cr);
+
+    /* For the split groups we also pass a shifts array to
+     * communicate_group_positions_finish(), so that it can make
      * the molecules whole even in cases where they span more than half of the box in
      * any dimension */
     for (ig = eGrpSplit0; ig <= eGrpSplit1; ig++)
     {
         g = &(s->group[ig]);
-        communicate_group_positions(cr, g->xc, g->xc_shifts, g->xc_eshifts, TRUE,
-                                    x, g->nat, g->nat_loc, g->ind_loc, g->c_ind_loc, g->xc_old, box);
+        communicate_group_positions_finish(g->xc, g->xc_shifts, g->xc_eshifts, TRUE,
+                                           g->nat, g->xc_old, box);
 
         get_center(g->xc, g->m, g->nat, g->center); /* center of split groups == channels */
     }
 
-    /* Assemble the positions of the ions (ig = 3, 4, ...). These molecules should
-     * be small and we can always make them whole with a simple distance check.
-     * Therefore we pass NULL as third argument. */
+    /* The ion molecules should be small and we can always make them whole
+     * with a simple distance check, so no shifts are needed. */
     for (ig = eSwapFixedGrpNR; ig < s->ngrp; ig++)
     {
         g = &(s->group[ig]);
-        communicate_group_positions(cr, g->xc, nullptr, nullptr, FALSE,
-                                    x, g->nat, g->nat_loc, g->ind_loc, g->c_ind_loc, nullptr, nullptr);
 
         /* Determine how many ions of this type each compartment contains */
         sortMoleculesIntoCompartments(g, cr, sc, box, step, s->fpout, bRerun, FALSE);
@@ -2057,8 +2138,10 @@ gmx_bool do_swapcoords(
         /* Since we here know that we have to perform ion/water position exchanges,
          * we now assemble the solvent positions */
         g = &(s->group[eGrpSolvent]);
-        communicate_group_positions(cr, g->xc, nullptr, nullptr, FALSE,
-                                    x, g->nat, g->nat_loc, g->ind_loc, g->c_ind_loc, nullptr, nullptr);
+        communicate_group_positions_start(s->cvr, g->xc_gather, g->xc, x,
+                                          g->nat, g->nat_loc,
+                                          g->ind_loc, g->c_ind_loc);
+        cvreduce_sum(s->cvr, cr);
 
         /* Determine how many molecules of solvent each compartment contains */
         sortMoleculesIntoCompartments(g, cr, sc, box, step, s->fpout, bRerun, TRUE);
@@ -487,4 +487,64 @@ CubicSplineTable::CubicSplineTable(std::initializer_list<NumericalSplineTableInp
     }
 }
 
+
+CubicSplineTable::CubicSplineTable(std::initializer_list<NumericalSplineTableInput>   numericalInputList,
+                                   const std::pair<real, real>                       &range,
+                                   UseInputSpacing                                    )
+    : numFuncInTable_(numericalInputList.size()), range_(range)
+{
+    // Sanity check on input values
+    if (range.first < 0.0 || (range.second-range.first) < 0.001)
+    {
+        GMX_THROW(InvalidInputError("Range to tabulate cannot include negative values and must span at least 0.001"));
+    }
+
+    double spacing = numericalInputList.begin()->spacing;
+
+    tableScale_    = 1.0 / spacing;
+
+    std::size_t funcIndex = 0;
+
+    for (auto thisFuncInput : numericalInputList)
+    {
+        try
+        {
+            if (thisFuncInput.spacing != spacing)
+            {
+                GMX_THROW(InconsistentInputError("All table input vectors should have the same spacing"));
+            }
+
+            // The re-interpolation accesses two points beyond the upper endpoint
+            if (thisFuncInput.function.size() < range_.second / spacing + 3)
+            {
+                GMX_THROW(InconsistentInputError("Table input vectors must cover requested range, and a margin beyond the upper endpoint"));
+            }
+
+            if (thisFuncInput.function.size() != thisFuncInput.derivative.size())
+            {
+                GMX_THROW(InconsistentInputError("Function and derivative vectors have different lengths"));
+            }
+
+            std::vector<real> tmpYfghTableData;
+
+            fillSingleCubicSplineTableData(thisFuncInput.function,
+                                           thisFuncInput.derivative,
+                                           spacing,
+                                           range,
+                                           spacing,
+                                           &tmpYfghTableData);
+
+            internal::fillMultiplexedTableData(tmpYfghTableData, &yfghMultiTableData_,
+                                               4, numFuncInTable_, funcIndex);
+
+            funcIndex++;
+        }
+        catch (gmx::GromacsException &ex)
+        {
+            ex.prependContext("Error generating cubic spline table for function '" + thisFuncInput.desc + "'");
+            throw;
+        }
+    }
+}
+
 } // namespace gmx
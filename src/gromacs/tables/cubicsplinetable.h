@@ -259,6 +259,32 @@ class CubicSplineTable
                          const std::pair<real, real>                      &range,
                          real                                              tolerance = defaultTolerance);
 
+        //! Tag type to select the constructor that keeps the input spacing
+        struct UseInputSpacing {};
+
+        /*! \brief Initialize table data from tabulated values and derivatives, keeping the input spacing
+         *
+         * \param numericalInputList  Initializer list with one or more functions to tabulate,
+         *                            as for the constructor with a tolerance. All functions
+         *                            must use the same input spacing, which will be the
+         *                            spacing of the table.
+         * \param range               Range over which the function will be tabulated.
+         *                            Constructor will throw gmx::APIError for negative values,
+         *                            or if the value/derivative vector does not cover the
+         *                            range plus a margin of two points.
+         * \param useInputSpacing     Tag to select this constructor.
+         *
+         * This is intended for user-supplied data, where the accuracy is limited
+         * by the input anyhow. Since no tolerance is used, the functions can
+         * be zero over the whole range or have zero derivatives, which is not
+         * allowed with the other constructors. Consistency of the derivative
+         * with the function is not checked; that is the responsibility of
+         * the caller.
+         */
+        CubicSplineTable(std::initializer_list<NumericalSplineTableInput>  numericalInputList,
+                         const std::pair<real, real>                      &range,
+                         UseInputSpacing                                   useInputSpacing);
+
 
         /************************************************************
          *           Evaluation methods for single functions        *
@@ -41,6 +41,7 @@
 #include <cmath>
 
 #include <algorithm>
+#include <vector>
 
 #include "gromacs/fileio/xvgr.h"
 #include "gromacs/math/functions.h"
@@ -50,6 +51,7 @@
 #include "gromacs/mdtypes/fcdata.h"
 #include "gromacs/mdtypes/md_enums.h"
 #include "gromacs/mdtypes/nblist.h"
+#include "gromacs/tables/cubicsplinetable.h"
 #include "gromacs/utility/cstringutil.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
@@ -1474,6 +1476,65 @@ t_forcetable *make_tables(FILE *out,
     return table;
 }
 
+gmx::CubicSplineTable *makeUserSplineTable(FILE *fp, const char *fn,
+                                           real rc, real rtab)
+{
+    t_tabledata         td[etiNR];
+    /* The same scaling of the LJ functions as in make_tables */
+    const double        scalefactor[etiNR] = { 1.0, 1.0/6.0, 1.0/12.0 };
+    std::vector<double> function[etiNR];
+    std::vector<double> derivative[etiNR];
+
+    read_tables(fp, fn, etiNR, 0, td);
+
+    if (td[0].x[td[0].nx-1] < rtab)
+    {
+        gmx_fatal(FARGS, "Tables in file %s not long enough for cut-off:\n"
+                  "\tshould be at least %f nm\n", fn, rtab);
+    }
+
+    /* Below the first non-zero entry of a function the user table is
+     * usually zero. We let the table range start at the largest of these
+     * indices over the functions, below it the table is extrapolated.
+     */
+    int firstNonZero = 0;
+    for (int k = 0; k < etiNR; k++)
+    {
+        int i0 = -1;
+        function[k].resize(td[k].nx);
+        derivative[k].resize(td[k].nx);
+        for (int i = 0; i < td[k].nx; i++)
+        {
+            /* The table stores the force, we need the derivative */
+            function[k][i]   =  scalefactor[k]*td[k].v[i];
+            derivative[k][i] = -scalefactor[k]*td[k].f[i];
+            if (i0 < 0 && (td[k].v[i] != 0 || td[k].f[i] != 0))
+            {
+                i0 = i;
+            }
+        }
+        firstNonZero = std::max(firstNonZero, i0);
+    }
+    double spacing = 1/td[0].tabscale;
+
+    for (int k = 0; k < etiNR; k++)
+    {
+        done_tabledata(&td[k]);
+    }
+
+    std::pair<real, real>  range(firstNonZero*spacing, rc);
+    if (fp)
+    {
+        fprintf(fp, "Using user tables for the range %g to %g nm\n",
+                range.first, range.second);
+    }
+
+    return new gmx::CubicSplineTable({{"User Coulomb", function[etiCOUL], derivative[etiCOUL], spacing},
+                                      {"User dispersion", function[etiLJ6], derivative[etiLJ6], spacing},
+                                      {"User repulsion", function[etiLJ12], derivative[etiLJ12], spacing}},
+                                     range, gmx::CubicSplineTable::UseInputSpacing());
+}
+
 t_forcetable *make_gb_table(const t_forcerec              *fr)
 {
     t_tabledata    *td;
@@ -51,6 +51,11 @@
 #include "gromacs/mdtypes/interaction_const.h"
 #include "gromacs/utility/real.h"
 
+namespace gmx
+{
+class CubicSplineTable;
+}
+
 /*! \brief Flag to select user tables for make_tables */
 #define GMX_MAKETABLES_FORCEUSER  (1<<0)
 /*! \brief Flag to only make 1,4 pair tables for make_tables */
@@ -134,6 +139,25 @@ t_forcetable *make_tables(FILE *fp,
                           const t_forcerec *fr,
                           const char *fn, real rtab, int flags);
 
+/*! \brief Return a cubic spline table with user Coulomb and LJ functions
+ *
+ * Reads the user table file \p fn, which has the same format as for
+ * make_tables, and returns a table with the three functions Coulomb,
+ * dispersion and repulsion, in that order. As with make_tables, the
+ * dispersion and repulsion functions are divided by 6 and 12,
+ * respectively, so they can be multiplied directly by 6*C6 and 12*C12.
+ * The table keeps the spacing of the input.
+ *
+ * \param fp     Log file pointer
+ * \param fn     File name from which to read user tables
+ * \param rc     Cut-off distance, the table is valid up to rc
+ * \param rtab   Distance up to which the file should contain data
+ *
+ * \return Pointer to a new table, the caller takes ownership
+ */
+gmx::CubicSplineTable *makeUserSplineTable(FILE *fp, const char *fn,
+                                           real rc, real rtab);
+
 /*! \brief Return a table for bonded interactions,
  *
  * \param  fplog   Pointer to log file
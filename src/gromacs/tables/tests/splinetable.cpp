@@ -46,6 +46,7 @@
 #include <algorithm>
 #include <functional>
 #include <utility>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -498,6 +499,54 @@ TYPED_TEST(SplineTableTest, NumericalInputPmeCorr)
     TestFixture::testSplineTableAgainstFunctions("NumericalPMECorr", pmeCorrFunction, pmeCorrDerivative, pmeCorrTable, range);
 }
 
+
+TEST(CubicSplineTableTest, KeepsInputSpacing)
+{
+    std::pair<real, real>  range(0.1, 1.0);
+    std::vector<double>    lj6Values, lj6Derivatives;
+    std::vector<double>    zeroValues, zeroDerivatives;
+
+    // Typical user table spacing, too coarse for the default tolerance
+    double                 inputSpacing = 2e-3;
+
+    for (std::size_t i = 0; i < range.second/inputSpacing + 3; i++)
+    {
+        double x    = i * inputSpacing;
+
+        // Zero below the range, as is common in user tables
+        lj6Values.push_back((x > 0.5*range.first) ? lj6Function(x) : 0.0);
+        lj6Derivatives.push_back((x > 0.5*range.first) ? lj6Derivative(x) : 0.0);
+        zeroValues.push_back(0.0);
+        zeroDerivatives.push_back(0.0);
+    }
+
+    CubicSplineTable table( {{"NumericalLJ6", lj6Values, lj6Derivatives, inputSpacing},
+                             {"Zero", zeroValues, zeroDerivatives, inputSpacing}},
+                            range, CubicSplineTable::UseInputSpacing());
+
+    for (std::size_t i = range.first/inputSpacing; i < range.second/inputSpacing; i++)
+    {
+        // Check the input points and the midpoints between them
+        for (real x : { real(i*inputSpacing), real((i + 0.5)*inputSpacing) })
+        {
+            real func0, der0, func1, der1;
+
+            table.evaluateFunctionAndDerivative(x, &func0, &der0, &func1, &der1);
+
+            EXPECT_REAL_EQ_TOL(lj6Function(x), func0, relativeToleranceAsFloatingPoint(lj6Function(x), 1e-4));
+            EXPECT_REAL_EQ_TOL(lj6Derivative(x), der0, relativeToleranceAsFloatingPoint(lj6Derivative(x), 1e-3));
+            EXPECT_EQ(0, func1);
+            EXPECT_EQ(0, der1);
+        }
+    }
+
+    // Too short input vectors
+    lj6Values.resize(range.second/inputSpacing + 1);
+    lj6Derivatives.resize(range.second/inputSpacing + 1);
+    EXPECT_THROW_GMX(CubicSplineTable( {{"ShortLJ6", lj6Values, lj6Derivatives, inputSpacing}},
+                                       range, CubicSplineTable::UseInputSpacing()), gmx::InconsistentInputError);
+}
+
 TYPED_TEST(SplineTableTest, TwoFunctions)
 {
     std::pair<real, real>  range(0.2, 2.0);
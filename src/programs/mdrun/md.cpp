@@ -88,6 +88,7 @@
 #include "gromacs/mdlib/trajectory_writing.h"
 #include "gromacs/mdlib/update.h"
 #include "gromacs/mdlib/vcm.h"
+#include "gromacs/mdlib/verletbuf_tuning.h"
 #include "gromacs/mdlib/vsite.h"
 #include "gromacs/mdtypes/commrec.h"
 #include "gromacs/mdtypes/df_history.h"
@@ -238,6 +239,7 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
     double          elapsed_time;
     double          t, t0, lam0[efptNR];
     gmx_bool        bGStatEveryStep, bGStat, bCalcVir, bCalcEnerStep, bCalcEner;
+    gmx_bool        bSumEner, bDeferGrpp;
     gmx_bool        bNS, bNStList, bSimAnn, bStopCM, bRerunMD,
                     bFirstStep, startingFromCheckpoint, bInitStep, bLastStep = FALSE,
                     bBornRadii, bUsingEnsembleRestraints;
@@ -288,6 +290,7 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
     pme_load_balancing_t *pme_loadbal      = nullptr;
     gmx_bool              bPMETune         = FALSE;
     gmx_bool              bPMETunePrinting = FALSE;
+    verletbuf_tuning_t   *verletbufTuning  = nullptr;
 
     /* Interactive MD */
     gmx_bool          bIMDstep = FALSE;
@@ -512,6 +515,11 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                          &bPMETunePrinting);
     }
 
+    if (!bRerunMD)
+    {
+        init_verletbuf_tuning(&verletbufTuning, fplog, cr, ir, fr, bPMETune);
+    }
+
     if (!ir->bContinuation && !bRerunMD)
     {
         if (state->flags & (1 << estV))
@@ -812,6 +820,13 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                            &bPMETunePrinting);
         }
 
+        if (verletbufTuning != nullptr && bNStList)
+        {
+            /* Adapt the pair-list buffer to the measured displacements */
+            verletbuf_tuning_do(verletbufTuning, fplog, cr, ir, top_global,
+                                fr, state, mdatoms, step);
+        }
+
         wallcycle_start(wcycle, ewcSTEP);
 
         if (bRerunMD)
@@ -1062,6 +1077,21 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
             bCalcEner = TRUE;
         }
 
+        /* Only sum the energies when they have been computed; free-energy
+         * runs use dH/dl and cosine acceleration uses vcos at every step.
+         */
+        bSumEner = (bCalcEner || bRerunMD || ir->efep != efepNO ||
+                    ekind->cosacc.cos_accel != 0);
+
+        /* Without output, the energy group pair energies are only used
+         * for the averages, so they are only added to local running sums,
+         * which are added to the averages at the next energy step with
+         * output. With multiple ranks the fluctuations require the totals
+         * of each step, so then they are summed at every energy step.
+         */
+        bDeferGrpp = (!EI_VV(ir->eI) && !PAR(cr) && enerd->grpp.nener > 1 &&
+                      bCalcEnerStep && !do_ene && !do_log && !bDoReplEx && !bCPT);
+
         /* Do we need global communication ? */
         bGStat = (bCalcVir || bCalcEner || bStopCM ||
                   do_per_step(step, nstglobalcomm) ||
@@ -1101,6 +1131,13 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                      (bNS ? GMX_FORCE_NS : 0) | force_flags);
         }
 
+        if (verletbufTuning != nullptr && bNS)
+        {
+            verletbuf_tuning_store_x(verletbufTuning, step, mdatoms,
+                                     as_rvec_array(state->x.data()),
+                                     as_rvec_array(state->v.data()));
+        }
+
         if (EI_VV(ir->eI) && !startingFromCheckpoint && !bRerunMD)
         /*  ############### START FIRST UPDATE HALF-STEP FOR VV METHODS############### */
         {
@@ -1273,6 +1310,11 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
          * coordinates at time t. We must output all of this before
          * the update.
          */
+        if (bCPT && MASTER(cr))
+        {
+            /* The energy history needs the deferred group pair energies */
+            upd_mdebin_grpp_sum(mdebin, enerd);
+        }
         do_md_trajectory_writing(fplog, cr, nfile, fnm, step, step_rel, t,
                                  ir, state, state_global, observablesHistory,
                                  top_global, fr,
@@ -1548,7 +1590,8 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                                 lastbox,
                                 &totalNumberOfBondedInteractions, &bSumEkinhOld,
                                 (bGStat ? CGLO_GSTAT : 0)
-                                | (!EI_VV(ir->eI) || bRerunMD ? CGLO_ENERGY : 0)
+                                | ((!EI_VV(ir->eI) || bRerunMD) && bSumEner ? CGLO_ENERGY : 0)
+                                | (bDeferGrpp ? CGLO_DEFERGRPP : 0)
                                 | (!EI_VV(ir->eI) && bStopCM ? CGLO_STOPCM : 0)
                                 | (!EI_VV(ir->eI) ? CGLO_TEMPERATURE : 0)
                                 | (!EI_VV(ir->eI) || bRerunMD ? CGLO_PRESSURE : 0)
@@ -1628,6 +1671,11 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
             }
             if (bCalcEner)
             {
+                if (!bDeferGrpp)
+                {
+                    /* Add the sums of earlier deferred steps */
+                    upd_mdebin_grpp_sum(mdebin, enerd);
+                }
                 upd_mdebin(mdebin, bDoDHDL, bCalcEnerStep,
                            t, mdatoms->tmass, enerd, state,
                            ir->fepvals, ir->expandedvals, lastbox,
@@ -1845,6 +1893,11 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
         pme_loadbal_done(pme_loadbal, fplog, mdlog, use_GPU(fr->nbv));
     }
 
+    if (verletbufTuning != nullptr)
+    {
+        done_verletbuf_tuning(verletbufTuning, fplog);
+    }
+
     done_shellfc(fplog, shellfc, step_rel);
 
     if (repl_ex_nst > 0 && MASTER(cr))
@@ -84,6 +84,7 @@
 #include "gromacs/mdlib/mdatoms.h"
 #include "gromacs/mdlib/mdrun.h"
 #include "gromacs/mdlib/minimize.h"
+#include "gromacs/mdlib/nb_verlet.h"
 #include "gromacs/mdlib/nbnxn_search.h"
 #include "gromacs/mdlib/qmmm.h"
 #include "gromacs/mdlib/sighandler.h"
@@ -312,6 +313,12 @@ static const int    nbnxnReferenceNstlist = 10;
 const int           nstlist_try[] = { 20, 25, 40 };
 //! Number of elements in the neighborsearch list trials.
 #define NNSTL  sizeof(nstlist_try)/sizeof(nstlist_try[0])
+//! The values to try when switching with dynamic pruning
+const int           nstlist_try_dynamic_pruning[] = { 20, 25, 40, 50, 80, 100 };
+//! Number of elements in the neighborsearch list trials with dynamic pruning.
+#define NNSTL_DYNAMIC_PRUNING  sizeof(nstlist_try_dynamic_pruning)/sizeof(nstlist_try_dynamic_pruning[0])
+//! The default interval in steps for dynamic pruning of the pair list
+static const int    nbnxnDynamicPruningIntervalDefault = 4;
 /* Increase nstlist until the non-bonded cost increases more than listfac_ok,
  * but never more than listfac_max.
  * A standard (protein+)water system at 300K with PME ewald_rtol=1e-5
@@ -331,18 +338,61 @@ static const float  nbnxn_cpu_listfac_max   = 1.09;
 static const float  nbnxn_knl_listfac_ok    = 1.22;
 //! Too high performance ratio beween force calc and neighbor searching
 static const float  nbnxn_knl_listfac_max   = 1.3;
+/* CPU with dynamic pruning: the kernels use the pruned inner list,
+ * the outer list only affects the (infrequent) search and the pruning.
+ */
+//! Max OK size ratio of the outer list with dynamic pruning
+static const float  nbnxn_cpu_dynamic_pruning_listfac_ok  = 2.0;
+//! Too high size ratio of the outer list with dynamic pruning
+static const float  nbnxn_cpu_dynamic_pruning_listfac_max = 2.4;
 /* GPU: pair-search is a factor 1.5-3 slower than the non-bonded kernel */
 //! Max OK performance ratio beween force calc and neighbor searching
 static const float  nbnxn_gpu_listfac_ok    = 1.20;
 //! Too high performance ratio beween force calc and neighbor searching
 static const float  nbnxn_gpu_listfac_max   = 1.30;
 
-/*! \brief Try to increase nstlist when using the Verlet cut-off scheme */
+/*! \brief Returns the pair-list pruning interval set by the user
+ *
+ * Dynamic pruning is requested by setting GMX_NSTLIST_DYNAMICPRUNING,
+ * optionally to the pruning interval in steps.
+ * Returns 0 when dynamic pruning is not requested.
+ */
+static int get_nstlist_prune_env()
+{
+    const char *env = getenv("GMX_NSTLIST_DYNAMICPRUNING");
+
+    if (env == nullptr)
+    {
+        return 0;
+    }
+    if (*env == '\0')
+    {
+        return nbnxnDynamicPruningIntervalDefault;
+    }
+
+    char *end;
+    int   nstlistPrune = strtol(env, &end, 10);
+    if (*end != '\0' || nstlistPrune < 1)
+    {
+        gmx_fatal(FARGS, "Invalid value passed in GMX_NSTLIST_DYNAMICPRUNING=%s, positive integer required", env);
+    }
+
+    return nstlistPrune;
+}
+
+/*! \brief Try to increase nstlist when using the Verlet cut-off scheme
+ *
+ * With \p bDynamicPruning the kernels use a pruned list, so the list
+ * buffer, and thus nstlist, can be much larger.
+ */
 static void increase_nstlist(FILE *fp, t_commrec *cr,
                              t_inputrec *ir, int nstlist_cmdline,
                              const gmx_mtop_t *mtop, matrix box,
-                             gmx_bool bGPU, const gmx::CpuInfo &cpuinfo)
+                             gmx_bool bGPU, gmx_bool bDynamicPruning,
+                             const gmx::CpuInfo &cpuinfo)
 {
+    const int             *nstl_try = (bDynamicPruning ? nstlist_try_dynamic_pruning : nstlist_try);
+    const size_t           nnstl    = (bDynamicPruning ? NNSTL_DYNAMIC_PRUNING : NNSTL);
     float                  listfac_ok, listfac_max;
     int                    nstlist_orig, nstlist_prev;
     verletbuf_list_setup_t ls;
@@ -367,16 +417,16 @@ static void increase_nstlist(FILE *fp, t_commrec *cr,
             return;
         }
 
-        if (fp != nullptr && bGPU && ir->nstlist < nstlist_try[0])
+        if (fp != nullptr && bGPU && ir->nstlist < nstl_try[0])
         {
             fprintf(fp, nstl_gpu, ir->nstlist);
         }
         nstlist_ind = 0;
-        while (nstlist_ind < NNSTL && ir->nstlist >= nstlist_try[nstlist_ind])
+        while (nstlist_ind < nnstl && ir->nstlist >= nstl_try[nstlist_ind])
         {
             nstlist_ind++;
         }
-        if (nstlist_ind == NNSTL)
+        if (nstlist_ind == nnstl)
         {
             /* There are no larger nstlist value to try */
             return;
@@ -421,6 +471,11 @@ static void increase_nstlist(FILE *fp, t_commrec *cr,
         listfac_ok  = nbnxn_gpu_listfac_ok;
         listfac_max = nbnxn_gpu_listfac_max;
     }
+    else if (bDynamicPruning)
+    {
+        listfac_ok  = nbnxn_cpu_dynamic_pruning_listfac_ok;
+        listfac_max = nbnxn_cpu_dynamic_pruning_listfac_max;
+    }
     else if (cpuinfo.feature(gmx::CpuInfo::Feature::X86_Avx512ER))
     {
         listfac_ok  = nbnxn_knl_listfac_ok;
@@ -471,7 +526,7 @@ static void increase_nstlist(FILE *fp, t_commrec *cr,
     {
         if (nstlist_cmdline <= 0)
         {
-            ir->nstlist = nstlist_try[nstlist_ind];
+            ir->nstlist = nstl_try[nstlist_ind];
         }
 
         /* Set the pair-list buffer size in ir */
@@ -507,7 +562,7 @@ static void increase_nstlist(FILE *fp, t_commrec *cr,
                 /* Increase nstlist */
                 nstlist_prev = ir->nstlist;
                 rlist_prev   = rlist_new;
-                bCont        = (nstlist_ind+1 < NNSTL && rlist_new < rlist_ok);
+                bCont        = (nstlist_ind+1 < nnstl && rlist_new < rlist_ok);
             }
             else
             {
@@ -549,6 +604,51 @@ static void increase_nstlist(FILE *fp, t_commrec *cr,
     }
 }
 
+/*! \brief Returns the pair-list pruning interval, 0 when dynamic pruning can not be used
+ *
+ * Checks the conditions for dynamic pruning that do not depend on nstlist.
+ * These are known before nstlist is set, so prepare_verlet_scheme() only
+ * increases nstlist for a pruned list when the list will be pruned.
+ * When pruning was requested, but can not be used, a note is printed
+ * to \p fplog, when not nullptr.
+ */
+static int get_dynamic_pruning_interval(FILE             *fplog,
+                                        const t_inputrec *ir,
+                                        gmx_bool          bRerunMD,
+                                        gmx_bool          bUseGPU)
+{
+    const int nstlistPrune = get_nstlist_prune_env();
+
+    if (nstlistPrune == 0)
+    {
+        return 0;
+    }
+
+    const char *note = nullptr;
+    if (!EI_DYNAMICS(ir->eI) || bRerunMD)
+    {
+        note = "dynamic pruning is only useful with dynamics";
+    }
+    else if (ir->verletbuf_tol <= 0 || (EI_MD(ir->eI) && ir->etc == etcNO))
+    {
+        note = "dynamic pruning requires verlet-buffer-tolerance and a thermostat";
+    }
+    else if (bUseGPU)
+    {
+        note = "dynamic pruning is only supported with CPU non-bonded kernels";
+    }
+    if (note != nullptr)
+    {
+        if (fplog != nullptr)
+        {
+            fprintf(fplog, "\nNOTE: Not using dynamic pair-list pruning, as %s\n", note);
+        }
+        return 0;
+    }
+
+    return nstlistPrune;
+}
+
 /*! \brief Initialize variables for Verlet scheme simulation */
 static void prepare_verlet_scheme(FILE                           *fplog,
                                   t_commrec                      *cr,
@@ -557,6 +657,7 @@ static void prepare_verlet_scheme(FILE                           *fplog,
                                   const gmx_mtop_t               *mtop,
                                   matrix                          box,
                                   gmx_bool                        bUseGPU,
+                                  gmx_bool                        bRerunMD,
                                   const gmx::CpuInfo             &cpuinfo)
 {
     /* For NVE simulations, we will retain the initial list buffer */
@@ -596,8 +697,90 @@ static void prepare_verlet_scheme(FILE                           *fplog,
 
     if (EI_DYNAMICS(ir->eI))
     {
+        /* Only allow the larger list of a pruned list when pruning
+         * will be used, setup_dynamic_pruning() does the same checks.
+         */
+        int  nstlistPrune = get_dynamic_pruning_interval(nullptr, ir, bRerunMD, bUseGPU);
+        int  nstlistOrig  = ir->nstlist;
+        real rlistOrig    = ir->rlist;
+
         /* Set or try nstlist values */
-        increase_nstlist(fplog, cr, ir, nstlist_cmdline, mtop, box, bUseGPU, cpuinfo);
+        increase_nstlist(fplog, cr, ir, nstlist_cmdline, mtop, box, bUseGPU,
+                         nstlistPrune > 0, cpuinfo);
+
+        if (nstlistPrune > 0 && nstlistPrune >= ir->nstlist)
+        {
+            /* The list will not be pruned, set nstlist for an unpruned list */
+            ir->nstlist = nstlistOrig;
+            ir->rlist   = rlistOrig;
+            increase_nstlist(fplog, cr, ir, nstlist_cmdline, mtop, box, bUseGPU,
+                             FALSE, cpuinfo);
+        }
+    }
+}
+
+/*! \brief Set up dynamic pruning of the pair list, when requested
+ *
+ * Determines the buffer for the inner list that is pruned every
+ * nstlistPrune steps and stores the settings in \p nbv.
+ * The outer list uses ir->rlist, as set by prepare_verlet_scheme().
+ */
+static void setup_dynamic_pruning(FILE                *fplog,
+                                  const t_inputrec    *ir,
+                                  const gmx_mtop_t    *mtop,
+                                  matrix               box,
+                                  gmx_bool             bRerunMD,
+                                  nonbonded_verlet_t  *nbv)
+{
+    if (nbv == nullptr)
+    {
+        return;
+    }
+
+    /* The 8x8x8 plain-C kernel is only used with GPU emulation,
+     * for which bUseGPU was already set in prepare_verlet_scheme().
+     */
+    const int nstlistPrune =
+        get_dynamic_pruning_interval(fplog, ir, bRerunMD,
+                                     nbv->bUseGPU || nbv->grp[0].kernel_type == nbnxnk8x8x8_PlainC);
+    if (nstlistPrune == 0)
+    {
+        return;
+    }
+    if (nstlistPrune >= ir->nstlist)
+    {
+        if (fplog != nullptr)
+        {
+            fprintf(fplog, "\nNOTE: Not using dynamic pair-list pruning, as the pruning interval is not smaller than nstlist\n");
+        }
+        return;
+    }
+
+    verletbuf_list_setup_t ls;
+    real                   rlistInner;
+
+    /* The outer buffer is ir->rlist, as set by increase_nstlist() */
+    verletbuf_get_list_setup(TRUE, FALSE, &ls);
+    calc_verlet_buffer_size_pruned(mtop, det(box), ir, nstlistPrune, -1, &ls,
+                                   nullptr, &rlistInner);
+
+    if (rlistInner >= ir->rlist)
+    {
+        if (fplog != nullptr)
+        {
+            fprintf(fplog, "\nNOTE: Not using dynamic pair-list pruning, as the pruned list would not be smaller\n");
+        }
+        return;
+    }
+
+    nbv->bDynamicPruning = TRUE;
+    nbv->nstlistPrune    = nstlistPrune;
+    nbv->rlistInner      = rlistInner;
+
+    if (fplog != nullptr)
+    {
+        fprintf(fplog, "\nUsing dynamic pair-list pruning: outer list rlist %g with nstlist %d, inner list rlist %g pruned every %d steps\n\n",
+                ir->rlist, ir->nstlist, rlistInner, nstlistPrune);
     }
 }
 
@@ -807,7 +990,7 @@ int mdrunner(gmx_hw_opt_t *hw_opt,
 
             prepare_verlet_scheme(fplog, cr,
                                   inputrec, nstlist_cmdline, mtop, state->box,
-                                  bUseGPU, *hwinfo->cpuInfo);
+                                  bUseGPU, bRerunMD, *hwinfo->cpuInfo);
         }
         else
         {
@@ -1213,6 +1396,11 @@ int mdrunner(gmx_hw_opt_t *hw_opt,
                       FALSE,
                       pforce);
 
+        if (inputrec->cutoff_scheme == ecutsVERLET)
+        {
+            setup_dynamic_pruning(fplog, inputrec, mtop, box, bRerunMD, fr->nbv);
+        }
+
         /* Initialize QM-MM */
         if (fr->bQMMM)
         {
@@ -1326,6 +1514,7 @@ int mdrunner(gmx_hw_opt_t *hw_opt,
                 status = gmx_pme_init(pmedata, cr, npme_major, npme_minor, inputrec,
                                       mtop ? mtop->natoms : 0, nChargePerturbed, nTypePerturbed,
                                       (Flags & MD_REPRODUCIBLE),
+                                      getenv("GMX_PME_COMPRESS_GRID_COMM") != nullptr,
                                       ewaldcoeff_q, ewaldcoeff_lj,
                                       nthreads_pme);
             }
@@ -1436,6 +1625,11 @@ int mdrunner(gmx_hw_opt_t *hw_opt,
     /* Free GPU memory and context */
     free_gpu_resources(fr, cr, &hwinfo->gpu_info, fr ? fr->gpu_opt : nullptr);
 
+    if (fr && fr->bQMMM)
+    {
+        done_QMMMrec(fr->qr);
+    }
+
     if (doMembed)
     {
         free_membed(membed);
@@ -43,10 +43,21 @@
 
 #include "stdiohelper.h"
 
+#include "config.h"
+
 #include <cerrno>
 #include <cstdio>
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if GMX_NATIVE_WINDOWS
+#include <io.h>
+#endif
+
 #include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/textreader.h"
 #include "gromacs/utility/textwriter.h"
 
 #include "testutils/testfilemanager.h"
@@ -73,5 +84,46 @@ StdioTestHelper::redirectStringToStdin(const char *theString)
     }
 }
 
+StdioTestHelper::~StdioTestHelper()
+{
+    restoreStdout();
+}
+
+void
+StdioTestHelper::redirectStdoutToFile()
+{
+    GMX_RELEASE_ASSERT(savedStdout_ < 0, "stdout is already redirected");
+    stdoutPath_ = fileManager_.getTemporaryFilePath(".stdout");
+    std::fflush(stdout);
+    savedStdout_ = dup(fileno(stdout));
+    if (savedStdout_ < 0 || nullptr == std::freopen(stdoutPath_.c_str(), "w", stdout))
+    {
+        GMX_THROW_WITH_ERRNO(FileIOError("Failed to redirect stdout to a file"),
+                             "freopen",
+                             errno);
+    }
+}
+
+void
+StdioTestHelper::restoreStdout()
+{
+    if (savedStdout_ >= 0)
+    {
+        std::fflush(stdout);
+        dup2(savedStdout_, fileno(stdout));
+        close(savedStdout_);
+        std::clearerr(stdout);
+        savedStdout_ = -1;
+    }
+}
+
+std::string
+StdioTestHelper::readStdout()
+{
+    restoreStdout();
+
+    return gmx::TextReader::readFileToString(stdoutPath_);
+}
+
 } // namespace test
 } // namespace gmx
@@ -43,6 +43,8 @@
 #ifndef GMX_TESTUTILS_STDIOHELPER_H
 #define GMX_TESTUTILS_STDIOHELPER_H
 
+#include <string>
+
 #include "gromacs/utility/classhelpers.h"
 
 namespace gmx
@@ -53,7 +55,8 @@ namespace test
 class TestFileManager;
 
 /*! \libinternal \brief
- * Helper class for tests where code reads directly from `stdin`.
+ * Helper class for tests where code reads directly from `stdin`
+ * or writes directly to `stdout`.
  *
  * Any method in this class may throw std::bad_alloc if out of memory.
  *
@@ -65,9 +68,11 @@ class StdioTestHelper
     public:
         //! Creates a helper using the given file manager.
         explicit StdioTestHelper(TestFileManager *fileManager)
-            : fileManager_(*fileManager)
+            : fileManager_(*fileManager), savedStdout_(-1)
         {
         }
+        //! Restores stdout, when it is still redirected.
+        ~StdioTestHelper();
 
         /*! \brief Accepts a string as input, writes it to a temporary
          * file and then reopens stdin to read the contents of that
@@ -77,8 +82,27 @@ class StdioTestHelper
          */
         void redirectStringToStdin(const char *theString);
 
+        /*! \brief Redirects stdout to a temporary file, until
+         * readStdout() is called.
+         *
+         * \throws FileIOError  when the redirection fails
+         */
+        void redirectStdoutToFile();
+
+        /*! \brief Restores stdout and returns everything that was
+         * written to it since redirectStdoutToFile().
+         */
+        std::string readStdout();
+
     private:
+        //! Restores the original stdout.
+        void restoreStdout();
+
         TestFileManager &fileManager_;
+        //! Path of the file stdout is redirected to.
+        std::string      stdoutPath_;
+        //! Duplicate of the original stdout file descriptor, -1 when not redirected.
+        int              savedStdout_;
 
         GMX_DISALLOW_COPY_AND_ASSIGN(StdioTestHelper);
 };